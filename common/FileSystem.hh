@@ -42,6 +42,10 @@ EOSCOMMONNAMESPACE_BEGIN;
 #define EOS_TAPE_FSID 65535
 #define EOS_TAPE_MODE_T (0x10000000ll)
 
+//! First line of the "fs dumpmd" stream display, followed by the raw
+//! length-delimited FileMdDumpProto records and an empty end record
+#define EOS_DUMPMD_STREAM_TAG "eos.dumpmd.stream=1\n"
+
 class TransferQueue;
 
 //------------------------------------------------------------------------------
@@ -24,6 +24,13 @@
 #include "common/Namespace.hh"
 #include "common/Logging.hh"
 #include "XrdSys/XrdSysPthread.hh"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdarg>
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 EOSCOMMONNAMESPACE_BEGIN
 
@@ -34,7 +41,9 @@ Mapping::VirtualIdentity Logging::gZeroVid;
 //------------------------------------------------------------------------------
 Logging::Logging():
   gLogMask(0), gPriorityLevel(0), gToSysLog(false),  gUnit("none"),
-  gShortFormat(0)
+  gShortFormat(0), gLogFanOut(std::make_shared<std::map<std::string, FILE*>>()),
+  gDroppedMessages(0), gBypassedMessages(0), mAsync(false),
+  mWriterStop(false), mReportedDrops(0)
 {
   // Initialize the log array and sets the log circular size
   gLogCircularIndex.resize(LOG_DEBUG + 1);
@@ -57,6 +66,14 @@ Logging::Logging():
       gToSysLog = true;
     }
   }
+
+  if (getenv("EOS_LOG_ASYNC")) {
+    XrdOucString toasync = getenv("EOS_LOG_ASYNC");
+
+    if ((toasync == "1") || (toasync == "true")) {
+      SetAsync(true);
+    }
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -83,6 +100,69 @@ Logging::shouldlog(const char* func, int priority)
   return true;
 }
 
+//------------------------------------------------------------------------------
+// Per-thread state used while formatting log messages
+//------------------------------------------------------------------------------
+namespace
+{
+struct ThreadLogState {
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  ThreadLogState(): mBuffer(nullptr), mBufferSize(0), mTsSec((time_t) - 1)
+  {
+    mTimestamp[0] = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Make sure the format buffer holds at least the given number of bytes,
+  //! keeping the first keep bytes of its content
+  //----------------------------------------------------------------------------
+  char*
+  Reserve(size_t size, size_t keep = 0)
+  {
+    if (mBufferSize < size) {
+      std::unique_ptr<char[]> buffer(new char[size]);
+
+      if (keep) {
+        memcpy(buffer.get(), mBuffer.get(), keep);
+      }
+
+      mBuffer.swap(buffer);
+      mBufferSize = size;
+    }
+
+    return mBuffer.get();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Destructor - hand the ring over to the writer thread for cleanup
+  //----------------------------------------------------------------------------
+  ~ThreadLogState()
+  {
+    if (mRing) {
+      mRing->mOrphaned = true;
+    }
+  }
+
+  std::unique_ptr<char[]> mBuffer; ///< Message format buffer
+  size_t mBufferSize; ///< Size of the message format buffer
+  time_t mTsSec; ///< Second for which mTimestamp was computed
+  char mTimestamp[64]; ///< Cached "YYMMDD HH:MM:SS" string
+  std::shared_ptr<LogRing> mRing; ///< Ring used by the asynchronous writer
+};
+
+thread_local ThreadLogState tlLogState;
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+Logging::~Logging()
+{
+  SetAsync(false);
+}
+
 //------------------------------------------------------------------------------
 // Logging function
 //------------------------------------------------------------------------------
@@ -91,8 +171,6 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
              const Mapping::VirtualIdentity& vid, const char* cident, int priority,
              const char* msg, ...)
 {
-  static int logmsgbuffersize = 1024 * 1024;
-
   // short cut if log messages are masked
   if (!((LOG_MASK(priority) & gLogMask))) {
     return "";
@@ -113,30 +191,31 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
     }
   }
 
-  static char* buffer = 0;
-
-  if (!buffer) {
-    // 1 M print buffer
-    buffer = (char*) malloc(logmsgbuffersize);
-  }
-
+  ThreadLogState& tls = tlLogState;
+  // small print buffer per thread, grown for long messages
+  char* buffer = tls.Reserve(sLogMsgInitBufferSize);
   XrdOucString File = file;
   // we show only one hierarchy directory like Acl (assuming that we have only
   // file names like *.cc and *.hh
   File.erase(0, File.rfind("/") + 1);
   File.erase(File.length() - 3);
-  static time_t current_time;
-  static struct timeval tv;
-  static struct timezone tz;
-  struct tm tm;
-  XrdSysMutexHelper scope_lock(gMutex);
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  time_t current_time = tv.tv_sec;
+
+  // the broken down time only changes once per second
+  if (current_time != tls.mTsSec) {
+    struct tm tm;
+    localtime_r(&current_time, &tm);
+    snprintf(tls.mTimestamp, sizeof(tls.mTimestamp),
+             "%02d%02d%02d %02d:%02d:%02d", tm.tm_year - 100, tm.tm_mon + 1,
+             tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    tls.mTsSec = current_time;
+  }
+
   va_list args;
   va_start(args, msg);
-  gettimeofday(&tv, &tz);
-  current_time = tv.tv_sec;
-  static char linen[16];
-  sprintf(linen, "%d", line);
-  static char fcident[1024];
+  char fcident[1024];
   XrdOucString truncname = vid.name;
 
   // we show only the last 16 bytes of the name
@@ -146,96 +225,113 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
   }
 
   char sourceline[64];
+  snprintf(sourceline, sizeof(sourceline) - 1, "%s:%d", File.c_str(), line);
+
+  int prefix_len;
 
   if (gShortFormat) {
-    localtime_r(&current_time, &tm);
-    snprintf(sourceline, sizeof(sourceline) - 1, "%s:%s", File.c_str(), linen);
     XrdOucString slog = logid;
 
     if (slog.beginswith("logid:")) {
       slog.erase(0, 6);
-      sprintf(buffer,
-              "%02d%02d%02d %02d:%02d:%02d t=%lu.%06lu f=%-16s l=%s %s s=%-24s ",
-              tm.tm_year - 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-              tm.tm_min, tm.tm_sec, current_time, (unsigned long) tv.tv_usec,
-              func, GetPriorityString(priority), slog.c_str(), sourceline);
+      prefix_len = snprintf(buffer, tls.mBufferSize,
+                            "%s t=%lu.%06lu f=%-16s l=%s %s s=%-24s ",
+                            tls.mTimestamp, current_time, (unsigned long) tv.tv_usec,
+                            func, GetPriorityString(priority), slog.c_str(), sourceline);
     } else {
-      sprintf(buffer,
-              "%02d%02d%02d %02d:%02d:%02d t=%lu.%06lu f=%-16s l=%s tid=%016lx s=%-24s ",
-              tm.tm_year - 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-              tm.tm_min, tm.tm_sec, current_time, (unsigned long) tv.tv_usec,
-              func, GetPriorityString(priority), (unsigned long) XrdSysThread::ID(),
-              sourceline);
+      prefix_len = snprintf(buffer, tls.mBufferSize,
+                            "%s t=%lu.%06lu f=%-16s l=%s tid=%016lx s=%-24s ",
+                            tls.mTimestamp, current_time, (unsigned long) tv.tv_usec,
+                            func, GetPriorityString(priority),
+                            (unsigned long) XrdSysThread::ID(), sourceline);
     }
   } else {
-    sprintf(fcident, "tident=%s sec=%-5s uid=%d gid=%d name=%s geo=\"%s\"", cident,
-            vid.prot.c_str(), vid.uid, vid.gid, truncname.c_str(), vid.geolocation.c_str());
+    snprintf(fcident, sizeof(fcident),
+             "tident=%s sec=%-5s uid=%d gid=%d name=%s geo=\"%s\"", cident,
+             vid.prot.c_str(), vid.uid, vid.gid, truncname.c_str(),
+             vid.geolocation.c_str());
+    prefix_len = snprintf(buffer, tls.mBufferSize,
+                          "%s time=%lu.%06lu func=%-24s level=%s logid=%s unit=%s tid=%016lx source=%-30s %s ",
+                          tls.mTimestamp, current_time, (unsigned long) tv.tv_usec, func,
+                          GetPriorityString(priority), logid, gUnit.c_str(),
+                          (unsigned long) XrdSysThread::ID(), sourceline, fcident);
+  }
 
-    localtime_r(&current_time, &tm);
-    snprintf(sourceline, sizeof(sourceline) - 1, "%s:%s", File.c_str(), linen);
-    sprintf(buffer,
-            "%02d%02d%02d %02d:%02d:%02d time=%lu.%06lu func=%-24s level=%s logid=%s unit=%s tid=%016lx source=%-30s %s ",
-            tm.tm_year - 100, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
-            tm.tm_sec, current_time, (unsigned long) tv.tv_usec, func,
-            GetPriorityString(priority), logid, gUnit.c_str(),
-            (unsigned long) XrdSysThread::ID(), sourceline, fcident);
+  // an oversized prefix is truncated to the initial buffer
+  if (prefix_len < 0) {
+    prefix_len = 0;
+    buffer[0] = 0;
+  } else if ((size_t) prefix_len >= tls.mBufferSize) {
+    prefix_len = tls.mBufferSize - 1;
   }
 
-  char* ptr = buffer + strlen(buffer);
-  // limit the length of the output to buffer-1 length
-  vsnprintf(ptr, logmsgbuffersize - (ptr - buffer + 1), msg, args);
+  char* ptr = buffer + prefix_len;
+  va_list args_retry;
+  va_copy(args_retry, args);
+  int msg_len = vsnprintf(ptr, tls.mBufferSize - prefix_len, msg, args);
+
+  if ((msg_len > 0) &&
+      ((size_t)(prefix_len + msg_len) >= tls.mBufferSize) &&
+      (tls.mBufferSize < sLogMsgBufferSize)) {
+    // grow the buffer and format again, the output is limited to
+    // sLogMsgBufferSize - 1 bytes
+    buffer = tls.Reserve(std::min(sLogMsgBufferSize,
+                                  (size_t)(prefix_len + msg_len + 1)), prefix_len);
+    ptr = buffer + prefix_len;
+    vsnprintf(ptr, tls.mBufferSize - prefix_len, msg, args_retry);
+  }
+
+  va_end(args_retry);
+  va_end(args);
 
   if (gToSysLog) {
     syslog(priority, "%s", ptr);
   }
 
-  if (gLogFanOut.size()) {
+  // build all the output lines outside the global lock
+  std::string out = buffer;
+  out += '\n';
+
+  std::shared_ptr<const std::map<std::string, FILE*>> fanout = GetFanOut();
+
+  if (fanout->size()) {
     // we do log-message fanout
-    if (gLogFanOut.count("*")) {
-      fprintf(gLogFanOut["*"], "%s\n", buffer);
-      fflush(gLogFanOut["*"]);
-    }
-
-    if (gLogFanOut.count(File.c_str())) {
-      buffer[15] = 0;
-      fprintf(gLogFanOut[File.c_str()], "%s %s%s%s %-30s %s \n",
-              buffer,
-              GetLogColour(GetPriorityString(priority)),
-              GetPriorityString(priority),
-              EOS_TEXTNORMAL,
-              sourceline,
-              ptr);
-      fflush(gLogFanOut[File.c_str()]);
-      buffer[15] = ' ';
-    } else {
-      if (gLogFanOut.count("#")) {
-        buffer[15] = 0;
-        fprintf(gLogFanOut["#"], "%s %s%s%s [%05d/%05d] %16s ::%-16s %s \n",
-                buffer,
-                GetLogColour(GetPriorityString(priority)),
-                GetPriorityString(priority),
-                EOS_TEXTNORMAL,
-                vid.uid,
-                vid.gid,
-                truncname.c_str(),
-                func,
-                ptr
-               );
-        fflush(gLogFanOut["#"]);
-        buffer[15] = ' ';
-      }
+    auto it_all = fanout->find("*");
+
+    if (it_all != fanout->end()) {
+      Output(it_all->second, out, priority);
     }
 
-    fprintf(stderr, "%s\n", buffer);
-    fflush(stderr);
-  } else {
-    fprintf(stderr, "%s\n", buffer);
-    fflush(stderr);
+    auto it_file = fanout->find(File.c_str());
+    auto it_fanout = (it_file != fanout->end()) ? it_file :
+                     fanout->find("#");
+
+    if (it_fanout != fanout->end()) {
+      std::string fan_line(buffer, 15);
+      fan_line += ' ';
+      fan_line += GetLogColour(GetPriorityString(priority));
+      fan_line += GetPriorityString(priority);
+      fan_line += EOS_TEXTNORMAL;
+      char extra[256];
+
+      if (it_fanout == it_file) {
+        snprintf(extra, sizeof(extra), " %-30s ", sourceline);
+      } else {
+        snprintf(extra, sizeof(extra), " [%05d/%05d] %16s ::%-16s ",
+                 vid.uid, vid.gid, truncname.c_str(), func);
+      }
+
+      fan_line += extra;
+      fan_line += ptr;
+      fan_line += " \n";
+      Output(it_fanout->second, fan_line, priority);
+    }
   }
 
-  va_end(args);
+  Output(stderr, out, priority);
   const char* rptr;
   // store into global log memory
+  XrdSysMutexHelper scope_lock(gMutex);
   gLogMemory[priority][(gLogCircularIndex[priority]) % gCircularIndexSize] =
     buffer;
   rptr = gLogMemory[priority][(gLogCircularIndex[priority]) %
@@ -244,6 +340,225 @@ Logging::log(const char* func, const char* file, int line, const char* logid,
   return rptr;
 }
 
+//------------------------------------------------------------------------------
+// Output formatted line either synchronously or through the thread's ring
+//------------------------------------------------------------------------------
+void
+Logging::Output(FILE* fd, const std::string& line, int priority)
+{
+  if (mAsync) {
+    LogRing* ring = GetThreadRing();
+
+    if (ring->Push(fileno(fd), line)) {
+      // the writer may have been stopped while we were pushing, in which
+      // case nobody else is going to write out this record
+      if (!mAsync) {
+        DrainRings();
+      }
+
+      return;
+    }
+
+    // ring is full - drop chatty messages, write out the important ones
+    if (priority > LOG_ERR) {
+      ++gDroppedMessages;
+      return;
+    }
+
+    ++gBypassedMessages;
+  }
+
+  XrdSysMutexHelper scope_lock(gMutex);
+  fwrite(line.c_str(), 1, line.length(), fd);
+  fflush(fd);
+}
+
+//------------------------------------------------------------------------------
+// Get the ring of the calling thread, registering it if needed
+//------------------------------------------------------------------------------
+LogRing*
+Logging::GetThreadRing()
+{
+  ThreadLogState& tls = tlLogState;
+
+  if (!tls.mRing) {
+    tls.mRing = std::make_shared<LogRing>(sRingCapacity);
+    std::lock_guard<std::mutex> lock(mRingsMutex);
+    mRings.push_back(tls.mRing);
+  }
+
+  return tls.mRing.get();
+}
+
+//------------------------------------------------------------------------------
+// Enable/disable the asynchronous log writer
+//------------------------------------------------------------------------------
+void
+Logging::SetAsync(bool onoff)
+{
+  std::lock_guard<std::mutex> lock(mAsyncMutex);
+
+  if (onoff) {
+    if (!mWriterThread.joinable()) {
+      mWriterStop = false;
+      mWriterThread = std::thread(&Logging::WriterLoop, this);
+    }
+
+    mAsync = true;
+  } else {
+    mAsync = false;
+
+    if (mWriterThread.joinable()) {
+      mWriterStop = true;
+      mWriterThread.join();
+    }
+
+    // the writer is gone, write out whatever is left in the rings
+    DrainRings();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Wait until all the messages queued so far are written out
+//------------------------------------------------------------------------------
+void
+Logging::Flush()
+{
+  std::vector<std::shared_ptr<LogRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(mRingsMutex);
+    rings.assign(mRings.begin(), mRings.end());
+  }
+
+  for (auto& ring : rings) {
+    while (mWriterThread.joinable() && !ring->Empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Asynchronous log writer loop
+//------------------------------------------------------------------------------
+void
+Logging::WriterLoop()
+{
+  auto last_report = std::chrono::steady_clock::now();
+
+  while (!mWriterStop) {
+    if (DrainRings() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (now - last_report > std::chrono::seconds(10)) {
+      last_report = now;
+      unsigned long long dropped = gDroppedMessages;
 
+      if (dropped != mReportedDrops) {
+        char report[256];
+        int len = snprintf(report, sizeof(report),
+                           "time=%lu func=%-24s level=WARN unit=%s msg=\"dropped "
+                           "%llu log messages, log rings full\"\n",
+                           (unsigned long) time(0), "WriterLoop", gUnit.c_str(),
+                           dropped - mReportedDrops);
+        mReportedDrops = dropped;
+
+        if ((len > 0) && (write(STDERR_FILENO, report, len) < 0)) {
+          // nothing we can do about it
+        }
+      }
+    }
+  }
+
+  DrainRings();
+}
+
+//------------------------------------------------------------------------------
+// Write out all queued records using batched writev calls
+//------------------------------------------------------------------------------
+size_t
+Logging::DrainRings()
+{
+  std::lock_guard<std::mutex> drain_lock(mDrainMutex);
+  size_t nwritten = 0;
+  mDrainRings.clear();
+  {
+    std::lock_guard<std::mutex> lock(mRingsMutex);
+
+    for (auto it = mRings.begin(); it != mRings.end(); /* empty */) {
+      // rings of exited threads are dropped once empty
+      if ((*it)->mOrphaned && (*it)->Empty()) {
+        it = mRings.erase(it);
+      } else {
+        mDrainRings.push_back(*it);
+        ++it;
+      }
+    }
+  }
+  std::vector<struct iovec> iov;
+  iov.reserve(IOV_MAX);
+
+  for (auto& ring : mDrainRings) {
+    uint64_t tail, head;
+    ring->Peek(tail, head);
+
+    while (tail != head) {
+      // batch consecutive records going to the same file descriptor
+      int fd = ring->At(tail).mFd;
+      uint64_t end = tail;
+      iov.clear();
+
+      while ((end != head) && (ring->At(end).mFd == fd) &&
+             (iov.size() < IOV_MAX)) {
+        const std::string& line = ring->At(end).mLine;
+        iov.push_back({(void*) line.c_str(), line.length()});
+        ++end;
+      }
+
+      WriteVector(fd, iov);
+      nwritten += end - tail;
+      tail = end;
+      ring->Release(tail);
+    }
+  }
+
+  mDrainRings.clear();
+  return nwritten;
+}
+
+//------------------------------------------------------------------------------
+// Write all the given buffers to the file descriptor handling partial writes
+//------------------------------------------------------------------------------
+void
+Logging::WriteVector(int fd, std::vector<struct iovec>& iov)
+{
+  struct iovec* piov = iov.data();
+  int cnt = (int) iov.size();
+
+  while (cnt > 0) {
+    ssize_t nwrite = writev(fd, piov, cnt);
+
+    if (nwrite < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return;
+    }
+
+    while ((cnt > 0) && ((size_t) nwrite >= piov->iov_len)) {
+      nwrite -= piov->iov_len;
+      ++piov;
+      --cnt;
+    }
+
+    if (cnt > 0) {
+      piov->iov_base = (char*) piov->iov_base + nwrite;
+      piov->iov_len -= nwrite;
+    }
+  }
+}
 
 EOSCOMMONNAMESPACE_END
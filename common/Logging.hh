@@ -55,8 +55,15 @@
 #include <string.h>
 #include <sys/syslog.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <uuid/uuid.h>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 EOSCOMMONNAMESPACE_BEGIN
@@ -270,6 +277,109 @@ public:
   Mapping::VirtualIdentity vid; //< the client identity
 };
 
+//------------------------------------------------------------------------------
+//! Single producer/single consumer ring of formatted log records. Every
+//! logging thread owns one ring which is drained by the asynchronous log
+//! writer thread.
+//------------------------------------------------------------------------------
+class LogRing
+{
+public:
+  //! Formatted log record together with its destination file descriptor
+  struct Record {
+    int mFd;
+    std::string mLine;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param capacity number of records, rounded up to a power of 2
+  //----------------------------------------------------------------------------
+  explicit LogRing(size_t capacity = 4096):
+    mOrphaned(false), mHead(0), mTail(0)
+  {
+    size_t sz = 1;
+
+    while (sz < capacity) {
+      sz <<= 1;
+    }
+
+    mRecords.resize(sz);
+    mMask = sz - 1;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Push record to the ring - producer side
+  //!
+  //! @return true if successful, false if ring is full
+  //----------------------------------------------------------------------------
+  bool
+  Push(int fd, const std::string& line)
+  {
+    uint64_t head = mHead.load(std::memory_order_relaxed);
+
+    if (head - mTail.load(std::memory_order_acquire) > mMask) {
+      return false;
+    }
+
+    Record& rec = mRecords[head & mMask];
+    rec.mFd = fd;
+    rec.mLine = line;
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the range of records available to the consumer
+  //!
+  //! @param tail index of the first available record
+  //! @param head index after the last available record
+  //----------------------------------------------------------------------------
+  void
+  Peek(uint64_t& tail, uint64_t& head) const
+  {
+    tail = mTail.load(std::memory_order_relaxed);
+    head = mHead.load(std::memory_order_acquire);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get record at the given index - consumer side
+  //----------------------------------------------------------------------------
+  const Record&
+  At(uint64_t index) const
+  {
+    return mRecords[index & mMask];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Release records up to the given index - consumer side
+  //----------------------------------------------------------------------------
+  void
+  Release(uint64_t index)
+  {
+    mTail.store(index, std::memory_order_release);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if ring is empty
+  //----------------------------------------------------------------------------
+  bool
+  Empty() const
+  {
+    return (mTail.load(std::memory_order_acquire) ==
+            mHead.load(std::memory_order_acquire));
+  }
+
+  std::atomic<bool> mOrphaned; ///< Set once the owning thread exited
+
+private:
+  std::vector<Record> mRecords; ///< Record slots
+  uint64_t mMask; ///< Index mask
+  std::atomic<uint64_t> mHead; ///< Next slot to be written by the producer
+  std::atomic<uint64_t> mTail; ///< Next slot to be read by the consumer
+};
+
 //------------------------------------------------------------------------------
 //! Class wrapping global singleton objects for logging
 //------------------------------------------------------------------------------
@@ -294,8 +404,16 @@ public:
   //! Global list of function names denied to log
   XrdOucHash<const char*> gDenyFilter;
   int gShortFormat; //< indiciating if the log-output is in short format
-  //! Here one can define log fan-out to different file descriptors than stderr
-  std::map<std::string, FILE*> gLogFanOut;
+  //! Log fan-out to different file descriptors than stderr. The map is
+  //! never modified in place: AddFanOut publishes a new copy, so that the
+  //! logging threads can read it without taking gMutex.
+  std::shared_ptr<const std::map<std::string, FILE*>> gLogFanOut;
+  //! Number of messages dropped by the asynchronous writer because the
+  //! per-thread ring was full
+  std::atomic<unsigned long long> gDroppedMessages;
+  //! Number of messages written synchronously because the per-thread ring
+  //! was full and the message priority too high to be dropped
+  std::atomic<unsigned long long> gBypassedMessages;
 
   //----------------------------------------------------------------------------
   //! Get singleton instance - this method MUST be in the header file so that
@@ -332,6 +450,28 @@ public:
     gToSysLog = onoff;
   }
 
+  //----------------------------------------------------------------------------
+  //! Enable/disable the asynchronous log writer. When enabled, messages are
+  //! formatted by the calling thread, queued into a per-thread ring and
+  //! written in batches by a background thread. Debug to notice messages are
+  //! dropped if the ring is full, more severe ones are written directly.
+  //----------------------------------------------------------------------------
+  void SetAsync(bool onoff);
+
+  //----------------------------------------------------------------------------
+  //! Check if the asynchronous log writer is enabled
+  //----------------------------------------------------------------------------
+  bool
+  IsAsync() const
+  {
+    return mAsync;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Wait until all the messages queued so far are written out
+  //----------------------------------------------------------------------------
+  void Flush();
+
   //----------------------------------------------------------------------------
   //! Set the log filter
   //----------------------------------------------------------------------------
@@ -454,7 +594,11 @@ public:
   void
   AddFanOut(const char* tag, FILE* fd)
   {
-    gLogFanOut[tag] = fd;
+    XrdSysMutexHelper scope_lock(gMutex);
+    auto fanout = std::make_shared<std::map<std::string, FILE*>>(*GetFanOut());
+    (*fanout)[tag] = fd;
+    std::atomic_store(&gLogFanOut,
+                      std::shared_ptr<const std::map<std::string, FILE*>>(fanout));
   }
 
   //----------------------------------------------------------------------------
@@ -463,11 +607,25 @@ public:
   void
   AddFanOutAlias(const char* alias, const char* tag)
   {
-    if (gLogFanOut.count(tag)) {
-      gLogFanOut[alias] = gLogFanOut[tag];
+    XrdSysMutexHelper scope_lock(gMutex);
+    auto fanout = std::make_shared<std::map<std::string, FILE*>>(*GetFanOut());
+
+    if (fanout->count(tag)) {
+      (*fanout)[alias] = (*fanout)[tag];
+      std::atomic_store(&gLogFanOut,
+                        std::shared_ptr<const std::map<std::string, FILE*>>(fanout));
     }
   }
 
+  //----------------------------------------------------------------------------
+  //! Get a snapshot of the log fan-out
+  //----------------------------------------------------------------------------
+  std::shared_ptr<const std::map<std::string, FILE*>>
+  GetFanOut() const
+  {
+    return std::atomic_load(&gLogFanOut);
+  }
+
   //----------------------------------------------------------------------------
   //! Get a color for a given logging level
   //----------------------------------------------------------------------------
@@ -536,11 +694,67 @@ public:
                   const char* logid, const Mapping::VirtualIdentity& vid,
                   const char* cident, int priority, const char* msg, ...);
 
+  //----------------------------------------------------------------------------
+  //! Destructor - flushes and stops the asynchronous log writer
+  //----------------------------------------------------------------------------
+  ~Logging();
+
 private:
+  //! Max size of a formatted log message
+  static constexpr size_t sLogMsgBufferSize = 1024 * 1024;
+  //! Initial size of the per-thread format buffer, grown on demand up to
+  //! sLogMsgBufferSize
+  static constexpr size_t sLogMsgInitBufferSize = 4 * 1024;
+  //! Max number of queued records per thread in asynchronous mode
+  static constexpr size_t sRingCapacity = 4096;
+
   //----------------------------------------------------------------------------
   //! Constructor - use GetInstance to get singleton object
   //----------------------------------------------------------------------------
   Logging();
+
+  //----------------------------------------------------------------------------
+  //! Output formatted line either synchronously or through the calling
+  //! thread's ring
+  //!
+  //! @param fd destination FILE object
+  //! @param line formatted line including newline
+  //! @param priority priority level of the message
+  //----------------------------------------------------------------------------
+  void Output(FILE* fd, const std::string& line, int priority);
+
+  //----------------------------------------------------------------------------
+  //! Get the ring of the calling thread, registering it if needed
+  //----------------------------------------------------------------------------
+  LogRing* GetThreadRing();
+
+  //----------------------------------------------------------------------------
+  //! Asynchronous log writer loop
+  //----------------------------------------------------------------------------
+  void WriterLoop();
+
+  //----------------------------------------------------------------------------
+  //! Write out all queued records using batched writev calls
+  //!
+  //! @return number of records written
+  //----------------------------------------------------------------------------
+  size_t DrainRings();
+
+  //----------------------------------------------------------------------------
+  //! Write all the given buffers to the file descriptor handling partial
+  //! writes
+  //----------------------------------------------------------------------------
+  static void WriteVector(int fd, std::vector<struct iovec>& iov);
+
+  std::atomic<bool> mAsync; ///< Asynchronous writer enabled
+  std::atomic<bool> mWriterStop; ///< Flag to stop the writer thread
+  std::thread mWriterThread; ///< Asynchronous writer thread
+  std::mutex mAsyncMutex; ///< Serialize starting/stopping the writer
+  std::mutex mRingsMutex; ///< Mutex protecting the list of rings
+  std::list<std::shared_ptr<LogRing>> mRings; ///< Rings of logging threads
+  std::mutex mDrainMutex; ///< Serialize the consumers of the rings
+  std::vector<std::shared_ptr<LogRing>> mDrainRings; ///< Drainer's snapshot
+  unsigned long long mReportedDrops; ///< Drops already reported by writer
 };
 
 EOSCOMMONNAMESPACE_END
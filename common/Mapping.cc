@@ -72,6 +72,9 @@ std::map<std::string, uid_t> Mapping::gPhysicalUserIdCache;
 std::map<std::string, gid_t> Mapping::gPhysicalGroupIdCache;
 
 Mapping::ip_cache Mapping::gIpCache(300);
+Mapping::id_cache Mapping::gIdCache(300);
+std::atomic<uint64_t> Mapping::gMapGeneration(0);
+constexpr size_t Mapping::id_cache::sNumShards;
 /*----------------------------------------------------------------------------*/
 /**
  * Initialize Google maps
@@ -115,6 +118,7 @@ Mapping::Reset()
     XrdSysMutexHelper mLock(ActiveLock);
     ActiveTidents.clear();
   }
+  gIdCache.Clear();
 }
 
 
@@ -175,9 +179,123 @@ Mapping::IdMap(const XrdSecEntity* client, const char* env, const char* tident,
 
   eos_static_debug("name:%s role:%s group:%s tident:%s", client->name,
                    client->role, client->grps, client->tident);
+  XrdOucEnv Env(env);
+  // ---------------------------------------------------------------------------
+  // the cache key covers everything the mapping reads apart from the rules
+  // ---------------------------------------------------------------------------
+  const char* fields[] = {
+    tident, client->prot, client->name, client->role, client->grps,
+    client->host, Env.Get("eos.ruid"), Env.Get("eos.rgid"), Env.Get("eos.app")
+  };
+  std::string key;
+
+  for (const char* field : fields) {
+    if (field) {
+      key += field;
+    }
+
+    key += '\n';
+  }
+
+  VirtualIdentity mapped;
+  std::string mytident;
+  time_t now = time(NULL);
+  bool refresh_active = true;
+
+  if (!gIdCache.Get(key, gMapGeneration.load(), now, mapped, mytident,
+                    refresh_active)) {
+    RWMutexReadLock lock(gMapMutex);
+    uint64_t generation = gMapGeneration.load();
+    XrdOucString reduced;
+    ComputeIdMap(client, Env, tident, mapped, reduced);
+    mytident = reduced.c_str();
+    gIdCache.Put(key, generation, now, mapped, mytident);
+  }
+
+  // ---------------------------------------------------------------------------
+  // take over the mapped identity - the fields the mapping does not always
+  // set keep the values the caller might have given
+  // ---------------------------------------------------------------------------
+  vid.uid = mapped.uid;
+  vid.gid = mapped.gid;
+  vid.uid_string = mapped.uid_string;
+  vid.gid_string = mapped.gid_string;
+  vid.uid_list = mapped.uid_list;
+  vid.gid_list = mapped.gid_list;
+  vid.tident = mapped.tident;
+  vid.name = mapped.name;
+  vid.prot = mapped.prot;
+  vid.host = mapped.host;
+  vid.domain = mapped.domain;
+  vid.sudoer = mapped.sudoer;
+
+  if (mapped.grps.length()) {
+    vid.grps = mapped.grps;
+  }
+
+  if (mapped.role.length()) {
+    vid.role = mapped.role;
+  }
+
+  if (mapped.app.length()) {
+    vid.app = mapped.app;
+  }
+
+  // a geo location set externally has precedence
+  if (!vid.geolocation.length()) {
+    vid.geolocation = mapped.geolocation;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Maintain the active client map and expire old entries - at most once per
+  // second for a session
+  // ---------------------------------------------------------------------------
+  if (refresh_active) {
+    ActiveLock.Lock();
+
+    // -------------------------------------------------------------------------
+    // safty measures not to exceed memory by 'nasty' clients
+    // -------------------------------------------------------------------------
+    if (ActiveTidents.size() > 25000) {
+      ActiveExpire();
+    }
+
+    if (ActiveTidents.size() < 60000) {
+      char actident[1024];
+      snprintf(actident, sizeof(actident) - 1, "%d^%s^%s^%s^%s", vid.uid,
+               mytident.c_str(), vid.prot.c_str(), vid.host.c_str(), vid.app.c_str());
+      std::string intident = actident;
+      ActiveTidents[intident] = now;
+    }
+
+    ActiveLock.UnLock();
+  }
+
+  if (log) {
+    eos_static_info("%s sec.tident=\"%s\"", eos::common::SecEntity::ToString(client,
+                    Env.Get("eos.app")).c_str(), tident);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+/**
+ * Compute the virtual identity of a client from the mapping rules
+ *
+ * @param client xrootd client authenticatino object
+ * @param Env opaque information containing role selection like 'eos.ruid' and 'eos.rgid'
+ * @param tident trace identifier of the client
+ * @param vid returned virtual identity
+ * @param mytident returned reduced trace identifier
+ */
+
+/*----------------------------------------------------------------------------*/
+void
+Mapping::ComputeIdMap(const XrdSecEntity* client, XrdOucEnv& Env,
+                      const char* tident, Mapping::VirtualIdentity& vid,
+                      XrdOucString& mytident)
+{
   // you first are 'nobody'
   Nobody(vid);
-  XrdOucEnv Env(env);
   vid.name = client->name;
   vid.tident = tident;
   vid.sudoer = false;
@@ -191,7 +309,6 @@ Mapping::IdMap(const XrdSecEntity* client, const char* env, const char* tident,
   XrdOucString groupalias = useralias;
   useralias += "uid";
   groupalias += "gid";
-  RWMutexReadLock lock(gMapMutex);
   vid.prot = client->prot;
 
   // ---------------------------------------------------------------------------
@@ -430,7 +547,7 @@ Mapping::IdMap(const XrdSecEntity* client, const char* env, const char* tident,
   // ---------------------------------------------------------------------------
   // tident mapping
   // ---------------------------------------------------------------------------
-  XrdOucString mytident = "";
+  mytident = "";
   XrdOucString myrole = "";
   XrdOucString wildcardtident = "";
   XrdOucString host = "";
@@ -812,8 +929,6 @@ Mapping::IdMap(const XrdSecEntity* client, const char* env, const char* tident,
     vid.app = rapp.c_str();
   }
 
-  time_t now = time(NULL);
-
   // ---------------------------------------------------------------------------
   // Check the Geo Location
   // ---------------------------------------------------------------------------
@@ -849,34 +964,8 @@ Mapping::IdMap(const XrdSecEntity* client, const char* env, const char* tident,
     }
   }
 
-  // ---------------------------------------------------------------------------
-  // Maintain the active client map and expire old entries
-  // ---------------------------------------------------------------------------
-  ActiveLock.Lock();
-
-  // ---------------------------------------------------------------------------
-  // safty measures not to exceed memory by 'nasty' clients
-  // ---------------------------------------------------------------------------
-  if (ActiveTidents.size() > 25000) {
-    ActiveExpire();
-  }
-
-  if (ActiveTidents.size() < 60000) {
-    char actident[1024];
-    snprintf(actident, sizeof(actident) - 1, "%d^%s^%s^%s^%s", vid.uid,
-             mytident.c_str(), vid.prot.c_str(), vid.host.c_str(), vid.app.c_str());
-    std::string intident = actident;
-    ActiveTidents[intident] = now;
-  }
-
-  ActiveLock.UnLock();
   eos_static_debug("selected %d %d [%s %s]", vid.uid, vid.gid, ruid.c_str(),
                    rgid.c_str());
-
-  if (log) {
-    eos_static_info("%s sec.tident=\"%s\"", eos::common::SecEntity::ToString(client,
-                    Env.Get("eos.app")).c_str(), tident);
-  }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -1575,6 +1664,76 @@ Mapping::ip_cache::GetIp(const char* hostname)
   }
 }
 
+// -----------------------------------------------------------------------------
+//! Get a cached identity
+// -----------------------------------------------------------------------------
+bool
+Mapping::id_cache::Get(const std::string& key, uint64_t generation, time_t now,
+                       VirtualIdentity& vid, std::string& tident,
+                       bool& refresh_active)
+{
+  shard_t& shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mMutex);
+  auto it = shard.mEntries.find(key);
+
+  if ((it == shard.mEntries.end()) || (it->second.generation != generation) ||
+      (it->second.expires <= now)) {
+    return false;
+  }
+
+  vid = it->second.vid;
+  tident = it->second.tident;
+  refresh_active = (it->second.active != now);
+  it->second.active = now;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//! Store an identity
+// -----------------------------------------------------------------------------
+void
+Mapping::id_cache::Put(const std::string& key, uint64_t generation, time_t now,
+                       const VirtualIdentity& vid, const std::string& tident)
+{
+  shard_t& shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mMutex);
+
+  if (shard.mEntries.size() >= mMaxShardEntries) {
+    // drop the outdated entries and everything if this is not enough to
+    // protect the memory from 'nasty' clients
+    for (auto it = shard.mEntries.begin(); it != shard.mEntries.end();) {
+      if ((it->second.generation != generation) || (it->second.expires <= now)) {
+        it = shard.mEntries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    if (shard.mEntries.size() >= mMaxShardEntries) {
+      shard.mEntries.clear();
+    }
+  }
+
+  entry_t& entry = shard.mEntries[key];
+  entry.vid = vid;
+  entry.tident = tident;
+  entry.generation = generation;
+  entry.expires = now + mLifeTime;
+  entry.active = now;
+}
+
+// -----------------------------------------------------------------------------
+//! Drop all cached identities
+// -----------------------------------------------------------------------------
+void
+Mapping::id_cache::Clear()
+{
+  for (size_t i = 0; i < sNumShards; ++i) {
+    std::lock_guard<std::mutex> lock(mShards[i].mMutex);
+    mShards[i].mEntries.clear();
+  }
+}
+
 // -----------------------------------------------------------------------------
 //! Convert a komma separated uid string to a vector uid list
 // -----------------------------------------------------------------------------
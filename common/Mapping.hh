@@ -39,15 +39,19 @@
 #include "XrdOuc/XrdOucString.hh"
 #include "XrdOuc/XrdOucHash.hh"
 /*----------------------------------------------------------------------------*/
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <set>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <google/dense_hash_map>
 
 /*----------------------------------------------------------------------------*/
 
 class XrdSecEntity;
+class XrdOucEnv;
 
 EOSCOMMONNAMESPACE_BEGIN
 
@@ -166,6 +170,61 @@ public:
   //----------------------------------------------------------------------------
   typedef struct VirtualIdentity_t VirtualIdentity;
 
+  // ---------------------------------------------------------------------------
+  //! Cache of the identities computed by IdMap for the client sessions. An
+  //! entry is only valid for the generation of the mapping rules it was
+  //! computed with and expires after its lifetime to follow changes of the
+  //! password database.
+  // ---------------------------------------------------------------------------
+  class id_cache
+  {
+  public:
+    // Cached identity
+    struct entry_t {
+      VirtualIdentity vid;
+      std::string tident; //< reduced tident of the session
+      uint64_t generation; //< generation of the mapping rules
+      time_t expires;
+      time_t active; //< last update of the active tident map
+    };
+
+    // Constructor
+    id_cache(int lifetime = 300, size_t max_entries = 65536):
+      mLifeTime(lifetime), mMaxShardEntries(max_entries / sNumShards + 1) {}
+
+    // Destructor
+    virtual ~id_cache() {}
+
+    // Get a valid identity, refresh_active tells if the active tident map is
+    // due for an update
+    bool Get(const std::string& key, uint64_t generation, time_t now,
+             VirtualIdentity& vid, std::string& tident, bool& refresh_active);
+
+    // Store an identity
+    void Put(const std::string& key, uint64_t generation, time_t now,
+             const VirtualIdentity& vid, const std::string& tident);
+
+    // Drop all entries
+    void Clear();
+
+  private:
+    static constexpr size_t sNumShards = 32;
+
+    struct shard_t {
+      std::mutex mMutex;
+      std::unordered_map<std::string, entry_t> mEntries;
+    };
+
+    shard_t mShards[sNumShards];
+    int mLifeTime;
+    size_t mMaxShardEntries;
+
+    shard_t& GetShard(const std::string& key)
+    {
+      return mShards[std::hash<std::string>()(key) % sNumShards];
+    }
+  };
+
   //----------------------------------------------------------------------------
   //! Function creating the Nobody identity
   //----------------------------------------------------------------------------
@@ -292,6 +351,25 @@ public:
   // ---------------------------------------------------------------------------
   static ip_cache gIpCache;
 
+  // ---------------------------------------------------------------------------
+  //! Cache of the identities computed by IdMap
+  // ---------------------------------------------------------------------------
+  static id_cache gIdCache;
+
+  // ---------------------------------------------------------------------------
+  //! Generation of the mapping rules, incremented by InvalidateIdCache
+  // ---------------------------------------------------------------------------
+  static std::atomic<uint64_t> gMapGeneration;
+
+  // ---------------------------------------------------------------------------
+  //! Invalidate the identities cached by IdMap - to be called with gMapMutex
+  //! write-locked whenever the mapping rules change
+  // ---------------------------------------------------------------------------
+  static void InvalidateIdCache()
+  {
+    ++gMapGeneration;
+  }
+
   // ---------------------------------------------------------------------------
   //! Function to expire unused ActiveTident entries by default after 1 day
   // ---------------------------------------------------------------------------
@@ -397,6 +475,20 @@ public:
   // ---------------------------------------------------------------------------
   static std::string GidAsString(gid_t gid);
 
+private:
+  // ---------------------------------------------------------------------------
+  //! Compute the virtual identity of a client from the mapping rules - the
+  //! caller has to hold gMapMutex in read mode
+  //!
+  //! @param client authentication information
+  //! @param env opaque information of the request
+  //! @param tident trace identifier of the client
+  //! @param vid computed identity, has to be a new identity
+  //! @param mytident reduced trace identifier
+  // ---------------------------------------------------------------------------
+  static void ComputeIdMap(const XrdSecEntity* client, XrdOucEnv& env,
+                           const char* tident, VirtualIdentity& vid,
+                           XrdOucString& mytident);
 };
 
 /*----------------------------------------------------------------------------*/
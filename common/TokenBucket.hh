@@ -0,0 +1,166 @@
+//------------------------------------------------------------------------------
+//! @file TokenBucket.hh
+//! @brief Thread-safe token bucket rate limiter
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#pragma once
+#include "common/Namespace.hh"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+EOSCOMMONNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Token bucket refilled at a given rate up to a burst capacity. Consumers
+//! take tokens up front and may drive the bucket into debt - the debt is
+//! the time they have to wait before using what they took. This keeps the
+//! long term rate exact for any request size and never blocks inside the
+//! bucket, so one bucket can be shared by many threads.
+//!
+//! A rate of 0 means unlimited.
+//------------------------------------------------------------------------------
+class TokenBucket
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param rate tokens per second, 0 for unlimited
+  //! @param burst capacity of the bucket, 0 for one second worth of tokens
+  //----------------------------------------------------------------------------
+  TokenBucket(double rate = 0, double burst = 0):
+    mRate(0), mBurst(0), mTokens(0), mLast(Clock::now())
+  {
+    SetRate(rate, burst);
+    mTokens = mBurst;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Change the rate - the tokens accumulated so far are kept up to the new
+  //! capacity
+  //!
+  //! @param rate tokens per second, 0 for unlimited
+  //! @param burst capacity of the bucket, 0 for one second worth of tokens
+  //! @param now current time
+  //----------------------------------------------------------------------------
+  void SetRate(double rate, double burst = 0, Clock::time_point now = Clock::now())
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Refill(now);
+    mRate = std::max(rate, 0.0);
+    mBurst = (burst > 0) ? burst : mRate;
+    mTokens = std::min(mTokens, mBurst);
+  }
+
+  double GetRate()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRate;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take tokens from the bucket
+  //!
+  //! @param tokens number of tokens
+  //! @param now current time
+  //!
+  //! @return time to wait before using the tokens, zero if they were there
+  //----------------------------------------------------------------------------
+  Clock::duration Consume(double tokens, Clock::time_point now = Clock::now())
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mRate) {
+      return Clock::duration::zero();
+    }
+
+    Refill(now);
+    mTokens -= tokens;
+
+    if (mTokens >= 0) {
+      return Clock::duration::zero();
+    }
+
+    return std::chrono::duration_cast<Clock::duration>
+           (std::chrono::duration<double>(-mTokens / mRate));
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take tokens only if they are available right now
+  //!
+  //! @return true if the tokens were taken
+  //----------------------------------------------------------------------------
+  bool TryConsume(double tokens, Clock::time_point now = Clock::now())
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mRate) {
+      return true;
+    }
+
+    Refill(now);
+
+    if (mTokens < tokens) {
+      return false;
+    }
+
+    mTokens -= tokens;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take tokens and sleep until they may be used
+  //----------------------------------------------------------------------------
+  void Acquire(double tokens)
+  {
+    Clock::duration wait = Consume(tokens);
+
+    if (wait > Clock::duration::zero()) {
+      std::this_thread::sleep_for(wait);
+    }
+  }
+
+private:
+  std::mutex mMutex;
+  double mRate; ///< tokens per second
+  double mBurst; ///< capacity
+  double mTokens; ///< available tokens, negative while in debt
+  Clock::time_point mLast; ///< time of the last refill
+
+  //----------------------------------------------------------------------------
+  //! Add the tokens accumulated since the last refill - called with the
+  //! mutex held
+  //----------------------------------------------------------------------------
+  void Refill(Clock::time_point now)
+  {
+    if (now > mLast) {
+      std::chrono::duration<double> elapsed = now - mLast;
+      mTokens = std::min(mBurst, mTokens + elapsed.count() * mRate);
+      mLast = now;
+    }
+  }
+};
+
+EOSCOMMONNAMESPACE_END
@@ -298,4 +298,81 @@ uint32_t crc32cHardware64(uint32_t crc, const void* data, size_t length)
 #endif
 }
 
+// Multiply the 32x32 GF(2) matrix mat with the vector vec
+static uint32_t gf2MatrixTimes(const uint32_t* mat, uint32_t vec)
+{
+  uint32_t sum = 0;
+
+  while (vec) {
+    if (vec & 1) {
+      sum ^= *mat;
+    }
+
+    vec >>= 1;
+    mat++;
+  }
+
+  return sum;
+}
+
+// Compute square = mat * mat
+static void gf2MatrixSquare(uint32_t* square, const uint32_t* mat)
+{
+  for (int n = 0; n < 32; n++) {
+    square[n] = gf2MatrixTimes(mat, mat[n]);
+  }
+}
+
+// Same algorithm as zlib's crc32_combine, using the reflected CRC32-C
+// polynomial. Applying len2 zero bytes to crc1 is done by repeated squaring
+// of the "one zero bit" operator, hence the cost is O(log(len2)).
+uint32_t crc32cCombine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+  uint32_t even[32]; // even-power-of-two zeros operator
+  uint32_t odd[32]; // odd-power-of-two zeros operator
+
+  if (len2 == 0) {
+    return crc1;
+  }
+
+  // Operator for one zero bit in odd
+  odd[0] = 0x82F63B78;
+  uint32_t row = 1;
+
+  for (int n = 1; n < 32; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+
+  // Operator for two zero bits in even and for four zero bits in odd
+  gf2MatrixSquare(even, odd);
+  gf2MatrixSquare(odd, even);
+
+  // Apply len2 zeros to crc1, the first square puts the operator for one
+  // zero byte (eight zero bits) in even
+  do {
+    gf2MatrixSquare(even, odd);
+
+    if (len2 & 1) {
+      crc1 = gf2MatrixTimes(even, crc1);
+    }
+
+    len2 >>= 1;
+
+    if (len2 == 0) {
+      break;
+    }
+
+    gf2MatrixSquare(odd, even);
+
+    if (len2 & 1) {
+      crc1 = gf2MatrixTimes(odd, crc1);
+    }
+
+    len2 >>= 1;
+  } while (len2 != 0);
+
+  return crc1 ^ crc2;
+}
+
 }  // namespace checksum
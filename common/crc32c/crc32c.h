@@ -36,6 +36,14 @@ static inline uint32_t crc32cFinish(uint32_t crc)
   return ~crc;
 }
 
+/** Combines the final CRC32-C values of two consecutive blocks of data.
+@arg crc1 final CRC32-C of the first block.
+@arg crc2 final CRC32-C of the second block.
+@arg len2 length of the second block in bytes.
+@return final CRC32-C of the concatenation of the two blocks.
+*/
+uint32_t crc32cCombine(uint32_t crc1, uint32_t crc2, size_t len2);
+
 uint32_t crc32cSarwate(uint32_t crc, const void* data, size_t length);
 uint32_t crc32cSlicingBy4(uint32_t crc, const void* data, size_t length);
 uint32_t crc32cSlicingBy8(uint32_t crc, const void* data, size_t length);
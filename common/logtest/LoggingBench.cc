@@ -0,0 +1,103 @@
+// ----------------------------------------------------------------------
+// File: LoggingBench.cc
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2017 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//----------------------------------------------------------------------------
+// Program measuring the logging throughput in messages per second with a
+// given number of threads, in synchronous and asynchronous mode. The log
+// output goes to stderr, which should be redirected e.g. to /dev/null.
+//
+// Usage: eos-logging-bench [num_threads] [msgs_per_thread]
+//----------------------------------------------------------------------------
+#include "common/Logging.hh"
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace eos::common;
+
+//----------------------------------------------------------------------------
+//! Log the given number of messages from each of the threads
+//!
+//! @return number of messages per second
+//----------------------------------------------------------------------------
+double
+RunBenchmark(unsigned int num_threads, unsigned long msgs_per_thread)
+{
+  Logging& g_logging = Logging::GetInstance();
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&g_logging, t, msgs_per_thread]() {
+      for (unsigned long i = 0; i < msgs_per_thread; ++i) {
+        g_logging.log("RunBenchmark", __FILE__, __LINE__, "logid:bench",
+                      Logging::gZeroVid, "", LOG_INFO,
+                      "msg=\"benchmark message\" thread=%u count=%lu", t, i);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  g_logging.Flush();
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>
+                  (std::chrono::steady_clock::now() - start).count();
+  return (1e6 * num_threads * msgs_per_thread) / (duration ? duration : 1);
+}
+
+int
+main(int argc, char* argv[])
+{
+  unsigned int num_threads = 8;
+  unsigned long msgs_per_thread = 100000;
+
+  if (argc > 1) {
+    num_threads = std::stoul(argv[1]);
+  }
+
+  if (argc > 2) {
+    msgs_per_thread = std::stoul(argv[2]);
+  }
+
+  Logging& g_logging = Logging::GetInstance();
+  g_logging.SetUnit("bench");
+  g_logging.SetLogPriority(LOG_INFO);
+
+  for (unsigned int nthreads = 1; nthreads <= num_threads; nthreads *= 2) {
+    g_logging.SetAsync(false);
+    double sync_rate = RunBenchmark(nthreads, msgs_per_thread);
+    g_logging.SetAsync(true);
+    unsigned long long dropped = g_logging.gDroppedMessages;
+    double async_rate = RunBenchmark(nthreads, msgs_per_thread);
+    dropped = g_logging.gDroppedMessages - dropped;
+    std::cout << "threads=" << nthreads
+              << " sync_msgs_per_sec=" << (unsigned long long) sync_rate
+              << " async_msgs_per_sec=" << (unsigned long long) async_rate
+              << " async_dropped=" << dropped << std::endl;
+  }
+
+  g_logging.SetAsync(false);
+  return 0;
+}
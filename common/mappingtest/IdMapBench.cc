@@ -0,0 +1,126 @@
+// ----------------------------------------------------------------------
+// File: IdMapBench.cc
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//----------------------------------------------------------------------------
+// Program measuring the number of Mapping::IdMap calls per second with a
+// given number of threads. Each thread maps the requests of a few client
+// sessions, which are served from the identity cache after the first call,
+// and in a second run every request comes from a new session, which always
+// goes through the mapping rules.
+//
+// Usage: eos-idmap-bench [num_threads] [calls_per_thread]
+//----------------------------------------------------------------------------
+#include "common/Mapping.hh"
+#include "XrdSec/XrdSecEntity.hh"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace eos::common;
+
+//----------------------------------------------------------------------------
+//! Map the given number of requests from each of the threads
+//!
+//! @param new_sessions if true every request uses a new trace identifier
+//!
+//! @return number of IdMap calls per second
+//----------------------------------------------------------------------------
+double
+RunBenchmark(unsigned int num_threads, unsigned long calls_per_thread,
+             bool new_sessions)
+{
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([t, calls_per_thread, new_sessions]() {
+      static const char* protocols[] = {"sss", "krb5", "unix", "gsi"};
+      XrdSecEntity client(protocols[t % 4]);
+      std::string name = "user" + std::to_string(t);
+      std::string host = "client" + std::to_string(t) + ".cern.ch";
+      client.name = (char*) name.c_str();
+      client.host = (char*) host.c_str();
+      Mapping::VirtualIdentity vid;
+
+      for (unsigned long i = 0; i < calls_per_thread; ++i) {
+        unsigned long session = new_sessions ? i : (i % 8);
+        std::string tident = name + "." + std::to_string(session) + ":" +
+                             std::to_string(t) + "@" + host;
+        Mapping::IdMap(&client, "eos.app=bench", tident.c_str(), vid, false);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>
+                  (std::chrono::steady_clock::now() - start).count();
+  return (1e6 * num_threads * calls_per_thread) / (duration ? duration : 1);
+}
+
+int
+main(int argc, char* argv[])
+{
+  unsigned int num_threads = 16;
+  unsigned long calls_per_thread = 100000;
+
+  if (argc > 1) {
+    num_threads = std::stoul(argv[1]);
+  }
+
+  if (argc > 2) {
+    calls_per_thread = std::stoul(argv[2]);
+  }
+
+  Mapping::Init();
+  {
+    // a typical set of rules: forced protocol mappings and gateway rules
+    RWMutexWriteLock lock(Mapping::gMapMutex);
+    Mapping::gVirtualUidMap["sss:\"<pwd>\":uid"] = 1000;
+    Mapping::gVirtualGidMap["sss:\"<pwd>\":gid"] = 1000;
+    Mapping::gVirtualUidMap["unix:\"<pwd>\":uid"] = 1001;
+    Mapping::gVirtualGidMap["unix:\"<pwd>\":gid"] = 1001;
+
+    for (int i = 0; i < 100; ++i) {
+      std::string gw = "tident:\"*@gateway" + std::to_string(i) + ".cern.ch\":";
+      Mapping::gVirtualUidMap[gw + "uid"] = 0;
+      Mapping::gVirtualGidMap[gw + "gid"] = 0;
+    }
+
+    Mapping::InvalidateIdCache();
+  }
+
+  for (unsigned int nthreads = 1; nthreads <= num_threads; nthreads *= 2) {
+    double cached_rate = RunBenchmark(nthreads, calls_per_thread, false);
+    double uncached_rate = RunBenchmark(nthreads, calls_per_thread, true);
+    std::cout << "threads=" << nthreads
+              << " cached_calls_per_sec=" << (unsigned long long) cached_rate
+              << " uncached_calls_per_sec=" << (unsigned long long) uncached_rate
+              << std::endl;
+  }
+
+  return 0;
+}
@@ -28,13 +28,19 @@
 #include "fst/checksum/ChecksumPlugins.hh"
 #include "fst/io/FileIoPluginCommon.hh"
 #include "XrdCl/XrdClFileSystem.hh"
+#include "XrdCl/XrdClFile.hh"
 #include "namespace/utils/StringConvertion.hh"
+#include "common/SymKeys.hh"
+#include <google/protobuf/io/coded_stream.h>
 #include <stdio.h>
 #include <sys/mman.h>
 #include <fts.h>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <future>
+#include <limits>
 #include "namespace/ns_quarkdb/persistency/FileMDSvc.hh"
 #include "namespace/ns_quarkdb/accounting/FileSystemView.hh"
 
@@ -81,6 +87,201 @@ FmdDbMapHandler::EnvMgmToFmd(XrdOucEnv& env, struct Fmd& fmd)
   return true;
 }
 
+//------------------------------------------------------------------------------
+// Convert an entry of the MGM dumpmd stream to an Fmd struct
+//------------------------------------------------------------------------------
+bool
+FmdDbMapHandler::DumpMgmToFmd(const eos::console::FileMdDumpProto& entry,
+                              struct Fmd& fmd)
+{
+  if (!entry.fid()) {
+    return false;
+  }
+
+  fmd.set_fid(entry.fid());
+  fmd.set_cid(entry.cid());
+  fmd.set_ctime(entry.ctime());
+  fmd.set_ctime_ns(entry.ctimens());
+  fmd.set_mtime(entry.mtime());
+  fmd.set_mtime_ns(entry.mtimens());
+  fmd.set_mgmsize(entry.size());
+  fmd.set_lid(entry.lid());
+  fmd.set_uid(entry.uid());
+  fmd.set_gid(entry.gid());
+  // Same representation as the env dump
+  fmd.set_mgmchecksum(entry.checksum().empty() ? "none" : entry.checksum());
+  std::string locations;
+  char loc[16];
+
+  for (const auto& fsid : entry.locations()) {
+    snprintf(loc, sizeof(loc), "%u,", fsid);
+    locations += loc;
+  }
+
+  for (const auto& fsid : entry.unlinkedlocations()) {
+    snprintf(loc, sizeof(loc), "!%u,", fsid);
+    locations += loc;
+  }
+
+  fmd.set_locations(locations);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Append a chunk of the dumpmd output
+//------------------------------------------------------------------------------
+void
+DumpmdDecoder::Feed(const char* data, size_t length)
+{
+  // Keep only the part which is not decoded yet
+  mPending.erase(0, mPos);
+  mPos = 0;
+  mPending.append(data, length);
+}
+
+//------------------------------------------------------------------------------
+// Decode the complete entries of the output appended so far
+//------------------------------------------------------------------------------
+bool
+DumpmdDecoder::Decode(std::vector<Fmd>& fmds, size_t max_entries)
+{
+  if (mFormat == Format::kUnknown) {
+    size_t tag_len = strlen(EOS_DUMPMD_STREAM_TAG);
+
+    if (mPending.length() - mPos < tag_len) {
+      // The output of older MGMs can be shorter than the tag
+      if (mPending.find('\n', mPos) == std::string::npos) {
+        return true;
+      }
+
+      mFormat = Format::kEnv;
+    } else if (mPending.compare(mPos, tag_len, EOS_DUMPMD_STREAM_TAG) == 0) {
+      mFormat = Format::kStream;
+      mPos += tag_len;
+    } else {
+      mFormat = Format::kEnv;
+    }
+  }
+
+  size_t max_size = fmds.size() + max_entries;
+
+  if (mFormat == Format::kEnv) {
+    size_t pos;
+
+    while ((fmds.size() < max_size) &&
+           ((pos = mPending.find('\n', mPos)) != std::string::npos)) {
+      DecodeEnvLine(mPending.substr(mPos, pos - mPos), fmds);
+      mPos = pos + 1;
+    }
+
+    return true;
+  }
+
+  eos::console::FileMdDumpProto entry;
+
+  while ((fmds.size() < max_size) && (mPos < mPending.length())) {
+    if (mEnd) {
+      eos_static_err("msg=\"unexpected data after the end of the dumpmd "
+                     "output\"");
+      return false;
+    }
+
+    google::protobuf::io::CodedInputStream input(
+      (const uint8_t*) mPending.data() + mPos, mPending.length() - mPos);
+    uint32_t length = 0;
+
+    if (!input.ReadVarint32(&length)) {
+      // Either an incomplete length or a corrupted one
+      if (mPending.length() - mPos >= 5) {
+        eos_static_err("msg=\"invalid record length in dumpmd output\"");
+        return false;
+      }
+
+      break;
+    }
+
+    if (length == 0) {
+      mEnd = true;
+      mPos += input.CurrentPosition();
+      continue;
+    }
+
+    if ((size_t) input.CurrentPosition() + length > mPending.length() - mPos) {
+      // Incomplete record, wait for more output
+      break;
+    }
+
+    entry.Clear();
+
+    if (!entry.ParseFromArray(mPending.data() + mPos + input.CurrentPosition(),
+                              length)) {
+      eos_static_err("msg=\"failed to parse dumpmd record\" length=%u", length);
+      return false;
+    }
+
+    mPos += input.CurrentPosition() + length;
+    fmds.emplace_back();
+    FmdHelper::Reset(fmds.back());
+
+    if (!FmdDbMapHandler::DumpMgmToFmd(entry, fmds.back())) {
+      eos_static_err("msg=\"failed to convert dumpmd record\" fid=%llu",
+                     (unsigned long long) entry.fid());
+      fmds.pop_back();
+      ++mNumFailed;
+    }
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Decode the rest of the output once all of it was appended
+//------------------------------------------------------------------------------
+bool
+DumpmdDecoder::Finish(std::vector<Fmd>& fmds)
+{
+  if (!Decode(fmds, std::numeric_limits<size_t>::max())) {
+    return false;
+  }
+
+  if (mFormat == Format::kStream) {
+    if (!mEnd || (mPos != mPending.length())) {
+      eos_static_err("msg=\"truncated dumpmd output\" end=%d pending=%llu",
+                     mEnd, (unsigned long long)(mPending.length() - mPos));
+      return false;
+    }
+  } else if (mPos < mPending.length()) {
+    // Last line without a new line
+    DecodeEnvLine(mPending.substr(mPos), fmds);
+  }
+
+  mPending.clear();
+  mPos = 0;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Decode an env line
+//------------------------------------------------------------------------------
+void
+DumpmdDecoder::DecodeEnvLine(const std::string& line, std::vector<Fmd>& fmds)
+{
+  if (line.empty()) {
+    return;
+  }
+
+  XrdOucEnv env(line.c_str());
+  fmds.emplace_back();
+  FmdHelper::Reset(fmds.back());
+
+  if (!FmdDbMapHandler::EnvMgmToFmd(env, fmds.back())) {
+    eos_static_err("msg=\"failed to convert dumpmd line\" line=\"%s\"",
+                   line.substr(0, 256).c_str());
+    fmds.pop_back();
+    ++mNumFailed;
+  }
+}
+
 //----------------------------------------------------------------------------
 // Convert namespace file metadata to an Fmd struct
 //----------------------------------------------------------------------------
@@ -799,6 +1000,102 @@ FmdDbMapHandler::UpdateFromMgm(eos::common::FileSystem::fsid_t fsid,
   }
 }
 
+//------------------------------------------------------------------------------
+// Update a batch of fmd entries from MGM metadata
+//------------------------------------------------------------------------------
+uint64_t
+FmdDbMapHandler::UpdateFromMgm(eos::common::FileSystem::fsid_t fsid,
+                               const std::vector<Fmd>& batch)
+{
+  eos::common::RWMutexReadLock lock(mMapMutex);
+  FsWriteLock wlock(fsid);
+
+  if (!mDbMap.count(fsid)) {
+    eos_crit("no %s DB open for fsid=%llu", eos::common::DbMap::getDbType().c_str(),
+             (unsigned long) fsid);
+    return 0;
+  }
+
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  eos::common::DbMap* db = mDbMap[fsid];
+  unsigned long cpt = 0;
+  db->beginSetSequence();
+
+  for (const auto& mgmfmd : batch) {
+    eos::common::FileId::fileid_t fid = mgmfmd.fid();
+    Fmd valfmd;
+
+    if (!fid) {
+      eos_info("skipping to insert a file with fid 0");
+      continue;
+    }
+
+    if (LocalExistFmd(fid, fsid)) {
+      valfmd = LocalRetrieveFmd(fid, fsid);
+
+      if ((valfmd.fid() != fid) || (valfmd.fsid() != fsid)) {
+        eos_crit("unable to get fmd for fid %llu on fs %lu - id mismatch in "
+                 "meta data block fid=%llu fsid=%lu", fid, (unsigned long) fsid,
+                 valfmd.fid(), (unsigned long) valfmd.fsid());
+        continue;
+      }
+    } else {
+      // Same as a record created by LocalGetFmd
+      valfmd.set_fid(fid);
+      valfmd.set_fsid(fsid);
+      valfmd.set_atime(tv.tv_sec);
+      valfmd.set_atime_ns(tv.tv_usec * 1000);
+    }
+
+    int layouterror = FmdHelper::LayoutError(mgmfmd, fsid);
+
+    // Check if it exists on disk
+    if (valfmd.disksize() == 0xfffffffffff1ULL) {
+      layouterror |= LayoutId::kMissing;
+      eos_warning("found missing replica for fid=%08llx on fsid=%lu", fid,
+                  (unsigned long) fsid);
+    }
+
+    // Truncate the checksum to the right string length
+    size_t cslen = LayoutId::GetChecksumLen(mgmfmd.lid()) * 2;
+    std::string checksum = mgmfmd.mgmchecksum().substr(0, cslen);
+    valfmd.set_mgmsize(mgmfmd.mgmsize());
+    valfmd.set_size(mgmfmd.mgmsize());
+    valfmd.set_checksum(checksum);
+    valfmd.set_mgmchecksum(checksum);
+    valfmd.set_cid(mgmfmd.cid());
+    valfmd.set_lid(mgmfmd.lid());
+    valfmd.set_uid(mgmfmd.uid());
+    valfmd.set_gid(mgmfmd.gid());
+    valfmd.set_ctime(mgmfmd.ctime());
+    valfmd.set_ctime_ns(mgmfmd.ctime_ns());
+    valfmd.set_mtime(mgmfmd.mtime());
+    valfmd.set_mtime_ns(mgmfmd.mtime_ns());
+    valfmd.set_layouterror(layouterror);
+    valfmd.set_locations(mgmfmd.locations());
+    std::string sval;
+    valfmd.SerializePartialToString(&sval);
+
+    if (db->set(eos::common::Slice((const char*)&fid, sizeof(fid)), sval,
+                "") < 0) {
+      eos_err("failed to update fid=%08llx on fsid=%lu", fid,
+              (unsigned long) fsid);
+    } else {
+      ++cpt;
+    }
+  }
+
+  // The endSetSequence makes it impossible to know which key is faulty
+  if (db->endSetSequence() != cpt) {
+    eos_err("unable to commit batch of %lu entries for fsid=%lu", cpt,
+            (unsigned long) fsid);
+    return 0;
+  }
+
+  return cpt;
+}
+
 //------------------------------------------------------------------------------
 // Reset disk information
 //------------------------------------------------------------------------------
@@ -1147,68 +1444,121 @@ bool
 FmdDbMapHandler::ResyncAllMgm(eos::common::FileSystem::fsid_t fsid,
                               const char* manager)
 {
+  // Small enough not to hold the file system lock for long in one commit
+  static const size_t sBatchSize = 1000;
+  static const uint32_t sChunkSize = 4 * 1024 * 1024;
+
   if (!ResetMgmInformation(fsid)) {
     eos_err("failed to reset the mgm information before resyncing");
     return false;
   }
 
-  std::string tmpfile;
+  uint64_t dump_size = 0;
+  std::unique_ptr<XrdCl::File> file = ExecuteDumpmd(manager, fsid, dump_size);
 
-  if (!ExecuteDumpmd(manager, fsid, tmpfile)) {
+  if (!file) {
     return false;
   }
 
-  // Parse the result and unlink temporary file
-  std::ifstream inFile(tmpfile);
-  std::string dumpentry;
-  unlink(tmpfile.c_str());
+  // Decode the output while it is read from the MGM
+  DumpmdDecoder decoder;
+  std::unique_ptr<char[]> buffer(new char[sChunkSize]);
+  uint64_t offset = 0;
   unsigned long long cnt = 0;
+  unsigned long long committed = 0;
+  std::vector<Fmd> batch;
+  std::future<uint64_t> pending;
+  auto start = std::chrono::steady_clock::now();
+  auto last_report = start;
+  // Commit a batch in the background while the next one is decoded
+  auto commit = [&]() {
+    if (pending.valid()) {
+      committed += pending.get();
+    }
 
-  while (std::getline(inFile, dumpentry)) {
-    cnt++;
-    eos_debug("line=%s", dumpentry.c_str());
-    std::unique_ptr<XrdOucEnv> env(new XrdOucEnv(dumpentry.c_str()));
-
-    if (env) {
-      struct Fmd fMd;
-      FmdHelper::Reset(fMd);
-
-      if (EnvMgmToFmd(*env, fMd)) {
-        // get/create one
-        FmdHelper* fmd = LocalGetFmd(fMd.fid(), fsid, fMd.uid(), fMd.gid(),
-                                     fMd.lid(), true, true);
-        fMd.set_layouterror(FmdHelper::LayoutError(fMd, fsid));
-
-        if (fmd) {
-          // Check if it exists on disk
-          if (fmd->mProtoFmd.disksize() == 0xfffffffffff1ULL) {
-            fMd.set_layouterror(fMd.layouterror() | LayoutId::kMissing);
-            eos_warning("found missing replica for fid=%08llx on fsid=%lu", fMd.fid(),
-                        (unsigned long) fsid);
-          }
+    if (!batch.empty()) {
+      cnt += batch.size();
+      pending = std::async(std::launch::async, [this, fsid](std::vector<Fmd> fmds) {
+        return UpdateFromMgm(fsid, fmds);
+      }, std::move(batch));
+      batch.clear();
+    }
+  };
+  bool ok = true;
+
+  while (true) {
+    uint32_t nread = 0;
+    XrdCl::XRootDStatus st = file->Read(offset, sChunkSize, buffer.get(), nread);
+
+    if (!st.IsOK()) {
+      eos_err("msg=\"failed to read dumpmd output\" fsid=%lu offset=%llu "
+              "err=\"%s\"", (unsigned long) fsid, (unsigned long long) offset,
+              st.ToStr().c_str());
+      ok = false;
+      break;
+    }
 
-          if (!UpdateFromMgm(fsid, fMd.fid(), fMd.cid(), fMd.lid(), fMd.mgmsize(),
-                             fMd.mgmchecksum(), fMd.uid(), fMd.gid(), fMd.ctime(),
-                             fMd.ctime_ns(), fMd.mtime(), fMd.mtime_ns(),
-                             fMd.layouterror(), fMd.locations())) {
-            eos_err("failed to update fmd %s", dumpentry.c_str());
-          }
+    if (nread == 0) {
+      break;
+    }
 
-          delete fmd;
-        } else {
-          eos_err("failed to get/create fmd %s", dumpentry.c_str());
-        }
-      } else {
-        eos_err("failed to convert %s", dumpentry.c_str());
+    offset += nread;
+    decoder.Feed(buffer.get(), nread);
+
+    do {
+      if (!decoder.Decode(batch, sBatchSize - batch.size())) {
+        ok = false;
+        break;
       }
+
+      if (batch.size() < sBatchSize) {
+        break;
+      }
+
+      commit();
+    } while (true);
+
+    if (!ok) {
+      break;
     }
 
-    if (!(cnt % 10000)) {
-      eos_info("msg=\"synced files so far\" nfiles=%llu fsid=%lu", cnt,
-               (unsigned long) fsid);
+    auto now = std::chrono::steady_clock::now();
+
+    if (now - last_report >= std::chrono::seconds(10)) {
+      double elapsed = std::chrono::duration<double>(now - start).count();
+      eos_info("msg=\"synced files so far\" nfiles=%llu fsid=%lu progress=%.01f%% "
+               "rate=%.01f Hz", cnt, (unsigned long) fsid,
+               100.0 * offset / std::max(dump_size, offset), cnt / elapsed);
+      last_report = now;
     }
   }
 
+  (void) file->Close();
+
+  if (ok && !decoder.Finish(batch)) {
+    ok = false;
+  }
+
+  // Commit the last batch and wait for it
+  commit();
+
+  if (pending.valid()) {
+    committed += pending.get();
+  }
+
+  double elapsed = std::chrono::duration<double>
+                   (std::chrono::steady_clock::now() - start).count();
+
+  if (!ok) {
+    eos_err("msg=\"failed mgm resync\" fsid=%lu nfiles=%llu committed=%llu",
+            (unsigned long) fsid, cnt, committed);
+    return false;
+  }
+
+  eos_info("msg=\"finished mgm resync\" fsid=%lu nfiles=%llu committed=%llu "
+           "failed=%llu duration=%.02fs rate=%.01f Hz", (unsigned long) fsid, cnt,
+           committed, cnt - committed + decoder.GetNumFailed(), elapsed,
+           cnt / std::max(elapsed, 1e-3));
   mIsSyncing[fsid] = false;
   return true;
 }
@@ -1569,67 +1919,64 @@ FmdDbMapHandler::GetNumFiles(eos::common::FileSystem::fsid_t fsid)
 //------------------------------------------------------------------------------
 // Execute "fs dumpmd" on the MGM node
 //------------------------------------------------------------------------------
-bool
+std::unique_ptr<XrdCl::File>
 FmdDbMapHandler::ExecuteDumpmd(const std::string& mgm_host,
                                eos::common::FileSystem::fsid_t fsid,
-                               std::string& fn_output)
+                               uint64_t& size)
 {
-  // Create temporary file used as output for the command
-  char tmpfile[] = "/tmp/efstd.XXXXXX";
-  int tmp_fd = mkstemp(tmpfile);
-
-  if (tmp_fd == -1) {
-    eos_static_err("failed to create a temporary file");
-    return false;
-  }
-
-  (void) close(tmp_fd);
-  fn_output = tmpfile;
   // First try to do the dumpmd using protobuf requests
   using eos::console::FsProto_DumpMdProto;
   eos::console::RequestProto request;
   eos::console::FsProto* fs = request.mutable_fs();
   FsProto_DumpMdProto* dumpmd = fs->mutable_dumpmd();
   dumpmd->set_fsid(fsid);
-  dumpmd->set_display(eos::console::FsProto::DumpMdProto::MONITOR);
+  dumpmd->set_display(eos::console::FsProto::DumpMdProto::STREAM);
   request.set_format(eos::console::RequestProto::FUSE);
   std::string b64buff;
-  std::ostringstream cmd;
+  std::vector<std::string> urls;
+  std::ostringstream url;
 
   if (eos::common::SymKey::ProtobufBase64Encode(&request, b64buff)) {
-    cmd << "env XrdSecPROTOCOL=sss xrdcp -f -s \""
-        << "root://" << mgm_host.c_str() << "/"
-        << "/proc/admin/?mgm.cmd.proto=" << b64buff << "\" "
-        << tmpfile;
-    int rc = system(cmd.str().c_str());
-
-    if (WEXITSTATUS(rc)) {
-      eos_static_err("%s returned %d", cmd.str().c_str(), WEXITSTATUS(rc));
-    } else {
-      eos_static_debug("%s executed successfully", cmd.str().c_str());
-      return true;
-    }
+    url << "root://" << mgm_host << "//proc/admin/?mgm.cmd.proto=" << b64buff;
+    urls.push_back(url.str());
   } else {
     eos_static_err("msg=\"failed to serialize protobuf request for dumpmd\"");
   }
 
-  eos_static_info("msg=\"falling back to classic dumpmd command\"");
-  cmd.str("");
-  cmd.clear();
-  cmd << "env XrdSecPROTOCOL=sss XRD_STREAMTIMEOUT=600 xrdcp -f -s \""
-      << "root://" << mgm_host.c_str() << "/"
-      << "/proc/admin/?&mgm.format=fuse&mgm.cmd=fs&mgm.subcmd=dumpmd&"
-      << "mgm.dumpmd.option=m&mgm.fsid=" << fsid << "\" "
-      << tmpfile;
-  int rc = system(cmd.str().c_str());
+  url.str("");
+  url << "root://" << mgm_host << "//proc/admin/?&mgm.format=fuse&mgm.cmd=fs&"
+      << "mgm.subcmd=dumpmd&mgm.dumpmd.option=m&mgm.fsid=" << fsid;
+  urls.push_back(url.str());
 
-  if (WEXITSTATUS(rc)) {
-    eos_static_err("%s returned %d", cmd.str().c_str(), WEXITSTATUS(rc));
-    return false;
-  } else {
-    eos_static_debug("%s executed successfully", cmd.str().c_str());
-    return true;
+  for (const auto& surl : urls) {
+    // The MGM stalls the open until the dump is ready
+    std::unique_ptr<XrdCl::File> file(new XrdCl::File());
+    XrdCl::XRootDStatus st = file->Open(surl, XrdCl::OpenFlags::Read,
+                                        XrdCl::Access::None, 600);
+
+    if (st.IsOK()) {
+      XrdCl::StatInfo* info = nullptr;
+      size = 0;
+
+      if (file->Stat(false, info).IsOK() && info) {
+        size = info->GetSize();
+      }
+
+      delete info;
+      eos_static_debug("msg=\"dumpmd executed successfully\" url=\"%s\" "
+                       "size=%llu", surl.c_str(), (unsigned long long) size);
+      return file;
+    }
+
+    eos_static_err("msg=\"dumpmd failed\" url=\"%s\" err=\"%s\"",
+                   surl.c_str(), st.ToStr().c_str());
+
+    if (&surl != &urls.back()) {
+      eos_static_info("msg=\"falling back to classic dumpmd command\"");
+    }
   }
+
+  return nullptr;
 }
 
 EOSFSTNAMESPACE_END
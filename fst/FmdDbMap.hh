@@ -34,8 +34,81 @@
 #define ECOMM 70
 #endif
 
+//! Forward declarations
+namespace eos
+{
+namespace console
+{
+class FileMdDumpProto;
+}
+}
+
+namespace XrdCl
+{
+class File;
+}
+
 EOSFSTNAMESPACE_BEGIN
 
+//------------------------------------------------------------------------------
+//! Incremental decoder of the MGM dumpmd output which is either the stream
+//! display (EOS_DUMPMD_STREAM_TAG line followed by length-delimited records)
+//! or env lines
+//------------------------------------------------------------------------------
+class DumpmdDecoder
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Append a chunk of the dumpmd output
+  //!
+  //! @param data chunk of output
+  //! @param length length of the chunk
+  //----------------------------------------------------------------------------
+  void Feed(const char* data, size_t length);
+
+  //----------------------------------------------------------------------------
+  //! Decode the complete entries of the output appended so far
+  //!
+  //! @param fmds decoded entries are appended here
+  //! @param max_entries maximum number of entries to decode
+  //!
+  //! @return false if the output is corrupted, otherwise true
+  //----------------------------------------------------------------------------
+  bool Decode(std::vector<Fmd>& fmds, size_t max_entries);
+
+  //----------------------------------------------------------------------------
+  //! Decode the rest of the output once all of it was appended
+  //!
+  //! @param fmds decoded entries are appended here
+  //!
+  //! @return false if the output is corrupted or truncated, otherwise true
+  //----------------------------------------------------------------------------
+  bool Finish(std::vector<Fmd>& fmds);
+
+  //----------------------------------------------------------------------------
+  //! Get the number of entries which could not be converted
+  //----------------------------------------------------------------------------
+  inline uint64_t GetNumFailed() const
+  {
+    return mNumFailed;
+  }
+
+private:
+  //! Format of the output, known after its first line
+  enum class Format {kUnknown, kEnv, kStream};
+
+  //----------------------------------------------------------------------------
+  //! Decode an env line
+  //----------------------------------------------------------------------------
+  void DecodeEnvLine(const std::string& line, std::vector<Fmd>& fmds);
+
+  Format mFormat {Format::kUnknown};
+  std::string mPending; ///< Output not decoded yet
+  size_t mPos {0}; ///< Position of the first byte not decoded in mPending
+  bool mEnd {false}; ///< Seen the end record of the stream display
+  uint64_t mNumFailed {0}; ///< Number of entries not converted
+};
+
 //------------------------------------------------------------------------------
 //! Class handling many Fmd changelog files at a time
 //------------------------------------------------------------------------------
@@ -52,6 +125,17 @@ public:
   //----------------------------------------------------------------------------
   static bool EnvMgmToFmd(XrdOucEnv& env, struct Fmd& fmd);
 
+  //----------------------------------------------------------------------------
+  //! Convert an entry of the MGM dumpmd stream to an Fmd struct
+  //!
+  //! @param entry dumpmd stream entry
+  //! @param fmd reference to Fmd struct
+  //!
+  //! @return true if successful otherwise false
+  //----------------------------------------------------------------------------
+  static bool DumpMgmToFmd(const eos::console::FileMdDumpProto& entry,
+                           struct Fmd& fmd);
+
   //----------------------------------------------------------------------------
   //! Convert namespace file metadata to an Fmd struct
   //!
@@ -213,6 +297,18 @@ public:
                      unsigned long long mtime_ns,
                      int layouterror, std::string locations);
 
+  //----------------------------------------------------------------------------
+  //! Update a batch of fmd entries from MGM metadata, creating the missing
+  //! ones, with a single write to the local database
+  //!
+  //! @param fsid file system id
+  //! @param batch MGM metadata of the files
+  //!
+  //! @return number of entries committed
+  //----------------------------------------------------------------------------
+  uint64_t UpdateFromMgm(eos::common::FileSystem::fsid_t fsid,
+                         const std::vector<Fmd>& batch);
+
   //----------------------------------------------------------------------------
   //! Reset disk information for all files stored on a particular file system
   //!
@@ -270,7 +366,9 @@ public:
                  eos::common::FileId::fileid_t fid, const char* manager);
 
   //----------------------------------------------------------------------------
-  //! Resync all meta data from MGM into local database
+  //! Resync all meta data from MGM into local database. The dump is decoded
+  //! incrementally and committed in batches, the commit of one batch
+  //! overlapping with the decoding of the next one.
   //!
   //! @param fsid filesystem id
   //! param manager manger hostname
@@ -555,13 +653,13 @@ private:
   //!
   //! @param mgm_host MGM hostname
   //! @param fsid filesystem id
-  //! @param fn_output file name where output is written
+  //! @param size size of the output
   //!
-  //! @return true if successful, otherwise false
+  //! @return file from which the output is read, or nullptr if failed
   //----------------------------------------------------------------------------
-  static bool ExecuteDumpmd(const std::string& mgm_hosst,
-                            eos::common::FileSystem::fsid_t fsid,
-                            std::string& fn_output);
+  static std::unique_ptr<XrdCl::File>
+  ExecuteDumpmd(const std::string& mgm_host,
+                eos::common::FileSystem::fsid_t fsid, uint64_t& size);
 
   //----------------------------------------------------------------------------
   //! Get file metadata info from QuarkDB
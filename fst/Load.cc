@@ -62,76 +62,64 @@ Load::~Load()
 //------------------------------------------------------------------------------
 // Get device name mounted at the given path
 //-----------------------------------------------------------------------------
-const char*
+std::string
 Load::DevMap(const char* dev_path)
 {
   static time_t loadtime = 0;
   static std::map<std::string, std::string> dev_map;
-  static XrdOucString mapdev = dev_path;
-  static XrdOucString mappath = "";
   static XrdSysMutex mutex_map; // Protect access to the dev_map
+  std::string path = dev_path;
+  std::string mapdev;
+  size_t maplen = 0;
 
-  if (mapdev.beginswith("/")) {
-    XrdSysMutexHelper scope_lock(&mutex_map);
-    mapdev = "";
-    struct stat stbuf;
+  if (path.empty() || (path[0] != '/')) {
+    return path;
+  }
+
+  XrdSysMutexHelper scope_lock(&mutex_map);
+  struct stat stbuf;
+
+  if (!(stat("/etc/mtab", &stbuf)) && (stbuf.st_mtime != loadtime)) {
+    FILE* fd = fopen("/etc/mtab", "r");
 
-    if (!(stat("/etc/mtab", &stbuf))) {
+    if (fd) {
+      // Reparse the mtab
+      char line[1025];
+      char val[6][1024];
+      line[0] = 0;
       dev_map.clear();
+      loadtime = stbuf.st_mtime;
 
-      if (stbuf.st_mtime != loadtime) {
-        FILE* fd = fopen("/etc/mtab", "r");
-        // Reparse the mtab
-        char line[1025];
-        char val[6][1024];
-        line[0] = 0;
-
-        while (fd && fgets(line, 1024, fd)) {
-          if ((sscanf(line, "%1023s %1023s %1023s %1023s %1023s %1023s\n",
-                      val[0], val[1], val[2], val[3], val[4], val[5])) == 6) {
-            XrdOucString sdev = val[0];
-            XrdOucString spath = val[1];
-
-            // fprintf(stderr,"%s => %s\n", sdev.c_str(), spath.c_str());
-            if (sdev.beginswith("/dev/")) {
-              sdev.erase(0, 5);
-              dev_map[sdev.c_str()] = spath.c_str();
-              // fprintf(stderr,"=> %s %s\n", sdev.c_str(),spath.c_str());
-            }
-          }
-        }
+      while (fgets(line, 1024, fd)) {
+        if ((sscanf(line, "%1023s %1023s %1023s %1023s %1023s %1023s\n",
+                    val[0], val[1], val[2], val[3], val[4], val[5])) == 6) {
+          XrdOucString sdev = val[0];
 
-        if (fd) {
-          fclose(fd);
+          if (sdev.beginswith("/dev/")) {
+            sdev.erase(0, 5);
+            dev_map[sdev.c_str()] = val[1];
+          }
         }
       }
-    }
 
-    XrdOucString match, it_str;
-
-    for (auto dev_map_it = dev_map.begin(); dev_map_it != dev_map.end();
-         dev_map_it++) {
-      match = dev_path;
-      it_str = dev_map_it->second.c_str();
-      match.erase(dev_map_it->second.length());
+      fclose(fd);
+    }
+  }
 
-      // fprintf(stderr,"%s <=> %s\n",match.c_str(),it_str.c_str());
-      if (match == it_str) {
-        if ((int) dev_map_it->second.length() > (int) mappath.length()) {
-          mapdev = dev_map_it->first.c_str();
-          mappath = dev_map_it->second.c_str();
-          // fprintf(stderr,"Setting up mapping %s=>%s\n", mapdev.c_str(), mappath.c_str());
-        }
-      }
+  // The longest mount path which is a prefix of the given path wins
+  for (auto it = dev_map.begin(); it != dev_map.end(); ++it) {
+    if ((it->second.length() > maplen) &&
+        (path.compare(0, it->second.length(), it->second) == 0)) {
+      mapdev = it->first;
+      maplen = it->second.length();
     }
   }
 
-  if (!mapdev.length()) {
-    mapdev = dev_path;
+  if (mapdev.empty()) {
+    mapdev = path;
   }
 
-  // printf("===> returning |%s|\n", mapdev.c_str());
-  return mapdev.c_str();
+  return mapdev;
 }
 
 //------------------------------------------------------------------------------
@@ -140,10 +128,16 @@ Load::DevMap(const char* dev_path)
 double
 Load::GetDiskRate(const char* dev_path, const char* tag)
 {
-  const char* dev = DevMap(dev_path);
-  //fprintf(stderr,"**** Device is %s\n", dev);
-  double val = fDiskStat.GetRate(dev, tag);
-  return val;
+  return GetDevRate(DevMap(dev_path).c_str(), tag);
+}
+
+//------------------------------------------------------------------------------
+// Get disk rate type for a device name as returned by DevMap
+//------------------------------------------------------------------------------
+double
+Load::GetDevRate(const char* dev, const char* tag)
+{
+  return fDiskStat.GetRate(dev, tag);
 }
 
 //------------------------------------------------------------------------------
@@ -128,14 +128,15 @@ class Load
 {
 public:
   //----------------------------------------------------------------------------
-  //! Get device name mounted at the given path
+  //! Get device name mounted at the given path. Thread-safe, the mount table
+  //! is parsed again only when it changed.
   //!
   //! @param dev_path device mount path
   //!
-  //! @return name of the devices which is mounted at the given path or empty
-  //!         string if no device found
+  //! @return name of the device with the longest mount path containing the
+  //!         given path or the given path if no device found
   //----------------------------------------------------------------------------
-  static const char* DevMap(const char* dev_path);
+  static std::string DevMap(const char* dev_path);
 
   //----------------------------------------------------------------------------
   //! Constructor
@@ -170,6 +171,16 @@ public:
   //----------------------------------------------------------------------------
   double GetDiskRate(const char* dev_path, const char* tag);
 
+  //----------------------------------------------------------------------------
+  //! Get disk rate type for a device name as returned by DevMap
+  //!
+  //! @param dev device name
+  //! @param tag type of disk rate retrieved
+  //!
+  //! @return disk rate value
+  //----------------------------------------------------------------------------
+  double GetDevRate(const char* dev, const char* tag);
+
   //----------------------------------------------------------------------------
   //! Get net rate type for a particular device
   //!
@@ -30,8 +30,11 @@
 #include "fst/io/FileIoPluginCommon.hh"
 #include "fst/FmdDbMap.hh"
 #include "fst/checksum/ChecksumPlugins.hh"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
+#include <thread>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
@@ -101,6 +104,26 @@ enum {
 
 EOSFSTNAMESPACE_BEGIN
 
+namespace
+{
+//! Disk utilisation above which the scan rate is lowered
+const double sHighDiskLoad = 0.7;
+//! Disk utilisation below which the scan rate is raised
+const double sLowDiskLoad = 0.5;
+//! Lowest scan rate in MB/s when backing off
+const double sMinRateMB = 5;
+
+//------------------------------------------------------------------------------
+// Get the number of files verified concurrently on a filesystem
+//------------------------------------------------------------------------------
+size_t
+GetNumStreams()
+{
+  const char* ptr = getenv("EOS_FST_SCAN_STREAMS");
+  size_t nstreams = (ptr ? strtoul(ptr, 0, 10) : 2);
+  return std::max(nstreams, (size_t) 1);
+}
+}
 
 /*----------------------------------------------------------------------------*/
 ScanDir::ScanDir(const char* dirpath, eos::common::FileSystem::fsid_t fsid,
@@ -108,26 +131,47 @@ ScanDir::ScanDir(const char* dirpath, eos::common::FileSystem::fsid_t fsid,
   int ratebandwidth, bool setchecksum) :
 
   fstLoad(fstload), fsId(fsid), dirPath(dirpath), testInterval(testinterval),
-  setChecksum(setchecksum), rateBandwidth(ratebandwidth), forcedScan(false)
+  setChecksum(setchecksum), rateBandwidth(ratebandwidth), forcedScan(false),
+  stopScan(false), rateLimiter(ratebandwidth * 1000000.0), lastRateAdjust(0)
 {
   thread = 0;
   noNoChecksumFiles = noScanFiles = 0;
   noCorruptFiles = noTotalFiles = SkippedFiles = 0;
+  lastTotalFiles = 0;
+  cycleStart = cycleEnd = time(NULL);
   durationScan = 0;
   totalScanSize = bufferSize = 0;
-  buffer = 0;
   bgThread = bgthread;
+  const char* ptr = getenv("EOS_FST_SCAN_IOPRIO");
+  idleIoPriority = (ptr && !strcmp(ptr, "idle"));
+  ptr = getenv("EOS_FST_SCAN_CGROUP");
+  cgroupPath = (ptr ? ptr : "");
+
+  if (fstLoad) {
+    devName = Load::DevMap(dirPath.c_str());
+  }
+
   alignment = pathconf((dirpath[0] != '/') ? "/" : dirPath.c_str(),
                       _PC_REC_XFER_ALIGN);
   size_t palignment = alignment;
 
   if (alignment > 0) {
     bufferSize = 256 * alignment;
+    size_t nstreams = GetNumStreams();
 
-    if (posix_memalign((void**) &buffer, palignment, bufferSize)) {
-      buffer = 0;
-      fprintf(stderr, "error: error calling posix_memaling on dirpath=%s. \n",
-              dirPath.c_str());
+    for (size_t i = 0; i < nstreams; ++i) {
+      char* buffer = 0;
+
+      if (posix_memalign((void**) &buffer, palignment, bufferSize)) {
+        fprintf(stderr, "error: error calling posix_memaling on dirpath=%s. \n",
+                dirPath.c_str());
+        break;
+      }
+
+      buffers.push_back(buffer);
+    }
+
+    if (buffers.empty()) {
       return;
     }
 
@@ -154,34 +198,31 @@ ScanDir::ScanDir(const char* dirpath, eos::common::FileSystem::fsid_t fsid,
 /*----------------------------------------------------------------------------*/
 ScanDir::~ScanDir()
 {
+  // the scanning streams stop after their current block, the thread itself
+  // is cancelled once it is out of the scan
+  stopScan = true;
+
   if ((bgThread && thread)) {
     XrdSysThread::Cancel(thread);
     XrdSysThread::Join(thread, NULL);
     closelog();
   }
 
-  if (buffer) {
+  for (auto buffer : buffers) {
     free(buffer);
   }
 }
 
-/*----------------------------------------------------------------------------*/
-void
-scandir_cleanup_handle(void* arg)
-{
-  FileIo::FtsHandle* handle = static_cast<FileIo::FtsHandle*>(arg);
-
-  if (handle) {
-    delete handle;
-  }
-}
-
 /*----------------------------------------------------------------------------*/
 void
 ScanDir::ScanFiles()
 {
   std::unique_ptr<FileIo> io(FileIoPluginHelper::GetIoObject(dirPath.c_str()));
 
+  if (buffers.empty()) {
+    return;
+  }
+
   if (!io) {
     if (bgThread) {
       eos_err("msg=\"no IO plug-in available\" url=\"%s\"", dirPath.c_str());
@@ -204,21 +245,54 @@ ScanDir::ScanFiles()
     return;
   }
 
-  pthread_cleanup_push(scandir_cleanup_handle, handle);
-  std::string filePath;
+  // The streams share the tree walk and must not be left behind by a
+  // cancellation - the destructor stops them through stopScan instead
+  int cancelstate;
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelstate);
+  std::mutex walkMutex;
+  auto stream = [&](char* buffer) {
+    std::string filePath;
+
+    while (!stopScan) {
+      {
+        std::lock_guard<std::mutex> lock(walkMutex);
+        filePath = io->ftsRead(handle);
+      }
 
-  while ((filePath = io->ftsRead(handle)) != "") {
-    if (!bgThread) {
-      fprintf(stderr, "[ScanDir] processing file %s\n", filePath.c_str());
+      if (filePath.empty()) {
+        break;
+      }
+
+      if (!bgThread) {
+        fprintf(stderr, "[ScanDir] processing file %s\n", filePath.c_str());
+      }
+
+      CheckFile(filePath.c_str(), buffer);
     }
+  };
+  std::vector<std::thread> streams;
 
-    CheckFile(filePath.c_str());
+  for (size_t i = 1; i < buffers.size(); ++i) {
+    try {
+      streams.emplace_back([&, i]() {
+        if (bgThread) {
+          SetLowPriority();
+        }
 
-    if (bgThread) {
-      XrdSysThread::CancelPoint();
+        stream(buffers[i]);
+      });
+    } catch (const std::system_error& e) {
+      eos_err("msg=\"failed to start scan stream\" error=\"%s\"", e.what());
+      break;
     }
   }
 
+  stream(buffers[0]);
+
+  for (auto& th : streams) {
+    th.join();
+  }
+
   if (io->ftsClose(handle)) {
     if (bgThread) {
       eos_err("fts_close failed");
@@ -228,12 +302,12 @@ ScanDir::ScanFiles()
   }
 
   delete handle;
-  pthread_cleanup_pop(0);
+  pthread_setcancelstate(cancelstate, NULL);
 }
 
 /*----------------------------------------------------------------------------*/
 void
-ScanDir::CheckFile(const char* filepath)
+ScanDir::CheckFile(const char* filepath, char* buffer)
 {
   float scantime;
   unsigned long layoutid = 0;
@@ -302,7 +376,8 @@ ScanDir::CheckFile(const char* filepath)
                                               checksumtype);
 
       if (rescan && (!ScanFileLoadAware(io, scansize, scantime, checksumVal, layoutid,
-                                        logicalFileName.c_str(), filecxerror, blockcxerror))) {
+                                        logicalFileName.c_str(), filecxerror, blockcxerror,
+                                        buffer))) {
         bool reopened = false;
 #ifndef _NOOFS
 
@@ -353,9 +428,14 @@ ScanDir::CheckFile(const char* filepath)
         }
       }
 
+      if (stopScan) {
+        // interrupted, the file is verified by the next scan
+        io->fileClose();
+        return;
+      }
+
       // Collect statistics
       if (rescan) {
-        durationScan += scantime;
         totalScanSize += scansize;
       }
 
@@ -610,12 +690,11 @@ ScanDir::ThreadProc(void)
     int retc = 0;
     pid_t tid = (pid_t) syscall(SYS_gettid);
 
-    if ((retc = ioprio_set(IOPRIO_WHO_PROCESS, tid,
-                           IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 7)))) {
-      eos_err("cannot set io priority to lowest best effort = retc=%d errno=%d\n",
-              retc, errno);
+    if ((retc = SetLowPriority())) {
+      eos_err("cannot set low priority mode errno=%d\n", retc);
     } else {
-      eos_notice("setting io priority to 7(lowest best-effort) for PID %u", tid);
+      eos_notice("setting io priority to %s for PID %u", idleIoPriority ?
+                 "idle" : "7(lowest best-effort)", tid);
     }
   }
 
@@ -677,28 +756,39 @@ ScanDir::ThreadProc(void)
     noNoChecksumFiles = 0;
     noTotalFiles = 0;
     SkippedFiles = 0;
+    cycleStart = time(NULL);
+    cycleEnd = 0;
     gettimeofday(&tv_start, &tz);
     ScanFiles();
     gettimeofday(&tv_end, &tz);
+    cycleEnd = time(NULL);
     durationScan = ((tv_end.tv_sec - tv_start.tv_sec) * 1000.0) + ((
                      tv_end.tv_usec - tv_start.tv_usec) / 1000.0);
 
+    if (!stopScan) {
+      lastTotalFiles = noTotalFiles.load();
+    }
+
+    long int nfiles = noTotalFiles;
+    long long int scansize = totalScanSize;
+    long int nscanned = noScanFiles;
+    long int ncorrupt = noCorruptFiles;
+    long int nnochecksum = noNoChecksumFiles;
+    long int nskipped = SkippedFiles;
+
     if (bgThread) {
       syslog(LOG_ERR,
              "Directory: %s, files=%li scanduration=%.02f [s] scansize=%lli [Bytes] [ %lli MB ] scannedfiles=%li  corruptedfiles=%li nochecksumfiles=%li skippedfiles=%li\n",
-             dirPath.c_str(), noTotalFiles, (durationScan / 1000.0), totalScanSize,
-             ((totalScanSize / 1000) / 1000), noScanFiles, noCorruptFiles, noNoChecksumFiles,
-             SkippedFiles);
+             dirPath.c_str(), nfiles, (durationScan / 1000.0), scansize,
+             ((scansize / 1000) / 1000), nscanned, ncorrupt, nnochecksum, nskipped);
       eos_notice("Directory: %s, files=%li scanduration=%.02f [s] scansize=%lli [Bytes] [ %lli MB ] scannedfiles=%li  corruptedfiles=%li nochecksumfiles=%li skippedfiles=%li",
-                 dirPath.c_str(), noTotalFiles, (durationScan / 1000.0), totalScanSize,
-                 ((totalScanSize / 1000) / 1000), noScanFiles, noCorruptFiles, noNoChecksumFiles,
-                 SkippedFiles);
+                 dirPath.c_str(), nfiles, (durationScan / 1000.0), scansize,
+                 ((scansize / 1000) / 1000), nscanned, ncorrupt, nnochecksum, nskipped);
     } else {
       fprintf(stderr,
               "[ScanDir] Directory: %s, files=%li scanduration=%.02f [s] scansize=%lli [Bytes] [ %lli MB ] scannedfiles=%li  corruptedfiles=%li nochecksumfiles=%li skippedfiles=%li\n",
-              dirPath.c_str(), noTotalFiles, (durationScan / 1000.0), totalScanSize,
-              ((totalScanSize / 1000) / 1000), noScanFiles, noCorruptFiles, noNoChecksumFiles,
-              SkippedFiles);
+              dirPath.c_str(), nfiles, (durationScan / 1000.0), scansize,
+              ((scansize / 1000) / 1000), nscanned, ncorrupt, nnochecksum, nskipped);
     }
 
     if (!bgThread) {
@@ -738,11 +828,10 @@ ScanDir::ThreadProc(void)
 bool
 ScanDir::ScanFileLoadAware(const std::unique_ptr<eos::fst::FileIo>& io,
                            unsigned long long& scansize, float& scantime, const char* checksumVal,
-                           unsigned long layoutid, const char* lfn, bool& filecxerror, bool& blockcxerror)
+                           unsigned long layoutid, const char* lfn, bool& filecxerror, bool& blockcxerror,
+                           char* buffer)
 {
-  double load;
   bool retVal, corruptBlockXS = false;
-  int currentRate = rateBandwidth;
   std::string filePath, fileXSPath;
   struct timezone tz;
   struct timeval opentime;
@@ -776,6 +865,20 @@ ScanDir::ScanFileLoadAware(const std::unique_ptr<eos::fst::FileIo>& io,
   off_t offset = 0;
 
   do {
+    if (stopScan) {
+      // not a verification failure, the file is simply not finished
+      if (blockXS) {
+        blockXS->CloseMap();
+        delete blockXS;
+      }
+
+      if (normalXS) {
+        delete normalXS;
+      }
+
+      return true;
+    }
+
     errno = 0;
     nread = io->fileRead(offset, buffer, bufferSize);
 
@@ -805,29 +908,10 @@ ScanDir::ScanFileLoadAware(const std::unique_ptr<eos::fst::FileIo>& io,
 
       offset += nread;
 
-      if (currentRate) {
-        // regulate the verification rate
-        gettimeofday(&currenttime, &tz);
-        scantime = (((currenttime.tv_sec - opentime.tv_sec) * 1000.0) + ((
-                      currenttime.tv_usec - opentime.tv_usec) / 1000.0));
-        float expecttime = (1.0 * offset / currentRate) / 1000.0;
-
-        if (expecttime > scantime) {
-          XrdSysTimer sleeper;
-          sleeper.Wait(expecttime - scantime);
-        }
-
-        //adjust the rate according to the load information
-        load = fstLoad->GetDiskRate("sda", "millisIO") / 1000.0;
-
-        if (load > 0.7) {
-          //adjust currentRate
-          if (currentRate > 5) {
-            currentRate = 0.9 * currentRate;
-          }
-        } else {
-          currentRate = rateBandwidth;
-        }
+      if (rateBandwidth) {
+        // regulate the verification rate of the disk
+        AdjustRate();
+        rateLimiter.Acquire(nread);
       }
     }
   } while (nread == bufferSize);
@@ -909,11 +993,105 @@ ScanDir::ScanFileLoadAware(const std::unique_ptr<eos::fst::FileIo>& io,
     delete normalXS;
   }
 
-  if (bgThread) {
-    XrdSysThread::CancelPoint();
+  return retVal;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+ScanDir::AdjustRate()
+{
+  time_t now = time(NULL);
+  time_t last = lastRateAdjust;
+
+  if ((now == last) || !lastRateAdjust.compare_exchange_strong(last, now) ||
+      !fstLoad) {
+    return;
   }
 
-  return retVal;
+  double load = fstLoad->GetDevRate(devName.c_str(), "millisIO") / 1000.0;
+  double maxRate = rateBandwidth * 1000000.0;
+  double minRate = std::min(maxRate, sMinRateMB * 1000000.0);
+  double rate = rateLimiter.GetRate();
+  double newRate = rate;
+
+  if (load > sHighDiskLoad) {
+    newRate = std::max(minRate, 0.9 * rate);
+  } else if (load < sLowDiskLoad) {
+    newRate = std::min(maxRate, rate + 0.1 * maxRate);
+  }
+
+  if (newRate != rate) {
+    rateLimiter.SetRate(newRate);
+    eos_debug("msg=\"adjusted scan rate\" path=%s load=%.02f rate=%.02f MB/s",
+              dirPath.c_str(), load, newRate / 1000000.0);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+int
+ScanDir::SetLowPriority()
+{
+  pid_t tid = (pid_t) syscall(SYS_gettid);
+  int ioprio = (idleIoPriority ? IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0) :
+                IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 7));
+
+  if (ioprio_set(IOPRIO_WHO_PROCESS, tid, ioprio)) {
+    return errno;
+  }
+
+  if (cgroupPath.length()) {
+    // cgroup v2 takes single threads through cgroup.threads, v1 through tasks
+    std::string tasks = cgroupPath + "/cgroup.threads";
+    struct stat buf;
+
+    if (stat(tasks.c_str(), &buf)) {
+      tasks = cgroupPath + "/tasks";
+    }
+
+    FILE* fd = fopen(tasks.c_str(), "w");
+
+    if (!fd) {
+      return errno;
+    }
+
+    int retc = ((fprintf(fd, "%u\n", (unsigned int) tid) < 0) ? errno : 0);
+
+    if (fclose(fd) && !retc) {
+      retc = errno;
+    }
+
+    if (retc) {
+      return retc;
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+ScanDir::GetStats(ScanStats& stats)
+{
+  time_t start = cycleStart;
+  time_t end = cycleEnd;
+  long int lastfiles = lastTotalFiles;
+  stats.mFiles = noTotalFiles;
+  stats.mScannedFiles = noScanFiles;
+  stats.mCorruptFiles = noCorruptFiles;
+  stats.mScannedBytes = totalScanSize;
+
+  if (end) {
+    stats.mProgress = 100.0;
+  } else if (lastfiles) {
+    stats.mProgress = std::min(100.0, 100.0 * stats.mFiles / lastfiles);
+  } else {
+    stats.mProgress = 0;
+  }
+
+  stats.mRateMB = (rateBandwidth ? rateLimiter.GetRate() / 1000000.0 : 0);
+  time_t elapsed = (end ? end : time(NULL)) - start;
+  stats.mThroughputMB = (elapsed > 0) ? (stats.mScannedBytes / 1000000.0 /
+                                         elapsed) : 0;
 }
 
 EOSFSTNAMESPACE_END
@@ -28,7 +28,10 @@
 #include "fst/Namespace.hh"
 #include "common/Logging.hh"
 #include "common/FileSystem.hh"
+#include "common/TokenBucket.hh"
 #include "XrdOuc/XrdOucString.hh"
+#include <atomic>
+#include <vector>
 
 #include <sys/syscall.h>
 #ifndef __APPLE__
@@ -41,35 +44,70 @@ class Load;
 class FileIo;
 class CheckSum;
 
+//------------------------------------------------------------------------------
+//! Progress and throughput of the scanner of a filesystem
+//------------------------------------------------------------------------------
+struct ScanStats {
+  long int mFiles; ///< files visited in the current cycle
+  long int mScannedFiles; ///< files verified in the current cycle
+  long int mCorruptFiles; ///< corrupted files found in the current cycle
+  long long int mScannedBytes; ///< bytes verified in the current cycle
+  double mProgress; ///< percentage of the files of the last cycle visited
+  double mRateMB; ///< current rate limit in MB/s, 0 if unlimited
+  double mThroughputMB; ///< average verification rate of the cycle in MB/s
+};
+
 class ScanDir : eos::common::LogId
 {
   //----------------------------------------------------------------------------
   //! This class scan's a directory tree and checks checksums (and
   //! blockchecksums if present) in a defined interval with limited bandwidth.
+  //!
+  //! Several files of the filesystem are verified concurrently, each stream
+  //! with its own buffer. All the streams share a token bucket holding the
+  //! bandwidth of the disk, which is lowered while the disk utilisation
+  //! reported by the load monitor is high and raised again once it drops.
+  //! The scanning threads run with a low IO priority (best-effort 7 or the
+  //! idle class) and can be attached to a cgroup.
+  //!
+  //! Environment:
+  //!   EOS_FST_SCAN_STREAMS   files verified concurrently per disk (2)
+  //!   EOS_FST_SCAN_IOPRIO    'idle' for the idle IO class, else best-effort 7
+  //!   EOS_FST_SCAN_CGROUP    cgroup directory the scanning threads join
   //----------------------------------------------------------------------------
 private:
   eos::fst::Load* fstLoad;
   eos::common::FileSystem::fsid_t fsId;
   XrdOucString dirPath;
+  std::string devName; // device holding dirPath, resolved once
   long int testInterval; // in seconds
 
   // Statistics
-  long int noScanFiles;
-  long int noCorruptFiles;
+  std::atomic<long int> noScanFiles;
+  std::atomic<long int> noCorruptFiles;
   float durationScan;
-  long long int totalScanSize;
+  std::atomic<long long int> totalScanSize;
   long long int bufferSize;
-  long int noNoChecksumFiles;
-  long int noTotalFiles;
-  long int SkippedFiles;
+  std::atomic<long int> noNoChecksumFiles;
+  std::atomic<long int> noTotalFiles;
+  std::atomic<long int> SkippedFiles;
+  std::atomic<long int> lastTotalFiles; // files seen by the last full cycle
+  std::atomic<time_t> cycleStart;
+  std::atomic<time_t> cycleEnd; // 0 while a cycle is running
 
   bool setChecksum;
   int rateBandwidth; // MB/s
   long alignment;
-  char* buffer;
+  std::vector<char*> buffers; // one per stream
   pthread_t thread;
   bool bgThread;
-  bool forcedScan;
+  std::atomic<bool> forcedScan;
+  std::atomic<bool> stopScan;
+
+  eos::common::TokenBucket rateLimiter; // bytes per second of the disk
+  std::atomic<time_t> lastRateAdjust;
+  bool idleIoPriority;
+  std::string cgroupPath;
 
 public:
 
@@ -79,11 +117,31 @@ public:
 
   void ScanFiles();
 
-  void CheckFile(const char*);
+  void CheckFile(const char*, char* buffer);
   eos::fst::CheckSum* GetBlockXS(const char*, unsigned long long maxfilesize);
   bool ScanFileLoadAware(const std::unique_ptr<eos::fst::FileIo>&,
                          unsigned long long&, float&, const char*, unsigned long, const char* lfn,
-                         bool& filecxerror, bool& blockxserror);
+                         bool& filecxerror, bool& blockxserror, char* buffer);
+
+  //----------------------------------------------------------------------------
+  //! Adjust the rate limit to the utilisation of the disk, at most once per
+  //! second. The rate is cut by 10% while the disk is busier than 70% and
+  //! grows back by 10% of the configured rate once it is below 50%.
+  //----------------------------------------------------------------------------
+  void AdjustRate();
+
+  //----------------------------------------------------------------------------
+  //! Put the calling thread into the low priority mode - IO priority class
+  //! and cgroup
+  //!
+  //! @return 0 if successful, otherwise the errno of the failing call
+  //----------------------------------------------------------------------------
+  int SetLowPriority();
+
+  //----------------------------------------------------------------------------
+  //! Get the progress and throughput of the scanner
+  //----------------------------------------------------------------------------
+  void GetStats(ScanStats& stats);
 
   std::string GetTimestamp();
   std::string GetTimestampSmeared();
@@ -1031,8 +1031,18 @@ XrdFstOfsFile::open(const char* path, XrdSfsFileOpenMode open_mode,
     }
 
     if (checkSum && isRW) {
-      // Preset with the last known checksum
-      eos_info("msg=\"reset init\" file-xs=%s", fMd->mProtoFmd.checksum().c_str());
+      // Preset with the last known checksum - without a valid one the
+      // checksum object is marked dirty and the file is rescanned at close
+      uint32_t xs_value = 0;
+
+      if (openSize && !CheckSum::ParseHexChecksum32(
+            fMd->mProtoFmd.checksum().c_str(), xs_value)) {
+        eos_warning("msg=\"no valid stored checksum, rescan at close\" "
+                    "file-xs=\"%s\"", fMd->mProtoFmd.checksum().c_str());
+      } else {
+        eos_info("msg=\"reset init\" file-xs=%s", fMd->mProtoFmd.checksum().c_str());
+      }
+
       checkSum->ResetInit(0, openSize, fMd->mProtoFmd.checksum().c_str());
     }
   }
@@ -2332,14 +2342,13 @@ XrdFstOfsFile::read(XrdSfsFileOffset fileOffset, char* buffer,
   eos_debug("rc=%d offset=%lu size=%llu", rc, fileOffset,
             static_cast<unsigned long long>(buffer_size));
 
-  if ((fileOffset + buffer_size) >= openSize) {
-    if (checkSum) {
-      if (!checkSum->NeedsRecalculation()) {
-        // If this is the last read of sequential reading, we can verify the checksum now
-        if (verifychecksum()) {
-          return gOFS.Emsg("read", error, EIO, "read file - wrong file checksum fn=",
-                           FName());
-        }
+  if (checkSum) {
+    // If this read completes the file - the last read of sequential reading or
+    // the one filling the last hole otherwise - we can verify the checksum now
+    if (!checkSum->NeedsRecalculation() && checkSum->IsComplete(openSize)) {
+      if (verifychecksum()) {
+        return gOFS.Emsg("read", error, EIO, "read file - wrong file checksum fn=",
+                         FName());
       }
     }
   }
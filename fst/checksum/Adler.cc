@@ -26,48 +26,43 @@
 
 EOSFSTNAMESPACE_BEGIN
 
-/*----------------------------------------------------------------------------*/
-bool
-Adler::Add (const char* buffer, size_t length, off_t offset)
+//------------------------------------------------------------------------------
+// Continue an adler32 value over the given buffer
+//------------------------------------------------------------------------------
+uint32_t
+Adler::Update(uint32_t value, const char* buffer, size_t length)
 {
-  if (offset != adleroffset)
-    needsRecalculation = true;
-
-  adler = adler32(0L, Z_NULL, 0);
-  Chunk currChunk;
-  adler = adler32(adler, (const Bytef*) buffer, length);
-  adleroffset = offset + length;
-  if (adleroffset > maxoffset)
-  {
-    maxoffset = adleroffset;
-  }
-  currChunk.offset = offset;
-  currChunk.length = length;
-  currChunk.adler = adler;
-
-  map = AddElementToMap(map, currChunk);
+  return adler32(value, (const Bytef*) buffer, length);
+}
 
-  return true;
+//------------------------------------------------------------------------------
+// Combine the adler32 values of two consecutive blocks
+//------------------------------------------------------------------------------
+uint32_t
+Adler::Combine(uint32_t value1, uint32_t value2, off_t length2)
+{
+  return adler32_combine(value1, value2, length2);
 }
 
-/*----------------------------------------------------------------------------*/
-MapChunks&
-Adler::AddElementToMap (MapChunks& map, Chunk& chunk)
+//------------------------------------------------------------------------------
+// Add a block - only overlapping blocks make the checksum dirty, holes are
+// checked once the checksum is finalized
+//------------------------------------------------------------------------------
+bool
+Adler::Add(const char* buffer, size_t length, off_t offset)
 {
-  off_t offEndChunk = chunk.offset + chunk.length;
-  IterMap iter = map.find(offEndChunk);
+  mRanges.Add(buffer, length, offset);
+  adleroffset = offset + length;
 
-  if (iter != map.end())
-  {
-    map.erase(iter);
-    map.insert(std::pair<off_t, Chunk > (offEndChunk, chunk));
+  if (adleroffset > maxoffset) {
+    maxoffset = adleroffset;
   }
-  else
-  {
-    map.insert(std::pair<off_t, Chunk > (offEndChunk, chunk));
+
+  if (mRanges.IsDirty()) {
+    needsRecalculation = true;
   }
 
-  return map;
+  return true;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -88,101 +83,21 @@ Adler::GetBinChecksum (int &len)
   return (char*) &adler;
 }
 
-/*----------------------------------------------------------------------------*/
-
-/* compute the adler value of the map if we have the full map
- * (starts from 0 and there are no holes)
- */
+//------------------------------------------------------------------------------
+// Compute the adler value of the file if the blocks seen cover [0, maxoffset)
+// without holes, otherwise the checksum needs a recalculation
+//------------------------------------------------------------------------------
 void
-Adler::ValidateAdlerMap ()
+Adler::ValidateAdlerMap()
 {
-  unsigned int value;
-  adler = adler32(0L, Z_NULL, 0);
-
-  if (map.begin() == map.end())
-  {
-    adler = adler32(0L, Z_NULL, 0);
-    return;
-  }
+  uint32_t value = 0;
 
-  IterMap iter1 = map.begin();
-  IterMap iter2 = iter1;
-
-  value = iter1->second.adler;
-
-  IterMap iter3;
-  //  for (iter3= map.begin(); iter3!= map.end(); iter3++) {
-  //    fprintf(stderr,"ADLER VALIDATE %llu %llu %llu %x\n", iter3->first,iter3->second.offset, iter3->second.length, iter3->second.adler);
-  //  } 
-
-  if (iter1->second.offset != 0)
-  {
-    // the first chunk is not at the beginning
-    needsRecalculation = true;
-    adler = adler32(0L, Z_NULL, 0);
-    return;
-  }
-
-  if (map.begin() == map.end())
-  {
-    //we have no chunk
-    adler = adler32(0L, Z_NULL, 0);
-    return;
-  }
-
-  needsRecalculation = false;
-
-  iter2++;
-
-  if (iter2 == map.end())
-  {
-    if ((iter1->first) != maxoffset)
-    {
-      // there was probably some overwrite
-      needsRecalculation = true;
-    }
-    else
-    {
-      if (iter1->second.offset != 0)
-      {
-        needsRecalculation = true;
-      }
-    }
-    //we have one chunk
+  if (!needsRecalculation && mRanges.GetChecksum(maxoffset, value)) {
     adler = value;
-    return;
-  }
-
-  off_t appliedoffset = 0;
-
-  for (; iter2 != map.end(); iter1++, iter2++)
-  {
-    appliedoffset = iter2->first;
-    value = adler32_combine(value, iter2->second.adler, iter2->second.length);
-    if (iter1->first != iter2->second.offset)
-    {
-      needsRecalculation = true;
-      break;
-    }
-  }
-
-  if (appliedoffset != maxoffset)
-  {
-    // there was probably some overwrite
+  } else {
     needsRecalculation = true;
-  }
-
-  if (!needsRecalculation)
-  {
-    adler = value;
-  }
-  else
-  {
     adler = adler32(0L, Z_NULL, 0);
   }
-
-  fflush(stdout);
-  return;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -26,40 +26,35 @@
 
 #include "fst/Namespace.hh"
 #include "fst/checksum/CheckSum.hh"
+#include "fst/checksum/ChecksumRanges.hh"
 #include "XrdOuc/XrdOucEnv.hh"
 #include "XrdOuc/XrdOucString.hh"
 #include <zlib.h>
-#include <map>
 
 EOSFSTNAMESPACE_BEGIN
 
-struct ltoff_t {
-
-  bool operator()(off_t s1, off_t s2) const
-  {
-    return (s1 < s2);
-  }
-};
-
-typedef struct {
-  off_t offset;
-  size_t length;
-  unsigned int adler;
-} Chunk;
-
-typedef std::map<off_t, Chunk, ltoff_t> MapChunks;
-typedef std::map<off_t, Chunk, ltoff_t>::iterator IterMap;
-
+//------------------------------------------------------------------------------
+//! Adler32 checksum. Blocks added out of order are combined as soon as they
+//! become adjacent, therefore a file written or read completely in any order
+//! does not need to be rescanned.
+//------------------------------------------------------------------------------
 class Adler : public CheckSum
 {
 private:
   off_t adleroffset;
   off_t maxoffset;
   unsigned int adler;
-  MapChunks map;
+  ChecksumRanges mRanges;
+
+  //----------------------------------------------------------------------------
+  //! Continue/combine adler32 values, used by the range tracker
+  //----------------------------------------------------------------------------
+  static uint32_t Update(uint32_t value, const char* buffer, size_t length);
+  static uint32_t Combine(uint32_t value1, uint32_t value2, off_t length2);
 
 public:
-  Adler() : CheckSum("adler")
+  Adler() : CheckSum("adler"),
+    mRanges(adler32(0L, Z_NULL, 0), &Adler::Update, &Adler::Combine)
   {
     Reset();
   }
@@ -70,7 +65,6 @@ public:
   }
 
   bool Add(const char* buffer, size_t length, off_t offset);
-  MapChunks& AddElementToMap(MapChunks& map, Chunk& chunk);
 
   off_t
   GetLastOffset()
@@ -84,6 +78,13 @@ public:
     return maxoffset;
   }
 
+  bool
+  IsComplete(off_t size)
+  {
+    uint32_t value = 0;
+    return mRanges.GetChecksum(size, value);
+  }
+
   int
   GetCheckSumLen()
   {
@@ -99,7 +100,7 @@ public:
   void
   Reset()
   {
-    map.clear();
+    mRanges.Reset();
     adleroffset = 0;
     adler = adler32(0L, Z_NULL, 0);
     needsRecalculation = false;
@@ -110,7 +111,6 @@ public:
   void
   ResetInit(off_t offsetInit, size_t lengthInit, const char* checksumInitHex)
   {
-    Chunk currChunk;
     maxoffset = 0;
     adleroffset = offsetInit + lengthInit;
 
@@ -119,23 +119,29 @@ public:
       return;
     }
 
-    int checksumInitBin = strtol(checksumInitHex, 0, 16);
+    mRanges.Reset();
 
     // if a file is truncated we get 0,0,<some checksum => reset to 0
     if (lengthInit != 0) {
-      adler = checksumInitBin;
+      uint32_t value = 0;
+
+      // Without a valid checksum of the prefix the file has to be rescanned
+      if (!ParseHexChecksum32(checksumInitHex, value)) {
+        adler = adler32(0L, Z_NULL, 0);
+        needsRecalculation = true;
+        finalized = false;
+        return;
+      }
+
+      adler = value;
     } else {
       adler = adler32(0L, Z_NULL, 0);
     }
 
-    fprintf(stderr, "adler is %x\n", adler);
-    currChunk.offset = offsetInit;
-    currChunk.length = lengthInit;
-    currChunk.adler = adler;
-    map.clear();
-    map = AddElementToMap(map, currChunk);
+    mRanges.AddRange(offsetInit, lengthInit, adler);
     maxoffset = (offsetInit + lengthInit);
     needsRecalculation = false;
+    finalized = false;
   }
 
   virtual
@@ -27,6 +27,7 @@
 /*----------------------------------------------------------------------------*/
 #include "fst/Namespace.hh"
 #include "fst/checksum/CheckSum.hh"
+#include "fst/checksum/ChecksumRanges.hh"
 #include "common/crc32c/crc32c.h"
 /*----------------------------------------------------------------------------*/
 #include "XrdOuc/XrdOucEnv.hh"
@@ -39,16 +40,39 @@
 
 EOSFSTNAMESPACE_BEGIN
 
+//------------------------------------------------------------------------------
+//! CRC32C checksum. Blocks added out of order are combined as soon as they
+//! become adjacent, therefore a file written or read completely in any order
+//! does not need to be rescanned.
+//------------------------------------------------------------------------------
 class CRC32C : public CheckSum
 {
 private:
   off_t crc32coffset;
+  off_t maxoffset;
   uint32_t crcsum;
-  bool finalized;
+  ChecksumRanges mRanges;
+
+  //----------------------------------------------------------------------------
+  //! Continue/combine final crc32c values, used by the range tracker
+  //----------------------------------------------------------------------------
+  static uint32_t
+  Update(uint32_t value, const char* buffer, size_t length)
+  {
+    return checksum::crc32cFinish(checksum::crc32c(~value, buffer, length));
+  }
+
+  static uint32_t
+  Combine(uint32_t value1, uint32_t value2, off_t length2)
+  {
+    return checksum::crc32cCombine(value1, value2, length2);
+  }
 
 public:
 
-  CRC32C() : CheckSum("crc32c")
+  CRC32C() : CheckSum("crc32c"),
+    mRanges(checksum::crc32cFinish(checksum::crc32cInit()), &CRC32C::Update,
+            &CRC32C::Combine)
   {
     Reset();
   }
@@ -59,16 +83,33 @@ public:
     return crc32coffset;
   }
 
+  off_t
+  GetMaxOffset()
+  {
+    return maxoffset;
+  }
+
+  bool
+  IsComplete(off_t size)
+  {
+    uint32_t value = 0;
+    return mRanges.GetChecksum(size, value);
+  }
+
   bool
   Add(const char* buffer, size_t length, off_t offset)
   {
-    if (offset != crc32coffset) {
+    mRanges.Add(buffer, length, offset);
+    crc32coffset = offset + length;
+
+    if (crc32coffset > maxoffset) {
+      maxoffset = crc32coffset;
+    }
+
+    if (mRanges.IsDirty()) {
       needsRecalculation = true;
-      return false;
     }
 
-    crcsum = checksum::crc32c(crcsum, (const Bytef*) buffer, length);
-    crc32coffset += length;
     return true;
   }
 
@@ -105,17 +146,53 @@ public:
   void
   Reset()
   {
-    crcsum = checksum::crc32cInit();
+    mRanges.Reset();
+    crcsum = checksum::crc32cFinish(checksum::crc32cInit());
     crc32coffset = 0;
+    maxoffset = 0;
     needsRecalculation = 0;
     finalized = false;
   }
 
+  void
+  ResetInit(off_t offsetInit, size_t lengthInit, const char* checksumInitHex)
+  {
+    maxoffset = 0;
+    crc32coffset = offsetInit + lengthInit;
+
+    if (checksumInitHex == NULL) {
+      return;
+    }
+
+    mRanges.Reset();
+    uint32_t value = 0;
+
+    // Without a valid checksum of the prefix the file has to be rescanned
+    if ((lengthInit != 0) && !ParseHexChecksum32(checksumInitHex, value)) {
+      needsRecalculation = true;
+      finalized = false;
+      return;
+    }
+
+    mRanges.AddRange(offsetInit, lengthInit, value);
+    maxoffset = offsetInit + lengthInit;
+    needsRecalculation = false;
+    finalized = false;
+  }
+
   void
   Finalize()
   {
     if (!finalized) {
-      crcsum = checksum::crc32cFinish(crcsum);
+      uint32_t value = 0;
+
+      if (!needsRecalculation && mRanges.GetChecksum(maxoffset, value)) {
+        crcsum = value;
+      } else {
+        needsRecalculation = true;
+        crcsum = checksum::crc32cFinish(checksum::crc32cInit());
+      }
+
       finalized = true;
     }
   }
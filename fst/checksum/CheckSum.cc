@@ -252,7 +252,7 @@ CheckSum::ScanFile(const char* path, off_t offsetInit, size_t lengthInit,
   }
 
   int nread = 0;
-  off_t offset = 0;
+  off_t offset = offsetInit + lengthInit;
   char* buffer = (char*) malloc(buffersize);
 
   if (!buffer) {
@@ -278,7 +278,8 @@ CheckSum::ScanFile(const char* path, off_t offsetInit, size_t lengthInit,
       gettimeofday(&currenttime, &tz);
       scantime = (((currenttime.tv_sec - opentime.tv_sec) * 1000.0) + ((
                     currenttime.tv_usec - opentime.tv_usec) / 1000.0));
-      float expecttime = (1.0 * offset / rate) / 1000.0;
+      float expecttime = (1.0 * (offset - offsetInit - lengthInit) / rate) /
+                         1000.0;
 
       if (expecttime > scantime) {
         usleep(1000.0 * (expecttime - scantime));
@@ -289,7 +290,7 @@ CheckSum::ScanFile(const char* path, off_t offsetInit, size_t lengthInit,
   gettimeofday(&currenttime, &tz);
   scantime = (((currenttime.tv_sec - opentime.tv_sec) * 1000.0) + ((
                 currenttime.tv_usec - opentime.tv_usec) / 1000.0));
-  scansize = (unsigned long long) offset;
+  scansize = (unsigned long long)(offset - offsetInit - lengthInit);
   Finalize();
   close(fd);
   free(buffer);
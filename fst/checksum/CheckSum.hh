@@ -32,6 +32,9 @@
 #include "XrdOuc/XrdOucString.hh"
 /*----------------------------------------------------------------------------*/
 #include <google/sparse_hash_map>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <setjmp.h>
 #include <signal.h>
 
@@ -100,6 +103,33 @@ public:
   virtual void
   ResetInit(off_t offsetInit, size_t lengthInit, const char* checksumInitHex) { };
 
+  //----------------------------------------------------------------------------
+  //! Parse the hex representation of a 32-bit checksum as stored in the file
+  //! metadata. It must have exactly 8 hex digits.
+  //!
+  //! @param hex checksum string, can be null
+  //! @param value parsed checksum
+  //!
+  //! @return true if the string is a valid checksum, otherwise false
+  //----------------------------------------------------------------------------
+  static bool
+  ParseHexChecksum32(const char* hex, uint32_t& value)
+  {
+    if ((hex == NULL) || (strlen(hex) != 2 * sizeof(uint32_t))) {
+      return false;
+    }
+
+    for (const char* ptr = hex; *ptr; ++ptr) {
+      if (!isxdigit((unsigned char) *ptr)) {
+        return false;
+      }
+    }
+
+    char* end = NULL;
+    value = (uint32_t) strtoul(hex, &end, 16);
+    return (*end == '\0');
+  }
+
   virtual void
   SetDirty()
   {
@@ -132,6 +162,17 @@ public:
   }
   virtual int GetCheckSumLen() = 0;
 
+  //----------------------------------------------------------------------------
+  //! Check if all the data of a file of the given size was added. Checksums
+  //! which can only be computed sequentially are complete once the last
+  //! offset reaches the size.
+  //----------------------------------------------------------------------------
+  virtual bool
+  IsComplete(off_t size)
+  {
+    return (GetLastOffset() >= size);
+  }
+
   const char*
   GetName()
   {
@@ -0,0 +1,148 @@
+// ----------------------------------------------------------------------
+// File: ChecksumRanges.cc
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fst/checksum/ChecksumRanges.hh"
+#include <iterator>
+
+EOSFSTNAMESPACE_BEGIN
+
+const size_t ChecksumRanges::sMaxRanges = 65536;
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+ChecksumRanges::ChecksumRanges(uint32_t init, UpdateFunc update,
+                               CombineFunc combine):
+  mInit(init), mUpdate(update), mCombine(combine), mDirty(false)
+{}
+
+//------------------------------------------------------------------------------
+// Account a buffer found at the given offset
+//------------------------------------------------------------------------------
+void
+ChecksumRanges::Add(const char* buffer, size_t length, off_t offset)
+{
+  if (length && !mDirty) {
+    Insert(offset, length, buffer, 0);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Account a range whose checksum value is already known
+//------------------------------------------------------------------------------
+void
+ChecksumRanges::AddRange(off_t offset, off_t length, uint32_t value)
+{
+  if ((length > 0) && !mDirty) {
+    Insert(offset, length, nullptr, value);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get the checksum of the file if the ranges cover exactly [0, size)
+//------------------------------------------------------------------------------
+bool
+ChecksumRanges::GetChecksum(off_t size, uint32_t& value) const
+{
+  if (mDirty) {
+    return false;
+  }
+
+  if (mRanges.empty()) {
+    value = mInit;
+    return (size == 0);
+  }
+
+  if ((mRanges.size() != 1) || (mRanges.begin()->first != 0) ||
+      (mRanges.begin()->second.mEnd != size)) {
+    return false;
+  }
+
+  value = mRanges.begin()->second.mValue;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Forget all ranges
+//------------------------------------------------------------------------------
+void
+ChecksumRanges::Reset()
+{
+  mRanges.clear();
+  mDirty = false;
+}
+
+//------------------------------------------------------------------------------
+// Insert a new range, merging it with the touching neighbours. Sequential
+// data extending a range continues its checksum directly, only data which
+// joins two ranges needs a combine.
+//------------------------------------------------------------------------------
+void
+ChecksumRanges::Insert(off_t offset, off_t length, const char* buffer,
+                       uint32_t value)
+{
+  off_t end = offset + length;
+  auto it_next = mRanges.upper_bound(offset);
+  auto it_prev = mRanges.end();
+
+  if (it_next != mRanges.begin()) {
+    it_prev = std::prev(it_next);
+  }
+
+  if (((it_prev != mRanges.end()) && (it_prev->second.mEnd > offset)) ||
+      ((it_next != mRanges.end()) && (it_next->first < end))) {
+    // Overlapping data, the previous content of the overlap is unknown
+    mDirty = true;
+    mRanges.clear();
+    return;
+  }
+
+  auto it_cur = it_prev;
+
+  if ((it_prev != mRanges.end()) && (it_prev->second.mEnd == offset)) {
+    it_prev->second.mValue = buffer ?
+                             mUpdate(it_prev->second.mValue, buffer, length) :
+                             mCombine(it_prev->second.mValue, value, length);
+    it_prev->second.mEnd = end;
+  } else {
+    Range range;
+    range.mEnd = end;
+    range.mValue = buffer ? mUpdate(mInit, buffer, length) : value;
+    it_cur = mRanges.emplace_hint(it_next, offset, range);
+  }
+
+  if ((it_next != mRanges.end()) && (it_next->first == end)) {
+    it_cur->second.mValue = mCombine(it_cur->second.mValue,
+                                     it_next->second.mValue,
+                                     it_next->second.mEnd - it_next->first);
+    it_cur->second.mEnd = it_next->second.mEnd;
+    mRanges.erase(it_next);
+  }
+
+  if (mRanges.size() > sMaxRanges) {
+    // Too fragmented, a rescan is cheaper than tracking all the holes
+    mDirty = true;
+    mRanges.clear();
+  }
+}
+
+EOSFSTNAMESPACE_END
@@ -0,0 +1,135 @@
+// ----------------------------------------------------------------------
+// File: ChecksumRanges.hh
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __EOSFST_CHECKSUMRANGES_HH__
+#define __EOSFST_CHECKSUMRANGES_HH__
+
+#include "fst/Namespace.hh"
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+EOSFSTNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Tracks the checksum of the byte ranges of a file which were seen so far,
+//! in any order, for checksum algorithms which support combining the values
+//! of two consecutive blocks (adler32, crc32c).
+//!
+//! Adjacent ranges are merged as soon as they touch, therefore a file written
+//! or read completely - sequentially or not - ends up as one range [0, size)
+//! whose value is the checksum of the file and no rescan is needed. Data
+//! which overlaps an already accounted range makes the tracker dirty, since
+//! the content of the overlapping part is not known any more.
+//!
+//! All values handled here are final checksum values.
+//------------------------------------------------------------------------------
+class ChecksumRanges
+{
+public:
+  //! Continue the checksum value over the given buffer
+  typedef uint32_t (*UpdateFunc)(uint32_t value, const char* buffer,
+                                 size_t length);
+  //! Checksum of the concatenation of two blocks given their checksums
+  typedef uint32_t (*CombineFunc)(uint32_t value1, uint32_t value2,
+                                  off_t length2);
+
+  //! Maximum number of disjoint ranges tracked before giving up
+  static const size_t sMaxRanges;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param init checksum value of an empty block
+  //! @param update function continuing a checksum value over a buffer
+  //! @param combine function combining the values of two consecutive blocks
+  //----------------------------------------------------------------------------
+  ChecksumRanges(uint32_t init, UpdateFunc update, CombineFunc combine);
+
+  //----------------------------------------------------------------------------
+  //! Account a buffer found at the given offset
+  //----------------------------------------------------------------------------
+  void Add(const char* buffer, size_t length, off_t offset);
+
+  //----------------------------------------------------------------------------
+  //! Account a range whose checksum value is already known
+  //----------------------------------------------------------------------------
+  void AddRange(off_t offset, off_t length, uint32_t value);
+
+  //----------------------------------------------------------------------------
+  //! Get the checksum of the file if the ranges cover exactly [0, size)
+  //!
+  //! @param size size of the file
+  //! @param value set to the checksum of the file
+  //!
+  //! @return true if the checksum is known, otherwise false
+  //----------------------------------------------------------------------------
+  bool GetChecksum(off_t size, uint32_t& value) const;
+
+  //----------------------------------------------------------------------------
+  //! Forget all ranges
+  //----------------------------------------------------------------------------
+  void Reset();
+
+  //----------------------------------------------------------------------------
+  //! Check if overlapping data was seen, or too many holes were left open
+  //----------------------------------------------------------------------------
+  inline bool IsDirty() const
+  {
+    return mDirty;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get number of disjoint ranges
+  //----------------------------------------------------------------------------
+  inline size_t GetNumRanges() const
+  {
+    return mRanges.size();
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  //! Range [start, mEnd) with its checksum, keyed by start in the map
+  //----------------------------------------------------------------------------
+  struct Range {
+    off_t mEnd;
+    uint32_t mValue;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Insert a new range, merging it with the touching neighbours
+  //!
+  //! @param buffer data of the range or nullptr if value is already known
+  //----------------------------------------------------------------------------
+  void Insert(off_t offset, off_t length, const char* buffer, uint32_t value);
+
+  uint32_t mInit;
+  UpdateFunc mUpdate;
+  CombineFunc mCombine;
+  std::map<off_t, Range> mRanges;
+  bool mDirty;
+};
+
+EOSFSTNAMESPACE_END
+
+#endif
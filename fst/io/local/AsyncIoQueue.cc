@@ -0,0 +1,288 @@
+//------------------------------------------------------------------------------
+//! @file AsyncIoQueue.cc
+//! @brief Queue of asynchronous requests on a local file executed in batches
+//!        by a pool of IO threads shared by all files
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fst/io/local/AsyncIoQueue.hh"
+#include "common/ThreadPool.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+#include <utility>
+
+EOSFSTNAMESPACE_BEGIN
+
+namespace
+{
+//! Maximum number of bytes merged in one transfer
+const uint64_t sMaxTransferSize = 64 * 1024 * 1024;
+//! Maximum number of recycled buffers per size in the aligned pool
+const size_t sMaxPooledBuffers = 8;
+
+//------------------------------------------------------------------------------
+// Get the number of IO threads, 0 if the asynchronous mode is disabled
+//------------------------------------------------------------------------------
+unsigned int
+GetNumThreads()
+{
+  static const unsigned int sNumThreads = []() {
+    const char* ptr = getenv("EOS_FST_LOCALIO_THREADS");
+    return (ptr ? (unsigned int) strtoul(ptr, 0, 10) : 16u);
+  }();
+  return sNumThreads;
+}
+
+//------------------------------------------------------------------------------
+// Get the thread pool shared by all the queues
+//------------------------------------------------------------------------------
+eos::common::ThreadPool&
+GetIoPool()
+{
+  static eos::common::ThreadPool sIoPool(GetNumThreads(), GetNumThreads());
+  return sIoPool;
+}
+
+//------------------------------------------------------------------------------
+// Round up a size to the size class of the aligned buffer pool
+//------------------------------------------------------------------------------
+size_t
+GetSizeClass(size_t size)
+{
+  size_t sz = AlignedBufferPool::sAlignment;
+
+  while (sz < size) {
+    sz <<= 1;
+  }
+
+  return sz;
+}
+
+std::mutex sBufferMutex; ///< protects the aligned buffer pool
+std::map<size_t, std::vector<char*>> sBuffers; ///< free buffers per size
+}
+
+//! Maximum number of segments merged in one transfer, below IOV_MAX
+const int AsyncIoQueue::sMaxIovCount = 1024;
+
+//------------------------------------------------------------------------------
+// Check if the asynchronous mode is enabled
+//------------------------------------------------------------------------------
+bool
+AsyncIoQueue::IsEnabled()
+{
+  return (GetNumThreads() > 0);
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+AsyncIoQueue::AsyncIoQueue(TransferFunc transfer):
+  mTransfer(std::move(transfer)), mRunning(false)
+{
+}
+
+//------------------------------------------------------------------------------
+// Destructor
+//------------------------------------------------------------------------------
+AsyncIoQueue::~AsyncIoQueue()
+{
+  Wait();
+}
+
+//------------------------------------------------------------------------------
+// Queue a request and schedule a run if none is active
+//------------------------------------------------------------------------------
+void
+AsyncIoQueue::Submit(Request&& req)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPending.push_back(std::move(req));
+
+    if (mRunning) {
+      return;
+    }
+
+    mRunning = true;
+  }
+  (void) GetIoPool().PushTask<void>([this]() {
+    Run();
+  });
+}
+
+//------------------------------------------------------------------------------
+// Wait until all the queued requests are completed
+//------------------------------------------------------------------------------
+void
+AsyncIoQueue::Wait()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  mCondIdle.wait(lock, [this]() {
+    return !mRunning;
+  });
+}
+
+//------------------------------------------------------------------------------
+// Execute the queued requests until the queue is empty. The queue is only
+// marked idle once the callbacks of the last batch returned so that waiting
+// for the queue also waits for the completion notifications.
+//------------------------------------------------------------------------------
+void
+AsyncIoQueue::Run()
+{
+  std::vector<Request> batch;
+
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      if (mPending.empty()) {
+        mRunning = false;
+        mCondIdle.notify_all();
+        return;
+      }
+
+      batch.swap(mPending);
+    }
+    ExecuteBatch(batch);
+    batch.clear();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Execute a batch of requests, merging the contiguous segments
+//------------------------------------------------------------------------------
+void
+AsyncIoQueue::ExecuteBatch(std::vector<Request>& batch)
+{
+  std::vector<struct iovec> iov;
+  std::vector<std::pair<Request*, Segment*>> segs;
+  uint64_t run_end = 0;
+  bool run_write = false;
+  // Do the transfer of the current run and account it to its segments
+  auto flush = [&]() {
+    if (segs.empty()) {
+      return;
+    }
+
+    int64_t nbytes = mTransfer(run_write, segs.front().second->mOffset,
+                               iov.data(), (int) iov.size());
+    int err = errno;
+
+    for (auto& seg : segs) {
+      if (nbytes < 0) {
+        seg.second->mDone = -1;
+
+        if (!seg.first->mErrno) {
+          seg.first->mErrno = (err ? err : EIO);
+        }
+      } else {
+        seg.second->mDone = std::min<int64_t>(seg.second->mLength, nbytes);
+        nbytes -= seg.second->mDone;
+      }
+    }
+
+    iov.clear();
+    segs.clear();
+  };
+
+  for (auto& req : batch) {
+    req.mErrno = 0;
+
+    for (auto& seg : req.mSegments) {
+      if (!segs.empty() && ((req.mIsWrite != run_write) ||
+                            (seg.mOffset != run_end) ||
+                            (iov.size() >= (size_t) sMaxIovCount) ||
+                            (run_end - segs.front().second->mOffset + seg.mLength >
+                             sMaxTransferSize))) {
+        flush();
+      }
+
+      run_write = req.mIsWrite;
+      run_end = seg.mOffset + seg.mLength;
+      iov.push_back({seg.mBuffer, seg.mLength});
+      segs.emplace_back(&req, &seg);
+    }
+  }
+
+  flush();
+
+  for (auto& req : batch) {
+    if (req.mCallback) {
+      req.mCallback(req);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get an aligned buffer of at least the given size
+//------------------------------------------------------------------------------
+char*
+AlignedBufferPool::Get(size_t size)
+{
+  size_t sz = GetSizeClass(size);
+  {
+    std::lock_guard<std::mutex> lock(sBufferMutex);
+    auto it = sBuffers.find(sz);
+
+    if ((it != sBuffers.end()) && !it->second.empty()) {
+      char* buffer = it->second.back();
+      it->second.pop_back();
+      return buffer;
+    }
+  }
+  void* buffer = nullptr;
+
+  if (posix_memalign(&buffer, sAlignment, sz)) {
+    return nullptr;
+  }
+
+  return static_cast<char*>(buffer);
+}
+
+//------------------------------------------------------------------------------
+// Give back a buffer to the pool
+//------------------------------------------------------------------------------
+void
+AlignedBufferPool::Put(char* buffer, size_t size)
+{
+  if (!buffer) {
+    return;
+  }
+
+  size_t sz = GetSizeClass(size);
+
+  if (sz <= sMaxTransferSize) {
+    std::lock_guard<std::mutex> lock(sBufferMutex);
+    std::vector<char*>& buffers = sBuffers[sz];
+
+    if (buffers.size() < sMaxPooledBuffers) {
+      buffers.push_back(buffer);
+      return;
+    }
+  }
+
+  free(buffer);
+}
+
+EOSFSTNAMESPACE_END
@@ -0,0 +1,172 @@
+//------------------------------------------------------------------------------
+//! @file AsyncIoQueue.hh
+//! @brief Queue of asynchronous requests on a local file executed in batches
+//!        by a pool of IO threads shared by all files
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __EOSFST_ASYNCIOQUEUE_HH__
+#define __EOSFST_ASYNCIOQUEUE_HH__
+
+#include "fst/Namespace.hh"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <sys/uio.h>
+
+EOSFSTNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Queue of asynchronous requests on one local file. The requests are
+//! executed in submission order by the threads of a pool shared by all the
+//! queues, one thread at a time per queue. Each run takes all the requests
+//! queued so far and merges the contiguous reads or writes into a single
+//! vector transfer, so that a burst of small requests costs few system calls
+//! and requests on different files proceed in parallel.
+//!
+//! The number of IO threads is given by EOS_FST_LOCALIO_THREADS (default 16),
+//! 0 disables the asynchronous mode and the local files fall back to
+//! synchronous IO.
+//------------------------------------------------------------------------------
+class AsyncIoQueue
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Contiguous piece of file transferred by a request
+  //----------------------------------------------------------------------------
+  struct Segment {
+    uint64_t mOffset; ///< offset in file
+    char* mBuffer; ///< data buffer
+    uint32_t mLength; ///< length of the segment
+    int64_t mDone; ///< bytes transferred or -1 if error, set on completion
+  };
+
+  //----------------------------------------------------------------------------
+  //! Request made of one or several segments of the same type
+  //----------------------------------------------------------------------------
+  struct Request {
+    bool mIsWrite; ///< write request, otherwise read
+    std::vector<Segment> mSegments; ///< pieces of the request
+    int mErrno; ///< errno of the first failed segment, set on completion
+    //! Called from the IO thread once all the segments are done
+    std::function<void(Request&)> mCallback;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Function doing a vector transfer at the given offset, the equivalent of
+  //! preadv/pwritev returning the number of bytes transferred or -1 with
+  //! errno set. Short counts are only expected at the end of file.
+  //----------------------------------------------------------------------------
+  typedef std::function<int64_t(bool isWrite, uint64_t offset,
+                                const struct iovec* iov, int iovcnt)>
+  TransferFunc;
+
+  //----------------------------------------------------------------------------
+  //! Check if the asynchronous mode is enabled
+  //----------------------------------------------------------------------------
+  static bool IsEnabled();
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param transfer function doing the actual transfers
+  //----------------------------------------------------------------------------
+  explicit AsyncIoQueue(TransferFunc transfer);
+
+  //----------------------------------------------------------------------------
+  //! Destructor - waits for all the requests to be completed
+  //----------------------------------------------------------------------------
+  ~AsyncIoQueue();
+
+  //----------------------------------------------------------------------------
+  //! Queue a request
+  //!
+  //! @param req request, its callback is called once completed
+  //----------------------------------------------------------------------------
+  void Submit(Request&& req);
+
+  //----------------------------------------------------------------------------
+  //! Wait until all the queued requests are completed
+  //----------------------------------------------------------------------------
+  void Wait();
+
+private:
+  //! Maximum number of segments merged in one transfer
+  static const int sMaxIovCount;
+
+  TransferFunc mTransfer; ///< function doing the transfers
+  std::mutex mMutex; ///< protects the queue and the running flag
+  std::condition_variable mCondIdle; ///< signaled when the queue is idle
+  std::vector<Request> mPending; ///< requests not yet taken by a run
+  bool mRunning; ///< set while a run is scheduled or executing
+
+  //----------------------------------------------------------------------------
+  //! Execute the queued requests until the queue is empty
+  //----------------------------------------------------------------------------
+  void Run();
+
+  //----------------------------------------------------------------------------
+  //! Execute a batch of requests, merging the contiguous segments
+  //!
+  //! @param batch requests in submission order
+  //----------------------------------------------------------------------------
+  void ExecuteBatch(std::vector<Request>& batch);
+
+  //----------------------------------------------------------------------------
+  //! Disable copy constructor and assignment operator
+  //----------------------------------------------------------------------------
+  AsyncIoQueue(const AsyncIoQueue&) = delete;
+  AsyncIoQueue& operator = (const AsyncIoQueue&) = delete;
+};
+
+//------------------------------------------------------------------------------
+//! Pool of buffers aligned for direct IO. Buffers are handed out in sizes
+//! rounded up to a power of two and recycled per size so that the transfers
+//! on files opened with O_DIRECT do not allocate on every request.
+//------------------------------------------------------------------------------
+class AlignedBufferPool
+{
+public:
+  //! Alignment of the buffers, offsets and lengths for direct IO
+  static const size_t sAlignment = 4096;
+
+  //----------------------------------------------------------------------------
+  //! Get a buffer of at least the given size
+  //!
+  //! @param size requested size
+  //!
+  //! @return aligned buffer or nullptr if allocation failed
+  //----------------------------------------------------------------------------
+  static char* Get(size_t size);
+
+  //----------------------------------------------------------------------------
+  //! Give back a buffer obtained with Get
+  //!
+  //! @param buffer buffer
+  //! @param size size requested when getting the buffer
+  //----------------------------------------------------------------------------
+  static void Put(char* buffer, size_t size);
+};
+
+EOSFSTNAMESPACE_END
+
+#endif // __EOSFST_ASYNCIOQUEUE_HH__
@@ -23,6 +23,12 @@
 
 #include "fst/XrdFstOfsFile.hh"
 #include "fst/io/local/FsIo.hh"
+#include "fst/io/local/AsyncIoQueue.hh"
+#include "fst/io/AsyncMetaHandler.hh"
+#include "fst/io/ChunkHandler.hh"
+#include "fst/io/VectChunkHandler.hh"
+#include <algorithm>
+#include <cstring>
 #ifndef __APPLE__
 #include <xfs/xfs.h>
 #include <attr/xattr.h>
@@ -35,11 +41,49 @@
 
 EOSFSTNAMESPACE_BEGIN
 
+namespace
+{
+//------------------------------------------------------------------------------
+// Build the status of a completed request
+//------------------------------------------------------------------------------
+XrdCl::XRootDStatus*
+MakeStatus(const AsyncIoQueue::Request& req)
+{
+  if (req.mErrno) {
+    return new XrdCl::XRootDStatus(XrdCl::stError, XrdCl::errErrorResponse,
+                                   req.mErrno, strerror(req.mErrno));
+  }
+
+  return new XrdCl::XRootDStatus();
+}
+
+//------------------------------------------------------------------------------
+// Check if a vector transfer is aligned for direct IO
+//------------------------------------------------------------------------------
+bool
+IsAligned(XrdSfsFileOffset offset, const struct iovec* iov, int iovcnt)
+{
+  const size_t mask = AlignedBufferPool::sAlignment - 1;
+
+  if (offset & mask) {
+    return false;
+  }
+
+  for (int i = 0; i < iovcnt; ++i) {
+    if ((((uintptr_t) iov[i].iov_base) & mask) || (iov[i].iov_len & mask)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+}
+
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
 FsIo::FsIo(std::string path) :
-  FileIo(path, "FsIo"), mFd(-1)
+  FileIo(path, "FsIo"), mFd(-1), mDirectIo(false), mBufferedFd(-1)
 {
 }
 
@@ -47,7 +91,7 @@ FsIo::FsIo(std::string path) :
 // Constructor
 //------------------------------------------------------------------------------
 FsIo::FsIo(std::string path, std::string iotype) :
-  FileIo(path, iotype), mFd(-1)
+  FileIo(path, iotype), mFd(-1), mDirectIo(false), mBufferedFd(-1)
 {
 }
 
@@ -56,6 +100,8 @@ FsIo::FsIo(std::string path, std::string iotype) :
 //------------------------------------------------------------------------------
 FsIo::~FsIo()
 {
+  WaitAsync();
+
   if (mFd != -1) {
     fileClose(mFd);
   }
@@ -71,6 +117,9 @@ FsIo::fileOpen(XrdSfsFileOpenMode flags, mode_t mode, const std::string& opaque,
   mFd = ::open(mFilePath.c_str(), flags, mode);
 
   if (mFd > 0) {
+#ifdef O_DIRECT
+    mDirectIo = ((flags & O_DIRECT) != 0);
+#endif
     return 0;
   } else {
     mFd = -1;
@@ -85,6 +134,7 @@ int64_t
 FsIo::fileRead(XrdSfsFileOffset offset, char* buffer, XrdSfsXferSize length,
                uint16_t timeout)
 {
+  WaitAsync();
   return ::pread(mFd, buffer, length, offset);
 }
 
@@ -95,27 +145,183 @@ int64_t
 FsIo::fileWrite(XrdSfsFileOffset offset, const char* buffer,
                 XrdSfsXferSize length, uint16_t timeout)
 {
+  WaitAsync();
   return ::pwrite(mFd, buffer, length, offset);
 }
 
 //------------------------------------------------------------------------------
-// Read from file async - falls back on synchronous mode
+// Vector read - sync
+//------------------------------------------------------------------------------
+int64_t
+FsIo::fileReadV(XrdCl::ChunkList& chunkList, uint16_t timeout)
+{
+  int64_t nread = 0;
+
+  for (auto chunk = chunkList.begin(); chunk != chunkList.end(); ++chunk) {
+    int64_t nbytes = fileRead(chunk->offset, (char*) chunk->buffer,
+                              chunk->length, timeout);
+
+    if (nbytes != chunk->length) {
+      if (nbytes >= 0) {
+        errno = EIO;
+      }
+
+      return SFS_ERROR;
+    }
+
+    nread += nbytes;
+  }
+
+  return nread;
+}
+
+//------------------------------------------------------------------------------
+// Read from file async - the request is queued and the response comes
+// through the async handler of the file, falls back on synchronous mode if
+// the asynchronous mode is disabled
 //------------------------------------------------------------------------------
 int64_t
 FsIo::fileReadAsync(XrdSfsFileOffset offset, char* buffer,
                     XrdSfsXferSize length, bool readahead, uint16_t timeout)
 {
-  return fileRead(offset, buffer, length, timeout);
+  AsyncIoQueue* queue = GetAsyncQueue();
+
+  if (!queue) {
+    return fileRead(offset, buffer, length, timeout);
+  }
+
+  ChunkHandler* handler = mMetaHandler->Register(offset, length, buffer, false);
+
+  if (!handler) {
+    return SFS_ERROR;
+  }
+
+  AsyncIoQueue::Request req;
+  req.mIsWrite = false;
+  req.mSegments.push_back({(uint64_t) offset, buffer, (uint32_t) length, 0});
+  req.mCallback = [handler](AsyncIoQueue::Request& done) {
+    const AsyncIoQueue::Segment& seg = done.mSegments.front();
+    XrdCl::AnyObject* response = nullptr;
+
+    if (!done.mErrno) {
+      response = new XrdCl::AnyObject();
+      response->Set(new XrdCl::ChunkInfo(seg.mOffset, (uint32_t) seg.mDone,
+                                         seg.mBuffer));
+    }
+
+    handler->HandleResponse(MakeStatus(done), response);
+  };
+  queue->Submit(std::move(req));
+  return length;
+}
+
+//------------------------------------------------------------------------------
+// Vector read - async
+//------------------------------------------------------------------------------
+int64_t
+FsIo::fileReadVAsync(XrdCl::ChunkList& chunkList, uint16_t timeout)
+{
+  AsyncIoQueue* queue = GetAsyncQueue();
+
+  if (!queue) {
+    return fileReadV(chunkList, timeout);
+  }
+
+  VectChunkHandler* vhandler = mMetaHandler->Register(chunkList, NULL, false);
+
+  if (!vhandler) {
+    eos_err("unable to get vector handler");
+    return SFS_ERROR;
+  }
+
+  int64_t nread = vhandler->GetLength();
+  AsyncIoQueue::Request req;
+  req.mIsWrite = false;
+
+  for (auto chunk = chunkList.begin(); chunk != chunkList.end(); ++chunk) {
+    req.mSegments.push_back({chunk->offset, (char*) chunk->buffer,
+                             chunk->length, 0
+                            });
+  }
+
+  req.mCallback = [vhandler](AsyncIoQueue::Request& done) {
+    XrdCl::AnyObject* response = nullptr;
+
+    if (!done.mErrno) {
+      XrdCl::VectorReadInfo* info = new XrdCl::VectorReadInfo();
+      uint32_t size = 0;
+
+      for (const auto& seg : done.mSegments) {
+        info->GetChunks().push_back(XrdCl::ChunkInfo(seg.mOffset,
+                                    (uint32_t) seg.mDone, seg.mBuffer));
+        size += (uint32_t) seg.mDone;
+      }
+
+      info->SetSize(size);
+      response = new XrdCl::AnyObject();
+      response->Set(info);
+    }
+
+    vhandler->HandleResponse(MakeStatus(done), response);
+  };
+  queue->Submit(std::move(req));
+  return nread;
 }
 
 //------------------------------------------------------------------------------
-// Write to file async - falls back on synchronous mode
+// Write to file async - the data is copied to the handler of the request
+// and written by the IO threads, falls back on synchronous mode if the
+// asynchronous mode is disabled
 //------------------------------------------------------------------------------
 int64_t
 FsIo::fileWriteAsync(XrdSfsFileOffset offset, const char* buffer,
                      XrdSfsXferSize length, uint16_t timeout)
 {
-  return fileWrite(offset, buffer, length, timeout);
+  AsyncIoQueue* queue = GetAsyncQueue();
+
+  if (!queue) {
+    return fileWrite(offset, buffer, length, timeout);
+  }
+
+  ChunkHandler* handler = mMetaHandler->Register(offset, length,
+                          (char*) buffer, true);
+
+  if (!handler) {
+    return SFS_ERROR;
+  }
+
+  AsyncIoQueue::Request req;
+  req.mIsWrite = true;
+  req.mSegments.push_back({(uint64_t) offset, handler->GetBuffer(),
+                           (uint32_t) length, 0
+                          });
+  req.mCallback = [handler](AsyncIoQueue::Request& done) {
+    const AsyncIoQueue::Segment& seg = done.mSegments.front();
+
+    if (!done.mErrno && (seg.mDone != seg.mLength)) {
+      done.mErrno = EIO;
+    }
+
+    handler->HandleResponse(MakeStatus(done), nullptr);
+  };
+  queue->Submit(std::move(req));
+  return length;
+}
+
+//------------------------------------------------------------------------------
+// Wait for all async IO
+//------------------------------------------------------------------------------
+int
+FsIo::fileWaitAsyncIO()
+{
+  WaitAsync();
+
+  if (mMetaHandler && (mMetaHandler->WaitOK() != XrdCl::errNone)) {
+    eos_err("error=async requests failed for file path=%s", mFilePath.c_str());
+    return SFS_ERROR;
+  }
+
+  return SFS_OK;
 }
 
 //------------------------------------------------------------------------------
@@ -124,6 +330,7 @@ FsIo::fileWriteAsync(XrdSfsFileOffset offset, const char* buffer,
 int
 FsIo::fileTruncate(XrdSfsFileOffset offset, uint16_t timeout)
 {
+  WaitAsync();
   return ::ftruncate(mFd, offset);
 }
 
@@ -190,6 +397,7 @@ FsIo::fileFdeallocate(XrdSfsFileOffset fromOffset,
 int
 FsIo::fileSync(uint16_t timeout)
 {
+  WaitAsync();
   return ::fsync(mFd);
 }
 
@@ -199,6 +407,8 @@ FsIo::fileSync(uint16_t timeout)
 int
 FsIo::fileStat(struct stat* buf, uint16_t timeout)
 {
+  WaitAsync();
+
   if (mFd > 0) {
     return ::fstat(mFd, buf);
   } else {
@@ -212,6 +422,13 @@ FsIo::fileStat(struct stat* buf, uint16_t timeout)
 int
 FsIo::fileClose(uint16_t timeout)
 {
+  WaitAsync();
+
+  if (mBufferedFd != -1) {
+    (void) ::close(mBufferedFd);
+    mBufferedFd = -1;
+  }
+
   int rc = ::close(mFd);
   mFd = -1;
   return rc;
@@ -248,7 +465,181 @@ FsIo::fileExists()
 void*
 FsIo::fileGetAsyncHandler()
 {
-  return NULL;
+  return mMetaHandler.get();
+}
+
+//------------------------------------------------------------------------------
+// Get the queue of asynchronous requests, created on first use
+//------------------------------------------------------------------------------
+AsyncIoQueue*
+FsIo::GetAsyncQueue()
+{
+  if (!mAsyncQueue && AsyncIoQueue::IsEnabled()) {
+    mMetaHandler.reset(new AsyncMetaHandler());
+    mAsyncQueue.reset(new AsyncIoQueue([this](bool isWrite, uint64_t offset,
+                                       const struct iovec* iov, int iovcnt) {
+      return fileTransferV(isWrite, offset, iov, iovcnt);
+    }));
+  }
+
+  return mAsyncQueue.get();
+}
+
+//------------------------------------------------------------------------------
+// Wait for the asynchronous requests in flight to complete
+//------------------------------------------------------------------------------
+void
+FsIo::WaitAsync()
+{
+  if (mAsyncQueue) {
+    mAsyncQueue->Wait();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Vector transfer for the asynchronous requests
+//------------------------------------------------------------------------------
+int64_t
+FsIo::fileTransferV(bool isWrite, XrdSfsFileOffset offset,
+                    const struct iovec* iov, int iovcnt)
+{
+  if (mDirectIo && !IsAligned(offset, iov, iovcnt)) {
+    return DirectTransferV(isWrite, offset, iov, iovcnt);
+  }
+
+  std::vector<struct iovec> vec(iov, iov + iovcnt);
+  int64_t total = 0;
+  int idx = 0;
+
+  while (idx < iovcnt) {
+    ssize_t nbytes = (isWrite ?
+                      ::pwritev(mFd, &vec[idx], iovcnt - idx, offset + total) :
+                      ::preadv(mFd, &vec[idx], iovcnt - idx, offset + total));
+
+    if (nbytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return SFS_ERROR;
+    }
+
+    if (nbytes == 0) {
+      break;
+    }
+
+    total += nbytes;
+
+    // Skip the buffers done and continue a partial transfer
+    while ((idx < iovcnt) && ((size_t) nbytes >= vec[idx].iov_len)) {
+      nbytes -= vec[idx].iov_len;
+      ++idx;
+    }
+
+    if (nbytes) {
+      vec[idx].iov_base = (char*) vec[idx].iov_base + nbytes;
+      vec[idx].iov_len -= nbytes;
+    }
+  }
+
+  return total;
+}
+
+//------------------------------------------------------------------------------
+// Vector transfer on a file opened with O_DIRECT which is not aligned. Reads
+// are done on the enclosing aligned range and writes with aligned offset and
+// length are staged in an aligned buffer. The other writes would need a
+// read-modify-write of the partial blocks and go through a descriptor
+// opened without O_DIRECT instead.
+//------------------------------------------------------------------------------
+int64_t
+FsIo::DirectTransferV(bool isWrite, XrdSfsFileOffset offset,
+                      const struct iovec* iov, int iovcnt)
+{
+  const uint64_t mask = AlignedBufferPool::sAlignment - 1;
+  uint64_t length = 0;
+
+  for (int i = 0; i < iovcnt; ++i) {
+    length += iov[i].iov_len;
+  }
+
+  uint64_t start = offset & ~mask;
+  uint64_t end = (offset + length + mask) & ~mask;
+
+  if (isWrite && ((start != (uint64_t) offset) ||
+                  (end != (uint64_t) offset + length))) {
+    if (mBufferedFd == -1) {
+      mBufferedFd = ::open(mFilePath.c_str(), O_WRONLY);
+
+      if (mBufferedFd == -1) {
+        return SFS_ERROR;
+      }
+    }
+
+    int64_t total = 0;
+
+    for (int i = 0; i < iovcnt; ++i) {
+      size_t done = 0;
+
+      while (done < iov[i].iov_len) {
+        ssize_t nbytes = ::pwrite(mBufferedFd, (char*) iov[i].iov_base + done,
+                                  iov[i].iov_len - done, offset + total);
+
+        if (nbytes < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+
+          return SFS_ERROR;
+        }
+
+        done += nbytes;
+        total += nbytes;
+      }
+    }
+
+    return total;
+  }
+
+  char* buffer = AlignedBufferPool::Get(end - start);
+
+  if (!buffer) {
+    errno = ENOMEM;
+    return SFS_ERROR;
+  }
+
+  struct iovec aligned = {buffer, (size_t)(end - start)};
+  int64_t total = 0;
+  uint64_t pos = offset - start;
+
+  if (isWrite) {
+    for (int i = 0; i < iovcnt; ++i) {
+      memcpy(buffer + pos, iov[i].iov_base, iov[i].iov_len);
+      pos += iov[i].iov_len;
+    }
+
+    total = fileTransferV(true, start, &aligned, 1);
+  } else {
+    int64_t nbytes = fileTransferV(false, start, &aligned, 1);
+
+    if (nbytes < 0) {
+      total = SFS_ERROR;
+    } else {
+      // Copy out what was read past the requested offset
+      uint64_t avail = ((uint64_t) nbytes > pos ? nbytes - pos : 0);
+
+      for (int i = 0; (i < iovcnt) && avail; ++i) {
+        size_t len = std::min<uint64_t>(iov[i].iov_len, avail);
+        memcpy(iov[i].iov_base, buffer + pos, len);
+        pos += len;
+        avail -= len;
+        total += len;
+      }
+    }
+  }
+
+  AlignedBufferPool::Put(buffer, end - start);
+  return total;
 }
 
 //------------------------------------------------------------------------------
@@ -26,10 +26,19 @@
 #define __EOSFST_FSFILEIO__HH__
 
 #include "fst/io/FileIo.hh"
+#include <memory>
+#include <sys/uio.h>
 
 EOSFSTNAMESPACE_BEGIN
+
+class AsyncIoQueue;
+class AsyncMetaHandler;
 //------------------------------------------------------------------------------
-//! Class used for doing local IO operations
+//! Class used for doing local IO operations. The asynchronous requests are
+//! queued per file and executed in batches by the IO threads of
+//! AsyncIoQueue, completing through the AsyncMetaHandler of the file like
+//! for remote files. Files opened with O_DIRECT go through aligned bounce
+//! buffers for the asynchronous requests which are not aligned.
 //------------------------------------------------------------------------------
 class FsIo : public FileIo
 {
@@ -125,11 +134,7 @@ public:
   //! @return number of bytes read of -1 if error
   //----------------------------------------------------------------------------
   virtual int64_t fileReadV(XrdCl::ChunkList& chunkList,
-                            uint16_t timeout = 0)
-  {
-    errno = EOPNOTSUPP;
-    return -1;
-  }
+                            uint16_t timeout = 0);
 
   //----------------------------------------------------------------------------
   //! Vector read - async
@@ -140,11 +145,7 @@ public:
   //! @return 0(SFS_OK) if request successfully sent, otherwise -1 (SFS_ERROR)
   //----------------------------------------------------------------------------
   virtual int64_t fileReadVAsync(XrdCl::ChunkList& chunkList,
-                                 uint16_t timeout = 0)
-  {
-    errno = EOPNOTSUPP;
-    return -1;
-  }
+                                 uint16_t timeout = 0);
 
   //----------------------------------------------------------------------------
   //! Write to file - async
@@ -161,6 +162,13 @@ public:
                                  XrdSfsXferSize length,
                                  uint16_t timeout = 0);
 
+  //----------------------------------------------------------------------------
+  //! Wait for all async IO
+  //!
+  //! @return 0 if all async requests succeeded, -1 otherwise
+  //----------------------------------------------------------------------------
+  virtual int fileWaitAsyncIO();
+
   //----------------------------------------------------------------------------
   //! Truncate
   //!
@@ -385,8 +393,49 @@ public:
   //----------------------------------------------------------------------------
   virtual int ftsClose(FileIo::FtsHandle* fts_handle);
 
+protected:
+  //----------------------------------------------------------------------------
+  //! Vector transfer at the given offset done by the IO threads for the
+  //! asynchronous requests
+  //!
+  //! @param isWrite write if true, otherwise read
+  //! @param offset offset in file
+  //! @param iov buffers
+  //! @param iovcnt number of buffers
+  //!
+  //! @return number of bytes transferred, less than requested only at the
+  //!         end of the file, or -1 if error and errno is set
+  //----------------------------------------------------------------------------
+  virtual int64_t fileTransferV(bool isWrite, XrdSfsFileOffset offset,
+                                const struct iovec* iov, int iovcnt);
+
+  //----------------------------------------------------------------------------
+  //! Wait for the asynchronous requests in flight to complete
+  //----------------------------------------------------------------------------
+  void WaitAsync();
+
 private:
   int mFd; //< file descriptor to filesystem file
+  bool mDirectIo; ///< file opened with O_DIRECT
+  int mBufferedFd; ///< descriptor without O_DIRECT for unaligned writes
+  std::unique_ptr<AsyncMetaHandler> mMetaHandler; ///< async responses
+  std::unique_ptr<AsyncIoQueue> mAsyncQueue; ///< async requests, after handler
+
+  //----------------------------------------------------------------------------
+  //! Get the queue of asynchronous requests, created on first use
+  //!
+  //! @return queue or nullptr if the asynchronous mode is disabled
+  //----------------------------------------------------------------------------
+  AsyncIoQueue* GetAsyncQueue();
+
+  //----------------------------------------------------------------------------
+  //! Vector transfer on a file opened with O_DIRECT for buffers, offsets or
+  //! lengths which are not aligned, through an aligned bounce buffer
+  //!
+  //! @return same as fileTransferV
+  //----------------------------------------------------------------------------
+  int64_t DirectTransferV(bool isWrite, XrdSfsFileOffset offset,
+                          const struct iovec* iov, int iovcnt);
 
   //----------------------------------------------------------------------------
   //! Disable copy constructor
@@ -114,15 +114,6 @@ LocalIo::fileReadV(XrdCl::ChunkList& chunkList, uint16_t timeout)
   return nread;
 }
 
-//--------------------------------------------------------------------------
-// Vector read - async - in this case it is the same as the sync one
-//--------------------------------------------------------------------------
-int64_t
-LocalIo::fileReadVAsync(XrdCl::ChunkList& chunkList, uint16_t timeout)
-{
-  return fileReadV(chunkList, timeout);
-}
-
 //------------------------------------------------------------------------------
 // Write to file - sync
 //------------------------------------------------------------------------------
@@ -137,17 +128,7 @@ LocalIo::fileWrite(XrdSfsFileOffset offset, const char* buffer,
 }
 
 //------------------------------------------------------------------------------
-// Read from file async - falls back on synchronous mode
-//------------------------------------------------------------------------------
-int64_t
-LocalIo::fileReadAsync(XrdSfsFileOffset offset, char* buffer,
-                       XrdSfsXferSize length, bool readahead, uint16_t timeout)
-{
-  return fileRead(offset, buffer, length, timeout);
-}
-
-//------------------------------------------------------------------------------
-// Write to file async - falls back on synchronous mode
+// Write to file async - done in synchronous mode
 //------------------------------------------------------------------------------
 int64_t
 LocalIo::fileWriteAsync(XrdSfsFileOffset offset, const char* buffer,
@@ -162,6 +143,7 @@ LocalIo::fileWriteAsync(XrdSfsFileOffset offset, const char* buffer,
 int
 LocalIo::fileTruncate(XrdSfsFileOffset offset, uint16_t timeout)
 {
+  WaitAsync();
   return mLogicalFile->truncateofs(offset);
 }
 
@@ -244,6 +226,7 @@ LocalIo::fileFdeallocate(XrdSfsFileOffset fromOffset,
 int
 LocalIo::fileSync(uint16_t timeout)
 {
+  WaitAsync();
   return mLogicalFile->syncofs();
 }
 
@@ -278,6 +261,7 @@ LocalIo::fileExists()
 int
 LocalIo::fileClose(uint16_t timeout)
 {
+  WaitAsync();
   mIsOpen = false;
   return mLogicalFile->closeofs();
 }
@@ -302,4 +286,36 @@ LocalIo::fileRemove(uint16_t timeout)
   return SFS_OK;
 }
 
+//------------------------------------------------------------------------------
+// Vector transfer for the asynchronous requests
+//------------------------------------------------------------------------------
+int64_t
+LocalIo::fileTransferV(bool isWrite, XrdSfsFileOffset offset,
+                       const struct iovec* iov, int iovcnt)
+{
+  int64_t total = 0;
+
+  for (int i = 0; i < iovcnt; ++i) {
+    int64_t nbytes = (isWrite ?
+                      mLogicalFile->writeofs(offset + total,
+                                             (const char*) iov[i].iov_base,
+                                             iov[i].iov_len) :
+                      mLogicalFile->readofs(offset + total,
+                                            (char*) iov[i].iov_base,
+                                            iov[i].iov_len));
+
+    if (nbytes < 0) {
+      return SFS_ERROR;
+    }
+
+    total += nbytes;
+
+    if ((size_t) nbytes != iov[i].iov_len) {
+      break;
+    }
+  }
+
+  return total;
+}
+
 EOSFSTNAMESPACE_END
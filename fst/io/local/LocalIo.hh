@@ -91,19 +91,6 @@ public:
   virtual int64_t fileReadV(XrdCl::ChunkList& chunkList, uint16_t timeout = 0);
 
 
-  //------------------------------------------------------------------------------
-  //! Vector read - async
-  //!
-  //! @param chunkList list of chunks for the vector read
-  //! @param timeout timeout value
-  //!
-  //! @return number of bytes read of -1 if error; this actually calls the
-  //!         ReadV sync method
-  //------------------------------------------------------------------------------
-  virtual int64_t fileReadVAsync(XrdCl::ChunkList& chunkList,
-                                 uint16_t timeout = 0);
-
-
   //----------------------------------------------------------------------------
   //! Write to file - sync
   //!
@@ -118,16 +105,8 @@ public:
                     XrdSfsXferSize length, uint16_t timeout = 0);
 
   //--------------------------------------------------------------------------
-  //! Read from file - async
-  //!
-  //! @return number of bytes read or -1 if error
-  //--------------------------------------------------------------------------
-  int64_t fileReadAsync(XrdSfsFileOffset offset, char* buffer,
-                        XrdSfsXferSize length, bool readahead = false,
-                        uint16_t timeout = 0);
-
-  //--------------------------------------------------------------------------
-  //! Write to file - async
+  //! Write to file - async, done synchronously as the OFS layer reports the
+  //! write errors (e.g. disk full) through the error object of the file
   //!
   //! @return number of bytes written or -1 if error
   //--------------------------------------------------------------------------
@@ -216,6 +195,14 @@ public:
   //----------------------------------------------------------------------------
   int fileStat(struct stat* buf, uint16_t timeout = 0);
 
+protected:
+  //----------------------------------------------------------------------------
+  //! Vector transfer for the asynchronous reads, done through the OFS layer
+  //! so that the accounting of the logical file stays correct
+  //----------------------------------------------------------------------------
+  virtual int64_t fileTransferV(bool isWrite, XrdSfsFileOffset offset,
+                                const struct iovec* iov, int iovcnt);
+
 private:
   XrdFstOfsFile* mLogicalFile; ///< handler to logical file
   const XrdSecEntity* mSecEntity; ///< security entity
@@ -0,0 +1,293 @@
+//------------------------------------------------------------------------------
+//! @file ReadaheadStrategy.cc
+//! @brief Access pattern detection and adaptive readahead window for XrdIo
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fst/io/xrd/ReadaheadStrategy.hh"
+#include <algorithm>
+#include <cstdio>
+
+EOSFSTNAMESPACE_BEGIN
+
+namespace
+{
+//! Maximum stride of a strided stream in blocks
+const uint64_t sMaxStrideBlocks = 16;
+}
+
+//------------------------------------------------------------------------------
+// Get the counters as an env string
+//------------------------------------------------------------------------------
+std::string
+ReadaheadStats::ToString() const
+{
+  char buffer[512];
+  snprintf(buffer, sizeof(buffer),
+           "ra_reads=%llu&ra_hitb=%llu&ra_missb=%llu&ra_prefetches=%llu&"
+           "ra_prefetchb=%llu&ra_wastes=%llu&ra_wasteb=%llu&ra_streams=%llu&"
+           "ra_hitrate=%.02f",
+           (unsigned long long) mReads, (unsigned long long) mHitBytes,
+           (unsigned long long) mMissBytes, (unsigned long long) mPrefetches,
+           (unsigned long long) mPrefetchedBytes, (unsigned long long) mWastes,
+           (unsigned long long) mWastedBytes, (unsigned long long) mStreams,
+           GetHitRate());
+  return buffer;
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+ReadaheadStrategy::ReadaheadStrategy(uint64_t blocksize, uint32_t initWindow,
+                                     uint32_t maxWindow, uint32_t maxStreams):
+  mNextId(1), mClock(0), mStats()
+{
+  Configure(blocksize, initWindow, maxWindow, maxStreams);
+}
+
+//------------------------------------------------------------------------------
+// Reconfigure and forget all the streams
+//------------------------------------------------------------------------------
+void
+ReadaheadStrategy::Configure(uint64_t blocksize, uint32_t initWindow,
+                             uint32_t maxWindow, uint32_t maxStreams)
+{
+  mBlocksize = std::max<uint64_t>(blocksize, 1);
+  mInitWindow = std::max<uint32_t>(initWindow, 1);
+  mMaxWindow = std::max(maxWindow, mInitWindow);
+  mStreams.assign(std::max<uint32_t>(maxStreams, 1), Stream());
+
+  for (auto& stream : mStreams) {
+    stream.mId = 0;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Find the stream matching a read and update its pattern. An established
+// stride matching exactly is preferred, then a sequential continuation
+// allowing a gap up to the size of the previous read, then a stream seen
+// only once which gets its stride from this read.
+//------------------------------------------------------------------------------
+ReadaheadStrategy::Stream*
+ReadaheadStrategy::Match(uint64_t offset, uint32_t length)
+{
+  Stream* strided = nullptr;
+  Stream* sequential = nullptr;
+  Stream* candidate = nullptr;
+  Stream* victim = &mStreams.front();
+
+  for (auto& stream : mStreams) {
+    if (!stream.mId) {
+      if (victim->mId) {
+        victim = &stream;
+      }
+
+      continue;
+    }
+
+    if (victim->mId && (stream.mLastUse < victim->mLastUse)) {
+      victim = &stream;
+    }
+
+    uint64_t last_end = stream.mLastOffset + stream.mLastLength;
+
+    if (stream.mStride && (offset == stream.mLastOffset + stream.mStride)) {
+      strided = &stream;
+      break;
+    }
+
+    if (!sequential && (offset >= stream.mLastOffset) &&
+        (offset <= last_end + stream.mLastLength)) {
+      sequential = &stream;
+    } else if (!stream.mConfirmed &&
+               (offset > last_end + stream.mLastLength) &&
+               (offset - stream.mLastOffset <= sMaxStrideBlocks * mBlocksize) &&
+               (!candidate || (stream.mLastOffset > candidate->mLastOffset))) {
+      candidate = &stream;
+    }
+  }
+
+  Stream* match = (strided ? strided : (sequential ? sequential : candidate));
+
+  if (!match) {
+    // New stream replacing the least recently used one
+    victim->mId = mNextId++;
+    victim->mLastOffset = offset;
+    victim->mLastLength = length;
+    victim->mStride = 0;
+    victim->mConfirmed = false;
+    victim->mWindow = mInitWindow;
+    victim->mUsed = 0;
+    victim->mNextPrefetch = 0;
+    victim->mLastUse = mClock;
+    ++mStats.mStreams;
+    return nullptr;
+  }
+
+  if (match == strided) {
+    match->mConfirmed = true;
+  } else if (match == sequential) {
+    if (match->mStride) {
+      match->mStride = 0;
+      match->mNextPrefetch = 0;
+    }
+
+    match->mConfirmed = true;
+  } else {
+    match->mStride = offset - match->mLastOffset;
+    match->mNextPrefetch = 0;
+  }
+
+  match->mLastOffset = offset;
+  match->mLastLength = length;
+  match->mLastUse = mClock;
+  return match;
+}
+
+//------------------------------------------------------------------------------
+// Account a read and get the ranges worth prefetching after it
+//------------------------------------------------------------------------------
+void
+ReadaheadStrategy::Read(uint64_t offset, uint32_t length,
+                        std::vector<Prefetch>& ranges)
+{
+  ++mClock;
+  ++mStats.mReads;
+  Stream* stream = Match(offset, length);
+
+  if (!stream || !stream->mConfirmed || !length) {
+    return;
+  }
+
+  if (!stream->mStride) {
+    // Sequential - the blocks following the read
+    uint64_t pos = std::max(stream->mNextPrefetch, offset + length);
+    uint64_t limit = offset + length + stream->mWindow * mBlocksize;
+
+    for (; pos < limit; pos += mBlocksize) {
+      ranges.push_back({pos, (uint32_t) mBlocksize, stream->mId});
+    }
+
+    stream->mNextPrefetch = pos;
+  } else {
+    // Strided - the next records of the same length
+    uint32_t len = (uint32_t) std::min<uint64_t>(length, mBlocksize);
+    uint64_t pos = std::max(stream->mNextPrefetch, offset + stream->mStride);
+    uint64_t limit = offset + stream->mWindow * stream->mStride;
+
+    for (; pos <= limit; pos += stream->mStride) {
+      ranges.push_back({pos, len, stream->mId});
+    }
+
+    stream->mNextPrefetch = pos;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Report bytes served from a prefetched block - once a whole window was
+// used the window of the stream is doubled
+//------------------------------------------------------------------------------
+void
+ReadaheadStrategy::Hit(uint64_t stream, uint64_t nbytes)
+{
+  mStats.mHitBytes += nbytes;
+  Stream* ptr = Find(stream);
+
+  if (!ptr) {
+    return;
+  }
+
+  uint64_t unit = (ptr->mStride ? ptr->mLastLength : mBlocksize);
+  ptr->mUsed += nbytes;
+
+  if (ptr->mUsed >= ptr->mWindow * unit) {
+    ptr->mWindow = std::min(2 * ptr->mWindow, mMaxWindow);
+    ptr->mUsed = 0;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Report bytes read without readahead
+//------------------------------------------------------------------------------
+void
+ReadaheadStrategy::Miss(uint64_t nbytes)
+{
+  mStats.mMissBytes += nbytes;
+}
+
+//------------------------------------------------------------------------------
+// Report a prefetch request sent
+//------------------------------------------------------------------------------
+void
+ReadaheadStrategy::Prefetched(uint64_t nbytes)
+{
+  ++mStats.mPrefetches;
+  mStats.mPrefetchedBytes += nbytes;
+}
+
+//------------------------------------------------------------------------------
+// Report a prefetched block dropped unused - the window of the stream is
+// halved
+//------------------------------------------------------------------------------
+void
+ReadaheadStrategy::Waste(uint64_t stream, uint64_t nbytes)
+{
+  ++mStats.mWastes;
+  mStats.mWastedBytes += nbytes;
+  Stream* ptr = Find(stream);
+
+  if (ptr) {
+    ptr->mWindow = std::max(ptr->mWindow / 2, 1u);
+    ptr->mUsed = 0;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get the window of a stream
+//------------------------------------------------------------------------------
+uint32_t
+ReadaheadStrategy::GetWindow(uint64_t stream) const
+{
+  const Stream* ptr = Find(stream);
+  return (ptr ? ptr->mWindow : 0);
+}
+
+//------------------------------------------------------------------------------
+// Find a stream by id
+//------------------------------------------------------------------------------
+ReadaheadStrategy::Stream*
+ReadaheadStrategy::Find(uint64_t stream)
+{
+  for (auto& ptr : mStreams) {
+    if (ptr.mId && (ptr.mId == stream)) {
+      return &ptr;
+    }
+  }
+
+  return nullptr;
+}
+
+const ReadaheadStrategy::Stream*
+ReadaheadStrategy::Find(uint64_t stream) const
+{
+  return const_cast<ReadaheadStrategy*>(this)->Find(stream);
+}
+
+EOSFSTNAMESPACE_END
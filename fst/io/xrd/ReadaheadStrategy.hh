@@ -0,0 +1,184 @@
+//------------------------------------------------------------------------------
+//! @file ReadaheadStrategy.hh
+//! @brief Access pattern detection and adaptive readahead window for XrdIo
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __EOSFST_READAHEADSTRATEGY_HH__
+#define __EOSFST_READAHEADSTRATEGY_HH__
+
+#include "fst/Namespace.hh"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+EOSFSTNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Readahead counters of one file
+//------------------------------------------------------------------------------
+struct ReadaheadStats {
+  uint64_t mReads; ///< number of reads seen
+  uint64_t mHitBytes; ///< bytes served from prefetched blocks
+  uint64_t mMissBytes; ///< bytes read without readahead
+  uint64_t mPrefetches; ///< number of prefetch requests sent
+  uint64_t mPrefetchedBytes; ///< bytes requested by the prefetches
+  uint64_t mWastes; ///< number of prefetched blocks dropped unused
+  uint64_t mWastedBytes; ///< bytes of the prefetched blocks dropped unused
+  uint64_t mStreams; ///< number of streams detected
+
+  //----------------------------------------------------------------------------
+  //! Get the fraction of the bytes read served by readahead
+  //----------------------------------------------------------------------------
+  double GetHitRate() const
+  {
+    uint64_t total = mHitBytes + mMissBytes;
+    return (total ? (1.0 * mHitBytes / total) : 0.0);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the counters as an env string
+  //----------------------------------------------------------------------------
+  std::string ToString() const;
+};
+
+//------------------------------------------------------------------------------
+//! Access pattern detection for the readahead of one file. Several
+//! concurrent streams are tracked, each being either sequential, allowing
+//! small gaps between reads, or strided with a constant distance between the
+//! reads. Once a stream is confirmed by a second read matching its pattern
+//! the strategy proposes to prefetch the next blocks (sequential) or records
+//! (strided) up to the window of the stream. The window grows when all the
+//! prefetched data gets used and shrinks when prefetched blocks are dropped
+//! unused. Streams not used for the longest time are replaced by new ones.
+//------------------------------------------------------------------------------
+class ReadaheadStrategy
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Range proposed for prefetching
+  //----------------------------------------------------------------------------
+  struct Prefetch {
+    uint64_t mOffset; ///< offset in file
+    uint32_t mLength; ///< length, at most one block
+    uint64_t mStream; ///< id of the stream to report hits and wastes
+  };
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param blocksize size of a prefetch block
+  //! @param initWindow initial window of a stream in blocks or records
+  //! @param maxWindow maximum window of a stream
+  //! @param maxStreams maximum number of streams tracked
+  //----------------------------------------------------------------------------
+  ReadaheadStrategy(uint64_t blocksize = 1024 * 1024, uint32_t initWindow = 2,
+                    uint32_t maxWindow = 8, uint32_t maxStreams = 8);
+
+  //----------------------------------------------------------------------------
+  //! Reconfigure and forget all the streams, the counters are kept
+  //----------------------------------------------------------------------------
+  void Configure(uint64_t blocksize, uint32_t initWindow, uint32_t maxWindow,
+                 uint32_t maxStreams);
+
+  //----------------------------------------------------------------------------
+  //! Account a read and get the ranges worth prefetching after it. A range
+  //! is proposed only once per stream.
+  //!
+  //! @param offset read offset
+  //! @param length read length
+  //! @param ranges appended the ranges to prefetch
+  //----------------------------------------------------------------------------
+  void Read(uint64_t offset, uint32_t length, std::vector<Prefetch>& ranges);
+
+  //----------------------------------------------------------------------------
+  //! Report bytes served from a block prefetched for a stream
+  //----------------------------------------------------------------------------
+  void Hit(uint64_t stream, uint64_t nbytes);
+
+  //----------------------------------------------------------------------------
+  //! Report bytes read without readahead
+  //----------------------------------------------------------------------------
+  void Miss(uint64_t nbytes);
+
+  //----------------------------------------------------------------------------
+  //! Report a prefetch request sent for a stream
+  //----------------------------------------------------------------------------
+  void Prefetched(uint64_t nbytes);
+
+  //----------------------------------------------------------------------------
+  //! Report a block prefetched for a stream dropped without being used
+  //----------------------------------------------------------------------------
+  void Waste(uint64_t stream, uint64_t nbytes);
+
+  //----------------------------------------------------------------------------
+  //! Get the window of the stream, 0 if not tracked anymore
+  //----------------------------------------------------------------------------
+  uint32_t GetWindow(uint64_t stream) const;
+
+  //----------------------------------------------------------------------------
+  //! Get the counters
+  //----------------------------------------------------------------------------
+  const ReadaheadStats& GetStats() const
+  {
+    return mStats;
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  //! State of a stream
+  //----------------------------------------------------------------------------
+  struct Stream {
+    uint64_t mId; ///< unique id, 0 if the slot is unused
+    uint64_t mLastOffset; ///< offset of the last read
+    uint32_t mLastLength; ///< length of the last read
+    uint64_t mStride; ///< distance between reads if strided, 0 if sequential
+    bool mConfirmed; ///< pattern seen at least twice
+    uint32_t mWindow; ///< number of blocks or records to prefetch ahead
+    uint64_t mUsed; ///< bytes used since the last window adjustment
+    uint64_t mNextPrefetch; ///< offset from which nothing was proposed yet
+    uint64_t mLastUse; ///< logical time of the last read
+  };
+
+  uint64_t mBlocksize; ///< size of a prefetch block
+  uint32_t mInitWindow; ///< initial window of a stream
+  uint32_t mMaxWindow; ///< maximum window of a stream
+  std::vector<Stream> mStreams; ///< streams tracked
+  uint64_t mNextId; ///< next stream id
+  uint64_t mClock; ///< logical time, incremented on each read
+  ReadaheadStats mStats; ///< counters
+
+  //----------------------------------------------------------------------------
+  //! Find the stream matching a read and update its pattern
+  //!
+  //! @return matched stream or nullptr if the read starts a new stream
+  //----------------------------------------------------------------------------
+  Stream* Match(uint64_t offset, uint32_t length);
+
+  //----------------------------------------------------------------------------
+  //! Find a stream by id
+  //----------------------------------------------------------------------------
+  Stream* Find(uint64_t stream);
+  const Stream* Find(uint64_t stream) const;
+};
+
+EOSFSTNAMESPACE_END
+
+#endif // __EOSFST_READAHEADSTRATEGY_HH__
@@ -98,10 +98,13 @@ XrdIo::XrdIo(std::string path) :
   FileIo(path, "XrdIo"),
   mDoReadahead(false),
   mNumRdAheadBlocks(InitNumRdAheadBlocks()),
+  mMaxRdAheadBlocks(InitMaxRdAheadBlocks()),
   mDefaultBlocksize(InitBlocksize()),
   mBlocksize(mDefaultBlocksize),
   mXrdFile(NULL),
   mMetaHandler(new AsyncMetaHandler()),
+  mNumBlocks(0),
+  mBlockSeq(0),
   mConnectionId(0)
 {
   // Set the TimeoutResolution to 1
@@ -188,9 +191,9 @@ XrdIo::fileOpen(XrdSfsFileOpenMode flags,
       mBlocksize = static_cast<uint64_t>(atoll(val));
     }
 
-    for (unsigned int i = 0; i < mNumRdAheadBlocks; i++) {
-      mQueueBlocks.push(new ReadaheadBlock(mBlocksize));
-    }
+    // Blocks are allocated on demand up to mMaxRdAheadBlocks
+    mReadahead.Configure(mBlocksize, mNumRdAheadBlocks, mMaxRdAheadBlocks,
+                         mMaxRdAheadBlocks);
   }
 
   // Final path + opaque info used in the open
@@ -270,9 +273,9 @@ XrdIo::fileOpenAsync(void* io_handler,
       mBlocksize = static_cast<uint64_t>(atoll(val));
     }
 
-    for (unsigned int i = 0; i < mNumRdAheadBlocks; i++) {
-      mQueueBlocks.push(new ReadaheadBlock(mBlocksize));
-    }
+    // Blocks are allocated on demand up to mMaxRdAheadBlocks
+    mReadahead.Configure(mBlocksize, mNumRdAheadBlocks, mMaxRdAheadBlocks,
+                         mMaxRdAheadBlocks);
   }
 
   request = mFilePath;
@@ -409,98 +412,81 @@ XrdIo::fileReadAsync(XrdSfsFileOffset offset, char* buffer,
     uint32_t aligned_length;
     uint32_t shift;
     std::map<uint64_t, ReadaheadBlock*>::iterator iter;
+    std::vector<ReadaheadStrategy::Prefetch> ranges;
     mPrefetchMutex.Lock(); // -->
+    // Let the strategy match the read against the detected streams
+    mReadahead.Read(offset, length, ranges);
 
     while (length) {
       iter = FindBlock(offset);
 
-      if (iter != mMapBlocks.end()) {
-        // Block found in prefetched blocks
-        SimpleHandler* sh = iter->second->handler;
-        shift = offset - iter->first;
-
-        // We can prefetch another block if we still have available blocks in
-        // the queue or if first read was from second prefetched block
-        if (!mQueueBlocks.empty() || (iter != mMapBlocks.begin())) {
-          if (iter != mMapBlocks.begin()) {
-            eos_debug("recycle the oldest block");
-            mQueueBlocks.push(mMapBlocks.begin()->second);
-            mMapBlocks.erase(mMapBlocks.begin());
-          }
-
-          eos_debug("prefetch new block(2)");
-
-          if (!PrefetchBlock(offset + mBlocksize, false, timeout)) {
-            eos_warning("failed to send prefetch request(2)");
-            break;
-          }
-        }
+      if (iter == mMapBlocks.end()) {
+        break;
+      }
 
-        if (sh->WaitOK()) {
-          eos_debug("block in cache, blk_off=%lld, req_off= %lld", iter->first, offset);
-
-          if (sh->GetRespLength() == 0) {
-            // The request got a response but it read 0 bytes
-            eos_warning("response contains 0 bytes");
-            done_read = true;
-            break;
-          }
-
-          aligned_length = sh->GetRespLength() - shift;
-          read_length = ((uint32_t) length < aligned_length) ? length : aligned_length;
-
-          // If prefetch block smaller than mBlocksize and current offset at end
-          // of the prefetch block then we reached the end of file
-          if ((sh->GetRespLength() != mBlocksize) &&
-              ((uint64_t) offset >= iter->first + sh->GetRespLength())) {
-            done_read = true;
-            break;
-          }
-
-          pBuff = static_cast<char*>(memcpy(pBuff, iter->second->buffer + shift,
-                                            read_length));
-          pBuff += read_length;
-          offset += read_length;
-          length -= read_length;
-          nread += read_length;
-        } else {
-          // Error while prefetching, remove block from map
-          mQueueBlocks.push(iter->second);
-          mMapBlocks.erase(iter);
-          eos_err("error=prefetching failed, disable it and remove block from map");
-          mDoReadahead = false;
+      // Block found in prefetched blocks
+      ReadaheadBlock* block = iter->second;
+      SimpleHandler* sh = block->handler;
+      shift = offset - iter->first;
+
+      if (!sh->WaitOK()) {
+        // Error while prefetching, remove block from map
+        mQueueBlocks.push(block);
+        mMapBlocks.erase(iter);
+        eos_err("error=prefetching failed, disable it and remove block from map");
+        mDoReadahead = false;
+        break;
+      }
+
+      eos_debug("block in cache, blk_off=%lld, req_off= %lld", iter->first, offset);
+
+      // If the prefetch block is smaller than requested and the current
+      // offset is at the end of the block then we reached the end of file
+      if (shift >= sh->GetRespLength()) {
+        done_read = (sh->GetRespLength() < sh->GetLength());
+        break;
+      }
+
+      aligned_length = sh->GetRespLength() - shift;
+      read_length = ((uint32_t) length < aligned_length) ? length : aligned_length;
+      pBuff = static_cast<char*>(memcpy(pBuff, block->buffer + shift,
+                                        read_length));
+      pBuff += read_length;
+      offset += read_length;
+      length -= read_length;
+      nread += read_length;
+      block->used += read_length;
+      mReadahead.Hit(block->stream, read_length);
+
+      // A block read up to its end is not needed anymore
+      if (shift + read_length == sh->GetRespLength()) {
+        done_read = (length && (sh->GetRespLength() < sh->GetLength()));
+        RecycleBlock(iter);
+
+        if (done_read) {
           break;
         }
-      } else {
-        // Remove all elements from map so that we can align with the new
-        // requests and prefetch a new block. But first we need to collect any
-        // responses which are in-flight as otherwise these response might
-        // arrive later on, when we are expecting replies for other blocks since
-        // we are recycling the SimpleHandler objects.
-        while (!mMapBlocks.empty()) {
-          SimpleHandler* sh = mMapBlocks.begin()->second->handler;
-
-          if (sh->HasRequest()) {
-            // Not interested in the result - discard it
-            sh->WaitOK();
-          }
-
-          mQueueBlocks.push(mMapBlocks.begin()->second);
-          mMapBlocks.erase(mMapBlocks.begin());
-        }
+      }
+    }
+
+    // Prefetch the ranges proposed by the strategy which are not yet cached
+    for (auto it = ranges.begin(); mDoReadahead && (it != ranges.end()); ++it) {
+      if (FindBlock(it->mOffset) != mMapBlocks.end()) {
+        continue;
+      }
 
-        if (!mQueueBlocks.empty()) {
-          eos_debug("prefetch new block(1)");
+      eos_debug("prefetch new block stream=%llu", it->mStream);
 
-          if (!PrefetchBlock(offset, false, timeout)) {
-            eos_err("error=failed to send prefetch request(1)");
-            mDoReadahead = false;
-            break;
-          }
-        }
+      if (!PrefetchBlock(it->mOffset, it->mLength, it->mStream, timeout)) {
+        eos_warning("failed to send prefetch request");
+        break;
       }
     }
 
+    if (length && !done_read) {
+      mReadahead.Miss(length);
+    }
+
     mPrefetchMutex.UnLock(); // <--
 
     // If readahead not useful, use the classic way to read
@@ -529,7 +515,7 @@ XrdIo::fileReadAsync(XrdSfsFileOffset offset, char* buffer,
         mMetaHandler->HandleResponse(&status, handler);
       }
 
-      nread = length;
+      nread += length;
     }
   }
 
@@ -559,7 +545,8 @@ XrdIo::FindBlock(uint64_t offset)
       // Check if the previous block, we know the map is not empty
       iter--;
 
-      if ((iter->first <= offset) && (offset < (iter->first + mBlocksize))) {
+      if ((iter->first <= offset) &&
+          (offset < (iter->first + iter->second->handler->GetLength()))) {
         return iter;
       } else {
         return mMapBlocks.end();
@@ -717,7 +704,7 @@ XrdIo::fileWaitAsyncIO()
   {
     XrdSysMutexHelper scope_lock(mPrefetchMutex);
 
-    // Wait for any requests on the fly and then close
+    // Wait for any requests on the fly and recycle the blocks
     while (!mMapBlocks.empty()) {
       SimpleHandler* shandler = mMapBlocks.begin()->second->handler;
 
@@ -725,8 +712,7 @@ XrdIo::fileWaitAsyncIO()
         async_ok = shandler->WaitOK();
       }
 
-      delete mMapBlocks.begin()->second;
-      mMapBlocks.erase(mMapBlocks.begin());
+      RecycleBlock(mMapBlocks.begin());
     }
   }
 
@@ -871,6 +857,11 @@ XrdIo::fileClose(uint16_t timeout)
     async_ok = false;
   }
 
+  if (mDoReadahead || mNumBlocks) {
+    eos_info("path=%s %s", mFilePath.c_str(),
+             GetReadaheadStats().ToString().c_str());
+  }
+
   XrdCl::XRootDStatus status = mXrdFile->Close(timeout);
 
   if (!status.IsOK()) {
@@ -985,36 +976,29 @@ void
 XrdIo::CleanReadCache()
 {
   fileWaitAsyncIO();
-
-  if (mQueueBlocks.empty()) {
-    for (unsigned int i = 0; i < mNumRdAheadBlocks; i++) {
-      mQueueBlocks.push(new ReadaheadBlock(mBlocksize));
-    }
-  }
 }
 
 //------------------------------------------------------------------------------
 // Prefetch block using the readahead mechanism
 //------------------------------------------------------------------------------
 bool
-XrdIo::PrefetchBlock(int64_t offset, bool isWrite, uint16_t timeout)
+XrdIo::PrefetchBlock(int64_t offset, uint32_t length, uint64_t stream,
+                     uint16_t timeout)
 {
-  bool done = true;
   XrdCl::XRootDStatus status;
-  ReadaheadBlock* block = NULL;
-  eos_debug("try to prefetch with offset: %lli, length: %4u",
-            offset, mBlocksize);
+  ReadaheadBlock* block = GetFreeBlock();
+  eos_debug("try to prefetch with offset: %lli, length: %4u", offset, length);
 
-  if (!mQueueBlocks.empty()) {
-    block = mQueueBlocks.front();
-    mQueueBlocks.pop();
-  } else {
-    done = false;
-    return done;
+  if (!block) {
+    return false;
   }
 
-  block->handler->Update(offset, mBlocksize, isWrite);
-  status = mXrdFile->Read(offset, mBlocksize, block->buffer, block->handler,
+  length = std::min(length, mBlocksize);
+  block->handler->Update(offset, length, false);
+  block->stream = stream;
+  block->used = 0;
+  block->seq = mBlockSeq++;
+  status = mXrdFile->Read(offset, length, block->buffer, block->handler,
                           timeout);
 
   if (!status.IsOK()) {
@@ -1022,12 +1006,68 @@ XrdIo::PrefetchBlock(int64_t offset, bool isWrite, uint16_t timeout)
     XrdCl::XRootDStatus* tmp_status = new XrdCl::XRootDStatus(status);
     block->handler->HandleResponse(tmp_status, NULL);
     mQueueBlocks.push(block);
-    done = false;
-  } else {
-    mMapBlocks.insert(std::make_pair(offset, block));
+    return false;
+  }
+
+  mMapBlocks.insert(std::make_pair(offset, block));
+  mReadahead.Prefetched(length);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Get a block for prefetching
+//------------------------------------------------------------------------------
+ReadaheadBlock*
+XrdIo::GetFreeBlock()
+{
+  if (mQueueBlocks.empty()) {
+    if (mNumBlocks < mMaxRdAheadBlocks) {
+      ++mNumBlocks;
+      return new ReadaheadBlock(mBlocksize);
+    }
+
+    if (mMapBlocks.empty()) {
+      return NULL;
+    }
+
+    // Evict the block prefetched first
+    PrefetchMap::iterator oldest = mMapBlocks.begin();
+
+    for (auto iter = mMapBlocks.begin(); iter != mMapBlocks.end(); ++iter) {
+      if (iter->second->seq < oldest->second->seq) {
+        oldest = iter;
+      }
+    }
+
+    eos_debug("recycle the oldest block");
+    RecycleBlock(oldest);
+  }
+
+  ReadaheadBlock* block = mQueueBlocks.front();
+  mQueueBlocks.pop();
+  return block;
+}
+
+//------------------------------------------------------------------------------
+// Put back a prefetched block in the queue of available blocks
+//------------------------------------------------------------------------------
+void
+XrdIo::RecycleBlock(PrefetchMap::iterator iter)
+{
+  ReadaheadBlock* block = iter->second;
+
+  // Collect any response in-flight as the handler object is reused and the
+  // response could otherwise arrive while we are expecting another one
+  if (block->handler->HasRequest()) {
+    (void) block->handler->WaitOK();
+  }
+
+  if (!block->used) {
+    mReadahead.Waste(block->stream, block->handler->GetLength());
   }
 
-  return done;
+  mQueueBlocks.push(block);
+  mMapBlocks.erase(iter);
 }
 
 //------------------------------------------------------------------------------
@@ -27,8 +27,10 @@
 
 #include "fst/io/FileIo.hh"
 #include "fst/io/SimpleHandler.hh"
+#include "fst/io/xrd/ReadaheadStrategy.hh"
 #include "common/FileMap.hh"
 #include "XrdCl/XrdClFile.hh"
+#include <algorithm>
 #include <queue>
 
 EOSFSTNAMESPACE_BEGIN
@@ -87,7 +89,8 @@ struct ReadaheadBlock {
   //!
   //! @param blocksize the size of the readahead
   //----------------------------------------------------------------------------
-  ReadaheadBlock(uint64_t blocksize)
+  ReadaheadBlock(uint64_t blocksize):
+    stream(0), used(0), seq(0)
   {
     buffer = new char[blocksize];
     handler = new SimpleHandler();
@@ -116,6 +119,9 @@ struct ReadaheadBlock {
 
   char* buffer; ///< pointer to where the data is read
   SimpleHandler* handler; ///< async handler for the requests
+  uint64_t stream; ///< readahead stream for which the block was prefetched
+  uint64_t used; ///< bytes served from the block
+  uint64_t seq; ///< prefetch sequence number, the lowest is evicted first
 };
 
 
@@ -151,6 +157,20 @@ public:
     return (ptr ? strtoul(ptr, 0, 10) : 2ul);
   }
 
+  //----------------------------------------------------------------------------
+  //! InitMaxRdAheadBlocks
+  //!
+  //! @return : maximum number of blocks a file can use for readahead, the
+  //!           readahead window of a stream grows up to this value
+  //----------------------------------------------------------------------------
+  static uint32_t InitMaxRdAheadBlocks()
+  {
+    char* ptr = getenv("EOS_FST_XRDIO_RDAHEAD_MAX_BLOCKS");
+    // default is 8 if envar is not set
+    uint32_t max_blocks = (ptr ? strtoul(ptr, 0, 10) : 8ul);
+    return std::max(max_blocks, InitNumRdAheadBlocks());
+  }
+
   //----------------------------------------------------------------------------
   //! GetDefaultBlocksize
   //!
@@ -161,6 +181,15 @@ public:
     return mBlocksize;
   }
 
+  //----------------------------------------------------------------------------
+  //! Get the readahead counters of the file
+  //----------------------------------------------------------------------------
+  ReadaheadStats GetReadaheadStats()
+  {
+    XrdSysMutexHelper scope_lock(mPrefetchMutex);
+    return mReadahead.GetStats();
+  }
+
   //----------------------------------------------------------------------------
   //! Constructor
   //!
@@ -546,12 +575,16 @@ private:
 
   bool mDoReadahead; ///< mark if readahead is enabled
   const uint32_t mNumRdAheadBlocks; ///< no. of blocks used for readahead
+  const uint32_t mMaxRdAheadBlocks; ///< max no. of blocks used for readahead
   const uint64_t mDefaultBlocksize;
   uint32_t mBlocksize; ///< block size for rd/wr opertations
   XrdCl::File* mXrdFile; ///< handler to xrd file
   AsyncMetaHandler* mMetaHandler; ///< async requests meta handler
   PrefetchMap mMapBlocks; ///< map of block read/prefetched
   std::queue<ReadaheadBlock*> mQueueBlocks; ///< queue containing available blocks
+  uint32_t mNumBlocks; ///< no. of readahead blocks allocated
+  uint64_t mBlockSeq; ///< sequence number of the next prefetched block
+  ReadaheadStrategy mReadahead; ///< access pattern detection for readahead
   XrdSysMutex mPrefetchMutex; ///< mutex to serialise the prefetch step
   eos::common::FileMap mFileMap; ///< extended attribute file map
   std::string mAttrUrl; ///< extended attribute url
@@ -578,15 +611,34 @@ private:
   void DumpConnectionPool();
 
   //----------------------------------------------------------------------------
-  //! Method used to prefetch the next block using the readahead mechanism
+  //! Method used to prefetch a block using the readahead mechanism
   //!
-  //! @param offset begin offset of the current block we are reading
-  //! @param isWrite true if block is for write, false otherwise
+  //! @param offset begin offset of the block
+  //! @param length length of the block, at most the block size
+  //! @param stream readahead stream the block is prefetched for
   //! @param timeout timeout value
   //!
   //! @return true if prefetch request was sent, otherwise false
   //----------------------------------------------------------------------------
-  bool PrefetchBlock(int64_t offset, bool isWrite, uint16_t timeout = 0);
+  bool PrefetchBlock(int64_t offset, uint32_t length, uint64_t stream,
+                     uint16_t timeout = 0);
+
+  //----------------------------------------------------------------------------
+  //! Get a block for prefetching - a free one, a newly allocated one if the
+  //! maximum is not reached or else the oldest prefetched block
+  //!
+  //! @return block or NULL if none available
+  //----------------------------------------------------------------------------
+  ReadaheadBlock* GetFreeBlock();
+
+  //----------------------------------------------------------------------------
+  //! Put back a prefetched block in the queue of available blocks after
+  //! collecting any response in-flight. A block never used is reported as
+  //! wasted to the readahead strategy.
+  //!
+  //! @param iter iterator to the block in the map of prefetched blocks
+  //----------------------------------------------------------------------------
+  void RecycleBlock(PrefetchMap::iterator iter);
 
   //----------------------------------------------------------------------------
   //! Try to find a block in cache with contains the provided offset
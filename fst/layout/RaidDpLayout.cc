@@ -27,13 +27,12 @@
 #include <sys/types.h>
 /*----------------------------------------------------------------------------*/
 #include "fst/layout/RaidDpLayout.hh"
+#include "fst/layout/RainKernels.hh"
 #include "fst/io/AsyncMetaHandler.hh"
 /*----------------------------------------------------------------------------*/
 
 EOSFSTNAMESPACE_BEGIN
 
-typedef long v2do __attribute__((vector_size(VECTOR_SIZE)));
-
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
@@ -61,7 +60,8 @@ RaidDpLayout::RaidDpLayout(XrdFstOfsFile* file,
 //------------------------------------------------------------------------------
 RaidDpLayout::~RaidDpLayout()
 {
-  // empty
+  // Parity jobs still running call the parity methods of this object
+  (void) CollectBlockParity(0);
 }
 
 
@@ -69,25 +69,24 @@ RaidDpLayout::~RaidDpLayout()
 // Compute simple and double parity blocks
 //------------------------------------------------------------------------------
 bool
-RaidDpLayout::ComputeParity()
+RaidDpLayout::ComputeParity(std::vector<char*>& blocks)
 {
+  // Each parity block is the XOR of its sources computed in one pass
+  std::vector<const char*> srcs;
+
   // Compute simple parity
   for (unsigned int i = 0; i < mNbDataFiles; i++) {
     int index_pblock = (i + 1) * mNbDataFiles + 2 * i;
     int current_block = i * (mNbDataFiles + 2); //beginning of current line
-    OperationXOR(mDataBlocks[current_block],
-                 mDataBlocks[current_block + 1],
-                 mDataBlocks[index_pblock],
-                 mStripeWidth);
-    current_block += 2;
+    srcs.clear();
 
     while (current_block < index_pblock) {
-      OperationXOR(mDataBlocks[index_pblock],
-                   mDataBlocks[current_block],
-                   mDataBlocks[index_pblock],
-                   mStripeWidth);
+      srcs.push_back(blocks[current_block]);
       current_block++;
     }
+
+    RainKernels::XorMulti(blocks[index_pblock], srcs.data(), srcs.size(),
+                          mStripeWidth, false);
   }
 
   // Compute double parity
@@ -102,10 +101,9 @@ RaidDpLayout::ComputeParity()
   for (unsigned int i = 0; i < mNbDataFiles; i++) {
     unsigned int index_dpblock = (i + 1) * (mNbDataFiles + 1) + i;
     unsigned int next_block = i + jump_blocks;
-    OperationXOR(mDataBlocks[i],
-                 mDataBlocks[next_block],
-                 mDataBlocks[index_dpblock],
-                 mStripeWidth);
+    srcs.clear();
+    srcs.push_back(blocks[i]);
+    srcs.push_back(blocks[next_block]);
     used_blocks.push_back(i);
     used_blocks.push_back(next_block);
 
@@ -125,12 +123,12 @@ RaidDpLayout::ComputeParity()
         }
       }
 
-      OperationXOR(mDataBlocks[index_dpblock],
-                   mDataBlocks[next_block],
-                   mDataBlocks[index_dpblock],
-                   mStripeWidth);
+      srcs.push_back(blocks[next_block]);
       used_blocks.push_back(next_block);
     }
+
+    RainKernels::XorMulti(blocks[index_dpblock], srcs.data(), srcs.size(),
+                          mStripeWidth, false);
   }
 
   return true;
@@ -138,40 +136,22 @@ RaidDpLayout::ComputeParity()
 
 
 //------------------------------------------------------------------------------
-// XOR the two blocks using 128 bits and return the result
+// Rebuild a block as the XOR of the other blocks of its stripe
 //------------------------------------------------------------------------------
 void
-RaidDpLayout::OperationXOR(char* pBlock1, char* pBlock2, char* pResult,
-                           size_t totalBytes)
+RaidDpLayout::RecoverBlock(unsigned int idBlock,
+                           const std::vector<unsigned int>& stripe)
 {
-  v2do* xor_res;
-  v2do* idx1;
-  v2do* idx2;
-  char* byte_res;
-  char* byte_idx1;
-  char* byte_idx2;
-  long int noPices = -1;
-  idx1 = (v2do*) pBlock1;
-  idx2 = (v2do*) pBlock2;
-  xor_res = (v2do*) pResult;
-  noPices = totalBytes / sizeof(v2do);
-
-  for (unsigned int i = 0; i < noPices; idx1++, idx2++, xor_res++, i++) {
-    *xor_res = *idx1 ^ *idx2;
-  }
-
-  // If the block does not devide perfectly to 128 ...
-  if (totalBytes % sizeof(v2do) != 0) {
-    byte_res = (char*) xor_res;
-    byte_idx1 = (char*) idx1;
-    byte_idx2 = (char*) idx2;
+  std::vector<const char*> srcs;
 
-    for (unsigned int i = noPices * sizeof(v2do);
-         i < totalBytes;
-         byte_res++, byte_idx1++, byte_idx2++, i++) {
-      *byte_res = *byte_idx1 ^ *byte_idx2;
+  for (auto id : stripe) {
+    if (id != idBlock) {
+      srcs.push_back(mDataBlocks[id]);
     }
   }
+
+  RainKernels::XorMulti(mDataBlocks[idBlock], srcs.data(), srcs.size(),
+                        mStripeWidth, false);
 }
 
 
@@ -292,16 +272,7 @@ RaidDpLayout::RecoverPiecesInGroup(XrdCl::ChunkList& grp_errs)
 
     if (ValidHorizStripe(horizontal_stripe, status_blocks, id_corrupted)) {
       // Try to recover using simple parity
-      memset(mDataBlocks[id_corrupted], 0, mStripeWidth);
-
-      for (unsigned int ind = 0; ind < horizontal_stripe.size(); ind++) {
-        if (horizontal_stripe[ind] != id_corrupted) {
-          OperationXOR(mDataBlocks[id_corrupted],
-                       mDataBlocks[horizontal_stripe[ind]],
-                       mDataBlocks[id_corrupted],
-                       mStripeWidth);
-        }
-      }
+      RecoverBlock(id_corrupted, horizontal_stripe);
 
       // Return recovered block and also write it to the file
       stripe_id = id_corrupted % mNbTotalFiles;
@@ -351,16 +322,7 @@ RaidDpLayout::RecoverPiecesInGroup(XrdCl::ChunkList& grp_errs)
     } else {
       // Try to recover using double parity
       if (ValidDiagStripe(diagonal_stripe, status_blocks, id_corrupted)) {
-        memset(mDataBlocks[id_corrupted], 0, mStripeWidth);
-
-        for (unsigned int ind = 0; ind < diagonal_stripe.size(); ind++) {
-          if (diagonal_stripe[ind] != id_corrupted) {
-            OperationXOR(mDataBlocks[id_corrupted],
-                         mDataBlocks[diagonal_stripe[ind]],
-                         mDataBlocks[id_corrupted],
-                         mStripeWidth);
-          }
-        }
+        RecoverBlock(id_corrupted, diagonal_stripe);
 
         // Return recovered block and also write them to the files
         stripe_id = id_corrupted % mNbTotalFiles;
@@ -491,7 +453,7 @@ RaidDpLayout::AddDataBlock(uint64_t offset,
       // We completed a group, we can compute parity
       mOffGroupParity = ((offset - 1) / mSizeGroup) * mSizeGroup;
       mFullDataBlocks = true;
-      DoBlockParity(mOffGroupParity);
+      SubmitBlockParity(mOffGroupParity);
       mOffGroupParity += mSizeGroup;
 
       for (unsigned int i = 0; i < mNbTotalBlocks; i++) {
@@ -503,10 +465,11 @@ RaidDpLayout::AddDataBlock(uint64_t offset,
 
 
 //------------------------------------------------------------------------------
-// Write the parity blocks from mDataBlocks to the corresponding file stripes
+// Write the parity blocks of the group to the corresponding file stripes
 //------------------------------------------------------------------------------
 int
-RaidDpLayout::WriteParityToFiles(uint64_t offGroup)
+RaidDpLayout::WriteParityToFiles(std::vector<char*>& blocks,
+                                 uint64_t offGroup)
 {
   eos_debug("offGroup = %zu", offGroup);
   int ret = SFS_OK;
@@ -526,7 +489,7 @@ RaidDpLayout::WriteParityToFiles(uint64_t offGroup)
     // Writing simple parity
     if (mStripe[physical_pindex]) {
       nwrite = mStripe[physical_pindex]->fileWriteAsync(off_parity_local,
-               mDataBlocks[index_pblock],
+               blocks[index_pblock],
                mStripeWidth,
                mTimeout);
 
@@ -544,7 +507,7 @@ RaidDpLayout::WriteParityToFiles(uint64_t offGroup)
     // Writing double parity
     if (mStripe[physical_dpindex]) {
       nwrite = mStripe[physical_dpindex]->fileWriteAsync(off_parity_local,
-               mDataBlocks[index_dpblock],
+               blocks[index_dpblock],
                mStripeWidth,
                mTimeout);
 
@@ -820,6 +783,9 @@ RaidDpLayout::Truncate(XrdSfsFileOffset offset)
   truncate_offset = ceil((offset * 1.0) / mSizeGroup) * mSizeLine;
   truncate_offset += mSizeHeader;
 
+  // Parity jobs may still write beyond the truncation offset
+  (void) CollectBlockParity(0);
+
   if (mStripe[0]) {
     mStripe[0]->fileTruncate(truncate_offset, mTimeout);
   }
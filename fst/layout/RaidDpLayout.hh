@@ -31,10 +31,6 @@
 
 EOSFSTNAMESPACE_BEGIN
 
-//! Used for computing XOR or 128 bits = 8 * 16
-#define VECTOR_SIZE 16
-
-
 //------------------------------------------------------------------------------
 //! Implementation of the RAID-double parity layout
 //------------------------------------------------------------------------------
@@ -124,36 +120,37 @@ private:
   //----------------------------------------------------------------------------
   //! Compute parity information
   //!
+  //! @param blocks data and parity blocks of the group
+  //!
   //! @return true if parity info computed successfully, otherwise false
   //!
   //------------------------------------------------------------------------------
-  virtual bool ComputeParity();
+  virtual bool ComputeParity(std::vector<char*>& blocks);
 
 
   //----------------------------------------------------------------------------
   //! Write parity information corresponding to a group to files
   //!
+  //! @param blocks data and parity blocks of the group
   //! @param offsetGroup offset of the group of blocks
   //!
   //! @return 0 if successful, otherwise error
   //!
   //----------------------------------------------------------------------------
-  virtual int WriteParityToFiles(uint64_t offsetGroup);
+  virtual int WriteParityToFiles(std::vector<char*>& blocks,
+                                 uint64_t offsetGroup);
 
 
   //----------------------------------------------------------------------------
-  //! Compute XOR operation for two blocks of any size
+  //! Rebuild a block of the current group as the XOR of the other blocks of
+  //! its horizontal or diagonal stripe
   //!
-  //! @param pBlock1 first input block
-  //! @param pBlock2 second input block
-  //! @param pResult result of XOR operation
-  //! @param totalBytes size of input blocks
+  //! @param idBlock index of the block to rebuild
+  //! @param stripe block indices of the stripe
   //!
   //----------------------------------------------------------------------------
-  void OperationXOR(char* pBlock1,
-                    char* pBlock2,
-                    char* pResult,
-                    size_t totalBytes);
+  void RecoverBlock(unsigned int idBlock,
+                    const std::vector<unsigned int>& stripe);
 
 
   //----------------------------------------------------------------------------
@@ -21,8 +21,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
 
+#include <algorithm>
 #include <cmath>
 #include <string>
+#include <thread>
 #include <utility>
 #include <stdint.h>
 #include "common/Timing.hh"
@@ -69,7 +71,9 @@ RaidMetaLayout::RaidMetaLayout(XrdFstOfsFile* file,
   mTargetSize(targetSize),
   mSizeLine(0),
   mSizeGroup(0),
-  mBookingOpaque(bookingOpaque)
+  mBookingOpaque(bookingOpaque),
+  mParityDepth(InitParityDepth()),
+  mParityFailed(false)
 {
   mStripeWidth = eos::common::LayoutId::GetBlocksize(lid);
   mNbTotalFiles = eos::common::LayoutId::GetStripeNumber(lid) + 1;
@@ -86,6 +90,10 @@ RaidMetaLayout::RaidMetaLayout(XrdFstOfsFile* file,
 //------------------------------------------------------------------------------
 RaidMetaLayout::~RaidMetaLayout()
 {
+  // Parity jobs still running use the stripe files and their own blocks, wait
+  // for them before freeing anything. Their blocks go to mFreeGroups.
+  (void) CollectBlockParity(0);
+
   while (!mHdrInfo.empty()) {
     HeaderCRC* hd = mHdrInfo.back();
     mHdrInfo.pop_back();
@@ -108,6 +116,25 @@ RaidMetaLayout::~RaidMetaLayout()
     mDataBlocks.pop_back();
     delete[] ptr_char;
   }
+
+  for (auto& group : mFreeGroups) {
+    for (auto ptr_char : group) {
+      delete[] ptr_char;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get the thread pool computing the parity of streaming writes - created on
+// first use so that clients linking the layouts do not start any thread
+//------------------------------------------------------------------------------
+eos::common::ThreadPool&
+RaidMetaLayout::GetParityPool()
+{
+  static eos::common::ThreadPool sParityPool(
+    std::max(std::thread::hardware_concurrency() / 4, 2u),
+    std::max(std::thread::hardware_concurrency(), 2u));
+  return sParityPool;
 }
 
 //------------------------------------------------------------------------------
@@ -598,6 +625,9 @@ RaidMetaLayout::Read(XrdSfsFileOffset offset, char* buffer,
       read_length = mStripe[0]->fileRead(offset, buffer, length, mTimeout);
     }
   } else {
+    // The reads below collect the responses of all the stripes
+    (void) CollectBlockParity(0);
+
     // Only entry server does this
     if ((uint64_t)offset > mFileSize) {
       eos_warning("offset:%lld larger then file size:%lld", offset, mFileSize);
@@ -764,6 +794,8 @@ RaidMetaLayout::ReadV(XrdCl::ChunkList& chunkList, uint32_t len)
       }
     }
   } else {
+    (void) CollectBlockParity(0);
+
     // Reset all the async handlers
     for (unsigned int i = 0; i < mStripe.size(); i++) {
       if (mStripe[i]) {
@@ -887,6 +919,11 @@ RaidMetaLayout::Write(XrdSfsFileOffset offset,
     if (mIsStreaming && ((uint64_t)offset != mLastWriteOffset)) {
       eos_debug("enable non-streaming mode");
       mIsStreaming = false;
+
+      // The sparse parity computation rewrites the parity of any group
+      if (!CollectBlockParity(0)) {
+        eos_err("failed while computing the parity of streamed groups");
+      }
     }
 
     mLastWriteOffset += length;
@@ -956,31 +993,109 @@ RaidMetaLayout::Write(XrdSfsFileOffset offset,
 //------------------------------------------------------------------------------
 // Compute and write parity blocks to files
 //------------------------------------------------------------------------------
-
 bool
 RaidMetaLayout::DoBlockParity(uint64_t offGroup)
 {
+  // The current group buffers are only used by the caller's thread
+  bool done = DoBlockParity(offGroup, mDataBlocks);
+
+  if (done) {
+    mFullDataBlocks = false;
+  }
+
+  return done;
+}
+
+//------------------------------------------------------------------------------
+// Compute and write the parity blocks of the given group buffers
+//------------------------------------------------------------------------------
+bool
+RaidMetaLayout::DoBlockParity(uint64_t offGroup, std::vector<char*>& blocks)
+{
+  std::lock_guard<std::mutex> lock(mParityMutex);
   bool done;
   eos::common::Timing up("parity");
   COMMONTIMING("Compute-In", &up);
 
   // Compute parity blocks
-  if ((done = ComputeParity())) {
+  if ((done = ComputeParity(blocks))) {
     COMMONTIMING("Compute-Out", &up);
 
     // Write parity blocks to files
-    if (WriteParityToFiles(offGroup) == SFS_ERROR) {
+    if (WriteParityToFiles(blocks, offGroup) == SFS_ERROR) {
       done = false;
     }
 
     COMMONTIMING("WriteParity", &up);
-    mFullDataBlocks = false;
   }
 
   //  up.Print();
   return done;
 }
 
+//------------------------------------------------------------------------------
+// Hand over the full group to the parity thread pool. The group buffers are
+// owned by the job until it is collected, in the meantime the writer fills
+// a spare group buffer. The parity computations of one file are serialized
+// by mParityMutex, therefore the parity stripes are only accessed by one
+// thread at a time.
+//------------------------------------------------------------------------------
+void
+RaidMetaLayout::SubmitBlockParity(uint64_t offGroup)
+{
+  if (mParityDepth <= 1) {
+    if (!DoBlockParity(offGroup)) {
+      mParityFailed = true;
+    }
+
+    return;
+  }
+
+  // Wait for a free slot in the pipeline
+  (void) CollectBlockParity(mParityDepth - 1);
+  mParityJobs.emplace_back();
+  ParityJob& job = mParityJobs.back();
+  job.mBlocks.swap(mDataBlocks);
+
+  if (mFreeGroups.empty()) {
+    for (unsigned int i = 0; i < mNbTotalBlocks; i++) {
+      mDataBlocks.push_back(new char[mStripeWidth]);
+    }
+  } else {
+    mDataBlocks.swap(mFreeGroups.back());
+    mFreeGroups.pop_back();
+  }
+
+  // Adding/removing at the ends of the deque keeps references to the other
+  // elements valid, the job owns its blocks until it is collected
+  std::vector<char*>* blocks = &job.mBlocks;
+  job.mDone = GetParityPool().PushTask<bool>([this, offGroup, blocks]() {
+    return DoBlockParity(offGroup, *blocks);
+  });
+  mFullDataBlocks = false;
+}
+
+//------------------------------------------------------------------------------
+// Wait for parity jobs until at most maxJobs are still running
+//------------------------------------------------------------------------------
+bool
+RaidMetaLayout::CollectBlockParity(size_t maxJobs)
+{
+  while (mParityJobs.size() > maxJobs) {
+    ParityJob& job = mParityJobs.front();
+
+    if (!job.mDone.valid() || !job.mDone.get()) {
+      eos_err("failed to compute/write the parity of a group");
+      mParityFailed = true;
+    }
+
+    mFreeGroups.push_back(std::move(job.mBlocks));
+    mParityJobs.pop_front();
+  }
+
+  return !mParityFailed;
+}
+
 //------------------------------------------------------------------------------
 // Recover pieces from the whole file. The map contains the original position of
 // the corrupted pieces in the initial file.
@@ -1254,6 +1369,10 @@ RaidMetaLayout::Sync()
     }
 
     if (mIsEntryServer) {
+      if (!CollectBlockParity(0)) {
+        ret = SFS_ERROR;
+      }
+
       // Sync remote files
       for (unsigned int i = 1; i < mStripe.size(); i++) {
         if (mStripe[i]) {
@@ -1284,6 +1403,8 @@ RaidMetaLayout::Remove()
   int ret = SFS_OK;
 
   if (mIsEntryServer) {
+    (void) CollectBlockParity(0);
+
     // Unlink remote stripes
     for (unsigned int i = 1; i < mStripe.size(); i++) {
       if (mStripe[i]) {
@@ -1322,6 +1443,8 @@ RaidMetaLayout::Stat(struct stat* buf)
 
   if (mIsOpen) {
     if (mIsEntryServer) {
+      (void) CollectBlockParity(0);
+
       for (unsigned int i = 0; i < mStripe.size(); i++) {
         if (mStripe[i]) {
           if (mStripe[i]->fileStat(buf, mTimeout) == SFS_OK) {
@@ -1370,6 +1493,12 @@ RaidMetaLayout::Close()
 
   if (mIsOpen) {
     if (mIsEntryServer) {
+      // Wait for the parity of the groups streamed so far
+      if (!CollectBlockParity(0)) {
+        eos_err("failed to do the parity of some group");
+        rc = SFS_ERROR;
+      }
+
       if (mStoreRecovery) {
         if (mDoneRecovery || mDoTruncate) {
           eos_debug("truncating after done a recovery or at end of write");
@@ -1492,6 +1621,7 @@ int
 RaidMetaLayout::Fctl(const std::string& cmd, const XrdSecEntity* client)
 {
   int retc = SFS_OK;
+  (void) CollectBlockParity(0);
 
   for (unsigned int i = 0; i < mStripe.size(); ++i) {
     eos_debug("Send cmd=\"%s\" to stripe %i", cmd.c_str(), i);
@@ -28,6 +28,10 @@
 #include <vector>
 #include <string>
 #include <list>
+#include <deque>
+#include <future>
+#include <mutex>
+#include "common/ThreadPool.hh"
 #include "fst/layout/Layout.hh"
 #include "fst/layout/HeaderCRC.hh"
 #include "fst/XrdFstOfsFile.hh"
@@ -71,6 +75,21 @@ public:
   //----------------------------------------------------------------------------
   virtual ~RaidMetaLayout();
 
+  //----------------------------------------------------------------------------
+  //! Get the depth of the parity pipeline of streaming writes i.e. the number
+  //! of groups which can be filled while the parity of the previous ones is
+  //! still being computed and written. A depth of 1 computes the parity
+  //! synchronously in the write call completing a group.
+  //!
+  //! @return value of EOS_FST_RAIN_PARITY_DEPTH, by default 2
+  //----------------------------------------------------------------------------
+  static unsigned int InitParityDepth()
+  {
+    char* ptr = getenv("EOS_FST_RAIN_PARITY_DEPTH");
+    unsigned long depth = (ptr ? strtoul(ptr, 0, 10) : 2ul);
+    return (depth ? depth : 1);
+  }
+
   //--------------------------------------------------------------------------
   //! Redirect to new target
   //--------------------------------------------------------------------------
@@ -304,6 +323,20 @@ protected:
   std::map<uint64_t, uint32_t> mMapPieces; ///< map of pieces written for which
   ///< parity computation has not been done yet
   std::string mLastErrMsg; ///< last error messages ssen
+  unsigned int mParityDepth; ///< number of group buffers in the pipeline
+
+  //----------------------------------------------------------------------------
+  //! Parity computation of a full group running in the parity thread pool
+  //----------------------------------------------------------------------------
+  struct ParityJob {
+    std::vector<char*> mBlocks; ///< blocks of the group owned by the job
+    std::future<bool> mDone; ///< result of the parity computation
+  };
+
+  std::deque<ParityJob> mParityJobs; ///< parity jobs in submission order
+  std::vector< std::vector<char*> > mFreeGroups; ///< spare group buffers
+  std::mutex mParityMutex; ///< serialize parity computations of the file
+  bool mParityFailed; ///< mark if the parity of some group failed
 
   //----------------------------------------------------------------------------
   //! Test and recover any corrupted headers in the stripe files
@@ -334,6 +367,42 @@ protected:
   virtual bool DoBlockParity(uint64_t offGroup);
 
 
+  //----------------------------------------------------------------------------
+  //! Compute and write the parity blocks of the given group buffers
+  //!
+  //! @param offGroup offset of group of blocks
+  //! @param blocks data and parity blocks of the group
+  //!
+  //! @return true if successfully computed the parity and wrote it to the
+  //!         corresponding files, otherwise false
+  //----------------------------------------------------------------------------
+  bool DoBlockParity(uint64_t offGroup, std::vector<char*>& blocks);
+
+
+  //----------------------------------------------------------------------------
+  //! Streaming operation
+  //! Hand over the full group in mDataBlocks to the parity thread pool and
+  //! continue with a spare group buffer in mDataBlocks. Blocks if the
+  //! pipeline is full until the oldest parity job is done.
+  //!
+  //! @param offGroup offset of group of blocks
+  //----------------------------------------------------------------------------
+  void SubmitBlockParity(uint64_t offGroup);
+
+
+  //----------------------------------------------------------------------------
+  //! Wait for parity jobs until at most maxJobs are still running. Any
+  //! method accessing the parity stripes or the async handlers of the
+  //! stripes must first wait for all jobs.
+  //!
+  //! @param maxJobs number of parity jobs allowed to still run
+  //!
+  //! @return true if the parity of all groups done so far was successful,
+  //!         otherwise false
+  //----------------------------------------------------------------------------
+  bool CollectBlockParity(size_t maxJobs = 0);
+
+
   //----------------------------------------------------------------------------
   //! Recover corrupted chunks from the current group
   //!
@@ -362,21 +431,25 @@ protected:
   //------------------------------------------------------------------------------
   //! Compute error correction blocks
   //!
+  //! @param blocks data and parity blocks of the group
+  //!
   //! @return true if parity info computed successfully, otherwise false
   //!
   //------------------------------------------------------------------------------
-  virtual bool ComputeParity() = 0;
+  virtual bool ComputeParity(std::vector<char*>& blocks) = 0;
 
 
   //----------------------------------------------------------------------------
   //! Write parity information corresponding to a group to files
   //!
+  //! @param blocks data and parity blocks of the group
   //! @param offsetGroup offset of the group of blocks
   //!
   //! @return 0 if successful, otherwise error
   //!
   //----------------------------------------------------------------------------
-  virtual int WriteParityToFiles(uint64_t offsetGroup) = 0;
+  virtual int WriteParityToFiles(std::vector<char*>& blocks,
+                                 uint64_t offsetGroup) = 0;
 
 
   //----------------------------------------------------------------------------
@@ -497,6 +570,12 @@ private:
   XrdCl::ChunkList SplitRead(uint64_t off, uint32_t len, char* buff);
 
 
+  //----------------------------------------------------------------------------
+  //! Get the thread pool computing the parity of streaming writes
+  //----------------------------------------------------------------------------
+  static eos::common::ThreadPool& GetParityPool();
+
+
   //----------------------------------------------------------------------------
   //! Disable copy constructor
   //----------------------------------------------------------------------------
@@ -0,0 +1,383 @@
+//------------------------------------------------------------------------------
+//! @file RainKernels.cc
+//! @brief XOR kernels used for computing and recovering RAIN parity blocks
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fst/layout/RainKernels.hh"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//! The AVX2/AVX-512 kernels are compiled with function level target
+//! attributes, the rest of the file keeps the default instruction set
+#if defined(__x86_64__) && (defined(__clang__) || (__GNUC__ >= 5))
+#define EOS_RAIN_WIDE_VECTORS 1
+#endif
+
+EOSFSTNAMESPACE_BEGIN
+
+namespace
+{
+//! Maximum number of schedule operations merged into one multi-source XOR
+const size_t sMaxMergedOps = 32;
+
+typedef void (*XorMultiFunc)(char* dst, const char* const* srcs,
+                             size_t nsrcs, size_t length, bool accumulate);
+
+//------------------------------------------------------------------------------
+// Unaligned load/store of a word - compiled to a single vector move
+//------------------------------------------------------------------------------
+template<typename V>
+inline __attribute__((always_inline)) void
+LoadWord(V& word, const char* ptr)
+{
+  memcpy(&word, ptr, sizeof(V));
+}
+
+template<typename V>
+inline __attribute__((always_inline)) void
+StoreWord(char* ptr, const V& word)
+{
+  memcpy(ptr, &word, sizeof(V));
+}
+
+//------------------------------------------------------------------------------
+// Multi-source XOR working on words of type V, four words per iteration so
+// that the loads of the different sources can overlap. Always inlined in
+// the per instruction set wrappers below so that it is compiled for the
+// target of the wrapper.
+//------------------------------------------------------------------------------
+template<typename V>
+inline __attribute__((always_inline)) void
+XorMultiWords(char* dst, const char* const* srcs, size_t nsrcs,
+              size_t length, bool accumulate)
+{
+  if (nsrcs == 0) {
+    if (!accumulate) {
+      memset(dst, 0, length);
+    }
+
+    return;
+  }
+
+  const char* base = (accumulate ? dst : srcs[0]);
+  size_t first = (accumulate ? 0 : 1);
+  size_t off = 0;
+
+  for (; off + 4 * sizeof(V) <= length; off += 4 * sizeof(V)) {
+    V w0, w1, w2, w3;
+    LoadWord(w0, base + off);
+    LoadWord(w1, base + off + sizeof(V));
+    LoadWord(w2, base + off + 2 * sizeof(V));
+    LoadWord(w3, base + off + 3 * sizeof(V));
+
+    for (size_t s = first; s < nsrcs; ++s) {
+      V x0, x1, x2, x3;
+      const char* src = srcs[s] + off;
+      LoadWord(x0, src);
+      LoadWord(x1, src + sizeof(V));
+      LoadWord(x2, src + 2 * sizeof(V));
+      LoadWord(x3, src + 3 * sizeof(V));
+      w0 ^= x0;
+      w1 ^= x1;
+      w2 ^= x2;
+      w3 ^= x3;
+    }
+
+    StoreWord(dst + off, w0);
+    StoreWord(dst + off + sizeof(V), w1);
+    StoreWord(dst + off + 2 * sizeof(V), w2);
+    StoreWord(dst + off + 3 * sizeof(V), w3);
+  }
+
+  for (; off + sizeof(V) <= length; off += sizeof(V)) {
+    V w0;
+    LoadWord(w0, base + off);
+
+    for (size_t s = first; s < nsrcs; ++s) {
+      V x0;
+      LoadWord(x0, srcs[s] + off);
+      w0 ^= x0;
+    }
+
+    StoreWord(dst + off, w0);
+  }
+
+  for (; off < length; ++off) {
+    char byte = base[off];
+
+    for (size_t s = first; s < nsrcs; ++s) {
+      byte ^= srcs[s][off];
+    }
+
+    dst[off] = byte;
+  }
+}
+
+void
+XorMultiGeneric(char* dst, const char* const* srcs, size_t nsrcs,
+                size_t length, bool accumulate)
+{
+  XorMultiWords<uint64_t>(dst, srcs, nsrcs, length, accumulate);
+}
+
+#ifdef __x86_64__
+//! SSE2 is part of the x86_64 baseline
+typedef long long Vec128 __attribute__((vector_size(16)));
+
+void
+XorMultiSse2(char* dst, const char* const* srcs, size_t nsrcs,
+             size_t length, bool accumulate)
+{
+  XorMultiWords<Vec128>(dst, srcs, nsrcs, length, accumulate);
+}
+#endif
+
+#ifdef EOS_RAIN_WIDE_VECTORS
+typedef long long Vec256 __attribute__((vector_size(32)));
+typedef long long Vec512 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2"))) void
+XorMultiAvx2(char* dst, const char* const* srcs, size_t nsrcs,
+             size_t length, bool accumulate)
+{
+  XorMultiWords<Vec256>(dst, srcs, nsrcs, length, accumulate);
+}
+
+__attribute__((target("avx512f"))) void
+XorMultiAvx512(char* dst, const char* const* srcs, size_t nsrcs,
+               size_t length, bool accumulate)
+{
+  XorMultiWords<Vec512>(dst, srcs, nsrcs, length, accumulate);
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Kernels indexed by RainKernels::Isa, null if not built for this platform
+//------------------------------------------------------------------------------
+const XorMultiFunc sXorMulti[] = {
+  XorMultiGeneric,
+#ifdef __x86_64__
+  XorMultiSse2,
+#else
+  nullptr,
+#endif
+#ifdef EOS_RAIN_WIDE_VECTORS
+  XorMultiAvx2,
+  XorMultiAvx512
+#else
+  nullptr,
+  nullptr
+#endif
+};
+
+//! Instruction set in use, negative until first used
+std::atomic<int> sIsa(-1);
+
+//------------------------------------------------------------------------------
+// Detect the widest instruction set usable on this machine
+//------------------------------------------------------------------------------
+RainKernels::Isa
+DetectIsa()
+{
+#ifdef EOS_RAIN_WIDE_VECTORS
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f")) {
+    return RainKernels::kAvx512;
+  }
+
+  if (__builtin_cpu_supports("avx2")) {
+    return RainKernels::kAvx2;
+  }
+
+#endif
+#ifdef __x86_64__
+  return RainKernels::kSse2;
+#else
+  return RainKernels::kGeneric;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Get the kernel of the instruction set in use
+//------------------------------------------------------------------------------
+inline XorMultiFunc
+GetXorMulti()
+{
+  return sXorMulti[RainKernels::GetIsa()];
+}
+}
+
+//------------------------------------------------------------------------------
+// Get the widest instruction set supported by the CPU and the OS
+//------------------------------------------------------------------------------
+RainKernels::Isa
+RainKernels::GetBestIsa()
+{
+  static const Isa sBestIsa = DetectIsa();
+  return sBestIsa;
+}
+
+//------------------------------------------------------------------------------
+// Get the instruction set currently used by the kernels - the first call
+// applies the EOS_FST_RAIN_ISA override if any
+//------------------------------------------------------------------------------
+RainKernels::Isa
+RainKernels::GetIsa()
+{
+  int isa = sIsa.load(std::memory_order_relaxed);
+
+  if (isa < 0) {
+    isa = GetBestIsa();
+    const char* ptr = getenv("EOS_FST_RAIN_ISA");
+
+    if (ptr) {
+      for (int i = kGeneric; i < isa; ++i) {
+        if (std::string(ptr) == GetIsaName((Isa) i)) {
+          isa = i;
+          break;
+        }
+      }
+    }
+
+    sIsa.store(isa, std::memory_order_relaxed);
+  }
+
+  return (Isa) isa;
+}
+
+//------------------------------------------------------------------------------
+// Select the instruction set used by the kernels
+//------------------------------------------------------------------------------
+bool
+RainKernels::SetIsa(Isa isa)
+{
+  if ((isa < kGeneric) || (isa > GetBestIsa()) || !sXorMulti[isa]) {
+    return false;
+  }
+
+  sIsa.store(isa, std::memory_order_relaxed);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Get the name of an instruction set
+//------------------------------------------------------------------------------
+const char*
+RainKernels::GetIsaName(Isa isa)
+{
+  switch (isa) {
+  case kSse2:
+    return "sse2";
+
+  case kAvx2:
+    return "avx2";
+
+  case kAvx512:
+    return "avx512";
+
+  default:
+    return "generic";
+  }
+}
+
+//------------------------------------------------------------------------------
+// XOR two blocks
+//------------------------------------------------------------------------------
+void
+RainKernels::Xor(const char* src1, const char* src2, char* dst, size_t length)
+{
+  XorMultiFunc xor_multi = GetXorMulti();
+
+  if (dst == src1) {
+    xor_multi(dst, &src2, 1, length, true);
+  } else if (dst == src2) {
+    xor_multi(dst, &src1, 1, length, true);
+  } else {
+    const char* srcs[2] = {src1, src2};
+    xor_multi(dst, srcs, 2, length, false);
+  }
+}
+
+//------------------------------------------------------------------------------
+// XOR several blocks in one pass
+//------------------------------------------------------------------------------
+void
+RainKernels::XorMulti(char* dst, const char* const* srcs, size_t nsrcs,
+                      size_t length, bool accumulate)
+{
+  GetXorMulti()(dst, srcs, nsrcs, length, accumulate);
+}
+
+//------------------------------------------------------------------------------
+// Execute a jerasure schedule. The operations of the smart schedules come in
+// runs of one copy or XOR followed by XORs into the same packet, each run
+// is done in one pass over the destination.
+//------------------------------------------------------------------------------
+void
+RainKernels::DoScheduledOperations(char** ptrs, int** operations,
+                                   int packetsize)
+{
+  XorMultiFunc xor_multi = GetXorMulti();
+  const char* srcs[sMaxMergedOps];
+  int op = 0;
+
+  while (operations[op][0] >= 0) {
+    char* dptr = ptrs[operations[op][2]] + operations[op][3] * packetsize;
+    bool accumulate = (operations[op][4] != 0);
+    size_t nsrcs = 0;
+
+    do {
+      srcs[nsrcs++] = ptrs[operations[op][0]] + operations[op][1] * packetsize;
+      ++op;
+    } while ((operations[op][0] >= 0) && operations[op][4] &&
+             (nsrcs < sMaxMergedOps) &&
+             (ptrs[operations[op][2]] + operations[op][3] * packetsize == dptr) &&
+             (ptrs[operations[op][0]] + operations[op][1] * packetsize != dptr));
+
+    xor_multi(dptr, srcs, nsrcs, packetsize, accumulate);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Encode with a jerasure bit-matrix schedule
+//------------------------------------------------------------------------------
+void
+RainKernels::ScheduleEncode(int k, int m, int w, int** schedule, char** data,
+                            char** coding, size_t size, int packetsize)
+{
+  std::vector<char*> ptrs(data, data + k);
+  ptrs.insert(ptrs.end(), coding, coding + m);
+
+  for (size_t done = 0; done < size; done += packetsize * w) {
+    DoScheduledOperations(ptrs.data(), schedule, packetsize);
+
+    for (auto& ptr : ptrs) {
+      ptr += packetsize * w;
+    }
+  }
+}
+
+EOSFSTNAMESPACE_END
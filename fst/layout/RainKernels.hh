@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------
+//! @file RainKernels.hh
+//! @brief XOR kernels used for computing and recovering RAIN parity blocks,
+//!        dispatched at runtime to the widest vector unit of the CPU
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __EOSFST_RAINKERNELS_HH__
+#define __EOSFST_RAINKERNELS_HH__
+
+#include "fst/Namespace.hh"
+#include <cstddef>
+
+EOSFSTNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! XOR kernels for the RAIN layouts. Both the RAID-DP and the Cauchy
+//! Reed-Solomon (bit-matrix) codes reduce to XORs of whole regions, the GF(2^w)
+//! arithmetic of the latter being folded into the jerasure schedules. The
+//! instruction set used is detected once and can be overridden with
+//! EOS_FST_RAIN_ISA=generic|sse2|avx2|avx512 or by calling SetIsa.
+//------------------------------------------------------------------------------
+class RainKernels
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Instruction sets for which kernels exist, in increasing order of width
+  //----------------------------------------------------------------------------
+  enum Isa {
+    kGeneric = 0, ///< 64-bit words
+    kSse2 = 1, ///< 128-bit vectors
+    kAvx2 = 2, ///< 256-bit vectors
+    kAvx512 = 3 ///< 512-bit vectors
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get the widest instruction set supported by the CPU and the OS
+  //----------------------------------------------------------------------------
+  static Isa GetBestIsa();
+
+  //----------------------------------------------------------------------------
+  //! Get the instruction set currently used by the kernels
+  //----------------------------------------------------------------------------
+  static Isa GetIsa();
+
+  //----------------------------------------------------------------------------
+  //! Select the instruction set used by the kernels
+  //!
+  //! @param isa instruction set
+  //!
+  //! @return true if selected, false if not supported on this machine
+  //----------------------------------------------------------------------------
+  static bool SetIsa(Isa isa);
+
+  //----------------------------------------------------------------------------
+  //! Get the name of an instruction set
+  //----------------------------------------------------------------------------
+  static const char* GetIsaName(Isa isa);
+
+  //----------------------------------------------------------------------------
+  //! XOR two blocks: dst = src1 ^ src2. The destination may be one of the
+  //! sources.
+  //!
+  //! @param src1 first input block
+  //! @param src2 second input block
+  //! @param dst result block
+  //! @param length size of the blocks
+  //----------------------------------------------------------------------------
+  static void Xor(const char* src1, const char* src2, char* dst,
+                  size_t length);
+
+  //----------------------------------------------------------------------------
+  //! XOR several blocks in one pass: dst = [dst ^] srcs[0] ^ ... ^ srcs[n-1].
+  //! The destination must not be one of the sources.
+  //!
+  //! @param dst result block
+  //! @param srcs input blocks
+  //! @param nsrcs number of input blocks, if 0 and not accumulating dst is
+  //!        zeroed
+  //! @param length size of the blocks
+  //! @param accumulate if true the initial content of dst is part of the XOR
+  //----------------------------------------------------------------------------
+  static void XorMulti(char* dst, const char* const* srcs, size_t nsrcs,
+                       size_t length, bool accumulate);
+
+  //----------------------------------------------------------------------------
+  //! Execute a jerasure schedule on w * packetsize bytes of each device, same
+  //! semantics as jerasure_do_scheduled_operations. Consecutive operations
+  //! targeting the same packet are merged into one multi-source XOR.
+  //!
+  //! @param ptrs pointers to the devices
+  //! @param operations jerasure schedule terminated by an operation with a
+  //!        negative source device
+  //! @param packetsize size of one packet
+  //----------------------------------------------------------------------------
+  static void DoScheduledOperations(char** ptrs, int** operations,
+                                    int packetsize);
+
+  //----------------------------------------------------------------------------
+  //! Encode with a jerasure bit-matrix schedule, same result as
+  //! jerasure_schedule_encode
+  //!
+  //! @param k number of data devices
+  //! @param m number of coding devices
+  //! @param w word size of the code
+  //! @param schedule encoding schedule
+  //! @param data pointers to the data blocks
+  //! @param coding pointers to the coding blocks
+  //! @param size size of the blocks, multiple of w * packetsize
+  //! @param packetsize size of one packet
+  //----------------------------------------------------------------------------
+  static void ScheduleEncode(int k, int m, int w, int** schedule,
+                             char** data, char** coding, size_t size,
+                             int packetsize);
+};
+
+EOSFSTNAMESPACE_END
+
+#endif // __EOSFST_RAINKERNELS_HH__
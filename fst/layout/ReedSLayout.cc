@@ -27,6 +27,7 @@
 #include <algorithm>
 #include "common/Timing.hh"
 #include "fst/layout/ReedSLayout.hh"
+#include "fst/layout/RainKernels.hh"
 #include "fst/io/AsyncMetaHandler.hh"
 #include "fst/layout/jerasure/include/jerasure.h"
 #include "fst/layout/jerasure/include/reed_sol.h"
@@ -67,7 +68,8 @@ ReedSLayout::ReedSLayout(XrdFstOfsFile* file,
 //------------------------------------------------------------------------------
 ReedSLayout::~ReedSLayout()
 {
-  // empty
+  // Parity jobs still running call the parity methods of this object
+  (void) CollectBlockParity(0);
 }
 
 
@@ -101,7 +103,7 @@ ReedSLayout::InitialiseJerasure()
 // Compute the error correction blocks
 //------------------------------------------------------------------------------
 bool
-ReedSLayout::ComputeParity()
+ReedSLayout::ComputeParity(std::vector<char*>& blocks)
 {
   // Initialise Jerasure structures if not done already
   if (!mDoneInitialisation) {
@@ -118,16 +120,16 @@ ReedSLayout::ComputeParity()
   char* coding[mNbParityFiles];
 
   for (unsigned int i = 0; i < mNbDataFiles; ++i) {
-    data[i] = (char*) mDataBlocks[i];
+    data[i] = (char*) blocks[i];
   }
 
   for (unsigned int i = 0; i < mNbParityFiles; ++i) {
-    coding[i] = (char*) mDataBlocks[mNbDataFiles + i];
+    coding[i] = (char*) blocks[mNbDataFiles + i];
   }
 
-  // Encode the blocks
-  jerasure_schedule_encode(mNbDataBlocks, mNbParityFiles, w, schedule, data,
-                           coding, mStripeWidth, mPacketSize);
+  // Encode the blocks - same schedule as jerasure_schedule_encode
+  RainKernels::ScheduleEncode(mNbDataBlocks, mNbParityFiles, w, schedule, data,
+                              coding, mStripeWidth, mPacketSize);
   return true;
 }
 
@@ -245,9 +247,10 @@ ReedSLayout::RecoverPiecesInGroup(XrdCl::ChunkList& grp_errs)
 
   erasures[invalid_ids.size()] = -1;
   // ******* DECODE ******
-  int decode = jerasure_schedule_decode_lazy(mNbDataBlocks, mNbParityFiles, w,
-               bitmatrix, erasures, data, coding,
-               mStripeWidth, mPacketSize, 1);
+  int decode = jerasure_schedule_decode_lazy_ops(mNbDataBlocks, mNbParityFiles,
+               w, bitmatrix, erasures, data, coding,
+               mStripeWidth, mPacketSize, 1,
+               RainKernels::DoScheduledOperations);
   // Free memory
   delete[] erasures;
 
@@ -376,7 +379,7 @@ ReedSLayout::AddDataBlock(uint64_t offset, const char* pBuffer, uint32_t length)
       // We completed a group, we can compute parity
       mOffGroupParity = ((offset - 1) / mSizeGroup) * mSizeGroup;
       mFullDataBlocks = true;
-      DoBlockParity(mOffGroupParity);
+      SubmitBlockParity(mOffGroupParity);
       mOffGroupParity = (offset / mSizeGroup) * mSizeGroup;
 
       for (unsigned int i = 0; i < mNbDataFiles; i++) {
@@ -388,10 +391,11 @@ ReedSLayout::AddDataBlock(uint64_t offset, const char* pBuffer, uint32_t length)
 
 
 //------------------------------------------------------------------------------
-// Write the parity blocks from mDataBlocks to the corresponding file stripes
+// Write the parity blocks of the group to the corresponding file stripes
 //------------------------------------------------------------------------------
 int
-ReedSLayout::WriteParityToFiles(uint64_t offsetGroup)
+ReedSLayout::WriteParityToFiles(std::vector<char*>& blocks,
+                                uint64_t offsetGroup)
 {
   int ret = SFS_OK;
   int64_t nwrite = 0;
@@ -404,7 +408,7 @@ ReedSLayout::WriteParityToFiles(uint64_t offsetGroup)
 
     // Write parity block
     if (mStripe[physical_id]) {
-      nwrite = mStripe[physical_id]->fileWriteAsync(offset_local, mDataBlocks[i],
+      nwrite = mStripe[physical_id]->fileWriteAsync(offset_local, blocks[i],
                mStripeWidth, mTimeout);
 
       if (nwrite != (int64_t)mStripeWidth) {
@@ -435,6 +439,9 @@ ReedSLayout::Truncate(XrdSfsFileOffset offset)
   eos_debug("Truncate local stripe to file_offset = %lli, stripe_offset = %zu",
             offset, truncate_offset);
 
+  // Parity jobs may still write beyond the truncation offset
+  (void) CollectBlockParity(0);
+
   if (mStripe[0]) {
     mStripe[0]->fileTruncate(truncate_offset, mTimeout);
   }
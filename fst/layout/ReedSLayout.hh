@@ -137,21 +137,25 @@ private:
   //----------------------------------------------------------------------------
   //! Compute error correction blocks
   //!
+  //! @param blocks data and parity blocks of the group
+  //!
   //! @return true if parity info computed successfully, otherwise false
   //!
   //----------------------------------------------------------------------------
-  virtual bool ComputeParity();
+  virtual bool ComputeParity(std::vector<char*>& blocks);
 
 
   //----------------------------------------------------------------------------
   //! Write parity information corresponding to a group to files
   //!
+  //! @param blocks data and parity blocks of the group
   //! @param offsetGroup offset of the group of blocks
   //!
   //! @return 0 if successful, otherwise error
   //!
   //--------------------------------------------------------------------------
-  virtual int WriteParityToFiles(uint64_t offsetGroup);
+  virtual int WriteParityToFiles(std::vector<char*>& blocks,
+                                 uint64_t offsetGroup);
 
 
   //--------------------------------------------------------------------------
@@ -162,6 +162,10 @@ void jerasure_schedule_encode(int k, int m, int w, int **schedule,
 
    jerasure_schedule_decode_lazy generates the schedule on the fly.
 
+   jerasure_schedule_decode_lazy_ops is jerasure_schedule_decode_lazy with
+         the scheduled operations executed by do_ops instead of
+         jerasure_do_scheduled_operations (e.g. with vectorized kernels).
+
    jerasure_matrix_decode only works when w = 8|16|32.
 
    jerasure_make_decoding_matrix/bitmatrix make the k*k decoding matrix
@@ -195,6 +199,10 @@ int jerasure_schedule_decode_lazy(int k, int m, int w, int *bitmatrix, int *eras
                             char **data_ptrs, char **coding_ptrs, int size, int packetsize,
                             int smart);
 
+int jerasure_schedule_decode_lazy_ops(int k, int m, int w, int *bitmatrix, int *erasures,
+                            char **data_ptrs, char **coding_ptrs, int size, int packetsize,
+                            int smart, void (*do_ops)(char **, int **, int));
+
 int jerasure_schedule_decode_cache(int k, int m, int w, int ***scache, int *erasures,
                             char **data_ptrs, char **coding_ptrs, int size, int packetsize);
 
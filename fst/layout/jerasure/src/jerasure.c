@@ -1178,6 +1178,16 @@ int jerasure_schedule_decode_lazy(int k, int m, int w, int* bitmatrix,
                                   int* erasures,
                                   char** data_ptrs, char** coding_ptrs, int size, int packetsize,
                                   int smart)
+{
+  return jerasure_schedule_decode_lazy_ops(k, m, w, bitmatrix, erasures,
+         data_ptrs, coding_ptrs, size, packetsize, smart,
+         jerasure_do_scheduled_operations);
+}
+
+int jerasure_schedule_decode_lazy_ops(int k, int m, int w, int* bitmatrix,
+                                      int* erasures,
+                                      char** data_ptrs, char** coding_ptrs, int size, int packetsize,
+                                      int smart, void (*do_ops)(char**, int**, int))
 {
   int i, tdone;
   char** ptrs;
@@ -1198,7 +1208,7 @@ int jerasure_schedule_decode_lazy(int k, int m, int w, int* bitmatrix,
   }
 
   for (tdone = 0; tdone < size; tdone += packetsize * w) {
-    jerasure_do_scheduled_operations(ptrs, schedule, packetsize);
+    do_ops(ptrs, schedule, packetsize);
 
     for (i = 0; i < k + m; i++) {
       ptrs[i] += (packetsize * w);
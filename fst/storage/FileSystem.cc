@@ -65,8 +65,13 @@ FileSystem::FileSystem(const char* queuepath,
 /*----------------------------------------------------------------------------*/
 FileSystem::~FileSystem()
 {
-  if (scanDir) {
-    delete scanDir;
+  {
+    XrdSysMutexHelper lock(scanDirMutex);
+
+    if (scanDir) {
+      delete scanDir;
+      scanDir = 0;
+    }
   }
 
   if (mFileIO) {
@@ -318,6 +323,8 @@ FileSystem::RunScanner(Load* fstLoad, time_t interval)
     return;
   }
 
+  XrdSysMutexHelper lock(scanDirMutex);
+
   if (scanDir) {
     delete scanDir;
   }
@@ -328,6 +335,20 @@ FileSystem::RunScanner(Load* fstLoad, time_t interval)
            (unsigned long) interval);
 }
 
+/*----------------------------------------------------------------------------*/
+bool
+FileSystem::GetScanStats(ScanStats& stats)
+{
+  XrdSysMutexHelper lock(scanDirMutex);
+
+  if (!scanDir) {
+    return false;
+  }
+
+  scanDir->GetStats(stats);
+  return true;
+}
+
 /*----------------------------------------------------------------------------*/
 bool
 FileSystem::OpenTransaction(unsigned long long fid)
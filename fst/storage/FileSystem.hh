@@ -48,6 +48,7 @@ EOSFSTNAMESPACE_BEGIN
 
 class TransferQueue;
 class ScanDir;
+struct ScanStats;
 
 /*----------------------------------------------------------------------------*/
 class FileSystem : public eos::common::FileSystem, eos::common::LogId
@@ -58,6 +59,7 @@ private:
   eos::common::Statfs*
   statFs; // the owner of the object is a global hash in eos::common::Statfs - this are just references
   eos::fst::ScanDir* scanDir; // the class scanning checksum on a filesystem
+  XrdSysMutex scanDirMutex; // protects the scanner against a restart
   unsigned long last_blocks_free;
   time_t last_status_broadcast;
   eos::common::FileSystem::fsstatus_t
@@ -94,6 +96,13 @@ public:
 
   void RunScanner(Load* fstLoad, time_t interval);
 
+  //----------------------------------------------------------------------------
+  //! Get the progress of the scanner
+  //!
+  //! @return false if no scanner is running
+  //----------------------------------------------------------------------------
+  bool GetScanStats(ScanStats& stats);
+
   std::string
   GetPath()
   {
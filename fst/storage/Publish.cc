@@ -25,6 +25,7 @@
 #include "fst/XrdFstOfs.hh"
 #include "fst/txqueue/TransferQueue.hh"
 #include "fst/storage/FileSystem.hh"
+#include "fst/ScanDir.hh"
 #include "common/LinuxStat.hh"
 #include "common/ShellCmd.hh"
 
@@ -291,6 +292,25 @@ Storage::Publish()
                                              writeratemb);
             success &= mFsVect[i]->SetDouble("stat.disk.load", diskload);
           }
+          // copy out scanner progress
+          {
+            ScanStats scan;
+
+            if (mFsVect[i]->GetScanStats(scan)) {
+              success &= mFsVect[i]->SetLongLong("stat.scan.files", scan.mFiles);
+              success &= mFsVect[i]->SetLongLong("stat.scan.scannedfiles",
+                                                 scan.mScannedFiles);
+              success &= mFsVect[i]->SetLongLong("stat.scan.corruptfiles",
+                                                 scan.mCorruptFiles);
+              success &= mFsVect[i]->SetLongLong("stat.scan.bytes",
+                                                 scan.mScannedBytes);
+              success &= mFsVect[i]->SetDouble("stat.scan.progress",
+                                               scan.mProgress);
+              success &= mFsVect[i]->SetDouble("stat.scan.ratemb", scan.mRateMB);
+              success &= mFsVect[i]->SetDouble("stat.scan.throughputmb",
+                                               scan.mThroughputMB);
+            }
+          }
           // copy out net info
           {
             // File system implementation may override standard implementation
@@ -0,0 +1,164 @@
+//------------------------------------------------------------------------------
+// File: RainKernelsBenchmark.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! Single core microbenchmark of the RAIN parity kernels. Reports in GB/s of
+//! data processed the XOR of two blocks and the Cauchy Reed-Solomon encoding
+//! and decoding (all parity stripes lost) as done by the RAID6 and archive
+//! layouts, for the plain jerasure code and for each instruction set
+//! supported by RainKernels.
+//!
+//! Usage: eos-fst-rain-kernels-bench [stripe_width_kb] [iterations]
+//------------------------------------------------------------------------------
+
+#include "fst/layout/RainKernels.hh"
+#include "fst/layout/jerasure/include/jerasure.h"
+#include "fst/layout/jerasure/include/cauchy.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+using eos::fst::RainKernels;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Run the function the given number of times and return the rate in GB/s
+//------------------------------------------------------------------------------
+double
+Measure(const std::function<void()>& func, size_t bytes, size_t iterations)
+{
+  func(); // warm up
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < iterations; ++i) {
+    func();
+  }
+
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return (1.0 * bytes * iterations) / elapsed.count() / 1e9;
+}
+
+//------------------------------------------------------------------------------
+// Print the rate of the XOR, encode and decode operations for one code
+//------------------------------------------------------------------------------
+void
+BenchCode(int k, int m, size_t width, size_t iterations)
+{
+  const int w = 8;
+  int packetsize = width / (w * sizeof(int));
+  int* matrix = cauchy_good_general_coding_matrix(k, m, w);
+  int* bitmatrix = jerasure_matrix_to_bitmatrix(k, m, w, matrix);
+  int** schedule = jerasure_smart_bitmatrix_to_schedule(k, m, w, bitmatrix);
+  std::vector<std::vector<char>> blocks(k + m, std::vector<char>(width));
+  std::vector<char*> data, coding;
+  std::vector<int> erasures;
+
+  for (int i = 0; i < k + m; ++i) {
+    for (size_t j = 0; j < width; ++j) {
+      blocks[i][j] = (char)(i * 131 + j * 7);
+    }
+
+    if (i < k) {
+      data.push_back(blocks[i].data());
+    } else {
+      coding.push_back(blocks[i].data());
+      erasures.push_back(i);
+    }
+  }
+
+  erasures.push_back(-1);
+  size_t bytes = k * width;
+  auto encode_jerasure = [&]() {
+    jerasure_schedule_encode(k, m, w, schedule, data.data(), coding.data(),
+                             width, packetsize);
+  };
+  auto decode_jerasure = [&]() {
+    jerasure_schedule_decode_lazy(k, m, w, bitmatrix, erasures.data(),
+                                  data.data(), coding.data(), width,
+                                  packetsize, 1);
+  };
+  auto encode = [&]() {
+    RainKernels::ScheduleEncode(k, m, w, schedule, data.data(), coding.data(),
+                                width, packetsize);
+  };
+  auto decode = [&]() {
+    jerasure_schedule_decode_lazy_ops(k, m, w, bitmatrix, erasures.data(),
+                                      data.data(), coding.data(), width,
+                                      packetsize, 1,
+                                      RainKernels::DoScheduledOperations);
+  };
+  auto xor2 = [&]() {
+    RainKernels::Xor(data[0], data[1], coding[0], width);
+  };
+  fprintf(stdout, "%2i+%i %-9s %10s %10.2f %10.2f\n", k, m, "jerasure", "-",
+          Measure(encode_jerasure, bytes, iterations),
+          Measure(decode_jerasure, bytes, iterations));
+  RainKernels::Isa saved = RainKernels::GetIsa();
+
+  for (int i = RainKernels::kGeneric; i <= RainKernels::GetBestIsa(); ++i) {
+    if (!RainKernels::SetIsa((RainKernels::Isa) i)) {
+      continue;
+    }
+
+    fprintf(stdout, "%2i+%i %-9s %10.2f %10.2f %10.2f\n", k, m,
+            RainKernels::GetIsaName((RainKernels::Isa) i),
+            Measure(xor2, 2 * width, iterations * k),
+            Measure(encode, bytes, iterations),
+            Measure(decode, bytes, iterations));
+  }
+
+  RainKernels::SetIsa(saved);
+  jerasure_free_schedule(schedule);
+  free(bitmatrix);
+  free(matrix);
+}
+}
+
+//------------------------------------------------------------------------------
+// Main function
+//------------------------------------------------------------------------------
+int
+main(int argc, char* argv[])
+{
+  size_t width = 1024 * ((argc > 1) ? strtoul(argv[1], 0, 10) : 1024);
+  size_t iterations = (argc > 2) ? strtoul(argv[2], 0, 10) : 50;
+
+  if (width % (8 * sizeof(int))) {
+    fprintf(stderr, "error: stripe width must be a multiple of 32 bytes\n");
+    return -1;
+  }
+
+  fprintf(stdout, "stripe width %zu KB, GB/s on one core\n", width / 1024);
+  fprintf(stdout, "%-4s %-9s %10s %10s %10s\n", "code", "kernel", "xor",
+          "encode", "decode");
+  // RAID6 and archive layouts for a few stripe numbers
+  BenchCode(4, 2, width, iterations);
+  BenchCode(8, 2, width, iterations);
+  BenchCode(5, 3, width, iterations);
+  BenchCode(9, 3, width, iterations);
+  return 0;
+}
@@ -0,0 +1,201 @@
+//------------------------------------------------------------------------------
+// File: RainWriteBenchmark.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! Benchmark of the streaming write path of the RAIN layouts. A file is
+//! written sequentially through a ReedSLayout opened in parallel IO mode on
+//! local stripe files, once with the parity computed synchronously and once
+//! with the parity computation pipelined, for RAID6 and archive layouts and
+//! several stripe widths. The stripe and parity files of both runs are
+//! compared to make sure the pipeline produces the same output.
+//!
+//! Usage: eos-fst-rain-bench [directory] [size_mb] [parity_depth]
+//------------------------------------------------------------------------------
+
+#include "common/LayoutId.hh"
+#include "fst/layout/ReedSLayout.hh"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using eos::common::LayoutId;
+using eos::fst::ReedSLayout;
+
+namespace
+{
+const size_t sWriteSize = 1024 * 1024; ///< size of one client write
+
+//------------------------------------------------------------------------------
+// Get the stripe file names of a benchmark run
+//------------------------------------------------------------------------------
+std::vector<std::string>
+GetStripes(const std::string& dir, unsigned long lid, const std::string& tag)
+{
+  std::vector<std::string> stripes;
+
+  for (unsigned int i = 0; i <= LayoutId::GetStripeNumber(lid); ++i) {
+    stripes.push_back(dir + "/eos-rain-bench." + tag + ".stripe" +
+                      std::to_string(i));
+  }
+
+  return stripes;
+}
+
+//------------------------------------------------------------------------------
+// Write a file of the given size and return the throughput in MB/s or a
+// negative value if an error occurred. The stripe files are kept.
+//------------------------------------------------------------------------------
+double
+WriteFile(const std::string& dir, unsigned long lid, unsigned int depth,
+          size_t size_mb, const std::string& tag)
+{
+  std::string sdepth = std::to_string(depth);
+  setenv("EOS_FST_RAIN_PARITY_DEPTH", sdepth.c_str(), 1);
+  std::vector<std::string> stripes = GetStripes(dir, lid, tag);
+
+  std::vector<char> buffer(sWriteSize);
+
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = (char)(i * 31 + 7);
+  }
+
+  double rate = -1;
+  {
+    ReedSLayout layout(NULL, lid, NULL, NULL, "/eos-rain-bench", 0, true);
+
+    if (layout.OpenPio(stripes, O_CREAT | O_RDWR | O_TRUNC, 0600)) {
+      fprintf(stderr, "error: failed to open stripes in %s\n", dir.c_str());
+      return rate;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool failed = false;
+
+    for (size_t i = 0; i < size_mb; ++i) {
+      if (layout.Write(i * sWriteSize, buffer.data(), sWriteSize) < 0) {
+        failed = true;
+        break;
+      }
+    }
+
+    if (layout.Close() || failed) {
+      fprintf(stderr, "error: failed to write file\n");
+    } else {
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+      rate = size_mb * (1.0 * sWriteSize / (1024 * 1024)) / elapsed.count();
+    }
+  }
+
+  return rate;
+}
+
+//------------------------------------------------------------------------------
+// Compare the stripe files of two runs and remove them
+//
+// @return true if all the stripe and parity files are identical
+//------------------------------------------------------------------------------
+bool
+CompareAndRemove(const std::string& dir, unsigned long lid,
+                 const std::string& tag1, const std::string& tag2)
+{
+  std::vector<std::string> stripes1 = GetStripes(dir, lid, tag1);
+  std::vector<std::string> stripes2 = GetStripes(dir, lid, tag2);
+  bool same = true;
+
+  for (size_t i = 0; i < stripes1.size(); ++i) {
+    std::ifstream file1(stripes1[i], std::ios::binary);
+    std::ifstream file2(stripes2[i], std::ios::binary);
+    std::vector<char> buf1(sWriteSize), buf2(sWriteSize);
+    bool differ = (!file1 || !file2);
+
+    while (!differ && file1 && file2) {
+      file1.read(buf1.data(), buf1.size());
+      file2.read(buf2.data(), buf2.size());
+      differ = (file1.gcount() != file2.gcount()) ||
+               memcmp(buf1.data(), buf2.data(), file1.gcount());
+    }
+
+    if (differ) {
+      fprintf(stderr, "error: stripe %zu differs between %s and %s\n", i,
+              tag1.c_str(), tag2.c_str());
+      same = false;
+    }
+
+    (void) unlink(stripes1[i].c_str());
+    (void) unlink(stripes2[i].c_str());
+  }
+
+  return same;
+}
+}
+
+//------------------------------------------------------------------------------
+// Main function
+//------------------------------------------------------------------------------
+int
+main(int argc, char* argv[])
+{
+  std::string dir = (argc > 1) ? argv[1] : "/tmp";
+  size_t size_mb = (argc > 2) ? strtoul(argv[2], 0, 10) : 1024;
+  unsigned int depth = (argc > 3) ? strtoul(argv[3], 0, 10) : 2;
+  struct Config {
+    const char* mName;
+    int mType;
+    int mStripes;
+  };
+  std::vector<Config> configs {
+    {"raid6", LayoutId::kRaid6, 6},
+    {"raid6", LayoutId::kRaid6, 10},
+    {"archive", LayoutId::kArchive, 8},
+    {"archive", LayoutId::kArchive, 12}
+  };
+  std::vector<int> widths {LayoutId::k64k, LayoutId::k1M, LayoutId::k4M};
+  fprintf(stdout, "%-8s %7s %10s %12s %12s %8s\n", "layout", "stripes",
+          "width", "sync[MB/s]", "pipe[MB/s]", "speedup");
+
+  for (const auto& cfg : configs) {
+    for (int width : widths) {
+      unsigned long lid = LayoutId::GetId(cfg.mType, LayoutId::kNone,
+                                          cfg.mStripes, width);
+      double sync_rate = WriteFile(dir, lid, 1, size_mb, "sync");
+      double pipe_rate = WriteFile(dir, lid, depth, size_mb, "pipe");
+
+      if (!CompareAndRemove(dir, lid, "sync", "pipe") || (sync_rate <= 0) ||
+          (pipe_rate <= 0)) {
+        return -1;
+      }
+
+      fprintf(stdout, "%-8s %7i %10lu %12.1f %12.1f %8.2f\n", cfg.mName,
+              cfg.mStripes, LayoutId::GetBlocksize(lid), sync_rate, pipe_rate,
+              pipe_rate / sync_rate);
+    }
+  }
+
+  return 0;
+}
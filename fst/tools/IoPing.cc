@@ -36,6 +36,8 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 
+#include "fst/io/local/FsIo.hh"
+
 #ifdef __linux__
 # include <sys/ioctl.h>
 # include <sys/mount.h>
@@ -225,7 +227,7 @@ void usage(void)
 {
   fprintf(stderr,
           " Usage: ioping [-LABCDWRq] [-c count] [-w deadline] [-pP period] [-i interval]\n"
-          "               [-s size] [-S wsize] [-o offset] directory|file|device\n"
+          "               [-s size] [-S wsize] [-o offset] [-Q depth] directory|file|device\n"
           "        ioping -h | -v\n"
           "\n"
           "      -c <count>      stop after <count> requests\n"
@@ -239,6 +241,8 @@ void usage(void)
           "      -k              keep and reuse temporary working file\n"
           "      -L              use sequential operations (includes -s 256k)\n"
           "      -A              use asynchronous I/O\n"
+          "      -Q <depth>      submit <depth> requests at once through the FST local IO\n"
+          "                      asynchronous API\n"
           "      -C              use cached I/O\n"
           "      -D              use direct I/O\n"
           "      -W              use write I/O *DANGEROUS*\n"
@@ -419,6 +423,7 @@ int async = 0;
 int cached = 0;
 int randomize = 1;
 int write_test = 0;
+int queue_depth = 1;
 
 ssize_t (*make_request)(int fd, void* buf, size_t nbytes, off_t offset) = pread;
 
@@ -452,7 +457,7 @@ void parse_options(int argc, char** argv)
     exit(1);
   }
 
-  while ((opt = getopt(argc, argv, "hvkALRDCWBqi:w:s:S:c:o:p:P:")) != -1) {
+  while ((opt = getopt(argc, argv, "hvkALRDCWBqi:w:s:S:c:o:p:P:Q:")) != -1) {
     switch (opt) {
     case 'h':
       usage();
@@ -486,6 +491,10 @@ void parse_options(int argc, char** argv)
       async = 1;
       break;
 
+    case 'Q':
+      queue_depth = parse_int(optarg);
+      break;
+
     case 'W':
       write_test++;
       break;
@@ -826,6 +835,82 @@ static void aio_setup(void)
 
 #endif
 
+eos::fst::FsIo* fsio;
+
+/*
+ * Submit queue_depth requests at once through the asynchronous API of the
+ * FST local files and wait for all of them: the first one at the given
+ * offset, the others at the next positions of the working set, random or
+ * sequential. Returns the total size.
+ */
+static ssize_t fsio_batch(int fd, void* buf, size_t nbytes, off_t first)
+{
+  ssize_t total = 0;
+  int i;
+
+  for (i = 0; i < queue_depth; i++) {
+    off_t this_offset = first;
+    char* this_buf = (char*) buf + i * nbytes;
+    int64_t ret;
+
+    if (i && randomize) {
+      this_offset = offset + random() % (wsize / nbytes) * nbytes;
+    } else if (i) {
+      this_offset = offset + (first - offset + i * nbytes) %
+                    (wsize / nbytes * nbytes);
+    }
+
+#ifdef HAVE_POSIX_FADVICE
+
+    if (i && !cached && posix_fadvise(fd, this_offset, nbytes,
+                                      POSIX_FADV_DONTNEED)) {
+      err(3, "fadvise failed");
+    }
+
+#endif
+
+    if (write_test) {
+      ret = fsio->fileWriteAsync(this_offset, this_buf, nbytes);
+    } else {
+      ret = fsio->fileReadAsync(this_offset, this_buf, nbytes);
+    }
+
+    if (ret < 0) {
+      err(1, "asynchronous request submission failed");
+    }
+
+    total += nbytes;
+  }
+
+  if (fsio->fileWaitAsyncIO()) {
+    errno = EIO;
+    return -1;
+  }
+
+  if (write_test && !cached && fdatasync(fd) < 0) {
+    return -1;
+  }
+
+  return total;
+}
+
+/*
+ * Open the target descriptor as an FST local file, the requests of the
+ * batch go to the same file as the synchronous ones.
+ */
+static void fsio_setup(int flags)
+{
+  char fd_path[64];
+  snprintf(fd_path, sizeof fd_path, "/proc/self/fd/%d", fd);
+  fsio = new eos::fst::FsIo(fd_path);
+
+  if (fsio->fileOpen(flags)) {
+    err(2, "failed to open \"%s\" for asynchronous I/O", path);
+  }
+
+  make_request = fsio_batch;
+}
+
 #ifdef __MINGW32__
 
 int create_temp(char* path, char* name)
@@ -993,6 +1078,10 @@ int main(int argc, char** argv)
     errx(1, "request size must be greather than zero");
   }
 
+  if (queue_depth <= 0) {
+    errx(1, "queue depth must be greather than zero");
+  }
+
   flags = O_RDONLY;
 #if !defined(HAVE_POSIX_FADVICE) && !defined(HAVE_NOCACHE_IO)
 # if defined(HAVE_DIRECT_IO)
@@ -1068,13 +1157,13 @@ int main(int argc, char** argv)
     errx(2, "request size is too big for this target");
   }
 
-  ret = posix_memalign(&buf, 0x1000, size);
+  ret = posix_memalign(&buf, 0x1000, size * queue_depth);
 
   if (ret) {
     errx(2, "buffer allocation failed");
   }
 
-  memset(buf, '*', size);
+  memset(buf, '*', size * queue_depth);
 
   if (S_ISDIR(st.st_mode)) {
     fd = create_temp(path, (char*)"ioping.tmp");
@@ -1113,6 +1202,10 @@ skip_preparation:
     }
   }
 
+  if (queue_depth > 1) {
+    fsio_setup(flags);
+  }
+
   if (!cached) {
 #ifdef HAVE_POSIX_FADVICE
     ret = posix_fadvise(fd, offset, wsize, POSIX_FADV_RANDOM);
@@ -1151,8 +1244,8 @@ skip_preparation:
   period_deadline = time_now + period_time;
 
   while (!exiting) {
-    request++;
-    part_request++;
+    request += queue_depth;
+    part_request += queue_depth;
 
     if (randomize) {
       woffset = random() % (wsize / size) * size;
@@ -1180,15 +1273,16 @@ skip_preparation:
     time_now = now();
     this_time = time_now - this_time;
     time_next = time_now + interval;
+    /* a batch counts as queue_depth requests of the average latency */
     part_sum += this_time;
-    part_sum2 += this_time * this_time;
+    part_sum2 += (double) this_time * this_time / queue_depth;
 
-    if (this_time < part_min) {
-      part_min = this_time;
+    if ((double) this_time / queue_depth < part_min) {
+      part_min = (double) this_time / queue_depth;
     }
 
-    if (this_time > part_max) {
-      part_max = this_time;
+    if ((double) this_time / queue_depth > part_max) {
+      part_max = (double) this_time / queue_depth;
     }
 
     if (!quiet) {
@@ -1233,10 +1327,10 @@ skip_preparation:
     }
 
     if (!randomize) {
-      woffset += size;
+      woffset += size * queue_depth;
 
       if (woffset + size > wsize) {
-        woffset = 0;
+        woffset %= wsize / size * size;
       }
     }
 
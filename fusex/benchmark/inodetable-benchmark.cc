@@ -0,0 +1,152 @@
+//------------------------------------------------------------------------------
+//! @file inodetable-benchmark.cc
+//! @brief Parallel stat/lookup storms against the metadata inode table
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "md/InodeTable.hh"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: inodetable-benchmark [threads] [inodes] [ops-per-thread]
+//
+// Every thread runs a storm of operations on random inodes: 90% lookups
+// (stat, lookup, getattr), 5% inserts (create) and 5% erase and re-insert
+// (forget, flush). The sharded table is compared to the previous single
+// mutex std::map.
+
+struct mdobj {
+  uint64_t id;
+};
+
+typedef std::shared_ptr<mdobj> shared_obj;
+
+//------------------------------------------------------------------------------
+//! The previous inode table - one lock around an ordered map
+//------------------------------------------------------------------------------
+class lockedmap
+{
+public:
+  bool retrieveTS(uint64_t ino, shared_obj& ret)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mMap.find(ino);
+
+    if (it == mMap.end()) {
+      return false;
+    }
+
+    ret = it->second;
+    return true;
+  }
+
+  void insertTS(uint64_t ino, const shared_obj& obj)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMap[ino] = obj;
+  }
+
+  void eraseTS(uint64_t ino)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMap.erase(ino);
+  }
+
+private:
+  std::mutex mMutex;
+  std::map<uint64_t, shared_obj> mMap;
+};
+
+template <typename Table>
+double storm(Table& table, size_t nthreads, uint64_t ninodes, size_t nops)
+{
+  for (uint64_t ino = 1; ino <= ninodes; ++ino) {
+    table.insertTS(ino, std::make_shared<mdobj>(mdobj{ino}));
+  }
+
+  std::atomic<uint64_t> found(0);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&, t]() {
+      std::mt19937_64 gen(t + 1);
+      uint64_t hits = 0;
+      shared_obj obj;
+
+      for (size_t i = 0; i < nops; ++i) {
+        uint64_t ino = 1 + gen() % ninodes;
+        unsigned int op = gen() % 100;
+
+        if (op < 90) {
+          hits += table.retrieveTS(ino, obj);
+        } else if (op < 95) {
+          table.insertTS(ino + ninodes, std::make_shared<mdobj>(mdobj{ino}));
+        } else {
+          if (table.retrieveTS(ino, obj)) {
+            table.eraseTS(ino);
+            table.insertTS(ino, obj);
+          }
+        }
+      }
+
+      found += hits;
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+                                          start;
+  return (nthreads * nops) / elapsed.count();
+}
+
+int main(int argc, char* argv[])
+{
+  size_t nthreads = (argc > 1) ? strtoul(argv[1], 0, 10) : 16;
+  uint64_t ninodes = (argc > 2) ? strtoull(argv[2], 0, 10) : 1000000;
+  size_t nops = (argc > 3) ? strtoul(argv[3], 0, 10) : 1000000;
+  fprintf(stderr, "# threads=%lu inodes=%lu ops/thread=%lu\n", nthreads,
+          ninodes, nops);
+
+  for (size_t n = 1; n <= nthreads; n *= 2) {
+    double map_rate, table_rate;
+    {
+      lockedmap table;
+      map_rate = storm(table, n, ninodes, nops);
+    }
+    {
+      InodeTable<uint64_t, shared_obj> table;
+      table_rate = storm(table, n, ninodes, nops);
+    }
+    fprintf(stdout, "threads=%-3lu map=%.02f Mops/s sharded=%.02f Mops/s "
+            "speedup=%.02f\n", n, map_rate / 1e6, table_rate / 1e6,
+            table_rate / map_rate);
+  }
+
+  return 0;
+}
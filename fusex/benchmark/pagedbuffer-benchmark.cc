@@ -0,0 +1,159 @@
+//------------------------------------------------------------------------------
+//! @file pagedbuffer-benchmark.cc
+//! @brief Write and read throughput of the fusex memory cache buffers
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "data/bufferll.hh"
+#include "data/pagedbuffer.hh"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// usage: pagedbuffer-benchmark [files] [file-mb] [io-kb] [budget-mb] [spill-dir]
+//
+// Every thread owns one file buffer. The files are written sequentially with
+// io-kb writes and read back. New files are then written at random io-kb
+// aligned offsets starting with the last block, which the previous
+// contiguous buffer pays with the whole prefix. The paged buffer runs once
+// without budget and once with a budget of budget-mb shared by all files,
+// evicting to spill-dir.
+
+struct result {
+  double write_mbs;
+  double read_mbs;
+  double random_mbs;
+  uint64_t rss_mb;
+};
+
+//------------------------------------------------------------------------------
+// Resident memory of the process in MB
+//------------------------------------------------------------------------------
+uint64_t rss_mb()
+{
+  FILE* f = fopen("/proc/self/statm", "r");
+  unsigned long pages = 0, rss = 0;
+
+  if (f) {
+    if (fscanf(f, "%lu %lu", &pages, &rss) != 2) {
+      rss = 0;
+    }
+
+    fclose(f);
+  }
+
+  return rss * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+template <typename Buffer>
+result run(size_t nfiles, size_t file_size, size_t io_size)
+{
+  std::vector<std::unique_ptr<Buffer>> buffers;
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    buffers.emplace_back(new Buffer());
+  }
+
+  auto parallel = [&](std::function<void(size_t)> fn) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < nfiles; ++i) {
+      threads.emplace_back(fn, i);
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+                                            start;
+    return (nfiles * file_size / (1024.0 * 1024.0)) / elapsed.count();
+  };
+  result res;
+  res.write_mbs = parallel([&](size_t i) {
+    std::string data(io_size, (char)('a' + i));
+
+    for (size_t off = 0; off + io_size <= file_size; off += io_size) {
+      buffers[i]->writeData(data.data(), off, io_size);
+    }
+  });
+  res.read_mbs = parallel([&](size_t i) {
+    std::string data(io_size, '\0');
+
+    for (size_t off = 0; off + io_size <= file_size; off += io_size) {
+      buffers[i]->readData(&data[0], off, io_size);
+    }
+  });
+  buffers.clear();
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    buffers.emplace_back(new Buffer());
+  }
+
+  res.random_mbs = parallel([&](size_t i) {
+    std::mt19937_64 gen(i + 1);
+    std::string data(io_size, (char)('A' + i));
+    size_t nblocks = file_size / io_size;
+    // the last block first: the file starts out with its final size
+    buffers[i]->writeData(data.data(), (nblocks - 1) * io_size, io_size);
+
+    for (size_t n = 1; n < nblocks; ++n) {
+      buffers[i]->writeData(data.data(), (gen() % nblocks) * io_size, io_size);
+    }
+  });
+  res.rss_mb = rss_mb();
+  return res;
+}
+
+void print(const char* name, const result& res)
+{
+  fprintf(stdout, "%-22s write=%8.02f MB/s read=%8.02f MB/s "
+          "random-write=%8.02f MB/s rss=%lu MB\n", name, res.write_mbs,
+          res.read_mbs, res.random_mbs, res.rss_mb);
+}
+
+int main(int argc, char* argv[])
+{
+  size_t nfiles = (argc > 1) ? strtoul(argv[1], 0, 10) : 8;
+  size_t file_size = ((argc > 2) ? strtoul(argv[2], 0, 10) : 256) << 20;
+  size_t io_size = ((argc > 3) ? strtoul(argv[3], 0, 10) : 128) << 10;
+  uint64_t budget = ((argc > 4) ? strtoull(argv[4], 0, 10) : 512) << 20;
+  std::string spill = (argc > 5) ? argv[5] : "/var/tmp";
+  fprintf(stderr, "# files=%lu file-size=%lu io-size=%lu budget=%lu spill=%s\n",
+          nfiles, file_size, io_size, budget, spill.c_str());
+  print("pagedbuffer", run<pagedbuffer>(nfiles, file_size, io_size));
+  pagepool::instance().set_budget(budget);
+  pagepool::instance().set_spill_path(spill);
+  print("pagedbuffer+budget", run<pagedbuffer>(nfiles, file_size, io_size));
+  fprintf(stdout, "%-22s evictions=%lu spills=%lu\n", "",
+          pagepool::instance().evictions(), pagepool::instance().spills());
+  pagepool::instance().set_budget(0);
+  // last, the memory freed by the vectors would inflate the rss of the others
+  print("bufferll", run<bufferll>(nfiles, file_size, io_size));
+  return 0;
+}
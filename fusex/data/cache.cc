@@ -44,6 +44,12 @@ cachehandler::init(cacheconfig& _config)
     return EINVAL;
   }
 
+  if (config.type == cache_t::MEMORY) {
+    pagepool::instance().set_budget(config.total_file_cache_size);
+    // pages evicted from the budget go to the cache location
+    pagepool::instance().set_spill_path(config.location);
+  }
+
   if (config.type == cache_t::DISK) {
     if (diskcache::init(config)) {
       fprintf(stderr,
@@ -106,6 +112,22 @@ cachehandler::logconfig()
                      (config.type == cache_t::MEMORY) ? "memory" :
                      "disk");
 
+  if (config.type == cache_t::MEMORY) {
+    std::string s;
+
+    if (config.total_file_cache_size == 0) {
+      eos_static_warning("data-cache-size      := unlimited");
+    } else {
+      eos_static_warning("data-cache-size      := %s",
+                         eos::common::StringConversion::GetReadableSizeString(s,
+                             config.total_file_cache_size, "B"));
+    }
+
+    eos_static_warning("data-cache-spill     := %s",
+                       config.location.length() ? config.location.c_str() :
+                       "disabled");
+  }
+
   if (config.type == cache_t::DISK) {
     eos_static_warning("data-cache-location  := %s",
                        config.location.c_str());
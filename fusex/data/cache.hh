@@ -61,6 +61,13 @@ public:
     return 0;
   }
 
+  // true if data written to the cache was dropped and has to be read back
+  // from the journal or the remote file
+  virtual bool dropped()
+  {
+    return false;
+  }
+
   virtual int set_attr(const std::string& key, const std::string& value) = 0;
   virtual int attr(const std::string &key, std::string& value) = 0;
 
@@ -1534,8 +1534,9 @@ data::datax::pread(fuse_req_t req, void* buf, size_t count, off_t offset)
                           req) : mFile->xrdiorw(req);
 
   if (proxy) {
-    if (!mFile->is_caching()) {
-      // if caching is disabled, we wait for outstanding writes
+    if (!mFile->is_caching() || (mFile->file() && mFile->file()->dropped())) {
+      // if caching is disabled or the cache dropped written data, we wait for
+      // outstanding writes
       XrdCl::XRootDStatus status = proxy->WaitWrite();
       // it is not obvious what we should do if there was a write error,
       // we just proceed
@@ -28,7 +28,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "llfusexx.hh"
-#include "bufferll.hh"
+#include "pagedbuffer.hh"
 #include "cache.hh"
 #include "XrdSys/XrdSysPthread.hh"
 #include <map>
@@ -53,11 +53,16 @@ public:
 
   virtual size_t size() override;
 
+  virtual bool dropped() override
+  {
+    return buffer.hasDropped();
+  }
+
   virtual int set_attr(const std::string& key, const std::string& value) override;
   virtual int attr(const std::string& key, std::string& value) override;
 
 private:
-  bufferll buffer;
+  pagedbuffer buffer;
   XrdSysMutex xattrmtx;
   std::map<std::string, std::string> xattr;
   fuse_ino_t ino;
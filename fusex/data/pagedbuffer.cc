@@ -0,0 +1,630 @@
+//------------------------------------------------------------------------------
+//! @file pagedbuffer.cc
+//! @brief sparse page based file buffer with a process wide memory budget
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "pagedbuffer.hh"
+#include <algorithm>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+//! Maximum number of page buffers kept for recycling
+const size_t sMaxFreePages = 256;
+}
+
+const size_t pagepool::sPageSize;
+
+/* -------------------------------------------------------------------------- */
+pagespill::~pagespill()
+/* -------------------------------------------------------------------------- */
+{
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+bool
+/* -------------------------------------------------------------------------- */
+pagespill::write(const std::string& dir, const char* buf, size_t len,
+                 off_t offset)
+/* -------------------------------------------------------------------------- */
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (fd < 0) {
+      if (dir.empty()) {
+        return false;
+      }
+
+      std::string tmpl = dir + "/pagedbuffer.XXXXXX";
+      fd = mkstemp(&tmpl[0]);
+
+      if (fd < 0) {
+        return false;
+      }
+
+      ::unlink(tmpl.c_str());
+    }
+  }
+
+  size_t done = 0;
+
+  while (done < len) {
+    ssize_t nw = ::pwrite(fd, buf + done, len - done, offset + done);
+
+    if (nw < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return false;
+    }
+
+    done += nw;
+  }
+
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+bool
+/* -------------------------------------------------------------------------- */
+pagespill::read(char* buf, size_t len, off_t offset)
+/* -------------------------------------------------------------------------- */
+{
+  if (fd < 0) {
+    return false;
+  }
+
+  size_t done = 0;
+
+  while (done < len) {
+    ssize_t nr = ::pread(fd, buf + done, len - done, offset + done);
+
+    if (nr < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return false;
+    }
+
+    if (nr == 0) {
+      // cut by a truncation
+      memset(buf + done, 0, len - done);
+      break;
+    }
+
+    done += nr;
+  }
+
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+pagespill::truncate(off_t offset)
+/* -------------------------------------------------------------------------- */
+{
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if (fd >= 0) {
+    (void) ::ftruncate(fd, offset);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+pagepool&
+/* -------------------------------------------------------------------------- */
+pagepool::instance()
+/* -------------------------------------------------------------------------- */
+{
+  static pagepool sPool;
+  return sPool;
+}
+
+/* -------------------------------------------------------------------------- */
+pagepool::pagepool() : mBudget(0), mInuse(0), mEvictions(0), mSpills(0)
+/* -------------------------------------------------------------------------- */
+{
+}
+
+/* -------------------------------------------------------------------------- */
+pagepool::~pagepool()
+/* -------------------------------------------------------------------------- */
+{
+  for (auto data : mFree) {
+    delete[] data;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+pagepool::set_budget(uint64_t bytes)
+/* -------------------------------------------------------------------------- */
+{
+  mBudget = bytes;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+pagepool::set_spill_path(const std::string& path)
+/* -------------------------------------------------------------------------- */
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  mSpillPath = path;
+}
+
+/* -------------------------------------------------------------------------- */
+char*
+/* -------------------------------------------------------------------------- */
+pagepool::evict_one()
+/* -------------------------------------------------------------------------- */
+{
+  // second chance: recently referenced pages are moved to the back once
+  size_t scan = 2 * mLru.size();
+
+  while (!mLru.empty() && scan--) {
+    auto it = mLru.begin();
+    std::shared_ptr<bufferpage> page = *it;
+
+    if (page->referenced.exchange(false)) {
+      mLru.splice(mLru.end(), mLru, it);
+      continue;
+    }
+
+    std::lock_guard<std::mutex> pLock(page->mtx);
+
+    // the page content goes to the spill file unless it is there already,
+    // without a copy on disk the page is dropped and counted as lost
+    if (page->dirty || !page->ondisk) {
+      page->ondisk = page->spill->write(mSpillPath, page->data, sPageSize,
+                                        page->index * sPageSize);
+
+      if (page->ondisk) {
+        mSpills++;
+      }
+    }
+
+    if (!page->ondisk) {
+      page->spill->lost++;
+    }
+
+    char* data = page->data;
+    page->data = nullptr;
+    page->dirty = false;
+    mLru.erase(it);
+    mInuse--;
+    mEvictions++;
+    return data;
+  }
+
+  return nullptr;
+}
+
+/* -------------------------------------------------------------------------- */
+char*
+/* -------------------------------------------------------------------------- */
+pagepool::get_memory()
+/* -------------------------------------------------------------------------- */
+{
+  uint64_t budget = mBudget;
+  char* data = nullptr;
+
+  if (budget && ((mInuse + 1) * sPageSize > budget)) {
+    // reuse the memory of an evicted page
+    return evict_one();
+  } else if (mFree.size()) {
+    data = mFree.back();
+    mFree.pop_back();
+  }
+
+  if (!data) {
+    data = new char[sPageSize];
+  }
+
+  return data;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+pagepool::put_memory(char* data)
+/* -------------------------------------------------------------------------- */
+{
+  if (mFree.size() < sMaxFreePages) {
+    mFree.push_back(data);
+  } else {
+    delete[] data;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+bool
+/* -------------------------------------------------------------------------- */
+pagepool::allocate(const std::shared_ptr<bufferpage>& page)
+/* -------------------------------------------------------------------------- */
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  char* data = get_memory();
+
+  if (!data) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> pLock(page->mtx);
+  page->data = data;
+  page->referenced = true;
+  page->lru = mLru.insert(mLru.end(), page);
+  mInuse++;
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+bool
+/* -------------------------------------------------------------------------- */
+pagepool::reload(const std::shared_ptr<bufferpage>& page)
+/* -------------------------------------------------------------------------- */
+{
+  char* data = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    data = get_memory();
+
+    if (!data) {
+      return false;
+    }
+
+    mInuse++;
+  }
+  bool loaded = false;
+  bool present = false;
+  {
+    // the pool mutex is not held while reading the spill file
+    std::lock_guard<std::mutex> pLock(page->mtx);
+    present = (page->data != nullptr);
+
+    if (!present && page->ondisk &&
+        page->spill->read(data, sPageSize, page->index * sPageSize)) {
+      page->data = data;
+      page->dirty = false;
+      page->referenced = true;
+      loaded = true;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if (loaded) {
+    // the owning buffer is locked, nobody else can release the page
+    page->lru = mLru.insert(mLru.end(), page);
+    return true;
+  }
+
+  mInuse--;
+  put_memory(data);
+  return present;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+pagepool::release(const std::shared_ptr<bufferpage>& page)
+/* -------------------------------------------------------------------------- */
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  std::lock_guard<std::mutex> pLock(page->mtx);
+
+  if (!page->data) {
+    if (!page->ondisk) {
+      page->spill->lost--;
+    }
+
+    return;
+  }
+
+  mLru.erase(page->lru);
+  mInuse--;
+  put_memory(page->data);
+  page->data = nullptr;
+}
+
+/* -------------------------------------------------------------------------- */
+pagedbuffer::pagedbuffer() : mSize(0)
+/* -------------------------------------------------------------------------- */
+{
+}
+
+/* -------------------------------------------------------------------------- */
+pagedbuffer::~pagedbuffer()
+/* -------------------------------------------------------------------------- */
+{
+  eos::common::RWMutexWriteLock dLock(mMutex);
+  dropPages(0);
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+pagedbuffer::dropPages(uint64_t index)
+/* -------------------------------------------------------------------------- */
+{
+  auto it = mPages.lower_bound(index);
+
+  while (it != mPages.end()) {
+    pagepool::instance().release(it->second);
+    it = mPages.erase(it);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+size_t
+/* -------------------------------------------------------------------------- */
+pagedbuffer::writeData(const void* ptr, off_t offset, size_t dataSize)
+/* -------------------------------------------------------------------------- */
+{
+  eos::common::RWMutexWriteLock dLock(mMutex);
+  const size_t psize = pagepool::sPageSize;
+  const char* src = (const char*) ptr;
+  size_t done = 0;
+
+  while (done < dataSize) {
+    uint64_t pos = offset + done;
+    uint64_t index = pos / psize;
+    size_t poff = pos % psize;
+    size_t len = std::min(psize - poff, dataSize - done);
+    bool full = ((poff == 0) && (len == psize));
+    auto it = mPages.find(index);
+
+    if (it == mPages.end()) {
+      // new page, the parts not written are zero
+      auto page = std::make_shared<bufferpage>();
+      page->data = nullptr;
+      page->index = index;
+      page->dirty = true;
+      page->ondisk = false;
+      page->referenced = false;
+      page->spill = &mSpill;
+      mPages[index] = page;
+
+      if (pagepool::instance().allocate(page)) {
+        std::lock_guard<std::mutex> pLock(page->mtx);
+
+        if (page->data) {
+          if (poff) {
+            memset(page->data, 0, poff);
+          }
+
+          memcpy(page->data + poff, src + done, len);
+
+          if (poff + len < psize) {
+            memset(page->data + poff + len, 0, psize - poff - len);
+          }
+
+          done += len;
+          continue;
+        }
+      } else {
+        mSpill.lost++;
+      }
+
+      // no memory for this page, it stays dropped
+      done += len;
+      continue;
+    }
+
+    std::shared_ptr<bufferpage> page = it->second;
+    bool reloaded = false;
+
+    while (true) {
+      {
+        std::lock_guard<std::mutex> pLock(page->mtx);
+
+        if (page->data) {
+          memcpy(page->data + poff, src + done, len);
+          page->dirty = true;
+          page->referenced = true;
+          break;
+        }
+
+        if (page->ondisk && reloaded) {
+          // no memory to bring it back, update the copy on disk
+          if (!mSpill.write("", src + done, len, index * psize + poff)) {
+            page->ondisk = false;
+            mSpill.lost++;
+          }
+
+          break;
+        }
+      }
+
+      if (page->ondisk) {
+        // evicted to disk, bring it back and write to memory
+        pagepool::instance().reload(page);
+        reloaded = true;
+        continue;
+      }
+
+      // a dropped page can only be revived by overwriting it completely
+      if (full && pagepool::instance().allocate(page)) {
+        mSpill.lost--;
+        std::lock_guard<std::mutex> pLock(page->mtx);
+
+        if (page->data) {
+          memcpy(page->data, src + done, len);
+          page->dirty = true;
+        }
+      }
+
+      break;
+    }
+
+    done += len;
+  }
+
+  if ((off_t)(offset + dataSize) > mSize) {
+    mSize = offset + dataSize;
+  }
+
+  return dataSize;
+}
+
+/* -------------------------------------------------------------------------- */
+bool
+/* -------------------------------------------------------------------------- */
+pagedbuffer::readPage(const std::shared_ptr<bufferpage>& page, char* dst,
+                      size_t poff, size_t len)
+/* -------------------------------------------------------------------------- */
+{
+  {
+    std::lock_guard<std::mutex> pLock(page->mtx);
+
+    if (page->data) {
+      memcpy(dst, page->data + poff, len);
+      page->referenced = true;
+      return true;
+    }
+
+    if (!page->ondisk) {
+      return false;
+    }
+  }
+  // evicted to disk, bring it back for the next reads
+  pagepool::instance().reload(page);
+  std::lock_guard<std::mutex> pLock(page->mtx);
+
+  if (page->data) {
+    memcpy(dst, page->data + poff, len);
+    page->referenced = true;
+    return true;
+  }
+
+  // evicted again or no memory, read the copy on disk
+  return (page->ondisk &&
+          mSpill.read(dst, len, page->index * pagepool::sPageSize + poff));
+}
+
+/* -------------------------------------------------------------------------- */
+size_t
+/* -------------------------------------------------------------------------- */
+pagedbuffer::readData(void* ptr, off_t offset, size_t dataSize)
+/* -------------------------------------------------------------------------- */
+{
+  eos::common::RWMutexReadLock dLock(mMutex);
+  const size_t psize = pagepool::sPageSize;
+  char* dst = (char*) ptr;
+
+  if (offset >= mSize) {
+    return 0;
+  }
+
+  dataSize = std::min(dataSize, (size_t)(mSize - offset));
+  size_t done = 0;
+
+  while (done < dataSize) {
+    uint64_t pos = offset + done;
+    uint64_t index = pos / psize;
+    size_t poff = pos % psize;
+    size_t len = std::min(psize - poff, dataSize - done);
+    auto it = mPages.find(index);
+
+    if (it == mPages.end()) {
+      // hole
+      memset(dst + done, 0, len);
+      done += len;
+      continue;
+    }
+
+    if (!readPage(it->second, dst + done, poff, len)) {
+      // dropped, the caller has to get the rest elsewhere
+      break;
+    }
+
+    done += len;
+  }
+
+  return done;
+}
+
+/* -------------------------------------------------------------------------- */
+void
+/* -------------------------------------------------------------------------- */
+pagedbuffer::truncateData(off_t offset)
+/* -------------------------------------------------------------------------- */
+{
+  eos::common::RWMutexWriteLock dLock(mMutex);
+  const size_t psize = pagepool::sPageSize;
+  uint64_t index = offset / psize;
+  size_t poff = offset % psize;
+
+  if (offset < mSize) {
+    dropPages(poff ? index + 1 : index);
+    // a later extension reads zeros from the disk copies as well
+    mSpill.truncate(offset);
+
+    if (poff) {
+      // clear the tail of the last page for a later extension
+      auto it = mPages.find(index);
+
+      if (it != mPages.end()) {
+        std::lock_guard<std::mutex> pLock(it->second->mtx);
+
+        if (it->second->data) {
+          memset(it->second->data + poff, 0, psize - poff);
+          it->second->dirty = true;
+        }
+      }
+    }
+  }
+
+  mSize = offset;
+}
+
+/* -------------------------------------------------------------------------- */
+off_t
+/* -------------------------------------------------------------------------- */
+pagedbuffer::getSize()
+/* -------------------------------------------------------------------------- */
+{
+  eos::common::RWMutexReadLock dLock(mMutex);
+
+  if (!mSpill.lost) {
+    return mSize;
+  }
+
+  for (auto it = mPages.begin(); it != mPages.end(); ++it) {
+    std::lock_guard<std::mutex> pLock(it->second->mtx);
+
+    if (!it->second->data && !it->second->ondisk) {
+      return std::min(mSize, (off_t)(it->first * pagepool::sPageSize));
+    }
+  }
+
+  return mSize;
+}
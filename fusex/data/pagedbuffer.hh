@@ -0,0 +1,277 @@
+//------------------------------------------------------------------------------
+//! @file pagedbuffer.hh
+//! @brief sparse page based file buffer with a process wide memory budget
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef FUSE_PAGEDBUFFER_HH_
+#define FUSE_PAGEDBUFFER_HH_
+
+#include "common/RWMutex.hh"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+//------------------------------------------------------------------------------
+//! Disk file holding the evicted pages of a paged buffer at their offset in
+//! the buffer. It is created unlinked in the spill directory of the pool on
+//! the first eviction and goes away with the buffer.
+//------------------------------------------------------------------------------
+struct pagespill {
+  std::mutex mtx; ///< protects the creation of the file
+  int fd; ///< spill file, -1 if not created yet
+  std::atomic<size_t> lost; ///< number of evicted pages not kept on disk
+
+  pagespill() : fd(-1), lost(0) {}
+  ~pagespill();
+
+  //----------------------------------------------------------------------------
+  //! Write a page to the spill file, creating it in the given directory
+  //!
+  //! @return true if the page is on disk
+  //----------------------------------------------------------------------------
+  bool write(const std::string& dir, const char* buf, size_t len, off_t offset);
+
+  //----------------------------------------------------------------------------
+  //! Read a page from the spill file, the part not on disk reads as zeros
+  //----------------------------------------------------------------------------
+  bool read(char* buf, size_t len, off_t offset);
+
+  //----------------------------------------------------------------------------
+  //! Cut the spill file at the given offset
+  //----------------------------------------------------------------------------
+  void truncate(off_t offset);
+};
+
+//------------------------------------------------------------------------------
+//! Page of a paged buffer. The data pointer is cleared when the page is
+//! evicted by the pool, the page object itself stays in its buffer and
+//! knows whether its content is in the spill file of the buffer or lost.
+//------------------------------------------------------------------------------
+struct bufferpage {
+  std::mutex mtx; ///< protects the data and the flags against an eviction
+  char* data; ///< page memory, nullptr if evicted
+  uint64_t index; ///< position of the page in its buffer
+  bool dirty; ///< modified since it was last written to the spill file
+  bool ondisk; ///< a copy of the content is in the spill file
+  std::atomic<bool> referenced; ///< set on access, cleared by the eviction scan
+  pagespill* spill; ///< spill file of the owning buffer
+  std::list<std::shared_ptr<bufferpage>>::iterator lru; ///< position in pool
+};
+
+//------------------------------------------------------------------------------
+//! Pool of fixed size pages shared by all the paged buffers. The memory of
+//! all the pages handed out is kept below a budget - when a new page would
+//! exceed it, the least recently used pages are evicted using a second
+//! chance scan. Evicted pages are written to the spill file of their buffer
+//! in the spill directory, without a spill directory they are dropped.
+//! Released pages are recycled through a small free list.
+//------------------------------------------------------------------------------
+class pagepool
+{
+public:
+  //! Size of a page
+  static const size_t sPageSize = 64 * 1024;
+
+  //----------------------------------------------------------------------------
+  //! Get the pool instance
+  //----------------------------------------------------------------------------
+  static pagepool& instance();
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  pagepool();
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  ~pagepool();
+
+  //----------------------------------------------------------------------------
+  //! Set the memory budget in bytes, 0 means unlimited
+  //----------------------------------------------------------------------------
+  void set_budget(uint64_t bytes);
+
+  uint64_t budget() const
+  {
+    return mBudget;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Set the directory of the spill files, empty to drop evicted pages
+  //----------------------------------------------------------------------------
+  void set_spill_path(const std::string& path);
+
+  //----------------------------------------------------------------------------
+  //! Give memory to a page, evicting other pages if the budget is exceeded
+  //!
+  //! @param page page without memory
+  //!
+  //! @return true if the page got memory, false if the budget is exhausted
+  //----------------------------------------------------------------------------
+  bool allocate(const std::shared_ptr<bufferpage>& page);
+
+  //----------------------------------------------------------------------------
+  //! Bring an evicted page back from its spill file
+  //!
+  //! @return true if the page has memory
+  //----------------------------------------------------------------------------
+  bool reload(const std::shared_ptr<bufferpage>& page);
+
+  //----------------------------------------------------------------------------
+  //! Give back the memory of a page removed from its buffer
+  //----------------------------------------------------------------------------
+  void release(const std::shared_ptr<bufferpage>& page);
+
+  //----------------------------------------------------------------------------
+  //! Statistics
+  //----------------------------------------------------------------------------
+  uint64_t inuse() const
+  {
+    return mInuse * sPageSize;
+  }
+
+  uint64_t evictions() const
+  {
+    return mEvictions;
+  }
+
+  uint64_t spills() const
+  {
+    return mSpills;
+  }
+
+private:
+  std::mutex mtx; ///< protects the lru list, the free list and spill path
+  std::list<std::shared_ptr<bufferpage>> mLru; ///< pages with memory
+  std::vector<char*> mFree; ///< recycled page memory
+  std::string mSpillPath; ///< directory of the spill files
+  std::atomic<uint64_t> mBudget; ///< budget in bytes, 0 if unlimited
+  std::atomic<uint64_t> mInuse; ///< number of pages with memory
+  std::atomic<uint64_t> mEvictions; ///< number of pages evicted
+  std::atomic<uint64_t> mSpills; ///< number of pages written to disk
+
+  //----------------------------------------------------------------------------
+  //! Get memory for a page within the budget - called with the pool mutex
+  //! held
+  //!
+  //! @return page memory or nullptr if there is no page left to evict
+  //----------------------------------------------------------------------------
+  char* get_memory();
+
+  //----------------------------------------------------------------------------
+  //! Give back the memory of a page - called with the pool mutex held
+  //----------------------------------------------------------------------------
+  void put_memory(char* data);
+
+  //----------------------------------------------------------------------------
+  //! Evict the least recently used page - called with the pool mutex held
+  //!
+  //! @return page memory or nullptr if there is no page left to evict
+  //----------------------------------------------------------------------------
+  char* evict_one();
+};
+
+//------------------------------------------------------------------------------
+//! Sparse file buffer made of pages from the shared pool. Only the pages
+//! written are allocated - holes read back as zeros. Pages evicted to the
+//! spill file are read back from it on access. Pages dropped by the pool
+//! are remembered and reads stop in front of them, so that the caller
+//! fetches the rest from the journal or the remote file. Reads and writes
+//! copy straight between the caller's buffer and the pages.
+//------------------------------------------------------------------------------
+class pagedbuffer
+{
+public:
+  pagedbuffer();
+  virtual ~pagedbuffer();
+
+  //----------------------------------------------------------------------------
+  //! Write data at an offset
+  //!
+  //! @return number of bytes written
+  //----------------------------------------------------------------------------
+  size_t writeData(const void* ptr, off_t offset, size_t dataSize);
+
+  //----------------------------------------------------------------------------
+  //! Read data at an offset
+  //!
+  //! @return number of bytes read, short before a dropped page or at the end
+  //----------------------------------------------------------------------------
+  size_t readData(void* ptr, off_t offset, size_t dataSize);
+
+  //----------------------------------------------------------------------------
+  //! Truncate the buffer
+  //----------------------------------------------------------------------------
+  void truncateData(off_t offset);
+
+  //----------------------------------------------------------------------------
+  //! Get the size of the buffer - if pages were dropped, only the part in
+  //! front of the first dropped page is accounted
+  //----------------------------------------------------------------------------
+  off_t getSize();
+
+  //----------------------------------------------------------------------------
+  //! Get the logical size of the buffer
+  //----------------------------------------------------------------------------
+  off_t getLogicalSize()
+  {
+    eos::common::RWMutexReadLock dLock(mMutex);
+    return mSize;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if pages were dropped, their content has to be read elsewhere
+  //----------------------------------------------------------------------------
+  bool hasDropped()
+  {
+    return mSpill.lost != 0;
+  }
+
+private:
+  eos::common::RWMutex mMutex;
+  std::map<uint64_t, std::shared_ptr<bufferpage>> mPages; ///< pages by index
+  off_t mSize; ///< logical size
+  pagespill mSpill; ///< spill file of the evicted pages
+
+  //----------------------------------------------------------------------------
+  //! Drop all pages from the given index on
+  //----------------------------------------------------------------------------
+  void dropPages(uint64_t index);
+
+  //----------------------------------------------------------------------------
+  //! Copy from a page, reloading it if it was evicted to disk
+  //!
+  //! @return false if the page content was dropped
+  //----------------------------------------------------------------------------
+  bool readPage(const std::shared_ptr<bufferpage>& page, char* dst,
+                size_t poff, size_t len);
+
+  pagedbuffer(const pagedbuffer&) = delete;
+  pagedbuffer& operator=(const pagedbuffer&) = delete;
+};
+
+#endif /* FUSE_PAGEDBUFFER_HH_ */
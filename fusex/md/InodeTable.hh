@@ -0,0 +1,152 @@
+//------------------------------------------------------------------------------
+//! @file InodeTable.hh
+//! @brief Sharded hash table of the metadata objects by inode
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef FUSE_INODE_TABLE_HH_
+#define FUSE_INODE_TABLE_HH_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//! Table of shared objects by inode split into independently locked shards.
+//! An inode is assigned to a shard by a multiplicative hash so that the
+//! sequential inodes of the local generator spread over all the shards.
+//! Threads working on different inodes rarely compete for the same lock and
+//! each access is a hash lookup instead of a tree walk.
+//!
+//! All the methods are thread-safe. No shard lock is ever held while calling
+//! out of the table, so the objects can be locked before or after accessing
+//! the table without ordering constraints.
+//------------------------------------------------------------------------------
+template <typename Ino, typename T>
+class InodeTable
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param bits log2 of the number of shards
+  //----------------------------------------------------------------------------
+  InodeTable(unsigned int bits = 8) :
+    mBits(bits ? bits : 1), mShards((size_t) 1 << mBits)
+  {
+  }
+
+  virtual ~InodeTable()
+  {
+  }
+
+  // TS stands for "thread-safe"
+  bool retrieveTS(Ino ino, T& ret)
+  {
+    Shard& shard = getShard(ino);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto it = shard.mMap.find(ino);
+
+    if (it == shard.mMap.end()) {
+      return false;
+    }
+
+    ret = it->second;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Retrieve an object or insert a new one made by the factory
+  //!
+  //! @return true if the object was created
+  //----------------------------------------------------------------------------
+  template <typename Factory>
+  bool retrieveOrCreateTS(Ino ino, T& ret, Factory factory)
+  {
+    Shard& shard = getShard(ino);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto it = shard.mMap.find(ino);
+
+    if (it != shard.mMap.end()) {
+      ret = it->second;
+      return false;
+    }
+
+    ret = factory();
+
+    if (ino) {
+      shard.mMap[ino] = ret;
+    }
+
+    return true;
+  }
+
+  void insertTS(Ino ino, const T& obj)
+  {
+    Shard& shard = getShard(ino);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.mMap[ino] = obj;
+  }
+
+  void eraseTS(Ino ino)
+  {
+    Shard& shard = getShard(ino);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.mMap.erase(ino);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the number of entries - not a snapshot, the shards are counted one
+  //! after the other
+  //----------------------------------------------------------------------------
+  size_t sizeTS()
+  {
+    size_t n = 0;
+
+    for (auto& shard : mShards) {
+      std::lock_guard<std::mutex> lock(shard.mMutex);
+      n += shard.mMap.size();
+    }
+
+    return n;
+  }
+
+protected:
+  //----------------------------------------------------------------------------
+  //! Shard of the table
+  //----------------------------------------------------------------------------
+  struct Shard {
+    std::mutex mMutex;
+    std::unordered_map<Ino, T> mMap;
+  };
+
+  Shard& getShard(Ino ino)
+  {
+    return mShards[((uint64_t) ino * 0x9e3779b97f4a7c15ull) >> (64 - mBits)];
+  }
+
+private:
+  unsigned int mBits; ///< log2 of the number of shards
+  std::vector<Shard> mShards; ///< shards
+};
+
+#endif /* FUSE_INODE_TABLE_HH_ */
@@ -78,8 +78,9 @@ metad::init(backend* _mdbackend)
   std::string mdstream;
   // load the root node
   fuse_req_t req = 0;
-  XrdSysMutexHelper mLock(mdmap);
-  update(req, mdmap[1], "", true);
+  shared_md root_md;
+  mdmap.retrieveOrCreateTS(1, root_md);
+  update(req, root_md, "", true);
   next_ino.init(EosFuse::Instance().getKV());
 }
 
@@ -1623,8 +1624,7 @@ metad::apply(fuse_req_t req, eos::fusex::container& cont, bool listing)
     md->Locker().UnLock();
 
     if (is_new) {
-      XrdSysMutexHelper mLock(mdmap);
-      mdmap[ino] = md;
+      mdmap.insertTS(ino, md);
       stat.inodes_inc();
       stat.inodes_ever_inc();
     }
@@ -2288,13 +2288,8 @@ metad::mdcommunicate(ThreadAssistant& assistant)
                 fuse_ino_t ino = EosFuse::Instance().getCap().forget(capid);
                 {
                   shared_md md;
-                  {
-                    XrdSysMutexHelper mmLock(mdmap);
-
-                    if (mdmap.count(ino)) {
-                      md = mdmap[ino];
-                      md->Locker().Lock();
-                    }
+                  if (mdmap.retrieveTS(ino, md)) {
+                    md->Locker().Lock();
                   }
 
                   // invalidate children
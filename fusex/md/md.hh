@@ -31,6 +31,7 @@
 #include "llfusexx.hh"
 #include "fusex/fusex.pb.h"
 #include "md/InodeGenerator.hh"
+#include "md/InodeTable.hh"
 #include "backend/backend.hh"
 #include "common/Logging.hh"
 #include "common/RWMutex.hh"
@@ -300,7 +301,7 @@ public:
     XrdSysMutex mMutex;
   } ;
 
-  class pmap : public std::map<fuse_ino_t, shared_md> , public XrdSysMutex
+  class pmap : public InodeTable<fuse_ino_t, shared_md>
   //----------------------------------------------------------------------------
   {
   public:
@@ -313,82 +314,52 @@ public:
     {
     }
 
-    bool retrieveOrCreateTS(fuse_ino_t ino, shared_md& ret)
-    {
-      XrdSysMutexHelper mLock(this);
-
-      if (this->retrieve(ino, ret)) {
-        return false;
-      }
-
-      ret = std::make_shared<mdx>();
-
-      if (ino) {
-        (*this)[ino] = ret;
-      }
-      return true;
-    }
-
     // TS stands for "thread-safe"
-    bool retrieveTS(fuse_ino_t ino, shared_md& ret)
-    {
-      XrdSysMutexHelper mLock(this);
-      return this->retrieve(ino, ret);
-    }
-
-    bool retrieve(fuse_ino_t ino, shared_md& ret)
-    {
-      auto it = this->find(ino);
-
-      if (it == this->end()) {
-        return false;
-      }
-
-      ret = it->second;
-      return true;
-    }
-
-    // TS stands for "thread-safe"
-    void insertTS(fuse_ino_t ino, shared_md& md)
-    {
-      XrdSysMutexHelper mLock(this);
-      (*this)[ino] = md;
-    }
-
-    // TS stands for "thread-safe"
-    void eraseTS(fuse_ino_t ino)
+    bool retrieveOrCreateTS(fuse_ino_t ino, shared_md& ret)
     {
-      XrdSysMutexHelper mLock(this);
-      this->erase(ino);
+      return InodeTable<fuse_ino_t, shared_md>::retrieveOrCreateTS(ino, ret, []() {
+        return std::make_shared<mdx>();
+      });
     }
 
     void retrieveWithParentTS(fuse_ino_t ino, shared_md &md, shared_md &pmd) {
       // Atomically retrieve md objects for an inode, and its parent.
 
       while(true) {
-        // In this particular case, we need to first lock mdmap, and then
-        // md.. The following algorithm is meant to avoid deadlocks with code
-        // which locks md first, and then mdmap.
+        // In this particular case, we need to first lock the shard of ino,
+        // and then md.. The following algorithm is meant to avoid deadlocks
+        // with code which locks md first, and then mdmap.
 
         md.reset();
         pmd.reset();
-
-        XrdSysMutexHelper mLock(this);
-        if(!retrieve(ino, md)) {
-          return; // ino not there, nothing to do
-        }
-
-        // md has been found. Can we lock it?
-        if(md->Locker().CondLock()) {
-          // Success!
-          retrieve(md->pid(), pmd);
+        fuse_ino_t pid = 0;
+        {
+          Shard& shard = getShard(ino);
+          std::unique_lock<std::mutex> mLock(shard.mMutex);
+          auto it = shard.mMap.find(ino);
+
+          if (it == shard.mMap.end()) {
+            return; // ino not there, nothing to do
+          }
+
+          md = it->second;
+
+          // md has been found. Can we lock it?
+          if(!md->Locker().CondLock()) {
+            // Nope, unlock the shard and try again.
+            mLock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+          }
+
+          pid = md->pid();
           md->Locker().UnLock();
-          return;
         }
 
-        // Nope, unlock mdmap and try again.
-        mLock.UnLock();
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        // the parent is looked up without holding the shard of ino, the
+        // shards are never locked two at a time
+        retrieveTS(pid, pmd);
+        return;
       }
     }
   } ;
@@ -0,0 +1,299 @@
+//------------------------------------------------------------------------------
+//! @file paged-buffer.cc
+//! @brief tests of the paged memory cache buffer and its eviction
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "fusex/data/pagedbuffer.hh"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+const size_t sPage = pagepool::sPageSize;
+
+//------------------------------------------------------------------------------
+//! Pool configuration for one test, restored to unlimited without spill
+//! directory at the end
+//------------------------------------------------------------------------------
+class PoolSetup
+{
+public:
+  PoolSetup(size_t pages, bool spill)
+  {
+    char tmpl[] = "/tmp/eos-pagedbuffer.XXXXXX";
+
+    if (spill && mkdtemp(tmpl)) {
+      mDir = tmpl;
+    }
+
+    pagepool::instance().set_spill_path(mDir);
+    pagepool::instance().set_budget(pages * sPage);
+  }
+
+  ~PoolSetup()
+  {
+    pagepool::instance().set_budget(0);
+    pagepool::instance().set_spill_path("");
+
+    if (mDir.length()) {
+      (void) rmdir(mDir.c_str());
+    }
+  }
+
+private:
+  std::string mDir;
+};
+
+//------------------------------------------------------------------------------
+// Page filled with a pattern depending on its index and a version
+//------------------------------------------------------------------------------
+std::string
+MakePage(uint64_t index, unsigned int version)
+{
+  std::string page(sPage, '\0');
+
+  for (size_t i = 0; i < sPage; ++i) {
+    page[i] = (char)((index * 131 + version * 7 + i / 512) & 0xff);
+  }
+
+  return page;
+}
+
+//------------------------------------------------------------------------------
+// Read the whole buffer
+//------------------------------------------------------------------------------
+std::string
+ReadAll(pagedbuffer& buffer, size_t length)
+{
+  std::string out(length, '\0');
+  out.resize(buffer.readData(&out[0], 0, length));
+  return out;
+}
+}
+
+//------------------------------------------------------------------------------
+// Pages over the budget are evicted to the spill file and read back from it
+//------------------------------------------------------------------------------
+TEST(PagedBuffer, EvictToDisk)
+{
+  PoolSetup setup(4, true);
+  uint64_t evictions = pagepool::instance().evictions();
+  uint64_t spills = pagepool::instance().spills();
+  pagedbuffer buffer;
+  std::string expected;
+
+  for (uint64_t i = 0; i < 16; ++i) {
+    expected += MakePage(i, 0);
+    ASSERT_EQ(sPage, buffer.writeData(expected.data() + i * sPage, i * sPage,
+                                      sPage));
+    ASSERT_LE(pagepool::instance().inuse(), 4 * sPage);
+  }
+
+  ASSERT_EQ(12u, pagepool::instance().evictions() - evictions);
+  ASSERT_EQ(12u, pagepool::instance().spills() - spills);
+  ASSERT_FALSE(buffer.hasDropped());
+  ASSERT_EQ((off_t) expected.size(), buffer.getSize());
+  ASSERT_TRUE(expected == ReadAll(buffer, expected.size()));
+  ASSERT_LE(pagepool::instance().inuse(), 4 * sPage);
+}
+
+//------------------------------------------------------------------------------
+// Evicted pages come back to memory when read or partially written
+//------------------------------------------------------------------------------
+TEST(PagedBuffer, Refill)
+{
+  PoolSetup setup(2, true);
+  pagedbuffer buffer;
+  std::string expected = MakePage(0, 1) + MakePage(1, 1) + MakePage(2, 1);
+  ASSERT_EQ(expected.size(), buffer.writeData(expected.data(), 0,
+            expected.size()));
+  // page 0 is on disk, reading it reloads it and evicts another page
+  uint64_t evictions = pagepool::instance().evictions();
+  std::string out(100, '\0');
+  ASSERT_EQ(100u, buffer.readData(&out[0], 10, 100));
+  ASSERT_EQ(expected.substr(10, 100), out);
+  ASSERT_EQ(1u, pagepool::instance().evictions() - evictions);
+  // page 1 comes back and evicts page 2, then page 2 comes back and evicts
+  // page 0 which is clean and not written to disk again
+  ASSERT_EQ(100u, buffer.readData(&out[0], sPage + 10, 100));
+  ASSERT_EQ(expected.substr(sPage + 10, 100), out);
+  uint64_t spills = pagepool::instance().spills();
+  ASSERT_EQ(100u, buffer.readData(&out[0], 2 * sPage + 10, 100));
+  ASSERT_EQ(expected.substr(2 * sPage + 10, 100), out);
+  ASSERT_EQ(0u, pagepool::instance().spills() - spills);
+  // unaligned write across two evicted pages
+  std::string patch(1000, 'P');
+  ASSERT_EQ(patch.size(), buffer.writeData(patch.data(), 2 * sPage - 500,
+            patch.size()));
+  expected.replace(2 * sPage - 500, patch.size(), patch);
+  ASSERT_TRUE(expected == ReadAll(buffer, expected.size()));
+  // extend with a hole and read it back as zeros
+  ASSERT_EQ(10u, buffer.writeData("0123456789", 5 * sPage, 10));
+  expected += std::string(2 * sPage, '\0') + "0123456789";
+  ASSERT_TRUE(expected == ReadAll(buffer, expected.size() + 100));
+  ASSERT_FALSE(buffer.hasDropped());
+}
+
+//------------------------------------------------------------------------------
+// Truncation cuts the pages in memory and on disk, an extension reads zeros
+//------------------------------------------------------------------------------
+TEST(PagedBuffer, TruncateEvicted)
+{
+  PoolSetup setup(1, true);
+  pagedbuffer buffer;
+  std::string expected = MakePage(0, 2) + MakePage(1, 2) + MakePage(2, 2);
+  buffer.writeData(expected.data(), 0, expected.size());
+  // pages 0 and 1 are on disk
+  buffer.truncateData(sPage + 100);
+  ASSERT_EQ((off_t)(sPage + 100), buffer.getSize());
+  buffer.writeData("x", 3 * sPage, 1);
+  expected.resize(sPage + 100);
+  expected += std::string(3 * sPage - expected.size(), '\0') + "x";
+  ASSERT_TRUE(expected == ReadAll(buffer, 4 * sPage));
+  buffer.truncateData(0);
+  ASSERT_EQ(0, buffer.getSize());
+  ASSERT_EQ(0u, ReadAll(buffer, sPage).size());
+}
+
+//------------------------------------------------------------------------------
+// Without a spill directory evicted pages are dropped, reads stop in front of
+// them and the size is cut at the first dropped page
+//------------------------------------------------------------------------------
+TEST(PagedBuffer, DropWithoutSpill)
+{
+  PoolSetup setup(2, false);
+  pagedbuffer buffer;
+  std::string expected;
+
+  for (uint64_t i = 0; i < 4; ++i) {
+    expected += MakePage(i, 3);
+  }
+
+  buffer.writeData(expected.data(), 0, expected.size());
+  ASSERT_TRUE(buffer.hasDropped());
+  ASSERT_EQ((off_t) expected.size(), buffer.getLogicalSize());
+  // the least recently used page 0 went first
+  ASSERT_EQ(0, buffer.getSize());
+  ASSERT_EQ(0u, ReadAll(buffer, expected.size()).size());
+  std::string out(sPage, '\0');
+  ASSERT_EQ(sPage, buffer.readData(&out[0], 3 * sPage, sPage));
+  ASSERT_TRUE(expected.substr(3 * sPage) == out);
+  // a complete overwrite revives a dropped page, the size moves to the next
+  // dropped page and the reads stop there
+  buffer.writeData(expected.data(), 0, sPage);
+  off_t size = buffer.getSize();
+  ASSERT_GE(size, (off_t) sPage);
+  std::string all = ReadAll(buffer, expected.size());
+  ASSERT_EQ((size_t) size, all.size());
+  ASSERT_TRUE(expected.substr(0, size) == all);
+  // truncating the dropped pages away clears the state
+  buffer.truncateData(0);
+  ASSERT_FALSE(buffer.hasDropped());
+  buffer.writeData(expected.data(), 0, sPage);
+  ASSERT_EQ((off_t) sPage, buffer.getSize());
+  ASSERT_TRUE(expected.substr(0, sPage) == ReadAll(buffer, sPage));
+}
+
+//------------------------------------------------------------------------------
+// Concurrent writers and readers under eviction pressure always see whole
+// pages of one version and the final content is the last one written
+//------------------------------------------------------------------------------
+TEST(PagedBuffer, ConcurrentReadWrite)
+{
+  PoolSetup setup(8, true);
+  const size_t nwriters = 4;
+  const size_t npages = 8; // per writer
+  const unsigned int nversions = 30;
+  pagedbuffer buffer;
+  std::atomic<size_t> running(nwriters);
+  std::atomic<size_t> bad(0);
+  std::vector<std::thread> threads;
+
+  for (size_t w = 0; w < nwriters; ++w) {
+    threads.emplace_back([&, w]() {
+      for (unsigned int v = 0; v < nversions; ++v) {
+        for (size_t p = 0; p < npages; ++p) {
+          uint64_t index = w * npages + p;
+          std::string page = MakePage(index, v);
+          buffer.writeData(page.data(), index * sPage, sPage);
+        }
+      }
+
+      running--;
+    });
+  }
+
+  for (size_t r = 0; r < 4; ++r) {
+    threads.emplace_back([&, r]() {
+      std::mt19937 gen(r);
+      std::string out(sPage, '\0');
+      const std::string zero(sPage, '\0');
+
+      while (running) {
+        uint64_t index = gen() % (nwriters * npages);
+        size_t nread = buffer.readData(&out[0], index * sPage, sPage);
+
+        if ((nread == 0) || ((nread == sPage) && (out == zero))) {
+          // not written yet
+          continue;
+        }
+
+        bool match = (nread == sPage);
+
+        if (match) {
+          match = false;
+
+          for (unsigned int v = 0; v < nversions; ++v) {
+            if (out == MakePage(index, v)) {
+              match = true;
+              break;
+            }
+          }
+        }
+
+        if (!match) {
+          bad++;
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(0u, bad.load());
+  ASSERT_FALSE(buffer.hasDropped());
+  std::string expected;
+
+  for (uint64_t index = 0; index < nwriters * npages; ++index) {
+    expected += MakePage(index, nversions - 1);
+  }
+
+  ASSERT_TRUE(expected == ReadAll(buffer, expected.size()));
+  ASSERT_LE(pagepool::instance().inuse(), 8 * sPage);
+}
@@ -73,6 +73,9 @@ bool Access::gStallWrite = false;
 //! indicates a user or group rate stall entry
 bool Access::gStallUserGroup = false;
 
+//! compiled user and group rate stall rules
+StallRates Access::gStallRates;
+
 //! singleton map for UID based redirection (not used yet)
 std::map<uid_t, std::string> Access::gUserRedirection;
 
@@ -139,6 +142,7 @@ Access::Reset()
   Access::gGroupRedirection.clear();
   Access::gStallGlobal = Access::gStallRead = \
                          Access::gStallWrite = Access::gStallUserGroup = false;
+  Access::gStallRates.Clear();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -308,6 +312,8 @@ Access::ApplyAccessConfig(bool applyredirectandstall)
         }
       }
     }
+
+    Access::gStallRates.Compile(Access::gStallRules, Access::gStallComment);
   }
 }
 
@@ -424,6 +430,8 @@ Access::StoreAccessConfig()
     }
   }
 
+  gStallRates.Compile(gStallRules, gStallComment);
+
   for (itredirect = Access::gRedirectionRules.begin();
        itredirect != Access::gRedirectionRules.end(); itredirect++) {
     redirect += itredirect->first.c_str();
@@ -29,6 +29,7 @@
 #define __EOSCOMMON_ACCESS__
 
 #include "mgm/Namespace.hh"
+#include "mgm/StallRates.hh"
 #include "common/RWMutex.hh"
 #include "common/Mapping.hh"
 #include <map>
@@ -145,6 +146,9 @@ public:
   //! indicates a user or group rate stall entry
   static bool gStallUserGroup;
 
+  //! token buckets compiled from the user and group rate stall rules
+  static StallRates gStallRates;
+
   //! map containing user based redirection
   static std::map<uid_t, std::string> gUserRedirection;
 
@@ -22,6 +22,7 @@
  ************************************************************************/
 
 #include <cfloat>
+#include <algorithm>
 #include "mgm/TableFormatter/TableFormatterBase.hh"
 #include "mgm/FsView.hh"
 #include "mgm/GeoBalancer.hh"
@@ -1083,19 +1084,86 @@ FsSpace::~FsSpace()
 }
 
 //------------------------------------------------------------------------------
-// Check if quota is enabled for space
-//-----------------------------------------------------------------------------
-bool FsView::IsQuotaEnabled(const std::string& space)
+// Record the quota setting of a space and publish it
+//------------------------------------------------------------------------------
+void
+FsView::SetQuotaEnabled(const std::string& space, bool enabled)
+{
+  {
+    std::lock_guard<std::mutex> lock(mSnapshotMutex);
+
+    if (enabled) {
+      mQuotaSpaces.insert(space);
+    } else {
+      mQuotaSpaces.erase(space);
+    }
+  }
+  PublishSnapshot();
+}
+
+//------------------------------------------------------------------------------
+// Rebuild and publish the placement snapshot
+//------------------------------------------------------------------------------
+void
+FsView::PublishSnapshot()
+{
+  std::lock_guard<std::mutex> lock(mSnapshotMutex);
+  std::shared_ptr<FsViewSnapshot> snapshot = std::make_shared<FsViewSnapshot>();
+  snapshot->mVersion = std::atomic_load(&mSnapshot)->mVersion + 1;
+
+  for (auto it = mSpaceGroupView.begin(); it != mSpaceGroupView.end(); ++it) {
+    if (!it->second.empty()) {
+      snapshot->mSpaceGroups[it->first].assign(it->second.begin(),
+          it->second.end());
+    }
+  }
+
+  snapshot->mQuotaSpaces = mQuotaSpaces;
+  std::shared_ptr<const FsViewSnapshot> published = snapshot;
+  std::atomic_store(&mSnapshot, published);
+  mSnapshotHistory.push_back(published);
+  ReclaimGroups();
+}
+
+//------------------------------------------------------------------------------
+// Retire a group object removed from the view
+//------------------------------------------------------------------------------
+void
+FsView::RetireGroup(FsGroup* group)
 {
-  bool is_enabled = false;
-  std::string key = "quota";
+  std::lock_guard<std::mutex> lock(mSnapshotMutex);
+  // The next published snapshot is the first one not containing the group
+  mRetiredGroups.emplace_back(std::atomic_load(&mSnapshot)->mVersion + 1, group);
+}
+
+//------------------------------------------------------------------------------
+// Delete retired groups which are no longer referenced by any snapshot
+//------------------------------------------------------------------------------
+void
+FsView::ReclaimGroups()
+{
+  uint64_t min_version = std::atomic_load(&mSnapshot)->mVersion;
 
-  if (mSpaceView.count(space)) {
-    std::string is_on = mSpaceView[space]->GetConfigMember(key);
-    is_enabled = (is_on == "on");
+  for (auto it = mSnapshotHistory.begin(); it != mSnapshotHistory.end();) {
+    std::shared_ptr<const FsViewSnapshot> snapshot = it->lock();
+
+    if (!snapshot) {
+      it = mSnapshotHistory.erase(it);
+    } else {
+      min_version = std::min(min_version, snapshot->mVersion);
+      ++it;
+    }
   }
 
-  return is_enabled;
+  for (auto it = mRetiredGroups.begin(); it != mRetiredGroups.end();) {
+    if (it->first <= min_version) {
+      eos_debug("reclaiming group %s", it->second->mName.c_str());
+      delete it->second;
+      it = mRetiredGroups.erase(it);
+    } else {
+      ++it;
+    }
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -1672,6 +1740,7 @@ FsView::Register(FileSystem* fs, bool registerInGeoTreeEngine)
 
 #endif
     mSpaceGroupView[snapshot.mSpace].insert(mGroupView[snapshot.mGroup]);
+    PublishSnapshot();
 
     // Align view by spacename
     // Check if we have already a space view
@@ -1802,7 +1871,8 @@ FsView::MoveGroup(FileSystem* fs, std::string group)
           }
 
           mGroupView.erase(snapshot1.mGroup);
-          delete group;
+          RetireGroup(group);
+          PublishSnapshot();
         }
       }
 
@@ -1848,6 +1918,7 @@ FsView::MoveGroup(FileSystem* fs, std::string group)
 
 #endif
       mSpaceGroupView[snapshot.mSpace].insert(mGroupView[snapshot.mGroup]);
+      PublishSnapshot();
 
       // Check if we have already a space view
       if (mSpaceView.count(snapshot.mSpace)) {
@@ -1942,7 +2013,8 @@ FsView::UnRegister(FileSystem* fs, bool unregisterInGeoTreeEngine)
       if (!group->size()) {
         mSpaceGroupView[snapshot.mSpace].erase(mGroupView[snapshot.mGroup]);
         mGroupView.erase(snapshot.mGroup);
-        delete group;
+        RetireGroup(group);
+        PublishSnapshot();
       }
     }
 
@@ -2145,6 +2217,7 @@ FsView::UnRegisterGroup(const char* groupname)
       std::string sgroupname = groupname;
       std::string spacename = "";
       std::string index = "";
+      eos::common::StringConversion::SplitByPoint(groupname, spacename, index);
 
       // remove the direct group reference here
       if (mSpaceGroupView.count(spacename)) {
@@ -2153,9 +2226,9 @@ FsView::UnRegisterGroup(const char* groupname)
 
       // We have to explicitly remove the group from the view here because no
       // fs was removed
-      delete mGroupView[groupname];
+      RetireGroup(mGroupView[groupname]);
       retc = (mGroupView.erase(groupname) ? true : false);
-      eos::common::StringConversion::SplitByPoint(groupname, spacename, index);
+      PublishSnapshot();
     }
   }
 
@@ -2194,6 +2267,12 @@ FsView::Reset()
   // Although this shouldn't be necessary, better run an additional cleanup
   mSpaceView.clear();
   mGroupView.clear();
+  mSpaceGroupView.clear();
+  {
+    std::lock_guard<std::mutex> lock(mSnapshotMutex);
+    mQuotaSpaces.clear();
+  }
+  PublishSnapshot();
   mNodeView.clear();
   {
     eos::common::RWMutexWriteLock gwlock(GwMutex);
@@ -2638,6 +2717,11 @@ BaseView::SetConfigMember(std::string key, std::string value, bool create,
 
   eos::common::GlobalConfig::gConfig.SOM()->HashMutex.UnLockRead();
 
+  // The placement reads the quota setting of a space from the snapshot
+  if (success && (mType == "spaceview") && (key == "quota")) {
+    FsView::gFsView.SetQuotaEnabled(mName, (value == "on"));
+  }
+
   // Register in the configuration engine
   if ((!isstatus) && (FsView::ConfEngine)) {
     nodeconfigname += "#";
@@ -3060,6 +3144,15 @@ FsView::ApplyGlobalConfig(const char* key, std::string& val)
   }
 
   eos::common::GlobalConfig::gConfig.SOM()->HashMutex.UnLockRead();
+  std::string spaceprefix = FsSpace::sGetConfigQueuePrefix();
+
+  // The placement reads the quota setting of a space from the snapshot
+  if (success && (tokens[1] == "quota") &&
+      (tokens[0].compare(0, spaceprefix.length(), spaceprefix) == 0)) {
+    eos::common::RWMutexReadLock viewlock(ViewMutex);
+    SetQuotaEnabled(tokens[0].substr(spaceprefix.length()), (val == "on"));
+  }
+
   return success;
 }
 #endif
@@ -39,6 +39,10 @@
 #endif
 #include <map>
 #include <set>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
 #ifndef EOSMGMFSVIEWTEST
 #include "mgm/IConfigEngine.hh"
 #endif
@@ -704,6 +708,52 @@ public:
   }
 };
 
+//------------------------------------------------------------------------------
+//! Immutable snapshot of the space to scheduling group view used by the
+//! placement hot path. A new snapshot is published by the FsView whenever
+//! the group membership of a space changes; readers only hold a reference to
+//! the snapshot and never need the ViewMutex. Group objects referenced by a
+//! snapshot are kept alive until the last snapshot referencing them is gone.
+//------------------------------------------------------------------------------
+struct FsViewSnapshot {
+  //! Groups of a space ordered like the std::set in FsView::mSpaceGroupView
+  typedef std::vector<FsGroup*> GroupVector;
+
+  uint64_t mVersion; ///< Monotonically increasing snapshot version
+  std::map<std::string, GroupVector> mSpaceGroups; ///< Space name to groups
+  std::set<std::string> mQuotaSpaces; ///< Spaces with quota enabled
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  FsViewSnapshot(): mVersion(0) {}
+
+  //----------------------------------------------------------------------------
+  //! Get the groups of a space
+  //!
+  //! @param space space name
+  //!
+  //! @return pointer to the group vector or nullptr if space has no groups
+  //----------------------------------------------------------------------------
+  const GroupVector* GetGroups(const std::string& space) const
+  {
+    auto it = mSpaceGroups.find(space);
+    return ((it == mSpaceGroups.end()) ? nullptr : &it->second);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if quota is enabled for a space
+  //!
+  //! @param space space name
+  //!
+  //! @return true if the quota is enabled for the space, otherwise false
+  //----------------------------------------------------------------------------
+  bool IsQuotaEnabled(const std::string& space) const
+  {
+    return (mQuotaSpaces.count(space) != 0);
+  }
+};
+
 //------------------------------------------------------------------------------
 //! Class describing an EOS pool including views
 //------------------------------------------------------------------------------
@@ -725,6 +775,35 @@ private:
   std::map<std::string, eos::common::FileSystem::fsid_t> Uuid2FsMap;
   std::string MgmConfigQueueName; ///< MGM configuration queue name
 
+  //! Mutex serializing snapshot publishing and group reclamation
+  std::mutex mSnapshotMutex;
+  //! Current placement snapshot, accessed via std::atomic_load/store
+  std::shared_ptr<const FsViewSnapshot> mSnapshot;
+  //! Snapshots published so far which might still be referenced by readers
+  std::list<std::weak_ptr<const FsViewSnapshot>> mSnapshotHistory;
+  //! Groups removed from the view together with the first snapshot version
+  //! not referencing them any more
+  std::list<std::pair<uint64_t, FsGroup*>> mRetiredGroups;
+  //! Spaces with quota enabled, copied into every published snapshot
+  std::set<std::string> mQuotaSpaces;
+
+  //----------------------------------------------------------------------------
+  //! Remove a group object once no published snapshot refers to it any more.
+  //! Replaces a direct delete of groups which were part of mSpaceGroupView.
+  //!
+  //! @param group group object already removed from all views
+  //!
+  //! @warning needs to be called with a write-lock on the ViewMutex and
+  //!          followed by a call to PublishSnapshot
+  //----------------------------------------------------------------------------
+  void RetireGroup(FsGroup* group);
+
+  //----------------------------------------------------------------------------
+  //! Delete retired groups which are no longer referenced by any snapshot.
+  //! Needs to be called with the mSnapshotMutex locked.
+  //----------------------------------------------------------------------------
+  void ReclaimGroups();
+
 public:
 
 #ifndef EOSMGMFSVIEWTEST
@@ -797,6 +876,25 @@ public:
   //----------------------------------------------------------------------------
   bool UnRegisterGroup(const char* groupname);
 
+  //----------------------------------------------------------------------------
+  //! Rebuild and atomically publish the placement snapshot from
+  //! mSpaceGroupView. Needs to be called after every modification of
+  //! mSpaceGroupView.
+  //!
+  //! @warning needs to be called with a lock on the ViewMutex
+  //----------------------------------------------------------------------------
+  void PublishSnapshot();
+
+  //----------------------------------------------------------------------------
+  //! Get the current placement snapshot - does not need the ViewMutex
+  //!
+  //! @return shared pointer to an immutable snapshot, never null
+  //----------------------------------------------------------------------------
+  std::shared_ptr<const FsViewSnapshot> GetSnapshot() const
+  {
+    return std::atomic_load(&mSnapshot);
+  }
+
   //! Mutex protecting all ...View variables
   eos::common::RWMutexR ViewMutex;
 
@@ -830,9 +928,23 @@ public:
   //! @param space space name
   //!
   //! @return true if quota enabled for space, otherwise false
-  //! @warning needs to be called with a read-lock on the ViewMutex
+  //! @note reads the current snapshot, does not need the ViewMutex
+  //----------------------------------------------------------------------------
+  bool IsQuotaEnabled(const std::string& space) const
+  {
+    return GetSnapshot()->IsQuotaEnabled(space);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Record the quota setting of a space and publish it with a new snapshot.
+  //! Called whenever the "quota" member of a space configuration is set.
+  //!
+  //! @param space space name
+  //! @param enabled true if quota is enabled for the space
+  //!
+  //! @warning needs to be called with a lock on the ViewMutex
   //----------------------------------------------------------------------------
-  bool IsQuotaEnabled(const std::string& space);
+  void SetQuotaEnabled(const std::string& space, bool enabled);
 
   //----------------------------------------------------------------------------
   //! Find filesystem by queue path
@@ -917,7 +1029,8 @@ public:
   //!                        testing purposes
   //----------------------------------------------------------------------------
   FsView(bool start_heartbeat = true):
-    hbthread(), mIsHeartbeatOn(false), NextFsId(0)
+    hbthread(), mIsHeartbeatOn(false), NextFsId(0),
+    mSnapshot(std::make_shared<const FsViewSnapshot>())
   {
     MgmConfigQueueName = "";
 #ifndef EOSMGMFSVIEWTEST
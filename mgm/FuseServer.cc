@@ -27,6 +27,7 @@
 #include "mgm/Quota.hh"
 #include "namespace/interface/IView.hh"
 #include <thread>
+#include <algorithm>
 #include <regex.h>
 #include "common/Logging.hh"
 #include "XrdMgmOfs.hh"
@@ -217,13 +218,11 @@ FuseServer::MonitorCaps()
   eos_static_info("msg=\"starting fusex monitor caps thread\"");
 
   while (1) {
-    do {
-      if (Cap().expire()) {
-        Cap().pop();
-      } else {
-        break;
-      }
-    } while (1);
+    size_t nexpired = Cap().Expire((uint64_t) time(NULL));
+
+    if (nexpired) {
+      eos_static_debug("msg=\"expired caps\" n=%lu", nexpired);
+    }
 
     sleeper.Snooze(1);
 
@@ -264,20 +263,8 @@ FuseServer::Clients::Print(std::string& out, std::string options,
   struct timespec tsnow;
   eos::common::Timing::GetTimeSpec(tsnow);
   std::map<std::string, size_t> clientcaps;
-  {
-    XrdSysMutexHelper lock(gOFS->zMQ->gFuseServer.Cap());
-
-    // count caps per client uuid
-    for (auto it = gOFS->zMQ->gFuseServer.Cap().InodeCaps().begin();
-         it != gOFS->zMQ->gFuseServer.Cap().InodeCaps().end(); ++it) {
-      for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
-        if (gOFS->zMQ->gFuseServer.Cap().GetCaps().count(*sit)) {
-          FuseServer::Caps::shared_cap cap = gOFS->zMQ->gFuseServer.Cap().GetCaps()[*sit];
-          clientcaps[cap->clientuuid()]++;
-        }
-      }
-    }
-  }
+  // count caps per client uuid
+  gOFS->zMQ->gFuseServer.Cap().CountByClientUuid(clientcaps);
 
   for (auto it = this->map().begin(); it != this->map().end(); ++it) {
     char formatline[4096];
@@ -407,7 +394,6 @@ FuseServer::Clients::Evict(std::string& uuid, std::string reason)
 int
 FuseServer::Clients::Dropcaps(const std::string& uuid, std::string& out)
 {
-  XrdSysMutexHelper lock(gOFS->zMQ->gFuseServer.Cap());
   out += " dropping caps of '";
   out += uuid;
   out += "' : ";
@@ -416,74 +402,40 @@ FuseServer::Clients::Dropcaps(const std::string& uuid, std::string& out)
     return ENOENT;
   }
 
-  std::string id = mUUIDView[uuid];
-
-  for (auto it = gOFS->zMQ->gFuseServer.Cap().InodeCaps().begin();
-       it != gOFS->zMQ->gFuseServer.Cap().InodeCaps().end(); ++it) {
-    std::set<FuseServer::Caps::shared_cap> cap2delete;
-
-    for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
-      if (gOFS->zMQ->gFuseServer.Cap().GetCaps().count(*sit)) {
-        FuseServer::Caps::shared_cap cap = gOFS->zMQ->gFuseServer.Cap().GetCaps()[*sit];
-
-        if (cap->clientuuid() == uuid) {
-          cap2delete.insert(cap);
-          out += "\n ";
-          char ahex[20];
-          snprintf(ahex, sizeof(ahex), "%016lx", (unsigned long) cap->id());
-          std::string match = "";
-          match += "# i:";
-          match += ahex;
-          match += " a:";
-          match += cap->authid();
-          out += match;
-        }
-      }
-    }
-
-    for (auto scap = cap2delete.begin(); scap != cap2delete.end(); ++scap) {
-      gOFS->zMQ->gFuseServer.Client().ReleaseCAP((uint64_t)(*scap)->id(),
-          (*scap)->clientuuid(),
-          (*scap)->clientid());
-      eos_static_info("erasing %llx %s %s", (*scap)->id(),
-                      (*scap)->clientid().c_str(), (*scap)->authid().c_str());
-      // erase cap by auth id
-      gOFS->zMQ->gFuseServer.Cap().GetCaps().erase((*scap)->authid());
-      // erase cap by inode
-      gOFS->zMQ->gFuseServer.Cap().InodeCaps()[(*scap)->id()].erase((
-            *scap)->authid());
-
-      if (!gOFS->zMQ->gFuseServer.Cap().InodeCaps()[(*scap)->id()].size()) {
-        gOFS->zMQ->gFuseServer.Cap().InodeCaps().erase((*scap)->id());
-      }
-
-      gOFS->zMQ->gFuseServer.Cap().ClientCaps()[(*scap)->clientid()].erase((
-            *scap)->authid());
-
-      if (!gOFS->zMQ->gFuseServer.Cap().ClientCaps()[(*scap)->clientid()].size()) {
-        gOFS->zMQ->gFuseServer.Cap().ClientCaps().erase((*scap)->clientid());
-      }
+  std::vector<FuseServer::Caps::shared_cap> cap2delete =
+    gOFS->zMQ->gFuseServer.Cap().DropClientUuid(uuid);
+  std::vector<client_message_t> batch;
 
-      gOFS->zMQ->gFuseServer.Cap().ClientCaps()[(*scap)->clientid()].insert((
-            *scap)->authid());
-    }
+  for (auto scap = cap2delete.begin(); scap != cap2delete.end(); ++scap) {
+    out += "\n ";
+    char ahex[20];
+    snprintf(ahex, sizeof(ahex), "%016lx", (unsigned long)(*scap)->id());
+    std::string match = "";
+    match += "# i:";
+    match += ahex;
+    match += " a:";
+    match += (*scap)->authid();
+    out += match;
+    eos_static_info("erasing %llx %s %s", (*scap)->id(),
+                    (*scap)->clientid().c_str(), (*scap)->authid().c_str());
+    batch.emplace_back((*scap)->clientuuid(),
+                       ReleaseCAPMessage((uint64_t)(*scap)->id(), (*scap)->clientid()));
+  }
 
-    if (!cap2delete.size()) {
-      out += " <no caps held>\n";
-    }
+  if (!cap2delete.size()) {
+    out += " <no caps held>\n";
   }
 
+  SendBatch(batch);
   return 0;
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-int
-FuseServer::Clients::ReleaseCAP(uint64_t md_ino,
-                                const std::string& uuid,
-                                const std::string& clientid
-                               )
+std::string
+FuseServer::Clients::ReleaseCAPMessage(uint64_t md_ino,
+                                       const std::string& clientid)
 {
   // prepare release cap message
   eos::fusex::response rsp;
@@ -493,6 +445,19 @@ FuseServer::Clients::ReleaseCAP(uint64_t md_ino,
   rsp.mutable_lease_()->set_clientid(clientid);
   std::string rspstream;
   rsp.SerializeToString(&rspstream);
+  return rspstream;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int
+FuseServer::Clients::ReleaseCAP(uint64_t md_ino,
+                                const std::string& uuid,
+                                const std::string& clientid
+                               )
+{
+  std::string rspstream = ReleaseCAPMessage(md_ino, clientid);
   XrdSysMutexHelper lLock(this);
 
   if (!mUUIDView.count(uuid)) {
@@ -509,14 +474,12 @@ FuseServer::Clients::ReleaseCAP(uint64_t md_ino,
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-int
-FuseServer::Clients::SendMD(const eos::fusex::md& md,
-                            const std::string& uuid,
-                            const std::string& clientid,
-                            uint64_t md_ino,
-                            uint64_t md_pino,
-                            struct timespec& p_mtime
-                           )
+std::string
+FuseServer::Clients::SendMDMessage(const eos::fusex::md& md,
+                                   const std::string& clientid,
+                                   uint64_t md_ino,
+                                   uint64_t md_pino,
+                                   struct timespec& p_mtime)
 {
   // prepare update message
   eos::fusex::response rsp;
@@ -536,6 +499,22 @@ FuseServer::Clients::SendMD(const eos::fusex::md& md,
 
   std::string rspstream;
   rsp.SerializeToString(&rspstream);
+  return rspstream;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int
+FuseServer::Clients::SendMD(const eos::fusex::md& md,
+                            const std::string& uuid,
+                            const std::string& clientid,
+                            uint64_t md_ino,
+                            uint64_t md_pino,
+                            struct timespec& p_mtime
+                           )
+{
+  std::string rspstream = SendMDMessage(md, clientid, md_ino, md_pino, p_mtime);
   XrdSysMutexHelper lLock(this);
 
   if (!mUUIDView.count(uuid)) {
@@ -549,6 +528,59 @@ FuseServer::Clients::SendMD(const eos::fusex::md& md,
   return 0;
 }
 
+//------------------------------------------------------------------------------
+// Send messages to several clients. The batch is grouped by client keeping
+// the order of the messages of each client and the identities are resolved
+// under one lock. The messages are sent once the lock is released, those of
+// a client back to back - each one stays a separate message on the wire.
+//------------------------------------------------------------------------------
+int
+FuseServer::Clients::SendBatch(std::vector<client_message_t>& batch)
+{
+  if (batch.empty()) {
+    return 0;
+  }
+
+  std::stable_sort(batch.begin(), batch.end(),
+  [](const client_message_t & a, const client_message_t & b) {
+    return a.first < b.first;
+  });
+  // client identity and messages
+  std::vector<std::pair<std::string, std::vector<std::string>>> replies;
+  size_t nsent = 0;
+  {
+    std::string uuid;
+    bool known = false;
+    XrdSysMutexHelper lLock(this);
+
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+      if ((it == batch.begin()) || (it->first != uuid)) {
+        uuid = it->first;
+        auto uit = mUUIDView.find(uuid);
+        known = (uit != mUUIDView.end());
+
+        if (known) {
+          replies.emplace_back(uit->second, std::vector<std::string>());
+        }
+      }
+
+      if (known) {
+        replies.back().second.push_back(std::move(it->second));
+        ++nsent;
+      }
+    }
+  }
+
+  for (auto it = replies.begin(); it != replies.end(); ++it) {
+    gOFS->zMQ->task->reply(it->first, it->second);
+  }
+
+  errno = 0 ; // seems that ZMQ function might set errno
+  eos_static_info("msg=\"sent batch\" messages=%lu sent=%lu clients=%lu",
+                  batch.size(), nsent, replies.size());
+  return (int) nsent;
+}
+
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
@@ -560,6 +592,238 @@ FuseServer::Clients::HandleStatistics(const std::string identity,
   eos_static_debug("");
 }
 
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+FuseServer::Caps::Caps():
+  mCapShards(sNumShards), mInodeShards(sNumShards), mClientShards(sNumShards),
+  mWheel(sWheelSlots), mWheelTime(0)
+{
+  for (auto& slot : mWheel) {
+    slot.store(nullptr);
+  }
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+FuseServer::Caps::~Caps()
+{
+  for (auto& slot : mWheel) {
+    TimerNode* node = slot.exchange(nullptr);
+
+    while (node) {
+      TimerNode* next = node->mNext;
+      delete node;
+      node = next;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Put a node into the expiry slot of its cap - a cap already due goes into
+// the next slot to be processed
+//------------------------------------------------------------------------------
+void
+FuseServer::Caps::Schedule(TimerNode* node, uint64_t vtime)
+{
+  uint64_t when = std::max(vtime + sExpiryGrace, mWheelTime.load() + 1);
+  std::atomic<TimerNode*>& slot = mWheel[when % sWheelSlots];
+  node->mNext = slot.load();
+
+  while (!slot.compare_exchange_weak(node->mNext, node)) {
+  }
+}
+
+//------------------------------------------------------------------------------
+// Remove the caps whose lifetime is over. Each slot of the wheel passed
+// since the last call is drained: caps still valid, because their lifetime
+// was extended or is beyond one turn of the wheel, are scheduled again.
+//------------------------------------------------------------------------------
+size_t
+FuseServer::Caps::Expire(uint64_t now)
+{
+  uint64_t last = mWheelTime.load();
+  size_t nexpired = 0;
+
+  if (now <= last) {
+    return 0;
+  }
+
+  uint64_t start = ((now - last) >= sWheelSlots) ? (now - sWheelSlots + 1) :
+                   (last + 1);
+
+  for (uint64_t t = start; t <= now; ++t) {
+    TimerNode* node = mWheel[t % sWheelSlots].exchange(nullptr);
+
+    while (node) {
+      TimerNode* next = node->mNext;
+      shared_cap cap = node->mCap.lock();
+
+      if (!cap) {
+        // deleted or replaced meanwhile
+        delete node;
+      } else if ((cap->vtime() + sExpiryGrace) <= now) {
+        if (Remove(cap)) {
+          ++nexpired;
+        }
+
+        delete node;
+      } else {
+        Schedule(node, cap->vtime());
+      }
+
+      node = next;
+    }
+
+    mWheelTime = t;
+  }
+
+  return nexpired;
+}
+
+//------------------------------------------------------------------------------
+// Add a cap to the three views and schedule its expiry
+//------------------------------------------------------------------------------
+void
+FuseServer::Caps::Insert(const shared_cap& cap)
+{
+  {
+    CapShard& shard = GetCapShard(cap->authid());
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.mCaps[cap->authid()] = cap;
+  }
+  {
+    InodeShard& shard = GetInodeShard(cap->id());
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.mInodeCaps[cap->id()][cap->authid()] = cap.get();
+  }
+  {
+    ClientShard& shard = GetClientShard(cap->clientid());
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.Add(cap);
+  }
+  Schedule(new TimerNode{cap, nullptr}, cap->vtime());
+}
+
+//------------------------------------------------------------------------------
+// Remove a cap from the three views unless it was replaced meanwhile
+//------------------------------------------------------------------------------
+bool
+FuseServer::Caps::Remove(const shared_cap& cap)
+{
+  {
+    CapShard& shard = GetCapShard(cap->authid());
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto it = shard.mCaps.find(cap->authid());
+
+    if ((it == shard.mCaps.end()) || (it->second != cap)) {
+      return false;
+    }
+
+    shard.mCaps.erase(it);
+  }
+  {
+    InodeShard& shard = GetInodeShard(cap->id());
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto it = shard.mInodeCaps.find(cap->id());
+
+    if (it != shard.mInodeCaps.end()) {
+      // a renewal may have stored a new cap under the same authid meanwhile
+      auto ait = it->second.find(cap->authid());
+
+      if ((ait != it->second.end()) && (ait->second == cap.get())) {
+        it->second.erase(ait);
+      }
+
+      if (it->second.empty()) {
+        shard.mInodeCaps.erase(it);
+      }
+    }
+  }
+  {
+    ClientShard& shard = GetClientShard(cap->clientid());
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.Remove(cap);
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Add a cap to the client views - a cap replacing another one with the same
+// authid moves the inode count to its own inode
+//------------------------------------------------------------------------------
+void
+FuseServer::Caps::ClientShard::Add(const shared_cap& cap)
+{
+  auto& authids = mClientCaps[cap->clientid()];
+  auto& inodes = mClientInoCaps[cap->clientid()];
+  auto it = authids.find(cap->authid());
+
+  if (it != authids.end()) {
+    it->second.mCap = cap.get();
+
+    if (it->second.mIno == (uint64_t) cap->id()) {
+      return;
+    }
+
+    auto iit = inodes.find(it->second.mIno);
+
+    if ((iit != inodes.end()) && !--iit->second) {
+      inodes.erase(iit);
+    }
+
+    it->second.mIno = cap->id();
+  } else {
+    authids[cap->authid()] = client_cap_t{cap.get(), cap->id()};
+  }
+
+  inodes[cap->id()]++;
+}
+
+//------------------------------------------------------------------------------
+// Remove a cap from the client views - the inode stays in the client view as
+// long as another cap of the client points to it
+//------------------------------------------------------------------------------
+void
+FuseServer::Caps::ClientShard::Remove(const shared_cap& cap)
+{
+  auto it = mClientCaps.find(cap->clientid());
+
+  if (it == mClientCaps.end()) {
+    return;
+  }
+
+  auto ait = it->second.find(cap->authid());
+
+  if ((ait == it->second.end()) || (ait->second.mCap != cap.get())) {
+    return;
+  }
+
+  uint64_t ino = ait->second.mIno;
+  it->second.erase(ait);
+
+  if (it->second.empty()) {
+    mClientCaps.erase(it);
+  }
+
+  auto iit = mClientInoCaps.find(cap->clientid());
+
+  if (iit == mClientInoCaps.end()) {
+    return;
+  }
+
+  auto cit = iit->second.find(ino);
+
+  if ((cit != iit->second.end()) && !--cit->second) {
+    iit->second.erase(cit);
+  }
+
+  if (iit->second.empty()) {
+    mClientInoCaps.erase(iit);
+  }
+}
+
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
@@ -567,20 +831,15 @@ void
 FuseServer::Caps::Store(const eos::fusex::cap& ecap,
                         eos::common::Mapping::VirtualIdentity* vid)
 {
-  XrdSysMutexHelper lock(this);
   eos_static_info("id=%lx clientid=%s authid=%s",
                   ecap.id(),
                   ecap.clientid().c_str(),
                   ecap.authid().c_str());
-  // fill the three views on caps
-  mTimeOrderedCap.push_back(ecap.authid());
-  mClientCaps[ecap.clientid()].insert(ecap.authid());
-  mClientInoCaps[ecap.clientid()].insert(ecap.id());
   shared_cap cap = std::make_shared<capx>();
   *cap = ecap;
   cap->set_vid(vid);
-  mCaps[ecap.authid()] = cap;
-  mInodeCaps[ecap.id()].insert(ecap.authid());
+  // fill the three views on caps
+  Insert(cap);
 }
 
 //------------------------------------------------------------------------------
@@ -611,11 +870,7 @@ FuseServer::Caps::Imply(uint64_t md_ino,
   implied_cap->set_vtime(ts.tv_sec + 300);
   implied_cap->set_vtime_ns(ts.tv_nsec);
   // fill the three views on caps
-  mTimeOrderedCap.push_back(implied_authid);
-  mClientCaps[cap->clientid()].insert(implied_authid);
-  mClientInoCaps[cap->clientid()].insert(md_ino);
-  mCaps[implied_authid] = implied_cap;
-  mInodeCaps[md_ino].insert(implied_authid);
+  Insert(implied_cap);
   return true;
 }
 
@@ -625,15 +880,120 @@ FuseServer::Caps::Imply(uint64_t md_ino,
 FuseServer::Caps::shared_cap
 FuseServer::Caps::Get(FuseServer::Caps::authid_t id)
 {
-  XrdSysMutexHelper lock(this);
+  CapShard& shard = GetCapShard(id);
+  std::lock_guard<std::mutex> lock(shard.mMutex);
+  auto it = shard.mCaps.find(id);
 
-  if (mCaps.count(id)) {
-    return mCaps[id];
+  if (it != shard.mCaps.end()) {
+    return it->second;
   } else {
     return std::make_shared<capx>();
   }
 }
 
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool
+FuseServer::Caps::HasClientInoCap(const clientid_t& clientid, uint64_t ino)
+{
+  ClientShard& shard = GetClientShard(clientid);
+  std::lock_guard<std::mutex> lock(shard.mMutex);
+  auto it = shard.mClientInoCaps.find(clientid);
+  return ((it != shard.mClientInoCaps.end()) && it->second.count(ino));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+std::vector<FuseServer::Caps::shared_cap>
+FuseServer::Caps::DropClientUuid(const std::string& uuid)
+{
+  std::vector<shared_cap> dropped;
+
+  for (auto& shard : mCapShards) {
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+
+    for (auto it = shard.mCaps.begin(); it != shard.mCaps.end(); ++it) {
+      if (it->second->clientuuid() == uuid) {
+        dropped.push_back(it->second);
+      }
+    }
+  }
+
+  for (auto it = dropped.begin(); it != dropped.end(); ++it) {
+    Remove(*it);
+  }
+
+  return dropped;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void
+FuseServer::Caps::CountByClientUuid(std::map<std::string, size_t>& counts)
+{
+  for (auto& shard : mCapShards) {
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+
+    for (auto it = shard.mCaps.begin(); it != shard.mCaps.end(); ++it) {
+      counts[it->second->clientuuid()]++;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t
+FuseServer::Caps::Size()
+{
+  size_t n = 0;
+
+  for (auto& shard : mCapShards) {
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    n += shard.mCaps.size();
+  }
+
+  return n;
+}
+
+//------------------------------------------------------------------------------
+// Get the caps attached to an inode
+//------------------------------------------------------------------------------
+std::vector<FuseServer::Caps::shared_cap>
+FuseServer::Caps::InodeCaps(uint64_t ino)
+{
+  std::vector<shared_cap> caps;
+  authid_set_t authids;
+  {
+    InodeShard& shard = GetInodeShard(ino);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto it = shard.mInodeCaps.find(ino);
+
+    if (it == shard.mInodeCaps.end()) {
+      return caps;
+    }
+
+    for (auto ait = it->second.begin(); ait != it->second.end(); ++ait) {
+      authids.insert(ait->first);
+    }
+  }
+
+  for (auto it = authids.begin(); it != authids.end(); ++it) {
+    CapShard& shard = GetCapShard(*it);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto cit = shard.mCaps.find(*it);
+
+    if (cit != shard.mCaps.end()) {
+      caps.push_back(cit->second);
+    }
+  }
+
+  return caps;
+}
+
 
 /*----------------------------------------------------------------------------*/
 int
@@ -702,39 +1062,25 @@ FuseServer::Caps::BroadcastReleaseFromExternal(uint64_t id)
 /*----------------------------------------------------------------------------*/
 {
   // broad-cast release for a given inode
-  XrdSysMutexHelper lock(this);
   eos_static_info("id=%lx ",
                   id);
+  std::vector<shared_cap> caps = InodeCaps(id);
+  std::vector<Clients::client_message_t> batch;
+  authid_set_t deletioncaps;
 
-  if (mInodeCaps.count(id)) {
-    std::set<std::string> deletioncaps;
-
-    for (auto it = mInodeCaps[id].begin();
-         it != mInodeCaps[id].end(); ++it) {
-      shared_cap cap;
-
-      // loop over all caps for that inode
-      if (mCaps.count(*it)) {
-        cap = mCaps[*it];
-      } else {
-        continue;
-      }
-
-      if (cap->id()) {
-        deletioncaps.insert(*it);
-        gOFS->zMQ->gFuseServer.Client().ReleaseCAP((uint64_t) cap->id(),
-            cap->clientuuid(),
-            cap->clientid());
-        errno = 0 ; // seems that ZMQ function might set errno
-      }
-    }
+  // loop over all caps for that inode
+  for (auto it = caps.begin(); it != caps.end(); ++it) {
+    shared_cap cap = *it;
 
-    for (auto it = deletioncaps.begin(); it != deletioncaps.end(); ++it) {
-      eos_static_info("auto-remove-cap authid=%s", it->c_str());
-      mInodeCaps[id].erase(*it);
+    if (cap->id()) {
+      deletioncaps.insert(cap->authid());
+      batch.emplace_back(cap->clientuuid(),
+                         Clients::ReleaseCAPMessage((uint64_t) cap->id(), cap->clientid()));
     }
   }
 
+  Detach(id, deletioncaps);
+  gOFS->zMQ->gFuseServer.Client().SendBatch(batch);
   return 0;
 }
 
@@ -742,51 +1088,38 @@ int
 FuseServer::Caps::BroadcastRelease(const eos::fusex::md& md)
 {
   FuseServer::Caps::shared_cap refcap = Get(md.authid());
-  XrdSysMutexHelper lock(this);
   eos_static_info("id=%lx clientid=%s clientuuid=%s authid=%s",
                   refcap->id(),
                   refcap->clientid().c_str(),
                   refcap->clientuuid().c_str(),
                   refcap->authid().c_str());
+  std::vector<shared_cap> caps = InodeCaps(refcap->id());
+  std::vector<Clients::client_message_t> batch;
+  authid_set_t deletioncaps;
 
-  if (mInodeCaps.count(refcap->id())) {
-    std::set<std::string> deletioncaps;
-
-    for (auto it = mInodeCaps[refcap->id()].begin();
-         it != mInodeCaps[refcap->id()].end(); ++it) {
-      shared_cap cap;
+  // loop over all caps for that inode
+  for (auto it = caps.begin(); it != caps.end(); ++it) {
+    shared_cap cap = *it;
 
-      // loop over all caps for that inode
-      if (mCaps.count(*it)) {
-        cap = mCaps[*it];
-      } else {
-        continue;
-      }
-
-      // skip our own cap!
-      if (cap->authid() == refcap->authid()) {
-        continue;
-      }
-
-      // skip identical client mounts!
-      if (cap->clientuuid() == refcap->clientuuid()) {
-        continue;
-      }
+    // skip our own cap!
+    if (cap->authid() == refcap->authid()) {
+      continue;
+    }
 
-      if (cap->id()) {
-        deletioncaps.insert(*it);
-        gOFS->zMQ->gFuseServer.Client().ReleaseCAP((uint64_t) cap->id(),
-            cap->clientuuid(),
-            cap->clientid());
-      }
+    // skip identical client mounts!
+    if (cap->clientuuid() == refcap->clientuuid()) {
+      continue;
     }
 
-    for (auto it = deletioncaps.begin(); it != deletioncaps.end(); ++it) {
-      eos_static_info("auto-remove-cap authid=%s", it->c_str());
-      mInodeCaps[refcap->id()].erase(*it);
+    if (cap->id()) {
+      deletioncaps.insert(cap->authid());
+      batch.emplace_back(cap->clientuuid(),
+                         Clients::ReleaseCAPMessage((uint64_t) cap->id(), cap->clientid()));
     }
   }
 
+  Detach(refcap->id(), deletioncaps);
+  gOFS->zMQ->gFuseServer.Client().SendBatch(batch);
   return 0;
 }
 
@@ -797,53 +1130,70 @@ FuseServer::Caps::BroadcastMD(const eos::fusex::md& md,
                               struct timespec& p_mtime)
 {
   FuseServer::Caps::shared_cap refcap = Get(md.authid());
-  XrdSysMutexHelper lock(this);
   eos_static_info("id=%lx clientid=%s clientuuid=%s authid=%s",
                   refcap->id(),
                   refcap->clientid().c_str(),
                   refcap->clientuuid().c_str(),
                   refcap->authid().c_str());
   std::set<std::string> clients_sent;
+  std::vector<shared_cap> caps = InodeCaps(refcap->id());
+  std::vector<Clients::client_message_t> batch;
 
-  if (mInodeCaps.count(refcap->id())) {
-    for (auto it = mInodeCaps[refcap->id()].begin();
-         it != mInodeCaps[refcap->id()].end(); ++it) {
-      shared_cap cap;
-
-      // loop over all caps for that inode
-      if (mCaps.count(*it)) {
-        cap = mCaps[*it];
-      } else {
-        continue;
-      }
+  // loop over all caps for that inode
+  for (auto it = caps.begin(); it != caps.end(); ++it) {
+    shared_cap cap = *it;
 
-      // skip our own cap!
-      if (cap->authid() == refcap->authid()) {
-        continue;
-      }
+    // skip our own cap!
+    if (cap->authid() == refcap->authid()) {
+      continue;
+    }
 
-      // skip identical client mounts, the have it anyway!
-      if (cap->clientuuid() == refcap->clientuuid()) {
-        continue;
-      }
+    // skip identical client mounts, the have it anyway!
+    if (cap->clientuuid() == refcap->clientuuid()) {
+      continue;
+    }
 
-      if (cap->id() && !clients_sent.count(cap->clientuuid())) {
-        gOFS->zMQ->gFuseServer.Client().SendMD(md,
-                                               cap->clientuuid(),
-                                               cap->clientid(),
-                                               md_ino,
-                                               md_pino,
-                                               p_mtime);
-        // make sure we sent the update only once to each client, eveh if this
-        // one has many caps
-        clients_sent.insert(cap->clientuuid());
-      }
+    if (cap->id() && !clients_sent.count(cap->clientuuid())) {
+      batch.emplace_back(cap->clientuuid(),
+                         Clients::SendMDMessage(md, cap->clientid(), md_ino, md_pino, p_mtime));
+      // make sure we sent the update only once to each client, eveh if this
+      // one has many caps
+      clients_sent.insert(cap->clientuuid());
     }
   }
 
+  gOFS->zMQ->gFuseServer.Client().SendBatch(batch);
   return 0;
 }
 
+//------------------------------------------------------------------------------
+// Detach caps from an inode without removing them
+//------------------------------------------------------------------------------
+void
+FuseServer::Caps::Detach(uint64_t ino, const authid_set_t& authids)
+{
+  if (authids.empty()) {
+    return;
+  }
+
+  InodeShard& shard = GetInodeShard(ino);
+  std::lock_guard<std::mutex> lock(shard.mMutex);
+  auto it = shard.mInodeCaps.find(ino);
+
+  if (it == shard.mInodeCaps.end()) {
+    return;
+  }
+
+  for (auto sit = authids.begin(); sit != authids.end(); ++sit) {
+    eos_static_info("auto-remove-cap authid=%s", sit->c_str());
+    it->second.erase(*sit);
+  }
+
+  if (it->second.empty()) {
+    shard.mInodeCaps.erase(it);
+  }
+}
+
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
@@ -853,7 +1203,6 @@ FuseServer::Caps::Print(std::string option, std::string filter)
   std::string out;
   std::string astring;
   uint64_t now = (uint64_t) time(NULL);
-  XrdSysMutexHelper lock(this);
   eos_static_info("option=%s string=%s", option.c_str(), filter.c_str());
   regex_t regex;
 
@@ -865,15 +1214,43 @@ FuseServer::Caps::Print(std::string option, std::string filter)
     return out;
   }
 
+  // lookup of a cap, nullptr if not there anymore
+  auto find_cap = [this](const authid_t & id) {
+    CapShard& shard = GetCapShard(id);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto it = shard.mCaps.find(id);
+    return ((it != shard.mCaps.end()) ? it->second : shared_cap());
+  };
+  // snapshot of the inode view
+  notify_set_t inodecaps;
+
+  if ((option == "i") || (option == "p")) {
+    for (auto& shard : mInodeShards) {
+      std::lock_guard<std::mutex> lock(shard.mMutex);
+      inodecaps.insert(shard.mInodeCaps.begin(), shard.mInodeCaps.end());
+    }
+  }
+
   if (option == "t") {
     // print by time order
-    for (auto it = mTimeOrderedCap.begin(); it != mTimeOrderedCap.end(); ++it) {
-      if (!mCaps.count(*it)) {
-        continue;
+    std::vector<shared_cap> caps;
+
+    for (auto& shard : mCapShards) {
+      std::lock_guard<std::mutex> lock(shard.mMutex);
+
+      for (auto it = shard.mCaps.begin(); it != shard.mCaps.end(); ++it) {
+        caps.push_back(it->second);
       }
+    }
+
+    std::stable_sort(caps.begin(), caps.end(),
+    [](const shared_cap & a, const shared_cap & b) {
+      return a->vtime() < b->vtime();
+    });
 
+    for (auto it = caps.begin(); it != caps.end(); ++it) {
       char ahex[256];
-      shared_cap cap = mCaps[*it];
+      shared_cap cap = *it;
       snprintf(ahex, sizeof(ahex), "%016lx", (unsigned long) cap->id());
       std::string match = "";
       match += "# i:";
@@ -910,7 +1287,7 @@ FuseServer::Caps::Print(std::string option, std::string filter)
 
   if (option == "i") {
     // print by inode
-    for (auto it = mInodeCaps.begin(); it != mInodeCaps.end(); ++it) {
+    for (auto it = inodecaps.begin(); it != inodecaps.end(); ++it) {
       char ahex[256];
       snprintf(ahex, sizeof(ahex), "%016lx", (unsigned long) it->first);
 
@@ -924,12 +1301,12 @@ FuseServer::Caps::Print(std::string option, std::string filter)
 
       for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
         out += "___ a:";
-        out += *sit;
+        out += sit->first;
+        shared_cap cap = find_cap(sit->first);
 
-        if (!mCaps.count(*sit)) {
+        if (!cap) {
           out += " c:<unfound> u:<unfound> m:<unfound> v:<unfound>\n";
         } else {
-          shared_cap cap = mCaps[*sit];
           out += " c:";
           out += cap->clientid();
           out += " u:";
@@ -948,7 +1325,7 @@ FuseServer::Caps::Print(std::string option, std::string filter)
 
   if (option == "p") {
     // print by inode
-    for (auto it = mInodeCaps.begin(); it != mInodeCaps.end(); ++it) {
+    for (auto it = inodecaps.begin(); it != inodecaps.end(); ++it) {
       std::string spath;
       eos::common::RWMutexReadLock lock(gOFS->eosViewRWMutex);
 
@@ -981,12 +1358,12 @@ FuseServer::Caps::Print(std::string option, std::string filter)
 
       for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
         out += "___ a:";
-        out += *sit;
+        out += sit->first;
+        shared_cap cap = find_cap(sit->first);
 
-        if (!mCaps.count(*sit)) {
+        if (!cap) {
           out += " c:<unfound> u:<unfound> m:<unfound> v:<unfound>\n";
         } else {
-          shared_cap cap = mCaps[*sit];
           out += " c:";
           out += cap->clientid();
           out += " u:";
@@ -1013,37 +1390,42 @@ FuseServer::Caps::Print(std::string option, std::string filter)
 int
 FuseServer::Caps::Delete(uint64_t md_ino)
 {
-  XrdSysMutexHelper lock(this);
-
-  if (!mInodeCaps.count(md_ino)) {
-    return ENOENT;
-  }
+  inode_cap_set_t authids;
+  {
+    InodeShard& shard = GetInodeShard(md_ino);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto it = shard.mInodeCaps.find(md_ino);
 
-  for (auto sit = mInodeCaps[md_ino].begin() ;
-       sit != mInodeCaps[md_ino].end();
-       ++sit) {
-    for (auto it = mClientCaps.begin(); it != mClientCaps.end(); it++) {
-      // erase authid from the client set
-      it->second.erase(*sit);
-      // erase authid from the time ordered list
-      mTimeOrderedCap.erase(std::remove(mTimeOrderedCap.begin(),
-                                        mTimeOrderedCap.end(),
-                                        *sit), mTimeOrderedCap.end());
+    if (it == shard.mInodeCaps.end()) {
+      return ENOENT;
     }
 
-    if (mCaps.count(*sit)) {
-      shared_cap cap = mCaps[*sit];
+    // erase inode from the inode caps
+    authids.swap(it->second);
+    shard.mInodeCaps.erase(it);
+  }
+
+  for (auto sit = authids.begin(); sit != authids.end(); ++sit) {
+    shared_cap cap;
+    {
+      CapShard& shard = GetCapShard(sit->first);
+      std::lock_guard<std::mutex> lock(shard.mMutex);
+      auto it = shard.mCaps.find(sit->first);
 
-      if (mClientInoCaps.count(cap->clientid())) {
-        mClientInoCaps[cap->clientid()].erase(md_ino);
+      if (it == shard.mCaps.end()) {
+        continue;
       }
 
-      mCaps.erase(*sit);
+      cap = it->second;
+      shard.mCaps.erase(it);
     }
+    // erase authid and inode from the client sets, the expiry drops its
+    // entry of the time wheel
+    ClientShard& shard = GetClientShard(cap->clientid());
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.Remove(cap);
   }
 
-  // erase inode from the inode caps
-  mInodeCaps.erase(md_ino);
   return 0;
 }
 
@@ -1331,6 +1713,9 @@ FuseServer::FillContainerMD(uint64_t id, eos::fusex::md& dir)
     dir.set_nchildren(cmd->getNumContainers() + cmd->getNumFiles());
 
     if (dir.operation() == dir.LS) {
+      // Files are created under the namespace read lock
+      eos::ReadLockGuard children_lock(cmd->getChildrenLock());
+
       for (auto it = cmd->filesBegin(), end = cmd->filesEnd();
            it != end; ++it) {
         (*dir.mutable_children())[it->first] =
@@ -1445,12 +1830,8 @@ FuseServer::FillContainerCAP(uint64_t id,
     eos_static_info("checking for id=%s", dir.clientid().c_str());
     // check if the client has already a cap, in case yes, we don't return a new
     // one
-    XrdSysMutexHelper lock(Cap());
-
-    if (Cap().ClientInoCaps().count(dir.clientid())) {
-      if (Cap().ClientInoCaps()[dir.clientid()].count(id)) {
-        return true;
-      }
+    if (Cap().HasClientInoCap(dir.clientid(), id)) {
+      return true;
     }
   }
 
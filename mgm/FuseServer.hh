@@ -30,6 +30,8 @@
 #include <map>
 #include <atomic>
 #include <deque>
+#include <mutex>
+#include <unordered_map>
 #include "mgm/fusex.pb.h"
 #include "mgm/fuse-locks/LockTracker.hh"
 #include "common/Mapping.hh"
@@ -162,6 +164,24 @@ public:
                uint64_t md_pino,
                struct timespec& p_mtime);
 
+    // message for a client mount: uuid and serialized response
+    typedef std::pair<std::string, std::string> client_message_t;
+
+    // serialize a release CAP message
+    static std::string ReleaseCAPMessage(uint64_t id, const std::string& clientid);
+
+    // serialize an MD update message
+    static std::string SendMDMessage(const eos::fusex::md& md,
+                                     const std::string& clientid,
+                                     uint64_t md_ino,
+                                     uint64_t md_pino,
+                                     struct timespec& p_mtime);
+
+    // send messages to several clients - the identities are resolved under
+    // one lock, the messages are sent after releasing it and those of a
+    // client back to back
+    int SendBatch(std::vector<client_message_t>& batch);
+
     // drop caps of a given client
     int Dropcaps(const std::string& uuid, std::string& out);
 
@@ -196,7 +216,7 @@ public:
   //----------------------------------------------------------------------------
   //! Class Caps
   //----------------------------------------------------------------------------
-  class Caps : public XrdSysMutex
+  class Caps
   {
     friend class FuseServer;
   public:
@@ -230,57 +250,29 @@ public:
 
     typedef std::shared_ptr<capx> shared_cap;
 
-    Caps() = default;
+    Caps();
 
-    virtual ~Caps() = default;
+    virtual ~Caps();
 
     typedef std::string authid_t;
     typedef std::string clientid_t;
     typedef std::pair<uint64_t, authid_t> ino_authid_t;
     typedef std::set<authid_t> authid_set_t;
     typedef std::set<uint64_t> ino_set_t;
-    typedef std::map<uint64_t, authid_set_t> notify_set_t; // inode=>set(authid_t)
-    typedef std::map<clientid_t, authid_set_t> client_set_t;
-    typedef std::map<clientid_t, ino_set_t> client_ino_set_t;
-
-    void pop()
-    {
-      XrdSysMutexHelper lock(this);
-      mTimeOrderedCap.pop_front();
-    }
-
-    bool expire()
-    {
-      XrdSysMutexHelper lock(this);
-      authid_t id;
-
-      if (!mTimeOrderedCap.empty()) {
-        id = mTimeOrderedCap.front();
-      } else {
-        return false;
-      }
-
-      if (mCaps.count(id)) {
-        shared_cap cap = mCaps[id];
-        uint64_t now = (uint64_t) time(NULL);
-
-	if ((cap->vtime()+10) <= now)
-        {
-          mCaps.erase(id);
-          mInodeCaps[cap->id()].erase(id);
-
-          if (!mInodeCaps[cap->id()].size()) {
-            mInodeCaps.erase(cap->id());
-          }
-
-          return true;
-        } else {
-          return false;
-        }
-      }
+    // caps of an inode - the pointer only tells replaced caps apart
+    typedef std::map<authid_t, const capx*> inode_cap_set_t;
+    typedef std::map<uint64_t, inode_cap_set_t> notify_set_t; // inode=>authids
+    // cap of a client - the pointer only tells replaced caps apart
+    struct client_cap_t {
+      const capx* mCap;
+      uint64_t mIno;
+    };
+    typedef std::map<clientid_t, std::map<authid_t, client_cap_t>> client_set_t;
+    // clientid=>inode=>number of caps of the client on the inode
+    typedef std::map<clientid_t, std::map<uint64_t, size_t>> client_ino_set_t;
 
-      return true;
-    }
+    // remove the caps whose lifetime is over, returns the number removed
+    size_t Expire(uint64_t now);
 
     void Store(const eos::fusex::cap& cap,
                eos::common::Mapping::VirtualIdentity* vid);
@@ -295,6 +287,18 @@ public:
 
     shared_cap Get(authid_t id);
 
+    // check if a client holds a cap for an inode
+    bool HasClientInoCap(const clientid_t& clientid, uint64_t ino);
+
+    // remove all the caps of a client mount, returns the caps removed
+    std::vector<shared_cap> DropClientUuid(const std::string& uuid);
+
+    // count the caps per client uuid
+    void CountByClientUuid(std::map<std::string, size_t>& counts);
+
+    // number of caps
+    size_t Size();
+
     int BroadcastRelease(const eos::fusex::md&
                          md); // broad cast triggered by fuse network
     int BroadcastReleaseFromExternal(uint64_t
@@ -306,37 +310,94 @@ public:
                    ); // broad cast changed md around
     std::string Print(std::string option, std::string filter);
 
-    std::map<authid_t, shared_cap>& GetCaps()
-    {
-      return mCaps;
-    }
+  protected:
+    //--------------------------------------------------------------------------
+    //! The caps are kept in three views, each one split into shards with their
+    //! own lock: authid=>cap sharded by authid, inode=>authids sharded by
+    //! inode and clientid=>authids/inodes sharded by clientid. An operation
+    //! never holds two shard locks at a time, so cap lookups, grants and
+    //! broadcasts on different inodes and clients proceed in parallel. The
+    //! views are updated one after the other - the readers tolerate an authid
+    //! without cap, as they did before.
+    //--------------------------------------------------------------------------
+    static const size_t sNumShards = 64;
+    //! Number of one second slots of the expiry wheel
+    static const size_t sWheelSlots = 4096;
+    //! Grace period after the end of the validity of a cap before removal
+    static const uint64_t sExpiryGrace = 10;
+
+    struct CapShard {
+      std::mutex mMutex;
+      // authid=>cap lookup map
+      std::unordered_map<authid_t, shared_cap> mCaps;
+    };
+
+    struct InodeShard {
+      std::mutex mMutex;
+      // inode=>authid_t=>cap
+      notify_set_t mInodeCaps;
+    };
+
+    struct ClientShard {
+      std::mutex mMutex;
+      // clientid=>list of authid
+      client_set_t mClientCaps;
+      // clientid=>list of inodes
+      client_ino_set_t mClientInoCaps;
+
+      // add a cap to the client views, replacing a cap with the same authid
+      void Add(const shared_cap& cap);
 
-    notify_set_t& InodeCaps()
+      // remove a cap from the client views unless it was replaced meanwhile
+      void Remove(const shared_cap& cap);
+    };
+
+    //--------------------------------------------------------------------------
+    //! Entry of the expiry wheel - the slots are lock-free stacks filled by
+    //! any thread and drained by the monitor thread only. An entry pointing
+    //! to a cap that was replaced or deleted meanwhile is simply dropped.
+    //--------------------------------------------------------------------------
+    struct TimerNode {
+      std::weak_ptr<capx> mCap;
+      TimerNode* mNext;
+    };
+
+    std::vector<CapShard> mCapShards;
+    std::vector<InodeShard> mInodeShards;
+    std::vector<ClientShard> mClientShards;
+    std::vector<std::atomic<TimerNode*>> mWheel;
+    // last second processed by the expiry
+    std::atomic<uint64_t> mWheelTime;
+
+    CapShard& GetCapShard(const authid_t& id)
     {
-      return mInodeCaps;
+      return mCapShards[std::hash<authid_t>()(id) % sNumShards];
     }
 
-    client_set_t& ClientCaps()
+    InodeShard& GetInodeShard(uint64_t ino)
     {
-      return mClientCaps;
+      return mInodeShards[((ino * 0x9e3779b97f4a7c15ull) >> 32) % sNumShards];
     }
 
-    client_ino_set_t& ClientInoCaps()
+    ClientShard& GetClientShard(const clientid_t& id)
     {
-      return mClientInoCaps;
+      return mClientShards[std::hash<clientid_t>()(id) % sNumShards];
     }
 
-  protected:
-    // a time ordered list pointing to caps
-    std::deque< authid_t > mTimeOrderedCap;
-    // authid=>cap lookup map
-    std::map<authid_t, shared_cap> mCaps;
-    // clientid=>list of authid
-    client_set_t mClientCaps;
-    // clientid=>list of inodes
-    client_ino_set_t mClientInoCaps;
-    // inode=>authid_t
-    notify_set_t mInodeCaps;
+    // add a cap to the three views and schedule its expiry
+    void Insert(const shared_cap& cap);
+
+    // remove a cap from the three views unless it was replaced meanwhile
+    bool Remove(const shared_cap& cap);
+
+    // put a node into the expiry slot of its cap
+    void Schedule(TimerNode* node, uint64_t vtime);
+
+    // get the caps attached to an inode
+    std::vector<shared_cap> InodeCaps(uint64_t ino);
+
+    // detach caps from an inode without removing them
+    void Detach(uint64_t ino, const authid_set_t& authids);
   };
 
   class Lock : XrdSysMutex
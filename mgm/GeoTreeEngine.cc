@@ -47,6 +47,7 @@ GeoTreeEngine gGeoTreeEngine;
 const size_t GeoTreeEngine::gGeoBufferSize = sizeof(FastPlacementTree) +
     FastPlacementTree::sGetMaxDataMemSize();
 __thread void* GeoTreeEngine::tlGeoBuffer = NULL;
+const size_t GeoTreeEngine::sBatchPlacementSlice = 64;
 pthread_key_t GeoTreeEngine::gPthreadKey;
 __thread const FsGroup* GeoTreeEngine::tlCurrentGroup = NULL;
 
@@ -179,9 +180,27 @@ bool GeoTreeEngine::forceRefresh()
 bool GeoTreeEngine::insertFsIntoGroup(FileSystem* fs ,
                                       FsGroup* group,
                                       bool updateFastStruct)
+{
+  eos::common::FileSystem::fs_snapshot_t fsn;
+  fs->SnapShotFileSystem(fsn, true);
+  return insertFsIntoGroup(fs, fsn, group, updateFastStruct);
+}
+
+bool GeoTreeEngine::insertFsIntoGroup(const
+                                      eos::common::FileSystem::fs_snapshot_t& fsn,
+                                      FsGroup* group,
+                                      bool updateFastStruct)
+{
+  return insertFsIntoGroup(NULL, fsn, group, updateFastStruct);
+}
+
+bool GeoTreeEngine::insertFsIntoGroup(FileSystem* fs,
+                                      const eos::common::FileSystem::fs_snapshot_t& fsn,
+                                      FsGroup* group,
+                                      bool updateFastStruct)
 {
   eos::common::RWMutexWriteLock lock(pAddRmFsMutex);
-  FileSystem::fsid_t fsid = fs->GetId();
+  FileSystem::fsid_t fsid = fsn.mId;
   SchedTME* mapEntry = 0;
   bool is_new_entry = false;
   {
@@ -231,8 +250,6 @@ bool GeoTreeEngine::insertFsIntoGroup(FileSystem* fs ,
   }
   // ==== fill the entry
   // create new TreeNodeInfo/TreeNodeState pair and update its data
-  eos::common::FileSystem::fs_snapshot_t fsn;
-  fs->SnapShotFileSystem(fsn, true);
   // check if there is still some space for a new fs
   {
     size_t depth = 1;
@@ -323,7 +340,7 @@ bool GeoTreeEngine::insertFsIntoGroup(FileSystem* fs ,
   }
 
   // ==== update the shared object notifications
-  {
+  if (fs) {
     if (gWatchedKeys.empty()) {
       for (auto it = gNotifKey2EnumSched.begin(); it != gNotifKey2EnumSched.end();
            it++) {
@@ -356,7 +373,10 @@ bool GeoTreeEngine::insertFsIntoGroup(FileSystem* fs ,
   }
 
   // update all the information about this new node
-  if (!updateTreeInfo(mapEntry, &fsn, ~sfgGeotag & ~sfgId & ~sfgHost , 0, node)) {
+  eos::common::FileSystem::fs_snapshot_t fsinfo = fsn;
+
+  if (!updateTreeInfo(mapEntry, &fsinfo, ~sfgGeotag & ~sfgId & ~sfgHost , 0,
+                      node)) {
     mapEntry->slowTreeMutex.UnLockWrite();
     pTreeMapMutex.LockRead();
     eos_err("error inserting fs %lu into group %s : slow tree node update failed",
@@ -398,7 +418,11 @@ bool GeoTreeEngine::insertFsIntoGroup(FileSystem* fs ,
     mapEntry->group = group;
     pGroup2SchedTME[group] = mapEntry;
     pFs2SchedTME[fsid] = mapEntry;
-    pFsId2FsPtr[fsid] = fs;
+
+    if (fs) {
+      pFsId2FsPtr[fsid] = fs;
+    }
+
     pTreeMapMutex.UnLockWrite();
     mapEntry->slowTreeMutex.UnLockWrite();
   }
@@ -1035,45 +1059,8 @@ GeoTreeEngine::placeNewReplicasOneGroup(FsGroup* group,
     existingReplicasIdx = new vector<SchedTreeBase::tFastTreeIdx>
     (existingReplicas->size());
     existingReplicasIdx->resize(0);
-    int count = 0;
-
-    for (auto it = existingReplicas->begin(); it != existingReplicas->end();
-         ++it , ++count) {
-      const SchedTreeBase::tFastTreeIdx* idx =
-        static_cast<const SchedTreeBase::tFastTreeIdx*>(0);
-
-      if (!entry->foregroundFastStruct->fs2TreeIdx->get(*it, idx) &&
-          !(*fsidsgeotags)[count].empty()) {
-        // the fs is not in that group.
-        // this could happen because the former file scheduler
-        // could place replicas across multiple groups
-        // with the new geoscheduler, it should not happen
-        // in that case, we try to match a filesystem having the same geotag
-        SchedTreeBase::tFastTreeIdx idx =
-          entry->foregroundFastStruct->tag2NodeIdx->getClosestFastTreeNode((
-                *fsidsgeotags)[count].c_str());
-
-        if (idx &&
-            (*entry->foregroundFastStruct->treeInfo)[idx].nodeType ==
-            SchedTreeBase::TreeNodeInfo::fs) {
-          if ((std::find(existingReplicasIdx->begin(), existingReplicasIdx->end(),
-                         idx) == existingReplicasIdx->end())) {
-            existingReplicasIdx->push_back(idx);
-          }
-        }
-        // if we can't find any such filesystem, the information is not taken into account
-        // (and then can lead to unoptimal placement
-        else {
-          eos_debug("could not place preexisting replica on the fast tree");
-        }
-
-        continue;
-      }
-
-      if (idx) {
-        existingReplicasIdx->push_back(*idx);
-      }
-    }
+    getExistingReplicasIdx(entry, *existingReplicas, fsidsgeotags,
+                           *existingReplicasIdx);
   }
 
   if (excludeFs) {
@@ -1166,35 +1153,9 @@ GeoTreeEngine::placeNewReplicasOneGroup(FsGroup* group,
 
   // fill the resulting vector and
   // update the fastTree UlScore and DlScore by applying the penalties
-  newReplicas->resize(0);
-
-  for (auto it = newReplicasIdx.begin(); it != newReplicasIdx.end(); ++it) {
-    const SchedTreeBase::tFastTreeIdx* idx = NULL;
-    const unsigned int fsid = (*entry->foregroundFastStruct->treeInfo)[*it].fsId;
-
-    if (!entry->foregroundFastStruct->fs2TreeIdx->get(fsid, idx)) {
-      eos_crit("inconsistency : cannot retrieve index of selected fs though "
-               "it should be in the tree");
-      success = false;
-      goto cleanup;
-    }
-
-    const char netSpeedClass =
-      (*entry->foregroundFastStruct->treeInfo)[*idx].netSpeedClass;
-    newReplicas->push_back(fsid);
-
-    // Apply the penalties
-    if (entry->foregroundFastStruct->placementTree->pNodes[*idx].fsData.dlScore >
-        0) {
-      applyDlScorePenalty(entry, *idx,
-                          pPenaltySched.pPlctDlScorePenalty[netSpeedClass]);
-    }
-
-    if (entry->foregroundFastStruct->placementTree->pNodes[*idx].fsData.ulScore >
-        0) {
-      applyUlScorePenalty(entry, *idx,
-                          pPenaltySched.pPlctUlScorePenalty[netSpeedClass]);
-    }
+  if (!commitNewReplicas(entry, newReplicasIdx, newReplicas)) {
+    success = false;
+    goto cleanup;
   }
 
   if (dataProxys || firewallEntryPoint) {
@@ -1279,6 +1240,281 @@ cleanup:
   return success;
 }
 
+void
+GeoTreeEngine::getExistingReplicasIdx(SchedTME* entry,
+                                      const vector<FileSystem::fsid_t>& existingReplicas,
+                                      const std::vector<std::string>* fsidsgeotags,
+                                      vector<SchedTreeBase::tFastTreeIdx>& existingReplicasIdx)
+{
+  int count = 0;
+
+  for (auto it = existingReplicas.begin(); it != existingReplicas.end();
+       ++it , ++count) {
+    const SchedTreeBase::tFastTreeIdx* idx =
+      static_cast<const SchedTreeBase::tFastTreeIdx*>(0);
+
+    if (!entry->foregroundFastStruct->fs2TreeIdx->get(*it, idx) &&
+        fsidsgeotags && !(*fsidsgeotags)[count].empty()) {
+      // the fs is not in that group.
+      // this could happen because the former file scheduler
+      // could place replicas across multiple groups
+      // with the new geoscheduler, it should not happen
+      // in that case, we try to match a filesystem having the same geotag
+      SchedTreeBase::tFastTreeIdx idx =
+        entry->foregroundFastStruct->tag2NodeIdx->getClosestFastTreeNode((
+              *fsidsgeotags)[count].c_str());
+
+      if (idx &&
+          (*entry->foregroundFastStruct->treeInfo)[idx].nodeType ==
+          SchedTreeBase::TreeNodeInfo::fs) {
+        if ((std::find(existingReplicasIdx.begin(), existingReplicasIdx.end(),
+                       idx) == existingReplicasIdx.end())) {
+          existingReplicasIdx.push_back(idx);
+        }
+      }
+      // if we can't find any such filesystem, the information is not taken into account
+      // (and then can lead to unoptimal placement
+      else {
+        eos_debug("could not place preexisting replica on the fast tree");
+      }
+
+      continue;
+    }
+
+    if (idx) {
+      existingReplicasIdx.push_back(*idx);
+    }
+  }
+}
+
+bool
+GeoTreeEngine::commitNewReplicas(SchedTME* entry,
+                                 const vector<SchedTreeBase::tFastTreeIdx>& newReplicasIdx,
+                                 vector<FileSystem::fsid_t>* newReplicas)
+{
+  newReplicas->resize(0);
+
+  for (auto it = newReplicasIdx.begin(); it != newReplicasIdx.end(); ++it) {
+    const SchedTreeBase::tFastTreeIdx* idx = NULL;
+    const unsigned int fsid = (*entry->foregroundFastStruct->treeInfo)[*it].fsId;
+
+    if (!entry->foregroundFastStruct->fs2TreeIdx->get(fsid, idx)) {
+      eos_crit("inconsistency : cannot retrieve index of selected fs though "
+               "it should be in the tree");
+      return false;
+    }
+
+    const char netSpeedClass =
+      (*entry->foregroundFastStruct->treeInfo)[*idx].netSpeedClass;
+    newReplicas->push_back(fsid);
+
+    // Apply the penalties
+    if (entry->foregroundFastStruct->placementTree->pNodes[*idx].fsData.dlScore >
+        0) {
+      applyDlScorePenalty(entry, *idx,
+                          pPenaltySched.pPlctDlScorePenalty[netSpeedClass]);
+    }
+
+    if (entry->foregroundFastStruct->placementTree->pNodes[*idx].fsData.ulScore >
+        0) {
+      applyUlScorePenalty(entry, *idx,
+                          pPenaltySched.pPlctUlScorePenalty[netSpeedClass]);
+    }
+  }
+
+  return true;
+}
+
+template<class T> size_t
+GeoTreeEngine::placeBatchSlice(SchedTME* entry, T* placementTree,
+                               std::vector<BatchPlacement>& batch,
+                               size_t begin, size_t end, bool skipSaturated)
+{
+  size_t nplaced = 0;
+  // working tree booked and sorted once for all the files of the slice
+  // having neither preexisting nor excluded replicas
+  std::vector<char> baseBuffer;
+  T* baseTree = NULL;
+  unsigned long long baseBookingSize = 0;
+  vector<SchedTreeBase::tFastTreeIdx> newReplicasIdx, existingReplicasIdx,
+         excludeFsIdx;
+
+  for (size_t i = begin; i < end; ++i) {
+    BatchPlacement& plct = batch[i];
+    newReplicasIdx.clear();
+    plct.newReplicas.clear();
+    plct.success = false;
+
+    if (!plct.nNewReplicas) {
+      continue;
+    }
+
+    if (plct.existingReplicas.empty() && plct.excludeFs.empty() &&
+        plct.excludeGeoTags.empty() && plct.startFromGeoTag.empty()) {
+      if (!baseTree || (baseBookingSize != plct.bookingSize)) {
+        baseBuffer.resize(gGeoBufferSize);
+
+        if (placementTree->copyToBuffer(&baseBuffer[0], gGeoBufferSize)) {
+          eos_crit("could not make a working copy of the fast tree");
+          continue;
+        }
+
+        baseTree = (T*) &baseBuffer[0];
+        baseBookingSize = plct.bookingSize;
+
+        if (applyBooking(baseTree, baseBookingSize)) {
+          baseTree->updateTree();
+        }
+      }
+
+      plct.success = placeNewReplicasFromBase(baseTree, plct.nNewReplicas,
+                                              &newReplicasIdx, skipSaturated);
+    } else {
+      existingReplicasIdx.clear();
+      excludeFsIdx.clear();
+      getExistingReplicasIdx(entry, plct.existingReplicas,
+                             plct.fsidsgeotags.empty() ? NULL : &plct.fsidsgeotags,
+                             existingReplicasIdx);
+
+      for (auto it = plct.excludeFs.begin(); it != plct.excludeFs.end(); ++it) {
+        const SchedTreeBase::tFastTreeIdx* idx;
+
+        // the excluded fs might belong to another group
+        if (entry->foregroundFastStruct->fs2TreeIdx->get(*it, idx)) {
+          excludeFsIdx.push_back(*idx);
+        }
+      }
+
+      for (auto it = plct.excludeGeoTags.begin(); it != plct.excludeGeoTags.end();
+           ++it) {
+        excludeFsIdx.push_back(
+          entry->foregroundFastStruct->tag2NodeIdx->getClosestFastTreeNode(
+            it->c_str()));
+      }
+
+      SchedTreeBase::tFastTreeIdx startFromNode = 0;
+
+      if (!plct.startFromGeoTag.empty()) {
+        startFromNode =
+          entry->foregroundFastStruct->tag2NodeIdx->getClosestFastTreeNode(
+            plct.startFromGeoTag.c_str());
+      }
+
+      plct.success = placeNewReplicas(entry, plct.nNewReplicas, &newReplicasIdx,
+                                      placementTree, &existingReplicasIdx,
+                                      plct.bookingSize, startFromNode,
+                                      plct.nCollocatedReplicas, &excludeFsIdx,
+                                      NULL, skipSaturated);
+    }
+
+    if (plct.success) {
+      plct.success = commitNewReplicas(entry, newReplicasIdx, &plct.newReplicas);
+    }
+
+    if (!plct.success) {
+      plct.newReplicas.clear();
+      continue;
+    }
+
+    ++nplaced;
+
+    // Apply the penalties to the shared tree as well so that the next files
+    // of the batch see them like they would in the foreground structures
+    if (baseTree) {
+      for (auto it = newReplicasIdx.begin(); it != newReplicasIdx.end(); ++it) {
+        const char netSpeedClass =
+          (*entry->foregroundFastStruct->treeInfo)[*it].netSpeedClass;
+
+        if (baseTree->pNodes[*it].fsData.dlScore > 0) {
+          baseTree->pNodes[*it].fsData.dlScore -=
+            pPenaltySched.pPlctDlScorePenalty[netSpeedClass];
+        }
+
+        if (baseTree->pNodes[*it].fsData.ulScore > 0) {
+          baseTree->pNodes[*it].fsData.ulScore -=
+            pPenaltySched.pPlctUlScorePenalty[netSpeedClass];
+        }
+
+        // re-sort the branches above the penalized fs
+        baseTree->pNodes[*it].fileData.maxUlScore =
+          baseTree->pNodes[*it].fsData.ulScore;
+        baseTree->pNodes[*it].fileData.maxDlScore =
+          baseTree->pNodes[*it].fsData.dlScore;
+        baseTree->pNodes[*it].fileData.avgUlScore =
+          baseTree->pNodes[*it].fsData.ulScore;
+        baseTree->pNodes[*it].fileData.avgDlScore =
+          baseTree->pNodes[*it].fsData.dlScore;
+        baseTree->updateBranch(*it);
+      }
+    }
+  }
+
+  return nplaced;
+}
+
+size_t
+GeoTreeEngine::placeNewReplicasOneGroupBatch(FsGroup* group,
+    std::vector<BatchPlacement>& batch,
+    SchedType type)
+{
+  size_t nplaced = 0;
+  tlCurrentGroup = group;
+  SchedTME* entry;
+  {
+    RWMutexReadLock lock(this->pTreeMapMutex);
+
+    if (!pGroup2SchedTME.count(group)) {
+      eos_err("could not find the requested placement group in the map");
+
+      for (auto it = batch.begin(); it != batch.end(); ++it) {
+        it->newReplicas.clear();
+        it->success = false;
+      }
+
+      return 0;
+    }
+
+    entry = pGroup2SchedTME[group];
+    AtomicInc(entry->fastStructLockWaitersCount);
+  }
+
+  for (size_t begin = 0; begin < batch.size();
+       begin += sBatchPlacementSlice) {
+    size_t end = std::min(batch.size(), begin + sBatchPlacementSlice);
+    // readlock the original fast structure, it is released after each slice
+    // to let the background updates swap the double buffer
+    entry->doubleBufferMutex.LockRead();
+
+    switch (type) {
+    case regularRO:
+    case regularRW:
+      nplaced += placeBatchSlice(entry, entry->foregroundFastStruct->placementTree,
+                                 batch, begin, end, pSkipSaturatedPlct);
+      break;
+
+    case draining:
+      nplaced += placeBatchSlice(entry,
+                                 entry->foregroundFastStruct->drnPlacementTree,
+                                 batch, begin, end, pSkipSaturatedDrnPlct);
+      break;
+
+    case balancing:
+      nplaced += placeBatchSlice(entry,
+                                 entry->foregroundFastStruct->blcPlacementTree,
+                                 batch, begin, end, pSkipSaturatedBlcPlct);
+      break;
+
+    default:
+      break;
+    }
+
+    entry->doubleBufferMutex.UnLockRead();
+  }
+
+  AtomicDec(entry->fastStructLockWaitersCount);
+  return nplaced;
+}
+
 // Would be better as defined locally in find Proxy
 // but it is not supported by gcc 4.4
 struct TreeInfoFsIdComparator {
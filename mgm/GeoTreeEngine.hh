@@ -995,6 +995,8 @@ public:
   enum SchedType
   { regularRO, regularRW, balancing, draining};
 
+  struct BatchPlacement;
+
 protected:
 //**********************************************************
 // BEGIN DATA MEMBERS
@@ -1159,6 +1161,9 @@ protected:
   //
   /// Thread local buffer to hold a working copy of a fast structure
   static __thread void* tlGeoBuffer;
+  /// Number of files placed by placeNewReplicasOneGroupBatch before the
+  /// fast structures are unlocked to let pending updates through
+  static const size_t sBatchPlacementSlice;
   static pthread_key_t gPthreadKey;
   /// Current scheduling group for the current thread
   static __thread const FsGroup* tlCurrentGroup;
@@ -1523,6 +1528,36 @@ protected:
       }
     }
 
+    if (applyBooking(tree, bookingSize)) {
+      updateNeeded = true;
+    }
+
+    // do the placement
+    if (g_logging.gLogMask & LOG_MASK(LOG_DEBUG)) {
+      stringstream ss;
+      ss << (*tree);
+      eos_debug("fast tree used for placement is: \n %s", ss.str().c_str());
+    }
+
+    if (updateNeeded) {
+      tree->updateTree();
+    }
+
+    return findNewReplicas(tree, nNewReplicas, newReplicas, startFromNode,
+                           nAdjustCollocatedReplicas, skipSaturated);
+  }
+
+  // ---------------------------------------------------------------------------
+  //! Book the space on a working copy of a placement tree
+  //! A node without enough space is marked unavailable.
+  // @return
+  //   true if the tree needs to be updated before the placement
+  // ---------------------------------------------------------------------------
+  template<class T> static bool applyBooking(T* tree,
+      unsigned long long bookingSize)
+  {
+    bool updateNeeded = false;
+
     if (bookingSize) {
       for (auto it = tree->pFs2Idx->begin(); it != tree->pFs2Idx->end(); it++) {
         // we prebook the space on all the possible nodes before the selection
@@ -1553,17 +1588,19 @@ protected:
       }
     }
 
-    // do the placement
-    if (g_logging.gLogMask & LOG_MASK(LOG_DEBUG)) {
-      stringstream ss;
-      ss << (*tree);
-      eos_debug("fast tree used for placement is: \n %s", ss.str().c_str());
-    }
-
-    if (updateNeeded) {
-      tree->updateTree();
-    }
+    return updateNeeded;
+  }
 
+  // ---------------------------------------------------------------------------
+  //! Select the free slots for the new replicas in a prepared working copy
+  //! of a placement tree
+  // ---------------------------------------------------------------------------
+  template<class T> bool findNewReplicas(T* tree, const size_t& nNewReplicas,
+                                         std::vector<SchedTreeBase::tFastTreeIdx>* newReplicas,
+                                         const SchedTreeBase::tFastTreeIdx& startFromNode,
+                                         const size_t& nAdjustCollocatedReplicas,
+                                         bool skipSaturated)
+  {
     for (size_t k = 0; k < nNewReplicas; k++) {
       SchedTreeBase::tFastTreeIdx idx;
       SchedTreeBase::tFastTreeIdx startidx = (k < nNewReplicas -
@@ -1593,6 +1630,64 @@ protected:
     return true;
   }
 
+  // ---------------------------------------------------------------------------
+  //! Place the new replicas of a file without existing or excluded replicas
+  //! using a base tree which was already booked and sorted once for the
+  //! whole batch. Only the slots are taken on a working copy of the base tree.
+  // ---------------------------------------------------------------------------
+  template<class T> bool placeNewReplicasFromBase(const T* baseTree,
+      const size_t& nNewReplicas,
+      std::vector<SchedTreeBase::tFastTreeIdx>* newReplicas,
+      bool skipSaturated)
+  {
+    if (!tlGeoBuffer) {
+      tlGeoBuffer = tlAlloc(gGeoBufferSize);
+    }
+
+    if (baseTree->copyToBuffer((char*)tlGeoBuffer, gGeoBufferSize)) {
+      eos_crit("could not make a working copy of the fast tree");
+      return false;
+    }
+
+    return findNewReplicas((T*)tlGeoBuffer, nNewReplicas, newReplicas, 0, 0,
+                           skipSaturated);
+  }
+
+  // ---------------------------------------------------------------------------
+  //! Locate preexisting replicas in the fast tree of a group. A replica which
+  //! is not in the group is matched to a fs having the same geotag.
+  //! A read lock is supposed to be acquired on the fast structures.
+  // ---------------------------------------------------------------------------
+  void getExistingReplicasIdx(SchedTME* entry,
+                              const std::vector<eos::common::FileSystem::fsid_t>& existingReplicas,
+                              const std::vector<std::string>* fsidsgeotags,
+                              std::vector<SchedTreeBase::tFastTreeIdx>& existingReplicasIdx);
+
+  // ---------------------------------------------------------------------------
+  //! Translate the placed tree indices to fsids and apply the placement
+  //! penalties to the foreground fast structures.
+  //! A read lock is supposed to be acquired on the fast structures.
+  // ---------------------------------------------------------------------------
+  bool commitNewReplicas(SchedTME* entry,
+                         const std::vector<SchedTreeBase::tFastTreeIdx>& newReplicasIdx,
+                         std::vector<eos::common::FileSystem::fsid_t>* newReplicas);
+
+  // ---------------------------------------------------------------------------
+  //! Insert a file system snapshot into a group. If fs is not NULL, the
+  //! engine subscribes to the updates of its shared hash.
+  // ---------------------------------------------------------------------------
+  bool insertFsIntoGroup(FileSystem* fs,
+                         const eos::common::FileSystem::fs_snapshot_t& fsn,
+                         FsGroup* group, bool updateFastStructures);
+
+  // ---------------------------------------------------------------------------
+  //! Place a slice of a batch in a group. The caller holds a read lock on the
+  //! double buffer of the entry.
+  // ---------------------------------------------------------------------------
+  template<class T> size_t placeBatchSlice(SchedTME* entry, T* placementTree,
+      std::vector<BatchPlacement>& batch, size_t begin, size_t end,
+      bool skipSaturated);
+
   template<class T> unsigned char accessReplicas(SchedTME* entry,
       const size_t& nNewReplicas,
       std::vector<SchedTreeBase::tFastTreeIdx>* accessedReplicas,
@@ -1937,6 +2032,23 @@ public:
   bool insertFsIntoGroup(FileSystem* fs , FsGroup* group,
                          bool updateFastStructures = false);
 
+  // ---------------------------------------------------------------------------
+  //! Insert a file system described by a snapshot into the GeoTreeEngine.
+  //! There is no FileSystem object behind it, so the state of the fs is not
+  //! updated from the shared hash afterwards. This is meant for the tests and
+  //! the benchmarks.
+  // @param fsn
+  //   the snapshot of the file system to be inserted
+  // @param group
+  //   the group the file system belongs to
+  // @param updateFastStructures
+  //   should the fast structures be updated immediately without waiting for the next time frame
+  // @return
+  //   true if success false else
+  // ---------------------------------------------------------------------------
+  bool insertFsIntoGroup(const eos::common::FileSystem::fs_snapshot_t& fsn,
+                         FsGroup* group, bool updateFastStructures = true);
+
   // ---------------------------------------------------------------------------
   //! Remove a file system into the GeoTreeEngine
   // @param fs
@@ -2043,6 +2155,61 @@ public:
                                 std::vector<std::string>* excludeGeoTags = NULL,
                                 std::vector<std::string>* forceGeoTags = NULL);
 
+  //! Input and output of one file placement done by
+  //! placeNewReplicasOneGroupBatch
+  struct BatchPlacement {
+    /// INPUT
+    //! number of replicas to be placed
+    size_t nNewReplicas;
+    //! fsids of preexisting replicas for the file
+    std::vector<eos::common::FileSystem::fsid_t> existingReplicas;
+    //! geotags of the preexisting replicas, same indexing as existingReplicas
+    std::vector<std::string> fsidsgeotags;
+    //! space to be booked on the fs
+    unsigned long long bookingSize;
+    //! try to place the replicas under this geotag
+    std::string startFromGeoTag;
+    //! number of replicas to place as close as possible to startFromGeoTag
+    size_t nCollocatedReplicas;
+    //! fsids to exclude from the placement
+    std::vector<eos::common::FileSystem::fsid_t> excludeFs;
+    //! geotags of the branches to exclude from the placement
+    std::vector<std::string> excludeGeoTags;
+    /// OUTPUT
+    //! fsids of the new replicas in decreasing priority order
+    std::vector<eos::common::FileSystem::fsid_t> newReplicas;
+    //! true if the placement succeeded
+    bool success;
+
+    BatchPlacement(size_t nreplicas = 1, unsigned long long booking = 0):
+      nNewReplicas(nreplicas), bookingSize(booking), nCollocatedReplicas(0),
+      success(false) {}
+  };
+
+  // ---------------------------------------------------------------------------
+  //! Place the replicas of several files in one scheduling group.
+  //! The group lookup and the locking of the fast structures are done once
+  //! per slice of sBatchPlacementSlice files instead of once per file and the
+  //! penalties of each placement are applied before placing the next file, so
+  //! that the result is spread like a sequence of placeNewReplicasOneGroup
+  //! calls. Files without preexisting or excluded replicas (e.g. bulk uploads)
+  //! share a tree which is booked and sorted once per slice and booking size.
+  //! Proxy and firewall entry point scheduling is not supported, use
+  //! placeNewReplicasOneGroup for that.
+  // @param group
+  //   the group to place the replicas in
+  // @param batch
+  //   the files to place, the output members are filled for each of them
+  // @param type
+  //   type of placement to be performed. It can be:
+  //     regularRO, regularRW, balancing or draining
+  // @return
+  //   number of files which could be placed
+  // ---------------------------------------------------------------------------
+  size_t placeNewReplicasOneGroupBatch(FsGroup* group,
+                                       std::vector<BatchPlacement>& batch,
+                                       SchedType type);
+
   // ---------------------------------------------------------------------------
   //! Access several replicas in one scheduling group.
   // @param group
@@ -373,6 +373,7 @@ IConfigEngine::ApplyConfig(XrdOucString& err)
     eos::common::Mapping::gVirtualUidMap.clear();
     eos::common::Mapping::gVirtualGidMap.clear();
     eos::common::Mapping::gAllowedTidentMatches.clear();
+    eos::common::Mapping::InvalidateIdCache();
   }
   Access::Reset();
   {
@@ -611,6 +612,7 @@ IConfigEngine::ResetConfig()
     eos::common::Mapping::gVirtualUidMap.clear();
     eos::common::Mapping::gVirtualGidMap.clear();
     eos::common::Mapping::gAllowedTidentMatches.clear();
+    eos::common::Mapping::InvalidateIdCache();
   }
   Access::Reset();
   gOFS->ResetPathMap();
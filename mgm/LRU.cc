@@ -382,6 +382,7 @@ LRU::AgeExpire(const char* dir,
     try {
       cmd = gOFS->eosView->getContainer(dir);
       std::shared_ptr<eos::IFileMD> fmd;
+      eos::ReadLockGuard children_lock(cmd->getChildrenLock());
       // Loop through all file names
       auto it_begin = cmd->filesBegin();
       auto it_end = cmd->filesEnd();
@@ -645,6 +646,7 @@ LRU::ConvertMatch(const char* dir,
     try {
       cmd = gOFS->eosView->getContainer(dir);
       std::shared_ptr<eos::IFileMD> fmd;
+      eos::ReadLockGuard children_lock(cmd->getChildrenLock());
       auto it_begin = cmd->filesBegin();
       auto it_end = cmd->filesEnd();
 
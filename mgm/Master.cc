@@ -1907,6 +1907,12 @@ Master::BootNamespace()
       contSettings["qdb_flusher_quota"] = instance_name + "_quota";
       fileSettings["qdb_cluster"] = gOFS->mQdbCluster;
       fileSettings["qdb_flusher_md"] = instance_name + "_md";
+
+      // Optional coalescing of the metadata updates towards QuarkDB
+      if (getenv("EOS_NS_QDB_FLUSHER_COALESCE_MS")) {
+        fileSettings["qdb_flusher_coalesce_ms"] =
+          getenv("EOS_NS_QDB_FLUSHER_COALESCE_MS");
+      }
     }
   }
 
@@ -1933,7 +1933,7 @@ Quota::FilePlacement(Scheduler::PlacementArguments* args)
     eos_static_debug("quota is disabled for space=%s", args->spacename->c_str());
   }
 
-  if (!FsView::gFsView.mSpaceGroupView.count(*args->spacename)) {
+  if (!FsView::gFsView.GetSnapshot()->GetGroups(*args->spacename)) {
     eos_static_err("msg=\"no filesystem in space\" space=\"%s\"",
                    args->spacename->c_str());
     args->selected_filesystems->clear();
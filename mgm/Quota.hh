@@ -547,7 +547,8 @@ public:
   //! @return 0 if placement successful, otherwise a non-zero value
   //!         ENOSPC - no space quota defined for current space
   //!         EDQUOT - no quota node found or not enough quota to place
-  //! @warning Must be called with a lock on the FsView::gFsView::ViewMutex
+  //! @note Uses the FsView snapshot, no lock on the FsView::gFsView::ViewMutex
+  //!       is needed
   //----------------------------------------------------------------------------
   static
   int FilePlacement(Scheduler::PlacementArguments* args);
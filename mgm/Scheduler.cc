@@ -24,6 +24,7 @@
 #include "mgm/Scheduler.hh"
 #include "mgm/Quota.hh"
 #include "GeoTreeEngine.hh"
+#include <algorithm>
 
 EOSMGMNAMESPACE_BEGIN
 
@@ -42,15 +43,23 @@ Scheduler::Scheduler() { }
 Scheduler::~Scheduler() { }
 
 //------------------------------------------------------------------------------
-// Write placement routine - the caller routine has to lock via =>
-// eos::common::RWMutexReadLock(FsView::gFsView.ViewMutex)
+// Write placement routine - works on the current FsView snapshot and does not
+// need the FsView::gFsView.ViewMutex
 //------------------------------------------------------------------------------
 int
 Scheduler::FilePlacement(PlacementArguments* args)
 {
   eos_static_debug("requesting file placement from geolocation %s",
                    args->vid->geolocation.c_str());
-  // the caller routine has to lock via => eos::common::RWMutexReadLock(FsView::gFsView.ViewMutex)
+  // The snapshot keeps all the referenced groups alive until we return
+  std::shared_ptr<const FsViewSnapshot> view = FsView::gFsView.GetSnapshot();
+  const FsViewSnapshot::GroupVector* groups = view->GetGroups(*args->spacename);
+
+  if (!groups) {
+    args->selected_filesystems->clear();
+    return ENOSPC;
+  }
+
   std::map<eos::common::FileSystem::fsid_t, float> availablefs;
   std::map<eos::common::FileSystem::fsid_t, std::string> availablefsgeolocation;
   std::list<eos::common::FileSystem::fsid_t> availablevector;
@@ -103,7 +112,7 @@ Scheduler::FilePlacement(PlacementArguments* args)
   }
 
   std::string indextag = lindextag.c_str();
-  std::set<FsGroup*>::const_iterator git;
+  FsViewSnapshot::GroupVector::const_iterator git;
   std::vector<std::string> fsidsgeotags;
   std::vector<FsGroup*> groupsToTry;
 
@@ -114,49 +123,53 @@ Scheduler::FilePlacement(PlacementArguments* args)
                                           0, &groupsToTry)) {
       eos_static_debug("could not retrieve scheduling group for all avoid fsids");
     }
+
+    // Only keep groups which are pinned by our snapshot, the others are being
+    // removed from the view and might be gone any time
+    groupsToTry.erase(std::remove_if(groupsToTry.begin(), groupsToTry.end(),
+    [groups](FsGroup * group) {
+      return !std::binary_search(groups->begin(), groups->end(), group);
+    }), groupsToTry.end());
   }
 
   if (args->forced_scheduling_group_index >= 0) {
-    for (git = FsView::gFsView.mSpaceGroupView[*args->spacename].begin();
-         git != FsView::gFsView.mSpaceGroupView[*args->spacename].end(); ++git) {
+    for (git = groups->begin(); git != groups->end(); ++git) {
       if ((*git)->GetIndex() == (unsigned int) args->forced_scheduling_group_index) {
         break;
       }
     }
 
-    if ((git != FsView::gFsView.mSpaceGroupView[*args->spacename].end()) &&
-        ((*git)->GetIndex() != (unsigned int) args->forced_scheduling_group_index)) {
-      args->selected_filesystems->clear();
-      return ENOSPC;
-    }
-
-    if (git == FsView::gFsView.mSpaceGroupView[*args->spacename].end()) {
+    if (git == groups->end()) {
       args->selected_filesystems->clear();
       return ENOSPC;
     }
   } else {
     XrdSysMutexHelper scope_lock(pMapMutex);
+    auto it_sched = schedulingGroup.find(indextag);
 
-    if (schedulingGroup.count(indextag)) {
-      git = FsView::gFsView.mSpaceGroupView[*args->spacename].find(
-              schedulingGroup[indextag]);
-      schedulingGroup[indextag] = *git;
+    if (it_sched != schedulingGroup.end()) {
+      // The groups are sorted by pointer like the std::set in the FsView. If
+      // the last used group is gone, lower_bound already points to its
+      // successor.
+      git = std::lower_bound(groups->begin(), groups->end(), it_sched->second);
+
+      if ((git != groups->end()) && (*git == it_sched->second)) {
+        git++;
+      }
     } else {
-      git = FsView::gFsView.mSpaceGroupView[*args->spacename].begin();
+      git = groups->begin();
       schedulingGroup[indextag] = *git;
+      git++;
     }
 
-    git++;
-
-    if (git ==  FsView::gFsView.mSpaceGroupView[*args->spacename].end()) {
-      git = FsView::gFsView.mSpaceGroupView[*args->spacename].begin();
+    if (git == groups->end()) {
+      git = groups->begin();
     }
   }
 
   // Rotate scheduling view ptr, remove it from the selection map
   for (unsigned int groupindex = 0;
-       groupindex < FsView::gFsView.mSpaceGroupView[*args->spacename].size() +
-       groupsToTry.size(); groupindex++) {
+       groupindex < groups->size() + groupsToTry.size(); groupindex++) {
     // Rotate scheduling view ptr -  we select a random one
     FsGroup* group = (groupindex < groupsToTry.size() ? groupsToTry[groupindex] :
                       *git);
@@ -203,9 +216,8 @@ Scheduler::FilePlacement(PlacementArguments* args)
     }
 
     if (groupindex >= groupsToTry.size()) {
-      if ((git == FsView::gFsView.mSpaceGroupView[*args->spacename].end()) ||
-          (++git == FsView::gFsView.mSpaceGroupView[*args->spacename].end())) {
-        git = FsView::gFsView.mSpaceGroupView[*args->spacename].begin();
+      if ((git == groups->end()) || (++git == groups->end())) {
+        git = groups->begin();
       }
 
       // remember the last group for that indextag
@@ -227,10 +239,14 @@ Scheduler::FilePlacement(PlacementArguments* args)
 }
 
 //------------------------------------------------------------------------------
-// File access method
+// File access method - works on the current FsView snapshot and does not need
+// the FsView::gFsView.ViewMutex
 //------------------------------------------------------------------------------
 int Scheduler::FileAccess(AccessArguments* args)
 {
+  // The snapshot keeps the groups of the scheduling trees the GeoTreeEngine
+  // looks up for the replicas alive until we return
+  std::shared_ptr<const FsViewSnapshot> view = FsView::gFsView.GetSnapshot();
   size_t nReqStripes = (args->isRW ?
                         eos::common::LayoutId::GetOnlineStripeNumber(args->lid) :
                         eos::common::LayoutId::GetMinOnlineReplica(args->lid));
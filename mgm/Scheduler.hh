@@ -136,7 +136,8 @@ public:
   //! @return 0 if placement successful, otherwise a non-zero value
   //!         ENOSPC - no space quota defined for current space
   //!
-  //! NOTE: Has to be called with a lock on the FsView::gFsView::ViewMutex
+  //! NOTE: Works on the current FsView snapshot (FsView::GetSnapshot) and
+  //! does not need a lock on the FsView::gFsView::ViewMutex
   //----------------------------------------------------------------------------
   static int FilePlacement(PlacementArguments* args);
 
@@ -214,7 +215,8 @@ public:
   //!
   //! @return 0 if successful, otherwise a non-zero value
   //!
-  //! NOTE: Has to be called with a lock on the FsView::gFsView::ViewMutex
+  //! NOTE: Works on the current FsView snapshot (FsView::GetSnapshot) and
+  //! does not need a lock on the FsView::gFsView::ViewMutex
   //----------------------------------------------------------------------------
   static int FileAccess(AccessArguments* args);
 
@@ -223,7 +225,8 @@ protected:
   static XrdSysMutex pMapMutex; //< protect the following scheduling state maps
 
   //! Points to the current scheduling group where to start scheduling =>
-  //! std::string = <grouptag>|<uid>:<gid>
+  //! std::string = <grouptag>|<uid>:<gid>. The group pointer is only used as
+  //! a position in the sorted group list of a snapshot and never dereferenced.
   static std::map<std::string, FsGroup*> schedulingGroup;
 };
 
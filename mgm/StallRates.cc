@@ -0,0 +1,289 @@
+//------------------------------------------------------------------------------
+// File: StallRates.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "mgm/StallRates.hh"
+#include "common/Logging.hh"
+#include "common/Mapping.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+EOSMGMNAMESPACE_BEGIN
+
+constexpr double StallRates::sTolerance;
+constexpr int StallRates::sPeriod;
+
+//------------------------------------------------------------------------------
+// Get the limits of a counter
+//------------------------------------------------------------------------------
+const StallRates::Limits*
+StallRates::Table::Find(const char* tag) const
+{
+  for (auto it = mCounters.begin(); it != mCounters.end(); ++it) {
+    if (!strcmp(it->first.c_str(), tag)) {
+      return &it->second;
+    }
+  }
+
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Replace the rules
+//------------------------------------------------------------------------------
+void
+StallRates::Compile(const std::map<std::string, std::string>& rules,
+                    const std::map<std::string, std::string>& comments)
+{
+  std::shared_ptr<Table> table = std::make_shared<Table>();
+
+  for (auto it = rules.begin(); it != rules.end(); ++it) {
+    bool group;
+    std::string spec;
+
+    if (it->first.find("rate:user:") == 0) {
+      group = false;
+      spec = it->first.substr(strlen("rate:user:"));
+    } else if (it->first.find("rate:group:") == 0) {
+      group = true;
+      spec = it->first.substr(strlen("rate:group:"));
+    } else {
+      continue;
+    }
+
+    size_t pos = spec.rfind(':');
+    double frequency = strtod(it->second.c_str(), 0);
+
+    if ((pos == std::string::npos) || (frequency <= 0)) {
+      eos_static_err("msg=\"ignore invalid rate rule\" rule=\"%s\" value=\"%s\"",
+                     it->first.c_str(), it->second.c_str());
+      continue;
+    }
+
+    std::string name = spec.substr(0, pos);
+    Limits& limits = table->mCounters[spec.substr(pos + 1)];
+    size_t idx = table->mRules.size();
+
+    if (name == "*") {
+      (group ? limits.mAnyGroup : limits.mAnyUser) = idx;
+    } else {
+      int errc = 0;
+
+      if (group) {
+        gid_t gid = eos::common::Mapping::GroupNameToGid(name, errc);
+
+        if (!errc) {
+          limits.mGroups[gid] = idx;
+        }
+      } else {
+        uid_t uid = eos::common::Mapping::UserNameToUid(name, errc);
+
+        if (!errc) {
+          limits.mUsers[uid] = idx;
+        }
+      }
+
+      if (errc) {
+        eos_static_err("msg=\"ignore rate rule for unknown %s\" rule=\"%s\"",
+                       group ? "group" : "user", it->first.c_str());
+        continue;
+      }
+    }
+
+    auto itcomment = comments.find(it->first);
+    table->mRules.push_back({frequency * sTolerance,
+                             (itcomment != comments.end()) ? itcomment->second : ""
+                            });
+  }
+
+  if (table->mRules.empty()) {
+    Clear();
+    return;
+  }
+
+  Install(table);
+}
+
+//------------------------------------------------------------------------------
+// Drop all rules
+//------------------------------------------------------------------------------
+void
+StallRates::Clear()
+{
+  Install(nullptr);
+}
+
+//------------------------------------------------------------------------------
+// Install a table in all the shards and reset their state
+//------------------------------------------------------------------------------
+void
+StallRates::Install(const std::shared_ptr<const Table>& table)
+{
+  std::shared_ptr<const Table> current = std::atomic_load(&mTable);
+
+  // The stall configuration is stored again on every access change, keep
+  // the buckets and holds as long as the rules stay the same
+  if ((current == table) || (current && table && (*current == *table))) {
+    return;
+  }
+
+  std::atomic_store(&mTable, table);
+
+  for (size_t i = 0; i < sNumShards; ++i) {
+    std::lock_guard<std::mutex> lock(mShards[i].mMutex);
+    mShards[i].mTable = table;
+    mShards[i].mBuckets.clear();
+    mShards[i].mHolds.clear();
+  }
+
+  mEnabled.store(table != nullptr, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+// Account operations of a client
+//------------------------------------------------------------------------------
+void
+StallRates::Consume(const char* tag, uid_t uid, gid_t gid, unsigned long val,
+                    Clock::time_point now)
+{
+  if (!Enabled()) {
+    return;
+  }
+
+  std::shared_ptr<const Table> table = std::atomic_load(&mTable);
+  const Limits* limits = (table ? table->Find(tag) : nullptr);
+
+  if (!limits) {
+    return;
+  }
+
+  for (bool group : {
+         false, true
+       }) {
+    size_t rule = Limits::sNone;
+    size_t any_rule = (group ? limits->mAnyGroup : limits->mAnyUser);
+
+    if (group) {
+      auto it = limits->mGroups.find(gid);
+
+      if (it != limits->mGroups.end()) {
+        rule = it->second;
+      }
+    } else {
+      auto it = limits->mUsers.find(uid);
+
+      if (it != limits->mUsers.end()) {
+        rule = it->second;
+      }
+    }
+
+    if ((rule == Limits::sNone) && (any_rule == Limits::sNone)) {
+      continue;
+    }
+
+    uint64_t identity = Identity(group, group ? gid : uid);
+    Shard& shard = GetShard(identity);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+
+    // The rules were replaced meanwhile, the operation no longer counts
+    if (shard.mTable != table) {
+      continue;
+    }
+
+    if (rule != Limits::sNone) {
+      Take(shard, *table, identity, rule, val, now);
+    }
+
+    if (any_rule != Limits::sNone) {
+      Take(shard, *table, identity, any_rule, val, now);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Take tokens from the bucket of an identity for a rule
+//------------------------------------------------------------------------------
+void
+StallRates::Take(Shard& shard, const Table& table, uint64_t identity,
+                 size_t rule, unsigned long val, Clock::time_point now)
+{
+  double rate = table.mRules[rule].mRate;
+  double burst = rate * sPeriod;
+  uint64_t key = ((uint64_t) rule << 33) | identity;
+  auto it = shard.mBuckets.find(key);
+
+  if (it == shard.mBuckets.end()) {
+    it = shard.mBuckets.emplace(key, Bucket{burst, now}).first;
+  }
+
+  Bucket& bucket = it->second;
+
+  if (now > bucket.mLast) {
+    std::chrono::duration<double> elapsed = now - bucket.mLast;
+    bucket.mTokens = std::min(burst, bucket.mTokens + elapsed.count() * rate);
+    bucket.mLast = now;
+  }
+
+  bucket.mTokens -= val;
+
+  if (bucket.mTokens < 0) {
+    // Rate exceeded - the client is stalled while the bucket refills
+    Hold& hold = shard.mHolds[identity];
+    hold.mUntil = now + std::chrono::seconds(sPeriod);
+    hold.mRule = rule;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Check if a client is held because it exceeded a rate
+//------------------------------------------------------------------------------
+bool
+StallRates::IsLimited(uid_t uid, gid_t gid, std::string& comment,
+                      Clock::time_point now)
+{
+  if (!Enabled()) {
+    return false;
+  }
+
+  for (uint64_t identity : {
+         Identity(false, uid), Identity(true, gid)
+       }) {
+    Shard& shard = GetShard(identity);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto it = shard.mHolds.find(identity);
+
+    if (it == shard.mHolds.end()) {
+      continue;
+    }
+
+    if (it->second.mUntil > now) {
+      comment = shard.mTable->mRules[it->second.mRule].mComment;
+      return true;
+    }
+
+    shard.mHolds.erase(it);
+  }
+
+  return false;
+}
+
+EOSMGMNAMESPACE_END
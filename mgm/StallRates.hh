@@ -0,0 +1,220 @@
+//------------------------------------------------------------------------------
+//! @file StallRates.hh
+//! @brief Token buckets enforcing the user and group rate stall rules
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __EOSMGM_STALLRATES__HH__
+#define __EOSMGM_STALLRATES__HH__
+
+#include "mgm/Namespace.hh"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+EOSMGMNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Compiled form of the 'rate:{user,group}:{name,*}:<counter>' stall rules.
+//!
+//! Every rule gets a token bucket per user or group it applies to, refilled
+//! at the configured frequency (plus the usual tolerance) and holding
+//! sPeriod seconds worth of tokens. Counting an operation takes tokens from
+//! the buckets of the caller, an empty bucket holds the user or group for
+//! sPeriod seconds. A stall decision is then a lookup of the hold of the
+//! user and of the group instead of evaluating the rolling averages of all
+//! the rules.
+//!
+//! The state is split in shards by identity so that concurrent clients
+//! rarely take the same lock. The rules themselves are an immutable table
+//! looked up without any lock, so operations without a rule never lock.
+//------------------------------------------------------------------------------
+class StallRates
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  //! Tolerance applied on top of the configured frequency
+  static constexpr double sTolerance = 1.33;
+
+  //! Period in seconds the frequency is averaged over and the stall time
+  static constexpr int sPeriod = 5;
+
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  StallRates(): mEnabled(false) {}
+
+  //----------------------------------------------------------------------------
+  //! Replace the rules - all buckets start full and all holds are dropped,
+  //! unless the compiled rules are the same as the current ones
+  //!
+  //! @param rules stall rules, only the 'rate:' ones are used
+  //! @param comments stall comments by rule
+  //----------------------------------------------------------------------------
+  void Compile(const std::map<std::string, std::string>& rules,
+               const std::map<std::string, std::string>& comments);
+
+  //----------------------------------------------------------------------------
+  //! Drop all rules
+  //----------------------------------------------------------------------------
+  void Clear();
+
+  //----------------------------------------------------------------------------
+  //! Check if there is any rule
+  //----------------------------------------------------------------------------
+  inline bool Enabled() const
+  {
+    return mEnabled.load(std::memory_order_relaxed);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Account operations of a client
+  //!
+  //! @param tag counter name as used in the statistics
+  //! @param uid user id of the client
+  //! @param gid group id of the client
+  //! @param val number of operations
+  //! @param now current time
+  //----------------------------------------------------------------------------
+  void Consume(const char* tag, uid_t uid, gid_t gid, unsigned long val,
+               Clock::time_point now = Clock::now());
+
+  //----------------------------------------------------------------------------
+  //! Check if a client is held because it exceeded a rate
+  //!
+  //! @param uid user id of the client
+  //! @param gid group id of the client
+  //! @param comment set to the comment of the exceeded rule
+  //! @param now current time
+  //!
+  //! @return true if the client has to be stalled
+  //----------------------------------------------------------------------------
+  bool IsLimited(uid_t uid, gid_t gid, std::string& comment,
+                 Clock::time_point now = Clock::now());
+
+private:
+  //! Compiled rule
+  struct Rule {
+    double mRate; ///< tokens per second
+    std::string mComment;
+
+    bool operator==(const Rule& other) const
+    {
+      return (mRate == other.mRate) && (mComment == other.mComment);
+    }
+  };
+
+  //! Rules applying to one counter, by index in Table::mRules
+  struct Limits {
+    static constexpr size_t sNone = (size_t) -1;
+    std::unordered_map<uid_t, size_t> mUsers;
+    std::unordered_map<gid_t, size_t> mGroups;
+    size_t mAnyUser = sNone;
+    size_t mAnyGroup = sNone;
+
+    bool operator==(const Limits& other) const
+    {
+      return (mUsers == other.mUsers) && (mGroups == other.mGroups) &&
+             (mAnyUser == other.mAnyUser) && (mAnyGroup == other.mAnyGroup);
+    }
+  };
+
+  //! Immutable set of compiled rules shared by all the shards
+  struct Table {
+    std::vector<Rule> mRules;
+    std::unordered_map<std::string, Limits> mCounters;
+
+    //--------------------------------------------------------------------------
+    //! Get the limits of a counter - the counters with rules are few, a scan
+    //! avoids building a key for every operation
+    //!
+    //! @return limits or nullptr if no rule applies to the counter
+    //--------------------------------------------------------------------------
+    const Limits* Find(const char* tag) const;
+
+    bool operator==(const Table& other) const
+    {
+      return (mRules == other.mRules) && (mCounters == other.mCounters);
+    }
+  };
+
+  struct Bucket {
+    double mTokens;
+    Clock::time_point mLast; ///< time of the last refill
+  };
+
+  struct Hold {
+    Clock::time_point mUntil;
+    size_t mRule;
+  };
+
+  //! State of the identities hashed to the same shard
+  struct Shard {
+    std::mutex mMutex;
+    std::shared_ptr<const Table> mTable;
+    //! Buckets by identity and rule
+    std::unordered_map<uint64_t, Bucket> mBuckets;
+    //! Holds by identity
+    std::unordered_map<uint64_t, Hold> mHolds;
+  };
+
+  static constexpr size_t sNumShards = 64;
+  std::atomic<bool> mEnabled;
+  //! Current table, accessed with std::atomic_load/std::atomic_store
+  std::shared_ptr<const Table> mTable;
+  Shard mShards[sNumShards];
+
+  //----------------------------------------------------------------------------
+  //! Key of a user or group identity
+  //----------------------------------------------------------------------------
+  static inline uint64_t Identity(bool group, uint32_t id)
+  {
+    return ((uint64_t) group << 32) | id;
+  }
+
+  inline Shard& GetShard(uint64_t identity)
+  {
+    return mShards[(identity ^ (identity >> 32)) % sNumShards];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take tokens from the bucket of an identity for a rule and hold the
+  //! identity if the bucket runs empty - called with the shard mutex held
+  //----------------------------------------------------------------------------
+  void Take(Shard& shard, const Table& table, uint64_t identity, size_t rule,
+            unsigned long val, Clock::time_point now);
+
+  //----------------------------------------------------------------------------
+  //! Install a table in all the shards and reset their state - nothing is
+  //! done if the table has the same rules as the current one
+  //----------------------------------------------------------------------------
+  void Install(const std::shared_ptr<const Table>& table);
+};
+
+EOSMGMNAMESPACE_END
+
+#endif
@@ -24,24 +24,42 @@
 #include "common/Mapping.hh"
 #include "mgm/TableFormatter/TableFormatterBase.hh"
 #include "mgm/Stat.hh"
+#include "mgm/Access.hh"
 #include "mgm/FsView.hh"
 #include "mgm/XrdMgmOfs.hh"
 #include "mq/XrdMqSharedObject.hh"
 #include "mgm/Quota.hh"
 #include "XrdOuc/XrdOucString.hh"
+#include <thread>
 
 EOSMGMNAMESPACE_BEGIN
 
+//------------------------------------------------------------------------------
+// Get the shard used by the calling thread
+//------------------------------------------------------------------------------
+Stat::Shard&
+Stat::GetShard()
+{
+  static thread_local size_t shard_idx =
+    std::hash<std::thread::id>()(std::this_thread::get_id()) % sNumShards;
+  return mShards[shard_idx];
+}
+
 /*----------------------------------------------------------------------------*/
 void
 Stat::Add(const char* tag, uid_t uid, gid_t gid, unsigned long val)
 {
-  Mutex.Lock();
-  StatsUid[tag][uid] += val;
-  StatsGid[tag][gid] += val;
-  StatAvgUid[tag][uid].Add(val);
-  StatAvgGid[tag][gid].Add(val);
-  Mutex.UnLock();
+  // Take the tokens of the rate stall rules for this counter
+  Access::gStallRates.Consume(tag, uid, gid, val);
+  time_t now = time(0);
+  Shard& shard = GetShard();
+  XrdSysMutexHelper scope_lock(shard.mMutex);
+  StatDelta& udelta = shard.mUid[tag][uid];
+  udelta.mVal += val;
+  udelta.mTime = now;
+  StatDelta& gdelta = shard.mGid[tag][gid];
+  gdelta.mVal += val;
+  gdelta.mTime = now;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -49,25 +67,112 @@ void
 Stat::AddExt(const char* tag, uid_t uid, gid_t gid, unsigned long nsample,
              const double& avgv, const double& minv, const double& maxv)
 {
-  Mutex.Lock();
-  StatExtUid[tag][uid].Insert(nsample, avgv, minv, maxv);
-  StatExtGid[tag][gid].Insert(nsample, avgv, minv, maxv);
-  Mutex.UnLock();
+  time_t now = time(0);
+  Shard& shard = GetShard();
+  XrdSysMutexHelper scope_lock(shard.mMutex);
+
+  for (StatExtDelta* delta : {
+         &shard.mExtUid[tag][uid], &shard.mExtGid[tag][gid]
+       }) {
+    if (delta->mTime == 0) {
+      delta->mMin = minv;
+      delta->mMax = maxv;
+    } else {
+      delta->mMin = std::min(delta->mMin, minv);
+      delta->mMax = std::max(delta->mMax, maxv);
+    }
+
+    delta->mN += nsample;
+    delta->mSum += avgv * nsample;
+    delta->mTime = now;
+  }
 }
 
 /*----------------------------------------------------------------------------*/
 void
 Stat::AddExec(const char* tag, float exectime)
 {
-  Mutex.Lock();
-  StatExec[tag].push_back(exectime);
-
-  // we average over 100 entries
-  if (StatExec[tag].size() > 100) {
-    StatExec[tag].pop_front();
+  Shard& shard = GetShard();
+  XrdSysMutexHelper scope_lock(shard.mMutex);
+  std::vector<float>& samples = shard.mExec[tag];
+  samples.push_back(exectime);
+
+  // only the last 100 entries are kept in StatExec anyway
+  if (samples.size() > 200) {
+    samples.erase(samples.begin(), samples.end() - 100);
   }
+}
 
-  Mutex.UnLock();
+//------------------------------------------------------------------------------
+// Fold the pending updates of all shards into the maps
+//------------------------------------------------------------------------------
+void
+Stat::Drain()
+{
+  for (size_t i = 0; i < sNumShards; ++i) {
+    Shard pending;
+    {
+      // swap out the pending updates so that writers are blocked only briefly
+      XrdSysMutexHelper scope_lock(mShards[i].mMutex);
+      pending.mUid.swap(mShards[i].mUid);
+      pending.mGid.swap(mShards[i].mGid);
+      pending.mExtUid.swap(mShards[i].mExtUid);
+      pending.mExtGid.swap(mShards[i].mExtGid);
+      pending.mExec.swap(mShards[i].mExec);
+    }
+
+    for (auto tit = pending.mUid.begin(); tit != pending.mUid.end(); ++tit) {
+      auto& stats = StatsUid[tit->first];
+      auto& avgs = StatAvgUid[tit->first];
+
+      for (auto it = tit->second.begin(); it != tit->second.end(); ++it) {
+        stats[it->first] += it->second.mVal;
+        avgs[it->first].Add(it->second.mVal, it->second.mTime);
+      }
+    }
+
+    for (auto tit = pending.mGid.begin(); tit != pending.mGid.end(); ++tit) {
+      auto& stats = StatsGid[tit->first];
+      auto& avgs = StatAvgGid[tit->first];
+
+      for (auto it = tit->second.begin(); it != tit->second.end(); ++it) {
+        stats[it->first] += it->second.mVal;
+        avgs[it->first].Add(it->second.mVal, it->second.mTime);
+      }
+    }
+
+    for (auto tit = pending.mExtUid.begin(); tit != pending.mExtUid.end();
+         ++tit) {
+      auto& exts = StatExtUid[tit->first];
+
+      for (auto it = tit->second.begin(); it != tit->second.end(); ++it) {
+        const StatExtDelta& delta = it->second;
+        exts[it->first].InsertSum(delta.mN, delta.mSum, delta.mMin, delta.mMax,
+                                  delta.mTime);
+      }
+    }
+
+    for (auto tit = pending.mExtGid.begin(); tit != pending.mExtGid.end();
+         ++tit) {
+      auto& exts = StatExtGid[tit->first];
+
+      for (auto it = tit->second.begin(); it != tit->second.end(); ++it) {
+        const StatExtDelta& delta = it->second;
+        exts[it->first].InsertSum(delta.mN, delta.mSum, delta.mMin, delta.mMax,
+                                  delta.mTime);
+      }
+    }
+
+    for (auto tit = pending.mExec.begin(); tit != pending.mExec.end(); ++tit) {
+      std::deque<float>& exec = StatExec[tit->first];
+      exec.insert(exec.end(), tit->second.begin(), tit->second.end());
+
+      // we average over 100 entries
+      while (exec.size() > 100) {
+        exec.pop_front();
+      }
+    }
+  }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -115,19 +220,17 @@ double
 Stat::GetTotalNExt3600(const char* tag)
 {
   google::sparse_hash_map<uid_t, StatExt>::iterator it;
-  unsigned long n = 0;
+  double n = 0;
 
   if (!StatExtUid.count(tag)) {
     return 0;
   }
 
   for (it = StatExtUid[tag].begin(); it != StatExtUid[tag].end(); ++it) {
-    for (int i = 0; i < 3600; i++) {
-      n += it->second.n3600[i];
-    }
+    n += it->second.GetN3600();
   }
 
-  return (double) n;
+  return n;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -145,12 +248,7 @@ Stat::GetTotalAvgExt3600(const char* tag)
   }
 
   for (it = StatExtUid[tag].begin(); it != StatExtUid[tag].end(); ++it) {
-    double w = 0;
-
-    for (int i = 0; i < 3600; i++) {
-      w += it->second.n3600[i];
-    }
-
+    double w = it->second.GetN3600();
     totw += w;
     val += it->second.GetAvg3600() * w;
   }
@@ -225,19 +323,17 @@ double
 Stat::GetTotalNExt300(const char* tag)
 {
   google::sparse_hash_map<uid_t, StatExt>::iterator it;
-  unsigned long n = 0;
+  double n = 0;
 
   if (!StatExtUid.count(tag)) {
     return 0;
   }
 
   for (it = StatExtUid[tag].begin(); it != StatExtUid[tag].end(); ++it) {
-    for (int i = 0; i < 300; i++) {
-      n += it->second.n300[i];
-    }
+    n += it->second.GetN300();
   }
 
-  return (double) n;
+  return n;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -255,12 +351,7 @@ Stat::GetTotalAvgExt300(const char* tag)
   }
 
   for (it = StatExtUid[tag].begin(); it != StatExtUid[tag].end(); ++it) {
-    double w = 0;
-
-    for (int i = 0; i < 300; i++) {
-      w += it->second.n300[i];
-    }
-
+    double w = it->second.GetN300();
     totw += w;
     val += it->second.GetAvg300() * w;
   }
@@ -336,19 +427,17 @@ double
 Stat::GetTotalNExt60(const char* tag)
 {
   google::sparse_hash_map<uid_t, StatExt>::iterator it;
-  unsigned long n = 0;
+  double n = 0;
 
   if (!StatExtUid.count(tag)) {
     return 0;
   }
 
   for (it = StatExtUid[tag].begin(); it != StatExtUid[tag].end(); ++it) {
-    for (int i = 0; i < 60; i++) {
-      n += it->second.n60[i];
-    }
+    n += it->second.GetN60();
   }
 
-  return (double) n;
+  return n;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -366,12 +455,7 @@ Stat::GetTotalAvgExt60(const char* tag)
   }
 
   for (it = StatExtUid[tag].begin(); it != StatExtUid[tag].end(); ++it) {
-    double w = 0;
-
-    for (int i = 0; i < 60; i++) {
-      w += it->second.n60[i];
-    }
-
+    double w = it->second.GetN60();
     totw += w;
     val += it->second.GetAvg60() * w;
   }
@@ -447,19 +531,17 @@ double
 Stat::GetTotalNExt5(const char* tag)
 {
   google::sparse_hash_map<uid_t, StatExt>::iterator it;
-  unsigned long n = 0;
+  double n = 0;
 
   if (!StatExtUid.count(tag)) {
     return 0;
   }
 
   for (it = StatExtUid[tag].begin(); it != StatExtUid[tag].end(); ++it) {
-    for (int i = 0; i < 5; i++) {
-      n += it->second.n5[i];
-    }
+    n += it->second.GetN5();
   }
 
-  return (double) n;
+  return n;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -477,12 +559,7 @@ Stat::GetTotalAvgExt5(const char* tag)
   }
 
   for (it = StatExtUid[tag].begin(); it != StatExtUid[tag].end(); ++it) {
-    double w = 0;
-
-    for (int i = 0; i < 5; i++) {
-      w += it->second.n5[i];
-    }
-
+    double w = it->second.GetN5();
     totw += w;
     val += it->second.GetAvg5() * w;
   }
@@ -613,6 +690,7 @@ void
 Stat::Clear()
 {
   Mutex.Lock();
+  Drain();
   google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, unsigned long long> >::iterator
   ittag;
 
@@ -637,6 +715,7 @@ Stat::PrintOutTotal(XrdOucString& out, bool details, bool monitoring,
                     bool numerical)
 {
   Mutex.Lock();
+  Drain();
   std::vector<std::string> tags, tags_ext;
   std::vector<std::string>::iterator it;
   google::sparse_hash_map < std::string,
@@ -1234,49 +1313,10 @@ Stat::Circulate()
     l2 = l2tmp;
     l3 = l3tmp;
     // --------------------------------------------
+    // fold the per-thread updates into the maps, the rolling windows expire
+    // old bins by themselves
     Mutex.Lock();
-    google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, StatAvg> >::iterator
-    tit;
-    google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, StatExt> >::iterator
-    tit_ext;
-
-    // loop over tags
-    for (tit = StatAvgUid.begin(); tit != StatAvgUid.end(); ++tit) {
-      // loop over vids
-      google::sparse_hash_map<uid_t, StatAvg>::iterator it;
-
-      for (it = tit->second.begin(); it != tit->second.end(); ++it) {
-        it->second.StampZero();
-      }
-    }
-
-    for (tit = StatAvgGid.begin(); tit != StatAvgGid.end(); ++tit) {
-      // loop over vids
-      google::sparse_hash_map<uid_t, StatAvg>::iterator it;
-
-      for (it = tit->second.begin(); it != tit->second.end(); ++it) {
-        it->second.StampZero();
-      }
-    }
-
-    for (tit_ext = StatExtGid.begin(); tit_ext != StatExtGid.end(); ++tit_ext) {
-      // loop over vids
-      google::sparse_hash_map<uid_t, StatExt>::iterator it;
-
-      for (it = tit_ext->second.begin(); it != tit_ext->second.end(); ++it) {
-        it->second.StampZero();
-      }
-    }
-
-    for (tit_ext = StatExtGid.begin(); tit_ext != StatExtGid.end(); ++tit_ext) {
-      // loop over vids
-      google::sparse_hash_map<uid_t, StatExt>::iterator it;
-
-      for (it = tit_ext->second.begin(); it != tit_ext->second.end(); ++it) {
-        it->second.StampZero();
-      }
-    }
-
+    Drain();
     Mutex.UnLock();
   }
 }
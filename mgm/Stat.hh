@@ -35,415 +35,314 @@
 #include <map>
 #include <string>
 #include <deque>
+#include <algorithm>
+#include <limits>
 #include <math.h>
+#include <time.h>
 
 EOSMGMNAMESPACE_BEGIN
 
-class StatAvg
+//------------------------------------------------------------------------------
+//! Ring of time buckets each covering 'Resolution' seconds. Buckets are reset
+//! lazily when time advances so no periodic stamping is needed and a bucket
+//! which is not updated any more simply ages out of the window.
+//------------------------------------------------------------------------------
+template<typename BinT, unsigned int Resolution, unsigned int Bins>
+class StatRing
 {
 public:
-  unsigned long avg3600[3600];
-  unsigned long avg300[300];
-  unsigned long avg60[60];
-  unsigned long avg5[5];
-
-  StatAvg ()
+  StatRing (): mLast(-1) { }
+
+  //----------------------------------------------------------------------------
+  //! Get bin for the given time, advancing the ring if needed
+  //!
+  //! @return bin pointer or nullptr if time is older than the ring
+  //----------------------------------------------------------------------------
+  BinT*
+  GetBin (int64_t now)
   {
-    memset (avg3600, 0, sizeof (avg3600));
-    memset (avg300, 0, sizeof (avg300));
-    memset (avg60, 0, sizeof (avg60));
-    memset (avg5, 0, sizeof (avg5));
-  }
+    int64_t bucket = now / Resolution;
 
-  ~StatAvg () { };
+    if (bucket > mLast) {
+      int64_t from = std::max(mLast + 1, bucket - (int64_t) Bins + 1);
 
-  void
-  Add (unsigned long val)
-  {
-    int64_t time_val = time(0);
+      for (int64_t b = from; b <= bucket; ++b) {
+        mBins[b % Bins].Reset();
+      }
 
-    if (time_val < 0) {
-      time_val = 0;
+      mLast = bucket;
+    } else if (bucket <= mLast - (int64_t) Bins) {
+      return nullptr;
     }
 
-    unsigned int bin3600 = time_val % 3600;
-    unsigned int bin300 = time_val % 300;
-    unsigned int bin60 = time_val % 60;
-    unsigned int bin5 = time_val % 5;
-
-    avg3600[(bin3600 + 1) % 3600] = 0;
-    avg3600[bin3600] += val;
-    avg300[(bin300 + 1) % 300] = 0;
-    avg300[bin300] += val;
-    avg60[(bin60 + 1) % 60] = 0;
-    avg60[bin60] += val;
-    avg5[(bin5 + 1) % 5] = 0;
-    avg5[bin5] += val;
+    return &mBins[bucket % Bins];
   }
 
+  //----------------------------------------------------------------------------
+  //! Call 'fn(bin, weight)' for every bin inside the window covering the
+  //! seconds [now - window + 2, now]. The weight is the fraction of the bin
+  //! falling into the window assuming a uniform distribution inside the bin.
+  //----------------------------------------------------------------------------
+  template<typename Fn>
   void
-  StampZero ()
+  ForEach (int64_t now, unsigned int window, Fn fn) const
   {
-    int64_t time_val = time(0);
+    int64_t start = now - window + 2;
 
-    if (time_val < 0) {
-      time_val = 0;
+    if (start < 0) {
+      start = 0;
     }
 
-    unsigned int bin3600 = time_val % 3600;
-    unsigned int bin300 = time_val % 300;
-    unsigned int bin60 = time_val % 60;
-    unsigned int bin5 = time_val % 5;
-
-    avg3600[(bin3600 + 1) % 3600] = 0;
-    avg300[(bin300 + 1) % 300] = 0;
-    avg60[(bin60 + 1) % 60] = 0;
-    avg5[(bin5 + 1) % 5] = 0;
-  }
-
-  double
-  GetAvg3600 ()
-  {
-    double sum = 0;
-    for (int i = 0; i < 3600; i++)
-      sum += avg3600[i];
-    return (sum / 3599);
-  }
+    for (int64_t b = start / Resolution; b <= now / Resolution; ++b) {
+      if ((b > mLast) || (b <= mLast - (int64_t) Bins)) {
+        continue;
+      }
 
-  double
-  GetAvg300 ()
-  {
-    double sum = 0;
-    for (int i = 0; i < 300; i++)
-      sum += avg300[i];
-    return (sum / 299);
-  }
-
-  double
-  GetAvg60 ()
-  {
-    double sum = 0;
-    for (int i = 0; i < 60; i++)
-      sum += avg60[i];
-    return (sum / 59);
+      int64_t lo = std::max(b * (int64_t) Resolution, start);
+      int64_t hi = b * (int64_t) Resolution + Resolution - 1;
+      fn(mBins[b % Bins], (double)(hi - lo + 1) / Resolution);
+    }
   }
 
-  double
-  GetAvg5 ()
-  {
-    double sum = 0;
-    for (int i = 0; i < 5; i++)
-      sum += avg5[i];
-    return (sum / 4);
-  }
+private:
+  BinT mBins[Bins];
+  int64_t mLast; ///< most recent bucket index (time / Resolution)
 };
 
-class StatExt
+//------------------------------------------------------------------------------
+//! Rolling windows of 5s, 1min, 5min and 1h. The short windows use one second
+//! bins, the 5min and 1h windows use 5s and 60s bins respectively.
+//------------------------------------------------------------------------------
+template<typename BinT>
+class StatWindows
 {
 public:
-  unsigned long n3600[3600];
-  unsigned long n300[300];
-  unsigned long n60[60];
-  unsigned long n5[5];
-  double sum3600[3600];
-  double sum300[300];
-  double sum60[60];
-  double sum5[5];
-  double min3600[3600];
-  double min300[300];
-  double min60[60];
-  double min5[5];
-  double max3600[3600];
-  double max300[300];
-  double max60[60];
-  double max5[5];
-
-  StatExt ()
+  void
+  Update (int64_t now, const BinT& val)
   {
-    memset (n3600, 0, sizeof (n3600));
-    memset (n300, 0, sizeof (n300));
-    memset (n60, 0, sizeof (n60));
-    memset (n5, 0, sizeof (n5));
-    for (int k = 0; k < 3600; k++)
-    {
-      min3600[k] = std::numeric_limits<long long>::max ();
-      max3600[k] = std::numeric_limits<size_t>::min ();
-      sum3600[k] = 0;
-    }
-    for (int k = 0; k < 300; k++)
-    {
-      min300[k] = std::numeric_limits<long long>::max ();
-      max300[k] = std::numeric_limits<size_t>::min ();
-      sum300[k] = 0;
+    BinT* bin;
+
+    if ((bin = mRing1.GetBin(now))) {
+      bin->Merge(val);
     }
-    for (int k = 0; k < 60; k++)
-    {
-      min60[k] = std::numeric_limits<long long>::max ();
-      max60[k] = std::numeric_limits<size_t>::min ();
-      sum60[k] = 0;
+
+    if ((bin = mRing5.GetBin(now))) {
+      bin->Merge(val);
     }
-    for (int k = 0; k < 5; k++)
-    {
-      min5[k] = std::numeric_limits<long long>::max ();
-      max5[k] = std::numeric_limits<size_t>::min ();
-      sum5[k] = 0;
+
+    if ((bin = mRing60.GetBin(now))) {
+      bin->Merge(val);
     }
   }
 
-  ~StatExt () { };
-
+  template<typename Fn>
   void
-  Insert (unsigned long nsample, const double &avgv, const double &minv, const double &maxv)
+  ForEach (unsigned int window, Fn fn) const
   {
-    int64_t time_val = time(0);
+    int64_t now = time(0);
 
-    if (time_val < 0) {
-      time_val = 0;
+    if (now < 0) {
+      now = 0;
     }
 
-    unsigned int bin3600 = time_val % 3600;
-    unsigned int bin300 = time_val % 300;
-    unsigned int bin60 = time_val % 60;
-    unsigned int bin5 = time_val % 5;
-    n3600[(bin3600 + 1) % 3600] = 0;
-    n3600[bin3600] += nsample;
-    sum3600[(bin3600 + 1) % 3600] = 0;
-    sum3600[bin3600] += avgv*nsample;
-    min3600[(bin3600 + 1) % 3600] = std::numeric_limits<long long>::max ();
-    min3600[bin3600] = std::min (min3600[bin3600], minv);
-    max3600[(bin3600 + 1) % 3600] = std::numeric_limits<size_t>::min ();
-    max3600[bin3600] = std::max (max3600[bin3600], maxv);
-
-    n300[(bin300 + 1) % 300] = 0;
-    n300[bin300] += nsample;
-    sum300[(bin300 + 1) % 300] = 0;
-    sum300[bin300] += avgv*nsample;
-    min300[(bin300 + 1) % 300] = std::numeric_limits<long long>::max ();
-    min300[bin300] = std::min (min300[bin300], minv);
-    max300[(bin300 + 1) % 300] = std::numeric_limits<size_t>::min ();
-    max300[bin300] = std::max (max300[bin300], maxv);
-
-    n60[(bin60 + 1) % 60] = 0;
-    n60[bin60] += nsample;
-    sum60[(bin60 + 1) % 60] = 0;
-    sum60[bin60] += avgv*nsample;
-    min60[(bin60 + 1) % 60] = std::numeric_limits<long long>::max ();
-    min60[bin60] = std::min (min60[bin60], minv);
-    max60[(bin60 + 1) % 60] = std::numeric_limits<size_t>::min ();
-    max60[bin60] = std::max (max60[bin60], maxv);
-
-    n5[(bin5 + 1) % 5] = 0;
-    n5[bin5] += nsample;
-    sum5[(bin5 + 1) % 5] = 0;
-    sum5[bin5] += avgv*nsample;
-    min5[(bin5 + 1) % 5] = std::numeric_limits<long long>::max ();
-    min5[bin5] = std::min (min5[bin5], minv);
-    max5[(bin5 + 1) % 5] = std::numeric_limits<size_t>::min ();
-    max5[bin5] = std::max (max5[bin5], maxv);
+    if (window <= 60) {
+      mRing1.ForEach(now, window, fn);
+    } else if (window <= 300) {
+      mRing5.ForEach(now, window, fn);
+    } else {
+      mRing60.ForEach(now, window, fn);
+    }
   }
 
-  void
-  StampZero ()
-  {
-    int64_t time_val = time(0);
+private:
+  StatRing<BinT, 1, 60> mRing1;
+  StatRing<BinT, 5, 62> mRing5;
+  StatRing<BinT, 60, 62> mRing60;
+};
 
-    if (time_val < 0) {
-      time_val = 0;
-    }
+//------------------------------------------------------------------------------
+//! Counter bin
+//------------------------------------------------------------------------------
+struct StatAvgBin {
+  unsigned long mVal;
 
-    unsigned int bin3600 = time_val % 3600;
-    unsigned int bin300 = time_val % 300;
-    unsigned int bin60 = time_val % 60;
-    unsigned int bin5 = time_val % 5;
-    n3600[(bin3600 + 1) % 3600] = 0;
-    n300[(bin300 + 1) % 300] = 0;
-    n60[(bin60 + 1) % 60] = 0;
-    n5[(bin5 + 1) % 5] = 0;
-    sum3600[(bin3600 + 1) % 3600] = 0;
-    sum300[(bin300 + 1) % 300] = 0;
-    sum60[(bin60 + 1) % 60] = 0;
-    sum5[(bin5 + 1) % 5] = 0;
-    min3600[(bin3600 + 1) % 3600] = std::numeric_limits<long long>::max ();
-    min300[(bin300 + 1) % 300] = std::numeric_limits<long long>::max ();
-    min60[(bin60 + 1) % 60] = std::numeric_limits<long long>::max ();
-    min5[(bin5 + 1) % 5] = std::numeric_limits<long long>::max ();
-    max3600[(bin3600 + 1) % 3600] = std::numeric_limits<size_t>::min ();
-    max300[(bin300 + 1) % 300] = std::numeric_limits<size_t>::min ();
-    max60[(bin60 + 1) % 60] = std::numeric_limits<size_t>::min ();
-    max5[(bin5 + 1) % 5] = std::numeric_limits<size_t>::min ();
+  StatAvgBin (unsigned long val = 0): mVal(val) { }
+
+  void
+  Reset ()
+  {
+    mVal = 0;
   }
 
-  double
-  GetN3600 ()
+  void
+  Merge (const StatAvgBin& other)
   {
-    unsigned long sum = 0;
-    for (int i = 0; i < 3600; i++)
-    {
-      sum += n3600[i];
-    }
-    return (double) sum;
+    mVal += other.mVal;
   }
+};
 
-  double
-  GetAvg3600 ()
+//------------------------------------------------------------------------------
+//! Sample bin with number of samples, sum, min and max
+//------------------------------------------------------------------------------
+struct StatExtBin {
+  unsigned long mN;
+  double mSum;
+  double mMin;
+  double mMax;
+
+  StatExtBin ()
   {
-    double sum = 0;
-    double n = 0;
-    for (int i = 0; i < 3600; i++)
-    {
-      n += n3600[i];
-      sum += sum3600[i];
-    }
-    return (sum / n);
+    Reset();
   }
 
-  double
-  GetMin3600 ()
+  void
+  Reset ()
   {
-    double minval = std::numeric_limits<long long>::max ();
-    for (int i = 0; i < 3600; i++)
-      minval = std::min (min3600[i], minval);
-    return double(minval);
+    mN = 0;
+    mSum = 0;
+    mMin = std::numeric_limits<long long>::max ();
+    mMax = std::numeric_limits<size_t>::min ();
   }
 
-  double
-  GetMax3600 ()
+  void
+  Merge (const StatExtBin& other)
   {
-    double maxval = std::numeric_limits<size_t>::min ();
-    for (int i = 0; i < 3600; i++)
-      maxval = std::max (max3600[i], maxval);
-    return double(maxval);
+    mN += other.mN;
+    mSum += other.mSum;
+    mMin = std::min (mMin, other.mMin);
+    mMax = std::max (mMax, other.mMax);
   }
+};
 
-  double
-  GetN300 ()
+class StatAvg
+{
+public:
+  StatWindows<StatAvgBin> mWindows;
+
+  void
+  Add (unsigned long val, int64_t now = time(0))
   {
-    unsigned long sum = 0;
-    for (int i = 0; i < 300; i++)
-    {
-      sum += n300[i];
-    }
-    return (double) sum;
+    mWindows.Update(now < 0 ? 0 : now, StatAvgBin(val));
   }
 
   double
-  GetAvg300 ()
+  GetAvg (unsigned int window) const
   {
     double sum = 0;
-    double n = 0;
-    for (int i = 0; i < 300; i++)
-    {
-      n += n300[i];
-      sum += sum300[i];
-    }
-    return (sum / n);
+    mWindows.ForEach(window, [&sum](const StatAvgBin & bin, double weight) {
+      sum += bin.mVal * weight;
+    });
+    return (sum / (window - 1));
   }
 
   double
-  GetMin300 ()
+  GetAvg3600 () const
   {
-    double minval = std::numeric_limits<long long>::max ();
-    for (int i = 0; i < 300; i++)
-      minval = std::min (min300[i], minval);
-    return double(minval);
+    return GetAvg(3600);
   }
 
   double
-  GetMax300 ()
+  GetAvg300 () const
   {
-    double maxval = std::numeric_limits<size_t>::min ();
-    for (int i = 0; i < 300; i++)
-      maxval = std::max (max300[i], maxval);
-    return double(maxval);
+    return GetAvg(300);
   }
 
   double
-  GetN60 ()
+  GetAvg60 () const
   {
-    unsigned long sum = 0;
-    for (int i = 0; i < 60; i++)
-    {
-      sum += n60[i];
-    }
-    return (double) sum;
+    return GetAvg(60);
   }
 
   double
-  GetAvg60 ()
+  GetAvg5 () const
   {
-    double sum = 0;
-    double n = 0;
-    for (int i = 0; i < 60; i++)
-    {
-      n += n60[i];
-      sum += sum60[i];
-    }
-    return (sum / n);
+    return GetAvg(5);
   }
+};
 
-  double
-  GetMin60 ()
+class StatExt
+{
+public:
+  StatWindows<StatExtBin> mWindows;
+
+  void
+  Insert (unsigned long nsample, const double &avgv, const double &minv, const double &maxv)
   {
-    double minval = std::numeric_limits<long long>::max ();
-    for (int i = 0; i < 60; i++)
-      minval = std::min (min60[i], minval);
-    return double(minval);
+    InsertSum(nsample, avgv * nsample, minv, maxv, time(0));
   }
 
-  double
-  GetMax60 ()
+  void
+  InsertSum (unsigned long nsample, double sum, double minv, double maxv,
+             int64_t now)
   {
-    double maxval = std::numeric_limits<size_t>::min ();
-    for (int i = 0; i < 60; i++)
-      maxval = std::max (max60[i], maxval);
-    return double(maxval);
+    StatExtBin val;
+    val.mN = nsample;
+    val.mSum = sum;
+    val.mMin = minv;
+    val.mMax = maxv;
+    mWindows.Update(now < 0 ? 0 : now, val);
   }
 
   double
-  GetN5 ()
+  GetN (unsigned int window) const
   {
-    unsigned long sum = 0;
-    for (int i = 0; i < 5; i++)
-    {
-      sum += n5[i];
-    }
-    return (double) sum;
+    double n = 0;
+    mWindows.ForEach(window, [&n](const StatExtBin & bin, double weight) {
+      n += bin.mN * weight;
+    });
+    return n;
   }
 
   double
-  GetAvg5 ()
+  GetAvg (unsigned int window) const
   {
     double sum = 0;
     double n = 0;
-    for (int i = 0; i < 5; i++)
-    {
-      n += n5[i];
-      sum += sum5[i];
-    }
+    mWindows.ForEach(window, [&](const StatExtBin & bin, double weight) {
+      n += bin.mN * weight;
+      sum += bin.mSum * weight;
+    });
     return (sum / n);
   }
 
   double
-  GetMin5 ()
+  GetMin (unsigned int window) const
   {
     double minval = std::numeric_limits<long long>::max ();
-    for (int i = 0; i < 5; i++)
-      minval = std::min (min5[i], minval);
-    return double(minval);
+    mWindows.ForEach(window, [&minval](const StatExtBin & bin, double) {
+      minval = std::min (bin.mMin, minval);
+    });
+    return minval;
   }
 
   double
-  GetMax5 ()
+  GetMax (unsigned int window) const
   {
     double maxval = std::numeric_limits<size_t>::min ();
-    for (int i = 0; i < 5; i++)
-      maxval = std::max (max5[i], maxval);
-    return double(maxval);
+    mWindows.ForEach(window, [&maxval](const StatExtBin & bin, double) {
+      maxval = std::max (bin.mMax, maxval);
+    });
+    return maxval;
   }
 
+  double GetN3600 () const { return GetN(3600); }
+  double GetAvg3600 () const { return GetAvg(3600); }
+  double GetMin3600 () const { return GetMin(3600); }
+  double GetMax3600 () const { return GetMax(3600); }
+  double GetN300 () const { return GetN(300); }
+  double GetAvg300 () const { return GetAvg(300); }
+  double GetMin300 () const { return GetMin(300); }
+  double GetMax300 () const { return GetMax(300); }
+  double GetN60 () const { return GetN(60); }
+  double GetAvg60 () const { return GetAvg(60); }
+  double GetMin60 () const { return GetMin(60); }
+  double GetMax60 () const { return GetMax(60); }
+  double GetN5 () const { return GetN(5); }
+  double GetAvg5 () const { return GetAvg(5); }
+  double GetMin5 () const { return GetMin(5); }
+  double GetMax5 () const { return GetMax(5); }
 };
 
-
 #define EXEC_TIMING_BEGIN(__ID__)               \
   struct timeval start__ID__;                   \
   struct timeval stop__ID__;                    \
@@ -457,6 +356,9 @@ public:
 class Stat
 {
 public:
+  //! Protects the maps below. Updates are first accumulated in per-thread
+  //! shards and folded into these maps by Circulate and PrintOutTotal, so
+  //! readers may see values up to one Circulate period old.
   XrdSysMutex Mutex;
 
   // first is name of value, then the map
@@ -515,6 +417,46 @@ public:
   void PrintOutTotal (XrdOucString &out, bool details = false, bool monitoring = false, bool numerical = false);
 
   void Circulate ();
+
+private:
+  //! Pending counter update
+  struct StatDelta {
+    unsigned long long mVal;
+    time_t mTime;
+  };
+
+  //! Pending sample update
+  struct StatExtDelta {
+    unsigned long mN;
+    double mSum;
+    double mMin;
+    double mMax;
+    time_t mTime;
+  };
+
+  //! Updates accumulated by a group of threads since the last Drain
+  struct Shard {
+    XrdSysMutex mMutex;
+    google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, StatDelta> > mUid;
+    google::sparse_hash_map<std::string, google::sparse_hash_map<gid_t, StatDelta> > mGid;
+    google::sparse_hash_map<std::string, google::sparse_hash_map<uid_t, StatExtDelta> > mExtUid;
+    google::sparse_hash_map<std::string, google::sparse_hash_map<gid_t, StatExtDelta> > mExtGid;
+    google::sparse_hash_map<std::string, std::vector<float> > mExec;
+  };
+
+  static constexpr size_t sNumShards = 16;
+  Shard mShards[sNumShards];
+
+  //----------------------------------------------------------------------------
+  //! Get the shard used by the calling thread
+  //----------------------------------------------------------------------------
+  Shard& GetShard ();
+
+  //----------------------------------------------------------------------------
+  //! Fold the pending updates of all shards into the maps - the caller must
+  //! hold Mutex
+  //----------------------------------------------------------------------------
+  void Drain ();
 };
 
 EOSMGMNAMESPACE_END
@@ -781,6 +781,20 @@ XrdMgmOfs::FuseXCast(uint64_t inode)
   gOFS->zMQ->gFuseServer.Cap().BroadcastReleaseFromExternal(inode);
 }
 
+//------------------------------------------------------------------------------
+// Lock the namespace for an attribute update, a file creation or a commit
+//------------------------------------------------------------------------------
+void
+XrdMgmOfs::LockNsForUpdate(eos::common::RWMutexReadLock& rd_lock,
+                           eos::common::RWMutexWriteLock& wr_lock)
+{
+  if (NsInQDB) {
+    rd_lock.Grab(eosViewRWMutex);
+  } else {
+    wr_lock.Grab(eosViewRWMutex);
+  }
+}
+
 //----------------------------------------------------------------------------
 //! Check if name space is booted
 //----------------------------------------------------------------------------
@@ -45,7 +45,16 @@
  * - eos::common::RWMutexXXXLock lock(gOFS->eosViewRWMutex)       : lock 2
  * - eos::common::RWMutexXXXLock lock(Quota::pMapMutex)           : lock 3
  * The XXX is either Read or Write depending what has to be done on the
- * objects they are protecting. The first mutex is the file system view object
+ * objects they are protecting. With the QuarkDB namespace, attribute updates,
+ * file creation and replica commits take lock 2 in read mode (see
+ * LockNsForUpdate). Below lock 2 the namespace objects use their own locks in
+ * this order: the children lock of a container (parent before child, a
+ * container never takes the lock of its parent), the leaf mutex of an object,
+ * then the leaf mutexes of the file system view and of the quota nodes.
+ * Creating a file checks and inserts the name under the children lock of its
+ * parent in write mode, iterating over the children of a container needs its
+ * children lock in read mode. Unlink, rename, move and mkdir still take lock 2
+ * in write mode. The first mutex is the file system view object
  * (FsView.cc) which contains the current state of the storage
  * filesystem/node/group/space configuration. The second mutex is protecting
  * the quota configuration and scheduling. The last mutex is protecting the
@@ -1325,6 +1334,9 @@ public:
   //! Subtree mtime propagation
   eos::IContainerMDChangeListener* eosSyncTimeAccounting;
   eos::common::RWMutex eosViewRWMutex; ///< rw namespace mutex
+  static constexpr size_t sNumFileUpdateMutexes = 256;
+  //! Mutexes serializing the file updates done under the ns read lock
+  std::mutex mFileUpdateMutexes[sNumFileUpdateMutexes];
   XrdOucString
   MgmMetaLogDir; //  Directory containing the meta data (change) log files
 
@@ -1408,6 +1420,34 @@ public:
   //------------------------------------------------------------------------------
   void FuseXCast(uint64_t inode);
 
+  //----------------------------------------------------------------------------
+  //! Lock the namespace for an update of the attributes of an object (mode,
+  //! times, extended attributes), the creation of a file or the commit of a
+  //! replica. The QuarkDB metadata objects serialize such updates themselves,
+  //! so with the QuarkDB namespace the namespace mutex is taken in read mode
+  //! and the update does not stall the readers. Otherwise the namespace mutex
+  //! is taken in write mode.
+  //!
+  //! @param rd_lock read lock grabbed for the QuarkDB namespace
+  //! @param wr_lock write lock grabbed for the in-memory namespace
+  //----------------------------------------------------------------------------
+  void LockNsForUpdate(eos::common::RWMutexReadLock& rd_lock,
+                       eos::common::RWMutexWriteLock& wr_lock);
+
+  //----------------------------------------------------------------------------
+  //! Get the mutex serializing the updates of the replicas, size and quota of
+  //! a file done under LockNsForUpdate. It is taken after the namespace mutex
+  //! and before any lock of the namespace objects.
+  //!
+  //! @param fid file id
+  //!
+  //! @return mutex of the stripe of the file id
+  //----------------------------------------------------------------------------
+  std::mutex& GetFileUpdateMutex(unsigned long long fid)
+  {
+    return mFileUpdateMutexes[fid % sNumFileUpdateMutexes];
+  }
+
   //----------------------------------------------------------------------------
   // Class objects
   //----------------------------------------------------------------------------
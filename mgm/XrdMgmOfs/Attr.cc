@@ -191,10 +191,11 @@ XrdMgmOfs::_attr_set(const char* path, XrdOucErrInfo& error,
   }
 
   std::shared_ptr<eos::IContainerMD> dh;
+  eos::common::RWMutexReadLock ns_rd_lock;
   eos::common::RWMutexWriteLock ns_wr_lock;
 
   if (take_lock) {
-    ns_wr_lock.Grab(gOFS->eosViewRWMutex);
+    gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
   }
 
   try {
@@ -512,7 +513,9 @@ XrdMgmOfs::_attr_rem(const char* path, XrdOucErrInfo& error,
     return Emsg(epname, error, EINVAL, "delete attribute", path);
   }
 
-  eos::common::RWMutexWriteLock lock(gOFS->eosViewRWMutex);
+  eos::common::RWMutexReadLock ns_rd_lock;
+  eos::common::RWMutexWriteLock ns_wr_lock;
+  gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
 
   try {
     dh = gOFS->eosView->getContainer(path);
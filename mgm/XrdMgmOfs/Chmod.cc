@@ -95,7 +95,9 @@ XrdMgmOfs::_chmod(const char* path,
   static const char* epname = "chmod";
   EXEC_TIMING_BEGIN("Chmod");
   // ---------------------------------------------------------------------------
-  eos::common::RWMutexWriteLock lock(gOFS->eosViewRWMutex);
+  eos::common::RWMutexReadLock ns_rd_lock;
+  eos::common::RWMutexWriteLock ns_wr_lock;
+  gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
   std::shared_ptr<eos::IContainerMD> cmd;
   std::shared_ptr<eos::IContainerMD> pcmd;
   std::shared_ptr<eos::IFileMD> fmd;
@@ -116,8 +116,10 @@ XrdMgmOfs::_find(const char* path, XrdOucErrInfo& out_error,
           continue;
         }
 
-        // Add all children into the 2D vectors
+        // Add all children into the 2D vectors, files are created under the
+        // namespace read lock
         // @todo (esindril): User the itertor interface from the ns
+        eos::ReadLockGuard children_lock(cmd->getChildrenLock());
         auto it_begin = cmd->subcontainersBegin();
         auto it_end = cmd->subcontainersEnd();
 
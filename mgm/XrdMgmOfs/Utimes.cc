@@ -98,7 +98,9 @@ XrdMgmOfs::_utimes(const char* path,
   gOFS->MgmStats.Add("Utimes", vid.uid, vid.gid, 1);
   eos_info("calling utimes for path=%s, uid=%i, gid=%i", path, vid.uid, vid.gid);
   // ---------------------------------------------------------------------------
-  eos::common::RWMutexWriteLock lock(gOFS->eosViewRWMutex);
+  eos::common::RWMutexReadLock ns_rd_lock;
+  eos::common::RWMutexWriteLock ns_wr_lock;
+  gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
 
   try {
     cmd = gOFS->eosView->getContainer(path, false);
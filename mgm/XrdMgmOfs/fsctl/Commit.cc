@@ -164,8 +164,13 @@
     eos::IContainerMD::id_t cid = 0;
     std::string fmdname;
     {
-      // Keep the lock order View=>Namespace=>Quota
-      eos::common::RWMutexWriteLock nslock(gOFS->eosViewRWMutex);
+      // Keep the lock order View=>Namespace=>Quota. Replicas of the same file
+      // commit concurrently, the size and quota updates are serialized per
+      // file when the namespace is only locked in read mode.
+      eos::common::RWMutexReadLock ns_rd_lock;
+      eos::common::RWMutexWriteLock ns_wr_lock;
+      gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
+      std::lock_guard<std::mutex> fid_lock(gOFS->GetFileUpdateMutex(fid));
       XrdOucString emsg = "";
 
       try {
@@ -196,20 +196,24 @@ XrdMgmOfsDirectory::_open(const char* dir_path,
       // Add all the files and subdirectories
       gOFS->MgmStats.Add("OpenDir-Entry", vid.uid, vid.gid,
                          dh->getNumContainers() + dh->getNumFiles());
-      // Collect all file names
-      auto fit_begin = dh->filesBegin();
-      auto fit_end = dh->filesEnd();
-
-      for (auto it = fit_begin; it != fit_end; ++it) {
-        dh_list.insert(it->first);
-      }
+      {
+        // Files are created under the namespace read lock
+        eos::ReadLockGuard children_lock(dh->getChildrenLock());
+        // Collect all file names
+        auto fit_begin = dh->filesBegin();
+        auto fit_end = dh->filesEnd();
+
+        for (auto it = fit_begin; it != fit_end; ++it) {
+          dh_list.insert(it->first);
+        }
 
-      // Collect all subcontainers
-      auto cit_begin = dh->subcontainersBegin();
-      auto cit_end = dh->subcontainersEnd();
+        // Collect all subcontainers
+        auto cit_begin = dh->subcontainersBegin();
+        auto cit_end = dh->subcontainersEnd();
 
-      for (auto it = cit_begin; it != cit_end; ++it) {
-        dh_list.insert(it->first);
+        for (auto it = cit_begin; it != cit_end; ++it) {
+          dh_list.insert(it->first);
+        }
       }
 
       dh_list.insert(".");
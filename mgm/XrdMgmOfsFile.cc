@@ -814,7 +814,9 @@ XrdMgmOfsFile::open(const char* inpath,
         // creation of a new file or isOcUpload
         {
           // -------------------------------------------------------------------
-          eos::common::RWMutexWriteLock lock(gOFS->eosViewRWMutex);
+          eos::common::RWMutexReadLock ns_rd_lock;
+          eos::common::RWMutexWriteLock ns_wr_lock;
+          gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
 
           try {
             if (!fmd) {
@@ -969,8 +971,9 @@ XrdMgmOfsFile::open(const char* inpath,
   std::string targetgeotag;
   // get placement policy
   Policy::GetPlctPolicy(path, attrmap, vid, *openOpaque, plctplcy, targetgeotag);
-  // @todo (jmakai): fix this - the same lock is taken later on in ShouldStall-IsKnownNode
-  eos::common::RWMutexReadLock fs_rd_lock(FsView::gFsView.ViewMutex);
+  // The placement and the access work on the FsView snapshot, the ViewMutex
+  // is only taken afterwards to resolve the selected file systems
+  eos::common::RWMutexReadLock fs_rd_lock;
   unsigned long long ext_mtime_sec = 0;
   unsigned long long ext_mtime_nsec = 0;
   unsigned long long ext_ctime_sec = 0;
@@ -1008,7 +1011,11 @@ XrdMgmOfsFile::open(const char* inpath,
     layoutId = new_lid;
     {
       std::shared_ptr<eos::IFileMD> fmdnew;
-      eos::common::RWMutexWriteLock lock(gOFS->eosViewRWMutex);
+      eos::common::RWMutexReadLock ns_rd_lock;
+      eos::common::RWMutexWriteLock ns_wr_lock;
+      gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
+      std::lock_guard<std::mutex>
+      fid_lock(gOFS->GetFileUpdateMutex(fmd->getId()));
 
       if (!byfid) {
         try {
@@ -1578,7 +1585,11 @@ XrdMgmOfsFile::open(const char* inpath,
           std::string binchecksum = eos::common::LayoutId::GetEmptyFileChecksum(layoutId);
           eos::Buffer cx;
           cx.putData(binchecksum.c_str(), binchecksum.size());
-          eos::common::RWMutexWriteLock lock(gOFS->eosViewRWMutex);
+          eos::common::RWMutexReadLock ns_rd_lock;
+          eos::common::RWMutexWriteLock ns_wr_lock;
+          gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
+          std::lock_guard<std::mutex>
+          fid_lock(gOFS->GetFileUpdateMutex(fmd->getId()));
           // -------------------------------------------------------------------
 
           try {
@@ -1617,7 +1628,10 @@ XrdMgmOfsFile::open(const char* inpath,
         if (byfid) {
           // the new FUSE client needs to have the replicas attached after the
           // first open call
-          eos::common::RWMutexWriteLock lock(gOFS->eosViewRWMutex);
+          eos::common::RWMutexReadLock ns_rd_lock;
+          eos::common::RWMutexWriteLock ns_wr_lock;
+          gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
+          std::lock_guard<std::mutex> fid_lock(gOFS->GetFileUpdateMutex(byfid));
 
           try {
             fmd = gOFS->eosFileService->getFileMD(byfid);
@@ -1644,6 +1658,7 @@ XrdMgmOfsFile::open(const char* inpath,
         eos::common::FileSystem::fsid_t fsid = 0;
         fsIndex = 0;
         std::string fsgeotag;
+        eos::common::RWMutexReadLock fuse_fs_rd_lock(FsView::gFsView.ViewMutex);
 
         for (size_t k = 0; k < selectedfs.size(); k++) {
           filesystem = 0;
@@ -1692,6 +1707,9 @@ XrdMgmOfsFile::open(const char* inpath,
     return Emsg(epname, error, ENETUNREACH, "received filesystem id 0", path);
   }
 
+  // @todo (jmakai): fix this - the same lock is taken later on in ShouldStall-IsKnownNode
+  fs_rd_lock.Grab(FsView::gFsView.ViewMutex);
+
   if (FsView::gFsView.mIdView.count(selectedfs[fsIndex])) {
     filesystem = FsView::gFsView.mIdView[selectedfs[fsIndex]];
   } else {
@@ -2352,7 +2370,9 @@ XrdMgmOfsFile::open(const char* inpath,
       time_t now = time(nullptr);
       XrdOucString sage = attrmap["sys.force.atime"].c_str();
       time_t age = eos::common::StringConversion::GetSizeFromString(sage);
-      eos::common::RWMutexWriteLock lock(gOFS->eosViewRWMutex);
+      eos::common::RWMutexReadLock ns_rd_lock;
+      eos::common::RWMutexWriteLock ns_wr_lock;
+      gOFS->LockNsForUpdate(ns_rd_lock, ns_wr_lock);
 
       try {
         fmd = gOFS->eosView->getFile(path);
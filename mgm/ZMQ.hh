@@ -101,19 +101,33 @@ public:
 
     void reply(const std::string& id, const std::string& data)
     {
-      static XrdSysMutex sMutex;
-      XrdSysMutexHelper lLock(sMutex);
+      XrdSysMutexHelper lLock(mReplyMutex);
       zmq::message_t id_msg(id.c_str(), id.size());
       zmq::message_t data_msg(data.c_str(), data.size());
       injector_.send(id_msg, ZMQ_SNDMORE);
       injector_.send(data_msg);
     }
 
+    // send several messages to the same client, each one is still a
+    // separate reply for the client
+    void reply(const std::string& id, const std::vector<std::string>& data)
+    {
+      XrdSysMutexHelper lLock(mReplyMutex);
+
+      for (auto it = data.begin(); it != data.end(); ++it) {
+        zmq::message_t id_msg(id.c_str(), id.size());
+        zmq::message_t data_msg(it->c_str(), it->size());
+        injector_.send(id_msg, ZMQ_SNDMORE);
+        injector_.send(data_msg);
+      }
+    }
+
   private:
     zmq::context_t ctx_;
     zmq::socket_t frontend_;
     zmq::socket_t backend_;
     zmq::socket_t injector_;
+    XrdSysMutex mReplyMutex; ///< serializes the replies on the injector
 
     std::string bindUrl;
   } ;
@@ -27,6 +27,7 @@
 #include "mgm/GeoTreeEngine.hh"
 #include "mgm/Master.hh"
 #include "namespace/interface/IFsView.hh"
+#include <set>
 #include <sstream>
 
 EOSMGMNAMESPACE_BEGIN
@@ -247,14 +248,27 @@ DrainFS::Drain()
       XrdSysThread::CancelPoint();
       bool stalled = ((time(NULL) - last_filesleft_change) > 600);
       auto job = mJobsPending.begin();
-      eos::common::FileSystem::fsid_t fsIdTarget;
       last_filesleft = filesleft;
+      std::set<DrainTransferJob*> tried;
 
       while ((mJobsRunning.size() <= maxParallelJobs) && (job != mJobsPending.end())) {
         if (!(*job)->GetTargetFS()) {
-          if ((fsIdTarget = SelectTargetFS(&(*job->get()))) != 0) {
-            (*job)->SetTargetFS(fsIdTarget);
-          } else {
+          if (!tried.count(job->get())) {
+            // place the targets of all the jobs which can start now at once
+            std::vector<DrainTransferJob*> to_place;
+
+            for (auto it = job; (it != mJobsPending.end()) &&
+                 (mJobsRunning.size() + to_place.size() <= maxParallelJobs); ++it) {
+              if (!(*it)->GetTargetFS()) {
+                to_place.push_back(it->get());
+              }
+            }
+
+            SelectTargetFS(to_place);
+            tried.insert(to_place.begin(), to_place.end());
+          }
+
+          if (!(*job)->GetTargetFS()) {
             std::string error = "Failed to find a suitable Target filesystem for draining";
             (*job)->ReportError(error);
             mJobsFailed.push_back(*job);
@@ -471,88 +485,91 @@ DrainFS::DrainStop()
 }
 
 //------------------------------------------------------------------------------
-// Select target file system using the GeoTreeEngine
+// Select the target file systems of several jobs using the GeoTreeEngine
 //------------------------------------------------------------------------------
-eos::common::FileSystem::fsid_t
-DrainFS::SelectTargetFS(DrainTransferJob* job)
-
+size_t
+DrainFS::SelectTargetFS(const std::vector<DrainTransferJob*>& jobs)
 {
-  eos::common::RWMutexReadLock(FsView::gFsView.ViewMutex);
-  eos::common::RWMutexReadLock nsLock(gOFS->eosViewRWMutex);
-  std::vector<FileSystem::fsid_t>* newReplicas = new
-  std::vector<FileSystem::fsid_t>();
-  std::vector<FileSystem::fsid_t> existingReplicas;
-  eos::common::FileSystem::fs_snapshot source_snapshot;
-  eos::common::FileSystem* source_fs = 0;
-  std::shared_ptr<eos::IFileMD> fmd =  gOFS->eosFileService->getFileMD(
-                                         job->GetFileId());
-  unsigned int nfilesystems = 1;
-  unsigned int ncollocatedfs = 0;
-  source_fs = FsView::gFsView.mIdView[job->GetSourceFS()];
-  source_fs->SnapShotFileSystem(source_snapshot);
-  FsGroup* group = FsView::gFsView.mGroupView[source_snapshot.mGroup];
-  //check other replicas for the file
-  std::vector<std::string> fsidsgeotags;
-  existingReplicas = static_cast<std::vector<FileSystem::fsid_t>>
-                     (fmd->getLocations());
-
-  if (!gGeoTreeEngine.getInfosFromFsIds(existingReplicas,
-                                        &fsidsgeotags,
-                                        0, 0)) {
-    eos_notice("could not retrieve info for all avoid fsids");
-    delete newReplicas;
+  if (jobs.empty()) {
     return 0;
   }
 
-  auto repl = existingReplicas.begin();
+  eos::common::RWMutexReadLock fs_rd_lock(FsView::gFsView.ViewMutex);
+  // all the jobs drain the same file system, hence the same group
+  FileSystem* source_fs = FsView::gFsView.mIdView.count(mFsId) ?
+                          FsView::gFsView.mIdView[mFsId] : nullptr;
 
-  while (repl != existingReplicas.end()) {
-    eos_static_debug("existing replicas: %d", *repl);
-    repl++;
+  if (!source_fs) {
+    eos_notice("fsid=%u is not in the view any more", mFsId);
+    return 0;
   }
 
-  auto geo = fsidsgeotags.begin();
+  eos::common::FileSystem::fs_snapshot source_snapshot;
+  source_fs->SnapShotFileSystem(source_snapshot);
 
-  while (geo != fsidsgeotags.end()) {
-    eos_static_debug("geotags: %s", (*geo).c_str());
-    geo++;
+  if (!FsView::gFsView.mGroupView.count(source_snapshot.mGroup)) {
+    eos_notice("group=%s of fsid=%u is not in the view",
+               source_snapshot.mGroup.c_str(), mFsId);
+    return 0;
   }
 
-  bool res = gGeoTreeEngine.placeNewReplicasOneGroup(
-               group, nfilesystems,
-               newReplicas,
-               (ino64_t) fmd->getId(),
-               NULL, //entrypoints
-               NULL, //firewall
-               GeoTreeEngine::draining,
-               &existingReplicas,
-               &fsidsgeotags,
-               fmd->getSize(),
-               "",//start from geotag
-               "",//client geo tag
-               ncollocatedfs,
-               NULL, //excludeFS
-               &fsidsgeotags, //excludeGeoTags
-               NULL);
-
-  if (res) {
-    std::ostringstream oss;
-
-    for (auto it = newReplicas->begin(); it != newReplicas->end(); ++it) {
-      oss << " " << (unsigned long)(*it);
+  FsGroup* group = FsView::gFsView.mGroupView[source_snapshot.mGroup];
+  std::vector<GeoTreeEngine::BatchPlacement> batch;
+  std::vector<DrainTransferJob*> batch_jobs;
+  batch.reserve(jobs.size());
+  batch_jobs.reserve(jobs.size());
+  {
+    eos::common::RWMutexReadLock ns_rd_lock(gOFS->eosViewRWMutex);
+
+    for (auto job : jobs) {
+      std::shared_ptr<eos::IFileMD> fmd;
+
+      try {
+        fmd = gOFS->eosFileService->getFileMD(job->GetFileId());
+      } catch (eos::MDException& e) {
+        eos_notice("fxid=%08llx msg=\"%s\"", job->GetFileId(),
+                   e.getMessage().str().c_str());
+        continue;
+      }
+
+      GeoTreeEngine::BatchPlacement plct(1, fmd->getSize());
+      // check other replicas for the file
+      plct.existingReplicas = static_cast<std::vector<FileSystem::fsid_t>>
+                              (fmd->getLocations());
+
+      if (!gGeoTreeEngine.getInfosFromFsIds(plct.existingReplicas,
+                                            &plct.fsidsgeotags, 0, 0)) {
+        eos_notice("could not retrieve info for all avoid fsids of fxid=%08llx",
+                   job->GetFileId());
+        continue;
+      }
+
+      plct.excludeGeoTags = plct.fsidsgeotags;
+      batch.push_back(std::move(plct));
+      batch_jobs.push_back(job);
     }
+  }
 
-    eos_static_debug("GeoTree Draining Placement returned %d with fs id's -> %s",
-                     (int)res, oss.str().c_str());
-    //return only one FS now
-    eos::common::FileSystem::fsid_t targetFS = *newReplicas->begin();
-    delete newReplicas;
-    return targetFS;
-  } else {
-    eos_notice("could not place the replica");
-    delete newReplicas;
+  if (batch.empty()) {
     return 0;
   }
+
+  size_t nplaced = gGeoTreeEngine.placeNewReplicasOneGroupBatch(group, batch,
+                   GeoTreeEngine::draining);
+  eos_static_debug("GeoTree Draining Placement placed %lu/%lu files",
+                   (unsigned long) nplaced, (unsigned long) batch.size());
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (batch[i].success && !batch[i].newReplicas.empty()) {
+      // return only one FS now
+      batch_jobs[i]->SetTargetFS(batch[i].newReplicas.front());
+    } else {
+      eos_notice("could not place the replica of fxid=%08llx",
+                 batch_jobs[i]->GetFileId());
+    }
+  }
+
+  return nplaced;
 }
 
 EOSMGMNAMESPACE_END
@@ -95,13 +95,14 @@ private:
   void* Drain();
 
   //----------------------------------------------------------------------------
-  //! Select target file system using the GeoTreeEngine
+  //! Select the target file systems of several jobs in one placement batch of
+  //! the GeoTreeEngine. The target of the jobs which could be placed is set.
   //!
-  //! @param job drain job object
+  //! @param jobs drain job objects without target file system
   //!
-  ///! @return if successful then target file system, othewise 0
+  //! @return number of jobs for which a target file system was found
   //----------------------------------------------------------------------------
-  eos::common::FileSystem::fsid_t SelectTargetFS(DrainTransferJob* job);
+  size_t SelectTargetFS(const std::vector<DrainTransferJob*>& jobs);
 
   //----------------------------------------------------------------------------
   //! Set initial drain counters and status
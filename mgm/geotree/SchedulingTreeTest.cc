@@ -20,9 +20,11 @@
  * You should have received a copy of the GNU General Public License    *
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
-#undef NDEBUG
 #include "mgm/geotree/SchedulingSlowTree.hh"
 #include "common/Logging.hh"
+#include "common/RWMutex.hh"
+#include "mgm/GeoTreeEngine.hh"
+#include "mgm/FsView.hh"
 
 #include <iostream>
 #include <iomanip>
@@ -36,10 +38,23 @@
 #include <cmath>
 #include <functional>
 #include <limits>
+#include <memory>
+#include <cstdlib>
 
 using namespace std;
 using namespace eos::mgm;
 
+//! Check a condition, which is evaluated even when NDEBUG is defined as many
+//! of them have the side effects the tests rely on
+#define VERIFY(cond)                                                        \
+  do {                                                                      \
+    if (!(cond)) {                                                          \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond  \
+                << std::endl;                                               \
+      abort();                                                              \
+    }                                                                       \
+  } while (0)
+
 #define RUN_FUNCTIONAL_TEST 1
 #define RUN_BURNIN_TEST 1
 size_t CheckLevel = 1;
@@ -186,17 +201,17 @@ void functionalTestFastTree(FastTree<T1, T2>* fptree, FastTree<T3, T4>* fatree,
     size_t nreplica = 1 + rand() % (nMaxReplicas);
     // copy a blank copy of the FastTree
     char buffer[bufferSize];
-    assert(fptree->copyToBuffer(buffer, bufferSize) == 0);
+    VERIFY(fptree->copyToBuffer(buffer, bufferSize) == 0);
     FastPlacementTree* ftree = (FastPlacementTree*) buffer;
     char buffer2[bufferSize];
-    assert(fatree->copyToBuffer(buffer2, bufferSize) == 0);
+    VERIFY(fatree->copyToBuffer(buffer2, bufferSize) == 0);
     FastROAccessTree* ftree2 = (FastROAccessTree*) buffer2;
     // place the replicas
     set<SchedTreeBase::tFastTreeIdx> repIdxs;
     SchedTreeBase::tFastTreeIdx repIdx;
 
     for (size_t k = 0; k < nreplica; k++) {
-      assert(ftree->findFreeSlot(repIdx));
+      VERIFY(ftree->findFreeSlot(repIdx));
       repIdxs.insert(repIdx);
     }
 
@@ -211,7 +226,7 @@ void functionalTestFastTree(FastTree<T1, T2>* fptree, FastTree<T3, T4>* fatree,
     SchedTreeBase::tFastTreeIdx allreplicas[255], nr;
     nr = 255;
     nr = ftree2->findFreeSlotsAll(allreplicas, nr);
-    assert(nr);
+    VERIFY(nr);
     // check that all the replicas are there
     set<SchedTreeBase::tFastTreeIdx> allreplicasset, symdif;
     allreplicasset.insert(allreplicas, allreplicas + nr);
@@ -219,24 +234,24 @@ void functionalTestFastTree(FastTree<T1, T2>* fptree, FastTree<T3, T4>* fatree,
     set_symmetric_difference(repIdxs.begin(), repIdxs.end(), allreplicasset.begin(),
                              allreplicasset.end(),
                              inserter(symdif, symdifbeg));
-    assert(symdif.empty());
+    VERIFY(symdif.empty());
 
     for (size_t k = 0; k < nreplica; k++) {
       // check that the closest node is the node itself
       SchedTreeBase::tFastTreeIdx closest = geomap->getClosestFastTreeNode((
                                               *treeinfo)[k].fullGeotag.c_str());
-      assert(closest == k);
+      VERIFY(closest == k);
       // request an access
-      assert(ftree2->findFreeSlot(repIdx, closest, true, true));
+      VERIFY(ftree2->findFreeSlot(repIdx, closest, true, true));
       // check that the replica node is among the placed replica
-      assert(repIdxs.count(repIdx));
+      VERIFY(repIdxs.count(repIdx));
       // check that it's the nearest one (i.e) the deepest tree similarity
       size_t simRep = treeDepthSimilarity((*treeinfo)[k].fullGeotag,
                                           (*treeinfo)[closest].fullGeotag);
 
       for (set<SchedTreeBase::tFastTreeIdx>::const_iterator it = repIdxs.begin();
            it != repIdxs.end(); it++) {
-        assert(treeDepthSimilarity((*treeinfo)[k].fullGeotag,
+        VERIFY(treeDepthSimilarity((*treeinfo)[k].fullGeotag,
                                    (*treeinfo)[*it].fullGeotag) <= simRep);
       }
     }
@@ -312,8 +327,15 @@ bool testAccess(const std::string& toAccess, const std::string& accessible)
   return false;
 }
 
-int main()
+int mainFull(bool runFunctional = true);
+
+int main(int argc, char* argv[])
 {
+  // run only the speed tests on the trees built from the geotag test file
+  if ((argc > 1) && (std::string(argv[1]) == "--burn-in")) {
+    return mainFull(false);
+  }
+
   SlowTree* st = new SlowTree("pg1");
   SlowTree::TreeNodeInfo* tni = new SlowTree::TreeNodeInfo();
   SlowTree::TreeNodeStateFloat* tns = new SlowTree::TreeNodeStateFloat();
@@ -438,7 +460,7 @@ int main2()
   return 0;
 }
 
-int mainFull()
+int mainFull(bool runFunctional)
 {
   eos::common::Logging& g_logging = eos::common::Logging::GetInstance();
   g_logging.SetUnit("SchedulingTreeTest");
@@ -562,8 +584,8 @@ int mainFull()
       }
 
       //std::cout<< "insert =>" << it->first <<"\t"<< it->second<<"::"<<info.mFsId <<std::endl;
-      assert(trees[idx].insert(&info, &state) != NULL);
-      assert(trees[idx].remove(
+      VERIFY(trees[idx].insert(&info, &state) != NULL);
+      VERIFY(trees[idx].remove(
                &info));  // erase and rewrite to just to give a try to this feature
       trees[idx].insert(&info, &state);
     }
@@ -587,7 +609,7 @@ int mainFull()
     fdatrees[idx].selfAllocate(trees[idx].getNodeCount());
     // build the FastTree
     //std::cout<<trees[0]<<std::endl;
-    assert(
+    VERIFY(
       trees[idx].buildFastStrcturesSched(&fptrees[idx], &froatrees[idx],
                                          &frwatrees[idx], &fbptrees[idx], &fbatrees[idx],
                                          &fdptrees[idx], &fdatrees[idx], &ftinfos[idx], &ftmaps[idx], &geomaps[idx]));
@@ -601,12 +623,12 @@ int mainFull()
          dningit != maxDningToDnerSimil[idx].end(); dningit++) {
       size_t maxSim = 0;
       const SchedTreeBase::tFastTreeIdx* dningIdx;
-      assert(ftmaps[idx].get(dningit->first, dningIdx));
+      VERIFY(ftmaps[idx].get(dningit->first, dningIdx));
 
       for (auto dnerit = drainerfs[idx].begin(); dnerit != drainerfs[idx].end();
            dnerit++) {
         const SchedTreeBase::tFastTreeIdx* dnerIdx;
-        assert(ftmaps[idx].get(*dnerit, dnerIdx));
+        VERIFY(ftmaps[idx].get(*dnerit, dnerIdx));
         size_t sim = treeDepthSimilarity(ftinfos[idx][*dnerIdx].fullGeotag,
                                          ftinfos[idx][*dningIdx].fullGeotag);
         maxSim = max(maxSim, sim);
@@ -619,12 +641,12 @@ int mainFull()
          bcingit != maxBcingToBcerSimil[idx].end(); bcingit++) {
       size_t maxSim = 0;
       const SchedTreeBase::tFastTreeIdx* bcingIdx;
-      assert(ftmaps[idx].get(bcingit->first, bcingIdx));
+      VERIFY(ftmaps[idx].get(bcingit->first, bcingIdx));
 
       for (auto bcerit = balancerfs[idx].begin(); bcerit != balancerfs[idx].end();
            bcerit++) {
         const SchedTreeBase::tFastTreeIdx* bcerIdx;
-        assert(ftmaps[idx].get(*bcerit, bcerIdx));
+        VERIFY(ftmaps[idx].get(*bcerit, bcerIdx));
         size_t sim = treeDepthSimilarity(ftinfos[idx][*bcerIdx].fullGeotag,
                                          ftinfos[idx][*bcingIdx].fullGeotag);
         maxSim = max(maxSim, sim);
@@ -634,6 +656,13 @@ int mainFull()
     }
 
 #if RUN_FUNCTIONAL_TEST==1
+
+    // the burn-in only run skips the functional testing
+    if (!runFunctional) {
+      idx++;
+      continue;
+    }
+
     // functional testing
     functionalTestFastTree(&fptrees[idx], &froatrees[idx], &geomaps[idx],
                            &ftinfos[idx], nAvailableFsPlct);
@@ -709,7 +738,7 @@ int mainFull()
 
   for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
     char buffer[bufferSize];
-    assert(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
+    VERIFY(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
     FastPlacementTree* ftree = (FastPlacementTree*) buffer;
     SchedTreeBase::tFastTreeIdx repId;
 
@@ -728,13 +757,93 @@ int mainFull()
          elapsed) / CLOCKS_PER_SEC)
        << " placements/sec " << endl;
   cout << "----------------------------" << endl << endl;
+  {
+    // Place files with 3 replicas and a booking size with the GeoTreeEngine,
+    // one placeNewReplicasOneGroup call per file against
+    // placeNewReplicasOneGroupBatch. Each path has its own engine holding the
+    // same groups, so that the penalties of one don't slow down the other.
+    const unsigned long long bookingSize = 1ull << 30;
+    GeoTreeEngine singleEngine, batchEngine;
+    std::vector<std::unique_ptr<FsGroup>> singleGroups, batchGroups;
+    eos::common::FileSystem::fsid_t fsid = 0;
+
+    for (size_t j = 0; j < schedGroups.size(); j++) {
+      std::string name = "default." + std::to_string(j);
+      singleGroups.emplace_back(new FsGroup(name.c_str()));
+      batchGroups.emplace_back(new FsGroup(name.c_str()));
+
+      for (auto it = schedGroups[j].begin(); it != schedGroups[j].end(); it++) {
+        eos::common::FileSystem::fs_snapshot_t fsn;
+        fsn.mId = ++fsid;
+        fsn.mGroup = name;
+        fsn.mHost = it->first;
+        fsn.mHostPort = it->first + ":1095";
+        fsn.mGeoTag = it->second;
+        fsn.mFileStickyProxyDepth = -1;
+        fsn.mStatus = eos::common::FileSystem::kBooted;
+        fsn.mConfigStatus = eos::common::FileSystem::kRW;
+        fsn.mActiveStatus = eos::common::FileSystem::kOnline;
+        fsn.mErrCode = 0;
+        fsn.mHeadRoom = 0;
+        fsn.mDiskUtilization = 0.1;
+        fsn.mNetEthRateMiB = 1250;
+        fsn.mDiskFilled = 10;
+        fsn.mDiskBsize = 4096;
+        fsn.mDiskBfree = 1ll << 30;
+        VERIFY(singleEngine.insertFsIntoGroup(fsn, singleGroups[j].get()));
+        VERIFY(batchEngine.insertFsIntoGroup(fsn, batchGroups[j].get()));
+      }
+    }
+
+    size_t nfailed = 0;
+    begin = clock();
+
+    for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
+      std::vector<eos::common::FileSystem::fsid_t> newReplicas;
+      std::vector<eos::common::FileSystem::fsid_t> existingReplicas;
+
+      if (!singleEngine.placeNewReplicasOneGroup(
+            singleGroups[i % schedGroups.size()].get(), 3, &newReplicas, 0, NULL,
+            NULL, GeoTreeEngine::regularRW, &existingReplicas, NULL,
+            bookingSize)) {
+        nfailed++;
+      }
+    }
+
+    elapsed = clock() - begin;
+    cout << "SINGLE FILE PLACEMENT SPEED TEST" << endl;
+    cout << "elapsed time : " << float (elapsed) / CLOCKS_PER_SEC << " sec." <<
+         endl;
+    cout << "speed        : " << schedGroups.size() * nbIter / (float (
+           elapsed) / CLOCKS_PER_SEC) << " files/sec " << endl;
+    cout << "failed       : " << nfailed << " files" << endl;
+    cout << "----------------------------" << endl << endl;
+    nfailed = 0;
+    begin = clock();
+
+    for (size_t j = 0; j < schedGroups.size(); j++) {
+      std::vector<GeoTreeEngine::BatchPlacement> batch(nbIter,
+          GeoTreeEngine::BatchPlacement(3, bookingSize));
+      nfailed += nbIter - batchEngine.placeNewReplicasOneGroupBatch(
+                   batchGroups[j].get(), batch, GeoTreeEngine::regularRW);
+    }
+
+    elapsed = clock() - begin;
+    cout << "BATCH FILE PLACEMENT SPEED TEST" << endl;
+    cout << "elapsed time : " << float (elapsed) / CLOCKS_PER_SEC << " sec." <<
+         endl;
+    cout << "speed        : " << schedGroups.size() * nbIter / (float (
+           elapsed) / CLOCKS_PER_SEC) << " files/sec " << endl;
+    cout << "failed       : " << nfailed << " files" << endl;
+    cout << "----------------------------" << endl << endl;
+  }
   begin = clock();
 
   for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
     char buffer[bufferSize];
-    assert(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
+    VERIFY(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
     char buffer2[bufferSize];
-    assert(froatrees[i % schedGroups.size()].copyToBuffer(buffer2,
+    VERIFY(froatrees[i % schedGroups.size()].copyToBuffer(buffer2,
            bufferSize) == 0);
   }
 
@@ -750,10 +859,10 @@ int mainFull()
 
   for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
     char buffer[bufferSize];
-    assert(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
+    VERIFY(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
     FastPlacementTree* ftree = (FastPlacementTree*) buffer;
     char buffer2[bufferSize];
-    assert(froatrees[i % schedGroups.size()].copyToBuffer(buffer2,
+    VERIFY(froatrees[i % schedGroups.size()].copyToBuffer(buffer2,
            bufferSize) == 0);
     FastROAccessTree* ftree2 = (FastROAccessTree*) buffer2;
 
@@ -776,7 +885,7 @@ int mainFull()
 
   for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
     char buffer[bufferSize];
-    assert(froatrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
+    VERIFY(froatrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
     FastROAccessTree* ftree = (FastROAccessTree*) buffer;
     // pick a random geolocation which makes sense in the tree
     const string& clientGeoString =
@@ -809,7 +918,7 @@ int mainFull()
 
   for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
     char buffer[bufferSize];
-    assert(froatrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
+    VERIFY(froatrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
     FastROAccessTree* ftree = (FastROAccessTree*) buffer;
 
     // update the tree
@@ -837,13 +946,13 @@ int mainFull()
     drainers[idx].resize(128);
     fsize = fptrees[idx].findFreeSlotsAll(&drainers[idx][0], drainers[idx].size(),
                                           0, false, SchedTreeBase::Drainer);
-    assert(fsize);
+    VERIFY(fsize);
     drainers[idx].resize(fsize);
     balancers[idx].resize(128);
     fsize = fptrees[idx].findFreeSlotsAll(&balancers[idx][0], balancers[idx].size(),
                                           0, false,
                                           SchedTreeBase::Balancer);
-    assert(fsize);
+    VERIFY(fsize);
     drainers[idx].resize(fsize);
   }
 
@@ -866,7 +975,7 @@ int mainFull()
 
   for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
     char buffer[bufferSize];
-    assert(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
+    VERIFY(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
     FastPlacementTree* ftree = (FastPlacementTree*) buffer;
     // select a random file system
     SchedTreeBase::tFastTreeIdx rfs = fsIdxBegV[i % schedGroups.size()]
@@ -887,7 +996,7 @@ int mainFull()
 
   for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
     char buffer[bufferSize];
-    assert(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
+    VERIFY(fptrees[i % schedGroups.size()].copyToBuffer(buffer, bufferSize) == 0);
     FastPlacementTree* ftree = (FastPlacementTree*) buffer;
     ftree->updateTree();
   }
@@ -904,7 +1013,7 @@ int mainFull()
 
   for (size_t i = 0; i < schedGroups.size() * nbIter; i++) {
     int j = i % schedGroups.size();
-    assert(
+    VERIFY(
       trees[j].buildFastStrcturesSched(&fptrees[j], &froatrees[j], &frwatrees[j],
                                        &fbptrees[j], &fbatrees[j],
                                        &fdptrees[j], &fdatrees[j], &ftinfos[j], &ftmaps[j], &geomaps[j]));
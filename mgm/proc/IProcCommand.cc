@@ -63,7 +63,13 @@ IProcCommand::open(const char* path, const char* info,
     if (!ofstdoutStreamFilename.empty() && !ofstderrStreamFilename.empty()) {
       ifstdoutStream.open(ofstdoutStreamFilename, std::ifstream::in);
       ifstderrStream.open(ofstderrStreamFilename, std::ifstream::in);
-      iretcStream.str(std::string("&mgm.proc.retc=") + std::to_string(reply.retc()));
+
+      // The fuse format returns just the raw output
+      if (mReqProto.format() != eos::console::RequestProto::FUSE) {
+        iretcStream.str(std::string("&mgm.proc.retc=") +
+                        std::to_string(reply.retc()));
+      }
+
       readStdOutStream = true;
     } else {
       std::ostringstream oss;
@@ -213,8 +219,11 @@ IProcCommand::OpenTemporaryOutputFiles()
     return false;
   }
 
-  ofstdoutStream << "mgm.proc.stdout=";
-  ofstderrStream << "&mgm.proc.stderr=";
+  if (mReqProto.format() != eos::console::RequestProto::FUSE) {
+    ofstdoutStream << "mgm.proc.stdout=";
+    ofstderrStream << "&mgm.proc.stderr=";
+  }
+
   return true;
 }
 
@@ -322,14 +322,37 @@ FsCmd::DumpMd(const eos::console::FsProto::DumpMdProto& dumpmdProto)
       }
     }
     std::string sfsid = std::to_string(dumpmdProto.fsid());
-    XrdOucString option = dumpmdProto.display() ==
-                          eos::console::FsProto::DumpMdProto::MONITOR ? "m" : "";
+    XrdOucString option = "";
+
+    if (dumpmdProto.display() == eos::console::FsProto::DumpMdProto::MONITOR) {
+      option = "m";
+    } else if (dumpmdProto.display() ==
+               eos::console::FsProto::DumpMdProto::STREAM) {
+      option = "b";
+    }
+
     XrdOucString dp = dumpmdProto.showpath() ? "1" : "0";
     XrdOucString df = dumpmdProto.showfid() ? "1" : "0";
     XrdOucString ds = dumpmdProto.showsize() ? "1" : "0";
     size_t entries = 0;
+    std::ostream* stream_out = nullptr;
+
+    // The stream display goes directly to the output file, it can be huge
+    if (option == "b") {
+      if (!OpenTemporaryOutputFiles()) {
+        mErr = "error: failed to open the temporary output files";
+        return EIO;
+      }
 
-    retc = SemaphoreProtectedProcDumpmd(sfsid, option, dp, df, ds, outLocal, errLocal, entries);
+      stream_out = &ofstdoutStream;
+    }
+
+    retc = SemaphoreProtectedProcDumpmd(sfsid, option, dp, df, ds, outLocal,
+                                        errLocal, entries, stream_out);
+
+    if (stream_out) {
+      CloseTemporaryOutputFiles();
+    }
 
     if (!retc) {
       gOFS->MgmStats.Add("DumpMd", mVid.uid, mVid.gid, entries);
@@ -774,7 +797,8 @@ eos::mgm::FsCmd::DisplayModeToString(eos::console::FsProto::LsProto::DisplayMode
 int
 FsCmd::SemaphoreProtectedProcDumpmd(std::string& fsid, XrdOucString& option, XrdOucString& dp,
                                     XrdOucString& df, XrdOucString& ds, XrdOucString& out,
-                                    XrdOucString& err, size_t& entries) {
+                                    XrdOucString& err, size_t& entries,
+                                    std::ostream* stream_out) {
   try {
     mSemaphore.Wait();
   } catch (...) {
@@ -783,7 +807,7 @@ FsCmd::SemaphoreProtectedProcDumpmd(std::string& fsid, XrdOucString& option, Xrd
   }
 
   retc = proc_fs_dumpmd(fsid, option, dp, df, ds, out, err,
-                        mVid, entries);
+                        mVid, entries, stream_out);
 
   try {
     mSemaphore.Post();
@@ -86,7 +86,8 @@ private:
 
   int SemaphoreProtectedProcDumpmd(std::string& fsid, XrdOucString& option, XrdOucString& dp,
                                    XrdOucString& df, XrdOucString& ds, XrdOucString& out,
-                                   XrdOucString& err, size_t& entries);
+                                   XrdOucString& err, size_t& entries,
+                                   std::ostream* stream_out);
 
   template <class T, std::size_t N>
   static constexpr std::size_t SizeOfArray(const T (&array)[N]) noexcept
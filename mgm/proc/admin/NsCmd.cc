@@ -27,6 +27,8 @@
 #include "namespace/interface/IChLogContainerMDSvc.hh"
 #include "namespace/interface/IContainerMDSvc.hh"
 #include "namespace/interface/IFileMDSvc.hh"
+#include "namespace/interface/IFlusherStats.hh"
+#include "namespace/interface/IAccountingStats.hh"
 #include "namespace/interface/IView.hh"
 #include "mgm/XrdMgmOfs.hh"
 #include "mgm/Quota.hh"
@@ -261,6 +263,26 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
     latencyp = chlog_file_svc->getFollowPending();
   }
 
+  // Statistics of the metadata flusher for namespaces flushing asynchronously
+  eos::FlusherStats flusher_stats;
+  auto flusher_svc = dynamic_cast<eos::IFlusherStats*>(gOFS->eosFileService);
+
+  if (flusher_svc) {
+    flusher_svc->getFlusherStats(flusher_stats);
+  }
+
+  // Statistics of the asynchronous subtree accounting
+  eos::AccountingStats acc_stats;
+  auto acc_svc = dynamic_cast<eos::IAccountingStats*>
+                 (gOFS->eosContainerAccounting);
+
+  if (acc_svc) {
+    acc_svc->getAccountingStats(acc_stats);
+  }
+
+  char coalescing_ratio[32];
+  snprintf(coalescing_ratio, sizeof(coalescing_ratio), "%.2f",
+           flusher_stats.GetCoalescingRatio());
   XrdOucString compact_status = "", master_status = "";
   gOFS->MgmMaster.PrintOutCompacting(compact_status);
   gOFS->MgmMaster.PrintOut(master_status);
@@ -298,6 +320,36 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
         << "uid=all gid=all ns.memory.share=" << mem.share << std::endl
         << "uid=all gid=all ns.stat.threads=" << pstat.threads << std::endl;
 
+    if (flusher_svc) {
+      oss << "uid=all gid=all ns.flusher.coalescing="
+          << (flusher_stats.mCoalescing ? "on" : "off") << std::endl
+          << "uid=all gid=all ns.flusher.updates=" << flusher_stats.mUpdates
+          << std::endl
+          << "uid=all gid=all ns.flusher.requests=" << flusher_stats.mRequests
+          << std::endl
+          << "uid=all gid=all ns.flusher.coalescing.ratio=" << coalescing_ratio
+          << std::endl
+          << "uid=all gid=all ns.flusher.queue.staged=" << flusher_stats.mStaged
+          << std::endl
+          << "uid=all gid=all ns.flusher.queue.pending=" << flusher_stats.mPending
+          << std::endl;
+    }
+
+    if (acc_svc) {
+      oss << "uid=all gid=all ns.accounting.queue.depth="
+          << acc_stats.mQueueDepth << std::endl
+          << "uid=all gid=all ns.accounting.batch.last=" << acc_stats.mLastBatchSize
+          << std::endl
+          << "uid=all gid=all ns.accounting.latency.last.ms="
+          << acc_stats.mLastLatencyMs << std::endl
+          << "uid=all gid=all ns.accounting.latency.max.ms="
+          << acc_stats.mMaxLatencyMs << std::endl
+          << "uid=all gid=all ns.accounting.propagations="
+          << acc_stats.mNumPropagations << std::endl
+          << "uid=all gid=all ns.accounting.updates=" << acc_stats.mNumUpdates
+          << std::endl;
+    }
+
     if (pstat.vsize > gOFS->LinuxStatsStartup.vsize) {
       oss << "uid=all gid=all ns.memory.growth=" << (unsigned long long)
           (pstat.vsize - gOFS->LinuxStatsStartup.vsize) << std::endl;
@@ -332,6 +384,29 @@ NsCmd::StatSubcmd(const eos::console::NsProto_StatProto& stat)
           << "ALL      Namespace Pending Updates        " << latencyp << std::endl;
     }
 
+    if (flusher_svc) {
+      oss << line << std::endl
+          << "ALL      Flusher coalescing               "
+          << (flusher_stats.mCoalescing ? "on" : "off") << " (ratio "
+          << coalescing_ratio << ")" << std::endl
+          << "ALL      Flusher staged updates           "
+          << flusher_stats.mStaged << std::endl
+          << "ALL      Flusher queue depth              "
+          << flusher_stats.mPending << std::endl;
+    }
+
+    if (acc_svc) {
+      oss << line << std::endl
+          << "ALL      Accounting queue depth           "
+          << acc_stats.mQueueDepth << std::endl
+          << "ALL      Accounting last batch            "
+          << acc_stats.mLastBatchSize << " (" << acc_stats.mLastLatencyMs
+          << "ms, max " << acc_stats.mMaxLatencyMs << "ms)" << std::endl
+          << "ALL      Accounting propagations          "
+          << acc_stats.mNumPropagations << " (updates "
+          << acc_stats.mNumUpdates << ")" << std::endl;
+    }
+
     oss << line << std::endl
         << "ALL      File Changelog Size              " << clfsize << std::endl
         << "ALL      Dir  Changelog Size              " << cldsize << std::endl
@@ -578,6 +653,7 @@ NsCmd::UpdateTreeSize(eos::IContainerMD* cont) const
   std::shared_ptr<eos::IFileMD> tmp_fmd {nullptr};
   std::shared_ptr<eos::IContainerMD> tmp_cont {nullptr};
   uint64_t tree_size = 0u;
+  eos::ReadLockGuard children_lock(cont->getChildrenLock());
 
   for (auto fit = cont->filesBegin(); fit != cont->filesEnd(); ++fit) {
     try {
@@ -634,6 +710,8 @@ NsCmd::BreadthFirstSearchContainers(eos::IContainerMD* cont,
         continue;
       }
 
+      eos::ReadLockGuard children_lock(tmp_cont->getChildrenLock());
+
       for (auto subcont_it = tmp_cont->subcontainersBegin();
            subcont_it != tmp_cont->subcontainersEnd(); ++subcont_it) {
         it_next_lvl->push_back(subcont_it->second);
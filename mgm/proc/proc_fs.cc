@@ -30,6 +30,8 @@
 #include "common/LayoutId.hh"
 #include "common/StringConversion.hh"
 #include "common/Path.hh"
+#include "proto/Fs.pb.h"
+#include <google/protobuf/io/coded_stream.h>
 
 EOSMGMNAMESPACE_BEGIN
 
@@ -115,6 +117,72 @@ MvOpType get_operation_type(const std::string& in1, const std::string& in2,
   return MvOpType::UNKNOWN;
 }
 
+namespace
+{
+//! Size of the records buffered before writing them to the dumpmd stream
+const size_t sDumpMdBufferSize = 64 * 1024;
+//! Number of files dumped per namespace lock acquisition
+const size_t sDumpMdBatchSize = 1024;
+
+//------------------------------------------------------------------------------
+// Append a file as a length-delimited record of the dumpmd stream display
+//------------------------------------------------------------------------------
+void
+AppendDumpMdRecord(eos::IFileMD* fmd, std::string& records)
+{
+  eos::console::FileMdDumpProto entry;
+  eos::IFileMD::ctime_t ctime;
+  eos::IFileMD::ctime_t mtime;
+  (void) fmd->getCTime(ctime);
+  (void) fmd->getMTime(mtime);
+  entry.set_fid(fmd->getId());
+  entry.set_cid(fmd->getContainerId());
+  entry.set_ctime(ctime.tv_sec);
+  entry.set_ctimens(ctime.tv_nsec);
+  entry.set_mtime(mtime.tv_sec);
+  entry.set_mtimens(mtime.tv_nsec);
+  entry.set_size(fmd->getSize());
+  entry.set_lid(fmd->getLayoutId());
+  entry.set_uid(fmd->getCUid());
+  entry.set_gid(fmd->getCGid());
+  eos::Buffer xs = fmd->getChecksum();
+  std::string* hex_xs = entry.mutable_checksum();
+
+  for (size_t i = 0; i < xs.size(); ++i) {
+    char hx[3];
+    snprintf(hx, sizeof(hx), "%02x", *(unsigned char*)(xs.getDataPtr() + i));
+    *hex_xs += hx;
+  }
+
+  for (const auto& loc : fmd->getLocations()) {
+    entry.add_locations(loc);
+  }
+
+  for (const auto& loc : fmd->getUnlinkedLocations()) {
+    entry.add_unlinkedlocations(loc);
+  }
+
+  std::string raw = entry.SerializeAsString();
+  uint8_t header[5];
+  uint8_t* end = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(
+                   raw.size(), header);
+  records.append((const char*) header, end - header);
+  records += raw;
+}
+
+//------------------------------------------------------------------------------
+// Write the pending records of the dumpmd stream display
+//------------------------------------------------------------------------------
+void
+FlushDumpMdRecords(std::string& records, std::ostream& out)
+{
+  if (!records.empty()) {
+    out.write(records.data(), records.size());
+    records.clear();
+  }
+}
+}
+
 //------------------------------------------------------------------------------
 // Dump metadata information
 //------------------------------------------------------------------------------
@@ -122,7 +190,8 @@ int
 proc_fs_dumpmd(std::string& fsidst, XrdOucString& option, XrdOucString& dp,
                XrdOucString& df, XrdOucString& ds, XrdOucString& stdOut,
                XrdOucString& stdErr,
-               eos::common::Mapping::VirtualIdentity& vid_in, size_t& entries)
+               eos::common::Mapping::VirtualIdentity& vid_in, size_t& entries,
+               std::ostream* stream_out)
 {
   entries = 0;
   int retc = 0;
@@ -130,8 +199,12 @@ proc_fs_dumpmd(std::string& fsidst, XrdOucString& option, XrdOucString& dp,
   bool dumpfid = false;
   bool dumpsize = false;
   bool monitor = false;
+  bool stream = false;
+  std::string records;
 
-  if (option != "m") {
+  if (option == "b") {
+    stream = true;
+  } else if (option != "m") {
     if (dp == "1") {
       dumppath = true;
     }
@@ -147,24 +220,73 @@ proc_fs_dumpmd(std::string& fsidst, XrdOucString& option, XrdOucString& dp,
     monitor = true;
   }
 
-  if (!fsidst.length()) {
+  if (!fsidst.length() || (stream && !stream_out)) {
     stdErr = "error: illegal parameters";
     retc = EINVAL;
   } else {
     int fsid = atoi(fsidst.c_str());
+
+    if (stream) {
+      *stream_out << EOS_DUMPMD_STREAM_TAG;
+    }
+
     std::shared_ptr<eos::IFileMD> fmd;
+    std::shared_ptr<eos::ICollectionIterator<std::shared_ptr<eos::IFileMD>>>
+        it_fmd;
     eos::common::RWMutexReadLock ns_rd_lock;
-    ns_rd_lock.Grab(gOFS->eosViewRWMutex);
 
-    for (auto it_fid = gOFS->eosFsView->getFileList(fsid);
-         (it_fid && it_fid->valid()); it_fid->next()) {
-      try {
-        fmd = gOFS->eosFileService->getFileMD(it_fid->getElement());
+    // With QuarkDB this waits for the flusher and starts the backend scan,
+    // which must not happen under the namespace lock
+    if (gOFS->NsInQDB) {
+      it_fmd = gOFS->eosFsView->getStreamingFileMDList(fsid,
+               gOFS->eosFileService);
+    } else {
+      ns_rd_lock.Grab(gOFS->eosViewRWMutex);
+      it_fmd = gOFS->eosFsView->getStreamingFileMDList(fsid,
+               gOFS->eosFileService);
+      ns_rd_lock.Release();
+    }
+
+    std::vector<std::pair<eos::IFileMD::id_t, std::shared_ptr<eos::IFileMD>>>
+        batch;
+
+    // Stream the file metadata batch by batch, the backend fetches it ahead
+    // of us and the namespace lock is released between batches to let the
+    // writers progress
+    while (it_fmd && it_fmd->valid()) {
+      batch.clear();
+
+      // The QuarkDB iterator talks only to the backend and to the file cache,
+      // the in-memory one walks through the view
+      if (!gOFS->NsInQDB) {
+        ns_rd_lock.Grab(gOFS->eosViewRWMutex);
+      }
+
+      for (; it_fmd->valid() && (batch.size() < sDumpMdBatchSize);
+           it_fmd->next()) {
+        fmd = it_fmd->getElement();
 
         if (fmd) {
+          batch.emplace_back(fmd->getId(), fmd);
+        }
+      }
+
+      if (gOFS->NsInQDB) {
+        ns_rd_lock.Grab(gOFS->eosViewRWMutex);
+      }
+
+      for (const auto& elem : batch) {
+        try {
+          fmd = elem.second;
           entries++;
 
-          if ((!dumppath) && (!dumpfid) && (!dumpsize)) {
+          if (stream) {
+            AppendDumpMdRecord(fmd.get(), records);
+
+            if (records.size() >= sDumpMdBufferSize) {
+              FlushDumpMdRecords(records, *stream_out);
+            }
+          } else if ((!dumppath) && (!dumpfid) && (!dumpsize)) {
             std::string env;
             fmd->getEnv(env, true);
             XrdOucString senv = env.c_str();
@@ -220,23 +342,20 @@ proc_fs_dumpmd(std::string& fsidst, XrdOucString& option, XrdOucString& dp,
 
             stdOut += "\n";
           }
+        } catch (eos::MDException& e) {
+          errno = e.getErrno();
+          eos_static_err("Couldn't retrieve meta data for file id: %llu. Error "
+                         "code: %d, message: %s", (unsigned long long) elem.first,
+                         e.getErrno(), e.getMessage().str().c_str());
         }
-      } catch (eos::MDException& e) {
-        errno = e.getErrno();
-        eos_static_err("Couldn't retrieve meta data for file id: %u. Error "
-                       "code: %d, message: %s", it_fid->getElement(),
-                       e.getErrno(), e.getMessage().str().c_str());
       }
 
-      // Release the lock from time to time to let writers progress
-      if (entries % 1024 == 0) {
-        ns_rd_lock.Release();
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        ns_rd_lock.Grab(gOFS->eosViewRWMutex);
-      }
+      ns_rd_lock.Release();
     }
 
-    if (monitor) {
+    ns_rd_lock.Grab(gOFS->eosViewRWMutex);
+
+    if (monitor || stream) {
       // Also add files which have yet to be unlinked
       for (auto it_fid = gOFS->eosFsView->getUnlinkedFileList(fsid);
            (it_fid && it_fid->valid()); it_fid->next()) {
@@ -245,12 +364,21 @@ proc_fs_dumpmd(std::string& fsidst, XrdOucString& option, XrdOucString& dp,
 
           if (fmd) {
             entries++;
-            std::string env;
-            fmd->getEnv(env, true);
-            XrdOucString senv = env.c_str();
-            senv.replace("checksum=&", "checksum=none&");
-            stdOut += senv.c_str();
-            stdOut += "&container=-\n";
+
+            if (stream) {
+              AppendDumpMdRecord(fmd.get(), records);
+
+              if (records.size() >= sDumpMdBufferSize) {
+                FlushDumpMdRecords(records, *stream_out);
+              }
+            } else {
+              std::string env;
+              fmd->getEnv(env, true);
+              XrdOucString senv = env.c_str();
+              senv.replace("checksum=&", "checksum=none&");
+              stdOut += senv.c_str();
+              stdOut += "&container=-\n";
+            }
 
             // Release the lock from time to time to let writers progress
             if (entries % 1024 == 0) {
@@ -267,6 +395,18 @@ proc_fs_dumpmd(std::string& fsidst, XrdOucString& option, XrdOucString& dp,
         }
       }
     }
+
+    if (stream) {
+      // The empty end record tells the reader that the dump is complete
+      records.push_back('\0');
+      FlushDumpMdRecords(records, *stream_out);
+      stream_out->flush();
+
+      if (!*stream_out) {
+        stdErr = "error: failed to write the dumpmd output";
+        retc = EIO;
+      }
+    }
   }
 
   return retc;
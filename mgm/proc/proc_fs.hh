@@ -30,6 +30,7 @@
 #include "mgm/FileSystem.hh"
 #include "mgm/FsView.hh"
 #include "XrdSec/XrdSecEntity.hh"
+#include <iosfwd>
 
 EOSMGMNAMESPACE_BEGIN
 
@@ -52,11 +53,14 @@ enum class MvOpType {
 
 //------------------------------------------------------------------------------
 //! Dump metadata held on filesystem
+//!
+//! @param stream_out output of the stream display (option "b") which is
+//!        written directly instead of being accumulated in stdOut
 //------------------------------------------------------------------------------
 int proc_fs_dumpmd(std::string& fsidst, XrdOucString& option, XrdOucString& dp,
                    XrdOucString& df, XrdOucString& ds, XrdOucString& stdOut,
                    XrdOucString& stdErr, eos::common::Mapping::VirtualIdentity& vid_in,
-                   size_t& entries);
+                   size_t& entries, std::ostream* stream_out = nullptr);
 
 //------------------------------------------------------------------------------
 //! Dump metada held on filesystem
@@ -1204,6 +1204,7 @@ ProcCommand::DirJSON(uint64_t fid, Json::Value* ret_json)
     Json::Value chld;
 
     if (!ret_json) {
+      eos::ReadLockGuard children_lock(cmd->getChildrenLock());
       auto fit_begin = cmd->filesBegin();
       auto fit_end = cmd->filesEnd();
 
@@ -0,0 +1,317 @@
+// ----------------------------------------------------------------------
+// File: MgmViewSnapshotBench.cc
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! Stress benchmark comparing the latency of the placement group selection
+//! and of the placement and access done by the open path, once under the
+//! FsView::ViewMutex like open() used to do and once on the published FsView
+//! snapshot, while a writer thread keeps taking the ViewMutex in write mode
+//! like 'fs config' and 'fs mv' do.
+//!
+//! Usage: eos-mgm-view-snapshot-bench [readers] [seconds] [hold_us]
+//------------------------------------------------------------------------------
+
+#include "mgm/FsView.hh"
+#include "mgm/GeoTreeEngine.hh"
+#include "mgm/Quota.hh"
+#include "mgm/Scheduler.hh"
+#include "common/LayoutId.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace eos::mgm;
+
+namespace
+{
+const std::string sSpace = "default";
+const unsigned int sNumGroups = 64;
+const unsigned int sFsPerGroup = 8;
+std::atomic<bool> sStop(false);
+std::atomic<uint64_t> sWrites(0);
+std::atomic<uint64_t> sFailures(0);
+
+//------------------------------------------------------------------------------
+// Group selection under the ViewMutex as done by the original scheduler
+//------------------------------------------------------------------------------
+unsigned int
+SelectLocked(unsigned int pos)
+{
+  eos::common::RWMutexReadLock rd_lock(FsView::gFsView.ViewMutex);
+  auto it_space = FsView::gFsView.mSpaceGroupView.find(sSpace);
+
+  if ((it_space == FsView::gFsView.mSpaceGroupView.end()) ||
+      it_space->second.empty()) {
+    return 0;
+  }
+
+  auto git = it_space->second.begin();
+  std::advance(git, pos % it_space->second.size());
+  return (*git)->GetIndex();
+}
+
+//------------------------------------------------------------------------------
+// Group selection on the published snapshot
+//------------------------------------------------------------------------------
+unsigned int
+SelectSnapshot(unsigned int pos)
+{
+  std::shared_ptr<const FsViewSnapshot> view = FsView::gFsView.GetSnapshot();
+  const FsViewSnapshot::GroupVector* groups = view->GetGroups(sSpace);
+
+  if (!groups || groups->empty()) {
+    return 0;
+  }
+
+  return (*groups)[pos % groups->size()]->GetIndex();
+}
+
+//------------------------------------------------------------------------------
+// Placement of a new file with 2 replicas followed by the access to it, with
+// the same calls as the open path
+//------------------------------------------------------------------------------
+unsigned int
+OpenPath(unsigned int pos)
+{
+  static const unsigned long lid = eos::common::LayoutId::GetId(
+                                     eos::common::LayoutId::kReplica,
+                                     eos::common::LayoutId::kAdler, 2);
+  eos::common::Mapping::VirtualIdentity vid;
+  eos::common::Mapping::Root(vid);
+  std::string spacename = sSpace;
+  std::string targetgeotag;
+  std::vector<unsigned int> selectedfs;
+  std::vector<unsigned int> unavailfs;
+  std::vector<std::string> proxys;
+  std::vector<std::string> firewalleps;
+  Scheduler::PlacementArguments plctargs;
+  plctargs.alreadyused_filesystems = &selectedfs;
+  plctargs.bookingsize = 1024 * 1024;
+  plctargs.dataproxys = &proxys;
+  plctargs.firewallentpts = &firewalleps;
+  plctargs.lid = lid;
+  plctargs.inode = pos;
+  plctargs.path = "/eos/bench/file";
+  plctargs.plctTrgGeotag = &targetgeotag;
+  plctargs.selected_filesystems = &selectedfs;
+  plctargs.spacename = &spacename;
+  plctargs.vid = &vid;
+
+  if (Quota::FilePlacement(&plctargs) || selectedfs.empty()) {
+    ++sFailures;
+    return 0;
+  }
+
+  unsigned long fsindex = 0;
+  std::string tried_cgi;
+  Scheduler::AccessArguments acsargs;
+  acsargs.dataproxys = &proxys;
+  acsargs.firewallentpts = &firewalleps;
+  acsargs.forcedspace = sSpace.c_str();
+  acsargs.fsindex = &fsindex;
+  acsargs.lid = lid;
+  acsargs.inode = pos;
+  acsargs.locationsfs = &selectedfs;
+  acsargs.tried_cgi = &tried_cgi;
+  acsargs.unavailfs = &unavailfs;
+  acsargs.vid = &vid;
+
+  if (Quota::FileAccess(&acsargs)) {
+    ++sFailures;
+    return 0;
+  }
+
+  return selectedfs[fsindex];
+}
+
+//------------------------------------------------------------------------------
+// Open path with the ViewMutex held across placement and access
+//------------------------------------------------------------------------------
+unsigned int
+OpenLocked(unsigned int pos)
+{
+  eos::common::RWMutexReadLock rd_lock(FsView::gFsView.ViewMutex);
+  return OpenPath(pos);
+}
+
+//------------------------------------------------------------------------------
+// Writer emulating configuration changes: take the write lock, hold it for
+// the given time, and every few iterations change the group membership of
+// the space and publish a new snapshot.
+//------------------------------------------------------------------------------
+void
+Writer(unsigned int hold_us)
+{
+  uint64_t iter = 0;
+
+  while (!sStop) {
+    {
+      eos::common::RWMutexWriteLock wr_lock(FsView::gFsView.ViewMutex);
+      auto start = std::chrono::steady_clock::now();
+
+      if ((iter % 4) == 0) {
+        std::set<FsGroup*>& groups = FsView::gFsView.mSpaceGroupView[sSpace];
+        FsGroup* group = FsView::gFsView.mGroupView[
+                           "default." + std::to_string(iter % sNumGroups)];
+
+        if (groups.count(group)) {
+          groups.erase(group);
+        } else {
+          groups.insert(group);
+        }
+
+        FsView::gFsView.PublishSnapshot();
+      }
+
+      while (std::chrono::steady_clock::now() - start <
+             std::chrono::microseconds(hold_us)) {}
+    }
+
+    ++iter;
+    ++sWrites;
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Run one benchmark round and print the latency distribution
+//------------------------------------------------------------------------------
+void
+Run(const char* name, unsigned int (*select)(unsigned int),
+    unsigned int nreaders, unsigned int seconds, unsigned int hold_us)
+{
+  std::vector<std::vector<uint64_t>> latencies(nreaders);
+  std::vector<std::thread> readers;
+  sStop = false;
+  sWrites = 0;
+  sFailures = 0;
+  std::thread writer(Writer, hold_us);
+
+  for (unsigned int i = 0; i < nreaders; ++i) {
+    readers.emplace_back([i, select, &latencies]() {
+      unsigned int pos = i;
+      uint64_t sum = 0;
+
+      while (!sStop) {
+        auto start = std::chrono::steady_clock::now();
+        sum += select(pos++);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        latencies[i].push_back(std::chrono::duration_cast
+                               <std::chrono::nanoseconds>(elapsed).count());
+      }
+
+      // Keep the selection from being optimized away
+      if (sum == 0xffffffffffffffffull) {
+        fprintf(stderr, "%llu\n", (unsigned long long) sum);
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  sStop = true;
+
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  writer.join();
+  std::vector<uint64_t> all;
+
+  for (auto& lat : latencies) {
+    all.insert(all.end(), lat.begin(), lat.end());
+  }
+
+  if (all.empty()) {
+    return;
+  }
+
+  std::sort(all.begin(), all.end());
+  auto pct = [&all](double p) {
+    return (unsigned long long) all[std::min(all.size() - 1,
+                                    (size_t)(p * all.size()))];
+  };
+  fprintf(stdout, "%-13s readers=%u ops=%zu writes=%llu failed=%llu ops/s=%.0f "
+          "p50=%lluns p99=%lluns p99.9=%lluns max=%lluns\n", name, nreaders,
+          all.size(), (unsigned long long) sWrites.load(),
+          (unsigned long long) sFailures.load(),
+          1.0 * all.size() / seconds, pct(0.5), pct(0.99), pct(0.999),
+          (unsigned long long) all.back());
+}
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int nreaders = (argc > 1) ? atoi(argv[1]) : 8;
+  unsigned int seconds = (argc > 2) ? atoi(argv[2]) : 5;
+  unsigned int hold_us = (argc > 3) ? atoi(argv[3]) : 200;
+  eos::common::Logging& g_logging = eos::common::Logging::GetInstance();
+  g_logging.SetUnit("MgmViewSnapshotBench");
+  g_logging.SetLogPriority(LOG_INFO);
+  {
+    eos::common::RWMutexWriteLock wr_lock(FsView::gFsView.ViewMutex);
+    eos::common::FileSystem::fsid_t fsid = 0;
+
+    for (unsigned int i = 0; i < sNumGroups; ++i) {
+      std::string name = "default." + std::to_string(i);
+      FsView::gFsView.RegisterGroup(name.c_str());
+      FsGroup* group = FsView::gFsView.mGroupView[name];
+      FsView::gFsView.mSpaceGroupView[sSpace].insert(group);
+
+      // the scheduling tree of the group, one fs per host on two racks
+      for (unsigned int j = 0; j < sFsPerGroup; ++j) {
+        eos::common::FileSystem::fs_snapshot_t fsn;
+        fsn.mId = ++fsid;
+        fsn.mGroup = name;
+        fsn.mHost = "host" + std::to_string(fsid) + ".bench";
+        fsn.mHostPort = fsn.mHost + ":1095";
+        fsn.mGeoTag = "site::rack" + std::to_string(j % 2);
+        fsn.mFileStickyProxyDepth = -1;
+        fsn.mStatus = eos::common::FileSystem::kBooted;
+        fsn.mConfigStatus = eos::common::FileSystem::kRW;
+        fsn.mActiveStatus = eos::common::FileSystem::kOnline;
+        fsn.mErrCode = 0;
+        fsn.mHeadRoom = 0;
+        fsn.mDiskUtilization = 0.1;
+        fsn.mNetEthRateMiB = 1250;
+        fsn.mDiskFilled = 10;
+        fsn.mDiskBsize = 4096;
+        fsn.mDiskBfree = 1ll << 30;
+
+        if (!gGeoTreeEngine.insertFsIntoGroup(fsn, group)) {
+          fprintf(stderr, "error: failed to insert fsid=%u\n", fsid);
+          return 1;
+        }
+      }
+    }
+
+    FsView::gFsView.PublishSnapshot();
+  }
+  Run("locked", SelectLocked, nreaders, seconds, hold_us);
+  Run("snapshot", SelectSnapshot, nreaders, seconds, hold_us);
+  Run("open-locked", OpenLocked, nreaders, seconds, hold_us);
+  Run("open-snapshot", OpenPath, nreaders, seconds, hold_us);
+  return 0;
+}
@@ -24,11 +24,202 @@
 #define TRACE_debug 0xffff
 #include <mq/XrdMqClient.hh>
 #include <mq/XrdMqTiming.hh>
+#include <mq/XrdMqLockFreeQueue.hh>
+#include <mq/XrdMqSubscriptionIndex.hh>
 #include <XrdSys/XrdSysLogger.hh>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <random>
 #include <stdio.h>
 
+//------------------------------------------------------------------------------
+//! Output queue of the benchmark broker
+//------------------------------------------------------------------------------
+struct BenchQueue {
+  std::string name;
+  bool advisorystatus;
+  XrdSysMutex mutex;
+  std::deque<int*> locked;
+  XrdMqLockFreeQueue<int*> lockfree;
+};
+
+//------------------------------------------------------------------------------
+// Broker throughput benchmark - matches and enqueues a mix of FST
+// broadcasts, named messages, MGM broadcasts and status advisories against a
+// broker with many connected queues. The linear scan over all queues with
+// string matching and locked queues is compared with the subscription index
+// and lock-free queues. No broker connection is needed.
+//
+// usage: xrdmqclienttest bench [queues] [messages]
+//------------------------------------------------------------------------------
+int
+BrokerBenchmark(int argc, char* argv[])
+{
+  size_t nqueues = (argc > 2) ? strtoul(argv[2], 0, 10) : 2000;
+  size_t nmessages = (argc > 3) ? strtoul(argv[3], 0, 10) : 20000;
+  std::map<std::string, BenchQueue*> queues;
+  std::vector<std::unique_ptr<BenchQueue>> storage;
+  XrdMqSubscriptionIndex<BenchQueue*> index;
+  std::vector<std::string> names;
+
+  for (size_t i = 0; i < nqueues + 100; ++i) {
+    char name[256];
+
+    if (i < nqueues) {
+      snprintf(name, sizeof(name), "/eos/fst%05lu.cern.ch:1095/fst", i);
+    } else if (i < nqueues + 98) {
+      snprintf(name, sizeof(name), "/eos/client%03lu.cern.ch/fusex", i);
+    } else {
+      snprintf(name, sizeof(name), "/eos/mgm%lu.cern.ch:1094/mgm", i);
+    }
+
+    storage.emplace_back(new BenchQueue());
+    BenchQueue* q = storage.back().get();
+    q->name = name;
+    q->advisorystatus = (i >= nqueues + 98);
+    queues[name] = q;
+    index.Attach(name, q, q->advisorystatus, false);
+    names.push_back(name);
+  }
+
+  // The message mix as (receiver, status advisory)
+  std::vector<std::pair<std::string, bool>> messages;
+  std::mt19937 gen(1);
+
+  for (size_t i = 0; i < nmessages; ++i) {
+    unsigned int type = gen() % 10;
+
+    if (type < 4) {
+      messages.emplace_back("/eos/*/fst", false);
+    } else if (type < 8) {
+      messages.emplace_back(names[gen() % nqueues], false);
+    } else if (type < 9) {
+      messages.emplace_back("/eos/*/mgm", false);
+    } else {
+      messages.emplace_back("/eos/*", true);
+    }
+  }
+
+  int payload = 0;
+  const std::string sender = names[0];
+  size_t delivered[2] = {0, 0};
+  double elapsed[2];
+
+  for (int mode = 0; mode < 2; ++mode) {
+    std::vector<BenchQueue*> matched;
+    XrdMqSubscriptionIndex<BenchQueue*>::SubscriberList scratch;
+    auto start = std::chrono::steady_clock::now();
+
+    for (const auto& msg : messages) {
+      matched.clear();
+
+      if (mode == 0) {
+        // linear scan of all the queues unless a single queue is addressed
+        if (msg.first.find('*') == std::string::npos) {
+          auto it = queues.find(msg.first);
+
+          if (it != queues.end()) {
+            matched.push_back(it->second);
+          }
+        } else {
+          for (auto it = queues.begin(); it != queues.end(); ++it) {
+            if (sender == it->first) {
+              continue;
+            }
+
+            if (msg.second) {
+              if (it->second->advisorystatus) {
+                matched.push_back(it->second);
+              }
+
+              continue;
+            }
+
+            XrdOucString Key = it->first.c_str();
+            XrdOucString nowildcard = msg.first.c_str();
+            nowildcard.replace("*", "");
+            int nmatch = Key.matches(msg.first.c_str(), '*');
+
+            if (nmatch == nowildcard.length()) {
+              matched.push_back(it->second);
+            }
+          }
+        }
+
+        for (auto q : matched) {
+          q->mutex.Lock();
+        }
+
+        for (auto q : matched) {
+          q->locked.push_back(&payload);
+        }
+
+        for (auto q : matched) {
+          q->mutex.UnLock();
+        }
+      } else {
+        if (msg.second) {
+          for (const auto& sub : index.AdvisoryStatus()) {
+            if (sender != sub.first) {
+              matched.push_back(sub.second);
+            }
+          }
+        } else if (msg.first.find('*') == std::string::npos) {
+          auto it = queues.find(msg.first);
+
+          if (it != queues.end()) {
+            matched.push_back(it->second);
+          }
+        } else {
+          for (const auto& sub : index.Match(msg.first, scratch)) {
+            if (sender != sub.first) {
+              matched.push_back(sub.second);
+            }
+          }
+        }
+
+        for (auto q : matched) {
+          q->lockfree.Push(&payload);
+        }
+      }
+
+      delivered[mode] += matched.size();
+    }
+
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    elapsed[mode] = d.count();
+
+    // drain the queues as the readers would
+    for (auto& q : storage) {
+      q->locked.clear();
+      q->lockfree.PopAll([](int*) {});
+    }
+  }
+
+  fprintf(stdout, "queues=%lu messages=%lu deliveries=%lu\n", queues.size(),
+          nmessages, delivered[0]);
+  fprintf(stdout, "linear  : %.02f messages/s %.02f deliveries/s\n",
+          nmessages / elapsed[0], delivered[0] / elapsed[0]);
+  fprintf(stdout, "indexed : %.02f messages/s %.02f deliveries/s speedup=%.02f\n",
+          nmessages / elapsed[1], delivered[1] / elapsed[1], elapsed[0] / elapsed[1]);
+
+  if (delivered[0] != delivered[1]) {
+    fprintf(stderr, "error: deliveries differ linear=%lu indexed=%lu\n",
+            delivered[0], delivered[1]);
+    return -1;
+  }
+
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
+  if ((argc > 1) && !strcmp(argv[1], "bench")) {
+    return BrokerBenchmark(argc, argv);
+  }
+
   printf("Starting up ...\n");
   XrdMqMessage::Logger = new XrdSysLogger();
   XrdMqMessage::Eroute.logger(XrdMqMessage::Logger);
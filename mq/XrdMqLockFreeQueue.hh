@@ -0,0 +1,119 @@
+//------------------------------------------------------------------------------
+//! @file XrdMqLockFreeQueue.hh
+//! @brief Multi-producer single-consumer queue without locks
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __XRDMQ_LOCKFREEQUEUE_HH__
+#define __XRDMQ_LOCKFREEQUEUE_HH__
+
+#include <atomic>
+#include <cstddef>
+
+//------------------------------------------------------------------------------
+//! Queue where any number of producers push without taking a lock and a
+//! single consumer takes all the pending entries at once. The producers
+//! push onto a stack with one compare-and-swap, the consumer detaches the
+//! whole stack with one exchange and reverses it to get the entries back in
+//! the order they were pushed.
+//------------------------------------------------------------------------------
+template <typename T>
+class XrdMqLockFreeQueue
+{
+public:
+  XrdMqLockFreeQueue(): mHead(nullptr) {}
+
+  ~XrdMqLockFreeQueue()
+  {
+    Node* node = mHead.exchange(nullptr);
+
+    while (node) {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Add an entry - can be called concurrently
+  //----------------------------------------------------------------------------
+  void Push(const T& value)
+  {
+    Node* node = new Node(value);
+    node->next = mHead.load(std::memory_order_relaxed);
+
+    while (!mHead.compare_exchange_weak(node->next, node,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Take all the entries in FIFO order - only one consumer at a time
+  //!
+  //! @param func called with each entry
+  //!
+  //! @return number of entries taken
+  //----------------------------------------------------------------------------
+  template <typename Func>
+  size_t PopAll(Func func)
+  {
+    Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+    Node* fifo = nullptr;
+
+    while (node) {
+      Node* next = node->next;
+      node->next = fifo;
+      fifo = node;
+      node = next;
+    }
+
+    size_t n = 0;
+
+    while (fifo) {
+      Node* next = fifo->next;
+      func(fifo->value);
+      delete fifo;
+      fifo = next;
+      ++n;
+    }
+
+    return n;
+  }
+
+  bool Empty() const
+  {
+    return !mHead.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Node {
+    explicit Node(const T& v): value(v), next(nullptr) {}
+    T value;
+    Node* next;
+  };
+
+  std::atomic<Node*> mHead;
+
+  XrdMqLockFreeQueue(const XrdMqLockFreeQueue&) = delete;
+  XrdMqLockFreeQueue& operator=(const XrdMqLockFreeQueue&) = delete;
+};
+
+#endif
@@ -404,6 +404,7 @@ XrdMqOfsFile::open(const char*                queuename,
   Out->AdvisoryFlushBackLog = advisoryflushbacklog;
   Out->BrokenByFlush = false;
   gMqFS->QueueOut.insert(std::pair<std::string, XrdMqMessageOut*>(squeue, Out));
+  gMqFS->QueueIndex.Attach(squeue, Out, advisorystatus, advisoryquery);
   ZTRACE(open, "Connected Queue: " << queuename);
   IsOpen = true;
   return SFS_OK;
@@ -430,6 +431,7 @@ XrdMqOfsFile::close()
       // we have to take away all pending messages
       Out->RetrieveMessages();
       gMqFS->QueueOut.erase(squeue);
+      gMqFS->QueueIndex.Detach(squeue);
       delete Out;
     }
 
@@ -39,7 +39,7 @@
 #include <map>
 #include <string>
 #include <vector>
-#include <deque>
+#include <atomic>
 
 #include <utime.h>
 #include <pwd.h>
@@ -52,6 +52,8 @@
 #include "XrdSys/XrdSysPthread.hh"
 #include "XrdSys/XrdSysSemWait.hh"
 #include "XrdOfs/XrdOfs.hh"
+#include "mq/XrdMqLockFreeQueue.hh"
+#include "mq/XrdMqSubscriptionIndex.hh"
 
 class XrdSecEntity;
 
@@ -137,11 +139,13 @@ public:
   bool AdvisoryQuery;
   bool AdvisoryFlushBackLog;
   bool BrokenByFlush;
-  int  nQueued;
+  std::atomic<int> nQueued;
   XrdOucString QueueName;
   XrdSysSemWait DeletionSem;
   XrdSysSemWait MessageSem;
-  std::deque<XrdSmartOucEnv*> MessageQueue;
+  // filled by Deliver without taking the queue lock, emptied by
+  // RetrieveMessages with the queue lock held
+  XrdMqLockFreeQueue<XrdSmartOucEnv*> MessageQueue;
 
   XrdMqMessageOut(const char* queuename)
   {
@@ -152,7 +156,6 @@ public:
     BrokenByFlush = false;
     nQueued = 0;
     QueueName = queuename;
-    MessageQueue.clear();
   }
 
   virtual ~XrdMqMessageOut()
@@ -325,6 +328,8 @@ public:
   QueueOut;  // -> hash of all output's connected
   XrdSysMutex
   QueueOutMutex;  // -> mutex protecting the output hash
+  XrdMqSubscriptionIndex<XrdMqMessageOut*>
+  QueueIndex;  // -> wildcard and advisory matches, protected by QueueOutMutex
 
   bool             Deliver(XrdMqOfsMatches&
                            Match); // -> delivers a message into matching output queues
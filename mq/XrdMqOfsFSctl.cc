@@ -46,75 +46,48 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
   std::vector<XrdMqMessageOut*> MatchedOutputQueues;
   Matches.message->procmutex.Lock();
 
-  // If we have a status message we have to do a complete loop
+  // Status and query messages go to the queues which asked for advisories
   if (((Matches.messagetype) == XrdMqMessageHeader::kStatusMessage) ||
       ((Matches.messagetype) == XrdMqMessageHeader::kQueryMessage)) {
-    std::map<std::string, XrdMqMessageOut*>::const_iterator QueueOutIt;
-
-    for (QueueOutIt = QueueOut.begin(); QueueOutIt != QueueOut.end();
-         QueueOutIt++) {
-      XrdMqMessageOut* Out = QueueOutIt->second;
-
-      // if this would be a loop back message we continue
-      if (sendername == QueueOutIt->first) {
-        // avoid feedback to the same queue
+    const XrdMqSubscriptionIndex<XrdMqMessageOut*>::SubscriberList& subscribers =
+      ((Matches.messagetype) == XrdMqMessageHeader::kStatusMessage) ?
+      QueueIndex.AdvisoryStatus() : QueueIndex.AdvisoryQuery();
+    MatchedOutputQueues.reserve(subscribers.size());
+
+    for (const auto& sub : subscribers) {
+      // avoid feedback to the same queue
+      if (sendername == sub.first) {
         continue;
       }
 
-      // if this queue does not take advisory status messages we continue
-      if ((Matches.messagetype == XrdMqMessageHeader::kStatusMessage) &&
-          (!Out->AdvisoryStatus)) {
-        continue;
-      }
-
-      // if this queue does not take advisory query messages we continue
-      if ((Matches.messagetype == XrdMqMessageHeader::kQueryMessage)  &&
-          (!Out->AdvisoryQuery)) {
-        continue;
-      } else {
-        ZTRACE(fsctl, "Adding Advisory Message to Queuename: " <<
-               Out->QueueName.c_str());
-        MatchedOutputQueues.push_back(Out);
-      }
+      ZTRACE(fsctl, "Adding Advisory Message to Queuename: " <<
+             sub.second->QueueName.c_str());
+      MatchedOutputQueues.push_back(sub.second);
     }
   } else {
-    // If we have a wildcard match we have to do a complete loop
+    // Wildcard matches are looked up in the subscription index
     if ((Matches.queuename.find("*") != STR_NPOS)) {
-      std::map<std::string, XrdMqMessageOut*>::const_iterator QueueOutIt;
+      XrdMqSubscriptionIndex<XrdMqMessageOut*>::SubscriberList scratch;
+      const XrdMqSubscriptionIndex<XrdMqMessageOut*>::SubscriberList& subscribers =
+        QueueIndex.Match(Matches.queuename.c_str(), scratch);
+      MatchedOutputQueues.reserve(subscribers.size());
 
-      for (QueueOutIt = QueueOut.begin(); QueueOutIt != QueueOut.end();
-           QueueOutIt++) {
-        XrdMqMessageOut* Out = QueueOutIt->second;
-
-        // fprintf(stderr,"%s <=> %s\n", sendername.c_str(), QueueOutIt->first.c_str());
-        // If this would be a loop back message we continue
-        if (sendername == QueueOutIt->first) {
-          // avoid feedback to the same queue
+      for (const auto& sub : subscribers) {
+        // avoid feedback to the same queue
+        if (sendername == sub.first) {
           continue;
         }
 
-        XrdOucString Key = QueueOutIt->first.c_str();
-        XrdOucString nowildcard = Matches.queuename;
-        nowildcard.replace("*", "");
-        int nmatch = Key.matches(Matches.queuename.c_str(), '*');
-
-        if (nmatch == nowildcard.length()) {
-          // this is a match
-          ZTRACE(fsctl, "Adding Wildcard matched Message to Queuename: "
-                 << Out->QueueName.c_str());
-          MatchedOutputQueues.push_back(Out);
-        }
+        ZTRACE(fsctl, "Adding Wildcard matched Message to Queuename: "
+               << sub.second->QueueName.c_str());
+        MatchedOutputQueues.push_back(sub.second);
       }
     } else {
       // We have just to find one named queue
-      std::string queuename = Matches.queuename.c_str();
-      XrdMqMessageOut* Out = 0;
-
-      if (QueueOut.count(queuename)) {
-        Out = QueueOut[queuename];
-      }
+      auto it = QueueOut.find(Matches.queuename.c_str());
 
-      if (Out) {
+      if ((it != QueueOut.end()) && it->second) {
+        XrdMqMessageOut* Out = it->second;
         ZTRACE(fsctl, "Adding full matched Message to Queuename: " <<
                Out->QueueName.c_str());
         MatchedOutputQueues.push_back(Out);
@@ -127,12 +100,8 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
     Matches.backlog = false;
     Matches.backlogrejected = false;
 
-    // Lock all matched queues at once
-    for (unsigned int i = 0; i < MatchedOutputQueues.size(); ++i) {
-      XrdMqMessageOut* Out = MatchedOutputQueues[i];
-      Out->Lock();
-    }
-
+    // The queues are not locked - delivery is serialized by QueueOutMutex and
+    // the readers take the messages from the lock-free message queues
     for (unsigned int i = 0; i < MatchedOutputQueues.size(); ++i) {
       XrdMqMessageOut* Out = MatchedOutputQueues[i];
 
@@ -199,18 +168,12 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
           ZTRACE(fsctl, "Adding Message to Queuename: " << Out->QueueName.c_str());
           // fprintf(stderr, "%s adding message %llu\n",
           // Out->QueueName.c_str(), (unsigned long long)Matches.message);
-          Out->MessageQueue.push_back((Matches.message));
           Matches.message->AddRefs(1);
           Out->nQueued++;
+          Out->MessageQueue.Push(Matches.message);
         }
       }
     }
-
-    // Unlock all matched queues at once
-    for (unsigned int i = 0; i < MatchedOutputQueues.size(); ++i) {
-      XrdMqMessageOut* Out = MatchedOutputQueues[i];
-      Out->UnLock();
-    }
   }
 
   Matches.message->procmutex.UnLock();
@@ -225,11 +188,7 @@ XrdMqOfs::Deliver(XrdMqOfsMatches& Matches)
 size_t
 XrdMqMessageOut::RetrieveMessages()
 {
-  XrdSmartOucEnv* message;
-
-  while (MessageQueue.size()) {
-    message = MessageQueue.front();
-    MessageQueue.pop_front();
+  MessageQueue.PopAll([this](XrdSmartOucEnv * message) {
     message->procmutex.Lock();
     //    fprintf(stderr,"%llu %s Message %llu nref: %d\n", (unsigned long long) &MessageQueue, QueueName.c_str(), (unsigned long long) message, message->Refs());
     int len;
@@ -252,8 +211,7 @@ XrdMqMessageOut::RetrieveMessages()
 
     nQueued--;
     gMqFS->MessagesMutex.UnLock();
-  }
-
+  });
   return MessageBuffer.length();
 }
 
@@ -25,19 +25,33 @@
 #include "mq/XrdMqMessaging.hh"
 #include "mq/XrdMqStringConversion.hh"
 #include "common/Logging.hh"
+#include "proto/SharedHash.pb.h"
 #include "XrdSys/XrdSysTimer.hh"
 #include "XrdOuc/XrdOucEnv.hh"
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
 
 bool XrdMqSharedObjectManager::sDebug = 0;
 bool XrdMqSharedObjectManager::sBroadcast = true;
+bool XrdMqSharedObjectManager::sDelta =
+  (getenv("EOS_MQ_SHAREDHASH_DELTA") &&
+   !strcmp(getenv("EOS_MQ_SHAREDHASH_DELTA"), "1"));
+
+//! Maximum size of the deltas in one message - base64 encoded they stay
+//! below the 2M message limit
+static const size_t sMaxDeltaBytes = 1400 * 1000;
+//! Minimum interval between two resync requests for the same hash
+static const time_t sResyncInterval = 10;
 
 // Static counters
 std::atomic<unsigned long long> XrdMqSharedHash::sSetCounter {0};
 std::atomic<unsigned long long> XrdMqSharedHash::sSetNLCounter = {0};
 std::atomic<unsigned long long> XrdMqSharedHash::sGetCounter = {0};
+std::atomic<unsigned long long> XrdMqSharedHash::sDeltaGapCounter = {0};
 
 __thread XrdMqSharedObjectChangeNotifier::Subscriber*
 XrdMqSharedObjectChangeNotifier::tlSubscriber = NULL;
@@ -173,6 +187,17 @@ XrdMqSharedHashEntry::Dump(XrdOucString& out)
 //                 * * * Class XrdMqSharedObjectHash * * *
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Generate a random non-zero epoch for the deltas of a new hash
+//------------------------------------------------------------------------------
+static unsigned long long
+GenerateEpoch()
+{
+  std::random_device rd;
+  unsigned long long epoch = ((unsigned long long) rd() << 32) | rd();
+  return (epoch ? epoch : 1);
+}
+
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
@@ -180,7 +205,8 @@ XrdMqSharedHash::XrdMqSharedHash(const char* subject, const char* bcast_queue,
                                  XrdMqSharedObjectManager* som):
   mType("hash"), mSOM(som), mSubject((subject ? subject : "")),
   mIsTransaction(false), mBroadcastQueue((bcast_queue ? bcast_queue : "")),
-  mTransactMutex(new XrdSysMutex()), mStoreMutex(new XrdMqRWMutex())
+  mTransactMutex(new XrdSysMutex()), mStoreMutex(new XrdMqRWMutex()),
+  mEpoch(GenerateEpoch()), mSeq(0), mResyncTime(0)
 {}
 
 //------------------------------------------------------------------------------
@@ -212,6 +238,10 @@ XrdMqSharedHash::operator=(XrdMqSharedHash&& other)
     std::swap(mTransactions, other.mTransactions);
     std::swap(mTransactMutex, other.mTransactMutex);
     std::swap(mStoreMutex, other.mStoreMutex);
+    mEpoch = other.mEpoch;
+    mSeq = other.mSeq;
+    std::swap(mPeers, other.mPeers);
+    mResyncTime = other.mResyncTime;
   }
 
   return *this;
@@ -375,6 +405,12 @@ XrdMqSharedHash::CloseTransaction()
 {
   bool retval = true;
 
+  if (XrdMqSharedObjectManager::sBroadcast && XrdMqSharedObjectManager::sDelta &&
+      mSOM && (mTransactions.size() || mDeletions.size())) {
+    // This clears both sets so no env string is sent below
+    retval &= SendDelta();
+  }
+
   if (XrdMqSharedObjectManager::sBroadcast && mTransactions.size()) {
     XrdOucString txmessage = "";
     MakeUpdateEnvHeader(txmessage);
@@ -508,6 +544,10 @@ XrdMqSharedHash::MakeRemoveEnvHeader(XrdOucString& out)
 bool
 XrdMqSharedHash::BroadCastEnvString(const char* receiver)
 {
+  if (XrdMqSharedObjectManager::sDelta && mSOM) {
+    return (XrdMqSharedObjectManager::sBroadcast ? SendSnapshot(receiver) : true);
+  }
+
   XrdOucString txmessage = "";
   {
     XrdSysMutexHelper lock(*mTransactMutex);
@@ -622,6 +662,184 @@ XrdMqSharedHash::BroadcastRequest(const char* req_target)
          false, true);
 }
 
+//-------------------------------------------------------------------------------
+// Send the transactions and deletions as binary deltas
+//-------------------------------------------------------------------------------
+bool
+XrdMqSharedHash::SendDelta()
+{
+  // Split into several deltas if the values don't fit into one message
+  std::vector<eos::mq::SharedHashDelta> deltas(1);
+  size_t size = 0;
+  bool retval = true;
+  // The values are read and stamped with the mDeltaMutex locked, a mux
+  // transaction on the same hash is then sent either before or after us. The
+  // messages are sent once the mDeltaMutex is released.
+  XrdSysMutexHelper lock(mSOM->mDeltaMutex);
+
+  // Single shot deletions get here with no transactions
+  if (mTransactions.size()) {
+    XrdMqRWMutexReadLock rd_lock(*mStoreMutex);
+
+    for (auto it = mTransactions.begin(); it != mTransactions.end(); ++it) {
+      auto entry = mStore.find(*it);
+
+      if (entry == mStore.end()) {
+        continue;
+      }
+
+      const char* value = entry->second.GetValue();
+      size_t len = it->length() + strlen(value) + 8;
+
+      if ((size + len > sMaxDeltaBytes) && deltas.back().keys_size()) {
+        deltas.emplace_back();
+        size = 0;
+      }
+
+      deltas.back().add_keys(*it);
+      deltas.back().add_values(value);
+      size += len;
+    }
+  }
+
+  for (auto it = mDeletions.begin(); it != mDeletions.end(); ++it) {
+    deltas.back().add_deletions(*it);
+  }
+
+  mTransactions.clear();
+  mDeletions.clear();
+
+  for (auto& delta : deltas) {
+    if (!delta.keys_size() && !delta.deletions_size()) {
+      continue;
+    }
+
+    eos::mq::SharedHashBatch batch;
+    StampDelta(delta, false);
+    batch.add_deltas()->Swap(&delta);
+    retval &= mSOM->QueueDeltaBatch(batch, mBroadcastQueue.c_str());
+  }
+
+  lock.UnLock();
+  retval &= mSOM->SendQueuedDeltas();
+  return retval;
+}
+
+//-------------------------------------------------------------------------------
+// Send the full contents as a binary snapshot
+//-------------------------------------------------------------------------------
+bool
+XrdMqSharedHash::SendSnapshot(const char* receiver)
+{
+  eos::mq::SharedHashBatch batch;
+  eos::mq::SharedHashDelta* delta = batch.add_deltas();
+  // No transaction can be open while we hold the mutex, so the snapshot
+  // contains exactly the deltas up to the current sequence number. Mux
+  // transactions read and stamp their deltas with the mDeltaMutex locked.
+  XrdSysMutexHelper lock(*mTransactMutex);
+  XrdSysMutexHelper delta_lock(mSOM->mDeltaMutex);
+  {
+    XrdMqRWMutexReadLock rd_lock(*mStoreMutex);
+
+    for (auto it = mStore.begin(); it != mStore.end(); ++it) {
+      delta->add_keys(it->first);
+      delta->add_values(it->second.GetValue());
+    }
+  }
+  StampDelta(*delta, true);
+
+  if (XrdMqSharedObjectManager::sDebug) {
+    fprintf(stderr, "XrdMqSharedObjectManager::SendSnapshot=>[%s]=>%s seq=%llu\n",
+            mSubject.c_str(), receiver, mSeq);
+  }
+
+  bool retval = mSOM->QueueDeltaBatch(batch, receiver);
+  delta_lock.UnLock();
+  retval &= mSOM->SendQueuedDeltas();
+  return retval;
+}
+
+//-------------------------------------------------------------------------------
+// Fill in the header of a delta
+//-------------------------------------------------------------------------------
+void
+XrdMqSharedHash::StampDelta(eos::mq::SharedHashDelta& delta, bool snapshot)
+{
+  if (!snapshot) {
+    ++mSeq;
+  }
+
+  delta.set_subject(mSubject);
+  delta.set_type(mType);
+  delta.set_epoch(mEpoch);
+  delta.set_seq(mSeq);
+  delta.set_snapshot(snapshot);
+}
+
+//-------------------------------------------------------------------------------
+// Apply a received delta
+//-------------------------------------------------------------------------------
+bool
+XrdMqSharedHash::ApplyDelta(const eos::mq::SharedHashDelta& delta,
+                            const std::string& sender)
+{
+  bool gap = false;
+  {
+    XrdSysMutexHelper lock(*mTransactMutex);
+    PeerSequence& peer = mPeers[sender];
+
+    if (peer.mEpoch == delta.epoch()) {
+      if (delta.snapshot() ? (delta.seq() < peer.mSeq) :
+          (delta.seq() <= peer.mSeq)) {
+        // Already covered by a snapshot or a later delta
+        return false;
+      }
+
+      gap = (!delta.snapshot() && (delta.seq() != peer.mSeq + 1));
+    } else {
+      // The first delta from a sender is taken as it is, a new epoch means
+      // the sending hash was recreated and we may have kept stale keys
+      gap = (!delta.snapshot() && peer.mEpoch);
+    }
+
+    peer.mEpoch = delta.epoch();
+    peer.mSeq = delta.seq();
+
+    if (delta.snapshot()) {
+      mResyncTime = 0;
+    } else if (gap) {
+      ++sDeltaGapCounter;
+      time_t now = time(NULL);
+
+      if (now - mResyncTime < sResyncInterval) {
+        // A resync is already on its way
+        gap = false;
+      } else {
+        mResyncTime = now;
+      }
+    }
+  }
+
+  if (delta.snapshot()) {
+    Clear(false);
+  }
+
+  for (int i = 0; i < delta.keys_size() && i < delta.values_size(); ++i) {
+    if (XrdMqSharedObjectManager::sDebug) {
+      fprintf(stderr, "XrdMqSharedObjectManager::ApplyDelta=>Setting [%s] %s=> %s\n",
+              mSubject.c_str(), delta.keys(i).c_str(), delta.values(i).c_str());
+    }
+
+    Set(delta.keys(i).c_str(), delta.values(i).c_str(), false);
+  }
+
+  for (int i = 0; i < delta.deletions_size(); ++i) {
+    Delete(delta.deletions(i), false);
+  }
+
+  return gap;
+}
+
 //-------------------------------------------------------------------------------
 // Dump hash map representation to output string
 //-------------------------------------------------------------------------------
@@ -647,28 +865,36 @@ bool
 XrdMqSharedHash::Delete(const std::string& key, bool broadcast)
 {
   bool deleted = false;
-  XrdMqRWMutexWriteLock wr_lock(*mStoreMutex);
+  bool do_broadcast = (XrdMqSharedObjectManager::sBroadcast && broadcast);
+  // Emulate transaction for single shot deletions - the transaction mutex is
+  // taken before the store mutex and the deletion is sent once the store is
+  // unlocked, the delta path locks the store mutex after the SOM mDeltaMutex
+  bool emulate = (do_broadcast && !mIsTransaction);
+
+  if (emulate) {
+    mTransactMutex->Lock();
+    mTransactions.clear();
+  }
 
-  if (mStore.count(key)) {
-    mStore.erase(key);
-    deleted = true;
+  {
+    XrdMqRWMutexWriteLock wr_lock(*mStoreMutex);
 
-    if (XrdMqSharedObjectManager::sBroadcast && broadcast) {
-      // Emulate transaction for single shot deletions
-      if (!mIsTransaction) {
-        mTransactMutex->Lock();
-        mTransactions.clear();
-      }
+    if (mStore.count(key)) {
+      mStore.erase(key);
+      deleted = true;
+    }
+  }
 
-      mDeletions.insert(key);
-      mTransactions.erase(key);
+  if (deleted && do_broadcast) {
+    mDeletions.insert(key);
+    mTransactions.erase(key);
+  }
 
-      // Emulate transaction for single shot deletions
-      if (!mIsTransaction) {
-        CloseTransaction();
-      }
-    }
+  if (emulate) {
+    CloseTransaction();
+  }
 
+  if (deleted) {
     // Check if we have to post for this subject
     if (mSOM) {
       std::string fkey = mSubject.c_str();
@@ -2389,8 +2615,15 @@ XrdMqSharedObjectChangeNotifier::Stop()
 // Constructor
 //------------------------------------------------------------------------------
 XrdMqSharedObjectManager::XrdMqSharedObjectManager():
-  mDumperTid(0), mDumperFile("")
+  mDumperTid(0), mDumperFile(""), mDeltaSending(false)
 {
+  mDeltaSender = [](const XrdOucString & body, const std::string & receiver) {
+    XrdMqMessage message("XrdMqSharedHashMessage");
+    message.SetBody(body.c_str());
+    message.MarkAsMonitor();
+    return XrdMqMessaging::gMessageClient.SendMessage(message, receiver.c_str(),
+           false, false, true);
+  };
   mEnableQueue = false;
   AutoReplyQueue = "";
   AutoReplyQueueDerive = false;
@@ -2778,6 +3011,10 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
             envlen, env.Env(envlen));
   }
 
+  if (env.Get(XRDMQSHAREDHASH_DELTA)) {
+    return ParseDeltaMessage(message, env.Get(XRDMQSHAREDHASH_DELTA), error);
+  }
+
   if (env.Get(XRDMQSHAREDHASH_SUBJECT)) {
     subject = env.Get(XRDMQSHAREDHASH_SUBJECT);
   } else {
@@ -2913,26 +3150,8 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
       if (!sh) {
         HashMutex.UnLockRead();
 
-        if (AutoReplyQueueDerive) {
-          AutoReplyQueue = subject.c_str();
-          int pos = 0;
-
-          for (int i = 0; i < 4; i++) {
-            pos = subject.find("/", pos);
-
-            if (i < 3) {
-              if (pos == STR_NPOS) {
-                AutoReplyQueue = "";
-                error = "cannot derive the reply queue from ";
-                error += subject.c_str();
-                return false;
-              } else {
-                pos++;
-              }
-            } else {
-              AutoReplyQueue.erase(pos);
-            }
-          }
+        if (!DeriveAutoReplyQueue(subject, error)) {
+          return false;
         }
 
         // create the list of subjects
@@ -3143,6 +3362,196 @@ XrdMqSharedObjectManager::ParseEnvMessage(XrdMqMessage* message,
   return false;
 }
 
+//------------------------------------------------------------------------------
+// Derive the auto reply queue from a subject
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::DeriveAutoReplyQueue(const std::string& subject,
+    XrdOucString& error)
+{
+  if (AutoReplyQueueDerive) {
+    AutoReplyQueue = subject.c_str();
+    int pos = 0;
+
+    for (int i = 0; i < 4; i++) {
+      pos = subject.find("/", pos);
+
+      if (i < 3) {
+        if (pos == STR_NPOS) {
+          AutoReplyQueue = "";
+          error = "cannot derive the reply queue from ";
+          error += subject.c_str();
+          return false;
+        } else {
+          pos++;
+        }
+      } else {
+        AutoReplyQueue.erase(pos);
+      }
+    }
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Apply a message with binary deltas
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::ParseDeltaMessage(XrdMqMessage* message,
+    const char* data, XrdOucString& error)
+{
+  char* raw = 0;
+  ssize_t rawlen = 0;
+  eos::mq::SharedHashBatch batch;
+
+  if (!XrdMqMessage::Base64Decode(data, raw, rawlen)) {
+    error = "delta: cannot decode message body";
+    return false;
+  }
+
+  bool parsed = batch.ParseFromArray(raw, rawlen);
+  free(raw);
+
+  if (!parsed) {
+    error = "delta: cannot parse message body";
+    return false;
+  }
+
+  std::string sender = message->kMessageHeader.kSenderId.c_str();
+
+  for (int i = 0; i < batch.deltas_size(); ++i) {
+    const eos::mq::SharedHashDelta& delta = batch.deltas(i);
+    const std::string& subject = delta.subject();
+    XrdMqSharedHash* sh = 0;
+    {
+      XrdMqRWMutexReadLock lock(HashMutex);
+      sh = GetObject(subject.c_str(), delta.type().c_str());
+    }
+
+    // automatically create the subject, if it does not exist
+    if (!sh) {
+      if (!DeriveAutoReplyQueue(subject, error)) {
+        return false;
+      }
+
+      if (!CreateSharedObject(subject.c_str(), AutoReplyQueue.c_str(),
+                              delta.type().c_str())) {
+        error = "cannot create shared object for ";
+        error += subject.c_str();
+        error += " and type ";
+        error += delta.type().c_str();
+        return false;
+      }
+    }
+
+    bool resync = false;
+    {
+      XrdMqRWMutexReadLock lock(HashMutex);
+      sh = GetObject(subject.c_str(), delta.type().c_str());
+
+      if (!sh) {
+        error = "delta: subject does not exist (FATAL!)";
+        return false;
+      }
+
+      resync = sh->ApplyDelta(delta, sender);
+
+      if (resync) {
+        if (sDebug) {
+          fprintf(stderr, "XrdMqSharedObjectManager::ParseDeltaMessage=>gap in "
+                  "[%s] seq=%llu, requesting resync from %s\n", subject.c_str(),
+                  (unsigned long long) delta.seq(), sender.c_str());
+        }
+
+        sh->BroadcastRequest(sender.c_str());
+      }
+    }
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Encode a batch of deltas as message body
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::MakeDeltaEnvString(const eos::mq::SharedHashBatch&
+    batch, XrdOucString& out)
+{
+  std::string data;
+  std::string b64;
+
+  if (!batch.SerializeToString(&data) ||
+      !XrdMqMessage::Base64Encode(data.c_str(), data.length(), b64)) {
+    return false;
+  }
+
+  out = XRDMQSHAREDHASH_DELTAUPDATE;
+  out += "&";
+  out += XRDMQSHAREDHASH_DELTA;
+  out += "=";
+  out += b64.c_str();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Replace the function sending the delta messages
+//------------------------------------------------------------------------------
+void
+XrdMqSharedObjectManager::SetDeltaSender(DeltaSender sender)
+{
+  XrdSysMutexHelper lock(mDeltaMutex);
+  mDeltaSender = std::move(sender);
+}
+
+//------------------------------------------------------------------------------
+// Queue a batch of deltas
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::QueueDeltaBatch(const eos::mq::SharedHashBatch&
+    batch, const char* receiver)
+{
+  XrdOucString txmessage = "";
+
+  if (!MakeDeltaEnvString(batch, txmessage)) {
+    return false;
+  }
+
+  mDeltaOutbox.emplace_back(receiver, txmessage);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Send the queued delta batches
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::SendQueuedDeltas()
+{
+  bool retval = true;
+  XrdSysMutexHelper lock(mDeltaMutex);
+
+  // The thread already sending keeps the order of the sequence numbers and
+  // also takes the batches we queued
+  if (mDeltaSending) {
+    return true;
+  }
+
+  mDeltaSending = true;
+
+  while (!mDeltaOutbox.empty()) {
+    std::pair<std::string, XrdOucString> item = std::move(mDeltaOutbox.front());
+    mDeltaOutbox.pop_front();
+    DeltaSender sender = mDeltaSender;
+    lock.UnLock();
+    retval &= sender(item.second, item.first);
+    lock.Lock(&mDeltaMutex);
+  }
+
+  mDeltaSending = false;
+  return retval;
+}
+
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
@@ -3170,7 +3579,9 @@ XrdMqSharedObjectManager::CloseMuxTransaction()
   // no deletions of subjects
   XrdSysMutexHelper mLock(MuxTransactionsMutex);
 
-  if (MuxTransactions.size()) {
+  if (MuxTransactions.size() && sDelta) {
+    SendMuxDelta();
+  } else if (MuxTransactions.size()) {
     XrdOucString txmessage = "";
     MakeMuxUpdateEnvHeader(txmessage);
     AddMuxTransactionEnvString(txmessage);
@@ -3263,6 +3674,69 @@ XrdMqSharedObjectManager::AddMuxTransactionEnvString(XrdOucString& out)
   }
 }
 
+//------------------------------------------------------------------------------
+// Send the multiplexed transactions as binary deltas
+//------------------------------------------------------------------------------
+bool
+XrdMqSharedObjectManager::SendMuxDelta()
+{
+  bool retval = true;
+  eos::mq::SharedHashBatch batch;
+  size_t size = 0;
+  // The values are read and stamped with the mDeltaMutex locked, so that the
+  // order of the sequence numbers is the order in which they were read
+  XrdSysMutexHelper lock(mDeltaMutex);
+
+  for (auto it_subj = MuxTransactions.begin(); it_subj != MuxTransactions.end();
+       ++it_subj) {
+    XrdMqSharedHash* hash = GetObject(it_subj->first.c_str(),
+                                      MuxTransactionType.c_str());
+
+    if (!hash) {
+      continue;
+    }
+
+    eos::mq::SharedHashDelta delta;
+    size_t len = 0;
+    {
+      XrdMqRWMutexReadLock rd_lock(*(hash->mStoreMutex));
+
+      for (auto it = it_subj->second.begin(); it != it_subj->second.end(); ++it) {
+        auto entry = hash->mStore.find(*it);
+
+        if (entry != hash->mStore.end()) {
+          delta.add_keys(*it);
+          delta.add_values(entry->second.GetValue());
+          len += it->length() + strlen(entry->second.GetValue()) + 8;
+        }
+      }
+    }
+
+    if (!delta.keys_size()) {
+      continue;
+    }
+
+    // A single hash is never split, the values of one mux transaction are
+    // small compared to the message limit
+    if ((size + len > sMaxDeltaBytes) && batch.deltas_size()) {
+      retval &= QueueDeltaBatch(batch, MuxTransactionBroadCastQueue.c_str());
+      batch.Clear();
+      size = 0;
+    }
+
+    hash->StampDelta(delta, false);
+    batch.add_deltas()->Swap(&delta);
+    size += len;
+  }
+
+  if (batch.deltas_size()) {
+    retval &= QueueDeltaBatch(batch, MuxTransactionBroadCastQueue.c_str());
+  }
+
+  lock.UnLock();
+  retval &= SendQueuedDeltas();
+  return retval;
+}
 
 //-------------------------------------------------------------------------------
 //
@@ -34,6 +34,7 @@
 #include <vector>
 #include <set>
 #include <deque>
+#include <functional>
 #include <regex.h>
 #include "mgm/TableFormatter/TableCell.hh"
 #include <atomic>
@@ -50,10 +51,21 @@
 #define XRDMQSHAREDHASH_KEYS      "mqsh.keys"
 #define XRDMQSHAREDHASH_REPLY     "mqsh.reply"
 #define XRDMQSHAREDHASH_TYPE      "mqsh.type"
+#define XRDMQSHAREDHASH_DELTAUPDATE "mqsh.cmd=delta"
+#define XRDMQSHAREDHASH_DELTA     "mqsh.delta"
 
-//! Forward declaration
+//! Forward declarations
 class XrdMqSharedObjectManager;
 
+namespace eos
+{
+namespace mq
+{
+class SharedHashDelta;
+class SharedHashBatch;
+}
+}
+
 //------------------------------------------------------------------------------
 //! Class XrdMqSharedHashEntry
 //------------------------------------------------------------------------------
@@ -181,6 +193,8 @@ public:
   static std::atomic<unsigned long long> sSetCounter; ///< Counter for set operations
   static std::atomic<unsigned long long> sSetNLCounter; ///< Counter for set no-lock operations
   static std::atomic<unsigned long long> sGetCounter; ///< Counter for get operations
+  //! Counter for the gaps detected in the received deltas
+  static std::atomic<unsigned long long> sDeltaGapCounter;
 
   //----------------------------------------------------------------------------
   //! Constructor
@@ -440,6 +454,14 @@ protected:
   bool SetImpl(const char* key, const char* value,  bool broadcast);
 
 private:
+  //----------------------------------------------------------------------------
+  //! Sequence of the deltas received from one sender
+  //----------------------------------------------------------------------------
+  struct PeerSequence {
+    unsigned long long mEpoch = 0; ///< Epoch of the sending hash
+    unsigned long long mSeq = 0; ///< Sequence number of the last delta applied
+  };
+
   std::string mSubject; ///< Hash subject
   bool mIsTransaction; ///< True if ongoing transaction
   std::string mBroadcastQueue; ///< Name of the broadcast queue
@@ -449,6 +471,13 @@ private:
   mTransactMutex; ///< Mutex protecting the set of transactions
   std::unique_ptr<XrdMqRWMutex>
   mStoreMutex; ///< RW Mutex protecting the mStore object
+  //! Random id of this hash instance sent with the deltas
+  unsigned long long mEpoch;
+  //! Sequence number of the last delta sent - protected by the SOM mDeltaMutex
+  unsigned long long mSeq;
+  //! Sequence of the received deltas per sender - protected by mTransactMutex
+  std::map<std::string, PeerSequence> mPeers;
+  time_t mResyncTime; ///< Time of the last resync request
 
   //----------------------------------------------------------------------------
   //! Construct broadcast env header
@@ -501,6 +530,46 @@ private:
   //! @return true if message sent successful, otherwise false
   //----------------------------------------------------------------------------
   bool BroadCastEnvString(const char* receiver);
+
+  //----------------------------------------------------------------------------
+  //! Send the transactions and deletions as binary deltas - this must be
+  //! called with the mTransactMutex locked and clears both sets
+  //!
+  //! @return true if messages sent successfully, otherwise false
+  //----------------------------------------------------------------------------
+  bool SendDelta();
+
+  //----------------------------------------------------------------------------
+  //! Send the full contents as a binary snapshot
+  //!
+  //! @param receiver target of the snapshot
+  //!
+  //! @return true if message sent successfully, otherwise false
+  //----------------------------------------------------------------------------
+  bool SendSnapshot(const char* receiver);
+
+  //----------------------------------------------------------------------------
+  //! Fill in the subject, type, epoch and the next sequence number of a
+  //! delta - this must be called with the SOM mDeltaMutex locked
+  //!
+  //! @param delta delta to fill in
+  //! @param snapshot if true the delta is a snapshot and carries the sequence
+  //!        number of the last delta sent
+  //----------------------------------------------------------------------------
+  void StampDelta(eos::mq::SharedHashDelta& delta, bool snapshot);
+
+  //----------------------------------------------------------------------------
+  //! Apply a received delta. Deltas already covered by a snapshot are
+  //! dropped, deltas after a gap are applied but the hash has to be
+  //! resynchronized from the sender.
+  //!
+  //! @param delta received delta
+  //! @param sender queue of the sender
+  //!
+  //! @return true if a resync has to be requested from the sender
+  //----------------------------------------------------------------------------
+  bool ApplyDelta(const eos::mq::SharedHashDelta& delta,
+                  const std::string& sender);
 };
 
 
@@ -619,6 +688,9 @@ private:
 public:
   static bool sDebug; ///< Set debug mode
   static bool sBroadcast; ///< Set broadcasting mode
+  //! Send changes as binary deltas, enabled by EOS_MQ_SHAREDHASH_DELTA=1 -
+  //! all the receivers have to understand deltas before it is turned on
+  static bool sDelta;
 
   //----------------------------------------------------------------------------
   //! Constructor
@@ -787,6 +859,64 @@ public:
   //----------------------------------------------------------------------------
   bool ParseEnvMessage(XrdMqMessage* message, XrdOucString& error);
 
+  //----------------------------------------------------------------------------
+  //! Apply a message with binary deltas, subjects which don't exist are
+  //! created. Gaps in the sequence of a hash trigger a broadcast request to
+  //! the sender for that hash only.
+  //!
+  //! @param message received message
+  //! @param data base64 encoded SharedHashBatch
+  //! @param error error message
+  //!
+  //! @return true if all the deltas were applied, otherwise false
+  //----------------------------------------------------------------------------
+  bool ParseDeltaMessage(XrdMqMessage* message, const char* data,
+                         XrdOucString& error);
+
+  //----------------------------------------------------------------------------
+  //! Encode a batch of deltas as message body
+  //!
+  //! @param batch deltas
+  //! @param out output string
+  //!
+  //! @return true if successful, otherwise false
+  //----------------------------------------------------------------------------
+  static bool MakeDeltaEnvString(const eos::mq::SharedHashBatch& batch,
+                                 XrdOucString& out);
+
+  //! Function sending the body of a delta message to a receiver
+  typedef std::function<bool(const XrdOucString& body,
+                             const std::string& receiver)> DeltaSender;
+
+  //----------------------------------------------------------------------------
+  //! Replace the function sending the delta messages, by default they go
+  //! through the message client
+  //!
+  //! @param sender new sender function
+  //----------------------------------------------------------------------------
+  void SetDeltaSender(DeltaSender sender);
+
+  //----------------------------------------------------------------------------
+  //! Queue a batch of deltas to be sent in the order of its sequence numbers
+  //! - this must be called with the mDeltaMutex locked
+  //!
+  //! @param batch deltas
+  //! @param receiver target queue
+  //!
+  //! @return true if the batch was encoded, otherwise false
+  //----------------------------------------------------------------------------
+  bool QueueDeltaBatch(const eos::mq::SharedHashBatch& batch,
+                       const char* receiver);
+
+  //----------------------------------------------------------------------------
+  //! Send the queued delta batches in order - this must be called without the
+  //! mDeltaMutex locked. If another thread is already sending, it also sends
+  //! the batches queued by this one.
+  //!
+  //! @return true if the messages sent by this thread were successful
+  //----------------------------------------------------------------------------
+  bool SendQueuedDeltas();
+
   //----------------------------------------------------------------------------
   //! Set debug level
   //!
@@ -839,6 +969,17 @@ public:
   //----------------------------------------------------------------------------
   void AddMuxTransactionEnvString(XrdOucString& out);
 
+  //----------------------------------------------------------------------------
+  //! Send the multiplexed transactions as binary deltas, one per hash,
+  //! batched into as few messages as possible - this must be called with the
+  //! MuxTransactionsMutex locked. Like for single hash deltas, the store
+  //! mutexes are locked after the mDeltaMutex and the messages are sent once
+  //! it is released.
+  //!
+  //! @return true if messages sent successfully, otherwise false
+  //----------------------------------------------------------------------------
+  bool SendMuxDelta();
+
 protected:
   XrdSysMutex MuxTransactionsMutex; ///< protects the mux transaction map
   std::string MuxTransactionType; ///<
@@ -850,6 +991,24 @@ protected:
   XrdSysSemWait SubjectsSem;
   //! Mutex to protect the creations/deletions/modifications & watch subjects
   XrdSysMutex mSubjectsMutex;
+  //! Protects the sequence numbers of the deltas and the queue of deltas
+  XrdSysMutex mDeltaMutex;
+  //! Encoded delta batches with their receivers, in the order of their
+  //! sequence numbers - protected by mDeltaMutex
+  std::deque<std::pair<std::string, XrdOucString>> mDeltaOutbox;
+  //! True while a thread is sending mDeltaOutbox - protected by mDeltaMutex
+  bool mDeltaSending;
+  DeltaSender mDeltaSender; ///< Function sending the delta messages
+
+  //----------------------------------------------------------------------------
+  //! Derive the auto reply queue from a subject if configured
+  //!
+  //! @param subject hash subject
+  //! @param error error message
+  //!
+  //! @return true if successful, otherwise false
+  //----------------------------------------------------------------------------
+  bool DeriveAutoReplyQueue(const std::string& subject, XrdOucString& error);
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,213 @@
+//------------------------------------------------------------------------------
+//! @file XrdMqSubscriptionIndex.hh
+//! @brief Index of the connected queues for wildcard and advisory delivery
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __XRDMQ_SUBSCRIPTIONINDEX_HH__
+#define __XRDMQ_SUBSCRIPTIONINDEX_HH__
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//! Index of the connected output queues. Receiver patterns with '*'
+//! wildcards are compiled into the list of the queues they match the first
+//! time they are used. The lists are kept up to date when queues attach and
+//! detach, so a broadcast only touches the queues it is delivered to. The
+//! queues taking advisory status and query messages are kept in lists of
+//! their own.
+//!
+//! The index is not thread-safe - the broker uses it under QueueOutMutex.
+//------------------------------------------------------------------------------
+template <typename T>
+class XrdMqSubscriptionIndex
+{
+public:
+  typedef std::pair<std::string, T> Subscriber;
+  typedef std::vector<Subscriber> SubscriberList;
+
+  //! Maximum number of compiled patterns
+  static const size_t sMaxPatterns = 1024;
+
+  //----------------------------------------------------------------------------
+  //! Check if a queue name matches a pattern with '*' wildcards
+  //----------------------------------------------------------------------------
+  static bool Matches(const char* name, const char* pattern)
+  {
+    const char* star = 0;
+    const char* resume = 0;
+
+    while (*name) {
+      if (*pattern == '*') {
+        // remember the position to backtrack to
+        star = pattern++;
+        resume = name;
+      } else if (*pattern == *name) {
+        ++pattern;
+        ++name;
+      } else if (star) {
+        pattern = star + 1;
+        name = ++resume;
+      } else {
+        return false;
+      }
+    }
+
+    while (*pattern == '*') {
+      ++pattern;
+    }
+
+    return !*pattern;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Add a queue
+  //----------------------------------------------------------------------------
+  void Attach(const std::string& name, T queue, bool advisorystatus,
+              bool advisoryquery)
+  {
+    mQueues[name] = queue;
+
+    if (advisorystatus) {
+      mAdvisoryStatus.emplace_back(name, queue);
+    }
+
+    if (advisoryquery) {
+      mAdvisoryQuery.emplace_back(name, queue);
+    }
+
+    for (auto it = mPatterns.begin(); it != mPatterns.end(); ++it) {
+      if (Matches(name.c_str(), it->first.c_str())) {
+        it->second.emplace_back(name, queue);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Remove a queue
+  //----------------------------------------------------------------------------
+  void Detach(const std::string& name)
+  {
+    if (!mQueues.erase(name)) {
+      return;
+    }
+
+    Remove(mAdvisoryStatus, name);
+    Remove(mAdvisoryQuery, name);
+
+    for (auto it = mPatterns.begin(); it != mPatterns.end(); ++it) {
+      if (Matches(name.c_str(), it->first.c_str())) {
+        Remove(it->second, name);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the queues matching a wildcard pattern
+  //!
+  //! @param pattern receiver pattern
+  //! @param scratch storage for the result if the pattern is not compiled
+  //!
+  //! @return list of the matching queues
+  //----------------------------------------------------------------------------
+  const SubscriberList& Match(const std::string& pattern,
+                              SubscriberList& scratch)
+  {
+    auto it = mPatterns.find(pattern);
+
+    if (it != mPatterns.end()) {
+      return it->second;
+    }
+
+    if (mPatterns.size() >= sMaxPatterns) {
+      // the senders use a handful of patterns, do not grow with odd ones
+      scratch.clear();
+      Compile(pattern, scratch);
+      return scratch;
+    }
+
+    SubscriberList& list = mPatterns[pattern];
+    Compile(pattern, list);
+    return list;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the queues taking advisory status or query messages
+  //----------------------------------------------------------------------------
+  const SubscriberList& AdvisoryStatus() const
+  {
+    return mAdvisoryStatus;
+  }
+
+  const SubscriberList& AdvisoryQuery() const
+  {
+    return mAdvisoryQuery;
+  }
+
+  size_t NumPatterns() const
+  {
+    return mPatterns.size();
+  }
+
+private:
+  std::map<std::string, T> mQueues; ///< all queues sorted by name
+  SubscriberList mAdvisoryStatus; ///< queues taking status advisories
+  SubscriberList mAdvisoryQuery; ///< queues taking query advisories
+  std::unordered_map<std::string, SubscriberList> mPatterns; ///< compiled
+
+  //----------------------------------------------------------------------------
+  //! Collect the queues matching a pattern - only the range of names
+  //! starting with the literal prefix of the pattern is visited
+  //----------------------------------------------------------------------------
+  void Compile(const std::string& pattern, SubscriberList& list) const
+  {
+    std::string prefix = pattern.substr(0, pattern.find('*'));
+
+    for (auto it = mQueues.lower_bound(prefix); it != mQueues.end(); ++it) {
+      if (it->first.compare(0, prefix.length(), prefix)) {
+        break;
+      }
+
+      if (Matches(it->first.c_str(), pattern.c_str())) {
+        list.emplace_back(it->first, it->second);
+      }
+    }
+  }
+
+  static void Remove(SubscriberList& list, const std::string& name)
+  {
+    for (size_t i = 0; i < list.size(); ++i) {
+      if (list[i].first == name) {
+        list[i] = std::move(list.back());
+        list.pop_back();
+        return;
+      }
+    }
+  }
+};
+
+template <typename T>
+const size_t XrdMqSubscriptionIndex<T>::sMaxPatterns;
+
+#endif
@@ -0,0 +1,65 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __EOS_NS_IACCOUNTINGSTATS_HH__
+#define __EOS_NS_IACCOUNTINGSTATS_HH__
+
+#include "namespace/Namespace.hh"
+#include <cstdint>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Statistics of the asynchronous container subtree accounting
+//------------------------------------------------------------------------------
+struct AccountingStats {
+  AccountingStats():
+    mQueueDepth(0), mLastBatchSize(0), mLastLatencyMs(0), mMaxLatencyMs(0),
+    mNumPropagations(0), mNumUpdates(0)
+  {}
+
+  uint64_t mQueueDepth; ///< Number of containers with pending deltas
+  uint64_t mLastBatchSize; ///< Containers updated in the last propagation
+  uint64_t mLastLatencyMs; ///< Duration of the last propagation
+  uint64_t mMaxLatencyMs; ///< Maximum duration of a propagation
+  uint64_t mNumPropagations; ///< Number of propagation cycles
+  uint64_t mNumUpdates; ///< Total number of container updates
+};
+
+//------------------------------------------------------------------------------
+//! Interface implemented by subtree accounting listeners keeping statistics
+//------------------------------------------------------------------------------
+class IAccountingStats
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  virtual ~IAccountingStats() {}
+
+  //----------------------------------------------------------------------------
+  //! Get the statistics of the subtree accounting
+  //!
+  //! @param stats filled with the current accounting statistics
+  //----------------------------------------------------------------------------
+  virtual void getAccountingStats(AccountingStats& stats) = 0;
+};
+
+EOSNSNAMESPACE_END
+
+#endif // __EOS_NS_IACCOUNTINGSTATS_HH__
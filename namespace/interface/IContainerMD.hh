@@ -26,6 +26,7 @@
 
 #include "namespace/Namespace.hh"
 #include "namespace/utils/Buffer.hh"
+#include "namespace/utils/Locking.hh"
 #include "namespace/MDException.hh"
 #include "common/Murmur3.hh"
 #include <stdint.h>
@@ -306,6 +307,21 @@ public:
   //----------------------------------------------------------------------------
   virtual void cleanUp() = 0;
 
+  //----------------------------------------------------------------------------
+  //! Get the lock protecting the files and subcontainers of this container
+  //! when the namespace mutex is not held in write mode. Iterating over the
+  //! children needs it in read mode, checking a name and adding or removing
+  //! a child as one step needs it in write mode. The locks of nested
+  //! containers are taken parent first.
+  //!
+  //! @return lock handler or nullptr if the implementation relies only on
+  //!         the namespace mutex
+  //----------------------------------------------------------------------------
+  virtual LockHandler* getChildrenLock()
+  {
+    return nullptr;
+  }
+
   //----------------------------------------------------------------------------
   //! Get iterator to the begining of the subcontainers map
   //----------------------------------------------------------------------------
@@ -0,0 +1,71 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef __EOS_NS_IFLUSHERSTATS_HH__
+#define __EOS_NS_IFLUSHERSTATS_HH__
+
+#include "namespace/Namespace.hh"
+#include <cstdint>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Statistics of a namespace backend flushing metadata updates asynchronously
+//------------------------------------------------------------------------------
+struct FlusherStats {
+  FlusherStats():
+    mCoalescing(false), mUpdates(0), mRequests(0), mStaged(0), mPending(0)
+  {}
+
+  bool mCoalescing; ///< Updates are coalesced before being queued
+  uint64_t mUpdates; ///< Updates received since start
+  uint64_t mRequests; ///< Requests queued towards the backend since start
+  uint64_t mStaged; ///< Updates waiting in the coalescing stage
+  uint64_t mPending; ///< Requests in the flush queue not acknowledged yet
+
+  //----------------------------------------------------------------------------
+  //! Average number of updates folded into one backend request
+  //----------------------------------------------------------------------------
+  double GetCoalescingRatio() const
+  {
+    return (mRequests ? (1.0 * (mUpdates - mStaged) / mRequests) : 1.0);
+  }
+};
+
+//------------------------------------------------------------------------------
+//! Interface implemented by metadata services which flush asynchronously
+//------------------------------------------------------------------------------
+class IFlusherStats
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  virtual ~IFlusherStats() {}
+
+  //----------------------------------------------------------------------------
+  //! Get the statistics of the metadata flusher
+  //!
+  //! @param stats filled with the current flusher statistics
+  //----------------------------------------------------------------------------
+  virtual void getFlusherStats(FlusherStats& stats) = 0;
+};
+
+EOSNSNAMESPACE_END
+
+#endif // __EOS_NS_IFLUSHERSTATS_HH__
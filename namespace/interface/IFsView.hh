@@ -29,6 +29,7 @@
 #include "namespace/interface/IFileMDSvc.hh"
 #include <google/dense_hash_set>
 #include <set>
+#include <vector>
 
 EOSNSNAMESPACE_BEGIN
 
@@ -122,6 +123,21 @@ public:
   virtual std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
       getFileList(IFileMD::location_t location) = 0;
 
+  //----------------------------------------------------------------------------
+  //! Get streaming iterator to the metadata of the files on a particular file
+  //! system. Unlike getFileList, the list of file ids is not cached by the
+  //! view and, if the backend allows it, the metadata is fetched ahead of
+  //! the consumer. Files which can not be retrieved are skipped.
+  //!
+  //! @param location file system id
+  //! @param file_svc file metadata service
+  //!
+  //! @return shared ptr to collection iterator
+  //----------------------------------------------------------------------------
+  virtual std::shared_ptr<ICollectionIterator<std::shared_ptr<IFileMD>>>
+      getStreamingFileMDList(IFileMD::location_t location,
+                             IFileMDSvc* file_svc) = 0;
+
   //----------------------------------------------------------------------------
   //! Get number of files on the given file system
   //!
@@ -304,6 +320,135 @@ private:
   IFsView::FileList::const_iterator mIt; ///< List iterator
 };
 
+//------------------------------------------------------------------------------
+//! Class FileListCopyIterator iterating through a snapshot of a list of files
+//! from the FileSystem class. Used when the list can change while it is
+//! iterated, the copy is taken under the lock protecting the list.
+//------------------------------------------------------------------------------
+class FileListCopyIterator:
+  public ICollectionIterator<IFileMD::id_t>
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  FileListCopyIterator(const IFsView::FileList& list) :
+    mList(list.begin(), list.end()), mIt(mList.cbegin()) {}
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  virtual ~FileListCopyIterator()  = default;
+
+  //----------------------------------------------------------------------------
+  //! Get current file id
+  //----------------------------------------------------------------------------
+  IFileMD::id_t getElement() override
+  {
+    return *mIt;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if iterator is valid
+  //----------------------------------------------------------------------------
+  bool valid() override
+  {
+    return (mIt != mList.cend());
+  }
+
+  //----------------------------------------------------------------------------
+  //! Retrieve next file id
+  //----------------------------------------------------------------------------
+  void next() override
+  {
+    if (valid()) {
+      ++mIt;
+    }
+  }
+
+private:
+  std::vector<IFileMD::id_t> mList; ///< Copy of the list
+  std::vector<IFileMD::id_t>::const_iterator mIt; ///< List iterator
+};
+
+//------------------------------------------------------------------------------
+//! Class FileMDIterator turning an iterator of file ids into an iterator of
+//! file metadata objects, retrieved one by one from the file service. Files
+//! which can not be retrieved are skipped.
+//------------------------------------------------------------------------------
+class FileMDIterator:
+  public ICollectionIterator<std::shared_ptr<IFileMD>>
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  FileMDIterator(std::shared_ptr<ICollectionIterator<IFileMD::id_t>> ids,
+                 IFileMDSvc* file_svc):
+    mIds(ids), mFileSvc(file_svc)
+  {
+    fetch();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  virtual ~FileMDIterator() = default;
+
+  //----------------------------------------------------------------------------
+  //! Get current file metadata object
+  //----------------------------------------------------------------------------
+  std::shared_ptr<IFileMD> getElement() override
+  {
+    return mFmd;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if iterator is valid
+  //----------------------------------------------------------------------------
+  bool valid() override
+  {
+    return (mFmd != nullptr);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Retrieve next file metadata object
+  //----------------------------------------------------------------------------
+  void next() override
+  {
+    if (valid()) {
+      mIds->next();
+      fetch();
+    }
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  //! Retrieve the metadata of the first file from the current position of
+  //! the id iterator which still exists
+  //----------------------------------------------------------------------------
+  void fetch()
+  {
+    mFmd.reset();
+
+    for (; mIds && mIds->valid(); mIds->next()) {
+      try {
+        mFmd = mFileSvc->getFileMD(mIds->getElement());
+      } catch (MDException& e) {
+        mFmd.reset();
+      }
+
+      if (mFmd) {
+        break;
+      }
+    }
+  }
+
+  std::shared_ptr<ICollectionIterator<IFileMD::id_t>> mIds; ///< Id iterator
+  IFileMDSvc* mFileSvc; ///< File metadata service
+  std::shared_ptr<IFileMD> mFmd; ///< Current file metadata object
+};
+
 EOSNSNAMESPACE_END
 
 #endif // __EOS_NS_IFSVIEW_HH__
@@ -28,6 +28,7 @@
 #include <iostream>
 #include <memory>
 #include <map>
+#include <mutex>
 #include <unordered_set>
 #include <vector>
 
@@ -37,7 +38,9 @@ EOSNSNAMESPACE_BEGIN
 class IQuotaStats;
 
 //------------------------------------------------------------------------------
-//! Placeholder for space occupancy statistics of an accounting node
+//! Placeholder for space occupancy statistics of an accounting node. The
+//! usage maps are protected by a leaf mutex since files are accounted while
+//! holding the namespace lock only in read mode.
 //------------------------------------------------------------------------------
 class IQuotaNode
 {
@@ -84,6 +87,7 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getUsedSpaceByUser(uid_t uid)
   {
+    std::lock_guard<std::mutex> lock(mUsageMutex);
     return pUserUsage[uid].space;
   }
 
@@ -92,6 +96,7 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getUsedSpaceByGroup(gid_t gid)
   {
+    std::lock_guard<std::mutex> lock(mUsageMutex);
     return pGroupUsage[gid].space;
   }
 
@@ -100,6 +105,7 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getPhysicalSpaceByUser(uid_t uid)
   {
+    std::lock_guard<std::mutex> lock(mUsageMutex);
     return pUserUsage[uid].physicalSpace;
   }
 
@@ -108,6 +114,7 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getPhysicalSpaceByGroup(gid_t gid)
   {
+    std::lock_guard<std::mutex> lock(mUsageMutex);
     return pGroupUsage[gid].physicalSpace;
   }
 
@@ -116,6 +123,7 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getNumFilesByUser(uid_t uid)
   {
+    std::lock_guard<std::mutex> lock(mUsageMutex);
     return pUserUsage[uid].files;
   }
 
@@ -124,6 +132,7 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getNumFilesByGroup(gid_t gid)
   {
+    std::lock_guard<std::mutex> lock(mUsageMutex);
     return pGroupUsage[gid].files;
   }
 
@@ -151,6 +160,7 @@ public:
   virtual std::unordered_set<uint64_t> getUids()
   {
     std::unordered_set<uint64_t> uids;
+    std::lock_guard<std::mutex> lock(mUsageMutex);
 
     for (auto it = pUserUsage.begin(); it != pUserUsage.end(); ++it) {
       uids.insert(it->first);
@@ -168,6 +178,7 @@ public:
   virtual std::unordered_set<uint64_t> getGids()
   {
     std::unordered_set<uint64_t> gids;
+    std::lock_guard<std::mutex> lock(mUsageMutex);
 
     for (auto it = pGroupUsage.begin(); it != pGroupUsage.end(); ++it) {
       gids.insert(it->first);
@@ -181,6 +192,7 @@ protected:
   IContainerMD::id_t pContainerId; ///< Id of the corresponding container
   UserMap pUserUsage;
   GroupMap pGroupUsage;
+  mutable std::mutex mUsageMutex; ///< Mutex protecting the usage maps
 };
 
 //----------------------------------------------------------------------------
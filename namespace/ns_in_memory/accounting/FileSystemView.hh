@@ -81,6 +81,29 @@ public:
   std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
       getFileList(IFileMD::location_t location) override;
 
+  //----------------------------------------------------------------------------
+  //! Get streaming iterator to the metadata of the files on a particular file
+  //! system. Everything is in memory, so just look up the files one by one.
+  //!
+  //! @param location file system id
+  //! @param file_svc file metadata service
+  //!
+  //! @return shared ptr to collection iterator
+  //----------------------------------------------------------------------------
+  std::shared_ptr<ICollectionIterator<std::shared_ptr<IFileMD>>>
+      getStreamingFileMDList(IFileMD::location_t location,
+                             IFileMDSvc* file_svc) override
+  {
+    auto ids = getFileList(location);
+
+    if (ids == nullptr) {
+      return nullptr;
+    }
+
+    return std::shared_ptr<ICollectionIterator<std::shared_ptr<IFileMD>>>
+           (new FileMDIterator(ids, file_svc));
+  }
+
   //----------------------------------------------------------------------------
   //! Get number of files on the given file system
   //!
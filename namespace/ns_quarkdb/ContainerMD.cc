@@ -107,6 +107,11 @@ ContainerMD::ContainerMD(const ContainerMD& other)
 //------------------------------------------------------------------------------
 ContainerMD& ContainerMD::operator= (const ContainerMD& other)
 {
+  if (this == &other) {
+    return *this;
+  }
+
+  std::lock_guard<std::mutex> lock(other.mMutex);
   mCont    = other.mCont;
   pContSvc = other.pContSvc;
   pFileSvc = other.pFileSvc;
@@ -127,25 +132,38 @@ std::shared_ptr<IContainerMD>
 ContainerMD::findContainer(const std::string& name)
 {
   waitOnContainerMap();
+  IContainerMD::id_t id;
 
-  auto iter = mSubcontainers.find(name);
+  {
+    ReadLockGuard lock(&mChildrenLock);
+    auto iter = mSubcontainers.find(name);
+
+    if (iter == mSubcontainers.end()) {
+      return nullptr;
+    }
 
-  if (iter == mSubcontainers.end()) {
-    return nullptr;
+    id = iter->second;
   }
 
   std::shared_ptr<IContainerMD> cont;
 
   try {
-    cont = pContSvc->getContainerMD(iter->second);
+    cont = pContSvc->getContainerMD(id);
   } catch (const MDException& ex) {
     cont = nullptr;
   }
 
-  // Curate the list of subcontainers in case entry is not found
-  if (cont == nullptr) {
-    pFlusher->hdel(pDirsKey, name);
-    mSubcontainers.erase(iter);
+  // Curate the list of subcontainers in case entry is not found. This is best
+  // effort, skip it if somebody else holds the children lock.
+  if ((cont == nullptr) && mChildrenLock.tryWriteLock()) {
+    auto iter = mSubcontainers.find(name);
+
+    if ((iter != mSubcontainers.end()) && (iter->second == id)) {
+      pFlusher->hdel(pDirsKey, name);
+      mSubcontainers.erase(iter);
+    }
+
+    mChildrenLock.unLock();
   }
 
   return cont;
@@ -158,6 +176,7 @@ void
 ContainerMD::removeContainer(const std::string& name)
 {
   waitOnContainerMap();
+  WriteLockGuard lock(&mChildrenLock);
   auto it = mSubcontainers.find(name);
 
   if (it == mSubcontainers.end()) {
@@ -179,6 +198,7 @@ void
 ContainerMD::addContainer(IContainerMD* container)
 {
   waitOnContainerMap();
+  WriteLockGuard lock(&mChildrenLock);
   container->setParentId(mCont.id());
   auto ret = mSubcontainers.insert(std::make_pair(container->getName(),
                                    container->getId()));
@@ -205,25 +225,38 @@ std::shared_ptr<IFileMD>
 ContainerMD::findFile(const std::string& name)
 {
   waitOnFileMap();
+  IFileMD::id_t id;
 
-  auto iter = mFiles.find(name);
+  {
+    ReadLockGuard lock(&mChildrenLock);
+    auto iter = mFiles.find(name);
 
-  if (iter == mFiles.end()) {
-    return nullptr;
+    if (iter == mFiles.end()) {
+      return nullptr;
+    }
+
+    id = iter->second;
   }
 
   std::shared_ptr<IFileMD> file;
 
   try {
-    file = pFileSvc->getFileMD(iter->second);
+    file = pFileSvc->getFileMD(id);
   } catch (MDException& e) {
     file = nullptr;
   }
 
-  // Curate the list of files in case file entry is not found
-  if (file == nullptr) {
-    pFlusher->hdel(pFilesKey, name);
-    mFiles.erase(iter);
+  // Curate the list of files in case file entry is not found. This is best
+  // effort, skip it if somebody else holds the children lock.
+  if ((file == nullptr) && mChildrenLock.tryWriteLock()) {
+    auto iter = mFiles.find(name);
+
+    if ((iter != mFiles.end()) && (iter->second == id)) {
+      pFlusher->hdel(pFilesKey, name);
+      mFiles.erase(iter);
+    }
+
+    mChildrenLock.unLock();
   }
 
   return file;
@@ -237,18 +270,21 @@ ContainerMD::addFile(IFileMD* file)
 {
   waitOnFileMap();
 
-  file->setContainerId(mCont.id());
-  (void)mFiles.insert(std::make_pair(file->getName(), file->getId()));
-  // @todo (esindril): Here we follow the behaviour of the namespace in memory
-  // and don't do any extra checks but this can lead to multiple accounting
-  // of this file in the quota view since the listeners are notified every
-  // time we call this ....
-  // if (!ret.second) {
-  //   MDException e(EINVAL);
-  //   e.getMessage() << "Error, file #" << file->getId() << " already exists";
-  //   throw e;
-  // }
-  pFlusher->hset(pFilesKey, file->getName(), std::to_string(file->getId()));
+  {
+    WriteLockGuard lock(&mChildrenLock);
+    file->setContainerId(mCont.id());
+    (void)mFiles.insert(std::make_pair(file->getName(), file->getId()));
+    // @todo (esindril): Here we follow the behaviour of the namespace in memory
+    // and don't do any extra checks but this can lead to multiple accounting
+    // of this file in the quota view since the listeners are notified every
+    // time we call this ....
+    // if (!ret.second) {
+    //   MDException e(EINVAL);
+    //   e.getMessage() << "Error, file #" << file->getId() << " already exists";
+    //   throw e;
+    // }
+    pFlusher->hset(pFilesKey, file->getName(), std::to_string(file->getId()));
+  }
 
   if (file->getSize() != 0u) {
     IFileMDChangeListener::Event e(file, IFileMDChangeListener::SizeChange, 0,
@@ -264,28 +300,34 @@ void
 ContainerMD::removeFile(const std::string& name)
 {
   waitOnFileMap();
+  IFileMD::id_t id;
+
+  {
+    WriteLockGuard lock(&mChildrenLock);
+    auto iter = mFiles.find(name);
 
-  auto iter = mFiles.find(name);
+    if (iter == mFiles.end()) {
+      return;
+    }
 
-  if (iter != mFiles.end()) {
-    IFileMD::id_t id = iter->second;
+    id = iter->second;
     mFiles.erase(iter);
     mFiles.resize(0);
     // Do async call to KV backend
     pFlusher->hdel(pFilesKey, name);
+  }
 
-    try {
-      std::shared_ptr<IFileMD> file = pFileSvc->getFileMD(id);
-      // NOTE: This is an ugly hack. The file object has no reference to the
-      // container id, therefore we hijack the "location" member of the Event
-      // class to pass in the container id.
-      IFileMDChangeListener::Event
-      e(file.get(), IFileMDChangeListener::SizeChange, mCont.id(),
-        0, -file->getSize());
-      pFileSvc->notifyListeners(&e);
-    } catch (MDException& e) {
-      // File already removed
-    }
+  try {
+    std::shared_ptr<IFileMD> file = pFileSvc->getFileMD(id);
+    // NOTE: This is an ugly hack. The file object has no reference to the
+    // container id, therefore we hijack the "location" member of the Event
+    // class to pass in the container id.
+    IFileMDChangeListener::Event
+    e(file.get(), IFileMDChangeListener::SizeChange, mCont.id(),
+      0, -file->getSize());
+    pFileSvc->notifyListeners(&e);
+  } catch (MDException& e) {
+    // File already removed
   }
 }
 
@@ -296,6 +338,7 @@ size_t
 ContainerMD::getNumFiles()
 {
   waitOnFileMap();
+  ReadLockGuard lock(&mChildrenLock);
   return mFiles.size();
 }
 
@@ -306,6 +349,7 @@ size_t
 ContainerMD::getNumContainers()
 {
   waitOnContainerMap();
+  ReadLockGuard lock(&mChildrenLock);
   return mSubcontainers.size();
 }
 
@@ -318,6 +362,7 @@ ContainerMD::cleanUp()
 {
   waitOnFileMap();
   waitOnContainerMap();
+  WriteLockGuard lock(&mChildrenLock);
 
   for (const auto& elem : mFiles) {
     auto file = pFileSvc->getFileMD(elem.second);
@@ -456,6 +501,8 @@ ContainerMD::access(uid_t uid, gid_t gid, int flags)
   }
 
   // Check the perms
+  std::lock_guard<std::mutex> lock(mMutex);
+
   if (uid == mCont.uid()) {
     char user = convertModetUser(mCont.mode());
     return checkPerms(user, convFlags);
@@ -485,6 +532,7 @@ ContainerMD::setName(const std::string& name)
   //     throw e;
   //   }
   // }
+  std::lock_guard<std::mutex> lock(mMutex);
   mCont.set_name(name);
 }
 
@@ -494,6 +542,7 @@ ContainerMD::setName(const std::string& name)
 void
 ContainerMD::setCTime(ctime_t ctime)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   mCont.set_ctime(&ctime, sizeof(ctime));
 }
 
@@ -512,6 +561,7 @@ ContainerMD::setCTimeNow()
 #else
   clock_gettime(CLOCK_REALTIME, &tnow);
 #endif
+  std::lock_guard<std::mutex> lock(mMutex);
   mCont.set_ctime(&tnow, sizeof(tnow));
 }
 
@@ -521,6 +571,7 @@ ContainerMD::setCTimeNow()
 void
 ContainerMD::getCTime(ctime_t& ctime) const
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   (void) memcpy(&ctime, mCont.ctime().data(), sizeof(ctime));
 }
 
@@ -530,6 +581,7 @@ ContainerMD::getCTime(ctime_t& ctime) const
 void
 ContainerMD::setMTime(mtime_t mtime)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   mCont.set_mtime(&mtime, sizeof(mtime));
 }
 
@@ -548,6 +600,7 @@ ContainerMD::setMTimeNow()
 #else
   clock_gettime(CLOCK_REALTIME, &tnow);
 #endif
+  std::lock_guard<std::mutex> lock(mMutex);
   mCont.set_mtime(&tnow, sizeof(tnow));
 }
 
@@ -557,6 +610,7 @@ ContainerMD::setMTimeNow()
 void
 ContainerMD::getMTime(mtime_t& mtime) const
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   (void) memcpy(&mtime, mCont.mtime().data(), sizeof(mtime));
 }
 
@@ -567,7 +621,8 @@ bool
 ContainerMD::setTMTime(tmtime_t tmtime)
 {
   tmtime_t tmt;
-  getTMTime(tmt);
+  std::lock_guard<std::mutex> lock(mMutex);
+  (void) memcpy(&tmt, mCont.stime().data(), sizeof(tmt));
 
   if (((tmt.tv_sec == 0) && (tmt.tv_nsec == 0)) ||
       (tmtime.tv_sec > tmt.tv_sec) ||
@@ -604,6 +659,7 @@ ContainerMD::setTMTimeNow()
 void
 ContainerMD::getTMTime(tmtime_t& tmtime)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   (void) memcpy(&tmtime, mCont.stime().data(), sizeof(tmtime));
 }
 
@@ -623,6 +679,7 @@ ContainerMD::notifyMTimeChange(IContainerMDSvc* containerMDSvc)
 uint64_t
 ContainerMD::updateTreeSize(int64_t delta)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   uint64_t sz = mCont.tree_size();
 
   // Avoid usigned underflow
@@ -642,6 +699,7 @@ ContainerMD::updateTreeSize(int64_t delta)
 std::string
 ContainerMD::getAttribute(const std::string& name) const
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   auto it = mCont.xattrs().find(name);
 
   if (it == mCont.xattrs().end()) {
@@ -659,6 +717,7 @@ ContainerMD::getAttribute(const std::string& name) const
 void
 ContainerMD::removeAttribute(const std::string& name)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   auto it = mCont.xattrs().find(name);
 
   if (it != mCont.xattrs().end()) {
@@ -672,6 +731,7 @@ ContainerMD::removeAttribute(const std::string& name)
 void
 ContainerMD::serialize(Buffer& buffer)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   // Align the buffer to 4 bytes to efficiently compute the checksum
   ++mClock;
   size_t obj_size = mCont.ByteSizeLong();
@@ -737,14 +797,22 @@ ContainerMD::loadChildren()
 void
 ContainerMD::deserialize(Buffer& buffer)
 {
-  Serialization::deserializeContainer(buffer, mCont);
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Serialization::deserializeContainer(buffer, mCont);
+  }
+
   loadChildren();
 }
 
 void
 ContainerMD::initialize(eos::ns::ContainerMdProto&& proto)
 {
-  mCont = std::move(proto);
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCont = std::move(proto);
+  }
+
   loadChildren();
 }
 
@@ -756,6 +824,7 @@ eos::IFileMD::XAttrMap
 ContainerMD::getAttributes() const
 {
   XAttrMap xattrs;
+  std::lock_guard<std::mutex> lock(mMutex);
 
   for (const auto& elem : mCont.xattrs()) {
     xattrs.insert(elem);
@@ -772,6 +841,7 @@ ContainerMD::getEnv(std::string& env, bool escapeAnd)
 {
   env = "";
   std::ostringstream oss;
+  std::lock_guard<std::mutex> lock(mMutex);
   std::string saveName = mCont.name();
 
   if (escapeAnd) {
@@ -791,9 +861,9 @@ ContainerMD::getEnv(std::string& env, bool escapeAnd)
   ctime_t ctime;
   ctime_t mtime;
   ctime_t stime;
-  (void) getCTime(ctime);
-  (void) getMTime(mtime);
-  (void) getTMTime(stime);
+  (void) memcpy(&ctime, mCont.ctime().data(), sizeof(ctime));
+  (void) memcpy(&mtime, mCont.mtime().data(), sizeof(mtime));
+  (void) memcpy(&stime, mCont.stime().data(), sizeof(stime));
   oss << "name=" << saveName
       << "&id=" << mCont.id()
       << "&uid=" << mCont.uid() << "&gid=" << mCont.gid()
@@ -29,6 +29,7 @@
 #include "namespace/ns_quarkdb/BackendClient.hh"
 #include "namespace/ns_quarkdb/flusher/MetadataFlusher.hh"
 #include "proto/ContainerMd.pb.h"
+#include <mutex>
 #include <sys/time.h>
 
 EOSNSNAMESPACE_BEGIN
@@ -38,6 +39,16 @@ class IFileMDSvc;
 
 //------------------------------------------------------------------------------
 //! Class holding the metadata information concerning a single container
+//!
+//! The attribute accessors (times, mode, ownership, xattrs, tree size) are
+//! serialized by a per-object mutex so that they can be updated while holding
+//! the global namespace lock only in read mode. The maps of children are
+//! protected by the children lock, so files can be created while holding the
+//! global lock in read mode. The name and the parent are changed only while
+//! holding the global lock in write mode. Lock order: global namespace lock,
+//! children locks parent first, map loading mutexes, store stripe mutexes,
+//! object mutex. The object mutex is a leaf lock - the change listeners are
+//! always notified after releasing it.
 //------------------------------------------------------------------------------
 class ContainerMD : public IContainerMD
 {
@@ -133,6 +144,7 @@ public:
   inline id_t
   getParentId() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mCont.parent_id();
   }
 
@@ -142,6 +154,7 @@ public:
   void
   setParentId(id_t parentId) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mCont.set_parent_id(parentId);
   }
 
@@ -151,6 +164,7 @@ public:
   inline uint16_t
   getFlags() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mCont.flags();
   }
 
@@ -159,6 +173,7 @@ public:
   //----------------------------------------------------------------------------
   virtual void setFlags(uint16_t flags) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mCont.set_flags(0x00ff & flags);
   }
 
@@ -218,6 +233,7 @@ public:
   inline uint64_t
   getTreeSize() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mCont.tree_size();
   }
 
@@ -227,6 +243,7 @@ public:
   inline void
   setTreeSize(uint64_t treesize) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mCont.set_tree_size(treesize);
   }
 
@@ -236,7 +253,7 @@ public:
   uint64_t updateTreeSize(int64_t delta) override;
 
   //----------------------------------------------------------------------------
-  //! Get name
+  //! Get name - only changed while holding the global namespace write lock
   //----------------------------------------------------------------------------
   inline const std::string&
   getName() const override
@@ -255,6 +272,7 @@ public:
   inline uid_t
   getCUid() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mCont.uid();
   }
 
@@ -264,6 +282,7 @@ public:
   inline void
   setCUid(uid_t uid) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mCont.set_uid(uid);
   }
 
@@ -273,6 +292,7 @@ public:
   inline gid_t
   getCGid() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mCont.gid();
   }
 
@@ -282,6 +302,7 @@ public:
   inline void
   setCGid(gid_t gid) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mCont.set_gid(gid);
   }
 
@@ -291,6 +312,7 @@ public:
   inline mode_t
   getMode() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mCont.mode();
   }
 
@@ -300,6 +322,7 @@ public:
   inline void
   setMode(mode_t mode) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mCont.set_mode(mode);
   }
 
@@ -309,6 +332,7 @@ public:
   void
   setAttribute(const std::string& name, const std::string& value) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     (*mCont.mutable_xattrs())[name] = value;
   }
 
@@ -323,6 +347,7 @@ public:
   bool
   hasAttribute(const std::string& name) const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return (mCont.xattrs().find(name) != mCont.xattrs().end());
   }
 
@@ -332,6 +357,7 @@ public:
   size_t
   numAttributes() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mCont.xattrs().size();
   }
 
@@ -385,6 +411,7 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getClock() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mClock;
   }
 
@@ -397,7 +424,16 @@ public:
   void getEnv(std::string& env, bool escapeAnd = false) override;
 
   //----------------------------------------------------------------------------
-  //! Get iterator to the begining of the subcontainers map
+  //! Get the lock protecting the maps of children
+  //----------------------------------------------------------------------------
+  LockHandler* getChildrenLock() override
+  {
+    return &mChildrenLock;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get iterator to the begining of the subcontainers map, the children
+  //! lock must be held in read mode while iterating
   //----------------------------------------------------------------------------
   eos::IContainerMD::ContainerMap::const_iterator
   subcontainersBegin() override {
@@ -415,7 +451,8 @@ public:
   }
 
   //----------------------------------------------------------------------------
-  //! Get iterator to the begining of the files map
+  //! Get iterator to the begining of the files map, the children lock must
+  //! be held in read mode while iterating
   //----------------------------------------------------------------------------
   virtual eos::IContainerMD::FileMap::const_iterator
   filesBegin() override {
@@ -483,6 +520,8 @@ private:
 
   std::mutex mSubcontainersMtx;
   std::mutex mFilesMtx;
+  mutable std::mutex mMutex; ///< Mutex protecting the mCont fields
+  ObjectRWLock mChildrenLock; ///< Lock protecting the maps of children
 
   bool pSubContainersLoaded = true;
   bool pFilesLoaded = true;
@@ -59,6 +59,11 @@ FileMD::FileMD(const FileMD& other)
 FileMD&
 FileMD::operator = (const FileMD& other)
 {
+  if (this == &other) {
+    return *this;
+  }
+
+  std::lock_guard<std::mutex> lock(other.mMutex);
   mFile = other.mFile;
   mClock = other.mClock;
   pFileMDSvc   = 0;
@@ -71,11 +76,16 @@ FileMD::operator = (const FileMD& other)
 void
 FileMD::addLocation(location_t location)
 {
-  if (hasLocation(location)) {
-    return;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (hasLocationLocked(location)) {
+      return;
+    }
+
+    mFile.add_locations(location);
   }
 
-  mFile.add_locations(location);
   IFileMDChangeListener::Event e(this, IFileMDChangeListener::LocationAdded,
                                  location);
   pFileMDSvc->notifyListeners(&e);
@@ -87,10 +97,18 @@ FileMD::addLocation(location_t location)
 void
 FileMD::replaceLocation(unsigned int index, location_t newlocation)
 {
-  location_t oldLocation = mFile.locations(index);
+  location_t oldLocation;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    oldLocation = mFile.locations(index);
+
+    if (oldLocation != newlocation) {
+      mFile.set_locations(index, newlocation);
+    }
+  }
 
   if (oldLocation != newlocation) {
-    mFile.set_locations(index, newlocation);
     IFileMDChangeListener::Event e(this, IFileMDChangeListener::LocationReplaced,
                                    newlocation, oldLocation);
     pFileMDSvc->notifyListeners(&e);
@@ -103,16 +121,26 @@ FileMD::replaceLocation(unsigned int index, location_t newlocation)
 void
 FileMD::removeLocation(location_t location)
 {
-  for (auto it = mFile.mutable_unlink_locations()->cbegin();
-       it != mFile.mutable_unlink_locations()->cend(); ++it) {
-    if (*it == location) {
-      it = mFile.mutable_unlink_locations()->erase(it);
-      IFileMDChangeListener::Event
-      e(this, IFileMDChangeListener::LocationRemoved, location);
-      pFileMDSvc->notifyListeners(&e);
-      return;
+  bool found = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto it = mFile.mutable_unlink_locations()->cbegin();
+         it != mFile.mutable_unlink_locations()->cend(); ++it) {
+      if (*it == location) {
+        mFile.mutable_unlink_locations()->erase(it);
+        found = true;
+        break;
+      }
     }
   }
+
+  if (found) {
+    IFileMDChangeListener::Event
+    e(this, IFileMDChangeListener::LocationRemoved, location);
+    pFileMDSvc->notifyListeners(&e);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -124,12 +152,23 @@ FileMD::removeAllLocations()
   // @note: This needs to be done like this since the FileSystemView checks at
   // each steps if there are any locations or unlinked locations and then adds
   // the file to the set of files without replicas.
-  auto it = mFile.mutable_unlink_locations()->cbegin();
+  while (true) {
+    location_t location;
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      auto it = mFile.mutable_unlink_locations()->cbegin();
+
+      if (it == mFile.mutable_unlink_locations()->cend()) {
+        break;
+      }
+
+      location = *it;
+      mFile.mutable_unlink_locations()->erase(it);
+    }
 
-  while (it != mFile.mutable_unlink_locations()->cend()) {
     IFileMDChangeListener::Event
-    e(this, IFileMDChangeListener::LocationRemoved, *it);
-    it = mFile.mutable_unlink_locations()->erase(it);
+    e(this, IFileMDChangeListener::LocationRemoved, location);
     pFileMDSvc->notifyListeners(&e);
   }
 }
@@ -140,17 +179,27 @@ FileMD::removeAllLocations()
 void
 FileMD::unlinkLocation(location_t location)
 {
-  for (auto it = mFile.mutable_locations()->cbegin();
-       it != mFile.mutable_locations()->cend(); ++it) {
-    if (*it == location) {
-      mFile.add_unlink_locations(*it);
-      it = mFile.mutable_locations()->erase(it);
-      IFileMDChangeListener::Event
-      e(this, IFileMDChangeListener::LocationUnlinked, location);
-      pFileMDSvc->notifyListeners(&e);
-      return;
+  bool found = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto it = mFile.mutable_locations()->cbegin();
+         it != mFile.mutable_locations()->cend(); ++it) {
+      if (*it == location) {
+        mFile.add_unlink_locations(*it);
+        mFile.mutable_locations()->erase(it);
+        found = true;
+        break;
+      }
     }
   }
+
+  if (found) {
+    IFileMDChangeListener::Event
+    e(this, IFileMDChangeListener::LocationUnlinked, location);
+    pFileMDSvc->notifyListeners(&e);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -159,14 +208,20 @@ FileMD::unlinkLocation(location_t location)
 void
 FileMD::unlinkAllLocations()
 {
-  for (auto it = mFile.locations().cbegin();
-       it != mFile.locations().cend(); ++it) {
-    mFile.add_unlink_locations(*it);
+  LocationVector locations = getLocations();
+
+  for (auto location : locations) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mFile.add_unlink_locations(location);
+    }
+
     IFileMDChangeListener::Event
-    e(this, IFileMDChangeListener::LocationUnlinked, *it);
+    e(this, IFileMDChangeListener::LocationUnlinked, location);
     pFileMDSvc->notifyListeners(&e);
   }
 
+  std::lock_guard<std::mutex> lock(mMutex);
   mFile.clear_locations();
 }
 
@@ -178,6 +233,7 @@ FileMD::getEnv(std::string& env, bool escapeAnd)
 {
   env = "";
   std::ostringstream oss;
+  std::lock_guard<std::mutex> lock(mMutex);
   std::string saveName = mFile.name();
 
   if (escapeAnd) {
@@ -196,8 +252,8 @@ FileMD::getEnv(std::string& env, bool escapeAnd)
 
   ctime_t ctime;
   ctime_t mtime;
-  (void) getCTime(ctime);
-  (void) getMTime(mtime);
+  (void) memcpy(&ctime, mFile.ctime().data(), sizeof(ctime_t));
+  (void) memcpy(&mtime, mFile.mtime().data(), sizeof(time_t));
   oss << "name=" << saveName << "&id=" << mFile.id()
       << "&ctime=" << ctime.tv_sec << "&ctime_ns=" << ctime.tv_nsec
       << "&mtime=" << mtime.tv_sec << "&mtime_ns=" << mtime.tv_nsec
@@ -245,6 +301,7 @@ FileMD::serialize(eos::Buffer& buffer)
     throw ex;
   }
 
+  std::lock_guard<std::mutex> lock(mMutex);
   // Increase clock to mark that metadata file has suffered updates
   ++mClock;
   // Align the buffer to 4 bytes to efficiently compute the checksum
@@ -280,6 +337,7 @@ FileMD::serialize(eos::Buffer& buffer)
 void
 FileMD::initialize(eos::ns::FileMdProto &&proto)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   mFile = std::move(proto);
 }
 
@@ -289,6 +347,7 @@ FileMD::initialize(eos::ns::FileMdProto &&proto)
 void
 FileMD::deserialize(const eos::Buffer& buffer)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   Serialization::deserializeFile(buffer, mFile);
 }
 
@@ -298,8 +357,14 @@ FileMD::deserialize(const eos::Buffer& buffer)
 void
 FileMD::setSize(uint64_t size)
 {
-  int64_t sizeChange = (size & 0x0000ffffffffffff) - mFile.size();
-  mFile.set_size(size & 0x0000ffffffffffff);
+  int64_t sizeChange;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    sizeChange = (size & 0x0000ffffffffffff) - mFile.size();
+    mFile.set_size(size & 0x0000ffffffffffff);
+  }
+
   IFileMDChangeListener::Event e(this, IFileMDChangeListener::SizeChange, 0, 0,
                                  sizeChange);
   pFileMDSvc->notifyListeners(&e);
@@ -311,6 +376,7 @@ FileMD::setSize(uint64_t size)
 void
 FileMD::getCTime(ctime_t& ctime) const
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   (void) memcpy(&ctime, mFile.ctime().data(), sizeof(ctime_t));
 }
 
@@ -320,6 +386,7 @@ FileMD::getCTime(ctime_t& ctime) const
 void
 FileMD::setCTime(ctime_t ctime)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   mFile.set_ctime(&ctime, sizeof(ctime));
 }
 
@@ -338,6 +405,7 @@ FileMD::setCTimeNow()
 #else
   clock_gettime(CLOCK_REALTIME, &tnow);
 #endif
+  std::lock_guard<std::mutex> lock(mMutex);
   mFile.set_ctime(&tnow, sizeof(tnow));
 }
 
@@ -347,6 +415,7 @@ FileMD::setCTimeNow()
 void
 FileMD::getMTime(ctime_t& mtime) const
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   (void) memcpy(&mtime, mFile.mtime().data(), sizeof(time_t));
 }
 
@@ -356,6 +425,7 @@ FileMD::getMTime(ctime_t& mtime) const
 void
 FileMD::setMTime(ctime_t mtime)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   mFile.set_mtime(&mtime, sizeof(mtime));
 }
 
@@ -374,6 +444,7 @@ FileMD::setMTimeNow()
 #else
   clock_gettime(CLOCK_REALTIME, &tnow);
 #endif
+  std::lock_guard<std::mutex> lock(mMutex);
   mFile.set_mtime(&tnow, sizeof(tnow));
 }
 
@@ -384,6 +455,7 @@ eos::IFileMD::XAttrMap
 FileMD::getAttributes() const
 {
   std::map<std::string, std::string> xattrs;
+  std::lock_guard<std::mutex> lock(mMutex);
 
   for (const auto& elem : mFile.xattrs()) {
     xattrs.insert(elem);
@@ -392,8 +464,14 @@ FileMD::getAttributes() const
   return xattrs;
 }
 
+//------------------------------------------------------------------------------
+// Test the unlinked location
+//------------------------------------------------------------------------------
 bool
-FileMD::hasUnlinkedLocation(IFileMD::location_t location) {
+FileMD::hasUnlinkedLocation(IFileMD::location_t location)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+
   for (int i = 0; i < mFile.unlink_locations_size(); ++i) {
     if (mFile.unlink_locations()[i] == location) {
       return true;
@@ -403,4 +481,19 @@ FileMD::hasUnlinkedLocation(IFileMD::location_t location) {
   return false;
 }
 
+//------------------------------------------------------------------------------
+// Check if location exists, called with the object mutex held
+//------------------------------------------------------------------------------
+bool
+FileMD::hasLocationLocked(location_t location) const
+{
+  for (int i = 0; i < mFile.locations_size(); i++) {
+    if (mFile.locations(i) == location) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 EOSNSNAMESPACE_END
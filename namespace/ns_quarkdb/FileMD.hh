@@ -29,6 +29,7 @@
 #include "namespace/ns_quarkdb/persistency/FileMDSvc.hh"
 #include "proto/FileMd.pb.h"
 #include <cstdint>
+#include <mutex>
 #include <sys/time.h>
 
 EOSNSNAMESPACE_BEGIN
@@ -39,6 +40,13 @@ class IContainerMD;
 
 //------------------------------------------------------------------------------
 //! Class holding the metadata information concerning a single file
+//!
+//! The accessors are serialized by a per-object mutex so that attribute
+//! updates (times, flags, xattrs) can be done while holding the global
+//! namespace lock only in read mode. Changes of the structure of the namespace
+//! (create, rename, unlink, locations) still require the global lock in write
+//! mode. The object mutex is a leaf lock - the change listeners are always
+//! notified after releasing it.
 //------------------------------------------------------------------------------
 class FileMD : public IFileMD
 {
@@ -115,6 +123,7 @@ public:
   inline uint64_t
   getSize() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.size();
   }
 
@@ -129,6 +138,7 @@ public:
   inline IContainerMD::id_t
   getContainerId() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.cont_id();
   }
 
@@ -138,6 +148,7 @@ public:
   void
   setContainerId(IContainerMD::id_t containerId) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_cont_id(containerId);
   }
 
@@ -147,6 +158,7 @@ public:
   inline const Buffer
   getChecksum() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     Buffer buff(mFile.checksum().size());
     buff.putData((void*)mFile.checksum().data(), mFile.checksum().size());
     return buff;
@@ -162,6 +174,7 @@ public:
   bool
   checksumMatch(const void* checksum) const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return !memcmp(checksum, (void*)mFile.checksum().data(),
                    mFile.checksum().size());
   }
@@ -172,6 +185,7 @@ public:
   void
   setChecksum(const Buffer& checksum) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_checksum(checksum.getDataPtr(), checksum.getSize());
   }
 
@@ -181,6 +195,7 @@ public:
   void
   clearChecksum(uint8_t size = 20) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.clear_checksum();
   }
 
@@ -193,6 +208,7 @@ public:
   void
   setChecksum(const void* checksum, uint8_t size) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_checksum(checksum, size);
   }
 
@@ -202,6 +218,7 @@ public:
   inline const std::string
   getName() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.name();
   }
 
@@ -210,6 +227,7 @@ public:
   //----------------------------------------------------------------------------
   inline void setName(const std::string& name) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_name(name);
   }
 
@@ -223,6 +241,7 @@ public:
   //----------------------------------------------------------------------------
   inline LocationVector getLocations() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     LocationVector locations(mFile.locations().begin(), mFile.locations().end());
     return locations;
   }
@@ -233,6 +252,8 @@ public:
   location_t
   getLocation(unsigned int index) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
+
     if (index < (unsigned int)mFile.locations_size()) {
       return mFile.locations(index);
     }
@@ -261,6 +282,7 @@ public:
   void
   clearLocations() override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.clear_locations();
   }
 
@@ -270,13 +292,8 @@ public:
   bool
   hasLocation(location_t location) override
   {
-    for (int i = 0; i < mFile.locations_size(); i++) {
-      if (mFile.locations(i) == location) {
-        return true;
-      }
-    }
-
-    return false;
+    std::lock_guard<std::mutex> lock(mMutex);
+    return hasLocationLocked(location);
   }
 
   //----------------------------------------------------------------------------
@@ -285,6 +302,7 @@ public:
   inline size_t
   getNumLocation() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.locations_size();
   }
 
@@ -293,6 +311,7 @@ public:
   //----------------------------------------------------------------------------
   inline LocationVector getUnlinkedLocations() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     LocationVector unlinked_locations(mFile.unlink_locations().begin(),
                                       mFile.unlink_locations().end());
     return unlinked_locations;
@@ -314,6 +333,7 @@ public:
   inline void
   clearUnlinkedLocations() override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.clear_unlink_locations();
   }
 
@@ -329,6 +349,7 @@ public:
   inline size_t
   getNumUnlinkedLocation() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.unlink_locations_size();
   }
 
@@ -338,6 +359,7 @@ public:
   inline uid_t
   getCUid() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.uid();
   }
 
@@ -347,6 +369,7 @@ public:
   inline void
   setCUid(uid_t uid) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_uid(uid);
   }
 
@@ -356,6 +379,7 @@ public:
   inline gid_t
   getCGid() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.gid();
   }
 
@@ -365,6 +389,7 @@ public:
   inline void
   setCGid(gid_t gid) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_gid(gid);
   }
 
@@ -374,6 +399,7 @@ public:
   inline layoutId_t
   getLayoutId() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.layout_id();
   }
 
@@ -383,6 +409,7 @@ public:
   inline void
   setLayoutId(layoutId_t layoutId) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_layout_id(layoutId);
   }
 
@@ -392,6 +419,7 @@ public:
   inline uint16_t
   getFlags() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.flags();
   }
 
@@ -401,6 +429,7 @@ public:
   inline bool
   getFlag(uint8_t n) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return (bool)(mFile.flags() & (0x0001 << n));
   }
 
@@ -410,6 +439,7 @@ public:
   inline void
   setFlags(uint16_t flags) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_flags(flags);
   }
 
@@ -419,6 +449,8 @@ public:
   void
   setFlag(uint8_t n, bool flag) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
+
     if (flag) {
       mFile.set_flags(mFile.flags() | (1 << n));
     } else {
@@ -455,6 +487,7 @@ public:
   inline std::string
   getLink() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.link_name();
   }
 
@@ -464,6 +497,7 @@ public:
   inline void
   setLink(std::string link_name) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.set_link_name(link_name);
   }
 
@@ -473,6 +507,7 @@ public:
   bool
   isLink() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return !mFile.link_name().empty();
   }
 
@@ -482,6 +517,7 @@ public:
   void
   setAttribute(const std::string& name, const std::string& value) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     (*mFile.mutable_xattrs())[name] = value;
   }
 
@@ -491,6 +527,7 @@ public:
   void
   removeAttribute(const std::string& name) override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     auto it = mFile.xattrs().find(name);
 
     if (it != mFile.xattrs().end()) {
@@ -503,6 +540,7 @@ public:
   //----------------------------------------------------------------------------
   void clearAttributes() override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     mFile.clear_xattrs();
   }
 
@@ -512,6 +550,7 @@ public:
   bool
   hasAttribute(const std::string& name) const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return (mFile.xattrs().find(name) != mFile.xattrs().end());
   }
 
@@ -521,6 +560,7 @@ public:
   inline size_t
   numAttributes() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mFile.xattrs().size();
   }
 
@@ -530,6 +570,7 @@ public:
   std::string
   getAttribute(const std::string& name) const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     auto it = mFile.xattrs().find(name);
 
     if (it == mFile.xattrs().end()) {
@@ -568,6 +609,7 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getClock() const override
   {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mClock;
   };
 
@@ -575,8 +617,14 @@ protected:
   IFileMDSvc* pFileMDSvc;
 
 private:
+  //----------------------------------------------------------------------------
+  //! Check if location exists, must be called with the object mutex held
+  //----------------------------------------------------------------------------
+  bool hasLocationLocked(location_t location) const;
+
   eos::ns::FileMdProto mFile; ///< Protobuf file representation
   uint64_t mClock; ///< Value tracking metadata changes
+  mutable std::mutex mMutex; ///< Mutex protecting the object fields
 };
 
 EOSNSNAMESPACE_END
@@ -18,8 +18,8 @@
 
 //------------------------------------------------------------------------------
 //! @author Elvin-Alin Sindrilaru <esindril@cern.ch>
-//! @brief LRU cache for namespace objects making sure we never evict an entry
-//!        which is still referenced in other parts of the program.
+//! @brief Sharded LRU cache for namespace objects making sure we never evict
+//!        an entry which is still referenced in other parts of the program.
 //------------------------------------------------------------------------------
 
 #ifndef __EOS_NS_REDIS_LRU_HH__
@@ -27,11 +27,13 @@
 
 #include "common/RWMutex.hh"
 #include "namespace/Namespace.hh"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <list>
-#include <map>
 #include <memory>
-#include <mutex>
+#include <unordered_map>
 
 EOSNSNAMESPACE_BEGIN
 
@@ -62,17 +64,45 @@ struct hasGetId {
 
 //------------------------------------------------------------------------------
 //! LRU cache for namespace entries
+//!
+//! The cache is split into a power of two number of shards, each one having
+//! its own lock, hash map and eviction list. A cache hit takes the shard lock
+//! in shared mode and marks the entry as referenced - the eviction list is
+//! never modified on the hit path, so concurrent hits do not serialize.
+//! Eviction uses the "second chance" (CLOCK) policy: referenced entries are
+//! moved to the back of the list and unmarked, entries still referenced
+//! elsewhere in the program are skipped.
+//!
+//! The maximum size is split across the shards so that their capacities add
+//! up to it exactly. Small caches use fewer shards (at most one per entry),
+//! the entries are redistributed when the maximum size changes the number of
+//! shards in use.
 //------------------------------------------------------------------------------
 template <typename IdT, typename EntryT>
 class LRU
 {
 public:
+  //----------------------------------------------------------------------------
+  //! Cache statistics
+  //----------------------------------------------------------------------------
+  struct Stats {
+    std::uint64_t mHits; ///< Number of lookups that found the entry
+    std::uint64_t mMisses; ///< Number of lookups that did not find the entry
+    std::uint64_t mEvictions; ///< Number of entries evicted from the cache
+    std::uint64_t mSize; ///< Current number of entries
+    std::uint64_t mMaxSize; ///< Maximum number of entries
+    std::uint64_t mNumShards; ///< Number of shards in use
+  };
+
   //----------------------------------------------------------------------------
   //! Constructor
   //!
   //! @param maxSize maximum number of entries in the cache
+  //! @param num_shards number of shards, rounded up to a power of two. If 0
+  //!        then it is computed based on the maximum size of the cache. The
+  //!        number of shards in use never exceeds the maximum size.
   //----------------------------------------------------------------------------
-  LRU(std::uint64_t maxSize);
+  LRU(std::uint64_t maxSize, std::uint64_t num_shards = 0);
 
   //----------------------------------------------------------------------------
   //! Destructor
@@ -119,8 +149,13 @@ public:
   inline std::uint64_t
   size() const
   {
-    eos::common::RWMutexWriteLock lock_w(mMutex);
-    return mMap.size();
+    std::uint64_t total = 0ull;
+
+    for (std::uint64_t i = 0; i < mNumShards; ++i) {
+      total += mShards[i].mSize.load(std::memory_order_relaxed);
+    }
+
+    return total;
   }
 
   //----------------------------------------------------------------------------
@@ -128,16 +163,20 @@ public:
   //!
   //! @param max_size new maximum number of entries
   //----------------------------------------------------------------------------
-  inline void
-  set_max_size(const std::uint64_t max_size)
-  {
-    eos::common::RWMutexWriteLock lock_w(mMutex);
-    mMaxSize = max_size;
-  }
+  void set_max_size(const std::uint64_t max_size);
+
+  //----------------------------------------------------------------------------
+  //! Get cache statistics
+  //----------------------------------------------------------------------------
+  Stats getStats() const;
 
 private:
   //! Percentage at which the cache purging stops
   static constexpr double sPurgeStopRatio = 0.9;
+  //! Minimum number of entries per shard when computing the number of shards
+  static constexpr std::uint64_t sMinShardSize = 16 * 1024;
+  //! Maximum number of shards
+  static constexpr std::uint64_t sMaxNumShards = 256;
 
   //! Forbid copying or moving LRU objects
   LRU(const LRU& other) = delete;
@@ -145,30 +184,235 @@ private:
   LRU(LRU&& other) = delete;
   LRU& operator=(LRU&& other) = delete;
 
-  using ListT = std::list<std::shared_ptr<EntryT>>;
-  typename std::list<std::shared_ptr<EntryT>>::iterator ListIterT;
-  using MapT = std::map<IdT, decltype(ListIterT)>;
-  MapT mMap;   ///< Internal map pointing to obj in list
-  ListT mList; ///< Internal list of objects where new/used objects are at the
-  ///< end of the list
-  // TODO: in C++17 use std::shared_mutex
-  //! Mutext to protect access to the map and list which is set to blocking
-  // mutable eos::common::RWMutex mMutex;
-  mutable eos::common::RWMutex mMutex;
-  std::uint64_t mMaxSize; ///< Maximum number of entries
+  //----------------------------------------------------------------------------
+  //! Cache entry holding the object and the CLOCK reference bit
+  //----------------------------------------------------------------------------
+  struct Node {
+    explicit Node(const std::shared_ptr<EntryT>& obj):
+      mObj(obj), mReferenced(false) {}
+
+    std::shared_ptr<EntryT> mObj;
+    std::atomic<bool> mReferenced;
+  };
+
+  using ListT = std::list<Node>;
+  using MapT = std::unordered_map<IdT, typename ListT::iterator>;
+
+  //----------------------------------------------------------------------------
+  //! Cache shard
+  //----------------------------------------------------------------------------
+  struct Shard {
+    Shard(): mMaxSize(0ull), mSize(0ull), mHits(0ull), mMisses(0ull),
+      mEvictions(0ull)
+    {
+      mMutex.SetBlocking(true);
+    }
+
+    // TODO: in C++17 use std::shared_mutex
+    mutable eos::common::RWMutex mMutex; ///< Protects the map and list
+    MapT mMap; ///< Internal map pointing to obj in list
+    ListT mList; ///< Eviction list where new objects are at the end
+    std::atomic<std::uint64_t> mMaxSize; ///< Maximum number of entries
+    std::atomic<std::uint64_t> mSize; ///< Number of entries in the shard
+    std::atomic<std::uint64_t> mHits; ///< Number of hits
+    std::atomic<std::uint64_t> mMisses; ///< Number of misses
+    std::atomic<std::uint64_t> mEvictions; ///< Number of evictions
+  };
+
+  //----------------------------------------------------------------------------
+  //! Get index of the shard responsible for the given id
+  //!
+  //! @param id entry id
+  //! @param num_active number of shards in use
+  //----------------------------------------------------------------------------
+  static inline std::uint64_t
+  getShardIndex(IdT id, std::uint64_t num_active)
+  {
+    return std::hash<IdT>()(id) & (num_active - 1);
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the shard responsible for the given id and lock it. The number of
+  //! shards in use only changes while all shards are write locked, so it is
+  //! checked again once the lock is held.
+  //!
+  //! @param id entry id
+  //! @param lock lock to grab on the shard
+  //----------------------------------------------------------------------------
+  template <typename LockT>
+  Shard&
+  lockShard(IdT id, LockT& lock)
+  {
+    while (true) {
+      std::uint64_t num_active = mActiveShards.load();
+      Shard& shard = mShards[getShardIndex(id, num_active)];
+      lock.Grab(shard.mMutex);
+
+      if (num_active == mActiveShards.load()) {
+        return shard;
+      }
+
+      lock.Release();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Compute the number of shards to use for the given maximum size
+  //----------------------------------------------------------------------------
+  std::uint64_t computeActiveShards(std::uint64_t max_size) const;
+
+  //----------------------------------------------------------------------------
+  //! Move entries to the shard responsible for them after a change of the
+  //! number of shards in use. All shard locks must be taken in write mode.
+  //!
+  //! @param num_active new number of shards in use
+  //----------------------------------------------------------------------------
+  void redistribute(std::uint64_t num_active);
+
+  //----------------------------------------------------------------------------
+  //! Purge entries from the given shard, shard lock must be taken in write
+  //! mode.
+  //!
+  //! @param shard shard to be purged
+  //----------------------------------------------------------------------------
+  void purge(Shard& shard);
+
+  std::uint64_t mNumShards; ///< Number of allocated shards, power of two
+  std::uint64_t mRequestedShards; ///< Requested number of shards, 0 if auto
+  std::unique_ptr<Shard[]> mShards; ///< Cache shards
+  std::atomic<std::uint64_t> mActiveShards; ///< Shards in use, power of two
+  std::atomic<std::uint64_t> mMaxSize; ///< Maximum number of entries
 };
 
-// Definition of class static member
+// Definition of class static members
 template <typename IdT, typename EntryT>
 constexpr double LRU<IdT, EntryT>::sPurgeStopRatio;
+template <typename IdT, typename EntryT>
+constexpr std::uint64_t LRU<IdT, EntryT>::sMinShardSize;
+template <typename IdT, typename EntryT>
+constexpr std::uint64_t LRU<IdT, EntryT>::sMaxNumShards;
 
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
 template <typename IdT, typename EntryT>
-LRU<IdT, EntryT>::LRU(std::uint64_t max_size) : mMutex(), mMaxSize(max_size)
+LRU<IdT, EntryT>::LRU(std::uint64_t max_size, std::uint64_t num_shards):
+  mNumShards(1ull), mRequestedShards(num_shards), mActiveShards(1ull),
+  mMaxSize(max_size)
 {
-  mMutex.SetBlocking(true);
+  if (num_shards == 0) {
+    num_shards = std::min(sMaxNumShards, max_size / sMinShardSize);
+  }
+
+  while (mNumShards < num_shards) {
+    mNumShards <<= 1;
+  }
+
+  mShards.reset(new Shard[mNumShards]);
+  set_max_size(max_size);
+}
+
+//------------------------------------------------------------------------------
+// Compute the number of shards to use for the given maximum size
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+std::uint64_t
+LRU<IdT, EntryT>::computeActiveShards(std::uint64_t max_size) const
+{
+  std::uint64_t wanted = mRequestedShards;
+
+  if (wanted == 0) {
+    wanted = std::min(sMaxNumShards, max_size / sMinShardSize);
+  }
+
+  // Round up to a power of two, then halve until every shard in use can hold
+  // at least one entry
+  std::uint64_t num_active = 1ull;
+
+  while (num_active < wanted) {
+    num_active <<= 1;
+  }
+
+  while ((num_active > 1) &&
+         ((num_active > mNumShards) || (num_active > max_size))) {
+    num_active >>= 1;
+  }
+
+  return num_active;
+}
+
+//------------------------------------------------------------------------------
+// Set max size
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+void
+LRU<IdT, EntryT>::set_max_size(const std::uint64_t max_size)
+{
+  // Lock all shards in index order since entries may move between them
+  std::unique_ptr<eos::common::RWMutexWriteLock[]> locks
+  (new eos::common::RWMutexWriteLock[mNumShards]);
+
+  for (std::uint64_t i = 0; i < mNumShards; ++i) {
+    locks[i].Grab(mShards[i].mMutex);
+  }
+
+  // Spread the remainder across the first shards so that the capacities add
+  // up to max_size
+  const std::uint64_t num_active = computeActiveShards(max_size);
+  const std::uint64_t base = max_size / num_active;
+  const std::uint64_t remainder = max_size % num_active;
+  mMaxSize = max_size;
+
+  for (std::uint64_t i = 0; i < mNumShards; ++i) {
+    mShards[i].mMaxSize = (i < num_active) ? base + (i < remainder ? 1 : 0) : 0;
+  }
+
+  if (num_active != mActiveShards.load()) {
+    redistribute(num_active);
+    mActiveShards = num_active;
+  }
+
+  // Shrink the shards above their new capacity
+  for (std::uint64_t i = 0; i < num_active; ++i) {
+    if (mShards[i].mMap.size() > mShards[i].mMaxSize.load()) {
+      purge(mShards[i]);
+      mShards[i].mSize.store(mShards[i].mMap.size(), std::memory_order_relaxed);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Move entries to the shard responsible for them
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+void
+LRU<IdT, EntryT>::redistribute(std::uint64_t num_active)
+{
+  for (std::uint64_t i = 0; i < mNumShards; ++i) {
+    Shard& shard = mShards[i];
+    auto iter = shard.mList.begin();
+
+    while (iter != shard.mList.end()) {
+      IdT id = iter->mObj->getId();
+      std::uint64_t target = getShardIndex(id, num_active);
+
+      if (target == i) {
+        ++iter;
+        continue;
+      }
+
+      // Splicing keeps the node, so the reference bit is preserved
+      Shard& dst = mShards[target];
+      auto to_move = iter++;
+      dst.mList.splice(dst.mList.end(), shard.mList, to_move);
+      shard.mMap.erase(id);
+      dst.mMap.emplace(id, to_move);
+    }
+  }
+
+  for (std::uint64_t i = 0; i < mNumShards; ++i) {
+    mShards[i].mSize.store(mShards[i].mMap.size(), std::memory_order_relaxed);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -177,9 +421,11 @@ LRU<IdT, EntryT>::LRU(std::uint64_t max_size) : mMutex(), mMaxSize(max_size)
 template <typename IdT, typename EntryT>
 LRU<IdT, EntryT>::~LRU()
 {
-  eos::common::RWMutexWriteLock lock_w(mMutex);
-  mMap.clear();
-  mList.clear();
+  for (std::uint64_t i = 0; i < mNumShards; ++i) {
+    eos::common::RWMutexWriteLock lock_w(mShards[i].mMutex);
+    mShards[i].mMap.clear();
+    mShards[i].mList.clear();
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -189,18 +435,24 @@ template <typename IdT, typename EntryT>
 std::shared_ptr<EntryT>
 LRU<IdT, EntryT>::get(IdT id)
 {
-  eos::common::RWMutexWriteLock lock_w(mMutex);
-  auto iter_map = mMap.find(id);
+  eos::common::RWMutexReadLock lock_r;
+  Shard& shard = lockShard(id, lock_r);
+  auto iter_map = shard.mMap.find(id);
 
-  if (iter_map == mMap.end()) {
+  if (iter_map == shard.mMap.end()) {
+    shard.mMisses.fetch_add(1, std::memory_order_relaxed);
     return nullptr;
   }
 
-  // Move object to the end of the list i.e. recently accessed
-  auto iter_new = mList.insert(mList.end(), *iter_map->second);
-  mList.erase(iter_map->second);
-  mMap[id] = iter_new;
-  return *iter_new;
+  shard.mHits.fetch_add(1, std::memory_order_relaxed);
+  Node& node = *iter_map->second;
+
+  // Only write the reference bit if needed to avoid cache line bouncing
+  if (!node.mReferenced.load(std::memory_order_relaxed)) {
+    node.mReferenced.store(true, std::memory_order_relaxed);
+  }
+
+  return node.mObj;
 }
 
 //------------------------------------------------------------------------------
@@ -210,33 +462,23 @@ template <typename IdT, typename EntryT>
 typename std::enable_if<hasGetId<EntryT>::value, std::shared_ptr<EntryT>>::type
     LRU<IdT, EntryT>::put(IdT id, std::shared_ptr<EntryT> obj)
 {
-  eos::common::RWMutexWriteLock lock_w(mMutex);
-  auto iter_map = mMap.find(id);
+  eos::common::RWMutexWriteLock lock_w;
+  Shard& shard = lockShard(id, lock_w);
+  auto iter_map = shard.mMap.find(id);
 
-  if (iter_map != mMap.end()) {
-    return *(iter_map->second);
+  if (iter_map != shard.mMap.end()) {
+    return iter_map->second->mObj;
   }
 
-  // Check if map full and purge some entries if necessary 10% of max size
-  if (mMap.size() >= mMaxSize) {
-    auto iter = mList.begin();
-
-    while ((iter != mList.end()) &&
-           (mMap.size() > sPurgeStopRatio * mMaxSize)) {
-      // If object is referenced also by someone else then skip it
-      if (iter->use_count() > 1) {
-        ++iter;
-        continue;
-      }
-
-      mMap.erase((*iter)->getId());
-      iter = mList.erase(iter);
-    }
+  // Check if shard full and purge some entries if necessary
+  if (shard.mMap.size() >= shard.mMaxSize.load()) {
+    purge(shard);
   }
 
-  auto iter = mList.insert(mList.end(), obj);
-  mMap.emplace(id, iter);
-  return *iter;
+  auto iter = shard.mList.emplace(shard.mList.end(), obj);
+  shard.mMap.emplace(id, iter);
+  shard.mSize.store(shard.mMap.size(), std::memory_order_relaxed);
+  return iter->mObj;
 }
 
 //------------------------------------------------------------------------------
@@ -246,18 +488,76 @@ template <typename IdT, typename EntryT>
 bool
 LRU<IdT, EntryT>::remove(IdT id)
 {
-  eos::common::RWMutexWriteLock lock_w(mMutex);
-  auto iter_map = mMap.find(id);
+  eos::common::RWMutexWriteLock lock_w;
+  Shard& shard = lockShard(id, lock_w);
+  auto iter_map = shard.mMap.find(id);
 
-  if (iter_map == mMap.end()) {
+  if (iter_map == shard.mMap.end()) {
     return false;
   }
 
-  (void)mList.erase(iter_map->second);
-  mMap.erase(iter_map);
+  (void)shard.mList.erase(iter_map->second);
+  shard.mMap.erase(iter_map);
+  shard.mSize.store(shard.mMap.size(), std::memory_order_relaxed);
   return true;
 }
 
+//------------------------------------------------------------------------------
+// Purge entries from shard until sPurgeStopRatio of the shard size is reached
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+void
+LRU<IdT, EntryT>::purge(Shard& shard)
+{
+  const double stop_size = sPurgeStopRatio * shard.mMaxSize.load();
+  // Every entry gets at most a second chance so bound the number of steps
+  std::uint64_t max_steps = 2 * shard.mList.size();
+  auto iter = shard.mList.begin();
+
+  while ((iter != shard.mList.end()) && max_steps &&
+         (shard.mMap.size() > stop_size)) {
+    --max_steps;
+
+    // Recently accessed - clear the reference and give it a second chance
+    if (iter->mReferenced.load(std::memory_order_relaxed)) {
+      iter->mReferenced.store(false, std::memory_order_relaxed);
+      auto to_move = iter++;
+      shard.mList.splice(shard.mList.end(), shard.mList, to_move);
+      continue;
+    }
+
+    // If object is referenced also by someone else then skip it
+    if (iter->mObj.use_count() > 1) {
+      ++iter;
+      continue;
+    }
+
+    shard.mMap.erase(iter->mObj->getId());
+    iter = shard.mList.erase(iter);
+    shard.mEvictions.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get cache statistics
+//------------------------------------------------------------------------------
+template <typename IdT, typename EntryT>
+typename LRU<IdT, EntryT>::Stats
+LRU<IdT, EntryT>::getStats() const
+{
+  Stats stats {0ull, 0ull, 0ull, 0ull, mMaxSize.load(), mActiveShards.load()};
+
+  for (std::uint64_t i = 0; i < mNumShards; ++i) {
+    const Shard& shard = mShards[i];
+    stats.mHits += shard.mHits.load(std::memory_order_relaxed);
+    stats.mMisses += shard.mMisses.load(std::memory_order_relaxed);
+    stats.mEvictions += shard.mEvictions.load(std::memory_order_relaxed);
+    stats.mSize += shard.mSize.load(std::memory_order_relaxed);
+  }
+
+  return stats;
+}
+
 EOSNSNAMESPACE_END
 
 #endif // __EOS_NS_REDIS_LRU_HH__
@@ -19,20 +19,27 @@
 #include "namespace/ns_quarkdb/accounting/ContainerAccounting.hh"
 #include <iostream>
 #include <chrono>
+#include <functional>
 
 EOSNSNAMESPACE_BEGIN
 
+// Definition of class static members
+constexpr uint64_t ContainerAccounting::sNumShards;
+constexpr uint64_t ContainerAccounting::sSliceSize;
+constexpr uint64_t ContainerAccounting::sMaxParentCacheSize;
+constexpr uint16_t ContainerAccounting::sMaxDeepness;
+
 //----------------------------------------------------------------------------
 // Constructor
 //----------------------------------------------------------------------------
 ContainerAccounting::ContainerAccounting(IContainerMDSvc* svc,
     eos::common::RWMutex* ns_mutex, int32_t update_interval)
-  : mAccumulateIndx(0), mCommitIndx(1), mShutdown(false),
+  : mShards(new Shard[sNumShards]), mQueueDepth(0), mTreeGeneration(0),
+    mCacheGeneration(0), mLastBatchSize(0), mLastLatencyMs(0),
+    mMaxLatencyMs(0), mNumPropagations(0), mNumUpdates(0), mShutdown(false),
     mUpdateIntervalSec(update_interval), mContainerMDSvc(svc),
     gNsRwMutex(ns_mutex)
 {
-  mBatch.resize(2);
-
   // If update interval is 0 then we disable async updates
   if (mUpdateIntervalSec) {
     mThread = std::thread(&ContainerAccounting::PropagateUpdates, this);
@@ -82,6 +89,8 @@ ContainerAccounting::fileMDChanged(IFileMDChangeListener::Event* e)
 void
 ContainerAccounting::AddTree(IContainerMD* obj, int64_t dsize)
 {
+  // A subtree was moved, the cached parent chains might be stale
+  ++mTreeGeneration;
   QueueForUpdate(obj->getId(), dsize);
 }
 
@@ -91,6 +100,7 @@ ContainerAccounting::AddTree(IContainerMD* obj, int64_t dsize)
 void
 ContainerAccounting::RemoveTree(IContainerMD* obj, int64_t dsize)
 {
+  ++mTreeGeneration;
   QueueForUpdate(obj->getId(), -dsize);
 }
 
@@ -100,32 +110,166 @@ ContainerAccounting::RemoveTree(IContainerMD* obj, int64_t dsize)
 void
 ContainerAccounting::QueueForUpdate(IContainerMD::id_t id, int64_t dsize)
 {
-  uint16_t deepness = 0;
-  std::shared_ptr<IContainerMD> cont;
-  std::lock_guard<std::mutex> scope_lock(mMutexBatch);
-  auto& batch = mBatch[mAccumulateIndx];
-
-  while ((id > 1) && (deepness < 255)) {
-    try {
-      cont = mContainerMDSvc->getContainerMD(id);
-    } catch (const MDException& e) {
-      // TODO (esindril): error message using default logging
-      break;
+  if ((id <= 1) || (dsize == 0)) {
+    return;
+  }
+
+  Shard& shard = mShards[std::hash<std::thread::id>()(std::this_thread::get_id())
+                         & (sNumShards - 1)];
+  std::lock_guard<std::mutex> scope_lock(shard.mMutex);
+  auto it_map = shard.mMap.find(id);
+
+  if (it_map != shard.mMap.end()) {
+    it_map->second += dsize;
+  } else {
+    shard.mMap.emplace(id, dsize);
+    ++mQueueDepth;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Collect the size deltas queued in all the shards
+//------------------------------------------------------------------------------
+void
+ContainerAccounting::CollectUpdates(DeltaMapT& updates)
+{
+  DeltaMapT tmp;
+
+  for (uint64_t i = 0; i < sNumShards; ++i) {
+    {
+      std::lock_guard<std::mutex> scope_lock(mShards[i].mMutex);
+      std::swap(tmp, mShards[i].mMap);
     }
 
-    auto it_map = batch.mMap.find(id);
+    mQueueDepth -= tmp.size();
 
-    if (it_map != batch.mMap.end()) {
-      it_map->second += dsize;
+    if (updates.empty()) {
+      std::swap(updates, tmp);
     } else {
-      batch.mMap.emplace(id, dsize);
+      for (auto const& elem : tmp) {
+        updates[elem.first] += elem.second;
+      }
+
+      tmp.clear();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Get parent id of a container
+//------------------------------------------------------------------------------
+IContainerMD::id_t
+ContainerAccounting::GetParentId(IContainerMD::id_t id)
+{
+  auto it = mParentCache.find(id);
+
+  if (it != mParentCache.end()) {
+    return it->second;
+  }
+
+  IContainerMD::id_t parent_id = 0;
+
+  try {
+    parent_id = mContainerMDSvc->getContainerMD(id)->getParentId();
+  } catch (const MDException& e) {
+    // TODO (esindril): error message using default logging
+    return 0;
+  }
+
+  if (mParentCache.size() >= sMaxParentCacheSize) {
+    mParentCache.clear();
+  }
+
+  mParentCache.emplace(id, parent_id);
+  return parent_id;
+}
+
+//------------------------------------------------------------------------------
+// Compute the deltas for all the parents of the updated containers
+//------------------------------------------------------------------------------
+void
+ContainerAccounting::ComputeTreeDeltas(const DeltaMapT& updates,
+                                       DeltaMapT& batch)
+{
+  // Subtrees are moved under the namespace write lock, so the generation is
+  // read again after every acquisition of the read lock. If it changed, the
+  // parent chains walked so far might be stale and the walk starts over.
+  auto cache_valid = [this]() {
+    uint64_t generation = mTreeGeneration.load();
+
+    if (generation == mCacheGeneration) {
+      return true;
+    }
+
+    mParentCache.clear();
+    mCacheGeneration = generation;
+    return false;
+  };
+  uint64_t count = 0;
+  eos::common::RWMutexReadLock rd_lock(*gNsRwMutex);
+  (void) cache_valid();
+  auto it = updates.begin();
+
+  while (it != updates.end()) {
+    IContainerMD::id_t id = it->first;
+    uint16_t deepness = 0;
+
+    while ((id > 1) && (deepness < sMaxDeepness)) {
+      batch[id] += it->second;
+      id = GetParentId(id);
+      ++deepness;
     }
 
-    id = cont->getParentId();
-    ++deepness;
+    ++it;
+
+    // Don't starve the writers for too long
+    if ((++count % sSliceSize) == 0) {
+      gNsRwMutex->UnLockRead();
+      gNsRwMutex->LockRead();
+
+      if (!cache_valid()) {
+        batch.clear();
+        it = updates.begin();
+      }
+    }
   }
 }
 
+//------------------------------------------------------------------------------
+// Apply deltas to the namespace in short read lock slices
+//------------------------------------------------------------------------------
+void
+ContainerAccounting::ApplyUpdates(const DeltaMapT& batch)
+{
+  auto it = batch.begin();
+  std::shared_ptr<IContainerMD> cont;
+
+  while (it != batch.end()) {
+    // The tree size is updated atomically by the container object itself and
+    // the store update is ordered per container, so the namespace lock is only
+    // needed in read mode to keep the containers from being removed.
+    eos::common::RWMutexReadLock rd_lock(*gNsRwMutex);
+
+    for (uint64_t count = 0; (it != batch.end()) && (count < sSliceSize);
+         ++it, ++count) {
+      if (it->second == 0) {
+        continue;
+      }
+
+      try {
+        cont = mContainerMDSvc->getContainerMD(it->first);
+        cont->updateTreeSize(it->second);
+        mContainerMDSvc->updateStore(cont.get());
+      } catch (const MDException& e) {
+        // TODO: (esindril) error message using default logging
+        continue;
+      }
+    }
+  }
+
+  cont.reset();
+}
+
 //------------------------------------------------------------------------------
 // Propagate updates in the hierarchical structure. Method ran by the
 // asynchronous thread.
@@ -138,31 +282,26 @@ ContainerAccounting::PropagateUpdates()
       break;
     }
 
-    {
-      // Update the indexes to have the async thread working on the batch to
-      // commit and the incoming updates to go to the batch to update
-      std::lock_guard<std::mutex> scope_lock(mMutexBatch);
-      std::swap(mAccumulateIndx, mCommitIndx);
-    }
+    auto start = std::chrono::steady_clock::now();
+    DeltaMapT updates;
+    CollectUpdates(updates);
 
-    auto& batch = mBatch[mCommitIndx];
-    {
-      // Need to lock the namespace
-      eos::common::RWMutexWriteLock wr_lock(*gNsRwMutex);
-      std::shared_ptr<IContainerMD> cont;
-
-      for (auto const& elem : batch.mMap) {
-        try {
-          cont = mContainerMDSvc->getContainerMD(elem.first);
-          cont->updateTreeSize(elem.second);
-          mContainerMDSvc->updateStore(cont.get());
-        } catch (const MDException& e) {
-          // TODO: (esindril) error message using default logging
-          continue;
-        }
+    if (!updates.empty()) {
+      DeltaMapT batch;
+      ComputeTreeDeltas(updates, batch);
+      ApplyUpdates(batch);
+      uint64_t duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>
+                             (std::chrono::steady_clock::now() - start).count();
+      mLastBatchSize = batch.size();
+      mLastLatencyMs = duration_ms;
+      mNumUpdates += batch.size();
+
+      if (duration_ms > mMaxLatencyMs) {
+        mMaxLatencyMs = duration_ms;
       }
     }
-    batch.mMap.clear();
+
+    ++mNumPropagations;
 
     if (mUpdateIntervalSec) {
       std::this_thread::sleep_for(std::chrono::seconds(mUpdateIntervalSec));
@@ -172,4 +311,18 @@ ContainerAccounting::PropagateUpdates()
   }
 }
 
+//------------------------------------------------------------------------------
+// Get accounting statistics
+//------------------------------------------------------------------------------
+void
+ContainerAccounting::getAccountingStats(AccountingStats& stats)
+{
+  stats.mQueueDepth = mQueueDepth.load();
+  stats.mLastBatchSize = mLastBatchSize.load();
+  stats.mLastLatencyMs = mLastLatencyMs.load();
+  stats.mMaxLatencyMs = mMaxLatencyMs.load();
+  stats.mNumPropagations = mNumPropagations.load();
+  stats.mNumUpdates = mNumUpdates.load();
+}
+
 EOSNSNAMESPACE_END
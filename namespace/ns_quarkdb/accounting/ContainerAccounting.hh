@@ -25,7 +25,10 @@
 #include "namespace/Namespace.hh"
 #include "namespace/interface/IContainerMDSvc.hh"
 #include "namespace/interface/IFileMDSvc.hh"
+#include "namespace/interface/IAccountingStats.hh"
 #include "common/RWMutex.hh"
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -37,7 +40,8 @@ EOSNSNAMESPACE_BEGIN
 //------------------------------------------------------------------------------
 //! Container subtree accounting listener
 //------------------------------------------------------------------------------
-class ContainerAccounting : public IFileMDChangeListener
+class ContainerAccounting : public IFileMDChangeListener,
+  public IAccountingStats
 {
 public:
   //----------------------------------------------------------------------------
@@ -105,7 +109,8 @@ public:
   void RemoveTree(IContainerMD* obj, int64_t dsize);
 
   //----------------------------------------------------------------------------
-  //! Queue info for update
+  //! Queue info for update. Only the delta of the given container is
+  //! recorded, the propagation to the parents is done by the async thread.
   //!
   //! @param pid container id
   //! @param dsize size change
@@ -118,22 +123,77 @@ public:
   //----------------------------------------------------------------------------
   void PropagateUpdates();
 
-private:
+  //----------------------------------------------------------------------------
+  //! Get accounting statistics
+  //!
+  //! @param stats filled with the current accounting statistics
+  //----------------------------------------------------------------------------
+  void getAccountingStats(AccountingStats& stats) override;
 
-  //! Update structure containing the nodes that need an update. We try to
+private:
+  using DeltaMapT = std::unordered_map<IContainerMD::id_t, int64_t>;
+  //! Number of shards accumulating updates, power of 2
+  static constexpr uint64_t sNumShards = 32;
+  //! Max number of containers handled while holding the namespace lock
+  static constexpr uint64_t sSliceSize = 1000;
+  //! Max number of entries in the parent cache
+  static constexpr uint64_t sMaxParentCacheSize = 1000000;
+  //! Max depth of propagation
+  static constexpr uint16_t sMaxDeepness = 255;
+
+  //! Shard accumulating the size deltas of the containers. We try to
   //! optimise the number of updates to the backend by computing the final
-  //! size deltas from a number of individual updates.
-  struct UpdateT {
-    std::unordered_map<IContainerMD::id_t, int64_t> mMap; ///< Map updates
+  //! size deltas from a number of individual updates. Threads are spread
+  //! over the shards so that writers don't contend on a single lock.
+  struct Shard {
+    std::mutex mMutex; ///< Mutex protecting the map
+    DeltaMapT mMap; ///< Map container id to size delta
   };
 
-  //! Vector of two elements containing the batch which is currently being
-  //! accumulated and the batch which is being commited to the namespace by
-  //! the asynchronous thread
-  std::vector<UpdateT> mBatch;
-  std::mutex mMutexBatch; ///< Mutex protecting access to the updates batch
-  uint8_t mAccumulateIndx; ///< Index of the batch accumulating updates
-  uint8_t mCommitIndx; ///< Index o the batch committing updates
+  //----------------------------------------------------------------------------
+  //! Collect the size deltas queued in all the shards
+  //!
+  //! @param updates map holding the merged deltas
+  //----------------------------------------------------------------------------
+  void CollectUpdates(DeltaMapT& updates);
+
+  //----------------------------------------------------------------------------
+  //! Compute the deltas for all the parents of the updated containers
+  //!
+  //! @param updates map of direct container updates
+  //! @param batch map of deltas to be applied, including the parents
+  //----------------------------------------------------------------------------
+  void ComputeTreeDeltas(const DeltaMapT& updates, DeltaMapT& batch);
+
+  //----------------------------------------------------------------------------
+  //! Get parent id of a container, cached across propagation cycles. Must be
+  //! called with the namespace lock held.
+  //!
+  //! @param id container id
+  //!
+  //! @return parent id or 0 if container could not be retrieved
+  //----------------------------------------------------------------------------
+  IContainerMD::id_t GetParentId(IContainerMD::id_t id);
+
+  //----------------------------------------------------------------------------
+  //! Apply deltas to the namespace in short read lock slices
+  //!
+  //! @param batch map of deltas to be applied
+  //----------------------------------------------------------------------------
+  void ApplyUpdates(const DeltaMapT& batch);
+
+  std::unique_ptr<Shard[]> mShards; ///< Shards accumulating updates
+  std::atomic<uint64_t> mQueueDepth; ///< Num. of containers with deltas
+  //! Parent id cache, only used by the async thread and invalidated when
+  //! subtrees are moved around (AddTree/RemoveTree)
+  std::unordered_map<IContainerMD::id_t, IContainerMD::id_t> mParentCache;
+  std::atomic<uint64_t> mTreeGeneration; ///< Bumped on tree moves
+  uint64_t mCacheGeneration; ///< Generation of the parent cache
+  std::atomic<uint64_t> mLastBatchSize; ///< Last propagation batch size
+  std::atomic<uint64_t> mLastLatencyMs; ///< Last propagation duration
+  std::atomic<uint64_t> mMaxLatencyMs; ///< Max propagation duration
+  std::atomic<uint64_t> mNumPropagations; ///< Num. of propagation cycles
+  std::atomic<uint64_t> mNumUpdates; ///< Total num. of container updates
   std::thread mThread; ///< Thread updating the namespace
   std::atomic<bool> mShutdown; ///< Flag to shutdown the async thread
   uint32_t mUpdateIntervalSec; ///< Interval in seconds when updates are pushed
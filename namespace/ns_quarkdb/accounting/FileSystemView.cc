@@ -19,6 +19,8 @@
 #include "namespace/ns_quarkdb/accounting/FileSystemView.hh"
 #include "namespace/ns_quarkdb/Constants.hh"
 #include "namespace/ns_quarkdb/FileMD.hh"
+#include "namespace/ns_quarkdb/persistency/FileMDSvc.hh"
+#include "namespace/ns_quarkdb/persistency/MetadataFetcher.hh"
 #include "common/StringTokenizer.hh"
 #include "common/Logging.hh"
 #include "qclient/QScanner.hh"
@@ -26,6 +28,204 @@
 
 EOSNSNAMESPACE_BEGIN
 
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+QdbFileIterator::QdbFileIterator(qclient::QClient& qcl, const std::string& key,
+                                 int64_t count):
+  mQcl(qcl), mKey(key), mCursor("0"), mCount(count), mIt(mPage.end())
+{
+  requestPage();
+  loadPage();
+}
+
+//------------------------------------------------------------------------------
+// Retrieve next file id
+//------------------------------------------------------------------------------
+void
+QdbFileIterator::next()
+{
+  if (valid()) {
+    ++mIt;
+
+    if (mIt == mPage.end()) {
+      loadPage();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Request the page following the current cursor
+//------------------------------------------------------------------------------
+void
+QdbFileIterator::requestPage()
+{
+  mNextPage = mQcl.exec("SSCAN", mKey, mCursor, "COUNT",
+                        std::to_string(mCount));
+}
+
+//------------------------------------------------------------------------------
+// Make the requested page the current one and request the following one
+//------------------------------------------------------------------------------
+void
+QdbFileIterator::loadPage()
+{
+  mPage.clear();
+
+  while (mPage.empty() && mNextPage.valid()) {
+    qclient::redisReplyPtr reply = mNextPage.get();
+
+    if (!reply || (reply->type != REDIS_REPLY_ARRAY) || (reply->elements != 2) ||
+        (reply->element[0]->type != REDIS_REPLY_STRING) ||
+        (reply->element[1]->type != REDIS_REPLY_ARRAY)) {
+      mIt = mPage.end();
+      throw std::runtime_error("Unexpected SSCAN response for key " + mKey +
+                               ": " + qclient::describeRedisReply(reply));
+    }
+
+    mCursor.assign(reply->element[0]->str, reply->element[0]->len);
+    redisReply* elements = reply->element[1];
+    mPage.reserve(elements->elements);
+
+    for (size_t i = 0; i < elements->elements; ++i) {
+      mPage.emplace_back(elements->element[i]->str, elements->element[i]->len);
+    }
+
+    // Keep the backend busy while the current page is consumed
+    if (mCursor != "0") {
+      requestPage();
+    }
+  }
+
+  mIt = mPage.begin();
+}
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+QdbFileMDIterator::QdbFileMDIterator(qclient::QClient& qcl,
+                                     const std::string& key,
+                                     IFileMDSvc* file_svc):
+  mQcl(qcl), mIds(qcl, key), mFileSvc(file_svc), mPos(0), mNumFailed(0)
+{
+  fillPipeline();
+  loadBatch();
+}
+
+//------------------------------------------------------------------------------
+// Retrieve next file metadata object
+//------------------------------------------------------------------------------
+void
+QdbFileMDIterator::next()
+{
+  if (valid()) {
+    ++mPos;
+
+    if (mPos == mFiles.size()) {
+      loadBatch();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Send batches until enough of them are in flight
+//------------------------------------------------------------------------------
+void
+QdbFileMDIterator::fillPipeline()
+{
+  FileMDSvc* qdb_file_svc = dynamic_cast<FileMDSvc*>(mFileSvc);
+
+  while ((mInFlight.size() < sBatchesInFlight) && mIds.valid()) {
+    Batch batch;
+    batch.mFetchIds.reserve(sBatchSize);
+
+    for (size_t num = 0; (num < sBatchSize) && mIds.valid(); mIds.next()) {
+      std::shared_ptr<IFileMD> fmd;
+      ++num;
+
+      // No need to go to the backend for the cached files
+      if (qdb_file_svc &&
+          qdb_file_svc->getCachedFileMD(mIds.getElement(), fmd)) {
+        if (fmd) {
+          batch.mCached.push_back(fmd);
+        }
+      } else {
+        batch.mFetchIds.push_back(mIds.getElement());
+      }
+    }
+
+    auto promise = std::make_shared<std::promise<BatchResult>>();
+    batch.mFetched = promise->get_future();
+
+    if (batch.mFetchIds.empty()) {
+      promise->set_value(BatchResult());
+    } else {
+      MetadataFetcher::getFilesFromIds(mQcl, batch.mFetchIds,
+                                       [promise](std::vector<MDStatus>&& statuses,
+      std::vector<eos::ns::FileMdProto>&& protos) {
+        promise->set_value(BatchResult(std::move(statuses), std::move(protos)));
+      });
+    }
+
+    mInFlight.push_back(std::move(batch));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Wait for the next batch holding at least one file
+//------------------------------------------------------------------------------
+void
+QdbFileMDIterator::loadBatch()
+{
+  FileMDSvc* qdb_file_svc = dynamic_cast<FileMDSvc*>(mFileSvc);
+  mFiles.clear();
+  mPos = 0;
+
+  while (mFiles.empty() && !mInFlight.empty()) {
+    Batch batch = std::move(mInFlight.front());
+    mInFlight.pop_front();
+    BatchResult result = batch.mFetched.get();
+    // Refill before building the objects so that the backend stays busy
+    fillPipeline();
+    mFiles = std::move(batch.mCached);
+    mFiles.reserve(mFiles.size() + result.second.size());
+
+    for (size_t i = 0; i < result.second.size(); ++i) {
+      if (!result.first[i].ok()) {
+        ++mNumFailed;
+        eos_static_err("msg=\"failed to fetch file metadata\" fid=%llu err=\"%s\"",
+                       (unsigned long long) batch.mFetchIds[i],
+                       result.first[i].getError().c_str());
+        continue;
+      }
+
+      std::shared_ptr<IFileMD> fmd;
+
+      if (qdb_file_svc) {
+        fmd = qdb_file_svc->getFileMDFromProto(std::move(result.second[i]));
+      } else {
+        try {
+          fmd = mFileSvc->getFileMD(batch.mFetchIds[i]);
+        } catch (MDException& e) {
+          ++mNumFailed;
+          eos_static_err("msg=\"failed to get file metadata\" fid=%llu err=\"%s\"",
+                         (unsigned long long) batch.mFetchIds[i],
+                         e.getMessage().str().c_str());
+        }
+      }
+
+      if (fmd) {
+        mFiles.push_back(fmd);
+      }
+    }
+  }
+
+  if (mFiles.empty() && mNumFailed) {
+    eos_static_err("msg=\"skipped files which could not be retrieved\" "
+                   "nfailed=%llu", (unsigned long long) mNumFailed);
+  }
+}
+
 //------------------------------------------------------------------------------
 // Constructor
 //------------------------------------------------------------------------------
@@ -91,6 +291,7 @@ FileSystemView::fileMDChanged(IFileMDChangeListener::Event* e)
   std::string key, val;
   FileMD* file = static_cast<FileMD*>(e->file);
   qclient::QSet fs_set;
+  std::lock_guard<std::mutex> lock(mMutex);
 
   switch (e->action) {
   // New file has been created
@@ -278,6 +479,7 @@ FileSystemView::fileMDCheck(IFileMD* file)
 std::shared_ptr<ICollectionIterator<IFileMD::location_t>>
     FileSystemView::getFileSystemIterator()
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   return std::shared_ptr<ICollectionIterator<IFileMD::location_t>>
          (new ListFileSystemIterator(pFiles));
 }
@@ -288,13 +490,15 @@ std::shared_ptr<ICollectionIterator<IFileMD::location_t>>
 std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
     FileSystemView::getFileList(IFileMD::location_t location)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
+
   if (pFiles.find(location) == pFiles.end()) {
     return nullptr;
   }
 
   CacheFiles(location);
   return std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
-         (new FileIterator(pFiles[location]));
+         (new FileListCopyIterator(pFiles[location]));
 }
 
 //------------------------------------------------------------------------------
@@ -303,13 +507,15 @@ std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
 std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
     FileSystemView::getUnlinkedFileList(IFileMD::location_t location)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
+
   if (pUnlinkedFiles.find(location) == pUnlinkedFiles.end()) {
     return nullptr;
   }
 
   CacheUnlinkedFiles(location);
   return std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
-         (new FileIterator(pUnlinkedFiles[location]));
+         (new FileListCopyIterator(pUnlinkedFiles[location]));
 }
 
 //------------------------------------------------------------------------------
@@ -318,9 +524,10 @@ std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
 std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
     FileSystemView::getNoReplicasFileList()
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   CacheNoReplicasFiles();
   return std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
-         (new FileIterator(pNoReplicas));
+         (new FileListCopyIterator(pNoReplicas));
 }
 
 //------------------------------------------------------------------------------
@@ -329,6 +536,7 @@ std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
 uint64_t
 FileSystemView::getNumNoReplicasFiles()
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   CacheNoReplicasFiles();
   return pNoReplicas.size();
 }
@@ -339,6 +547,7 @@ FileSystemView::getNumNoReplicasFiles()
 uint64_t
 FileSystemView::getNumFilesOnFs(IFileMD::location_t fs_id)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   auto it = pFiles.find(fs_id);
 
   if (it == pFiles.end()) {
@@ -355,6 +564,7 @@ FileSystemView::getNumFilesOnFs(IFileMD::location_t fs_id)
 uint64_t
 FileSystemView::getNumUnlinkedFilesOnFs(IFileMD::location_t fs_id)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   auto it = pUnlinkedFiles.find(fs_id);
 
   if (it == pUnlinkedFiles.end()) {
@@ -371,6 +581,7 @@ FileSystemView::getNumUnlinkedFilesOnFs(IFileMD::location_t fs_id)
 bool
 FileSystemView::hasFileId(IFileMD::id_t fid, IFileMD::location_t fs_id)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   auto it = pFiles.find(fs_id);
 
   if (it != pFiles.end()) {
@@ -391,6 +602,7 @@ FileSystemView::hasFileId(IFileMD::id_t fid, IFileMD::location_t fs_id)
 bool
 FileSystemView::clearUnlinkedFileList(IFileMD::location_t location)
 {
+  std::lock_guard<std::mutex> lock(mMutex);
   auto it = pUnlinkedFiles.find(location);
 
   if (it == pUnlinkedFiles.end()) {
@@ -475,6 +687,26 @@ std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
          (new QdbFileIterator(*pQcl, key));
 }
 
+//------------------------------------------------------------------------------
+// Get streaming iterator to the metadata of the files on a file system
+//------------------------------------------------------------------------------
+std::shared_ptr<ICollectionIterator<std::shared_ptr<IFileMD>>>
+    FileSystemView::getStreamingFileMDList(IFileMD::location_t location,
+        IFileMDSvc* file_svc)
+{
+  // Make sure the backend has seen all the updates before scanning it
+  pFlusher->synchronize();
+  std::string key = keyFilesystemFiles(location);
+
+  // Don't look at pFiles, it is protected by the namespace lock
+  if (qclient::QSet(*pQcl, key).scard() == 0) {
+    return nullptr;
+  }
+
+  return std::shared_ptr<ICollectionIterator<std::shared_ptr<IFileMD>>>
+         (new QdbFileMDIterator(*pQcl, key, file_svc));
+}
+
 //------------------------------------------------------------------------------
 // Get iterator to list of unlinked files on a particular file system
 //------------------------------------------------------------------------------
@@ -505,6 +737,7 @@ FileSystemView::loadFromBackend()
   std::vector<std::string> patterns {
     fsview::sPrefix + "*:files",
     fsview::sPrefix + "*:unlinked" };
+  std::lock_guard<std::mutex> lock(mMutex);
 
   for (const auto& pattern : patterns) {
     for (auto it = getQdbFileSystemIterator(pattern);
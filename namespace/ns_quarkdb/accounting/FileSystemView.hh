@@ -29,6 +29,10 @@
 #include "namespace/interface/IFsView.hh"
 #include "namespace/ns_quarkdb/BackendClient.hh"
 #include "namespace/ns_quarkdb/flusher/MetadataFlusher.hh"
+#include "proto/FileMd.pb.h"
+#include <deque>
+#include <future>
+#include <mutex>
 #include <utility>
 
 EOSNSNAMESPACE_BEGIN
@@ -91,6 +95,10 @@ private:
 //! Class QdbFileIterator that can iterate through a list of files from the
 //! FileSystem class. Used to iterate through the files / unlinked files on a
 //! filesystem.
+//!
+//! The set is scanned page by page with SSCAN. Every page request depends on
+//! the cursor returned by the previous one, so while the current page is
+//! consumed the next one is already requested from the backend.
 //------------------------------------------------------------------------------
 class QdbFileIterator:
   public ICollectionIterator<IFileMD::id_t>
@@ -98,14 +106,13 @@ class QdbFileIterator:
 public:
   //----------------------------------------------------------------------------
   //! Constructor
+  //!
+  //! @param qcl qclient object
+  //! @param key set to iterate through
+  //! @param count max number of elements requested per page
   //----------------------------------------------------------------------------
-  QdbFileIterator(qclient::QClient& qcl, const std::string& key) :
-    mSet(qcl, key), mCursor("0")
-  {
-    mReply = mSet.sscan(mCursor, mCount);
-    mCursor = mReply.first;
-    mIt = mReply.second.begin();
-  }
+  QdbFileIterator(qclient::QClient& qcl, const std::string& key,
+                  int64_t count = 250000);
 
   //----------------------------------------------------------------------------
   //! Destructor
@@ -117,7 +124,7 @@ public:
   //----------------------------------------------------------------------------
   bool valid() override
   {
-    return (mIt != mReply.second.end());
+    return (mIt != mPage.end());
   }
 
   //----------------------------------------------------------------------------
@@ -131,25 +138,110 @@ public:
   //----------------------------------------------------------------------------
   //! Retrieve next file id
   //----------------------------------------------------------------------------
-  void next() override
+  void next() override;
+
+private:
+  //----------------------------------------------------------------------------
+  //! Request the page following the current cursor, if any
+  //----------------------------------------------------------------------------
+  void requestPage();
+
+  //----------------------------------------------------------------------------
+  //! Wait for the requested page and make it the current one, skipping
+  //! empty pages. Throws std::runtime_error in case of backend errors.
+  //----------------------------------------------------------------------------
+  void loadPage();
+
+  qclient::QClient& mQcl; ///< QClient object
+  std::string mKey; ///< Set to iterate through
+  std::string mCursor; ///< Cursor used while scanning the set
+  int64_t mCount; ///< Max number of elements returned at once
+  std::future<qclient::redisReplyPtr> mNextPage; ///< Page in flight
+  std::vector<std::string> mPage; ///< Current page
+  std::vector<std::string>::iterator mIt; ///< Iterator to element to return
+};
+
+//------------------------------------------------------------------------------
+//! Class QdbFileMDIterator streaming the metadata of the files of a set. The
+//! file ids are split in batches. The files found in the cache are taken from
+//! there, and the HGETs of the other ones are pipelined towards the backend
+//! ahead of the consumer. Files which can not be retrieved are logged and
+//! skipped. The iterator does not use any of the in-memory view structures,
+//! so it does not need the namespace lock.
+//------------------------------------------------------------------------------
+class QdbFileMDIterator:
+  public ICollectionIterator<std::shared_ptr<IFileMD>>
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //!
+  //! @param qcl qclient object
+  //! @param key set holding the file ids
+  //! @param file_svc file metadata service owning the returned objects
+  //----------------------------------------------------------------------------
+  QdbFileMDIterator(qclient::QClient& qcl, const std::string& key,
+                    IFileMDSvc* file_svc);
+
+  //----------------------------------------------------------------------------
+  //! Destructor
+  //----------------------------------------------------------------------------
+  virtual ~QdbFileMDIterator() = default;
+
+  //----------------------------------------------------------------------------
+  //! Check if iterator is valid
+  //----------------------------------------------------------------------------
+  bool valid() override
   {
-    if (valid()) {
-      ++mIt;
+    return (mPos < mFiles.size());
+  }
 
-      if ((mIt == mReply.second.end()) && (mCursor != "0")) {
-        mReply = mSet.sscan(mCursor, mCount);
-        mCursor = mReply.first;
-        mIt = mReply.second.begin();
-      }
-    }
+  //----------------------------------------------------------------------------
+  //! Get current file metadata object
+  //----------------------------------------------------------------------------
+  std::shared_ptr<IFileMD> getElement() override
+  {
+    return mFiles[mPos];
   }
 
+  //----------------------------------------------------------------------------
+  //! Retrieve next file metadata object
+  //----------------------------------------------------------------------------
+  void next() override;
+
 private:
-  qclient::QSet mSet; ///< Set to iterate through
-  std::string mCursor; ///< Cursor used while scanning the set
-  int64_t mCount = 2000000; ///< Max number of elements returned at once
-  std::pair<std::string, std::vector<std::string>> mReply;
-  std::vector<std::string>::iterator mIt; ///< Iterator to element to return
+  static constexpr size_t sBatchSize = 1000; ///< Files per batch
+  static constexpr size_t sBatchesInFlight = 16; ///< Batches ahead of consumer
+
+  //! Statuses and protobufs of a batch, in the order of the requested ids
+  typedef std::pair<std::vector<MDStatus>, std::vector<eos::ns::FileMdProto>>
+      BatchResult;
+
+  //! Batch of files in flight
+  struct Batch {
+    std::vector<std::shared_ptr<IFileMD>> mCached; ///< Files found in cache
+    std::vector<id_t> mFetchIds; ///< Ids fetched from the backend
+    std::future<BatchResult> mFetched; ///< Result of fetching mFetchIds
+  };
+
+  //----------------------------------------------------------------------------
+  //! Send batches until enough of them are in flight or there are no more ids
+  //----------------------------------------------------------------------------
+  void fillPipeline();
+
+  //----------------------------------------------------------------------------
+  //! Wait for batches until one of them holds at least one file, or no more
+  //! batches are left
+  //----------------------------------------------------------------------------
+  void loadBatch();
+
+  qclient::QClient& mQcl; ///< QClient object
+  QdbFileIterator mIds; ///< Iterator through the file ids
+  IFileMDSvc* mFileSvc; ///< File metadata service
+  std::deque<Batch> mInFlight; ///< Batches in flight
+  std::vector<std::shared_ptr<IFileMD>> mFiles; ///< Current batch
+  size_t mPos; ///< Position in the current batch
+  uint64_t mNumFailed; ///< Number of files which could not be retrieved
 };
 
 //------------------------------------------------------------------------------
@@ -227,6 +319,10 @@ private:
 //!
 //! fsview_noreplicas - file ids that don't have any replicas on any fs
 //! fsview:x:unlinked - set of file ids that are unlinked on file system "x"
+//!
+//! The in-memory sets are protected by a leaf mutex since files are created
+//! and committed while holding the namespace lock only in read mode. The file
+//! lists are returned as copies taken under that mutex.
 //------------------------------------------------------------------------------
 class FileSystemView : public IFsView
 {
@@ -271,6 +367,22 @@ public:
   std::shared_ptr<ICollectionIterator<IFileMD::id_t>>
       getFileList(IFileMD::location_t location) override;
 
+  //----------------------------------------------------------------------------
+  //! Get streaming iterator to the metadata of the files on a particular file
+  //! system. The ids are scanned directly from the backend and the metadata
+  //! is fetched in pipelined batches. This waits for the flusher and talks
+  //! only to the backend, so it is meant to be called without holding the
+  //! namespace lock.
+  //!
+  //! @param location file system id
+  //! @param file_svc file metadata service
+  //!
+  //! @return shared ptr to collection iterator
+  //----------------------------------------------------------------------------
+  std::shared_ptr<ICollectionIterator<std::shared_ptr<IFileMD>>>
+      getStreamingFileMDList(IFileMD::location_t location,
+                             IFileMDSvc* file_svc) override;
+
   //----------------------------------------------------------------------------
   //! Get number of files on the given file system
   //!
@@ -407,21 +519,24 @@ private:
       getQdbFileList(IFileMD::location_t location);
 
   //----------------------------------------------------------------------------
-  //! Cache from backend the list of file on the file system
+  //! Cache from backend the list of file on the file system, must be called
+  //! with the view mutex locked
   //!
   //! @param fsid file system id
   //----------------------------------------------------------------------------
   void CacheFiles(IFileMD::location_t fsid);
 
   //----------------------------------------------------------------------------
-  //! Cache from backend the list of unlinked file on the file system
+  //! Cache from backend the list of unlinked file on the file system, must be
+  //! called with the view mutex locked
   //!
   //! @param fsid file system id
   //----------------------------------------------------------------------------
   void CacheUnlinkedFiles(IFileMD::location_t fsid);
 
   //----------------------------------------------------------------------------
-  //! Cache from backend the list of files without replicas
+  //! Cache from backend the list of files without replicas, must be called
+  //! with the view mutex locked
   //----------------------------------------------------------------------------
   void CacheNoReplicasFiles();
 
@@ -438,6 +553,7 @@ private:
   MetadataFlusher* pFlusher; ///< Metadata flusher object
   qclient::QClient* pQcl;    ///< QClient object
   qclient::QSet pNoReplicasSet; ///< Set of file ids without replicas
+  std::mutex mMutex; ///< Mutex protecting the in-memory sets
 };
 
 //------------------------------------------------------------------------------
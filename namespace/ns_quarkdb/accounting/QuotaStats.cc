@@ -69,6 +69,7 @@ QuotaNode::addFile(const IFileMD* file)
   );
 
   // Update the cached information
+  std::lock_guard<std::mutex> lock(mUsageMutex);
   UsageInfo& user  = pUserUsage[file->getCUid()];
   UsageInfo& group = pGroupUsage[file->getCGid()];
   user.physicalSpace  += size;
@@ -103,6 +104,7 @@ QuotaNode::removeFile(const IFileMD* file)
   );
 
   // Update the cached information
+  std::lock_guard<std::mutex> lock(mUsageMutex);
   UsageInfo& user  = pUserUsage[file->getCUid()];
   UsageInfo& group = pGroupUsage[file->getCGid()];
   user.physicalSpace  -= size;
@@ -149,14 +151,24 @@ QuotaNode::meld(const IQuotaNode* node)
     }
   } while (cursor != "0");
 
-  // Update the cached information
-  for (auto it1 = impl_node->pUserUsage.begin();
-       it1 != impl_node->pUserUsage.end(); ++it1) {
+  // Update the cached information, copy the other node first so that the
+  // two usage mutexes are never held together
+  UserMap user_usage;
+  GroupMap group_usage;
+
+  {
+    std::lock_guard<std::mutex> lock(impl_node->mUsageMutex);
+    user_usage = impl_node->pUserUsage;
+    group_usage = impl_node->pGroupUsage;
+  }
+
+  std::lock_guard<std::mutex> lock(mUsageMutex);
+
+  for (auto it1 = user_usage.begin(); it1 != user_usage.end(); ++it1) {
     pUserUsage[it1->first] += it1->second;
   }
 
-  for (auto it2 = impl_node->pGroupUsage.begin();
-       it2 != impl_node->pGroupUsage.end(); ++it2) {
+  for (auto it2 = group_usage.begin(); it2 != group_usage.end(); ++it2) {
     pGroupUsage[it2->first] += it2->second;
   }
 }
@@ -175,6 +187,7 @@ void QuotaNode::updateFromBackend()
   do {
     reply = uid_map.hscan(cursor, count);
     cursor = reply.first;
+    std::lock_guard<std::mutex> lock(mUsageMutex);
 
     for (const auto& elem : reply.second) {
       size_t pos = elem.first.find(':');
@@ -204,6 +217,7 @@ void QuotaNode::updateFromBackend()
   do {
     reply = gid_map.hscan(cursor, count);
     cursor = reply.first;
+    std::lock_guard<std::mutex> lock(mUsageMutex);
 
     for (const auto& elem : reply.second) {
       size_t pos = elem.first.find(':');
@@ -294,18 +308,30 @@ QuotaStats::configure(const std::map<std::string, std::string>& config)
 IQuotaNode*
 QuotaStats::getQuotaNode(IContainerMD::id_t node_id)
 {
-  if (pNodeMap.count(node_id) != 0u) {
-    return pNodeMap[node_id];
+  {
+    std::lock_guard<std::mutex> lock(mNodeMapMutex);
+    auto it = pNodeMap.find(node_id);
+
+    if (it != pNodeMap.end()) {
+      return it->second;
+    }
   }
 
   std::string snode_id = std::to_string(node_id);
 
   if ((pQcl->exists(KeyQuotaUidMap(snode_id)) == 1) ||
       (pQcl->exists(KeyQuotaGidMap(snode_id)) == 1)) {
-    QuotaNode* ptr = new QuotaNode(this, node_id);
+    std::unique_ptr<QuotaNode> ptr(new QuotaNode(this, node_id));
     ptr->updateFromBackend();
-    pNodeMap[node_id] = static_cast<IQuotaNode*>(ptr);
-    return ptr;
+    std::lock_guard<std::mutex> lock(mNodeMapMutex);
+    // Somebody else might have loaded it in the meantime
+    auto pair = pNodeMap.emplace(node_id, ptr.get());
+
+    if (pair.second) {
+      (void) ptr.release();
+    }
+
+    return pair.first->second;
   }
 
   return nullptr;
@@ -318,6 +344,7 @@ IQuotaNode*
 QuotaStats::registerNewNode(IContainerMD::id_t node_id)
 {
   std::string snode_id = std::to_string(node_id);
+  std::lock_guard<std::mutex> lock(mNodeMapMutex);
 
   if (pNodeMap.count(node_id) ||
       (pQcl->exists(KeyQuotaUidMap(snode_id)) == 1) ||
@@ -338,8 +365,12 @@ QuotaStats::registerNewNode(IContainerMD::id_t node_id)
 void
 QuotaStats::removeNode(IContainerMD::id_t node_id)
 {
-  if (pNodeMap.count(node_id) != 0u) {
-    pNodeMap.erase(node_id);
+  {
+    std::lock_guard<std::mutex> lock(mNodeMapMutex);
+
+    if (pNodeMap.count(node_id) != 0u) {
+      pNodeMap.erase(node_id);
+    }
   }
 
   std::string snode_id = std::to_string(node_id);
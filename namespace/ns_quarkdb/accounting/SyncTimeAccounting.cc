@@ -124,7 +124,9 @@ SyncTimeAccounting::PropagateUpdates()
 
       eos_debug("Container_id=%lu sync time", id);
       IContainerMD::ctime_t mtime {0};
-      eos::common::RWMutexWriteLock wr_lock(*gNsRwMutex);
+      // The sync time is only advanced atomically by the container object,
+      // the namespace read lock keeps the containers from being removed.
+      eos::common::RWMutexReadLock rd_lock(*gNsRwMutex);
 
       while ((id > 1) && (deepness < 255)) {
         std::shared_ptr<IContainerMD> cont;
@@ -20,6 +20,7 @@
 #include "namespace/utils/PathProcessor.hh"
 #include "namespace/ns_quarkdb/persistency/MetadataFetcher.hh"
 #include "common/Assert.hh"
+#include <algorithm>
 #include <memory>
 #include <numeric>
 
@@ -27,6 +28,105 @@
 
 EOSNSNAMESPACE_BEGIN
 
+//------------------------------------------------------------------------------
+// Constructor - fire off all requests needed to explore this container.
+//------------------------------------------------------------------------------
+SearchNode::SearchNode(qclient::QClient &qclient, id_t d, const std::string &pth,
+  int dpth, bool fetchContents)
+: qcl(qclient), id(d), fullPath(pth), depth(dpth) {
+
+  containerMdFut = MetadataFetcher::getContainerFromId(qcl, id);
+
+  if(fetchContents) {
+    fileMapFut = MetadataFetcher::getFilesInContainer(qcl, id);
+    containerMapFut = MetadataFetcher::getSubContainers(qcl, id);
+  }
+  else {
+    fileMapReady = true;
+    containerMapReady = true;
+  }
+}
+
+eos::ns::ContainerMdProto& SearchNode::getContainerInfo() {
+  if(!containerMdReady) {
+    containerMd = containerMdFut.get();
+    containerMdReady = true;
+  }
+
+  return containerMd;
+}
+
+//------------------------------------------------------------------------------
+// Extract the ids out of a file or container map, sorted by name.
+//------------------------------------------------------------------------------
+template<typename MapT>
+void SearchNode::sortedIds(MapT &&contents, std::vector<id_t> &ids) {
+  std::vector<std::pair<std::string, id_t>> entries;
+  entries.reserve(contents.size());
+
+  for(auto it = contents.begin(); it != contents.end(); it++) {
+    entries.emplace_back(it->first, it->second);
+  }
+
+  std::sort(entries.begin(), entries.end());
+  ids.reserve(entries.size());
+
+  for(auto it = entries.begin(); it != entries.end(); it++) {
+    ids.push_back(it->second);
+  }
+}
+
+bool SearchNode::fetchFile(eos::ns::FileMdProto &proto, size_t window) {
+  if(!fileMapReady) {
+    sortedIds(fileMapFut.get(), pendingFileIds);
+    fileMapReady = true;
+  }
+
+  // Keep the window of outstanding requests full
+  while(filesToGive.size() < window && nextFileId < pendingFileIds.size()) {
+    filesToGive.emplace_back(MetadataFetcher::getFileFromId(qcl, pendingFileIds[nextFileId++]));
+  }
+
+  if(filesToGive.empty()) {
+    return false;
+  }
+
+  proto = filesToGive.front().get();
+  filesToGive.pop_front();
+  return true;
+}
+
+bool SearchNode::fetchChild(std::unique_ptr<SearchNode> &child, size_t window,
+  bool fetchChildContents) {
+
+  if(!containerMapReady) {
+    sortedIds(containerMapFut.get(), pendingContainerIds);
+    containerMapReady = true;
+  }
+
+  // Each child node has up to three requests in flight
+  size_t childWindow = std::max<size_t>(1, window / 3);
+
+  while(childrenToGive.size() < childWindow && nextContainerId < pendingContainerIds.size()) {
+    // The full path of the child is only known once its metadata arrives
+    childrenToGive.emplace_back(new SearchNode(qcl, pendingContainerIds[nextContainerId++],
+      "", depth + 1, fetchChildContents));
+  }
+
+  if(childrenToGive.empty()) {
+    return false;
+  }
+
+  child = std::move(childrenToGive.front());
+  childrenToGive.pop_front();
+  child->fullPath = fullPath + child->getContainerInfo().name() + "/";
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Constructor - resolve the starting path. Only the container ids of the
+// intermediate path elements are needed, so a single round-trip per element.
+//------------------------------------------------------------------------------
 NamespaceExplorer::NamespaceExplorer(const std::string &pth, const ExplorationOptions &opts, qclient::QClient &qclient)
 : path(pth), options(opts), qcl(qclient) {
 
@@ -40,39 +140,81 @@ NamespaceExplorer::NamespaceExplorer(const std::string &pth, const ExplorationOp
     throw e;
   }
 
-  // This part is synchronous by necessity,
-  SearchNode root;
-  root.container = MetadataFetcher::getContainerFromId(qcl, 1).get();
-  state.nodes.push_back(root);
+  // This part is synchronous by necessity.
+  id_t currentId = 1;
+  std::string fullPath = "/";
 
   for(size_t i = 0; i < pathParts.size(); i++) {
-    id_t parentID = state.nodes.back().container.id();
-    id_t nextId = MetadataFetcher::getContainerIDFromName(qcl, parentID, pathParts[i]).get();
-
-    SearchNode next;
-    next.container = MetadataFetcher::getContainerFromId(qcl, nextId).get();
-    state.nodes.push_back(next);
+    currentId = MetadataFetcher::getContainerIDFromName(qcl, currentId, pathParts[i]).get();
+    fullPath += pathParts[i];
+    fullPath += "/";
   }
 
-  state.pendingFileIds.set_deleted_key("");
-  state.pendingFileIds.set_empty_key("##_EMPTY_##");
-  populatePendingItems(state.nodes.back().container.id());
+  dfsPath.emplace_back(new SearchNode(qcl, currentId, fullPath, 0, options.depthLimit > 0));
 }
 
-void NamespaceExplorer::populatePendingItems(id_t container) {
-  eos_assert(state.pendingFileIds.empty());
-  state.pendingFileIds = MetadataFetcher::getFilesInContainer(qcl, container).get();
+bool NamespaceExplorer::passesFilter(const NamespaceItem &item) const {
+  return !options.filter || options.filter(item);
+}
+
+bool NamespaceExplorer::shouldExpand(SearchNode &node) {
+  if(node.getDepth() >= options.depthLimit) {
+    return false;
+  }
+
+  if(options.expansionLimit != 0 && expandedContainers >= options.expansionLimit) {
+    return false;
+  }
 
-  for(auto it = state.pendingFileIds.begin(); it != state.pendingFileIds.end(); it++) {
-    state.filesToGive.push(MetadataFetcher::getFileFromId(qcl, it->second));
+  if(options.expansionDecider && !options.expansionDecider(node.getContainerInfo())) {
+    return false;
   }
+
+  expandedContainers++;
+  return true;
 }
 
 bool NamespaceExplorer::fetch(NamespaceItem &item) {
-  if(!state.filesToGive.empty()) {
-    item.fileMd = state.filesToGive.front().get();
-    state.filesToGive.pop();
-    return true;
+  while(!dfsPath.empty()) {
+    SearchNode &node = *dfsPath.back();
+
+    // First time we see this container, give it out
+    if(!node.visited) {
+      node.visited = true;
+      node.expand = shouldExpand(node);
+
+      item.fullPath = node.getPath();
+      item.isFile = false;
+      item.containerMd = node.getContainerInfo();
+
+      if(passesFilter(item)) {
+        return true;
+      }
+
+      continue;
+    }
+
+    // Then its files
+    if(node.expand && node.fetchFile(item.fileMd, options.prefetchWindow)) {
+      item.fullPath = node.getPath() + item.fileMd.name();
+      item.isFile = true;
+
+      if(passesFilter(item)) {
+        return true;
+      }
+
+      continue;
+    }
+
+    // And finally descend into its subcontainers
+    std::unique_ptr<SearchNode> child;
+
+    if(node.expand && node.fetchChild(child, options.prefetchWindow, node.getDepth() + 1 < options.depthLimit)) {
+      dfsPath.push_back(std::move(child));
+      continue;
+    }
+
+    dfsPath.pop_back();
   }
 
   return false;
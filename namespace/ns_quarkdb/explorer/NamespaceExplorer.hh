@@ -26,6 +26,10 @@
 #include "namespace/Namespace.hh"
 #include "namespace/ns_quarkdb/ContainerMD.hh"
 #include "proto/FileMd.pb.h"
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -35,40 +39,115 @@ class ContainerMDSvc;
 class FileMDSvc;
 class HierarchicalView;
 
-struct ExplorationOptions {
-  int depthLimit;
-};
-
 struct NamespaceItem {
   // A simple string for now, we can extend this later.
   std::string fullPath;
 
-  // Only one of these are actually filled out.
+  // Only one of these are actually filled out, depending on isFile.
+  bool isFile = false;
   eos::ns::FileMdProto fileMd;
   eos::ns::ContainerMdProto containerMd;
 };
 
-// Represents a node in the search tree, including any unexplored children.
-struct SearchNode {
-  eos::ns::ContainerMdProto container;
-  std::queue<id_t> unexploredChildContainers;
-};
+struct ExplorationOptions {
+  // Maximum depth to descend to, relative to the starting container. With a
+  // limit of 0 only the starting container itself is given out.
+  int depthLimit = 1024;
 
-struct SearchState {
-  std::vector<SearchNode> nodes;
-  IContainerMD::FileMap pendingFileIds;
+  // Maximum number of outstanding backend requests for the files and the
+  // subcontainers of each node in the current search path.
+  size_t prefetchWindow = 256;
 
-  std::queue<std::future<eos::ns::FileMdProto>> filesToGive;
-  std::queue<std::future<eos::ns::ContainerMdProto>> containersToGive;
+  // Maximum number of containers to expand, 0 means no limit.
+  uint64_t expansionLimit = 0;
+
+  // Optional - only items for which the filter returns true are given out.
+  // Containers not matching the filter are still expanded.
+  std::function<bool(const NamespaceItem&)> filter;
+
+  // Optional - containers for which this returns false are not expanded.
+  std::function<bool(const eos::ns::ContainerMdProto&)> expansionDecider;
 };
 
+//------------------------------------------------------------------------------
+//! Represents a container in the search tree. All backend requests needed to
+//! explore it are issued asynchronously as soon as the node is created, and
+//! the metadata of its files and subcontainers is prefetched within a bounded
+//! window.
+//------------------------------------------------------------------------------
+class SearchNode {
+public:
+  SearchNode(qclient::QClient &qcl, id_t id, const std::string &fullPath,
+    int depth, bool fetchContents);
+
+  id_t getID() const {
+    return id;
+  }
+
+  int getDepth() const {
+    return depth;
+  }
+
+  const std::string& getPath() const {
+    return fullPath;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get container metadata, blocks until it's available.
+  //----------------------------------------------------------------------------
+  eos::ns::ContainerMdProto& getContainerInfo();
+
+  //----------------------------------------------------------------------------
+  //! Fetch next file of this container, in lexicographical order. Returns
+  //! false if there are no more files.
+  //----------------------------------------------------------------------------
+  bool fetchFile(eos::ns::FileMdProto &proto, size_t window);
+
+  //----------------------------------------------------------------------------
+  //! Fetch next subcontainer of this container, in lexicographical order.
+  //! Returns false if there are no more subcontainers.
+  //----------------------------------------------------------------------------
+  bool fetchChild(std::unique_ptr<SearchNode> &child, size_t window,
+    bool fetchChildContents);
+
+  bool visited = false;
+  bool expand = false;
+
+private:
+  template<typename MapT>
+  static void sortedIds(MapT &&contents, std::vector<id_t> &ids);
+
+  qclient::QClient &qcl;
+  id_t id;
+  std::string fullPath;
+  int depth;
+
+  bool containerMdReady = false;
+  eos::ns::ContainerMdProto containerMd;
+  std::future<eos::ns::ContainerMdProto> containerMdFut;
+
+  bool fileMapReady = false;
+  std::future<IContainerMD::FileMap> fileMapFut;
+  std::vector<id_t> pendingFileIds;
+  size_t nextFileId = 0;
+  std::deque<std::future<eos::ns::FileMdProto>> filesToGive;
+
+  bool containerMapReady = false;
+  std::future<IContainerMD::ContainerMap> containerMapFut;
+  std::vector<id_t> pendingContainerIds;
+  size_t nextContainerId = 0;
+  std::deque<std::unique_ptr<SearchNode>> childrenToGive;
+};
 
 //------------------------------------------------------------------------------
 //! Class to recursively explore the QuarkDB namespace, starting from some path.
 //! Useful for "Find" commands - no consistency guarantees, if a write is in
 //! the flusher, it might not be seen here.
 //!
-//! This implementation is super slow right now, and synchronous! Simple DFS.
+//! Depth-first, pre-order traversal: a container is given out before its
+//! files, which are given out before its subcontainers. Backend requests are
+//! pipelined, so exploration does not wait one round-trip per object, and
+//! memory usage is bounded by depth * prefetchWindow in-flight nodes.
 //------------------------------------------------------------------------------
 class NamespaceExplorer {
 public:
@@ -79,25 +158,27 @@ public:
   NamespaceExplorer(const std::string &path, const ExplorationOptions &options, qclient::QClient &qcl);
 
   //----------------------------------------------------------------------------
-  //! Fetch next item.
+  //! Fetch next item. Returns false once the exploration is over.
   //----------------------------------------------------------------------------
   bool fetch(NamespaceItem &result);
 
   //----------------------------------------------------------------------------
-  //! Get current search state.
+  //! Get number of containers expanded so far.
   //----------------------------------------------------------------------------
-  SearchState& getSearchState() {
-    return state;
+  uint64_t getExpandedContainers() const {
+    return expandedContainers;
   }
 
 private:
-  void populatePendingItems(id_t container);
+  bool passesFilter(const NamespaceItem &item) const;
+  bool shouldExpand(SearchNode &node);
 
   std::string path;
   ExplorationOptions options;
   qclient::QClient &qcl;
 
-  SearchState state;
+  std::vector<std::unique_ptr<SearchNode>> dfsPath;
+  uint64_t expandedContainers = 0;
 };
 
 EOSNSNAMESPACE_END
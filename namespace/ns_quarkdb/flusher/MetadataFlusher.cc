@@ -55,7 +55,9 @@ MetadataFlusher::MetadataFlusher(const std::string& path,
 backgroundFlusher(qcl, notifier, 200000 /* size limit */,
                   20000 /* pipeline length */,
                   new qclient::RocksDBPersistency(path)),
-sizePrinter(&MetadataFlusher::queueSizeMonitoring, this)
+mCoalesce(false), mCoalesceIntervalMs(0), mNumUpdates(0), mNumRequests(0),
+sizePrinter(&MetadataFlusher::queueSizeMonitoring, this),
+coalescer(&MetadataFlusher::coalescingLoop, this)
 {
   synchronize();
 }
@@ -74,21 +76,127 @@ MetadataFlusher::~MetadataFlusher()
 void MetadataFlusher::queueSizeMonitoring(qclient::ThreadAssistant& assistant)
 {
   while (!assistant.terminationRequested()) {
-    eos_static_info("id=%s total-pending=%" PRId64 " enqueued=%" PRId64  " acknowledged=%" PRId64,
+    FlusherStats stats;
+    getStatistics(stats);
+    eos_static_info("id=%s total-pending=%" PRId64 " enqueued=%" PRId64  " acknowledged=%" PRId64
+                    " staged=%" PRIu64 " coalescing-ratio=%.2f",
                     id.c_str(),
                     backgroundFlusher.size(),
                     backgroundFlusher.getEnqueuedAndClear(),
-                    backgroundFlusher.getAcknowledgedAndClear());
+                    backgroundFlusher.getAcknowledgedAndClear(),
+                    stats.mStaged, stats.GetCoalescingRatio());
     assistant.wait_for(std::chrono::seconds(10));
   }
 }
 
+//------------------------------------------------------------------------------
+// Push the staged updates to the background flusher at the configured
+// interval
+//------------------------------------------------------------------------------
+void MetadataFlusher::coalescingLoop(qclient::ThreadAssistant& assistant)
+{
+  while (!assistant.terminationRequested()) {
+    int64_t interval_ms = mCoalesceIntervalMs;
+    assistant.wait_for(std::chrono::milliseconds(interval_ms > 0 ?
+                       interval_ms : 1000));
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+    flushStaged();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Enable or disable the coalescing of updates
+//------------------------------------------------------------------------------
+void MetadataFlusher::setCoalescing(std::chrono::milliseconds interval)
+{
+  std::lock_guard<std::mutex> lock(mCoalesceMutex);
+  mCoalesceIntervalMs = interval.count();
+  mCoalesce = (interval.count() > 0);
+
+  if (!mCoalesce) {
+    flushStaged();
+  }
+
+  eos_static_notice("id=%s msg=\"update coalescing %s\" interval_ms=%" PRId64,
+                    id.c_str(), (mCoalesce ? "enabled" : "disabled"),
+                    (int64_t) interval.count());
+}
+
+//------------------------------------------------------------------------------
+// Get flusher statistics
+//------------------------------------------------------------------------------
+void MetadataFlusher::getStatistics(FlusherStats& stats)
+{
+  {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+    stats.mStaged = mCoalescer.getNumUpdates();
+  }
+  // Read the counters after the staged updates so that they are consistent
+  stats.mCoalescing = mCoalesce;
+  stats.mUpdates = mNumUpdates;
+  stats.mRequests = mNumRequests;
+  stats.mPending = backgroundFlusher.size();
+}
+
+//------------------------------------------------------------------------------
+// Push all staged updates to the background flusher
+//------------------------------------------------------------------------------
+void MetadataFlusher::flushStaged()
+{
+  if (mCoalescer.empty()) {
+    return;
+  }
+
+  std::vector<std::vector<std::string>> reqs;
+  mCoalescer.drain(reqs);
+
+  for (const auto& req : reqs) {
+    backgroundFlusher.pushRequest(req);
+  }
+
+  mNumRequests += reqs.size();
+}
+
+//------------------------------------------------------------------------------
+// Queue a generic request
+//------------------------------------------------------------------------------
+void MetadataFlusher::pushRequest(std::vector<std::string>&& req)
+{
+  ++mNumUpdates;
+
+  if (mCoalesce) {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+
+    if (mCoalesce) {
+      mCoalescer.barrier(std::move(req));
+      checkStaged();
+      return;
+    }
+  }
+
+  ++mNumRequests;
+  backgroundFlusher.pushRequest(req);
+}
+
 //------------------------------------------------------------------------------
 // Queue an hset command
 //------------------------------------------------------------------------------
 void MetadataFlusher::hset(const std::string& key, const std::string& field,
                            const std::string& value)
 {
+  ++mNumUpdates;
+
+  if (mCoalesce) {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+
+    if (mCoalesce) {
+      mCoalescer.hset(key, field, value);
+      checkStaged();
+      return;
+    }
+  }
+
+  ++mNumRequests;
   backgroundFlusher.pushRequest({"HSET", key, field, value});
 }
 
@@ -98,6 +206,21 @@ void MetadataFlusher::hset(const std::string& key, const std::string& field,
 void MetadataFlusher::hincrby(const std::string& key, const std::string& field,
                               int64_t value)
 {
+  ++mNumUpdates;
+
+  if (mCoalesce) {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+
+    if (mCoalesce) {
+      mCoalescer.keyBarrier(key, {"HINCRBY", key, field,
+                                  std::to_string(value)
+                                 });
+      checkStaged();
+      return;
+    }
+  }
+
+  ++mNumRequests;
   backgroundFlusher.pushRequest({"HINCRBY", key, field, std::to_string(value)});
 }
 
@@ -106,6 +229,19 @@ void MetadataFlusher::hincrby(const std::string& key, const std::string& field,
 //------------------------------------------------------------------------------
 void MetadataFlusher::del(const std::string& key)
 {
+  ++mNumUpdates;
+
+  if (mCoalesce) {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+
+    if (mCoalesce) {
+      mCoalescer.del(key);
+      checkStaged();
+      return;
+    }
+  }
+
+  ++mNumRequests;
   backgroundFlusher.pushRequest({"DEL", key});
 }
 
@@ -114,6 +250,19 @@ void MetadataFlusher::del(const std::string& key)
 //------------------------------------------------------------------------------
 void MetadataFlusher::hdel(const std::string& key, const std::string& field)
 {
+  ++mNumUpdates;
+
+  if (mCoalesce) {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+
+    if (mCoalesce) {
+      mCoalescer.hdel(key, field);
+      checkStaged();
+      return;
+    }
+  }
+
+  ++mNumRequests;
   backgroundFlusher.pushRequest({"HDEL", key, field});
 }
 
@@ -122,6 +271,19 @@ void MetadataFlusher::hdel(const std::string& key, const std::string& field)
 //------------------------------------------------------------------------------
 void MetadataFlusher::sadd(const std::string& key, const std::string& field)
 {
+  ++mNumUpdates;
+
+  if (mCoalesce) {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+
+    if (mCoalesce) {
+      mCoalescer.sadd(key, field);
+      checkStaged();
+      return;
+    }
+  }
+
+  ++mNumRequests;
   backgroundFlusher.pushRequest({"SADD", key, field});
 }
 
@@ -130,6 +292,19 @@ void MetadataFlusher::sadd(const std::string& key, const std::string& field)
 //------------------------------------------------------------------------------
 void MetadataFlusher::srem(const std::string& key, const std::string& field)
 {
+  ++mNumUpdates;
+
+  if (mCoalesce) {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+
+    if (mCoalesce) {
+      mCoalescer.srem(key, field);
+      checkStaged();
+      return;
+    }
+  }
+
+  ++mNumRequests;
   backgroundFlusher.pushRequest({"SREM", key, field});
 }
 
@@ -139,12 +314,28 @@ void MetadataFlusher::srem(const std::string& key, const std::string& field)
 void MetadataFlusher::srem(const std::string& key,
                            const std::list<std::string>& items)
 {
+  mNumUpdates += items.size();
+
+  if (mCoalesce) {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+
+    if (mCoalesce) {
+      for (auto it = items.begin(); it != items.end(); it++) {
+        mCoalescer.srem(key, *it);
+      }
+
+      checkStaged();
+      return;
+    }
+  }
+
   std::vector<std::string> req = {"SREM", key};
 
   for (auto it = items.begin(); it != items.end(); it++) {
     req.emplace_back(*it);
   }
 
+  ++mNumRequests;
   backgroundFlusher.pushRequest(req);
 }
 
@@ -153,6 +344,12 @@ void MetadataFlusher::srem(const std::string& key,
 //------------------------------------------------------------------------------
 void MetadataFlusher::synchronize(ItemIndex targetIndex)
 {
+  // Everything staged before this call has to be covered by the target index
+  {
+    std::lock_guard<std::mutex> lock(mCoalesceMutex);
+    flushStaged();
+  }
+
   if (targetIndex < 0) {
     targetIndex = backgroundFlusher.getEndingIndex() - 1;
   }
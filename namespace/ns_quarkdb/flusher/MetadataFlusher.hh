@@ -24,12 +24,17 @@
 #pragma once
 #include "namespace/interface/IContainerMD.hh"
 #include "namespace/interface/IContainerMDSvc.hh"
+#include "namespace/interface/IFlusherStats.hh"
 #include "namespace/ns_quarkdb/Constants.hh"
 #include "namespace/ns_quarkdb/LRU.hh"
+#include "namespace/ns_quarkdb/flusher/UpdateCoalescer.hh"
 #include "qclient/BackgroundFlusher.hh"
 #include "qclient/AssistedThread.hh"
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <map>
+#include <mutex>
 
 EOSNSNAMESPACE_BEGIN
 
@@ -75,7 +80,7 @@ public:
   //----------------------------------------------------------------------------
   template<typename... Args>
   void exec(const Args... args) {
-    backgroundFlusher.pushRequest(std::vector<std::string> {args...});
+    pushRequest(std::vector<std::string> {args...});
   }
 
   void del(const std::string& key);
@@ -93,18 +98,77 @@ public:
   //! calling. Example: synchronize is called when pending items in the queue
   //! are [1500, 2000]. The calling thread sleeps up to the point that entry
   //! #2000 is flushed - of course, at that point other items might have been
-  //! added to the queue, but we don't wait.
+  //! added to the queue, but we don't wait. Updates waiting in the coalescing
+  //! stage are pushed to the queue first.
   //----------------------------------------------------------------------------
   void synchronize(ItemIndex targetIndex = -1);
 
+  //----------------------------------------------------------------------------
+  //! Enable or disable the coalescing of updates. When enabled, updates are
+  //! staged for up to the given interval and the updates of the same
+  //! key/field are collapsed into the last one, while set updates and hash
+  //! updates on the same key are merged into a single request. Staged updates
+  //! are not persisted in the local queue, so they are lost in case of crash.
+  //!
+  //! @param interval maximum time an update stays staged, zero disables the
+  //!        coalescing and flushes whatever is staged
+  //----------------------------------------------------------------------------
+  void setCoalescing(std::chrono::milliseconds interval);
+
+  //----------------------------------------------------------------------------
+  //! Get flusher statistics
+  //!
+  //! @param stats filled with the current statistics
+  //----------------------------------------------------------------------------
+  void getStatistics(FlusherStats& stats);
+
 private:
+  //! Number of staged updates which triggers a flush of the coalescing stage
+  static constexpr size_t sMaxStagedUpdates = 10000;
+
   void queueSizeMonitoring(qclient::ThreadAssistant& assistant);
+
+  //----------------------------------------------------------------------------
+  //! Periodically push the staged updates to the background flusher
+  //----------------------------------------------------------------------------
+  void coalescingLoop(qclient::ThreadAssistant& assistant);
+
+  //----------------------------------------------------------------------------
+  //! Push a request which can touch any key, acts as barrier for coalescing
+  //----------------------------------------------------------------------------
+  void pushRequest(std::vector<std::string>&& req);
+
+  //----------------------------------------------------------------------------
+  //! Push all staged updates to the background flusher, in order. Must be
+  //! called with mCoalesceMutex locked.
+  //----------------------------------------------------------------------------
+  void flushStaged();
+
+  //----------------------------------------------------------------------------
+  //! Flush the staging area if it grew too big. Must be called with
+  //! mCoalesceMutex locked.
+  //----------------------------------------------------------------------------
+  inline void checkStaged()
+  {
+    if (mCoalescer.getNumUpdates() >= sMaxStagedUpdates) {
+      flushStaged();
+    }
+  }
+
   std::string id;
 
   FlusherNotifier notifier;
   qclient::QClient qcl;
   qclient::BackgroundFlusher backgroundFlusher;
+  //! Serializes the staging and its draining into the background flusher
+  std::mutex mCoalesceMutex;
+  UpdateCoalescer mCoalescer; ///< Coalescing stage
+  std::atomic<bool> mCoalesce; ///< Coalescing enabled
+  std::atomic<int64_t> mCoalesceIntervalMs; ///< Max time updates stay staged
+  std::atomic<uint64_t> mNumUpdates; ///< Updates received
+  std::atomic<uint64_t> mNumRequests; ///< Requests pushed to the flusher
   qclient::AssistedThread sizePrinter;
+  qclient::AssistedThread coalescer;
 };
 
 class MetadataFlusherFactory
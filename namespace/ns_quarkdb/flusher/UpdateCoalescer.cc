@@ -0,0 +1,217 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "namespace/ns_quarkdb/flusher/UpdateCoalescer.hh"
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------------------------
+UpdateCoalescer::UpdateCoalescer():
+  mNumUpdates(0)
+{}
+
+//------------------------------------------------------------------------------
+// Stage an hset
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::hset(const std::string& key, const std::string& field,
+                      const std::string& value)
+{
+  stage("HSET", key, field, value);
+}
+
+//------------------------------------------------------------------------------
+// Stage an hdel
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::hdel(const std::string& key, const std::string& field)
+{
+  stage("HDEL", key, field, "");
+}
+
+//------------------------------------------------------------------------------
+// Stage a sadd
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::sadd(const std::string& key, const std::string& member)
+{
+  stage("SADD", key, member, "");
+}
+
+//------------------------------------------------------------------------------
+// Stage an srem
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::srem(const std::string& key, const std::string& member)
+{
+  stage("SREM", key, member, "");
+}
+
+//------------------------------------------------------------------------------
+// Stage a del - whatever was staged for the key since the last barrier is
+// wiped out anyway
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::del(const std::string& key)
+{
+  closeKey(key, true);
+  ++mNumUpdates;
+  mSlots.emplace_back();
+  mSlots.back().mRequest = {"DEL", key};
+}
+
+//------------------------------------------------------------------------------
+// Stage a request acting as barrier for the given key
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::keyBarrier(const std::string& key,
+                            std::vector<std::string>&& req)
+{
+  closeKey(key, false);
+  ++mNumUpdates;
+  mSlots.emplace_back();
+  mSlots.back().mRequest = std::move(req);
+}
+
+//------------------------------------------------------------------------------
+// Stage a request acting as barrier for all keys
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::barrier(std::vector<std::string>&& req)
+{
+  mOpenSlots.clear();
+  mMembers.clear();
+  ++mNumUpdates;
+  mSlots.emplace_back();
+  mSlots.back().mRequest = std::move(req);
+}
+
+//------------------------------------------------------------------------------
+// Move out all staged requests
+//------------------------------------------------------------------------------
+size_t
+UpdateCoalescer::drain(std::vector<std::vector<std::string>>& out)
+{
+  for (auto& slot : mSlots) {
+    if (!slot.mRequest.empty()) {
+      out.emplace_back(std::move(slot.mRequest));
+      continue;
+    }
+
+    if (slot.mItems.empty()) {
+      continue;
+    }
+
+    std::vector<std::string> req;
+    bool with_values = (slot.mCmd == "HSET");
+
+    if (with_values && (slot.mItems.size() > 1)) {
+      req.reserve(2 + 2 * slot.mItems.size());
+      req.push_back("HMSET");
+    } else {
+      req.reserve(2 + (with_values ? 2 : 1) * slot.mItems.size());
+      req.push_back(slot.mCmd);
+    }
+
+    req.push_back(slot.mKey);
+
+    for (auto& item : slot.mItems) {
+      req.push_back(item.first);
+
+      if (with_values) {
+        req.emplace_back(std::move(item.second));
+      }
+    }
+
+    out.emplace_back(std::move(req));
+  }
+
+  size_t num_updates = mNumUpdates;
+  mSlots.clear();
+  mOpenSlots.clear();
+  mMembers.clear();
+  mNumUpdates = 0;
+  return num_updates;
+}
+
+//------------------------------------------------------------------------------
+// Stage the update of a key/field. Only one slot staged after the last
+// barrier on the key holds the field, therefore the field can be moved into
+// any other open slot of the same key without changing the outcome.
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::stage(const std::string& cmd, const std::string& key,
+                       const std::string& field, const std::string& value)
+{
+  ++mNumUpdates;
+  KeyPair member(key, field);
+  auto it_member = mMembers.find(member);
+
+  if (it_member != mMembers.end()) {
+    mSlots[it_member->second].mItems.erase(field);
+  }
+
+  size_t idx;
+  KeyPair open(key, cmd);
+  auto it_open = mOpenSlots.find(open);
+
+  if (it_open == mOpenSlots.end()) {
+    idx = mSlots.size();
+    mSlots.emplace_back();
+    mSlots.back().mCmd = cmd;
+    mSlots.back().mKey = key;
+    mOpenSlots.emplace(open, idx);
+  } else {
+    idx = it_open->second;
+  }
+
+  mSlots[idx].mItems[field] = value;
+
+  if (it_member != mMembers.end()) {
+    it_member->second = idx;
+  } else {
+    mMembers.emplace(std::move(member), idx);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Forget the open slots and members of a key
+//------------------------------------------------------------------------------
+void
+UpdateCoalescer::closeKey(const std::string& key, bool drop_items)
+{
+  auto it_open = mOpenSlots.lower_bound(KeyPair(key, ""));
+
+  while ((it_open != mOpenSlots.end()) && (it_open->first.first == key)) {
+    it_open = mOpenSlots.erase(it_open);
+  }
+
+  auto it_member = mMembers.lower_bound(KeyPair(key, ""));
+
+  while ((it_member != mMembers.end()) && (it_member->first.first == key)) {
+    if (drop_items) {
+      mSlots[it_member->second].mItems.erase(it_member->first.second);
+    }
+
+    it_member = mMembers.erase(it_member);
+  }
+}
+
+EOSNSNAMESPACE_END
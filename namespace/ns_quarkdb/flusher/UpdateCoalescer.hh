@@ -0,0 +1,141 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! @brief Collapse pending metadata updates before they reach the flusher
+//------------------------------------------------------------------------------
+
+#pragma once
+#include "namespace/Namespace.hh"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+EOSNSNAMESPACE_BEGIN
+
+//------------------------------------------------------------------------------
+//! Staging area which collapses updates to the same key/field and merges
+//! updates of the same kind on the same key into a single request.
+//!
+//! For every key/field only the last update is kept (last writer wins). The
+//! staged updates are grouped in slots of the form (command, key) which turn
+//! into one HSET/HMSET, HDEL, SADD or SREM request each. Updates on different
+//! keys are independent, therefore the only ordering that has to be kept is
+//! between the updates of the same key and the operations acting on the whole
+//! key (DEL, HINCRBY) or on unknown keys (generic commands). These act as
+//! barriers: later updates never get merged into slots staged before them.
+//!
+//! The class is not thread-safe, the caller has to serialize the access.
+//------------------------------------------------------------------------------
+class UpdateCoalescer
+{
+public:
+  //----------------------------------------------------------------------------
+  //! Constructor
+  //----------------------------------------------------------------------------
+  UpdateCoalescer();
+
+  //----------------------------------------------------------------------------
+  //! Stage hash updates
+  //----------------------------------------------------------------------------
+  void hset(const std::string& key, const std::string& field,
+            const std::string& value);
+  void hdel(const std::string& key, const std::string& field);
+
+  //----------------------------------------------------------------------------
+  //! Stage set updates
+  //----------------------------------------------------------------------------
+  void sadd(const std::string& key, const std::string& member);
+  void srem(const std::string& key, const std::string& member);
+
+  //----------------------------------------------------------------------------
+  //! Stage the removal of a key, drops all the updates of the key staged
+  //! since the last barrier on it
+  //----------------------------------------------------------------------------
+  void del(const std::string& key);
+
+  //----------------------------------------------------------------------------
+  //! Stage a request which can not be collapsed and which only touches the
+  //! given key. Acts as a barrier for the given key.
+  //----------------------------------------------------------------------------
+  void keyBarrier(const std::string& key, std::vector<std::string>&& req);
+
+  //----------------------------------------------------------------------------
+  //! Stage a request touching arbitrary keys. Acts as a barrier for all keys.
+  //----------------------------------------------------------------------------
+  void barrier(std::vector<std::string>&& req);
+
+  //----------------------------------------------------------------------------
+  //! Move all the staged requests out, in the order they need to be executed
+  //!
+  //! @param out vector to which the requests are appended
+  //!
+  //! @return number of updates collapsed into the returned requests
+  //----------------------------------------------------------------------------
+  size_t drain(std::vector<std::vector<std::string>>& out);
+
+  //----------------------------------------------------------------------------
+  //! Get number of updates staged since the last drain
+  //----------------------------------------------------------------------------
+  inline size_t getNumUpdates() const
+  {
+    return mNumUpdates;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if anything is staged
+  //----------------------------------------------------------------------------
+  inline bool empty() const
+  {
+    return mSlots.empty();
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  //! Group of updates of the same kind on the same key, or a verbatim request
+  //----------------------------------------------------------------------------
+  struct Slot {
+    std::string mCmd;
+    std::string mKey;
+    std::map<std::string, std::string> mItems; ///< field/member -> value
+    std::vector<std::string> mRequest; ///< verbatim request, if not empty
+  };
+
+  //----------------------------------------------------------------------------
+  //! Stage the given update of a key/field
+  //----------------------------------------------------------------------------
+  void stage(const std::string& cmd, const std::string& key,
+             const std::string& field, const std::string& value);
+
+  //----------------------------------------------------------------------------
+  //! Forget the open slots and the members of the given key, later updates
+  //! will go into new slots
+  //----------------------------------------------------------------------------
+  void closeKey(const std::string& key, bool drop_items);
+
+  typedef std::pair<std::string, std::string> KeyPair;
+  std::vector<Slot> mSlots; ///< Staged slots in execution order
+  //! Slots which still accept updates, indexed by (key, command)
+  std::map<KeyPair, size_t> mOpenSlots;
+  //! Slot holding the last update of every (key, field) since the last barrier
+  std::map<KeyPair, size_t> mMembers;
+  size_t mNumUpdates; ///< Number of updates staged since the last drain
+};
+
+EOSNSNAMESPACE_END
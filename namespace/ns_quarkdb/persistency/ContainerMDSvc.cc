@@ -57,7 +57,7 @@ ContainerMDSvc::getBucketKey(IContainerMD::id_t id)
 ContainerMDSvc::ContainerMDSvc()
   : pQuotaStats(nullptr), pFileSvc(nullptr), pQcl(nullptr), pFlusher(nullptr),
     mMetaMap(), mContainerCache(10e7), mNumConts(0ull),
-    mShardMutexes(mNumMutexes + 1) {}
+    mShardMutexes(mNumMutexes + 1), mStoreMutexes(mNumMutexes + 1) {}
 
 //------------------------------------------------------------------------------
 // Destructor
@@ -226,6 +226,7 @@ void
 ContainerMDSvc::updateStore(IContainerMD* obj)
 {
   eos::Buffer ebuff;
+  std::lock_guard<std::mutex> lock(mStoreMutexes[obj->getId() & mNumMutexes]);
   obj->serialize(ebuff);
   std::string buffer(ebuff.getDataPtr(), ebuff.getSize());
   std::string sid = stringify(obj->getId());
@@ -165,6 +165,15 @@ public:
   //----------------------------------------------------------------------------
   IContainerMD::id_t getFirstFreeId() override;
 
+  //----------------------------------------------------------------------------
+  //! Get statistics of the local container cache
+  //----------------------------------------------------------------------------
+  LRU<IContainerMD::id_t, IContainerMD>::Stats
+  getCacheStatistics() const
+  {
+    return mContainerCache.getStats();
+  }
+
   //----------------------------------------------------------------------------
   //! Override number of buckets
   //----------------------------------------------------------------------------
@@ -225,6 +234,11 @@ private:
   //! we might end up retrieving the same info several times. The memory used
   //! in Linux is 40 bytes/std::mutex => ~40 kb
   std::vector<std::mutex> mShardMutexes;
+  //! Collection of mutexes making the serialization and the flush of a
+  //! container atomic. Attribute updates of the same container can run
+  //! concurrently under the namespace read lock and must reach the backend in
+  //! the order they were serialized.
+  std::vector<std::mutex> mStoreMutexes;
   constexpr static uint64_t mNumMutexes = 1023; ///< Number of shards
 };
 
@@ -17,6 +17,7 @@
  ************************************************************************/
 
 #include "namespace/ns_quarkdb/persistency/FileMDSvc.hh"
+#include "common/Logging.hh"
 #include "namespace/ns_quarkdb/Constants.hh"
 #include "namespace/ns_quarkdb/FileMD.hh"
 #include "namespace/ns_quarkdb/BackendClient.hh"
@@ -25,6 +26,8 @@
 #include "namespace/ns_quarkdb/flusher/MetadataFlusher.hh"
 #include "namespace/ns_quarkdb/persistency/MetadataFetcher.hh"
 #include "namespace/utils/StringConvertion.hh"
+#include <cerrno>
+#include <cstdlib>
 #include <numeric>
 
 EOSNSNAMESPACE_BEGIN
@@ -45,7 +48,8 @@ void FileMDSvc::OverrideNumberOfBuckets(uint64_t buckets) {
 //------------------------------------------------------------------------------
 FileMDSvc::FileMDSvc()
   : pQuotaStats(nullptr), pContSvc(nullptr), pFlusher(nullptr), pQcl(nullptr),
-    mMetaMap(), mDirtyFidBackend(), mFileCache(10e8), mNumFiles(0ull) {}
+    mMetaMap(), mDirtyFidBackend(), mFileCache(10e8), mNumFiles(0ull),
+    mStoreMutexes(mNumMutexes + 1) {}
 
 //------------------------------------------------------------------------------
 // Destructor
@@ -67,6 +71,7 @@ FileMDSvc::configure(const std::map<std::string, std::string>& config)
   const std::string key_cluster = "qdb_cluster";
   const std::string key_flusher = "qdb_flusher_md";
   const std::string cache_size = "file_cache_size";
+  const std::string key_coalesce = "qdb_flusher_coalesce_ms";
 
   if ((config.find(key_cluster) != config.end()) &&
       (config.find(key_flusher) != config.end())) {
@@ -88,6 +93,20 @@ FileMDSvc::configure(const std::map<std::string, std::string>& config)
     mDirtyFidBackend.setClient(*pQcl);
     mInodeProvider.configure(mMetaMap, constants::sLastUsedFid);
     pFlusher = MetadataFlusherFactory::getInstance(qdb_flusher_id, qdb_members);
+
+    if (config.find(key_coalesce) != config.end()) {
+      const std::string& sval = config.at(key_coalesce);
+      char* end = nullptr;
+      errno = 0;
+      long long ms = strtoll(sval.c_str(), &end, 10);
+
+      if (sval.empty() || (*end != '\0') || (errno == ERANGE) || (ms < 0)) {
+        eos_static_err("msg=\"ignore invalid flusher coalescing interval\" "
+                       "%s=\"%s\"", key_coalesce.c_str(), sval.c_str());
+      } else {
+        pFlusher->setCoalescing(std::chrono::milliseconds(ms));
+      }
+    }
   }
 
   if (config.find(cache_size) != config.end()) {
@@ -188,6 +207,43 @@ FileMDSvc::getFileMD(IFileMD::id_t id, uint64_t* clock)
   return mFileCache.put(retval->getId(), retval);
 }
 
+//------------------------------------------------------------------------------
+// Get the file metadata object for a protobuf fetched from the backend
+//------------------------------------------------------------------------------
+std::shared_ptr<IFileMD>
+FileMDSvc::getFileMDFromProto(eos::ns::FileMdProto&& proto)
+{
+  std::shared_ptr<IFileMD> file;
+
+  if (getCachedFileMD(proto.id(), file)) {
+    return file;
+  }
+
+  std::shared_ptr<FileMD> retval = std::make_shared<FileMD>(0, this);
+  retval->initialize(std::move(proto));
+  file = mFileCache.put(retval->getId(), retval);
+  return (file->isDeleted() ? nullptr : file);
+}
+
+//------------------------------------------------------------------------------
+// Look up a file in the cache
+//------------------------------------------------------------------------------
+bool
+FileMDSvc::getCachedFileMD(IFileMD::id_t id, std::shared_ptr<IFileMD>& file)
+{
+  file = mFileCache.get(id);
+
+  if (file == nullptr) {
+    return false;
+  }
+
+  if (file->isDeleted()) {
+    file.reset();
+  }
+
+  return true;
+}
+
 //------------------------------------------------------------------------------
 // Create new file metadata object
 //------------------------------------------------------------------------------
@@ -210,6 +266,7 @@ void
 FileMDSvc::updateStore(IFileMD* obj)
 {
   eos::Buffer ebuff;
+  std::lock_guard<std::mutex> lock(mStoreMutexes[obj->getId() & mNumMutexes]);
   obj->serialize(ebuff);
   std::string buffer(ebuff.getDataPtr(), ebuff.getSize());
   std::string sid = stringify(obj->getId());
@@ -247,6 +304,17 @@ FileMDSvc::getNumFiles()
   return mNumFiles.load();
 }
 
+//------------------------------------------------------------------------------
+// Get the statistics of the metadata flusher
+//------------------------------------------------------------------------------
+void
+FileMDSvc::getFlusherStats(FlusherStats& stats)
+{
+  if (pFlusher) {
+    pFlusher->getStatistics(stats);
+  }
+}
+
 //------------------------------------------------------------------------------
 // Attach a broken file to lost+found
 //------------------------------------------------------------------------------
@@ -25,8 +25,12 @@
 #define __EOS_NS_FILE_MD_SVC_HH__
 
 #include "namespace/interface/IFileMDSvc.hh"
+#include "namespace/interface/IFlusherStats.hh"
 #include "namespace/ns_quarkdb/persistency/NextInodeProvider.hh"
 #include "namespace/ns_quarkdb/LRU.hh"
+#include "proto/FileMd.pb.h"
+#include <mutex>
+#include <vector>
 
 EOSNSNAMESPACE_BEGIN
 
@@ -36,7 +40,7 @@ class MetadataFlusher;
 //------------------------------------------------------------------------------
 //! FileMDSvc based on Redis
 //------------------------------------------------------------------------------
-class FileMDSvc : public IFileMDSvc
+class FileMDSvc : public IFileMDSvc, public IFlusherStats
 {
 public:
   //----------------------------------------------------------------------------
@@ -115,6 +119,34 @@ public:
   //----------------------------------------------------------------------------
   virtual uint64_t getNumFiles() override;
 
+  //----------------------------------------------------------------------------
+  //! Look up a file in the cache without going to the backend
+  //!
+  //! @param id file id
+  //! @param file cached file metadata object, nullptr if the file has been
+  //!        deleted
+  //!
+  //! @return true if the file is cached, otherwise false
+  //----------------------------------------------------------------------------
+  bool getCachedFileMD(IFileMD::id_t id, std::shared_ptr<IFileMD>& file);
+
+  //----------------------------------------------------------------------------
+  //! Get the file metadata object for a protobuf fetched from the backend.
+  //! The object goes through the cache like for getFileMD: if the file got
+  //! cached in the meantime, the cached object is returned since it might be
+  //! more recent than the backend.
+  //!
+  //! @param proto file protobuf
+  //!
+  //! @return file metadata object, or nullptr if the file has been deleted
+  //----------------------------------------------------------------------------
+  std::shared_ptr<IFileMD> getFileMDFromProto(eos::ns::FileMdProto&& proto);
+
+  //----------------------------------------------------------------------------
+  //! Get the statistics of the metadata flusher
+  //----------------------------------------------------------------------------
+  virtual void getFlusherStats(FlusherStats& stats) override;
+
   //----------------------------------------------------------------------------
   //! Add file listener that will be notified about all of the changes in
   //! the store
@@ -163,6 +195,15 @@ public:
   //----------------------------------------------------------------------------
   IFileMD::id_t getFirstFreeId() override;
 
+  //----------------------------------------------------------------------------
+  //! Get statistics of the local file cache
+  //----------------------------------------------------------------------------
+  LRU<IFileMD::id_t, IFileMD>::Stats
+  getCacheStatistics() const
+  {
+    return mFileCache.getStats();
+  }
+
   //----------------------------------------------------------------------------
   //! Override number of buckets
   //----------------------------------------------------------------------------
@@ -210,6 +251,12 @@ private:
   qclient::QSet mDirtyFidBackend; ///< Set of "dirty" files
   LRU<IFileMD::id_t, IFileMD> mFileCache; ///< Local cache of file objects
   std::atomic<uint64_t> mNumFiles; ///< Total number of fileso
+  //! Collection of mutexes making the serialization and the flush of a file
+  //! atomic. Attribute updates of the same file can run concurrently under the
+  //! namespace read lock and must reach the backend in the order they were
+  //! serialized.
+  std::vector<std::mutex> mStoreMutexes;
+  constexpr static uint64_t mNumMutexes = 1023; ///< Number of shards
 };
 
 EOSNSNAMESPACE_END
@@ -25,6 +25,7 @@
 #include "namespace/ns_quarkdb/persistency/ContainerMDSvc.hh"
 #include "namespace/ns_quarkdb/persistency/FileMDSvc.hh"
 #include "namespace/ns_quarkdb/persistency/Serialization.hh"
+#include <atomic>
 
 #define SSTR(message) static_cast<std::ostringstream&>(std::ostringstream().flush() << message).str()
 #define DBG(message) std::cerr << __FILE__ << ":" << __LINE__ << " -- " << #message << " = " << message << std::endl
@@ -277,6 +278,138 @@ private:
   std::promise<ContainerType> promise;
 };
 
+struct FileBatchTrait {
+  static std::string getBucketKey(id_t id) {
+    return FileMDSvc::getBucketKey(id);
+  }
+
+  static constexpr const char* name = "FileMD";
+  using ProtoType = eos::ns::FileMdProto;
+};
+
+struct ContainerBatchTrait {
+  static std::string getBucketKey(id_t id) {
+    return ContainerMDSvc::getBucketKey(id);
+  }
+
+  static constexpr const char* name = "ContainerMD";
+  using ProtoType = eos::ns::ContainerMdProto;
+};
+
+constexpr const char* FileBatchTrait::name;
+constexpr const char* ContainerBatchTrait::name;
+
+// Fetch the protobufs of many files or containers. All HGETs are pipelined
+// through QClient without waiting for the replies, the continuation is
+// called once every reply has arrived.
+template<typename Trait>
+class BatchFetcher {
+public:
+  using ProtoType = typename Trait::ProtoType;
+  using Callback = std::function<void(std::vector<MDStatus>&&, std::vector<ProtoType>&&)>;
+
+  BatchFetcher(const std::vector<id_t> &i, Callback cb)
+  : ids(i), callback(std::move(cb)), pending(i.size()), statuses(i.size()),
+    protos(i.size()), slots(i.size()) {}
+
+  void initialize(qclient::QClient &qcl) {
+    const size_t count = ids.size();
+
+    if(count == 0) {
+      return finalize();
+    }
+
+    // Same evil race condition as for the single fetchers: once the last
+    // request is out, *this might have been destroyed already.
+    for(size_t i = 0; i < count; i++) {
+      slots[i].parent = this;
+      slots[i].index = i;
+      qcl.execCB(&slots[i], "HGET", Trait::getBucketKey(ids[i]), SSTR(ids[i]));
+    }
+  }
+
+private:
+  // One QCallback per request, forwarding the reply to the batch.
+  struct Slot : public qclient::QCallback {
+    virtual void handleResponse(redisReplyPtr &&reply) override {
+      parent->handleResponse(index, std::move(reply));
+    }
+
+    BatchFetcher *parent = nullptr;
+    size_t index = 0;
+  };
+
+  void handleResponse(size_t index, redisReplyPtr &&reply) {
+    MDStatus status = ensureStringReply(reply);
+
+    if(status.ok()) {
+      status = Serialization::deserialize(reply->str, reply->len, protos[index]);
+    }
+
+    if(!status.ok()) {
+      statuses[index] = MDStatus(status.getErrno(), SSTR("Error while fetching " << Trait::name << " #" << ids[index] << " protobuf from QDB: " << status.getError()));
+    }
+
+    if(--pending == 0) {
+      finalize();
+    }
+  }
+
+  void finalize() {
+    callback(std::move(statuses), std::move(protos));
+    delete this; // harakiri
+  }
+
+  std::vector<id_t> ids;
+  Callback callback;
+  std::atomic<size_t> pending;
+  std::vector<MDStatus> statuses;
+  std::vector<ProtoType> protos;
+  std::vector<Slot> slots;
+};
+
+// Wrap a batch continuation into a future, holding the first error, if any.
+template<typename Trait>
+std::future<std::vector<typename Trait::ProtoType>> batchToFuture(qclient::QClient &qcl, const std::vector<id_t> &ids) {
+  using ProtoType = typename Trait::ProtoType;
+  auto promise = std::make_shared<std::promise<std::vector<ProtoType>>>();
+  std::future<std::vector<ProtoType>> fut = promise->get_future();
+
+  BatchFetcher<Trait> *fetcher = new BatchFetcher<Trait>(ids,
+    [promise](std::vector<MDStatus> &&statuses, std::vector<ProtoType> &&protos) {
+      for(auto it = statuses.begin(); it != statuses.end(); it++) {
+        if(!it->ok()) {
+          promise->set_exception(makeMDException(it->getErrno(), it->getError()));
+          return;
+        }
+      }
+
+      promise->set_value(std::move(protos));
+    }
+  );
+
+  fetcher->initialize(qcl);
+  return fut;
+}
+
+void MetadataFetcher::getFilesFromIds(qclient::QClient &qcl, const std::vector<id_t> &ids, FileMdBatchCallback callback) {
+  BatchFetcher<FileBatchTrait> *fetcher = new BatchFetcher<FileBatchTrait>(ids, std::move(callback));
+  fetcher->initialize(qcl);
+}
+
+void MetadataFetcher::getContainersFromIds(qclient::QClient &qcl, const std::vector<id_t> &ids, ContainerMdBatchCallback callback) {
+  BatchFetcher<ContainerBatchTrait> *fetcher = new BatchFetcher<ContainerBatchTrait>(ids, std::move(callback));
+  fetcher->initialize(qcl);
+}
+
+std::future<std::vector<eos::ns::FileMdProto>> MetadataFetcher::getFilesFromIds(qclient::QClient &qcl, const std::vector<id_t> &ids) {
+  return batchToFuture<FileBatchTrait>(qcl, ids);
+}
+
+std::future<std::vector<eos::ns::ContainerMdProto>> MetadataFetcher::getContainersFromIds(qclient::QClient &qcl, const std::vector<id_t> &ids) {
+  return batchToFuture<ContainerBatchTrait>(qcl, ids);
+}
+
 std::future<eos::ns::FileMdProto> MetadataFetcher::getFileFromId(qclient::QClient &qcl, id_t id) {
   FileMdFetcher *fetcher = new FileMdFetcher();
   return fetcher->initialize(qcl, id);
@@ -19,7 +19,6 @@
 //------------------------------------------------------------------------------
 //! @author Georgios Bitzes <georgios.bitzes@cern.ch>
 //! @brief Class to retrieve metadata from the backend - no caching!
-//!        TODO: Make asynchronous, try building continuations out of std::future
 //------------------------------------------------------------------------------
 
 #pragma once
@@ -28,6 +27,8 @@
 #include "namespace/ns_quarkdb/ContainerMD.hh"
 #include "namespace/ns_quarkdb/FileMD.hh"
 #include "qclient/QClient.hh"
+#include <functional>
+#include <vector>
 
 using redisReplyPtr = qclient::redisReplyPtr;
 
@@ -39,9 +40,31 @@ EOSNSNAMESPACE_BEGIN
 
 class MetadataFetcher {
 public:
+  //----------------------------------------------------------------------------
+  //! Continuations for batched lookups: receive the statuses and the protobufs
+  //! in the same order as the requested ids. The protobuf of an entry is
+  //! valid only if its status is ok. Called from the QClient event loop
+  //! thread, so they should not block.
+  //----------------------------------------------------------------------------
+  using FileMdBatchCallback = std::function<void(std::vector<MDStatus>&&, std::vector<eos::ns::FileMdProto>&&)>;
+  using ContainerMdBatchCallback = std::function<void(std::vector<MDStatus>&&, std::vector<eos::ns::ContainerMdProto>&&)>;
+
   static std::future<eos::ns::FileMdProto> getFileFromId(qclient::QClient &qcl, id_t id);
   static std::future<eos::ns::ContainerMdProto> getContainerFromId(qclient::QClient &qcl, id_t id);
 
+  //----------------------------------------------------------------------------
+  //! Batched lookups - all requests are pipelined to QuarkDB at once, so
+  //! fetching many ids costs a single round-trip instead of one per id.
+  //----------------------------------------------------------------------------
+  static void getFilesFromIds(qclient::QClient &qcl, const std::vector<id_t> &ids, FileMdBatchCallback callback);
+  static void getContainersFromIds(qclient::QClient &qcl, const std::vector<id_t> &ids, ContainerMdBatchCallback callback);
+
+  //----------------------------------------------------------------------------
+  //! Same as above, the future holds the first error encountered, if any.
+  //----------------------------------------------------------------------------
+  static std::future<std::vector<eos::ns::FileMdProto>> getFilesFromIds(qclient::QClient &qcl, const std::vector<id_t> &ids);
+  static std::future<std::vector<eos::ns::ContainerMdProto>> getContainersFromIds(qclient::QClient &qcl, const std::vector<id_t> &ids);
+
   static std::future<IContainerMD::FileMap> getFilesInContainer(qclient::QClient &qcl, id_t container);
   static std::future<IContainerMD::ContainerMap> getSubContainers(qclient::QClient &qcl, id_t container);
 
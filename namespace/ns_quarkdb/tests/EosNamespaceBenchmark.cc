@@ -31,6 +31,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 eos::common::RWMutex nslock;
 
@@ -211,6 +212,65 @@ RunReader(void* tconf)
   return nullptr;
 }
 
+//------------------------------------------------------------------------------
+// Cache lookup thread configuration
+//------------------------------------------------------------------------------
+struct CacheThread {
+  eos::IFileMDSvc* file_svc;
+  eos::IContainerMDSvc* cont_svc;
+  uint64_t seed;
+  uint64_t max_fid;
+  uint64_t max_cid;
+  uint64_t n_lookups;
+};
+
+//----------------------------------------------------------------------------
+// Start metadata cache consumer thread doing random file and container lookups
+//----------------------------------------------------------------------------
+static void*
+RunCacheReader(void* tconf)
+{
+  CacheThread* c = static_cast<CacheThread*>(tconf);
+  uint64_t rnd = c->seed;
+
+  for (uint64_t n = 0; n < c->n_lookups; ++n) {
+    // xorshift64 to avoid contention on a shared random generator
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 7;
+    rnd ^= rnd << 17;
+
+    try {
+      if (n % 4) {
+        (void) c->file_svc->getFileMD(1 + rnd % c->max_fid);
+      } else {
+        (void) c->cont_svc->getContainerMD(1 + rnd % c->max_cid);
+      }
+    } catch (eos::MDException& e) {
+      // Ids might be missing, ignore
+    }
+  }
+
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Print metadata cache statistics
+//------------------------------------------------------------------------------
+template <typename StatsT>
+void
+PrintCacheStats(const std::string& name, const StatsT& stats)
+{
+  uint64_t lookups = stats.mHits + stats.mMisses;
+  fprintf(stderr, "ALL      %-5s cache size/max/shards       %llu/%llu/%llu\n"
+          "ALL      %-5s cache hits/misses/evictions %llu/%llu/%llu "
+          "(hit ratio %.02f%%)\n", name.c_str(),
+          (unsigned long long) stats.mSize, (unsigned long long) stats.mMaxSize,
+          (unsigned long long) stats.mNumShards, name.c_str(),
+          (unsigned long long) stats.mHits, (unsigned long long) stats.mMisses,
+          (unsigned long long) stats.mEvictions,
+          lookups ? (100.0 * stats.mHits) / lookups : 0.0);
+}
+
 //------------------------------------------------------------------------------
 // Main function
 //----------------------------------------------------------------------------
@@ -423,5 +483,53 @@ main(int argc, char** argv)
     double rate = (n_files * n_i * n_j * n_k) / tm.RealTime() * 1000.0;
     PrintStatus(view, &st[0], &st[1], &mem[0], &mem[1], rate);
   }
+  // Run a parallel random lookup benchmark against the metadata caches
+  {
+    eos::common::LinuxStat::linux_stat_t st[10];
+    eos::common::LinuxMemConsumption::linux_mem_t mem[10];
+    std::cerr << "# ***********************************************************"
+              << std::endl;
+    std::cerr << "[i] Parallel metadata cache benchmark ..." << std::endl;
+    std::cerr << "# ***********************************************************"
+              << std::endl;
+    eos::common::LinuxStat::GetStat(st[0]);
+    eos::common::LinuxMemConsumption::GetMemoryFootprint(mem[0]);
+    eos::common::Timing tm("cache");
+    COMMONTIMING("cache-start", &tm);
+    const uint64_t n_lookups = n_files * n_j * n_k;
+    std::vector<CacheThread> confs(n_i);
+    pthread_t tid[1024];
+
+    // fire threads
+    for (size_t i = 0; i < n_i; i++) {
+      confs[i].file_svc = view->getFileMDSvc();
+      confs[i].cont_svc = view->getContainerMDSvc();
+      confs[i].seed = 0x9e3779b97f4a7c15ull * (i + 1);
+      confs[i].max_fid = n_files * n_i * n_j * n_k;
+      confs[i].max_cid = n_i * n_j * n_k;
+      confs[i].n_lookups = n_lookups;
+      XrdSysThread::Run(&tid[i], RunCacheReader, static_cast<void*>(&confs[i]),
+                        XRDSYSTHREAD_HOLD, "Cache Reader Thread");
+    }
+
+    // join them
+    for (size_t i = 0; i < n_i; i++) {
+      XrdSysThread::Join(tid[i], nullptr);
+    }
+
+    eos::common::LinuxStat::GetStat(st[1]);
+    eos::common::LinuxMemConsumption::GetMemoryFootprint(mem[1]);
+    COMMONTIMING("cache-stop", &tm);
+    tm.Print();
+    double rate = (n_lookups * n_i) / tm.RealTime() * 1000.0;
+    PrintStatus(view, &st[0], &st[1], &mem[0], &mem[1], rate);
+    auto file_svc = dynamic_cast<eos::FileMDSvc*>(view->getFileMDSvc());
+    auto cont_svc = dynamic_cast<eos::ContainerMDSvc*>(view->getContainerMDSvc());
+
+    if (file_svc && cont_svc) {
+      PrintCacheStats("file", file_svc->getCacheStatistics());
+      PrintCacheStats("dir", cont_svc->getCacheStatistics());
+    }
+  }
   return 0;
 }
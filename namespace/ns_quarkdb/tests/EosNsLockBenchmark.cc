@@ -0,0 +1,388 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+//------------------------------------------------------------------------------
+//! @brief Namespace lock contention benchmark
+//!
+//! Replays a mixed open/stat/setattr/create/rename workload against the
+//! HierarchicalView from several threads. The workload is run twice: once with
+//! the attribute updates and the creations taking the namespace lock in write
+//! mode (the old global locking) and once taking it in read mode and relying
+//! on the metadata objects and the children lock of the parent container to
+//! serialize the update. Renames always take the namespace lock in write mode
+//! and contend with the creations in the same directories. The throughput and
+//! the latency of every kind of operation are printed for both runs.
+//------------------------------------------------------------------------------
+
+#include "common/RWMutex.hh"
+#include "namespace/ns_quarkdb/persistency/ContainerMDSvc.hh"
+#include "namespace/ns_quarkdb/persistency/FileMDSvc.hh"
+#include "namespace/ns_quarkdb/views/HierarchicalView.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+eos::common::RWMutex nslock;
+
+//------------------------------------------------------------------------------
+// File size mapping function
+//------------------------------------------------------------------------------
+static uint64_t
+mapSize(const eos::IFileMD* /*file*/)
+{
+  return 0u;
+}
+
+//------------------------------------------------------------------------------
+// Boot the namespace
+//------------------------------------------------------------------------------
+eos::IView*
+bootNamespace(const std::map<std::string, std::string>& config)
+{
+  eos::IContainerMDSvc* contSvc = new eos::ContainerMDSvc();
+  eos::IFileMDSvc* fileSvc = new eos::FileMDSvc();
+  eos::IView* view = new eos::HierarchicalView();
+  fileSvc->configure(config);
+  contSvc->configure(config);
+  fileSvc->setContMDService(contSvc);
+  contSvc->setFileMDService(fileSvc);
+  view->setContainerMDSvc(contSvc);
+  view->setFileMDSvc(fileSvc);
+  view->configure(config);
+  view->getQuotaStats()->registerSizeMapper(mapSize);
+  view->initialize();
+  return view;
+}
+
+//------------------------------------------------------------------------------
+// Close the namespace
+//------------------------------------------------------------------------------
+void
+closeNamespace(eos::IView* view)
+{
+  eos::IContainerMDSvc* contSvc = view->getContainerMDSvc();
+  eos::IFileMDSvc* fileSvc = view->getFileMDSvc();
+  view->finalize();
+  delete view;
+  delete contSvc;
+  delete fileSvc;
+}
+
+//------------------------------------------------------------------------------
+// Path of a benchmark directory and file
+//------------------------------------------------------------------------------
+static std::string
+dirPath(uint64_t dir)
+{
+  char path[256];
+  snprintf(path, sizeof(path), "/eos/nslockbench/dir_%06llu/",
+           (unsigned long long) dir);
+  return path;
+}
+
+static std::string
+filePath(uint64_t dir, uint64_t file)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "file_%08llu", (unsigned long long) file);
+  return dirPath(dir) + name;
+}
+
+//------------------------------------------------------------------------------
+// Workload thread configuration and results
+//------------------------------------------------------------------------------
+struct WorkerThread {
+  eos::IView* view;
+  bool fine_locking; ///< Take the namespace lock in read mode for updates
+  uint64_t id;
+  uint64_t n_ops;
+  uint64_t n_dirs;
+  uint64_t n_files;
+  std::atomic<uint64_t>* next_file; ///< Id of the next created file
+  // Results
+  uint64_t n_reads = 0;
+  uint64_t read_ns = 0;
+  uint64_t max_read_ns = 0;
+  uint64_t n_setattrs = 0;
+  uint64_t setattr_ns = 0;
+  uint64_t n_creates = 0;
+  uint64_t create_ns = 0;
+  uint64_t max_create_ns = 0;
+  uint64_t n_renames = 0;
+  uint64_t rename_ns = 0;
+};
+
+//! Kind of operation
+enum OpKind { kRead, kSetattr, kCreate, kRename };
+
+//------------------------------------------------------------------------------
+// Run the mixed workload: 60% stat, 20% open, 12% setattr, 5% create,
+// 3% rename
+//------------------------------------------------------------------------------
+static void
+RunWorker(WorkerThread* w)
+{
+  uint64_t rnd = 0x9e3779b97f4a7c15ull * (w->id + 1);
+
+  for (uint64_t n = 0; n < w->n_ops; ++n) {
+    // xorshift64 to avoid contention on a shared random generator
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 7;
+    rnd ^= rnd << 17;
+    uint64_t dir = rnd % w->n_dirs;
+    uint64_t file = (rnd >> 20) % w->n_files;
+    uint64_t op = (rnd >> 40) % 100;
+    auto start = std::chrono::steady_clock::now();
+    OpKind kind = kRead;
+
+    try {
+      if (op < 60) {
+        // stat
+        eos::common::RWMutexReadLock rd_lock(nslock);
+        auto fmd = w->view->getFile(filePath(dir, file));
+        eos::IFileMD::ctime_t mtime;
+        fmd->getMTime(mtime);
+        (void) fmd->getSize();
+        (void) fmd->getCUid();
+      } else if (op < 80) {
+        // open: permission check on the parent and replica lookup
+        eos::common::RWMutexReadLock rd_lock(nslock);
+        auto cmd = w->view->getContainer(dirPath(dir));
+        (void) cmd->access(1000, 1000, R_OK | X_OK);
+        (void) cmd->getAttributes();
+        auto fmd = w->view->getFile(filePath(dir, file));
+        (void) fmd->getLocations();
+        (void) fmd->getLayoutId();
+      } else if (op < 92) {
+        // setattr/utimes on the directory, alternating with its file
+        kind = kSetattr;
+        eos::common::RWMutexReadLock rd_lock;
+        eos::common::RWMutexWriteLock wr_lock;
+
+        if (w->fine_locking) {
+          rd_lock.Grab(nslock);
+        } else {
+          wr_lock.Grab(nslock);
+        }
+
+        if (op % 2) {
+          auto cmd = w->view->getContainer(dirPath(dir));
+          cmd->setAttribute("user.bench", std::to_string(n));
+          cmd->setMTimeNow();
+          w->view->updateContainerStore(cmd.get());
+        } else {
+          auto fmd = w->view->getFile(filePath(dir, file));
+          fmd->setAttribute("user.bench", std::to_string(n));
+          fmd->setMTimeNow();
+          w->view->updateFileStore(fmd.get());
+        }
+      } else if (op < 97) {
+        // create, the name is checked and inserted under the children lock
+        // of the parent
+        kind = kCreate;
+        uint64_t id = (*w->next_file)++;
+        eos::common::RWMutexReadLock rd_lock;
+        eos::common::RWMutexWriteLock wr_lock;
+
+        if (w->fine_locking) {
+          rd_lock.Grab(nslock);
+        } else {
+          wr_lock.Grab(nslock);
+        }
+
+        auto fmd = w->view->createFile(filePath(dir, id), 0, 0);
+        fmd->setLayoutId(10);
+        w->view->updateFileStore(fmd.get());
+      } else {
+        // rename is a structural change and always takes the write lock, it
+        // flips the name of the rename file of the directory
+        kind = kRename;
+        eos::common::RWMutexWriteLock wr_lock(nslock);
+        auto cmd = w->view->getContainer(dirPath(dir));
+        auto fmd = cmd->findFile("rename_a");
+
+        if (fmd) {
+          w->view->renameFile(fmd.get(), "rename_b");
+        } else {
+          fmd = cmd->findFile("rename_b");
+          w->view->renameFile(fmd.get(), "rename_a");
+        }
+      }
+    } catch (eos::MDException& e) {
+      std::cerr << "[!] Error: " << e.getMessage().str() << std::endl;
+    }
+
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+                  (std::chrono::steady_clock::now() - start).count();
+
+    switch (kind) {
+    case kRead:
+      ++w->n_reads;
+      w->read_ns += ns;
+      w->max_read_ns = std::max(w->max_read_ns, ns);
+      break;
+
+    case kSetattr:
+      ++w->n_setattrs;
+      w->setattr_ns += ns;
+      break;
+
+    case kCreate:
+      ++w->n_creates;
+      w->create_ns += ns;
+      w->max_create_ns = std::max(w->max_create_ns, ns);
+      break;
+
+    case kRename:
+      ++w->n_renames;
+      w->rename_ns += ns;
+      break;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Run the workload with the given locking and print the results
+//------------------------------------------------------------------------------
+static void
+RunWorkload(eos::IView* view, bool fine_locking, uint64_t n_threads,
+            uint64_t n_ops, uint64_t n_dirs, uint64_t n_files,
+            std::atomic<uint64_t>& next_file)
+{
+  std::vector<WorkerThread> workers(n_threads);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint64_t i = 0; i < n_threads; ++i) {
+    workers[i].view = view;
+    workers[i].fine_locking = fine_locking;
+    workers[i].id = i;
+    workers[i].n_ops = n_ops;
+    workers[i].n_dirs = n_dirs;
+    workers[i].n_files = n_files;
+    workers[i].next_file = &next_file;
+    threads.emplace_back(RunWorker, &workers[i]);
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  double sec = std::chrono::duration_cast<std::chrono::microseconds>
+               (std::chrono::steady_clock::now() - start).count() / 1e6;
+  WorkerThread sum;
+
+  for (const auto& w : workers) {
+    sum.n_reads += w.n_reads;
+    sum.read_ns += w.read_ns;
+    sum.max_read_ns = std::max(sum.max_read_ns, w.max_read_ns);
+    sum.n_setattrs += w.n_setattrs;
+    sum.setattr_ns += w.setattr_ns;
+    sum.n_creates += w.n_creates;
+    sum.create_ns += w.create_ns;
+    sum.max_create_ns = std::max(sum.max_create_ns, w.max_create_ns);
+    sum.n_renames += w.n_renames;
+    sum.rename_ns += w.rename_ns;
+  }
+
+  auto avg_us = [](uint64_t ns, uint64_t n) {
+    return n ? ns / 1e3 / n : 0.0;
+  };
+  fprintf(stderr, "# -------------------------------------------------------------\n"
+          "ALL      locking                          %s\n"
+          "ALL      ops/s                            %.02f\n"
+          "ALL      creates/s                        %.02f\n"
+          "ALL      read    latency avg/max [us]     %.02f/%.02f\n"
+          "ALL      setattr latency avg [us]         %.02f\n"
+          "ALL      create  latency avg/max [us]     %.02f/%.02f\n"
+          "ALL      rename  latency avg [us]         %.02f\n"
+          "# -------------------------------------------------------------\n",
+          fine_locking ? "updates under read lock and children locks" :
+          "updates under write lock",
+          (sum.n_reads + sum.n_setattrs + sum.n_creates + sum.n_renames) / sec,
+          sum.n_creates / sec,
+          avg_us(sum.read_ns, sum.n_reads), sum.max_read_ns / 1e3,
+          avg_us(sum.setattr_ns, sum.n_setattrs),
+          avg_us(sum.create_ns, sum.n_creates), sum.max_create_ns / 1e3,
+          avg_us(sum.rename_ns, sum.n_renames));
+}
+
+//------------------------------------------------------------------------------
+// Main function
+//------------------------------------------------------------------------------
+int
+main(int argc, char** argv)
+{
+  if (argc != 7) {
+    std::cerr << "Usage:" << std::endl;
+    std::cerr << "  eos-ns-lock-benchmark <qdb_host> <qdb_port> <threads> "
+              << "<ops-per-thread> <dirs> <files-per-dir>" << std::endl;
+    return 1;
+  }
+
+  std::map<std::string, std::string> config = {{"qdb_host", argv[1]},
+    {"qdb_port", argv[2]}
+  };
+  uint64_t n_threads = std::stoull(argv[3]);
+  uint64_t n_ops = std::stoull(argv[4]);
+  uint64_t n_dirs = std::max(1ull, std::stoull(argv[5]));
+  uint64_t n_files = std::max(1ull, std::stoull(argv[6]));
+
+  try {
+    eos::IView* view = bootNamespace(config);
+    std::cerr << "[i] Populate " << n_dirs << " directories with " << n_files
+              << " files each ..." << std::endl;
+
+    for (uint64_t dir = 0; dir < n_dirs; ++dir) {
+      std::shared_ptr<eos::IContainerMD> cont =
+        view->createContainer(dirPath(dir), true);
+      cont->setAttribute("sys.forced.layout", "replica");
+      view->updateContainerStore(cont.get());
+      std::shared_ptr<eos::IFileMD> rename_fmd =
+        view->createFile(dirPath(dir) + "rename_a", 0, 0);
+      view->updateFileStore(rename_fmd.get());
+
+      for (uint64_t file = 0; file < n_files; ++file) {
+        std::shared_ptr<eos::IFileMD> fmd =
+          view->createFile(filePath(dir, file), 0, 0);
+        fmd->addLocation(1 + file % 16);
+        fmd->addLocation(2 + file % 16);
+        fmd->setLayoutId(10);
+        view->updateFileStore(fmd.get());
+      }
+    }
+
+    // Files created by the workload get ids above the pre-populated ones
+    std::atomic<uint64_t> next_file(n_files);
+    std::cerr << "[i] Run the workload with " << n_threads << " threads ..."
+              << std::endl;
+    RunWorkload(view, false, n_threads, n_ops, n_dirs, n_files, next_file);
+    RunWorkload(view, true, n_threads, n_ops, n_dirs, n_files, next_file);
+    closeNamespace(view);
+  } catch (eos::MDException& e) {
+    std::cerr << "[!] Error: " << e.getMessage().str() << std::endl;
+    return 2;
+  }
+
+  return 0;
+}
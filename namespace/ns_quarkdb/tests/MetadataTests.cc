@@ -29,6 +29,8 @@
 #include "namespace/ns_quarkdb/FileMD.hh"
 #include "namespace/ns_quarkdb/ContainerMD.hh"
 #include <iostream>
+#include <thread>
+#include <vector>
 
 using ::testing::_;
 using ::testing::Return;
@@ -173,4 +175,48 @@ TEST(NsQuarkdb, ContainerMd)
   ASSERT_THROW(rcont.deserialize(buffer), eos::MDException);
 }
 
+//------------------------------------------------------------------------------
+// Test concurrent attribute updates of the same container and file, as done
+// under the namespace read lock
+//------------------------------------------------------------------------------
+TEST(NsQuarkdb, ConcurrentAttributes)
+{
+  MockFileMDSvc file_svc;
+  EXPECT_CALL(file_svc, notifyListeners(_)).WillRepeatedly(Return());
+  eos::ContainerMD cont;
+  eos::FileMD file(12345, (eos::IFileMDSvc*)&file_svc);
+  const int num_threads = 8;
+  const int num_updates = 2000;
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&, i]() {
+      std::string key = "user.key" + std::to_string(i);
+
+      for (int n = 0; n < num_updates; ++n) {
+        cont.updateTreeSize(2);
+        cont.setAttribute(key, std::to_string(n));
+        cont.setMTimeNow();
+        file.setAttribute(key, std::to_string(n));
+        file.setFlag(i, n % 2);
+        eos::Buffer buffer;
+        file.serialize(buffer);
+        (void) cont.getAttributes();
+        (void) cont.access(1000, 1000, R_OK);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(2ull * num_threads * num_updates, cont.getTreeSize());
+  ASSERT_EQ((size_t) num_threads, cont.numAttributes());
+  ASSERT_EQ((size_t) num_threads, file.numAttributes());
+  ASSERT_EQ(std::to_string(num_updates - 1), cont.getAttribute("user.key0"));
+  // Every thread left its flag set on the last (odd) update
+  ASSERT_EQ((1 << num_threads) - 1, file.getFlags());
+}
+
 EOSNSTESTING_END
@@ -22,6 +22,7 @@
 //------------------------------------------------------------------------------
 
 #include "namespace/ns_quarkdb/LRU.hh"
+#include "namespace/ns_quarkdb/flusher/UpdateCoalescer.hh"
 #include "namespace/utils/PathProcessor.hh"
 #include "namespace/utils/TestHelpers.hh"
 #include <gtest/gtest.h>
@@ -125,6 +126,114 @@ TEST(LRU, BasicSanity)
   ASSERT_TRUE(!cache.get(100));
 }
 
+TEST(LRU, ShardedStats)
+{
+  struct Entry {
+    explicit Entry(std::uint64_t id) : id_(id) {}
+
+    ~Entry() = default;
+
+    std::uint64_t
+    getId() const
+    {
+      return id_;
+    }
+
+    std::uint64_t id_;
+  };
+  std::uint64_t max_size = 1024;
+  eos::LRU<std::uint64_t, Entry> cache{max_size, 6};
+  auto stats = cache.getStats();
+  // Number of shards is rounded up to a power of two
+  ASSERT_EQ(8u, stats.mNumShards);
+
+  for (std::uint64_t id = 0; id < max_size; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+  }
+
+  ASSERT_EQ(max_size, cache.size());
+
+  for (std::uint64_t id = 0; id < 2 * max_size; ++id) {
+    std::shared_ptr<Entry> elem = cache.get(id);
+
+    if (id < max_size) {
+      ASSERT_TRUE(elem);
+      ASSERT_EQ(id, elem->getId());
+    } else {
+      ASSERT_FALSE(elem);
+    }
+  }
+
+  stats = cache.getStats();
+  ASSERT_EQ(max_size, stats.mHits);
+  ASSERT_EQ(max_size, stats.mMisses);
+  ASSERT_EQ(0u, stats.mEvictions);
+  // Each shard purges 10% of its entries once full
+  ASSERT_TRUE(cache.put(max_size, std::make_shared<Entry>(max_size)));
+  stats = cache.getStats();
+  ASSERT_EQ(13u, stats.mEvictions);
+  ASSERT_EQ(max_size - 12, cache.size());
+  ASSERT_TRUE(cache.remove(max_size));
+  ASSERT_FALSE(cache.remove(max_size));
+  ASSERT_EQ(max_size - 13, cache.size());
+}
+
+TEST(LRU, ShardCapacity)
+{
+  struct Entry {
+    explicit Entry(std::uint64_t id) : id_(id) {}
+
+    ~Entry() = default;
+
+    std::uint64_t
+    getId() const
+    {
+      return id_;
+    }
+
+    std::uint64_t id_;
+  };
+  // A cache smaller than the number of shards uses at most one per entry
+  eos::LRU<std::uint64_t, Entry> small_cache{3, 16};
+  ASSERT_EQ(2u, small_cache.getStats().mNumShards);
+
+  for (std::uint64_t id = 0; id < 100; ++id) {
+    ASSERT_TRUE(small_cache.put(id, std::make_shared<Entry>(id)));
+    ASSERT_LE(small_cache.size(), 3u);
+  }
+
+  // The remainder of the size is spread across the shards
+  std::uint64_t max_size = 1000;
+  eos::LRU<std::uint64_t, Entry> cache{max_size, 16};
+  ASSERT_EQ(16u, cache.getStats().mNumShards);
+
+  for (std::uint64_t id = 0; id < max_size; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+  }
+
+  ASSERT_EQ(max_size, cache.size());
+  ASSERT_EQ(0u, cache.getStats().mEvictions);
+  // Shrinking the cache reduces the shards in use and evicts the entries
+  // above the new size, except the ones still referenced
+  std::shared_ptr<Entry> elem = cache.get(7);
+  cache.set_max_size(4);
+  ASSERT_EQ(4u, cache.getStats().mNumShards);
+  ASSERT_LE(cache.size(), 4u);
+  ASSERT_EQ(elem, cache.get(7));
+
+  for (std::uint64_t id = max_size; id < 2 * max_size; ++id) {
+    ASSERT_TRUE(cache.put(id, std::make_shared<Entry>(id)));
+    ASSERT_LE(cache.size(), 4u + 1u);
+  }
+
+  // Growing it again spreads the entries over more shards
+  cache.set_max_size(max_size);
+  ASSERT_EQ(16u, cache.getStats().mNumShards);
+  ASSERT_EQ(elem, cache.get(7));
+  ASSERT_TRUE(cache.remove(7));
+  ASSERT_FALSE(cache.get(7));
+}
+
 TEST(PathProcessor, AbsPathTest)
 {
   std::string path = "/a/b/c/d/";
@@ -149,3 +258,70 @@ TEST(PathProcessor, AbsPathTest)
   eos::PathProcessor::absPath(path);
   EXPECT_EQ("/e/f", path);
 }
+
+TEST(UpdateCoalescer, LastWriterWins)
+{
+  using Request = std::vector<std::string>;
+  eos::UpdateCoalescer coalescer;
+  std::vector<Request> out;
+
+  for (int i = 0; i < 1000; ++i) {
+    coalescer.hset("bucket", "1", "v" + std::to_string(i));
+  }
+
+  coalescer.hset("bucket", "2", "x");
+  coalescer.hdel("bucket", "3");
+  coalescer.hdel("bucket", "2");
+  coalescer.sadd("set", "a");
+  coalescer.sadd("set", "b");
+  coalescer.srem("set", "a");
+  coalescer.srem("set", "c");
+  coalescer.sadd("set", "c");
+  ASSERT_EQ(1008u, coalescer.getNumUpdates());
+  ASSERT_EQ(1008u, coalescer.drain(out));
+  ASSERT_TRUE(coalescer.empty());
+  ASSERT_EQ(0u, coalescer.getNumUpdates());
+  ASSERT_EQ(4u, out.size());
+  EXPECT_EQ(Request({"HSET", "bucket", "1", "v999"}), out[0]);
+  EXPECT_EQ(Request({"HDEL", "bucket", "2", "3"}), out[1]);
+  EXPECT_EQ(Request({"SADD", "set", "b", "c"}), out[2]);
+  EXPECT_EQ(Request({"SREM", "set", "a"}), out[3]);
+  // Multiple fields of the same key are merged into an HMSET
+  out.clear();
+  coalescer.hset("bucket", "1", "a");
+  coalescer.hset("bucket", "2", "b");
+  coalescer.drain(out);
+  ASSERT_EQ(1u, out.size());
+  EXPECT_EQ(Request({"HMSET", "bucket", "1", "a", "2", "b"}), out[0]);
+}
+
+TEST(UpdateCoalescer, Barriers)
+{
+  using Request = std::vector<std::string>;
+  eos::UpdateCoalescer coalescer;
+  std::vector<Request> out;
+  // DEL drops the updates staged before it on the same key
+  coalescer.hset("dir", "a", "1");
+  coalescer.hset("other", "a", "1");
+  coalescer.del("dir");
+  coalescer.hset("dir", "b", "2");
+  // HINCRBY keeps the previous updates of the key before it
+  coalescer.hset("quota", "space", "10");
+  coalescer.keyBarrier("quota", {"HINCRBY", "quota", "space", "5"});
+  coalescer.hset("quota", "space", "1");
+  // Generic requests are barriers for all the keys
+  coalescer.sadd("set", "a");
+  coalescer.barrier({"HINCRBYMULTI", "set", "a", "1"});
+  coalescer.srem("set", "a");
+  coalescer.drain(out);
+  ASSERT_EQ(9u, out.size());
+  EXPECT_EQ(Request({"HSET", "other", "a", "1"}), out[0]);
+  EXPECT_EQ(Request({"DEL", "dir"}), out[1]);
+  EXPECT_EQ(Request({"HSET", "dir", "b", "2"}), out[2]);
+  EXPECT_EQ(Request({"HSET", "quota", "space", "10"}), out[3]);
+  EXPECT_EQ(Request({"HINCRBY", "quota", "space", "5"}), out[4]);
+  EXPECT_EQ(Request({"HSET", "quota", "space", "1"}), out[5]);
+  EXPECT_EQ(Request({"SADD", "set", "a"}), out[6]);
+  EXPECT_EQ(Request({"HINCRBYMULTI", "set", "a", "1"}), out[7]);
+  EXPECT_EQ(Request({"SREM", "set", "a"}), out[8]);
+}
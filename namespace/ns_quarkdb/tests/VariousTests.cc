@@ -21,7 +21,10 @@
 //! @brief Various namespace tests
 //------------------------------------------------------------------------------
 
+#include <atomic>
 #include <memory>
+#include <set>
+#include <thread>
 #include <gtest/gtest.h>
 
 #include "namespace/ns_quarkdb/explorer/NamespaceExplorer.hh"
@@ -29,6 +32,7 @@
 #include "namespace/ns_quarkdb/persistency/FileMDSvc.hh"
 #include "namespace/ns_quarkdb/persistency/MetadataFetcher.hh"
 #include "namespace/ns_quarkdb/views/HierarchicalView.hh"
+#include "namespace/ns_quarkdb/accounting/ContainerAccounting.hh"
 #include "namespace/ns_quarkdb/accounting/FileSystemView.hh"
 #include "namespace/ns_quarkdb/flusher/MetadataFlusher.hh"
 #include "TestUtils.hh"
@@ -38,6 +42,9 @@ using namespace eos;
 class VariousTests : public eos::ns::testing::NsTestsFixture {};
 class NamespaceExplorerF : public eos::ns::testing::NsTestsFixture {};
 class FileMDFetching : public eos::ns::testing::NsTestsFixture {};
+class ContainerAccountingF : public eos::ns::testing::NsTestsFixture {};
+class FileSystemViewF : public eos::ns::testing::NsTestsFixture {};
+class ConcurrentCreateF : public eos::ns::testing::NsTestsFixture {};
 
 TEST_F(VariousTests, BasicSanity) {
   std::shared_ptr<eos::IContainerMD> root = view()->getContainer("/");
@@ -124,6 +131,48 @@ TEST_F(FileMDFetching, CorruptionTest) {
   }
 }
 
+TEST_F(FileMDFetching, BatchFetching) {
+  populateDummyData1();
+
+  std::vector<id_t> fileIds;
+  for(size_t i = 1; i <= 5; i++) {
+    fileIds.push_back(view()->getFile("/eos/d1/f" + std::to_string(i))->getId());
+  }
+
+  std::vector<eos::ns::FileMdProto> files = MetadataFetcher::getFilesFromIds(qcl(), fileIds).get();
+  ASSERT_EQ(files.size(), 5u);
+  for(size_t i = 0; i < files.size(); i++) {
+    ASSERT_EQ(files[i].id(), fileIds[i]);
+    ASSERT_EQ(files[i].name(), "f" + std::to_string(i + 1));
+  }
+
+  std::vector<id_t> containerIds = { 1, 2, 3, 999999 };
+  std::promise<void> done;
+  std::vector<MDStatus> statuses;
+  std::vector<eos::ns::ContainerMdProto> containers;
+
+  MetadataFetcher::getContainersFromIds(qcl(), containerIds,
+    [&](std::vector<MDStatus> &&st, std::vector<eos::ns::ContainerMdProto> &&protos) {
+      statuses = std::move(st);
+      containers = std::move(protos);
+      done.set_value();
+    }
+  );
+
+  done.get_future().wait();
+  ASSERT_EQ(statuses.size(), 4u);
+  ASSERT_TRUE(statuses[0].ok());
+  ASSERT_TRUE(statuses[1].ok());
+  ASSERT_TRUE(statuses[2].ok());
+  ASSERT_FALSE(statuses[3].ok());
+  ASSERT_EQ(statuses[3].getErrno(), ENOENT);
+  ASSERT_EQ(containers[1].name(), "eos");
+  ASSERT_EQ(containers[2].name(), "d1");
+
+  ASSERT_THROW(MetadataFetcher::getContainersFromIds(qcl(), containerIds).get(), eos::MDException);
+  ASSERT_TRUE(MetadataFetcher::getFilesFromIds(qcl(), {}).get().empty());
+}
+
 TEST_F(NamespaceExplorerF, BasicSanity) {
   populateDummyData1();
 
@@ -133,13 +182,270 @@ TEST_F(NamespaceExplorerF, BasicSanity) {
   ASSERT_THROW(eos::NamespaceExplorer("", options, qcl()), eos::MDException);
   NamespaceExplorer explorer("/eos/d1/", options, qcl());
 
-  SearchState& searchState = explorer.getSearchState();
-  ASSERT_EQ(searchState.nodes.size(), 3);
-  ASSERT_EQ(searchState.nodes[0].container.id(), 1);
-  ASSERT_EQ(searchState.nodes[1].container.id(), 2);
-  ASSERT_EQ(searchState.nodes[2].container.id(), 3);
+  std::vector<std::string> expected = {
+    "/eos/d1/",
+    "/eos/d1/f1",
+    "/eos/d1/f2",
+    "/eos/d1/f3",
+    "/eos/d1/f4",
+    "/eos/d1/f5",
+    "/eos/d1/d2/",
+    "/eos/d1/d2/d3/",
+    "/eos/d1/d2/d3/d4/",
+    "/eos/d1/d2/d3/d4/d5/",
+    "/eos/d1/d2/d3/d4/d5/d6/",
+    "/eos/d1/d2/d3/d4/d5/d6/d7/",
+    "/eos/d1/d2/d3/d4/d5/d6/d7/d8/",
+    "/eos/d1/d2/d3-1/",
+    "/eos/d1/d2/d3-2/",
+    "/eos/d1/d2-1/",
+    "/eos/d1/d2-2/",
+    "/eos/d1/d2-3/"
+  };
+
+  NamespaceItem item;
+  for(size_t i = 0; i < expected.size(); i++) {
+    ASSERT_TRUE(explorer.fetch(item));
+    ASSERT_EQ(item.fullPath, expected[i]);
+    ASSERT_EQ(item.isFile, expected[i].back() != '/');
+  }
+
+  ASSERT_FALSE(explorer.fetch(item));
+  ASSERT_EQ(explorer.getExpandedContainers(), 13u);
+}
+
+TEST_F(NamespaceExplorerF, LimitsAndFilters) {
+  populateDummyData1();
+
+  // Depth limit, small prefetch window
+  ExplorationOptions options;
+  options.depthLimit = 1;
+  options.prefetchWindow = 1;
+
+  NamespaceExplorer explorer("/eos/d1/d2", options, qcl());
+  std::vector<std::string> expected = {
+    "/eos/d1/d2/", "/eos/d1/d2/d3/", "/eos/d1/d2/d3-1/", "/eos/d1/d2/d3-2/"
+  };
+
+  NamespaceItem item;
+  for(size_t i = 0; i < expected.size(); i++) {
+    ASSERT_TRUE(explorer.fetch(item));
+    ASSERT_EQ(item.fullPath, expected[i]);
+  }
+
+  ASSERT_FALSE(explorer.fetch(item));
+
+  // Only files, don't descend into d2
+  options = ExplorationOptions();
+  options.filter = [](const NamespaceItem &it) { return it.isFile; };
+  options.expansionDecider = [](const eos::ns::ContainerMdProto &cont) {
+    return cont.name() != "d2";
+  };
+
+  NamespaceExplorer explorer2("/eos/d1", options, qcl());
+  for(size_t i = 1; i <= 5; i++) {
+    ASSERT_TRUE(explorer2.fetch(item));
+    ASSERT_TRUE(item.isFile);
+    ASSERT_EQ(item.fileMd.name(), "f" + std::to_string(i));
+  }
+
+  ASSERT_FALSE(explorer2.fetch(item));
+  ASSERT_EQ(explorer2.getExpandedContainers(), 4u);
+
+  // Expansion limit
+  options = ExplorationOptions();
+  options.expansionLimit = 2;
+
+  NamespaceExplorer explorer3("/eos/d1", options, qcl());
+  size_t count = 0;
+  while(explorer3.fetch(item)) {
+    count++;
+  }
+
+  // d1, its 5 files and 4 subcontainers, plus the 3 subcontainers of d2
+  ASSERT_EQ(count, 13u);
+}
+
+TEST_F(ContainerAccountingF, ShardedDeltas) {
+  populateDummyData1();
+
+  eos::common::RWMutex nsMutex;
+  ContainerAccounting accounting(containerSvc(), &nsMutex, 0);
+  std::shared_ptr<eos::IContainerMD> d3 = view()->getContainer("/eos/d1/d2/d3");
+  std::shared_ptr<eos::IContainerMD> d1 = view()->getContainer("/eos/d1");
+
+  std::vector<std::thread> threads;
+  for(size_t i = 0; i < 10; i++) {
+    threads.emplace_back([&]() {
+      for(size_t j = 0; j < 100; j++) {
+        accounting.QueueForUpdate(d3->getId(), 2);
+        accounting.QueueForUpdate(d3->getId(), -1);
+      }
+    });
+  }
+
+  for(size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+
+  accounting.QueueForUpdate(d1->getId(), 10);
+  // Updates of the root container are ignored
+  accounting.QueueForUpdate(1, 10);
+  // The statistics are reached the way the MGM does, from the listener
+  eos::IFileMDChangeListener* listener = &accounting;
+  eos::IAccountingStats* stats_svc =
+    dynamic_cast<eos::IAccountingStats*>(listener);
+  ASSERT_TRUE(stats_svc != nullptr);
+  eos::AccountingStats stats;
+  stats_svc->getAccountingStats(stats);
+  ASSERT_LE(stats.mQueueDepth, 11u);
+  ASSERT_GE(stats.mQueueDepth, 2u);
+  ASSERT_EQ(stats.mNumPropagations, 0u);
+  ASSERT_EQ(stats.mNumUpdates, 0u);
+
+  accounting.PropagateUpdates();
+  stats_svc->getAccountingStats(stats);
+  ASSERT_EQ(stats.mQueueDepth, 0u);
+  ASSERT_EQ(stats.mLastBatchSize, 4u);
+  ASSERT_EQ(stats.mNumPropagations, 1u);
+  ASSERT_EQ(stats.mNumUpdates, 4u);
+  ASSERT_LE(stats.mLastLatencyMs, stats.mMaxLatencyMs);
+
+  ASSERT_EQ(view()->getContainer("/eos/d1/d2/d3")->getTreeSize(), 1000u);
+  ASSERT_EQ(view()->getContainer("/eos/d1/d2")->getTreeSize(), 1000u);
+  ASSERT_EQ(view()->getContainer("/eos/d1")->getTreeSize(), 1010u);
+  ASSERT_EQ(view()->getContainer("/eos")->getTreeSize(), 1010u);
+  ASSERT_EQ(view()->getContainer("/")->getTreeSize(), 0u);
+
+  // Moving a subtree invalidates the cached parents
+  accounting.RemoveTree(d1.get(), 10);
+  accounting.PropagateUpdates();
+  ASSERT_EQ(view()->getContainer("/eos/d1")->getTreeSize(), 1000u);
+  ASSERT_EQ(view()->getContainer("/eos")->getTreeSize(), 1000u);
+  ASSERT_EQ(view()->getContainer("/eos/d1/d2")->getTreeSize(), 1000u);
+  stats_svc->getAccountingStats(stats);
+  ASSERT_EQ(stats.mLastBatchSize, 2u);
+  ASSERT_EQ(stats.mNumPropagations, 2u);
+  ASSERT_EQ(stats.mNumUpdates, 6u);
+}
+
+TEST_F(FileSystemViewF, StreamingFileMDList) {
+  view()->createContainer("/eos/stream/", true);
+  std::set<IFileMD::id_t> expected;
+
+  // More files than fit in one batch of the streaming iterator
+  for(size_t i = 0; i < 2500; i++) {
+    std::shared_ptr<IFileMD> file = view()->createFile("/eos/stream/f" + std::to_string(i), true);
+    file->addLocation(7);
+    view()->updateFileStore(file.get());
+    expected.insert(file->getId());
+  }
+
+  // A file removed from the backend but still present in the fs set
+  std::shared_ptr<IFileMD> file = view()->getFile("/eos/stream/f0");
+  IFileMD::id_t removed_id = file->getId();
+  file.reset();
+  mdFlusher()->hdel(FileMDSvc::getBucketKey(removed_id), std::to_string(removed_id));
+  mdFlusher()->synchronize();
+  expected.erase(removed_id);
+
+  // Start with an empty cache, then cache one of the files
+  shut_down_everything();
+  std::shared_ptr<IFileMD> cached = view()->getFile("/eos/stream/f1");
+
+  std::set<IFileMD::id_t> streamed;
+  for(auto it = fsview()->getStreamingFileMDList(7, fileSvc()); it && it->valid(); it->next()) {
+    ASSERT_TRUE(it->getElement()->hasLocation(7));
+    ASSERT_TRUE(streamed.insert(it->getElement()->getId()).second);
+
+    if(it->getElement()->getId() == cached->getId()) {
+      ASSERT_EQ(it->getElement(), cached);
+    }
+  }
+
+  ASSERT_EQ(streamed, expected);
+  // The streamed files went through the cache
+  std::shared_ptr<IFileMD> last;
+  ASSERT_TRUE(static_cast<FileMDSvc*>(fileSvc())->getCachedFileMD(*expected.rbegin(), last));
+  ASSERT_EQ(last->getId(), *expected.rbegin());
+  ASSERT_EQ(fsview()->getStreamingFileMDList(8, fileSvc()), nullptr);
+
+  // Small pages still go through the whole set
+  size_t count = 0;
+  for(QdbFileIterator it(qcl(), keyFilesystemFiles(7), 100); it.valid(); it.next()) {
+    count++;
+  }
+
+  ASSERT_EQ(count, 2500u);
+}
+
+TEST_F(ConcurrentCreateF, SameNamesUnderReadLock) {
+  // Files are created concurrently as done by the MGM while holding the
+  // namespace lock only in read mode
+  std::shared_ptr<eos::IContainerMD> cont = view()->createContainer("/eos/concurrent/", true);
+  const size_t numThreads = 8;
+  const size_t numNames = 200;
+  std::atomic<size_t> created(0);
+  std::atomic<size_t> failed(0);
+  std::atomic<bool> done(false);
+  std::atomic<size_t> badListing(0);
+
+  // Iterate over the children while they change
+  std::thread lister([&]() {
+    while(!done) {
+      eos::ReadLockGuard lock(cont->getChildrenLock());
+      size_t count = 0;
+
+      for(auto it = cont->filesBegin(); it != cont->filesEnd(); ++it) {
+        count++;
+      }
+
+      if(count != cont->getNumFiles()) {
+        badListing++;
+      }
+    }
+  });
+
+  std::vector<std::thread> threads;
+  for(size_t i = 0; i < numThreads; i++) {
+    threads.emplace_back([&, i]() {
+      for(size_t j = 0; j < numNames; j++) {
+        try {
+          std::shared_ptr<IFileMD> file = view()->createFile("/eos/concurrent/f" + std::to_string(j), 0, 0);
+          file->addLocation(i + 1);
+          view()->updateFileStore(file.get());
+          created++;
+        }
+        catch(const eos::MDException& e) {
+          ASSERT_EQ(e.getErrno(), EEXIST);
+          failed++;
+        }
+      }
+    });
+  }
+
+  for(size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+
+  done = true;
+  lister.join();
+
+  // Every name was created exactly once, without orphans
+  ASSERT_EQ(created.load(), numNames);
+  ASSERT_EQ(failed.load(), (numThreads - 1) * numNames);
+  ASSERT_EQ(badListing.load(), 0u);
+  ASSERT_EQ(cont->getNumFiles(), numNames);
+  ASSERT_EQ(fileSvc()->getNumFiles(), numNames);
+
+  uint64_t onFs = 0;
+  for(size_t i = 0; i < numThreads; i++) {
+    for(auto it = fsview()->getFileList(i + 1); it && it->valid(); it->next()) {
+      ASSERT_TRUE(fileSvc()->getFileMD(it->getElement())->hasLocation(i + 1));
+      onFs++;
+    }
+  }
 
-  // NamespaceItem item;
-  // ASSERT_TRUE(explorer.fetch(item));
-  // ASSERT_EQ(item.fileMd.name(), "f1");
+  ASSERT_EQ(onFs, numNames);
+  ASSERT_EQ(fsview()->getNumNoReplicasFiles(), 0u);
 }
@@ -223,34 +223,43 @@ HierarchicalView::createFile(const std::string& uri, uid_t uid, gid_t gid)
     throw e;
   }
 
-  // Check if the file of this name can be inserted
-  if (cont->findContainer(elements[position])) {
-    MDException e(EEXIST);
-    e.getMessage() << "File exist";
-    throw e;
-  }
+  std::shared_ptr<IFileMD> file;
+
+  {
+    // Check and insert as one step, the caller might hold the namespace lock
+    // only in read mode
+    WriteLockGuard lock(cont->getChildrenLock());
+
+    // Check if the file of this name can be inserted
+    if (cont->findContainer(elements[position])) {
+      MDException e(EEXIST);
+      e.getMessage() << "File exist";
+      throw e;
+    }
 
-  if (cont->findFile(elements[position])) {
-    MDException e(EEXIST);
-    e.getMessage() << "File exist";
-    throw e;
-  }
+    if (cont->findFile(elements[position])) {
+      MDException e(EEXIST);
+      e.getMessage() << "File exist";
+      throw e;
+    }
 
-  std::shared_ptr<IFileMD> file{pFileSvc->createFile()};
+    file = pFileSvc->createFile();
 
-  if (!file) {
-    MDException e(EIO);
-    e.getMessage() << "File creation failed";
-    throw e;
+    if (!file) {
+      MDException e(EIO);
+      e.getMessage() << "File creation failed";
+      throw e;
+    }
+
+    file->setName(elements[position]);
+    file->setCUid(uid);
+    file->setCGid(gid);
+    file->setCTimeNow();
+    file->setMTimeNow();
+    file->clearChecksum(0);
+    cont->addFile(file.get());
   }
 
-  file->setName(elements[position]);
-  file->setCUid(uid);
-  file->setCGid(gid);
-  file->setCTimeNow();
-  file->setMTimeNow();
-  file->clearChecksum(0);
-  cont->addFile(file.get());
   updateFileStore(file.get());
   return file;
 }
@@ -843,6 +852,7 @@ HierarchicalView::renameContainer(IContainerMD* container,
 
   std::shared_ptr<IContainerMD> parent{
     pContainerSvc->getContainerMD(container->getParentId())};
+  WriteLockGuard lock(parent->getChildrenLock());
 
   if (parent->findContainer(newName) != nullptr) {
     MDException ex;
@@ -888,6 +898,7 @@ HierarchicalView::renameFile(IFileMD* file, const std::string& newName)
 
   std::shared_ptr<IContainerMD> parent{
     pContainerSvc->getContainerMD(file->getContainerId())};
+  WriteLockGuard lock(parent->getChildrenLock());
 
   if (parent->findContainer(newName) != nullptr) {
     MDException ex;
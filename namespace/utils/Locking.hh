@@ -23,6 +23,10 @@
 #ifndef EOS_NS_LOCKING_HH
 #define EOS_NS_LOCKING_HH
 
+#include <atomic>
+#include <thread>
+#include <pthread.h>
+
 namespace eos
 {
   class LockHandler
@@ -48,6 +52,163 @@ namespace eos
       //------------------------------------------------------------------------
       virtual void unLock() = 0;
   };
+
+  //----------------------------------------------------------------------------
+  //! Read-write lock small enough to be embedded in every metadata object.
+  //! Readers go ahead of writers and are reentrant. The thread holding the
+  //! write lock may take it again, in read or write mode, but a read lock is
+  //! never upgraded to a write lock.
+  //----------------------------------------------------------------------------
+  class ObjectRWLock : public LockHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      ObjectRWLock(): mWriter(std::thread::id()), mDepth(0)
+      {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+#ifndef __APPLE__
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_READER_NP);
+#endif
+        pthread_rwlock_init(&mLock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+      }
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      virtual ~ObjectRWLock()
+      {
+        pthread_rwlock_destroy(&mLock);
+      }
+
+      ObjectRWLock(const ObjectRWLock&) = delete;
+      ObjectRWLock& operator=(const ObjectRWLock&) = delete;
+
+      //------------------------------------------------------------------------
+      //! Take a read lock
+      //------------------------------------------------------------------------
+      virtual void readLock() override
+      {
+        if (mWriter.load() == std::this_thread::get_id()) {
+          ++mDepth;
+        } else {
+          pthread_rwlock_rdlock(&mLock);
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //! Take a write lock
+      //------------------------------------------------------------------------
+      virtual void writeLock() override
+      {
+        if (mWriter.load() == std::this_thread::get_id()) {
+          ++mDepth;
+        } else {
+          pthread_rwlock_wrlock(&mLock);
+          mWriter = std::this_thread::get_id();
+          mDepth = 1;
+        }
+      }
+
+      //------------------------------------------------------------------------
+      //! Try to take a write lock without waiting
+      //!
+      //! @return true if the lock was taken, otherwise false
+      //------------------------------------------------------------------------
+      bool tryWriteLock()
+      {
+        if (mWriter.load() == std::this_thread::get_id()) {
+          ++mDepth;
+          return true;
+        }
+
+        if (pthread_rwlock_trywrlock(&mLock)) {
+          return false;
+        }
+
+        mWriter = std::this_thread::get_id();
+        mDepth = 1;
+        return true;
+      }
+
+      //------------------------------------------------------------------------
+      //! Unlock
+      //------------------------------------------------------------------------
+      virtual void unLock() override
+      {
+        if (mWriter.load() == std::this_thread::get_id()) {
+          if (--mDepth) {
+            return;
+          }
+
+          mWriter = std::thread::id();
+        }
+
+        pthread_rwlock_unlock(&mLock);
+      }
+
+    private:
+      pthread_rwlock_t mLock;
+      std::atomic<std::thread::id> mWriter; ///< Thread holding the write lock
+      unsigned int mDepth; ///< Number of times the writer took the lock
+  };
+
+  //----------------------------------------------------------------------------
+  //! Read lock helper, does nothing without lock handler
+  //----------------------------------------------------------------------------
+  class ReadLockGuard
+  {
+    public:
+      explicit ReadLockGuard(LockHandler* lock): mLock(lock)
+      {
+        if (mLock) {
+          mLock->readLock();
+        }
+      }
+
+      ~ReadLockGuard()
+      {
+        if (mLock) {
+          mLock->unLock();
+        }
+      }
+
+      ReadLockGuard(const ReadLockGuard&) = delete;
+      ReadLockGuard& operator=(const ReadLockGuard&) = delete;
+
+    private:
+      LockHandler* mLock;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Write lock helper, does nothing without lock handler
+  //----------------------------------------------------------------------------
+  class WriteLockGuard
+  {
+    public:
+      explicit WriteLockGuard(LockHandler* lock): mLock(lock)
+      {
+        if (mLock) {
+          mLock->writeLock();
+        }
+      }
+
+      ~WriteLockGuard()
+      {
+        if (mLock) {
+          mLock->unLock();
+        }
+      }
+
+      WriteLockGuard(const WriteLockGuard&) = delete;
+      WriteLockGuard& operator=(const WriteLockGuard&) = delete;
+
+    private:
+      LockHandler* mLock;
+  };
 }
 
 #endif // EOS_NS_LOCKING_HH
@@ -24,6 +24,7 @@
 #include "gtest/gtest.h"
 #include "Namespace.hh"
 #include "common/Mapping.hh"
+#include "XrdSec/XrdSecEntity.hh"
 
 EOSCOMMONTESTING_BEGIN
 
@@ -78,4 +79,55 @@ TEST(Mapping, VidAssignOperator)
   ASSERT_TRUE(vid.sudoer == copy_vid.sudoer);
 }
 
+TEST(Mapping, IdMapCache)
+{
+  using namespace eos::common;
+  Mapping::Init();
+  XrdSecEntity client("sss");
+  client.name = (char*) "someuser";
+  client.host = (char*) "client.cern.ch";
+  const char* tident = "someuser.12:34@client";
+  {
+    RWMutexWriteLock lock(Mapping::gMapMutex);
+    Mapping::gVirtualUidMap["sss:\"<pwd>\":uid"] = 1234;
+    Mapping::InvalidateIdCache();
+  }
+  Mapping::VirtualIdentity vid;
+  Mapping::IdMap(&client, "eos.app=test", tident, vid, false);
+  ASSERT_EQ(1234u, vid.uid);
+  ASSERT_EQ(99u, vid.gid);
+  ASSERT_EQ("test", vid.app);
+  ASSERT_EQ("client.cern.ch", vid.host);
+  // The same session maps to the same identity - the geo location given by
+  // the caller is kept
+  Mapping::VirtualIdentity vid2;
+  vid2.geolocation = "site";
+  Mapping::IdMap(&client, "eos.app=test", tident, vid2, false);
+  ASSERT_EQ(1234u, vid2.uid);
+  ASSERT_EQ("test", vid2.app);
+  ASSERT_EQ("site", vid2.geolocation);
+  ASSERT_TRUE(vid.uid_list == vid2.uid_list);
+  ASSERT_TRUE(vid.gid_list == vid2.gid_list);
+  // The environment is part of the session key
+  Mapping::VirtualIdentity vid3;
+  Mapping::IdMap(&client, 0, tident, vid3, false);
+  ASSERT_EQ(1234u, vid3.uid);
+  ASSERT_EQ("", vid3.app);
+  // Changing the rules invalidates the cached identities
+  {
+    RWMutexWriteLock lock(Mapping::gMapMutex);
+    Mapping::gVirtualUidMap["sss:\"<pwd>\":uid"] = 1235;
+    Mapping::InvalidateIdCache();
+  }
+  Mapping::IdMap(&client, "eos.app=test", tident, vid, false);
+  ASSERT_EQ(1235u, vid.uid);
+  {
+    RWMutexWriteLock lock(Mapping::gMapMutex);
+    Mapping::gVirtualUidMap.erase("sss:\"<pwd>\":uid");
+    Mapping::InvalidateIdCache();
+  }
+  Mapping::IdMap(&client, "eos.app=test", tident, vid, false);
+  ASSERT_EQ(99u, vid.uid);
+}
+
 EOSCOMMONTESTING_END
@@ -0,0 +1,99 @@
+//------------------------------------------------------------------------------
+// File: TokenBucketTest.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "common/TokenBucket.hh"
+#include <vector>
+
+using eos::common::TokenBucket;
+typedef TokenBucket::Clock Clock;
+
+TEST(TokenBucketTest, Unlimited)
+{
+  TokenBucket bucket;
+  Clock::time_point now = Clock::now();
+
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(Clock::duration::zero(), bucket.Consume(1e9, now));
+    ASSERT_TRUE(bucket.TryConsume(1e9, now));
+  }
+}
+
+TEST(TokenBucketTest, Debt)
+{
+  TokenBucket bucket(0, 0);
+  Clock::time_point now = Clock::now();
+  bucket.SetRate(100, 100, now);
+  // Starts empty after a rate change from unlimited
+  std::chrono::duration<double> wait = bucket.Consume(50, now);
+  ASSERT_NEAR(0.5, wait.count(), 1e-6);
+  wait = bucket.Consume(50, now);
+  ASSERT_NEAR(1.0, wait.count(), 1e-6);
+  // The debt is paid back by the refill
+  now += std::chrono::seconds(1);
+  wait = bucket.Consume(0, now);
+  ASSERT_EQ(0.0, wait.count());
+  wait = bucket.Consume(10, now);
+  ASSERT_NEAR(0.1, wait.count(), 1e-6);
+}
+
+TEST(TokenBucketTest, Burst)
+{
+  TokenBucket bucket(0, 0);
+  Clock::time_point now = Clock::now();
+  bucket.SetRate(10, 20, now);
+  // A long idle period only fills the bucket up to the burst
+  now += std::chrono::seconds(100);
+  ASSERT_TRUE(bucket.TryConsume(20, now));
+  ASSERT_FALSE(bucket.TryConsume(1, now));
+  now += std::chrono::milliseconds(100);
+  ASSERT_TRUE(bucket.TryConsume(1, now));
+  ASSERT_FALSE(bucket.TryConsume(1, now));
+  // A lower rate caps the tokens to the new burst
+  now += std::chrono::seconds(100);
+  bucket.SetRate(1, 0, now);
+  ASSERT_TRUE(bucket.TryConsume(1, now));
+  ASSERT_FALSE(bucket.TryConsume(1, now));
+}
+
+TEST(TokenBucketTest, Rate)
+{
+  // Consumers sleeping on their debt get the configured rate in total
+  TokenBucket bucket(1000, 10);
+  Clock::time_point start = Clock::now();
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 50; ++i) {
+        bucket.Acquire(1);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  ASSERT_GE(elapsed.count(), 0.18);
+}
@@ -0,0 +1,455 @@
+//------------------------------------------------------------------------------
+// File: AsyncIoQueueTest.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "fst/io/local/AsyncIoQueue.hh"
+#include "fst/io/local/FsIo.hh"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using eos::fst::AsyncIoQueue;
+using eos::fst::FsIo;
+
+namespace
+{
+//------------------------------------------------------------------------------
+//! In-memory file recording the transfers done by a queue. The transfers can
+//! be held back so that the requests submitted meanwhile form one batch.
+//------------------------------------------------------------------------------
+struct MemFile {
+  //! Transfer as seen by the file
+  struct Call {
+    bool mIsWrite;
+    uint64_t mOffset;
+    int mIovCount;
+    uint64_t mLength;
+  };
+
+  std::mutex mMutex;
+  std::condition_variable mCond;
+  bool mHold = false; ///< transfers wait while set
+  bool mWaiting = false; ///< set once a transfer waits
+  int mWriteErrno = 0; ///< if set the writes fail with this error
+  std::string mData;
+  std::vector<Call> mCalls;
+
+  int64_t Transfer(bool isWrite, uint64_t offset, const struct iovec* iov,
+                   int iovcnt)
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWaiting = true;
+    mCond.notify_all();
+    mCond.wait(lock, [this]() {
+      return !mHold;
+    });
+    uint64_t length = 0;
+
+    for (int i = 0; i < iovcnt; ++i) {
+      length += iov[i].iov_len;
+    }
+
+    mCalls.push_back({isWrite, offset, iovcnt, length});
+
+    if (isWrite && mWriteErrno) {
+      errno = mWriteErrno;
+      return -1;
+    }
+
+    if (isWrite && (mData.size() < offset + length)) {
+      mData.resize(offset + length, '\0');
+    }
+
+    int64_t total = 0;
+
+    for (int i = 0; i < iovcnt; ++i) {
+      uint64_t pos = offset + total;
+      size_t len = iov[i].iov_len;
+
+      if (!isWrite) {
+        len = (pos < mData.size() ? std::min<uint64_t>(len, mData.size() - pos) :
+               0);
+      }
+
+      if (isWrite) {
+        memcpy(&mData[pos], iov[i].iov_base, len);
+      } else {
+        memcpy(iov[i].iov_base, mData.data() + pos, len);
+      }
+
+      total += len;
+
+      if (len < iov[i].iov_len) {
+        break;
+      }
+    }
+
+    return total;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Hold back the transfers and submit a request which starts a run, the
+  //! requests submitted until Release is called form the next batch
+  //----------------------------------------------------------------------------
+  void Hold(AsyncIoQueue& queue)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mHold = true;
+      mWaiting = false;
+    }
+    static char byte;
+    AsyncIoQueue::Request req;
+    req.mIsWrite = false;
+    req.mSegments.push_back({1ull << 40, &byte, 1, 0});
+    queue.Submit(std::move(req));
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCond.wait(lock, [this]() {
+      return mWaiting;
+    });
+  }
+
+  //----------------------------------------------------------------------------
+  //! Let the transfers proceed and forget the ones done so far
+  //----------------------------------------------------------------------------
+  void Release(AsyncIoQueue& queue)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mHold = false;
+      mCond.notify_all();
+    }
+    queue.Wait();
+    // Drop the call of the request used to hold back the transfers
+    mCalls.erase(mCalls.begin());
+  }
+};
+
+//------------------------------------------------------------------------------
+// Build a request with one segment
+//------------------------------------------------------------------------------
+AsyncIoQueue::Request
+MakeRequest(bool isWrite, uint64_t offset, char* buffer, uint32_t length,
+            std::vector<AsyncIoQueue::Request>* done = nullptr)
+{
+  AsyncIoQueue::Request req;
+  req.mIsWrite = isWrite;
+  req.mSegments.push_back({offset, buffer, length, 0});
+
+  if (done) {
+    req.mCallback = [done](AsyncIoQueue::Request & r) {
+      done->push_back(r);
+    };
+  }
+
+  return req;
+}
+
+//------------------------------------------------------------------------------
+// Read the whole content of a file
+//------------------------------------------------------------------------------
+std::string
+ReadFile(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+}
+
+//------------------------------------------------------------------------------
+// Contiguous requests of the same type queued together are done with one
+// vector transfer
+//------------------------------------------------------------------------------
+TEST(AsyncIoQueue, MergedBatch)
+{
+  MemFile file;
+  AsyncIoQueue queue([&file](bool isWrite, uint64_t offset,
+  const struct iovec * iov, int iovcnt) {
+    return file.Transfer(isWrite, offset, iov, iovcnt);
+  });
+  std::vector<std::string> data;
+  std::vector<AsyncIoQueue::Request> done;
+
+  for (int i = 0; i < 16; ++i) {
+    data.push_back(std::string(1000, (char)('a' + i)));
+  }
+
+  file.Hold(queue);
+
+  for (int i = 0; i < 16; ++i) {
+    queue.Submit(MakeRequest(true, i * 1000, &data[i][0], 1000, &done));
+  }
+
+  file.Release(queue);
+  ASSERT_EQ(1u, file.mCalls.size());
+  ASSERT_TRUE(file.mCalls[0].mIsWrite);
+  ASSERT_EQ(0ull, file.mCalls[0].mOffset);
+  ASSERT_EQ(16, file.mCalls[0].mIovCount);
+  ASSERT_EQ(16000ull, file.mCalls[0].mLength);
+  ASSERT_EQ(16u, done.size());
+
+  for (int i = 0; i < 16; ++i) {
+    // Callbacks come in submission order
+    ASSERT_EQ(i * 1000ull, done[i].mSegments[0].mOffset);
+    ASSERT_EQ(0, done[i].mErrno);
+    ASSERT_EQ(1000, done[i].mSegments[0].mDone);
+    ASSERT_EQ(data[i], file.mData.substr(i * 1000, 1000));
+  }
+
+  // The segments of a single request are merged the same way
+  file.mCalls.clear();
+  std::string out(3000, '\0');
+  AsyncIoQueue::Request req;
+  req.mIsWrite = false;
+
+  for (int i = 0; i < 3; ++i) {
+    req.mSegments.push_back({5000ull + i * 1000, &out[i * 1000], 1000, 0});
+  }
+
+  queue.Submit(std::move(req));
+  queue.Wait();
+  ASSERT_EQ(1u, file.mCalls.size());
+  ASSERT_EQ(3, file.mCalls[0].mIovCount);
+  ASSERT_EQ(file.mData.substr(5000, 3000), out);
+}
+
+//------------------------------------------------------------------------------
+// A run is cut on a change of type, on a gap between the offsets and when
+// it reaches the maximum number of segments
+//------------------------------------------------------------------------------
+TEST(AsyncIoQueue, SplitBatch)
+{
+  MemFile file;
+  file.mData.assign(20000, 'x');
+  AsyncIoQueue queue([&file](bool isWrite, uint64_t offset,
+  const struct iovec * iov, int iovcnt) {
+    return file.Transfer(isWrite, offset, iov, iovcnt);
+  });
+  std::vector<char> buffer(20000);
+  std::vector<AsyncIoQueue::Request> done;
+  file.Hold(queue);
+  queue.Submit(MakeRequest(false, 0, &buffer[0], 100, &done));
+  queue.Submit(MakeRequest(false, 100, &buffer[100], 100, &done));
+  queue.Submit(MakeRequest(true, 200, &buffer[200], 100, &done));
+  queue.Submit(MakeRequest(true, 500, &buffer[500], 100, &done));
+
+  for (int i = 0; i < 1030; ++i) {
+    queue.Submit(MakeRequest(false, 10000 + i, &buffer[10000 + i], 1, &done));
+  }
+
+  file.Release(queue);
+  ASSERT_EQ(1034u, done.size());
+  ASSERT_EQ(5u, file.mCalls.size());
+  std::vector<MemFile::Call> expected {
+    {false, 0, 2, 200},
+    {true, 200, 1, 100},
+    {true, 500, 1, 100},
+    {false, 10000, 1024, 1024},
+    {false, 11024, 6, 6}
+  };
+
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(expected[i].mIsWrite, file.mCalls[i].mIsWrite) << "call=" << i;
+    ASSERT_EQ(expected[i].mOffset, file.mCalls[i].mOffset) << "call=" << i;
+    ASSERT_EQ(expected[i].mIovCount, file.mCalls[i].mIovCount) << "call=" << i;
+    ASSERT_EQ(expected[i].mLength, file.mCalls[i].mLength) << "call=" << i;
+  }
+
+  for (const auto& req : done) {
+    ASSERT_EQ(0, req.mErrno);
+    ASSERT_EQ(req.mSegments[0].mLength, req.mSegments[0].mDone);
+  }
+}
+
+//------------------------------------------------------------------------------
+// A short read of a merged run is accounted to its segments in order
+//------------------------------------------------------------------------------
+TEST(AsyncIoQueue, ShortRead)
+{
+  MemFile file;
+  file.mData.assign(10000, 'y');
+  AsyncIoQueue queue([&file](bool isWrite, uint64_t offset,
+  const struct iovec * iov, int iovcnt) {
+    return file.Transfer(isWrite, offset, iov, iovcnt);
+  });
+  std::vector<char> buffer(5 * 4096);
+  std::vector<AsyncIoQueue::Request> done;
+  file.Hold(queue);
+
+  for (int i = 0; i < 3; ++i) {
+    queue.Submit(MakeRequest(false, i * 4096, &buffer[i * 4096], 4096, &done));
+  }
+
+  queue.Submit(MakeRequest(false, 20000, &buffer[4 * 4096], 4096, &done));
+  file.Release(queue);
+  ASSERT_EQ(2u, file.mCalls.size());
+  ASSERT_EQ(4u, done.size());
+  ASSERT_EQ(4096, done[0].mSegments[0].mDone);
+  ASSERT_EQ(4096, done[1].mSegments[0].mDone);
+  ASSERT_EQ(10000 - 2 * 4096, done[2].mSegments[0].mDone);
+  ASSERT_EQ(0, done[3].mSegments[0].mDone);
+
+  for (const auto& req : done) {
+    ASSERT_EQ(0, req.mErrno);
+  }
+
+  ASSERT_EQ(std::string(10000, 'y'), std::string(buffer.data(), 10000));
+}
+
+//------------------------------------------------------------------------------
+// A failed transfer fails all the segments of its run with the errno of the
+// transfer, the other runs of the batch are not affected
+//------------------------------------------------------------------------------
+TEST(AsyncIoQueue, ErrorPath)
+{
+  MemFile file;
+  file.mData.assign(1000, 'z');
+  file.mWriteErrno = ENOSPC;
+  AsyncIoQueue queue([&file](bool isWrite, uint64_t offset,
+  const struct iovec * iov, int iovcnt) {
+    return file.Transfer(isWrite, offset, iov, iovcnt);
+  });
+  std::vector<char> buffer(1000);
+  std::vector<AsyncIoQueue::Request> done;
+  file.Hold(queue);
+  queue.Submit(MakeRequest(true, 0, &buffer[0], 100, &done));
+  queue.Submit(MakeRequest(true, 100, &buffer[100], 100, &done));
+  queue.Submit(MakeRequest(false, 500, &buffer[500], 100, &done));
+  queue.Submit(MakeRequest(false, 800, &buffer[800], 100, &done));
+  queue.Submit(MakeRequest(true, 900, &buffer[900], 100, &done));
+  file.Release(queue);
+  ASSERT_EQ(5u, done.size());
+  ASSERT_EQ(4u, file.mCalls.size());
+
+  for (int i : {
+         0, 1, 4
+       }) {
+    ASSERT_EQ(ENOSPC, done[i].mErrno) << "request=" << i;
+    ASSERT_EQ(-1, done[i].mSegments[0].mDone) << "request=" << i;
+  }
+
+  for (int i : {
+         2, 3
+       }) {
+    ASSERT_EQ(0, done[i].mErrno) << "request=" << i;
+    ASSERT_EQ(100, done[i].mSegments[0].mDone) << "request=" << i;
+  }
+
+  // A transfer failing without errno is reported as an IO error
+  AsyncIoQueue nerr_queue([](bool isWrite, uint64_t offset,
+  const struct iovec * iov, int iovcnt) -> int64_t {
+    errno = 0;
+    return -1;
+  });
+  done.clear();
+  nerr_queue.Submit(MakeRequest(false, 0, &buffer[0], 10, &done));
+  nerr_queue.Wait();
+  ASSERT_EQ(1u, done.size());
+  ASSERT_EQ(EIO, done[0].mErrno);
+  ASSERT_EQ(-1, done[0].mSegments[0].mDone);
+}
+
+//------------------------------------------------------------------------------
+// Unaligned asynchronous requests on a file opened with O_DIRECT go through
+// the aligned bounce buffers or the buffered descriptor and give the same
+// data as the buffered IO
+//------------------------------------------------------------------------------
+TEST(AsyncIoQueue, DirectIo)
+{
+  if (!AsyncIoQueue::IsEnabled()) {
+    std::cerr << "asynchronous local IO disabled, skipping" << std::endl;
+    return;
+  }
+
+  // /tmp is often a tmpfs which does not support O_DIRECT
+  char tmpl[] = "/var/tmp/eos-asyncio.XXXXXX";
+  int fd = mkstemp(tmpl);
+  ASSERT_NE(-1, fd);
+  std::string path = tmpl;
+  std::mt19937 gen(11);
+  std::string data(64 * 1024 + 123, '\0');
+
+  for (auto& c : data) {
+    c = (char)(gen() & 0xff);
+  }
+
+  ASSERT_EQ((ssize_t) data.size(), pwrite(fd, data.data(), data.size(), 0));
+  (void) close(fd);
+  FsIo file(path);
+
+  if (file.fileOpen(O_RDWR | O_DIRECT)) {
+    std::cerr << "O_DIRECT not supported in /var/tmp, skipping" << std::endl;
+    (void) unlink(path.c_str());
+    return;
+  }
+
+  // Unaligned reads into unaligned buffers
+  std::vector<std::pair<uint64_t, uint32_t>> reads {
+    {1, 10}, {4095, 2}, {5000, 8000}, {8192, 4096}, {60000, 5000}
+  };
+  std::vector<std::string> out;
+
+  for (const auto& rd : reads) {
+    out.push_back(std::string(rd.second + 1, '\0'));
+  }
+
+  for (size_t i = 0; i < reads.size(); ++i) {
+    ASSERT_EQ((int64_t) reads[i].second,
+              file.fileReadAsync(reads[i].first, &out[i][1], reads[i].second));
+  }
+
+  ASSERT_EQ(0, file.fileWaitAsyncIO());
+
+  for (size_t i = 0; i < reads.size(); ++i) {
+    ASSERT_EQ(data.substr(reads[i].first, reads[i].second), out[i].substr(1))
+        << "offset=" << reads[i].first;
+  }
+
+  // Aligned range from an unaligned buffer and a write with unaligned offset
+  std::string block(4097, 'B');
+  std::string small(50, 'S');
+  ASSERT_EQ(4096, file.fileWriteAsync(16384, &block[1], 4096));
+  ASSERT_EQ(50, file.fileWriteAsync(100, small.data(), 50));
+  ASSERT_EQ(0, file.fileWaitAsyncIO());
+  // The buffered and direct writes are both visible to direct reads
+  std::string check(4097, '\0');
+  ASSERT_EQ(4096, file.fileReadAsync(0, &check[1], 4096));
+  ASSERT_EQ(0, file.fileWaitAsyncIO());
+  ASSERT_EQ(0, file.fileClose());
+  data.replace(16384, 4096, block.substr(1));
+  data.replace(100, 50, small);
+  ASSERT_EQ(data.substr(0, 4096), check.substr(1));
+  ASSERT_EQ(data, ReadFile(path));
+  (void) unlink(path.c_str());
+}
@@ -0,0 +1,220 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "fst/checksum/Adler.hh"
+#include "fst/checksum/CRC32C.hh"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using eos::fst::Adler;
+using eos::fst::CRC32C;
+using eos::fst::CheckSum;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Build some pseudo-random file content
+//------------------------------------------------------------------------------
+std::string
+MakeData(size_t length)
+{
+  std::mt19937 gen(42);
+  std::string data(length, '\0');
+
+  for (size_t i = 0; i < length; ++i) {
+    data[i] = (char)(gen() & 0xff);
+  }
+
+  return data;
+}
+
+//------------------------------------------------------------------------------
+// Checksum of the data added sequentially
+//------------------------------------------------------------------------------
+std::string
+Sequential(CheckSum& xs, const std::string& data)
+{
+  xs.Reset();
+  xs.Add(data.data(), data.length(), 0);
+  xs.Finalize();
+  return xs.GetHexChecksum();
+}
+
+//------------------------------------------------------------------------------
+// Add the data in chunks of varying size, in random order
+//------------------------------------------------------------------------------
+void
+AddShuffled(CheckSum& xs, const std::string& data, unsigned int seed)
+{
+  std::vector<std::pair<off_t, size_t>> chunks;
+  std::mt19937 gen(seed);
+  off_t offset = 0;
+
+  while (offset < (off_t) data.length()) {
+    size_t len = std::min((size_t)(1 + gen() % 70000),
+                          data.length() - (size_t) offset);
+    chunks.emplace_back(offset, len);
+    offset += len;
+  }
+
+  std::shuffle(chunks.begin(), chunks.end(), gen);
+  xs.Reset();
+
+  for (const auto& chunk : chunks) {
+    xs.Add(data.data() + chunk.first, chunk.second, chunk.first);
+  }
+}
+}
+
+//------------------------------------------------------------------------------
+// Combining the CRC32C of two blocks gives the CRC32C of the concatenation
+//------------------------------------------------------------------------------
+TEST(ChecksumTest, Crc32cCombine)
+{
+  std::string data = MakeData(100000);
+
+  for (size_t split : {
+         0, 1, 7, 4096, 65537, 100000
+       }) {
+    uint32_t crc1 = checksum::crc32cFinish(checksum::crc32c(
+                      checksum::crc32cInit(), data.data(), split));
+    uint32_t crc2 = checksum::crc32cFinish(checksum::crc32c(
+                      checksum::crc32cInit(), data.data() + split,
+                      data.length() - split));
+    uint32_t crc = checksum::crc32cFinish(checksum::crc32c(
+                     checksum::crc32cInit(), data.data(), data.length()));
+    ASSERT_EQ(crc, checksum::crc32cCombine(crc1, crc2, data.length() - split));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Out-of-order blocks covering the file give the sequential checksum
+//------------------------------------------------------------------------------
+TEST(ChecksumTest, OutOfOrder)
+{
+  std::string data = MakeData(1024 * 1024 + 17);
+  Adler adler;
+  CRC32C crc;
+  std::vector<CheckSum*> checksums {&adler, &crc};
+
+  for (auto xs : checksums) {
+    std::string expected = Sequential(*xs, data);
+
+    for (unsigned int seed = 0; seed < 5; ++seed) {
+      AddShuffled(*xs, data, seed);
+      ASSERT_TRUE(xs->IsComplete(data.length()));
+      xs->Finalize();
+      ASSERT_FALSE(xs->NeedsRecalculation()) << xs->GetName();
+      ASSERT_EQ(expected, xs->GetHexChecksum()) << xs->GetName();
+      ASSERT_EQ((off_t) data.length(), xs->GetMaxOffset());
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Holes or overlapping blocks require a rescan
+//------------------------------------------------------------------------------
+TEST(ChecksumTest, HolesAndOverlaps)
+{
+  std::string data = MakeData(10000);
+  Adler adler;
+  CRC32C crc;
+  std::vector<CheckSum*> checksums {&adler, &crc};
+
+  for (auto xs : checksums) {
+    // Hole in the middle
+    xs->Reset();
+    xs->Add(data.data(), 4000, 0);
+    xs->Add(data.data() + 5000, 5000, 5000);
+    ASSERT_FALSE(xs->NeedsRecalculation());
+    ASSERT_FALSE(xs->IsComplete(data.length()));
+    xs->Finalize();
+    ASSERT_TRUE(xs->NeedsRecalculation()) << xs->GetName();
+    // Overlapping blocks
+    xs->Reset();
+    xs->Add(data.data(), 6000, 0);
+    xs->Add(data.data() + 5000, 5000, 5000);
+    ASSERT_TRUE(xs->NeedsRecalculation()) << xs->GetName();
+    ASSERT_FALSE(xs->IsComplete(data.length()));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Appending to a file with a known checksum does not need a rescan
+//------------------------------------------------------------------------------
+TEST(ChecksumTest, ResetInitAppend)
+{
+  std::string data = MakeData(300000);
+  Adler adler;
+  CRC32C crc;
+  std::vector<CheckSum*> checksums {&adler, &crc};
+
+  for (auto xs : checksums) {
+    std::string expected = Sequential(*xs, data);
+    std::string prefix = Sequential(*xs, data.substr(0, 100000));
+    xs->ResetInit(0, 100000, prefix.c_str());
+    // Append the tail out of order
+    xs->Add(data.data() + 200000, 100000, 200000);
+    xs->Add(data.data() + 100000, 100000, 100000);
+    xs->Finalize();
+    ASSERT_FALSE(xs->NeedsRecalculation()) << xs->GetName();
+    ASSERT_EQ(expected, xs->GetHexChecksum()) << xs->GetName();
+  }
+}
+
+//------------------------------------------------------------------------------
+// A missing or malformed stored checksum is never trusted for the prefix
+//------------------------------------------------------------------------------
+TEST(ChecksumTest, ResetInitInvalid)
+{
+  std::string data = MakeData(200000);
+  Adler adler;
+  CRC32C crc;
+  std::vector<CheckSum*> checksums {&adler, &crc};
+  uint32_t value = 0;
+  ASSERT_TRUE(CheckSum::ParseHexChecksum32("0a1B2c3d", value));
+  ASSERT_EQ(0x0a1b2c3du, value);
+
+  for (auto hex : {
+         "", "0", "zzzzzzzz", "1234567", "123456789", "1234 678", "-1234567"
+       }) {
+    ASSERT_FALSE(CheckSum::ParseHexChecksum32(hex, value)) << hex;
+
+    for (auto xs : checksums) {
+      xs->Reset();
+      xs->ResetInit(0, 100000, hex);
+      xs->Add(data.data() + 100000, 100000, 100000);
+      xs->Finalize();
+      ASSERT_TRUE(xs->NeedsRecalculation()) << xs->GetName() << " " << hex;
+    }
+  }
+
+  // A truncated file does not need the stored checksum
+  for (auto xs : checksums) {
+    std::string expected = Sequential(*xs, data);
+    xs->Reset();
+    xs->ResetInit(0, 0, "");
+    xs->Add(data.data(), data.length(), 0);
+    xs->Finalize();
+    ASSERT_FALSE(xs->NeedsRecalculation()) << xs->GetName();
+    ASSERT_EQ(expected, xs->GetHexChecksum()) << xs->GetName();
+  }
+}
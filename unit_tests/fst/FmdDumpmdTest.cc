@@ -0,0 +1,226 @@
+//------------------------------------------------------------------------------
+// File: FmdDumpmdTest.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "fst/FmdDbMap.hh"
+#include "proto/Fs.pb.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using eos::fst::DumpmdDecoder;
+using eos::fst::FmdDbMapHandler;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Build a dumpmd stream entry
+//------------------------------------------------------------------------------
+eos::console::FileMdDumpProto
+MakeEntry(uint64_t fid)
+{
+  eos::console::FileMdDumpProto entry;
+  entry.set_fid(fid);
+  entry.set_cid(fid / 10 + 1);
+  entry.set_ctime(1500000000 + fid);
+  entry.set_ctimens(fid % 1000000000);
+  entry.set_mtime(1600000000 + fid);
+  entry.set_mtimens((fid * 7) % 1000000000);
+  entry.set_size(fid * 4096);
+  entry.set_lid(0x00100002);
+  entry.set_uid(1000 + fid % 5);
+  entry.set_gid(2000 + fid % 3);
+
+  if (fid % 4) {
+    char xs[9];
+    snprintf(xs, sizeof(xs), "%08llx", (unsigned long long) fid * 2654435761ULL);
+    entry.set_checksum(xs);
+  }
+
+  for (uint32_t i = 0; i < fid % 3 + 1; ++i) {
+    entry.add_locations(i + 1);
+  }
+
+  if (fid % 5 == 0) {
+    entry.add_unlinkedlocations(42);
+  }
+
+  return entry;
+}
+
+//------------------------------------------------------------------------------
+// Append an entry the same way as the MGM stream display does
+//------------------------------------------------------------------------------
+void
+AppendRecord(const eos::console::FileMdDumpProto& entry, std::string& out)
+{
+  std::string raw = entry.SerializeAsString();
+  uint8_t header[5];
+  uint8_t* end = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(
+                   raw.size(), header);
+  out.append((const char*) header, end - header);
+  out += raw;
+}
+
+//------------------------------------------------------------------------------
+// Feed the output to the decoder in chunks of random size
+//------------------------------------------------------------------------------
+bool
+DecodeInChunks(const std::string& output, size_t max_entries,
+               DumpmdDecoder& decoder, std::vector<eos::fst::Fmd>& fmds)
+{
+  std::mt19937 gen(17);
+  size_t offset = 0;
+
+  while (offset < output.length()) {
+    size_t length = std::min((size_t)(1 + gen() % 1000),
+                             output.length() - offset);
+    decoder.Feed(output.data() + offset, length);
+    offset += length;
+
+    do {
+      size_t before = fmds.size();
+
+      if (!decoder.Decode(fmds, max_entries)) {
+        return false;
+      }
+
+      EXPECT_LE(fmds.size() - before, max_entries);
+
+      if (fmds.size() - before < max_entries) {
+        break;
+      }
+    } while (true);
+  }
+
+  return decoder.Finish(fmds);
+}
+}
+
+//------------------------------------------------------------------------------
+// Entries of the stream display decode to the same Fmd as DumpMgmToFmd
+//------------------------------------------------------------------------------
+TEST(FmdDumpmd, StreamRoundTrip)
+{
+  std::vector<eos::console::FileMdDumpProto> entries;
+  std::string output = EOS_DUMPMD_STREAM_TAG;
+
+  for (uint64_t fid = 1; fid <= 5000; ++fid) {
+    entries.push_back(MakeEntry(fid));
+    AppendRecord(entries.back(), output);
+  }
+
+  output.push_back('\0');
+  DumpmdDecoder decoder;
+  std::vector<eos::fst::Fmd> fmds;
+  ASSERT_TRUE(DecodeInChunks(output, 7, decoder, fmds));
+  ASSERT_EQ(entries.size(), fmds.size());
+  ASSERT_EQ(0ull, decoder.GetNumFailed());
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    eos::fst::Fmd expected;
+    eos::fst::FmdHelper::Reset(expected);
+    ASSERT_TRUE(FmdDbMapHandler::DumpMgmToFmd(entries[i], expected));
+    ASSERT_EQ(expected.SerializeAsString(), fmds[i].SerializeAsString())
+        << "fid=" << entries[i].fid();
+  }
+
+  // Check the conversion itself on a couple of entries
+  ASSERT_EQ(5ull, fmds[4].fid());
+  ASSERT_EQ(5ull * 4096, fmds[4].mgmsize());
+  ASSERT_EQ(1500000005ull, fmds[4].ctime());
+  ASSERT_EQ("1,2,3,!42,", fmds[4].locations());
+  ASSERT_EQ("none", fmds[3].mgmchecksum());
+  ASSERT_EQ(entries[4].checksum(), fmds[4].mgmchecksum());
+}
+
+//------------------------------------------------------------------------------
+// A stream display without its end record is reported as truncated
+//------------------------------------------------------------------------------
+TEST(FmdDumpmd, StreamTruncated)
+{
+  std::string output = EOS_DUMPMD_STREAM_TAG;
+
+  for (uint64_t fid = 1; fid <= 100; ++fid) {
+    AppendRecord(MakeEntry(fid), output);
+  }
+
+  {
+    DumpmdDecoder decoder;
+    std::vector<eos::fst::Fmd> fmds;
+    ASSERT_FALSE(DecodeInChunks(output, 1000, decoder, fmds));
+    ASSERT_EQ(100u, fmds.size());
+  }
+  {
+    // Cut in the middle of the last record
+    DumpmdDecoder decoder;
+    std::vector<eos::fst::Fmd> fmds;
+    ASSERT_FALSE(DecodeInChunks(output.substr(0, output.length() - 3), 1000,
+                                decoder, fmds));
+    ASSERT_EQ(99u, fmds.size());
+  }
+  {
+    // Garbage in place of a record
+    DumpmdDecoder decoder;
+    std::vector<eos::fst::Fmd> fmds;
+    std::string corrupted = EOS_DUMPMD_STREAM_TAG;
+    corrupted += std::string(16, '\xff');
+    ASSERT_FALSE(DecodeInChunks(corrupted, 1000, decoder, fmds));
+  }
+}
+
+//------------------------------------------------------------------------------
+// The env lines of older MGMs and of the classic command are still decoded
+//------------------------------------------------------------------------------
+TEST(FmdDumpmd, EnvLines)
+{
+  std::string output;
+
+  for (uint64_t fid = 1; fid <= 300; ++fid) {
+    output += "id=" + std::to_string(fid) + "&cid=3&ctime=10&ctime_ns=11&"
+              "mtime=12&mtime_ns=13&size=" + std::to_string(fid * 10) +
+              "&checksum=none&lid=1048578&uid=1&gid=2&location=1,!5,"
+              "&container=/eos/dir/\n";
+  }
+
+  // A broken line and a last one without a new line
+  output += "id=301&cid=3\n";
+  output += "id=302&cid=3&ctime=10&ctime_ns=11&mtime=12&mtime_ns=13&size=7&"
+            "checksum=none&lid=1048578&uid=1&gid=2&container=-";
+  DumpmdDecoder decoder;
+  std::vector<eos::fst::Fmd> fmds;
+  ASSERT_TRUE(DecodeInChunks(output, 13, decoder, fmds));
+  ASSERT_EQ(301u, fmds.size());
+  ASSERT_EQ(1ull, decoder.GetNumFailed());
+  ASSERT_EQ(1ull, fmds[0].fid());
+  ASSERT_EQ(100ull, fmds[9].mgmsize());
+  ASSERT_EQ("1,!5,", fmds[0].locations());
+  ASSERT_EQ(302ull, fmds.back().fid());
+  ASSERT_EQ("", fmds.back().locations());
+  // Short output without any new line
+  DumpmdDecoder short_decoder;
+  std::vector<eos::fst::Fmd> short_fmds;
+  ASSERT_TRUE(DecodeInChunks("", 10, short_decoder, short_fmds));
+  ASSERT_TRUE(short_fmds.empty());
+}
@@ -0,0 +1,263 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "fst/layout/RainKernels.hh"
+#include "fst/layout/jerasure/include/jerasure.h"
+#include "fst/layout/jerasure/include/cauchy.h"
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using eos::fst::RainKernels;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Instruction sets supported on this machine
+//------------------------------------------------------------------------------
+std::vector<RainKernels::Isa>
+GetIsas()
+{
+  std::vector<RainKernels::Isa> isas;
+
+  for (int i = RainKernels::kGeneric; i <= RainKernels::GetBestIsa(); ++i) {
+    isas.push_back((RainKernels::Isa) i);
+  }
+
+  return isas;
+}
+
+//------------------------------------------------------------------------------
+// Build some pseudo-random blocks
+//------------------------------------------------------------------------------
+std::vector<std::string>
+MakeBlocks(size_t num, size_t length, unsigned int seed)
+{
+  std::mt19937 gen(seed);
+  std::vector<std::string> blocks(num, std::string(length, '\0'));
+
+  for (auto& block : blocks) {
+    for (auto& c : block) {
+      c = (char)(gen() & 0xff);
+    }
+  }
+
+  return blocks;
+}
+
+//------------------------------------------------------------------------------
+// Cauchy Reed-Solomon code set up like in ReedSLayout
+//------------------------------------------------------------------------------
+struct CauchyCode {
+  CauchyCode(int k_, int m_, size_t width):
+    k(k_), m(m_), w(8), size(width)
+  {
+    packetsize = (int)(k * width / (k * w * sizeof(int)));
+    matrix = cauchy_good_general_coding_matrix(k, m, w);
+    bitmatrix = jerasure_matrix_to_bitmatrix(k, m, w, matrix);
+    schedule = jerasure_smart_bitmatrix_to_schedule(k, m, w, bitmatrix);
+  }
+
+  ~CauchyCode()
+  {
+    jerasure_free_schedule(schedule);
+    free(bitmatrix);
+    free(matrix);
+  }
+
+  int k, m, w, packetsize;
+  size_t size;
+  int* matrix;
+  int* bitmatrix;
+  int** schedule;
+};
+
+//------------------------------------------------------------------------------
+// Get pointers to the data and coding blocks
+//------------------------------------------------------------------------------
+void
+GetPointers(std::vector<std::string>& blocks, int k, std::vector<char*>& data,
+            std::vector<char*>& coding)
+{
+  data.clear();
+  coding.clear();
+
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    ((int) i < k ? data : coding).push_back(&blocks[i][0]);
+  }
+}
+}
+
+//------------------------------------------------------------------------------
+// XOR kernels against a byte by byte XOR, including unaligned tails
+//------------------------------------------------------------------------------
+TEST(RainKernelsTest, XorMulti)
+{
+  RainKernels::Isa saved = RainKernels::GetIsa();
+
+  for (auto isa : GetIsas()) {
+    ASSERT_TRUE(RainKernels::SetIsa(isa));
+
+    for (size_t length : {
+           0, 1, 63, 64, 129, 4096, 65536 + 17
+         }) {
+      for (size_t nsrcs : {
+             0, 1, 2, 5, 11
+           }) {
+        std::vector<std::string> blocks = MakeBlocks(nsrcs + 1, length, 7);
+        std::vector<const char*> srcs;
+        std::string expected = blocks[nsrcs];
+        std::string expected_acc = blocks[nsrcs];
+
+        for (size_t s = 0; s < nsrcs; ++s) {
+          srcs.push_back(blocks[s].data());
+        }
+
+        for (size_t i = 0; i < length; ++i) {
+          expected[i] = 0;
+
+          for (size_t s = 0; s < nsrcs; ++s) {
+            expected[i] ^= blocks[s][i];
+            expected_acc[i] ^= blocks[s][i];
+          }
+        }
+
+        std::string result = blocks[nsrcs];
+        RainKernels::XorMulti(&result[0], srcs.data(), nsrcs, length, false);
+        ASSERT_EQ(expected, result) << RainKernels::GetIsaName(isa);
+        result = blocks[nsrcs];
+        RainKernels::XorMulti(&result[0], srcs.data(), nsrcs, length, true);
+        ASSERT_EQ(expected_acc, result) << RainKernels::GetIsaName(isa);
+
+        if (nsrcs == 2) {
+          // In place XOR on misaligned pointers
+          std::string in_place = blocks[0];
+          RainKernels::Xor(&in_place[0], blocks[1].data(), &in_place[0], length);
+          ASSERT_EQ(expected, in_place) << RainKernels::GetIsaName(isa);
+
+          if (length > 1) {
+            std::string shifted = blocks[1].substr(1);
+            RainKernels::Xor(blocks[0].data() + 1, blocks[1].data() + 1,
+                             &shifted[0], length - 1);
+            ASSERT_EQ(expected.substr(1), shifted);
+          }
+        }
+      }
+    }
+  }
+
+  RainKernels::SetIsa(saved);
+}
+
+//------------------------------------------------------------------------------
+// Encoding gives the same parity as jerasure_schedule_encode
+//------------------------------------------------------------------------------
+TEST(RainKernelsTest, ScheduleEncode)
+{
+  RainKernels::Isa saved = RainKernels::GetIsa();
+  std::vector<std::pair<int, int>> codes {{4, 2}, {8, 2}, {5, 3}, {9, 3}};
+
+  for (const auto& km : codes) {
+    for (size_t width : {
+           64 * 1024, 1024 * 1024
+         }) {
+      CauchyCode code(km.first, km.second, width);
+      std::vector<std::string> orig = MakeBlocks(code.k + code.m, width, 42);
+      std::vector<std::string> ref = orig;
+      std::vector<char*> data, coding;
+      GetPointers(ref, code.k, data, coding);
+      jerasure_schedule_encode(code.k, code.m, code.w, code.schedule,
+                               data.data(), coding.data(), width,
+                               code.packetsize);
+
+      for (auto isa : GetIsas()) {
+        ASSERT_TRUE(RainKernels::SetIsa(isa));
+        std::vector<std::string> blocks = orig;
+        GetPointers(blocks, code.k, data, coding);
+        RainKernels::ScheduleEncode(code.k, code.m, code.w, code.schedule,
+                                    data.data(), coding.data(), width,
+                                    code.packetsize);
+
+        for (int i = code.k; i < code.k + code.m; ++i) {
+          ASSERT_TRUE(ref[i] == blocks[i]) << "k=" << code.k << " m=" << code.m
+                                           << " isa=" << RainKernels::GetIsaName(isa);
+        }
+      }
+    }
+  }
+
+  RainKernels::SetIsa(saved);
+}
+
+//------------------------------------------------------------------------------
+// Decoding with the kernels recovers any combination of up to m erasures
+//------------------------------------------------------------------------------
+TEST(RainKernelsTest, ScheduleDecode)
+{
+  RainKernels::Isa saved = RainKernels::GetIsa();
+  std::vector<std::pair<int, int>> codes {{4, 2}, {5, 3}};
+  const size_t width = 64 * 1024;
+
+  for (const auto& km : codes) {
+    CauchyCode code(km.first, km.second, width);
+    std::vector<std::string> ref = MakeBlocks(code.k + code.m, width, 3);
+    std::vector<char*> data, coding;
+    GetPointers(ref, code.k, data, coding);
+    jerasure_schedule_encode(code.k, code.m, code.w, code.schedule,
+                             data.data(), coding.data(), width,
+                             code.packetsize);
+    int n = code.k + code.m;
+
+    for (auto isa : GetIsas()) {
+      ASSERT_TRUE(RainKernels::SetIsa(isa));
+
+      // All subsets of at most m erased blocks
+      for (int mask = 1; mask < (1 << n); ++mask) {
+        if (__builtin_popcount(mask) > code.m) {
+          continue;
+        }
+
+        std::vector<std::string> blocks = ref;
+        std::vector<int> erasures;
+
+        for (int i = 0; i < n; ++i) {
+          if (mask & (1 << i)) {
+            erasures.push_back(i);
+            blocks[i].assign(width, '\0');
+          }
+        }
+
+        erasures.push_back(-1);
+        GetPointers(blocks, code.k, data, coding);
+        ASSERT_EQ(0, jerasure_schedule_decode_lazy_ops(
+                    code.k, code.m, code.w, code.bitmatrix, erasures.data(),
+                    data.data(), coding.data(), width, code.packetsize, 1,
+                    RainKernels::DoScheduledOperations));
+
+        for (int i = 0; i < n; ++i) {
+          ASSERT_TRUE(ref[i] == blocks[i]) << "mask=" << mask << " isa="
+                                           << RainKernels::GetIsaName(isa);
+        }
+      }
+    }
+  }
+
+  RainKernels::SetIsa(saved);
+}
@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------
+// File: RainParityPipelineTest.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "common/LayoutId.hh"
+#include "fst/layout/RaidDpLayout.hh"
+#include "fst/layout/ReedSLayout.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using eos::common::LayoutId;
+using eos::fst::RaidDpLayout;
+using eos::fst::RaidMetaLayout;
+using eos::fst::ReedSLayout;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Write the data through a RAIN layout with the given parity pipeline depth
+// and return the content of all the stripe files, parity stripes included
+//------------------------------------------------------------------------------
+std::vector<std::string>
+WriteStripes(unsigned long lid, unsigned int depth, const std::string& data,
+             const std::string& dir)
+{
+  setenv("EOS_FST_RAIN_PARITY_DEPTH", std::to_string(depth).c_str(), 1);
+  std::vector<std::string> urls;
+
+  for (unsigned int i = 0; i <= LayoutId::GetStripeNumber(lid); ++i) {
+    urls.push_back(dir + "/stripe" + std::to_string(i));
+  }
+
+  std::unique_ptr<RaidMetaLayout> layout;
+
+  if (LayoutId::GetLayoutType(lid) == LayoutId::kRaidDP) {
+    layout.reset(new RaidDpLayout(NULL, lid, NULL, NULL, "/eos-rain-test", 0,
+                                  true));
+  } else {
+    layout.reset(new ReedSLayout(NULL, lid, NULL, NULL, "/eos-rain-test", 0,
+                                 true));
+  }
+
+  EXPECT_EQ(0, layout->OpenPio(urls, O_CREAT | O_RDWR | O_TRUNC, 0600));
+  // Writes of varying size not aligned to the block or group size
+  std::mt19937 gen(7);
+  size_t offset = 0;
+
+  while (offset < data.length()) {
+    size_t length = std::min((size_t)(1 + gen() % 300000),
+                             data.length() - offset);
+    EXPECT_EQ((int64_t) length, layout->Write(offset, data.data() + offset,
+              length));
+    offset += length;
+  }
+
+  EXPECT_EQ(0, layout->Close());
+  layout.reset();
+  std::vector<std::string> stripes;
+
+  for (const auto& url : urls) {
+    std::ifstream file(url, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    stripes.push_back(content.str());
+    (void) unlink(url.c_str());
+  }
+
+  return stripes;
+}
+}
+
+//------------------------------------------------------------------------------
+// Pipelined parity computation gives exactly the same stripe and parity
+// bytes as the synchronous one
+//------------------------------------------------------------------------------
+TEST(RainParityPipeline, SameAsSynchronous)
+{
+  char tmpl[] = "/tmp/eos-rain-pipeline.XXXXXX";
+  ASSERT_TRUE(mkdtemp(tmpl) != nullptr);
+  std::string dir = tmpl;
+  std::mt19937 gen(42);
+  std::string data(5 * 1024 * 1024 + 12345, '\0');
+
+  for (auto& c : data) {
+    c = (char)(gen() & 0xff);
+  }
+
+  std::vector<unsigned long> lids {
+    LayoutId::GetId(LayoutId::kRaid6, LayoutId::kNone, 6, LayoutId::k64k),
+    LayoutId::GetId(LayoutId::kArchive, LayoutId::kNone, 8, LayoutId::k64k),
+    LayoutId::GetId(LayoutId::kRaidDP, LayoutId::kNone, 6, LayoutId::k64k)
+  };
+
+  for (auto lid : lids) {
+    std::vector<std::string> sync_stripes = WriteStripes(lid, 0, data, dir);
+    ASSERT_EQ(LayoutId::GetStripeNumber(lid) + 1, sync_stripes.size());
+
+    for (unsigned int depth : {
+           2, 4
+         }) {
+      std::vector<std::string> pipe_stripes = WriteStripes(lid, depth, data, dir);
+      ASSERT_EQ(sync_stripes.size(), pipe_stripes.size());
+
+      for (size_t i = 0; i < sync_stripes.size(); ++i) {
+        ASSERT_FALSE(sync_stripes[i].empty());
+        ASSERT_TRUE(sync_stripes[i] == pipe_stripes[i])
+            << "layout=" << LayoutId::GetLayoutTypeString(lid)
+            << " depth=" << depth << " stripe=" << i;
+      }
+    }
+  }
+
+  unsetenv("EOS_FST_RAIN_PARITY_DEPTH");
+  (void) rmdir(dir.c_str());
+}
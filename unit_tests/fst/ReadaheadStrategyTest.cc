@@ -0,0 +1,155 @@
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "fst/io/xrd/ReadaheadStrategy.hh"
+#include <random>
+#include <set>
+
+using eos::fst::ReadaheadStrategy;
+
+namespace
+{
+const uint64_t sBlock = 1024 * 1024;
+}
+
+//------------------------------------------------------------------------------
+// Sequential reads prefetch the following blocks, each one only once
+//------------------------------------------------------------------------------
+TEST(ReadaheadStrategyTest, Sequential)
+{
+  ReadaheadStrategy ra(sBlock, 2, 8, 4);
+  std::vector<ReadaheadStrategy::Prefetch> ranges;
+  const uint32_t len = 64 * 1024;
+  ra.Read(0, len, ranges);
+  ASSERT_TRUE(ranges.empty());
+  ra.Read(len, len, ranges);
+  ASSERT_EQ(2u, ranges.size());
+  ASSERT_EQ(2 * len, ranges[0].mOffset);
+  ASSERT_EQ(sBlock, ranges[0].mLength);
+  ASSERT_EQ(2 * len + sBlock, ranges[1].mOffset);
+  uint64_t next = ranges.back().mOffset + ranges.back().mLength;
+
+  for (uint64_t off = 2 * len; off < 8 * sBlock; off += len) {
+    ranges.clear();
+    ra.Read(off, len, ranges);
+
+    for (const auto& range : ranges) {
+      ASSERT_EQ(next, range.mOffset);
+      next += range.mLength;
+    }
+
+    // Never more than the window ahead of the reads
+    ASSERT_LE(next, off + len + 3 * sBlock);
+  }
+
+  ASSERT_EQ(1u, ra.GetStats().mStreams);
+}
+
+//------------------------------------------------------------------------------
+// Strided reads prefetch the next records once the stride is confirmed
+//------------------------------------------------------------------------------
+TEST(ReadaheadStrategyTest, Strided)
+{
+  ReadaheadStrategy ra(sBlock, 2, 8, 4);
+  std::vector<ReadaheadStrategy::Prefetch> ranges;
+  const uint64_t stride = 3 * sBlock;
+  const uint32_t len = 4096;
+  ra.Read(100, len, ranges);
+  ra.Read(100 + stride, len, ranges);
+  ASSERT_TRUE(ranges.empty());
+  ra.Read(100 + 2 * stride, len, ranges);
+  ASSERT_EQ(2u, ranges.size());
+  ASSERT_EQ(100 + 3 * stride, ranges[0].mOffset);
+  ASSERT_EQ(len, ranges[0].mLength);
+  ASSERT_EQ(100 + 4 * stride, ranges[1].mOffset);
+  ranges.clear();
+  ra.Read(100 + 3 * stride, len, ranges);
+  ASSERT_EQ(1u, ranges.size());
+  ASSERT_EQ(100 + 5 * stride, ranges[0].mOffset);
+}
+
+//------------------------------------------------------------------------------
+// Interleaved sequential streams are tracked separately
+//------------------------------------------------------------------------------
+TEST(ReadaheadStrategyTest, Interleaved)
+{
+  ReadaheadStrategy ra(sBlock, 1, 8, 4);
+  std::vector<ReadaheadStrategy::Prefetch> ranges;
+  const uint32_t len = 256 * 1024;
+  const uint64_t bases[3] = {0, 100 * sBlock, 500 * sBlock};
+  std::set<uint64_t> streams;
+
+  for (uint64_t i = 0; i < 16; ++i) {
+    for (uint64_t base : bases) {
+      ranges.clear();
+      ra.Read(base + i * len, len, ranges);
+
+      for (const auto& range : ranges) {
+        ASSERT_GE(range.mOffset, base + (i + 1) * len);
+        ASSERT_LE(range.mOffset, base + (i + 1) * len + sBlock);
+        streams.insert(range.mStream);
+      }
+    }
+  }
+
+  ASSERT_EQ(3u, streams.size());
+  ASSERT_EQ(3u, ra.GetStats().mStreams);
+}
+
+//------------------------------------------------------------------------------
+// The window grows when the prefetched data is used and shrinks when it is
+// wasted, random reads do not trigger any prefetching
+//------------------------------------------------------------------------------
+TEST(ReadaheadStrategyTest, AdaptiveWindow)
+{
+  ReadaheadStrategy ra(sBlock, 2, 8, 4);
+  std::vector<ReadaheadStrategy::Prefetch> ranges;
+  ra.Read(0, sBlock, ranges);
+  ra.Read(sBlock, sBlock, ranges);
+  ASSERT_FALSE(ranges.empty());
+  uint64_t id = ranges.front().mStream;
+  ASSERT_EQ(2u, ra.GetWindow(id));
+  ra.Hit(id, 2 * sBlock);
+  ASSERT_EQ(4u, ra.GetWindow(id));
+  ra.Hit(id, 4 * sBlock);
+  ra.Hit(id, 8 * sBlock);
+  ra.Hit(id, 8 * sBlock);
+  ASSERT_EQ(8u, ra.GetWindow(id));
+  ra.Waste(id, sBlock);
+  ASSERT_EQ(4u, ra.GetWindow(id));
+  ra.Waste(id, sBlock);
+  ra.Waste(id, sBlock);
+  ra.Waste(id, sBlock);
+  ASSERT_EQ(1u, ra.GetWindow(id));
+  ASSERT_EQ(4u, ra.GetStats().mWastes);
+  ASSERT_EQ(22 * sBlock, ra.GetStats().mHitBytes);
+  // Random reads over a large file
+  ReadaheadStrategy random(sBlock, 2, 8, 4);
+  std::mt19937_64 gen(5);
+  ranges.clear();
+
+  for (int i = 0; i < 1000; ++i) {
+    random.Read((gen() % 100000) * sBlock, 4096, ranges);
+  }
+
+  ASSERT_TRUE(ranges.empty());
+  random.Miss(1000 * 4096);
+  ASSERT_EQ(0.0, random.GetStats().GetHitRate());
+  ASSERT_EQ(1000u, random.GetStats().mReads);
+}
@@ -0,0 +1,225 @@
+//------------------------------------------------------------------------------
+// File: FuseServerCapsTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/FuseServer.hh"
+#include <map>
+#include <string>
+
+using eos::mgm::FuseServer;
+
+namespace
+{
+//! Start of the test clock, far from the origin of the expiry wheel
+const uint64_t sNow = 1500000000;
+
+//------------------------------------------------------------------------------
+// Store a cap valid until the given time
+//------------------------------------------------------------------------------
+void
+StoreCap(FuseServer::Caps& caps, const std::string& authid, uint64_t ino,
+         const std::string& clientid, uint64_t vtime)
+{
+  eos::fusex::cap cap;
+  cap.set_id(ino);
+  cap.set_authid(authid);
+  cap.set_clientid(clientid);
+  cap.set_clientuuid("uuid-" + clientid);
+  cap.set_vtime(vtime);
+  eos::common::Mapping::VirtualIdentity vid;
+  caps.Store(cap, &vid);
+}
+
+//------------------------------------------------------------------------------
+//! Caps giving access to the single views to replay interleavings
+//------------------------------------------------------------------------------
+class CapsProbe : public FuseServer::Caps
+{
+public:
+  using FuseServer::Caps::InodeCaps;
+  using FuseServer::Caps::Remove;
+
+  //----------------------------------------------------------------------------
+  //! Put a cap into the authid view only
+  //----------------------------------------------------------------------------
+  void SetInAuthidView(const shared_cap& cap)
+  {
+    CapShard& shard = GetCapShard(cap->authid());
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    shard.mCaps[cap->authid()] = cap;
+  }
+};
+}
+
+//------------------------------------------------------------------------------
+// A cap is visible in all views until it expires
+//------------------------------------------------------------------------------
+TEST(FuseServerCaps, StoreExpire)
+{
+  FuseServer::Caps caps;
+  // start the wheel
+  ASSERT_EQ(0u, caps.Expire(sNow));
+  StoreCap(caps, "a1", 10, "c1", sNow + 100);
+  StoreCap(caps, "a2", 11, "c1", sNow + 200);
+  ASSERT_EQ(2u, caps.Size());
+  ASSERT_EQ(10ull, caps.Get("a1")->id());
+  ASSERT_TRUE(caps.HasClientInoCap("c1", 10));
+  ASSERT_TRUE(caps.HasClientInoCap("c1", 11));
+  ASSERT_FALSE(caps.HasClientInoCap("c2", 10));
+  // still in the grace period
+  ASSERT_EQ(0u, caps.Expire(sNow + 105));
+  ASSERT_EQ(2u, caps.Size());
+  ASSERT_EQ(1u, caps.Expire(sNow + 110));
+  ASSERT_EQ(1u, caps.Size());
+  ASSERT_EQ(0ull, caps.Get("a1")->id());
+  ASSERT_FALSE(caps.HasClientInoCap("c1", 10));
+  ASSERT_TRUE(caps.HasClientInoCap("c1", 11));
+  // the last expiry empties all the views
+  ASSERT_EQ(1u, caps.Expire(sNow + 1000));
+  ASSERT_EQ(0u, caps.Size());
+  ASSERT_FALSE(caps.HasClientInoCap("c1", 11));
+  std::map<std::string, size_t> counts;
+  caps.CountByClientUuid(counts);
+  ASSERT_TRUE(counts.empty());
+}
+
+//------------------------------------------------------------------------------
+// The client keeps its inode as long as one of its caps points to it
+//------------------------------------------------------------------------------
+TEST(FuseServerCaps, ClientInodeRefCount)
+{
+  FuseServer::Caps caps;
+  ASSERT_EQ(0u, caps.Expire(sNow));
+  StoreCap(caps, "a1", 10, "c1", sNow + 100);
+  StoreCap(caps, "a2", 10, "c1", sNow + 200);
+  StoreCap(caps, "a3", 10, "c2", sNow + 100);
+  ASSERT_EQ(2u, caps.Expire(sNow + 110));
+  ASSERT_TRUE(caps.HasClientInoCap("c1", 10));
+  ASSERT_FALSE(caps.HasClientInoCap("c2", 10));
+  ASSERT_EQ(1u, caps.Expire(sNow + 210));
+  ASSERT_FALSE(caps.HasClientInoCap("c1", 10));
+}
+
+//------------------------------------------------------------------------------
+// A cap stored again under the same authid replaces the previous one, the
+// expiry entry of the previous one doesn't remove it
+//------------------------------------------------------------------------------
+TEST(FuseServerCaps, SameAuthidRestore)
+{
+  FuseServer::Caps caps;
+  ASSERT_EQ(0u, caps.Expire(sNow));
+  StoreCap(caps, "a1", 10, "c1", sNow + 10);
+  StoreCap(caps, "a1", 10, "c1", sNow + 500);
+  ASSERT_EQ(1u, caps.Size());
+  ASSERT_EQ(0u, caps.Expire(sNow + 100));
+  ASSERT_EQ(sNow + 500, caps.Get("a1")->vtime());
+  ASSERT_TRUE(caps.HasClientInoCap("c1", 10));
+  // Restored on another inode the client view follows
+  StoreCap(caps, "a1", 12, "c1", sNow + 600);
+  ASSERT_FALSE(caps.HasClientInoCap("c1", 10));
+  ASSERT_TRUE(caps.HasClientInoCap("c1", 12));
+  ASSERT_EQ(0u, caps.Expire(sNow + 520));
+  ASSERT_EQ(1u, caps.Expire(sNow + 610));
+  ASSERT_EQ(0u, caps.Size());
+  ASSERT_FALSE(caps.HasClientInoCap("c1", 12));
+}
+
+//------------------------------------------------------------------------------
+// An expiry racing with a renewal under the same authid leaves the inode view
+// of the renewed cap alone: the old cap passed the authid view check before
+// the renewal stored the new one
+//------------------------------------------------------------------------------
+TEST(FuseServerCaps, RemoveRacingRenewal)
+{
+  CapsProbe caps;
+  ASSERT_EQ(0u, caps.Expire(sNow));
+  StoreCap(caps, "a1", 10, "c1", sNow + 10);
+  FuseServer::Caps::shared_cap old_cap = caps.Get("a1");
+  StoreCap(caps, "a1", 10, "c1", sNow + 500);
+  FuseServer::Caps::shared_cap new_cap = caps.Get("a1");
+  ASSERT_NE(old_cap, new_cap);
+  // replay the expiry of the old cap as seen before the renewal
+  caps.SetInAuthidView(old_cap);
+  ASSERT_TRUE(caps.Remove(old_cap));
+  caps.SetInAuthidView(new_cap);
+  std::vector<FuseServer::Caps::shared_cap> inode_caps = caps.InodeCaps(10);
+  ASSERT_EQ(1u, inode_caps.size());
+  ASSERT_EQ(new_cap, inode_caps[0]);
+  ASSERT_TRUE(caps.HasClientInoCap("c1", 10));
+  // the regular expiry of the new cap empties the inode view
+  ASSERT_EQ(1u, caps.Expire(sNow + 600));
+  ASSERT_TRUE(caps.InodeCaps(10).empty());
+}
+
+//------------------------------------------------------------------------------
+// Deleting an inode and dropping a client remove the caps from all views and
+// the expiry doesn't count them again
+//------------------------------------------------------------------------------
+TEST(FuseServerCaps, DeleteAndDrop)
+{
+  FuseServer::Caps caps;
+  ASSERT_EQ(0u, caps.Expire(sNow));
+  StoreCap(caps, "a1", 10, "c1", sNow + 100);
+  StoreCap(caps, "a2", 10, "c2", sNow + 100);
+  StoreCap(caps, "a3", 11, "c2", sNow + 100);
+  ASSERT_EQ(0, caps.Delete(10));
+  ASSERT_EQ(ENOENT, caps.Delete(10));
+  ASSERT_EQ(1u, caps.Size());
+  ASSERT_FALSE(caps.HasClientInoCap("c1", 10));
+  ASSERT_FALSE(caps.HasClientInoCap("c2", 10));
+  ASSERT_TRUE(caps.HasClientInoCap("c2", 11));
+  std::vector<FuseServer::Caps::shared_cap> dropped =
+    caps.DropClientUuid("uuid-c2");
+  ASSERT_EQ(1u, dropped.size());
+  ASSERT_EQ("a3", dropped[0]->authid());
+  ASSERT_EQ(0u, caps.Size());
+  ASSERT_FALSE(caps.HasClientInoCap("c2", 11));
+  ASSERT_EQ(0u, caps.Expire(sNow + 1000));
+}
+
+//------------------------------------------------------------------------------
+// Caps valid for longer than one turn of the wheel or extended in place are
+// scheduled again until their lifetime is over
+//------------------------------------------------------------------------------
+TEST(FuseServerCaps, WheelWrapAround)
+{
+  FuseServer::Caps caps;
+  ASSERT_EQ(0u, caps.Expire(sNow));
+  StoreCap(caps, "long", 10, "c1", sNow + 10000);
+  StoreCap(caps, "extended", 11, "c1", sNow + 20);
+  caps.Get("extended")->set_vtime(sNow + 5000);
+  size_t nexpired = 0;
+
+  for (uint64_t now = sNow + 1; now < sNow + 5010; ++now) {
+    nexpired += caps.Expire(now);
+  }
+
+  ASSERT_EQ(0u, nexpired);
+  ASSERT_EQ(2u, caps.Size());
+  ASSERT_EQ(1u, caps.Expire(sNow + 5010));
+  ASSERT_EQ(0ull, caps.Get("extended")->id());
+  ASSERT_EQ(0u, caps.Expire(sNow + 9000));
+  ASSERT_EQ(1u, caps.Size());
+  // A jump of more than one turn of the wheel still finds the cap
+  ASSERT_EQ(1u, caps.Expire(sNow + 20000));
+  ASSERT_EQ(0u, caps.Size());
+}
@@ -0,0 +1,264 @@
+//------------------------------------------------------------------------------
+// File: GeoTreeEngineTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/GeoTreeEngine.hh"
+#include "mgm/FsView.hh"
+#include <set>
+#include <string>
+#include <vector>
+
+using eos::common::FileSystem;
+using eos::mgm::FsGroup;
+using eos::mgm::GeoTreeEngine;
+
+namespace
+{
+const unsigned long long sGB = 1024ull * 1024 * 1024;
+//! File systems with little free space
+const std::set<FileSystem::fsid_t> sSmallFs = {5, 6};
+
+//------------------------------------------------------------------------------
+// Snapshot of a booted, online and writable file system
+//------------------------------------------------------------------------------
+FileSystem::fs_snapshot_t
+MakeFs(FileSystem::fsid_t id, const std::string& geotag,
+       const std::string& host, unsigned long long free_bytes)
+{
+  FileSystem::fs_snapshot_t fsn;
+  fsn.mId = id;
+  fsn.mGroup = "default.0";
+  fsn.mGeoTag = geotag;
+  fsn.mHost = host;
+  fsn.mHostPort = host + ":1095";
+  fsn.mFileStickyProxyDepth = -1;
+  fsn.mStatus = FileSystem::kBooted;
+  fsn.mConfigStatus = FileSystem::kRW;
+  fsn.mActiveStatus = FileSystem::kOnline;
+  fsn.mErrCode = 0;
+  fsn.mHeadRoom = 0;
+  fsn.mDiskUtilization = 0.1;
+  fsn.mNetEthRateMiB = 1250;
+  fsn.mDiskFilled = 10;
+  fsn.mDiskBsize = 4096;
+  fsn.mDiskBfree = free_bytes / 4096;
+  return fsn;
+}
+
+//------------------------------------------------------------------------------
+//! Engine with one group of 12 file systems on 3 racks of 2 hosts. The file
+//! systems in sSmallFs have 16 MB free, the other ones 1 TB.
+//------------------------------------------------------------------------------
+struct TestEngine {
+  TestEngine(): mGroup("default.0")
+  {
+    for (FileSystem::fsid_t id = 1; id <= 12; ++id) {
+      unsigned int rack = (id - 1) / 4 + 1;
+      std::string host = "host" + std::to_string((id - 1) / 2 + 1);
+      unsigned long long free_bytes = sSmallFs.count(id) ? (16ull << 20) :
+                                      1024 * sGB;
+      EXPECT_TRUE(mEngine.insertFsIntoGroup(MakeFs(id, "site::rack" +
+                  std::to_string(rack), host, free_bytes), &mGroup));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  //! Place the files one by one with the single file API
+  //----------------------------------------------------------------------------
+  size_t PlaceOneByOne(std::vector<GeoTreeEngine::BatchPlacement>& batch,
+                       GeoTreeEngine::SchedType type)
+  {
+    size_t nplaced = 0;
+
+    for (auto& plct : batch) {
+      plct.success = mEngine.placeNewReplicasOneGroup(&mGroup, plct.nNewReplicas,
+                     &plct.newReplicas, 0, NULL, NULL, type, &plct.existingReplicas,
+                     &plct.fsidsgeotags, plct.bookingSize, plct.startFromGeoTag, "",
+                     plct.nCollocatedReplicas, &plct.excludeFs, &plct.excludeGeoTags);
+
+      if (plct.success) {
+        nplaced++;
+      }
+    }
+
+    return nplaced;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Place the files with the batch API
+  //----------------------------------------------------------------------------
+  size_t PlaceBatch(std::vector<GeoTreeEngine::BatchPlacement>& batch,
+                    GeoTreeEngine::SchedType type)
+  {
+    return mEngine.placeNewReplicasOneGroupBatch(&mGroup, batch, type);
+  }
+
+  FsGroup mGroup;
+  GeoTreeEngine mEngine;
+};
+
+//------------------------------------------------------------------------------
+// Check the replicas of a successful placement: count, no duplicate, no
+// preexisting or excluded replica
+//------------------------------------------------------------------------------
+void
+CheckReplicas(const GeoTreeEngine::BatchPlacement& plct)
+{
+  ASSERT_TRUE(plct.success);
+  ASSERT_EQ(plct.nNewReplicas, plct.newReplicas.size());
+  std::set<FileSystem::fsid_t> fsids(plct.newReplicas.begin(),
+                                     plct.newReplicas.end());
+  ASSERT_EQ(plct.newReplicas.size(), fsids.size());
+
+  for (auto fsid : plct.existingReplicas) {
+    ASSERT_EQ(0u, fsids.count(fsid));
+  }
+
+  for (auto fsid : plct.excludeFs) {
+    ASSERT_EQ(0u, fsids.count(fsid));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Files of a batch, every third one has a preexisting replica and every fifth
+// one an excluded file system
+//------------------------------------------------------------------------------
+std::vector<GeoTreeEngine::BatchPlacement>
+MakeBatch(size_t nfiles, size_t nreplicas)
+{
+  std::vector<GeoTreeEngine::BatchPlacement> batch;
+
+  for (size_t i = 0; i < nfiles; ++i) {
+    batch.emplace_back(nreplicas);
+
+    if (i % 3 == 0) {
+      FileSystem::fsid_t fsid = i % 12 + 1;
+      batch.back().existingReplicas.push_back(fsid);
+      batch.back().fsidsgeotags.push_back("site::rack" +
+                                          std::to_string((fsid - 1) / 4 + 1));
+    }
+
+    if (i % 5 == 0) {
+      batch.back().excludeFs.push_back((i + 7) % 12 + 1);
+    }
+  }
+
+  return batch;
+}
+}
+
+//------------------------------------------------------------------------------
+// The batch places the same number of replicas as a sequence of single file
+// placements
+//------------------------------------------------------------------------------
+TEST(GeoTreeEngine, BatchSameReplicaCount)
+{
+  // more files than one slice of the batch
+  std::vector<GeoTreeEngine::BatchPlacement> single = MakeBatch(150, 2);
+  std::vector<GeoTreeEngine::BatchPlacement> batch = MakeBatch(150, 2);
+  // separate engines, the penalties of one path don't affect the other one
+  TestEngine single_engine, batch_engine;
+  size_t nsingle = single_engine.PlaceOneByOne(single, GeoTreeEngine::regularRW);
+  ASSERT_EQ(single.size(), nsingle);
+  ASSERT_EQ(nsingle, batch_engine.PlaceBatch(batch, GeoTreeEngine::regularRW));
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    CheckReplicas(single[i]);
+    CheckReplicas(batch[i]);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Both paths never place a replica on a file system without enough space for
+// the booking, also with mixed booking sizes within one batch
+//------------------------------------------------------------------------------
+TEST(GeoTreeEngine, BatchHonoursBooking)
+{
+  std::vector<GeoTreeEngine::BatchPlacement> batch;
+
+  for (size_t i = 0; i < 200; ++i) {
+    batch.emplace_back(2, (i % 2) ? sGB : 0);
+  }
+
+  // one file which doesn't fit anywhere
+  batch.emplace_back(1, 2048 * sGB);
+  std::vector<GeoTreeEngine::BatchPlacement> single = batch;
+  TestEngine single_engine, batch_engine;
+  ASSERT_EQ(batch.size() - 1, single_engine.PlaceOneByOne(single,
+            GeoTreeEngine::regularRW));
+  ASSERT_EQ(batch.size() - 1, batch_engine.PlaceBatch(batch,
+            GeoTreeEngine::regularRW));
+  ASSERT_FALSE(single.back().success);
+  ASSERT_FALSE(batch.back().success);
+  ASSERT_TRUE(batch.back().newReplicas.empty());
+  size_t nsmall = 0;
+
+  for (size_t i = 0; i + 1 < batch.size(); ++i) {
+    CheckReplicas(single[i]);
+    CheckReplicas(batch[i]);
+
+    for (auto plcts : {
+           &single[i], &batch[i]
+         }) {
+      for (auto fsid : plcts->newReplicas) {
+        if (sSmallFs.count(fsid)) {
+          ASSERT_EQ(0ull, plcts->bookingSize) << "fsid=" << fsid;
+          nsmall++;
+        }
+      }
+    }
+  }
+
+  // without booking the small file systems are used as well
+  ASSERT_NE(0u, nsmall);
+}
+
+//------------------------------------------------------------------------------
+// Draining placements with excluded geotags, as done by the drain, stay out of
+// the excluded branches
+//------------------------------------------------------------------------------
+TEST(GeoTreeEngine, BatchDrainExcludeGeoTags)
+{
+  std::vector<GeoTreeEngine::BatchPlacement> batch;
+
+  for (size_t i = 0; i < 100; ++i) {
+    batch.emplace_back(1, sGB);
+    batch.back().existingReplicas.push_back(1);
+    batch.back().fsidsgeotags.push_back("site::rack1");
+    batch.back().excludeGeoTags = batch.back().fsidsgeotags;
+  }
+
+  std::vector<GeoTreeEngine::BatchPlacement> single = batch;
+  TestEngine single_engine, batch_engine;
+  ASSERT_EQ(single.size(), single_engine.PlaceOneByOne(single,
+            GeoTreeEngine::draining));
+  ASSERT_EQ(batch.size(), batch_engine.PlaceBatch(batch,
+            GeoTreeEngine::draining));
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    CheckReplicas(single[i]);
+    CheckReplicas(batch[i]);
+    // rack1 holds the file systems 1 to 4
+    ASSERT_GT(single[i].newReplicas[0], 4u);
+    ASSERT_GT(batch[i].newReplicas[0], 4u);
+  }
+}
@@ -0,0 +1,116 @@
+//------------------------------------------------------------------------------
+// File: StallRatesTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mgm/StallRates.hh"
+
+using namespace eos::mgm;
+
+TEST(StallRates, UserRule)
+{
+  StallRates rates;
+  std::string comment;
+  StallRates::Clock::time_point now = StallRates::Clock::now();
+  ASSERT_FALSE(rates.Enabled());
+  rates.Compile({{"rate:user:1234:Stat", "100"}, {"*", "60"}},
+                {{"rate:user:1234:Stat", "too many stats"}});
+  ASSERT_TRUE(rates.Enabled());
+  // the bucket holds the tolerated rate for the whole period
+  rates.Consume("Stat", 1234, 99, 665, now);
+  ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+  // other counters and users are not affected
+  rates.Consume("OpenRead", 1234, 99, 10000, now);
+  rates.Consume("Stat", 4321, 99, 10000, now);
+  ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+  ASSERT_FALSE(rates.IsLimited(4321, 99, comment, now));
+  rates.Consume("Stat", 1234, 99, 1, now);
+  ASSERT_TRUE(rates.IsLimited(1234, 99, comment, now));
+  ASSERT_EQ("too many stats", comment);
+  ASSERT_FALSE(rates.IsLimited(4321, 99, comment, now));
+  // the hold expires after the period, meanwhile the bucket refilled
+  now += std::chrono::seconds(StallRates::sPeriod);
+  ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+  rates.Consume("Stat", 1234, 99, 600, now);
+  ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+  // a sustained rate below the tolerance is never limited
+  for (int i = 0; i < 100; ++i) {
+    now += std::chrono::seconds(1);
+    rates.Consume("Stat", 1234, 99, 130, now);
+    ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+  }
+
+  // dropping the rule lifts the hold
+  rates.Consume("Stat", 1234, 99, 10000, now);
+  ASSERT_TRUE(rates.IsLimited(1234, 99, comment, now));
+  rates.Compile({{"*", "60"}}, {});
+  ASSERT_FALSE(rates.Enabled());
+  ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+}
+
+TEST(StallRates, WildcardRules)
+{
+  StallRates rates;
+  std::string comment;
+  StallRates::Clock::time_point now = StallRates::Clock::now();
+  rates.Compile({{"rate:user:*:OpenRead", "10"}, {"rate:group:*:OpenWrite", "10"}},
+                {{"rate:group:*:OpenWrite", "group limit"}});
+  // every user has its own bucket
+  rates.Consume("OpenRead", 1, 99, 60, now);
+  rates.Consume("OpenRead", 2, 99, 60, now);
+  ASSERT_FALSE(rates.IsLimited(1, 99, comment, now));
+  ASSERT_FALSE(rates.IsLimited(2, 99, comment, now));
+  rates.Consume("OpenRead", 1, 99, 10, now);
+  ASSERT_TRUE(rates.IsLimited(1, 99, comment, now));
+  ASSERT_FALSE(rates.IsLimited(2, 99, comment, now));
+  // the group rule holds all the members of the group
+  rates.Consume("OpenWrite", 3, 100, 40, now);
+  rates.Consume("OpenWrite", 4, 100, 40, now);
+  ASSERT_TRUE(rates.IsLimited(3, 100, comment, now));
+  ASSERT_TRUE(rates.IsLimited(5, 100, comment, now));
+  ASSERT_EQ("group limit", comment);
+  ASSERT_FALSE(rates.IsLimited(5, 101, comment, now));
+}
+
+TEST(StallRates, RecompileSameRules)
+{
+  StallRates rates;
+  std::string comment;
+  StallRates::Clock::time_point now = StallRates::Clock::now();
+  std::map<std::string, std::string> rules = {
+    {"rate:user:1234:Stat", "100"}, {"*", "60"}
+  };
+  rates.Compile(rules, {});
+  rates.Consume("Stat", 1234, 99, 600, now);
+  ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+  // storing the same configuration again keeps the bucket and the hold
+  rates.Compile(rules, {});
+  rates.Consume("Stat", 1234, 99, 100, now);
+  ASSERT_TRUE(rates.IsLimited(1234, 99, comment, now));
+  rates.Compile(rules, {});
+  ASSERT_TRUE(rates.IsLimited(1234, 99, comment, now));
+  // a changed rule starts over with full buckets
+  rules["rate:user:1234:Stat"] = "200";
+  rates.Compile(rules, {});
+  ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+  rates.Consume("Stat", 1234, 99, 1000, now);
+  ASSERT_FALSE(rates.IsLimited(1234, 99, comment, now));
+}
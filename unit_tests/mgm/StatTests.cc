@@ -0,0 +1,85 @@
+//------------------------------------------------------------------------------
+// File: StatTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2017 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "XrdSys/XrdSysPthread.hh"
+#include "mgm/Stat.hh"
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// Wait for the beginning of a new second so that the windows don't move
+// while the test is running
+//------------------------------------------------------------------------------
+static int64_t
+FreshSecond()
+{
+  int64_t now = time(0);
+
+  while (time(0) == now) {
+    usleep(1000);
+  }
+
+  return time(0);
+}
+
+using namespace eos::mgm;
+
+TEST(StatAvg, RollingWindows)
+{
+  StatAvg avg;
+  int64_t now = FreshSecond();
+
+  for (int64_t t = now - 4000; t <= now; ++t) {
+    avg.Add(10, t);
+  }
+
+  ASSERT_DOUBLE_EQ(10, avg.GetAvg5());
+  ASSERT_DOUBLE_EQ(10, avg.GetAvg60());
+  ASSERT_DOUBLE_EQ(10, avg.GetAvg300());
+  ASSERT_DOUBLE_EQ(10, avg.GetAvg3600());
+  // values older than the window expire without any stamping
+  StatAvg old;
+  old.Add(100, now - 100);
+  ASSERT_DOUBLE_EQ(0, old.GetAvg5());
+  ASSERT_DOUBLE_EQ(0, old.GetAvg60());
+  ASSERT_DOUBLE_EQ(100.0 / 299, old.GetAvg300());
+  ASSERT_DOUBLE_EQ(100.0 / 3599, old.GetAvg3600());
+}
+
+TEST(StatExt, RollingWindows)
+{
+  StatExt ext;
+  int64_t now = FreshSecond();
+
+  for (int64_t t = now - 4000; t <= now; ++t) {
+    ext.InsertSum(2, 6.0, 1.0, (t == now - 100) ? 15.0 : 5.0, t);
+  }
+
+  ASSERT_DOUBLE_EQ(8, ext.GetN5());
+  ASSERT_DOUBLE_EQ(118, ext.GetN60());
+  ASSERT_DOUBLE_EQ(598, ext.GetN300());
+  ASSERT_DOUBLE_EQ(7198, ext.GetN3600());
+  ASSERT_DOUBLE_EQ(3, ext.GetAvg300());
+  ASSERT_DOUBLE_EQ(1, ext.GetMin3600());
+  ASSERT_DOUBLE_EQ(5, ext.GetMax60());
+  ASSERT_DOUBLE_EQ(15, ext.GetMax300());
+}
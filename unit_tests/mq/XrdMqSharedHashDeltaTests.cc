@@ -0,0 +1,400 @@
+//------------------------------------------------------------------------------
+// File: XrdMqSharedHashDeltaTests.cc
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * EOS - the CERN Disk Storage System                                   *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "gtest/gtest.h"
+#include "mq/XrdMqSharedObject.hh"
+#include "proto/SharedHash.pb.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* sSender = "/eos/fst.cern.ch:1095/fst";
+static const char* sSubject1 = "/eos/fst.cern.ch:1095/fst/data01";
+static const char* sSubject2 = "/eos/fst.cern.ch:1095/fst/data02";
+static const char* sQueue = "/eos/*/mgm";
+
+//------------------------------------------------------------------------------
+// Add a delta to a batch
+//------------------------------------------------------------------------------
+static eos::mq::SharedHashDelta*
+AddDelta(eos::mq::SharedHashBatch& batch, const char* subject,
+         unsigned long long epoch, unsigned long long seq, bool snapshot = false)
+{
+  eos::mq::SharedHashDelta* delta = batch.add_deltas();
+  delta->set_subject(subject);
+  delta->set_epoch(epoch);
+  delta->set_seq(seq);
+  delta->set_snapshot(snapshot);
+  return delta;
+}
+
+//------------------------------------------------------------------------------
+// Feed a batch to the shared object manager as if it came from the sender
+//------------------------------------------------------------------------------
+static bool
+Receive(XrdMqSharedObjectManager& som, const eos::mq::SharedHashBatch& batch)
+{
+  XrdOucString body;
+  XrdOucString error;
+
+  if (!XrdMqSharedObjectManager::MakeDeltaEnvString(batch, body)) {
+    return false;
+  }
+
+  XrdMqMessage message("XrdMqSharedHashMessage");
+  message.SetBody(body.c_str());
+  message.kMessageHeader.kSenderId = sSender;
+  return som.ParseEnvMessage(&message, error);
+}
+
+//------------------------------------------------------------------------------
+//! Delta messages captured on the sending side in the order they are sent
+//------------------------------------------------------------------------------
+struct SentDeltas {
+  std::mutex mMutex;
+  std::vector<std::pair<std::string, std::string>> mMessages;
+
+  //----------------------------------------------------------------------------
+  //! Capture the messages of the given shared object manager
+  //----------------------------------------------------------------------------
+  void Attach(XrdMqSharedObjectManager& som)
+  {
+    som.SetDeltaSender([this](const XrdOucString & body,
+    const std::string & receiver) {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mMessages.emplace_back(receiver, body.c_str());
+      return true;
+    });
+  }
+
+  //----------------------------------------------------------------------------
+  //! Decode all the captured messages
+  //----------------------------------------------------------------------------
+  std::vector<eos::mq::SharedHashBatch> Decode()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<eos::mq::SharedHashBatch> batches;
+    std::string tag = XRDMQSHAREDHASH_DELTA "=";
+
+    for (const auto& msg : mMessages) {
+      size_t pos = msg.second.find(tag);
+      EXPECT_NE(std::string::npos, pos);
+      char* raw = 0;
+      ssize_t rawlen = 0;
+      batches.emplace_back();
+
+      if ((pos == std::string::npos) ||
+          !XrdMqMessage::Base64Decode(msg.second.c_str() + pos + tag.length(),
+                                      raw, rawlen)) {
+        ADD_FAILURE() << "cannot decode " << msg.second;
+        continue;
+      }
+
+      EXPECT_TRUE(batches.back().ParseFromArray(raw, rawlen));
+      free(raw);
+    }
+
+    return batches;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Create a hash sending deltas to sQueue
+//------------------------------------------------------------------------------
+static XrdMqSharedHash*
+CreateHash(XrdMqSharedObjectManager& som, const char* subject)
+{
+  XrdMqSharedObjectManager::sDelta = true;
+  som.CreateSharedHash(subject, sQueue, &som);
+  XrdMqRWMutexReadLock lock(som.HashMutex);
+  return som.GetObject(subject, "hash");
+}
+
+TEST(XrdMqSharedHashDelta, Batch)
+{
+  XrdMqSharedObjectManager som;
+  eos::mq::SharedHashBatch batch;
+  eos::mq::SharedHashDelta* delta = AddDelta(batch, sSubject1, 7, 1);
+  delta->add_keys("stat.disk.load");
+  delta->add_values("0.5");
+  delta->add_keys("stat.geotag");
+  delta->add_values("a&b=c");
+  delta = AddDelta(batch, sSubject2, 8, 1);
+  delta->add_keys("stat.disk.load");
+  delta->add_values("0.7");
+  ASSERT_TRUE(Receive(som, batch));
+  XrdMqRWMutexReadLock lock(som.HashMutex);
+  XrdMqSharedHash* hash = som.GetObject(sSubject1, "hash");
+  ASSERT_TRUE(hash != nullptr);
+  ASSERT_EQ("0.5", hash->Get("stat.disk.load"));
+  ASSERT_EQ("a&b=c", hash->Get("stat.geotag"));
+  hash = som.GetObject(sSubject2, "hash");
+  ASSERT_TRUE(hash != nullptr);
+  ASSERT_EQ("0.7", hash->Get("stat.disk.load"));
+}
+
+TEST(XrdMqSharedHashDelta, Sequence)
+{
+  XrdMqSharedObjectManager som;
+  unsigned long long gaps = XrdMqSharedHash::sDeltaGapCounter;
+  eos::mq::SharedHashBatch batch;
+  eos::mq::SharedHashDelta* delta = AddDelta(batch, sSubject1, 7, 1);
+  delta->add_keys("a");
+  delta->add_values("1");
+  delta->add_keys("b");
+  delta->add_values("1");
+  ASSERT_TRUE(Receive(som, batch));
+  // In sequence with a deletion
+  batch.Clear();
+  delta = AddDelta(batch, sSubject1, 7, 2);
+  delta->add_keys("a");
+  delta->add_values("2");
+  delta->add_deletions("b");
+  ASSERT_TRUE(Receive(som, batch));
+  ASSERT_EQ(gaps, XrdMqSharedHash::sDeltaGapCounter);
+  // Delta 3 is lost - 4 is applied but detected as gap
+  batch.Clear();
+  delta = AddDelta(batch, sSubject1, 7, 4);
+  delta->add_keys("a");
+  delta->add_values("4");
+  ASSERT_TRUE(Receive(som, batch));
+  ASSERT_EQ(gaps + 1, XrdMqSharedHash::sDeltaGapCounter);
+  // The snapshot replaces the contents
+  batch.Clear();
+  delta = AddDelta(batch, sSubject1, 7, 5, true);
+  delta->add_keys("c");
+  delta->add_values("5");
+  ASSERT_TRUE(Receive(som, batch));
+  // A delta already included in the snapshot is dropped
+  batch.Clear();
+  delta = AddDelta(batch, sSubject1, 7, 5);
+  delta->add_keys("a");
+  delta->add_values("5");
+  ASSERT_TRUE(Receive(som, batch));
+  {
+    XrdMqRWMutexReadLock lock(som.HashMutex);
+    XrdMqSharedHash* hash = som.GetObject(sSubject1, "hash");
+    ASSERT_TRUE(hash != nullptr);
+    ASSERT_EQ("", hash->Get("a"));
+    ASSERT_EQ("", hash->Get("b"));
+    ASSERT_EQ("5", hash->Get("c"));
+  }
+  // In sequence after the snapshot
+  batch.Clear();
+  delta = AddDelta(batch, sSubject1, 7, 6);
+  delta->add_keys("a");
+  delta->add_values("6");
+  ASSERT_TRUE(Receive(som, batch));
+  ASSERT_EQ(gaps + 1, XrdMqSharedHash::sDeltaGapCounter);
+  // A recreated sender hash has a new epoch
+  batch.Clear();
+  delta = AddDelta(batch, sSubject1, 9, 1);
+  delta->add_keys("a");
+  delta->add_values("1");
+  ASSERT_TRUE(Receive(som, batch));
+  ASSERT_EQ(gaps + 2, XrdMqSharedHash::sDeltaGapCounter);
+  XrdMqRWMutexReadLock lock(som.HashMutex);
+  XrdMqSharedHash* hash = som.GetObject(sSubject1, "hash");
+  ASSERT_EQ("1", hash->Get("a"));
+}
+
+TEST(XrdMqSharedHashDelta, Corrupt)
+{
+  XrdMqSharedObjectManager som;
+  XrdOucString error;
+  XrdMqMessage message("XrdMqSharedHashMessage");
+  message.SetBody(XRDMQSHAREDHASH_DELTAUPDATE "&" XRDMQSHAREDHASH_DELTA
+                  "=////");
+  ASSERT_FALSE(som.ParseEnvMessage(&message, error));
+}
+
+TEST(XrdMqSharedHashDelta, SendSetDelete)
+{
+  XrdMqSharedObjectManager som;
+  SentDeltas sent;
+  sent.Attach(som);
+  XrdMqSharedHash* hash = CreateHash(som, sSubject1);
+  ASSERT_TRUE(hash != nullptr);
+  ASSERT_TRUE(hash->Set("a", "1"));
+  ASSERT_TRUE(hash->Set("b", "2"));
+  ASSERT_TRUE(hash->Delete("a"));
+  // Deleting a missing key or without broadcast sends nothing
+  ASSERT_FALSE(hash->Delete("a"));
+  ASSERT_TRUE(hash->Delete("b", false));
+  std::vector<eos::mq::SharedHashBatch> batches = sent.Decode();
+  ASSERT_EQ(3u, batches.size());
+
+  for (size_t i = 0; i < batches.size(); ++i) {
+    ASSERT_EQ(sQueue, sent.mMessages[i].first);
+    ASSERT_EQ(1, batches[i].deltas_size());
+    const eos::mq::SharedHashDelta& delta = batches[i].deltas(0);
+    ASSERT_EQ(sSubject1, delta.subject());
+    ASSERT_EQ(i + 1, delta.seq());
+    ASSERT_FALSE(delta.snapshot());
+  }
+
+  ASSERT_EQ(1, batches[1].deltas(0).keys_size());
+  ASSERT_EQ("b", batches[1].deltas(0).keys(0));
+  ASSERT_EQ("2", batches[1].deltas(0).values(0));
+  ASSERT_EQ(0, batches[2].deltas(0).keys_size());
+  ASSERT_EQ(1, batches[2].deltas(0).deletions_size());
+  ASSERT_EQ("a", batches[2].deltas(0).deletions(0));
+  // A deletion inside a transaction replaces the pending update
+  ASSERT_TRUE(hash->OpenTransaction());
+  ASSERT_TRUE(hash->Set("c", "3"));
+  ASSERT_TRUE(hash->Delete("c"));
+  ASSERT_TRUE(hash->CloseTransaction());
+  batches = sent.Decode();
+  ASSERT_EQ(4u, batches.size());
+  ASSERT_EQ(4ull, batches[3].deltas(0).seq());
+  ASSERT_EQ(0, batches[3].deltas(0).keys_size());
+  ASSERT_EQ("c", batches[3].deltas(0).deletions(0));
+}
+
+TEST(XrdMqSharedHashDelta, SendSnapshot)
+{
+  XrdMqSharedObjectManager som;
+  SentDeltas sent;
+  sent.Attach(som);
+  XrdMqSharedHash* hash = CreateHash(som, sSubject1);
+  ASSERT_TRUE(hash != nullptr);
+  ASSERT_TRUE(hash->Set("a", "1"));
+  ASSERT_TRUE(hash->Set("b", "2"));
+  ASSERT_TRUE(hash->SendSnapshot("/eos/mgm.cern.ch/mgm"));
+  std::vector<eos::mq::SharedHashBatch> batches = sent.Decode();
+  ASSERT_EQ(3u, batches.size());
+  ASSERT_EQ("/eos/mgm.cern.ch/mgm", sent.mMessages[2].first);
+  const eos::mq::SharedHashDelta& snapshot = batches[2].deltas(0);
+  ASSERT_TRUE(snapshot.snapshot());
+  // The snapshot covers the deltas up to its own sequence number
+  ASSERT_EQ(2ull, snapshot.seq());
+  ASSERT_EQ(2, snapshot.keys_size());
+}
+
+TEST(XrdMqSharedHashDelta, SendMux)
+{
+  XrdMqSharedObjectManager som;
+  SentDeltas sent;
+  sent.Attach(som);
+  XrdMqSharedHash* hash1 = CreateHash(som, sSubject1);
+  XrdMqSharedHash* hash2 = CreateHash(som, sSubject2);
+  ASSERT_TRUE(hash1 != nullptr);
+  ASSERT_TRUE(hash2 != nullptr);
+  ASSERT_TRUE(hash1->Set("a", "1"));
+  ASSERT_TRUE(som.OpenMuxTransaction("hash", "/eos/*/fst"));
+  ASSERT_TRUE(hash1->Set("a", "2"));
+  ASSERT_TRUE(hash1->Set("b", "2"));
+  ASSERT_TRUE(hash2->Set("a", "3"));
+  ASSERT_TRUE(som.CloseMuxTransaction());
+  std::vector<eos::mq::SharedHashBatch> batches = sent.Decode();
+  // One message with one delta per hash, each hash keeps its own sequence
+  ASSERT_EQ(2u, batches.size());
+  ASSERT_EQ("/eos/*/fst", sent.mMessages[1].first);
+  ASSERT_EQ(2, batches[1].deltas_size());
+  std::map<std::string, eos::mq::SharedHashDelta> deltas;
+
+  for (const auto& delta : batches[1].deltas()) {
+    deltas[delta.subject()] = delta;
+  }
+
+  ASSERT_EQ(2ull, deltas[sSubject1].seq());
+  ASSERT_EQ(2, deltas[sSubject1].keys_size());
+  ASSERT_EQ(1ull, deltas[sSubject2].seq());
+  ASSERT_EQ("3", deltas[sSubject2].values(0));
+}
+
+//------------------------------------------------------------------------------
+// Concurrent updates, deletions and mux transactions on the same hashes don't
+// deadlock and the messages are sent in the order of their sequence numbers,
+// so that a receiver ends up with the same contents
+//------------------------------------------------------------------------------
+TEST(XrdMqSharedHashDelta, SendConcurrent)
+{
+  XrdMqSharedObjectManager som;
+  SentDeltas sent;
+  sent.Attach(som);
+  XrdMqSharedHash* hash1 = CreateHash(som, sSubject1);
+  XrdMqSharedHash* hash2 = CreateHash(som, sSubject2);
+  ASSERT_TRUE(hash1 != nullptr);
+  ASSERT_TRUE(hash2 != nullptr);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([ &, t]() {
+      XrdMqSharedHash* hash = (t % 2) ? hash2 : hash1;
+
+      for (int i = 0; i < 500; ++i) {
+        std::string key = "key" + std::to_string(i % 7);
+        hash->Set(key.c_str(), std::to_string(t * 1000 + i));
+
+        if (i % 3 == 0) {
+          hash->Delete(key);
+        }
+      }
+    });
+  }
+
+  threads.emplace_back([&]() {
+    for (int i = 0; i < 200; ++i) {
+      som.OpenMuxTransaction("hash", sQueue);
+      hash1->Set("key1", std::to_string(i));
+      hash2->Set("key2", std::to_string(i));
+      som.CloseMuxTransaction();
+    }
+  });
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::map<std::string, unsigned long long> last_seq;
+  XrdMqSharedObjectManager receiver;
+  unsigned long long gaps = XrdMqSharedHash::sDeltaGapCounter;
+
+  for (const auto& batch : sent.Decode()) {
+    for (const auto& delta : batch.deltas()) {
+      ASSERT_EQ(last_seq[delta.subject()] + 1, delta.seq());
+      last_seq[delta.subject()] = delta.seq();
+    }
+
+    ASSERT_TRUE(Receive(receiver, batch));
+  }
+
+  ASSERT_EQ(gaps, XrdMqSharedHash::sDeltaGapCounter);
+  XrdMqRWMutexReadLock lock(receiver.HashMutex);
+
+  for (const char* subject : {
+         sSubject1, sSubject2
+       }) {
+    XrdMqSharedHash* sender_hash = (subject == sSubject1) ? hash1 : hash2;
+    XrdMqSharedHash* receiver_hash = receiver.GetObject(subject, "hash");
+    ASSERT_TRUE(receiver_hash != nullptr);
+
+    for (int i = 0; i < 7; ++i) {
+      std::string key = "key" + std::to_string(i);
+      ASSERT_EQ(sender_hash->Get(key), receiver_hash->Get(key)) << key;
+    }
+  }
+}